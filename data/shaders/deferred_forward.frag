@@ -0,0 +1,42 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+#define MAX_LIGHTS 256
+
+layout(set = 0, binding = 0) uniform sampler2D diffuseMap;
+
+// same layout as deferred_lighting.frag
+layout(set = 0, binding = 1) uniform Lights {
+    vec4 info;
+    vec4 values[MAX_LIGHTS * 2];
+} lights;
+
+layout(location = 0) in vec3 eyePos;
+layout(location = 1) in vec3 normalDir;
+layout(location = 2) in vec2 texCoord0;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    vec4 albedo = texture(diffuseMap, texCoord0);
+    vec3 normal = normalize(normalDir);
+
+    vec3 color = albedo.rgb * lights.info.yzw;
+    int numLights = min(int(lights.info.x), MAX_LIGHTS);
+    for (int i = 0; i < numLights; ++i)
+    {
+        vec4 position = lights.values[i * 2];
+        vec4 lightColor = lights.values[i * 2 + 1];
+
+        vec3 delta = position.xyz - eyePos;
+        float distance = length(delta);
+        if (distance >= position.w) continue;
+
+        float attenuation = 1.0 - distance / position.w;
+        float diffuse = max(dot(normal, delta / distance), 0.0);
+        color += albedo.rgb * lightColor.rgb * (lightColor.a * diffuse * attenuation * attenuation);
+    }
+
+    outColor = vec4(color, albedo.a);
+}
@@ -0,0 +1,18 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform sampler2D diffuseMap;
+
+layout(location = 0) in vec3 eyePos;
+layout(location = 1) in vec3 normalDir;
+layout(location = 2) in vec2 texCoord0;
+
+// G-buffer, read back as input attachments by deferred_lighting.frag
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec4 outNormal;
+
+void main()
+{
+    outAlbedo = texture(diffuseMap, texCoord0);
+    outNormal = vec4(normalize(normalDir) * 0.5 + 0.5, 0.0);
+}
@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+    mat4 modelView;
+} pc;
+
+layout(location = 0) in vec3 vsg_Vertex;
+layout(location = 1) in vec3 vsg_Normal;
+layout(location = 2) in vec2 vsg_TexCoord0;
+
+layout(location = 0) out vec3 eyePos;
+layout(location = 1) out vec3 normalDir;
+layout(location = 2) out vec2 texCoord0;
+
+out gl_PerVertex{ vec4 gl_Position; };
+
+void main()
+{
+    vec4 eye = pc.modelView * vec4(vsg_Vertex, 1.0);
+    gl_Position = pc.projection * eye;
+
+    eyePos = eye.xyz / eye.w;
+    normalDir = mat3(pc.modelView) * vsg_Normal;
+    texCoord0 = vsg_TexCoord0;
+}
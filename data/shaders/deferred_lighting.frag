@@ -0,0 +1,47 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+#define MAX_LIGHTS 256
+
+// info.x = number of lights, info.yzw = ambient colour, then position and radius, colour and intensity per light in eye coordinates
+layout(set = 0, binding = 0) uniform Lights {
+    vec4 info;
+    vec4 values[MAX_LIGHTS * 2];
+} lights;
+
+layout(input_attachment_index = 0, set = 0, binding = 1) uniform subpassInput albedoInput;
+layout(input_attachment_index = 1, set = 0, binding = 2) uniform subpassInput normalInput;
+layout(input_attachment_index = 2, set = 0, binding = 3) uniform subpassInput depthInput;
+
+layout(location = 0) in vec2 ndc;
+layout(location = 1) flat in mat4 inverseProjection;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    float depth = subpassLoad(depthInput).r;
+    vec4 albedo = subpassLoad(albedoInput);
+    vec3 normal = normalize(subpassLoad(normalInput).xyz * 2.0 - 1.0);
+
+    vec4 eye = inverseProjection * vec4(ndc, depth, 1.0);
+    vec3 eyePos = eye.xyz / eye.w;
+
+    vec3 color = albedo.rgb * lights.info.yzw;
+    int numLights = min(int(lights.info.x), MAX_LIGHTS);
+    for (int i = 0; i < numLights; ++i)
+    {
+        vec4 position = lights.values[i * 2];
+        vec4 lightColor = lights.values[i * 2 + 1];
+
+        vec3 delta = position.xyz - eyePos;
+        float distance = length(delta);
+        if (distance >= position.w) continue;
+
+        float attenuation = 1.0 - distance / position.w;
+        float diffuse = max(dot(normal, delta / distance), 0.0);
+        color += albedo.rgb * lightColor.rgb * (lightColor.a * diffuse * attenuation * attenuation);
+    }
+
+    outColor = vec4(color, albedo.a);
+}
@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+    mat4 modelView;
+} pc;
+
+layout(location = 0) out vec2 ndc;
+layout(location = 1) flat out mat4 inverseProjection;
+
+out gl_PerVertex{ vec4 gl_Position; };
+
+void main()
+{
+    // single triangle covering the whole viewport, no vertex buffers required
+    ndc = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2) * 2.0 - 1.0;
+    gl_Position = vec4(ndc, 0.0, 1.0);
+
+    inverseProjection = inverse(pc.projection);
+}
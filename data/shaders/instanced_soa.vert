@@ -0,0 +1,59 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+#pragma import_defines (VSG_QUANTIZED_INSTANCES)
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+    mat4 modelView;
+} pc;
+
+layout(set = 0, binding = 11) uniform InstanceSettings
+{
+    vec4 dequantize; // chunk size in xyz, maximum scale in w
+    vec4 palette[256];
+} settings;
+
+layout(location = 0) in vec3 vsg_Vertex;
+layout(location = 1) in vec3 vsg_Normal;
+layout(location = 2) in vec2 vsg_TexCoord0;
+
+layout(location = 4) in vec4 vsg_InstancePositionScale;
+layout(location = 5) in vec4 vsg_InstanceRotation;
+layout(location = 6) in uint vsg_InstanceColorIndex;
+
+layout(location = 0) out vec3 eyePos;
+layout(location = 1) out vec3 normalDir;
+layout(location = 2) out vec4 vertexColor;
+layout(location = 3) out vec2 texCoord0;
+
+layout(location = 5) out vec3 viewDir;
+
+out gl_PerVertex{ vec4 gl_Position; };
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    vec4 positionScale = vsg_InstancePositionScale;
+#ifdef VSG_QUANTIZED_INSTANCES
+    positionScale *= settings.dequantize;
+#endif
+
+    // 8 bit quaternions are only approximately unit length
+    vec4 q = normalize(vsg_InstanceRotation);
+
+    vec4 vertex = vec4(rotate(q, vsg_Vertex * positionScale.w) + positionScale.xyz, 1.0);
+    vec4 normal = vec4(rotate(q, vsg_Normal), 0.0);
+
+    gl_Position = (pc.projection * pc.modelView) * vertex;
+    eyePos = (pc.modelView * vertex).xyz;
+    viewDir = - (pc.modelView * vertex).xyz;
+    normalDir = (pc.modelView * normal).xyz;
+
+    vertexColor = settings.palette[vsg_InstanceColorIndex];
+    texCoord0 = vsg_TexCoord0;
+}
@@ -1,6 +1,6 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
-#pragma import_defines (VSG_DIFFUSE_MAP, VSG_GREYSACLE_DIFFUSE_MAP, VSG_EMISSIVE_MAP, VSG_LIGHTMAP_MAP, VSG_NORMAL_MAP, VSG_METALLROUGHNESS_MAP, VSG_SPECULAR_MAP, VSG_TWO_SIDED_LIGHTING, VSG_WORKFLOW_SPECGLOSS)
+#pragma import_defines (VSG_DIFFUSE_MAP, VSG_GREYSACLE_DIFFUSE_MAP, VSG_EMISSIVE_MAP, VSG_LIGHTMAP_MAP, VSG_NORMAL_MAP, VSG_METALLROUGHNESS_MAP, VSG_SPECULAR_MAP, VSG_TWO_SIDED_LIGHTING, VSG_CLUSTERED_LIGHTING, VSG_SHADOW_ATLAS, VSG_IMAGE_BASED_LIGHTING, VSG_WORKFLOW_SPECGLOSS)
 
 const float PI = 3.14159265359;
 const float RECIPROCAL_PI = 0.31830988618;
@@ -49,6 +49,134 @@ layout(set = 1, binding = 0) uniform LightData
     vec4 values[64];
 } lightData;
 
+#ifdef VSG_CLUSTERED_LIGHTING
+// point lights binned into view space froxel clusters by shaders/clustered_lights_cull.comp
+layout(set = 2, binding = 0) uniform ClusterParams
+{
+    mat4 viewMatrix;
+    mat4 inverseProjectionMatrix;
+    vec4 viewport;   // x, y, width, height
+    vec4 depthRange; // near, far, log(far / near)
+    uvec4 counts;    // numClustersX, numClustersY, numClustersZ, numLights
+    uvec4 limits;    // maxLightsPerCluster
+} clusterParams;
+
+layout(set = 2, binding = 1) readonly buffer ClusterLights
+{
+    vec4 values[]; // pairs of position_radius, color_intensity in world coordinates
+} clusterLights;
+
+layout(set = 2, binding = 2) readonly buffer ClusterViewLights
+{
+    vec4 values[]; // position_radius in eye coordinates
+} clusterViewLights;
+
+layout(set = 2, binding = 3) readonly buffer ClusterLightCounts
+{
+    uint values[];
+} clusterLightCounts;
+
+layout(set = 2, binding = 4) readonly buffer ClusterLightIndices
+{
+    uint values[];
+} clusterLightIndices;
+
+uint clusterIndex(vec3 eyePosition)
+{
+    uvec4 counts = clusterParams.counts;
+    vec2 fragCoord = (gl_FragCoord.xy - clusterParams.viewport.xy) / clusterParams.viewport.zw;
+    uint x = min(uint(fragCoord.x * float(counts.x)), counts.x - 1);
+    uint y = min(uint(fragCoord.y * float(counts.y)), counts.y - 1);
+    float slice = log(max(-eyePosition.z, clusterParams.depthRange.x) / clusterParams.depthRange.x) / clusterParams.depthRange.z;
+    uint z = min(uint(slice * float(counts.z)), counts.z - 1);
+    return (z * counts.y + y) * counts.x + x;
+}
+#endif
+
+#ifdef VSG_SHADOW_ATLAS
+// directional light cascades and spot light shadow maps packed into tiles of one depth atlas
+layout(set = 3, binding = 0) uniform sampler2DShadow shadowAtlas;
+
+layout(set = 3, binding = 1) uniform ShadowData
+{
+    mat4 cascadeMatrices[4]; // eye coordinates to atlas texture coordinates and depth
+    vec4 cascadeSplits;      // far distance of each cascade
+    mat4 spotMatrices[4];
+    uvec4 counts;            // numCascades, numSpotShadows
+    vec4 texelSize;          // 1.0 / atlas width, 1.0 / atlas height
+} shadowData;
+
+float sampleShadow(mat4 shadowMatrix, vec3 eyePosition)
+{
+    vec4 coord = shadowMatrix * vec4(eyePosition, 1.0);
+    coord.xyz /= coord.w;
+    if (coord.z <= 0.0 || coord.z >= 1.0) return 1.0;
+
+    // 3x3 percentage closer filtering, each tap is bilinear filtered by the compare sampler
+    float lit = 0.0;
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            lit += texture(shadowAtlas, vec3(coord.xy + vec2(x, y) * shadowData.texelSize.xy, coord.z));
+        }
+    }
+    return lit / 9.0;
+}
+
+float directionalShadow(int lightIndex, vec3 eyePosition)
+{
+    // only the first directional light casts shadows
+    if (lightIndex != 0) return 1.0;
+
+    float distance = -eyePosition.z;
+    for (uint c = 0; c < shadowData.counts.x; ++c)
+    {
+        if (distance <= shadowData.cascadeSplits[c]) return sampleShadow(shadowData.cascadeMatrices[c], eyePosition);
+    }
+    return 1.0;
+}
+
+float spotShadow(int lightIndex, vec3 eyePosition)
+{
+    if (lightIndex >= int(shadowData.counts.y)) return 1.0;
+    return sampleShadow(shadowData.spotMatrices[lightIndex], eyePosition);
+}
+#endif
+
+#ifdef VSG_IMAGE_BASED_LIGHTING
+// irradiance spherical harmonics and GGX prefiltered specular mip chain computed from the environment cube map
+layout(set = 4, binding = 0) uniform EnvironmentParams
+{
+    vec4 irradianceSH[9];    // cosine convolved radiance divided by pi
+    mat4 environmentFromEye; // rotates eye coordinate directions into the environment cube map's
+    vec4 params;             // max prefiltered lod, intensity
+} environmentParams;
+
+layout(set = 4, binding = 1) uniform samplerCube prefilteredMap;
+
+vec3 irradianceSH(vec3 d)
+{
+    vec4 sh[9] = environmentParams.irradianceSH;
+    vec3 irradiance = sh[0].rgb * 0.282095;
+    irradiance += sh[1].rgb * (0.488603 * d.y) + sh[2].rgb * (0.488603 * d.z) + sh[3].rgb * (0.488603 * d.x);
+    irradiance += sh[4].rgb * (1.092548 * d.x * d.y) + sh[5].rgb * (1.092548 * d.y * d.z) + sh[6].rgb * (0.315392 * (3.0 * d.z * d.z - 1.0));
+    irradiance += sh[7].rgb * (1.092548 * d.x * d.z) + sh[8].rgb * (0.546274 * (d.x * d.x - d.y * d.y));
+    return max(irradiance, vec3(0.0));
+}
+
+// analytic fit of the split sum environment BRDF, avoiding a lookup table
+vec3 environmentBRDF(vec3 specularColor, float roughness, float NdotV)
+{
+    const vec4 c0 = vec4(-1.0, -0.0275, -0.572, 0.022);
+    const vec4 c1 = vec4(1.0, 0.0425, 1.04, -0.04);
+    vec4 r = roughness * c0 + c1;
+    float a004 = min(r.x * r.x, exp2(-9.28 * NdotV)) * r.x + r.y;
+    vec2 AB = vec2(-1.04, 1.04) * a004 + r.zw;
+    return specularColor * AB.x + AB.y;
+}
+#endif
+
 layout(location = 0) in vec3 eyePos;
 layout(location = 1) in vec3 normalDir;
 layout(location = 2) in vec4 vertexColor;
@@ -413,6 +541,9 @@ void main()
         for(int i = 0; i<numDirectionalLights; ++i)
         {
             vec4 lightColor = lightData.values[index++];
+#ifdef VSG_SHADOW_ATLAS
+            lightColor.a *= directionalShadow(i, eyePos);
+#endif
             vec3 direction = -lightData.values[index++].xyz;
 
             vec3 l = direction;         // Vector from surface point to light
@@ -442,12 +573,44 @@ void main()
         }
     }
 
+#ifdef VSG_CLUSTERED_LIGHTING
+    {
+        // clustered point lights, fading out to zero at their radius of influence
+        uint cluster = clusterIndex(eyePos);
+        uint maxLightsPerCluster = clusterParams.limits.x;
+        uint numClusterLights = min(clusterLightCounts.values[cluster], maxLightsPerCluster);
+        for(uint i = 0; i<numClusterLights; ++i)
+        {
+            uint lightIndex = clusterLightIndices.values[cluster * maxLightsPerCluster + i];
+            vec4 position_radius = clusterViewLights.values[lightIndex];
+            vec4 lightColor = clusterLights.values[lightIndex * 2 + 1];
+
+            vec3 delta = position_radius.xyz - eyePos;
+            float distance2 = delta.x * delta.x + delta.y * delta.y + delta.z * delta.z;
+            float range2 = distance2 / (position_radius.w * position_radius.w);
+            if (range2 >= 1.0) continue;
+
+            float window = 1.0 - range2 * range2;
+            vec3 direction = delta / sqrt(distance2);
+            float scale = (lightColor.a * window * window) / distance2;
+
+            vec3 l = direction;         // Vector from surface point to light
+            vec3 h = normalize(l+v);    // Half vector between both l and v
+
+            color.rgb += BRDF(lightColor.rgb * scale, v, n, l, h, perceptualRoughness, metallic, specularEnvironmentR0, specularEnvironmentR90, alphaRoughness, diffuseColor, specularColor, ambientOcclusion);
+        }
+    }
+#endif
+
     if (numSpotLights>0)
     {
         // spot light
         for(int i = 0; i<numSpotLights; ++i)
         {
             vec4 lightColor = lightData.values[index++];
+#ifdef VSG_SHADOW_ATLAS
+            lightColor.a *= spotShadow(i, eyePos);
+#endif
             vec4 position_cosInnerAngle = lightData.values[index++];
             vec4 lightDirection_cosOuterAngle = lightData.values[index++];
 
@@ -464,5 +627,17 @@ void main()
         }
     }
 
+#ifdef VSG_IMAGE_BASED_LIGHTING
+    {
+        // diffuse and specular environment light
+        mat3 environmentFromEye = mat3(environmentParams.environmentFromEye);
+        vec3 irradiance = irradianceSH(normalize(environmentFromEye * n));
+        vec3 prefiltered = textureLod(prefilteredMap, normalize(environmentFromEye * reflect(-v, n)), perceptualRoughness * environmentParams.params.x).rgb;
+        float NdotV = clamp(abs(dot(n, v)), 0.001, 1.0);
+
+        color += (diffuseColor * irradiance + prefiltered * environmentBRDF(specularColor, perceptualRoughness, NdotV)) * (environmentParams.params.y * ambientOcclusion);
+    }
+#endif
+
     outColor = LINEARtoSRGB(vec4(color, baseColor.a));
 }
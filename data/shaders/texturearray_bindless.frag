@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+// global table of base textures, indexed by the per instance material index
+layout(set = 0, binding = 1) uniform sampler2D baseTextures[];
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterialIndex;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(baseTextures[nonuniformEXT(fragMaterialIndex)], fragTexCoord);
+}
@@ -0,0 +1,35 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+    mat4 modelview;
+} pc;
+
+// global table of height fields, indexed by the per instance material index
+layout(set = 0, binding = 0) uniform sampler2D heightFields[];
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in uint inMaterialIndex;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterialIndex;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main()
+{
+    float height = texture(heightFields[nonuniformEXT(inMaterialIndex)], inTexCoord).x * 0.1;
+    vec4 position = vec4(inPosition.x, inPosition.y, inPosition.z + height, 1.0);
+
+    gl_Position = (pc.projection * pc.modelview) * position;
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+    fragMaterialIndex = inMaterialIndex;
+}
@@ -1,8 +1,53 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+#pragma import_defines (VSG_BRICK_GRID, VSG_SPARSE_BRICKS)
+
 layout(binding = 0) uniform sampler3D volume;
 
+#ifdef VSG_BRICK_GRID
+layout(binding = 1) uniform BrickSettings
+{
+    vec4 volumeSize;    // voxels
+    vec4 brickGridSize; // bricks in xyz, brick size in voxels in w
+    vec4 atlasSize;     // voxels in the atlas of occupied bricks
+    vec4 parameters;    // empty threshold, max step scale, homogeneous range, opacity threshold
+} bricks;
+
+layout(binding = 2) uniform sampler3D brickMinMax;
+
+#ifdef VSG_SPARSE_BRICKS
+layout(binding = 3) uniform usampler3D brickIndirection;
+#endif
+
+// levelScale is set to the size of the sampled brick's voxels relative to the full resolution voxels
+float sampleVolume(vec3 texcoord, ivec3 brick, out float levelScale)
+{
+#ifdef VSG_SPARSE_BRICKS
+    // volume is an atlas of bricks, each with a one voxel border for filtering across brick faces. The indirection entry
+    // gives the atlas position of the brick and in w its level + 1, so paged volumes can fall back to a coarser brick.
+    uvec4 entry = texelFetch(brickIndirection, brick, 0);
+    levelScale = exp2(float(entry.w) - 1.0);
+    float brickSize = bricks.brickGridSize.w;
+    vec3 levelBrick = floor(vec3(brick) / levelScale);
+    vec3 local = texcoord * bricks.volumeSize.xyz / levelScale - levelBrick * brickSize;
+    vec3 atlasVoxel = vec3(entry.xyz) * (brickSize + 2.0) + 1.0 + local;
+    return texture(volume, atlasVoxel / bricks.atlasSize.xyz).r;
+#else
+    levelScale = 1.0;
+    return texture(volume, texcoord).r;
+#endif
+}
+
+bool emptyBrick(ivec3 brick, float emptyThreshold)
+{
+#ifdef VSG_SPARSE_BRICKS
+    if (texelFetch(brickIndirection, brick, 0).w == 0u) return true;
+#endif
+    return texelFetch(brickMinMax, brick, 0).g <= emptyThreshold;
+}
+#endif
+
 layout(location = 0) in vec4 cameraPos;
 layout(location = 1) in vec4 vertexPos;
 layout(location = 2) in mat4 texgen;
@@ -52,6 +97,61 @@ void main() {
     float AlphaFuncValue = 0.1;
     float SampleDensityValue = 0.005; // 0.5 / texture_sample_count
 
+#ifdef VSG_BRICK_GRID
+    float emptyThreshold = bricks.parameters.x;
+    float maxStepScale = bricks.parameters.y;
+    float homogeneousRange = bricks.parameters.z;
+    float opacityThreshold = bricks.parameters.w;
+
+    // march front to back, from where the ray enters the volume, so it can stop once it's opaque
+    vec3 delta = (t0-te).xyz;
+    float rayLength = length(delta);
+    if (rayLength <= 0.0) discard;
+
+    vec3 rayDir = delta / rayLength;
+    vec3 safeDir = mix(vec3(-1e-6), vec3(1e-6), step(0.0, rayDir));
+    safeDir = mix(safeDir, rayDir, step(1e-6, abs(rayDir)));
+    vec3 brickExtent = bricks.brickGridSize.w / bricks.volumeSize.xyz;
+
+    vec4 fragColor = vec4(0.0, 0.0, 0.0, 0.0);
+    float t = 0.0;
+    int iterations = 0;
+    while(t <= rayLength && iterations < int(max_iteratrions))
+    {
+        ++iterations;
+
+        vec3 texcoord = te.xyz + rayDir * t;
+        ivec3 brick = clamp(ivec3(floor(texcoord / brickExtent)), ivec3(0), ivec3(bricks.brickGridSize.xyz) - 1);
+        if (emptyBrick(brick, emptyThreshold))
+        {
+            // nothing in this brick can contribute so jump to where the ray leaves it
+            vec3 brickMin = vec3(brick) * brickExtent;
+            vec3 tExit = (mix(brickMin, brickMin + brickExtent, step(0.0, safeDir)) - texcoord) / safeDir;
+            t += max(min(min(tExit.x, tExit.y), tExit.z), 0.0) + SampleDensityValue * 0.01;
+            continue;
+        }
+
+        // take longer steps through bricks with little variation and coarser levels, correcting the opacity for the step length
+        vec2 minMax = texelFetch(brickMinMax, brick, 0).rg;
+        float levelScale;
+        float alpha = sampleVolume(texcoord, brick, levelScale);
+        float stepScale = ((minMax.y - minMax.x) < homogeneousRange ? maxStepScale : 1.0) * levelScale;
+
+        vec4 color = vec4(alpha, alpha, alpha, alpha * TransparencyValue);
+        float r = 1.0 - pow(1.0 - color.a, stepScale);
+        if (r > AlphaFuncValue)
+        {
+            fragColor.rgb += (1.0 - fragColor.a) * r * color.rgb;
+            fragColor.a += (1.0 - fragColor.a) * r;
+        }
+
+        // early ray termination once the ray is effectively opaque
+        if (fragColor.a >= opacityThreshold) break;
+
+        t += SampleDensityValue * stepScale;
+    }
+    if (fragColor.a > 0.0) fragColor.rgb /= fragColor.a;
+#else
     float num_iterations = ceil(length((te-t0).xyz)/SampleDensityValue);
     if (num_iterations<min_iteratrions) num_iterations = min_iteratrions;
     else if (num_iterations>max_iteratrions) num_iterations = max_iteratrions;
@@ -79,6 +179,7 @@ void main() {
         texcoord += deltaTexCoord;
         --num_iterations;
     }
+#endif
     if (fragColor.a>1.0) fragColor.a = 1.0;
     if (fragColor.a<AlphaFuncValue) discard;
     outColor = fragColor;
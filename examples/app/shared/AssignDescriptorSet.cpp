@@ -0,0 +1,54 @@
+#include "AssignDescriptorSet.h"
+
+namespace
+{
+    bool matches(const vsg::DescriptorSetLayoutBindings& lhs, const vsg::DescriptorSetLayoutBindings& rhs)
+    {
+        if (lhs.size() != rhs.size()) return false;
+        for (size_t i = 0; i < lhs.size(); ++i)
+        {
+            if (lhs[i].binding != rhs[i].binding || lhs[i].descriptorType != rhs[i].descriptorType ||
+                lhs[i].descriptorCount != rhs[i].descriptorCount || lhs[i].stageFlags != rhs[i].stageFlags) return false;
+        }
+        return true;
+    }
+} // namespace
+
+AssignDescriptorSet::AssignDescriptorSet(vsg::ref_ptr<vsg::DescriptorSet> in_descriptorSet, uint32_t in_set) :
+    descriptorSet(in_descriptorSet),
+    set(in_set)
+{
+}
+
+void AssignDescriptorSet::apply(vsg::Node& node)
+{
+    if (_visited.insert(&node).second) node.traverse(*this);
+}
+
+void AssignDescriptorSet::apply(vsg::StateGroup& stateGroup)
+{
+    if (!_visited.insert(&stateGroup).second) return;
+
+    vsg::ref_ptr<vsg::BindDescriptorSet> bindDescriptorSet;
+    for (auto& stateCommand : stateGroup.stateCommands)
+    {
+        auto bindGraphicsPipeline = stateCommand.cast<vsg::BindGraphicsPipeline>();
+        if (!bindGraphicsPipeline || !bindGraphicsPipeline->pipeline) continue;
+
+        auto& layout = bindGraphicsPipeline->pipeline->layout;
+        if (!layout || layout->setLayouts.size() <= set || !matches(layout->setLayouts[set]->bindings, descriptorSet->setLayout->bindings)) continue;
+
+        // share the binds between StateGroups with the same layout so they are recorded once when adjacent
+        auto& bind = _binds[layout.get()];
+        if (!bind) bind = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set, descriptorSet);
+        bindDescriptorSet = bind;
+    }
+
+    if (bindDescriptorSet)
+    {
+        stateGroup.add(bindDescriptorSet);
+        ++numAssigned;
+    }
+
+    stateGroup.traverse(*this);
+}
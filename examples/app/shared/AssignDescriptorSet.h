@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <map>
+#include <set>
+
+// adds a BindDescriptorSet for a descriptor set to the StateGroups whose pipeline layouts include its layout at the given set number
+class AssignDescriptorSet : public vsg::Inherit<vsg::Visitor, AssignDescriptorSet>
+{
+public:
+    AssignDescriptorSet(vsg::ref_ptr<vsg::DescriptorSet> in_descriptorSet, uint32_t in_set);
+
+    vsg::ref_ptr<vsg::DescriptorSet> descriptorSet;
+    uint32_t set;
+    size_t numAssigned = 0;
+
+    void apply(vsg::Node& node) override;
+    void apply(vsg::StateGroup& stateGroup) override;
+
+protected:
+    std::set<vsg::Object*> _visited;
+    std::map<vsg::PipelineLayout*, vsg::ref_ptr<vsg::BindDescriptorSet>> _binds;
+};
@@ -0,0 +1,100 @@
+#include "AsyncCompute.h"
+
+#include <set>
+
+int findDedicatedComputeQueueFamily(vsg::PhysicalDevice* physicalDevice)
+{
+    auto& queueFamilyProperties = physicalDevice->getQueueFamilyProperties();
+    for (size_t i = 0; i < queueFamilyProperties.size(); ++i)
+    {
+        auto queueFlags = queueFamilyProperties[i].queueFlags;
+        if ((queueFlags & VK_QUEUE_COMPUTE_BIT) != 0 && (queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+vsg::ref_ptr<vsg::Device> createDeviceWithComputeQueue(vsg::Window* window, int computeQueueFamily)
+{
+    auto& windowTraits = window->traits();
+    auto instance = window->getOrCreateInstance();
+    auto surface = window->getOrCreateSurface();
+    auto physicalDevice = window->getOrCreatePhysicalDevice();
+
+    auto [queueFamily, presentFamily] = physicalDevice->getQueueFamily(windowTraits->queueFlags, surface);
+    if (queueFamily < 0 || presentFamily < 0 || computeQueueFamily < 0) return {};
+
+    vsg::QueueSettings queueSettings;
+    for (auto family : std::set<int>{queueFamily, presentFamily, computeQueueFamily})
+    {
+        queueSettings.push_back(vsg::QueueSetting{family, {1.0}});
+    }
+
+    vsg::Names requestedLayers;
+    if (windowTraits->debugLayer)
+    {
+        requestedLayers.push_back("VK_LAYER_KHRONOS_validation");
+        if (windowTraits->apiDumpLayer) requestedLayers.push_back("VK_LAYER_LUNARG_api_dump");
+    }
+    vsg::Names validatedNames = vsg::validateInstancelayerNames(requestedLayers);
+
+    vsg::Names deviceExtensions;
+    deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    deviceExtensions.insert(deviceExtensions.end(), windowTraits->deviceExtensionNames.begin(), windowTraits->deviceExtensionNames.end());
+
+    auto device = vsg::Device::create(physicalDevice, queueSettings, validatedNames, deviceExtensions, windowTraits->deviceFeatures, instance->getAllocationCallbacks());
+    window->setDevice(device);
+    return device;
+}
+
+AsyncCompute::AsyncCompute(vsg::ref_ptr<vsg::RecordAndSubmitTask> in_computeTask, vsg::ref_ptr<vsg::RecordAndSubmitTask> in_graphicsTask, uint32_t in_numSlots) :
+    computeTask(in_computeTask),
+    graphicsTask(in_graphicsTask),
+    numSlots(std::max(in_numSlots, 2u)),
+    _computeWaitSemaphores(in_computeTask->waitSemaphores),
+    _computeSignalSemaphores(in_computeTask->signalSemaphores),
+    _graphicsWaitSemaphores(in_graphicsTask->waitSemaphores),
+    _graphicsSignalSemaphores(in_graphicsTask->signalSemaphores)
+{
+    auto device = computeTask->device;
+    for (uint32_t i = 0; i < numSlots; ++i)
+    {
+        _computeSignals.push_back(vsg::Semaphore::create(device, graphicsWaitStages));
+        _graphicsSignals.push_back(vsg::Semaphore::create(device, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT));
+    }
+}
+
+vsg::ref_ptr<AsyncCompute> AsyncCompute::assign(vsg::Viewer& viewer, vsg::ref_ptr<vsg::CommandGraph> computeCommandGraph, vsg::ref_ptr<vsg::CommandGraph> graphicsCommandGraph, uint32_t in_numSlots)
+{
+    vsg::ref_ptr<vsg::RecordAndSubmitTask> computeTask, graphicsTask;
+    for (auto& task : viewer.recordAndSubmitTasks)
+    {
+        for (auto& commandGraph : task->commandGraphs)
+        {
+            if (commandGraph == computeCommandGraph) computeTask = task;
+            if (commandGraph == graphicsCommandGraph) graphicsTask = task;
+        }
+    }
+
+    if (!computeTask || !graphicsTask || computeTask == graphicsTask) return {};
+
+    return AsyncCompute::create(computeTask, graphicsTask, in_numSlots);
+}
+
+void AsyncCompute::advance(uint64_t frameCount)
+{
+    _frameCount = frameCount;
+
+    // each binary semaphore is signalled once and waited on once before it's signalled again, the waits are always
+    // on semaphores signalled in an earlier frame so the order the viewer submits the tasks in doesn't matter.
+    computeTask->waitSemaphores = _computeWaitSemaphores;
+    if (_frameCount + 1 >= numSlots) computeTask->waitSemaphores.push_back(_graphicsSignals[(_frameCount + 1) % numSlots]);
+
+    computeTask->signalSemaphores = _computeSignalSemaphores;
+    computeTask->signalSemaphores.push_back(_computeSignals[_frameCount % numSlots]);
+
+    graphicsTask->waitSemaphores = _graphicsWaitSemaphores;
+    if (_frameCount > 0) graphicsTask->waitSemaphores.push_back(_computeSignals[(_frameCount - 1) % numSlots]);
+
+    graphicsTask->signalSemaphores = _graphicsSignalSemaphores;
+    graphicsTask->signalSemaphores.push_back(_graphicsSignals[_frameCount % numSlots]);
+}
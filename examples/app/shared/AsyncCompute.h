@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// returns a queue family with compute but not graphics support, or -1 if the physical device doesn't have one.
+extern int findDedicatedComputeQueueFamily(vsg::PhysicalDevice* physicalDevice);
+
+// assign the window a device with queues for the window's graphics and present families and for computeQueueFamily,
+// call before the window's device is created.
+extern vsg::ref_ptr<vsg::Device> createDeviceWithComputeQueue(vsg::Window* window, int computeQueueFamily);
+
+// Chains a compute RecordAndSubmitTask on a dedicated compute queue and the graphics RecordAndSubmitTask that consumes
+// its results, so that the compute work for the next frame overlaps the rendering of the current frame.
+// The results are written to one of numSlots slots in rotation, compute for frame i writes slot i % numSlots and the
+// graphics for frame i reads the slot written by compute for frame i - 1. The dependencies are binary semaphores assigned
+// to the tasks each frame: graphics for frame i waits on compute for frame i - 1, and compute for frame i waits on the
+// graphics for frame i + 1 - numSlots, the last frame to read the slot it overwrites.
+class AsyncCompute : public vsg::Inherit<vsg::Object, AsyncCompute>
+{
+public:
+    AsyncCompute(vsg::ref_ptr<vsg::RecordAndSubmitTask> in_computeTask, vsg::ref_ptr<vsg::RecordAndSubmitTask> in_graphicsTask, uint32_t in_numSlots = 3);
+
+    const vsg::ref_ptr<vsg::RecordAndSubmitTask> computeTask;
+    const vsg::ref_ptr<vsg::RecordAndSubmitTask> graphicsTask;
+    const uint32_t numSlots;
+
+    // VkPipelineStageFlags at which the graphics submission waits for the compute results
+    VkPipelineStageFlags graphicsWaitStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    // find the tasks that the viewer has assigned the compute and graphics command graphs to, returns null if they share the same task.
+    static vsg::ref_ptr<AsyncCompute> assign(vsg::Viewer& viewer, vsg::ref_ptr<vsg::CommandGraph> computeCommandGraph, vsg::ref_ptr<vsg::CommandGraph> graphicsCommandGraph, uint32_t in_numSlots = 3);
+
+    // assign the semaphores for frameCount, call before Viewer::recordAndSubmit()
+    void advance(uint64_t frameCount);
+
+    uint32_t computeSlot() const { return static_cast<uint32_t>(_frameCount % numSlots); }
+
+    // returns false for the first frame when there is no compute result to draw yet
+    bool graphicsReady() const { return _frameCount > 0; }
+    uint32_t graphicsSlot() const { return static_cast<uint32_t>((_frameCount + numSlots - 1) % numSlots); }
+
+protected:
+    uint64_t _frameCount = 0;
+    vsg::Semaphores _computeSignals;
+    vsg::Semaphores _graphicsSignals;
+
+    // the semaphores assigned to the tasks before the AsyncCompute was set up
+    vsg::Semaphores _computeWaitSemaphores;
+    vsg::Semaphores _computeSignalSemaphores;
+    vsg::Semaphores _graphicsWaitSemaphores;
+    vsg::Semaphores _graphicsSignalSemaphores;
+};
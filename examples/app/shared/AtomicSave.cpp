@@ -0,0 +1,49 @@
+#include "AtomicSave.h"
+
+#include <vsg/io/Logger.h>
+
+#include <atomic>
+#include <filesystem>
+#include <string>
+
+#ifdef _WIN32
+#    include <process.h>
+#    define getpid _getpid
+#else
+#    include <unistd.h>
+#endif
+
+vsg::Path experimental::temporaryFilename(const vsg::Path& filename)
+{
+    // the process id keeps concurrent runs apart, the count concurrent saves within this one
+    static std::atomic_uint32_t s_count{0};
+
+    auto temporary = vsg::removeExtension(filename);
+    temporary.concat("." + std::to_string(getpid()) + "_" + std::to_string(s_count++) + ".tmp");
+    temporary.concat(vsg::fileExtension(filename));
+    return temporary;
+}
+
+bool experimental::replaceFile(const vsg::Path& temporaryFilename, const vsg::Path& filename)
+{
+    // std::filesystem::rename() replaces an existing file on Windows too
+    std::error_code ec;
+    std::filesystem::rename(std::filesystem::path(temporaryFilename.native()), std::filesystem::path(filename.native()), ec);
+    if (!ec) return true;
+
+    vsg::warn("Unable to replace ", filename, ", ", ec.message());
+    std::filesystem::remove(std::filesystem::path(temporaryFilename.native()), ec);
+    return false;
+}
+
+bool experimental::atomicSave(const vsg::Path& filename, const std::function<bool(const vsg::Path& temporaryFilename)>& writeFile)
+{
+    auto temporary = temporaryFilename(filename);
+    if (!writeFile(temporary))
+    {
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::path(temporary.native()), ec);
+        return false;
+    }
+    return replaceFile(temporary, filename);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vsg/io/Path.h>
+
+#include <functional>
+
+// Saving files so that readers never see them partially written. The file is written to a temporary file alongside it
+// and then moved over the original, which replaces an existing file on all platforms, std::rename() fails on Windows
+// when the target exists. On failure the temporary file is removed and the original is left untouched.
+namespace experimental
+{
+    // temporary filename in the same directory as filename, unique to this process and keeping the extension so that vsg::write() selects the same ReaderWriter
+    vsg::Path temporaryFilename(const vsg::Path& filename);
+
+    // move temporaryFilename over filename, removing temporaryFilename if that fails
+    bool replaceFile(const vsg::Path& temporaryFilename, const vsg::Path& filename);
+
+    // call writeFile(temporaryFilename) and replace filename with the result if it returns true
+    bool atomicSave(const vsg::Path& filename, const std::function<bool(const vsg::Path& temporaryFilename)>& writeFile);
+} // namespace experimental
@@ -0,0 +1,334 @@
+#include "BatchCull.h"
+
+#include <cmath>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#    define BATCHCULL_X86
+#    include <immintrin.h>
+#    if defined(__GNUC__) || defined(__clang__)
+#        define BATCHCULL_TARGET_SSE __attribute__((target("sse")))
+#        define BATCHCULL_TARGET_AVX2 __attribute__((target("avx2")))
+#    else
+#        define BATCHCULL_TARGET_SSE
+#        define BATCHCULL_TARGET_AVX2
+#    endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#    define BATCHCULL_NEON
+#    include <arm_neon.h>
+#endif
+
+void SphereBatch::reserve(size_t n)
+{
+    x.reserve(n);
+    y.reserve(n);
+    z.reserve(n);
+    radius.reserve(n);
+}
+
+void SphereBatch::clear()
+{
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+}
+
+void SphereBatch::add(const vsg::sphere& sphere)
+{
+    x.push_back(sphere.center.x);
+    y.push_back(sphere.center.y);
+    z.push_back(sphere.center.z);
+    radius.push_back(sphere.radius);
+}
+
+void BoxBatch::reserve(size_t n)
+{
+    x.reserve(n);
+    y.reserve(n);
+    z.reserve(n);
+    ex.reserve(n);
+    ey.reserve(n);
+    ez.reserve(n);
+}
+
+void BoxBatch::clear()
+{
+    x.clear();
+    y.clear();
+    z.clear();
+    ex.clear();
+    ey.clear();
+    ez.clear();
+}
+
+void BoxBatch::add(const vsg::box& box)
+{
+    auto center = (box.min + box.max) * 0.5f;
+    auto extents = (box.max - box.min) * 0.5f;
+    x.push_back(center.x);
+    y.push_back(center.y);
+    z.push_back(center.z);
+    ex.push_back(extents.x);
+    ey.push_back(extents.y);
+    ez.push_back(extents.z);
+}
+
+namespace
+{
+    // plane with the absolute values of its normal, the distance of a box's furthest corner along the normal
+    struct CullPlane
+    {
+        float nx, ny, nz, w;
+        float ax, ay, az;
+    };
+
+    // all the kernels evaluate distance + extent >= 0 with the same order of operations so that they agree exactly
+    inline float scalarDistance(const CullPlane& p, float x, float y, float z)
+    {
+        return ((p.nx * x + p.ny * y) + p.nz * z) + p.w;
+    }
+
+    inline float scalarExtent(const CullPlane&, const SphereBatch& batch, size_t i)
+    {
+        return batch.radius[i];
+    }
+
+    inline float scalarExtent(const CullPlane& p, const BoxBatch& batch, size_t i)
+    {
+        return (p.ax * batch.ex[i] + p.ay * batch.ey[i]) + p.az * batch.ez[i];
+    }
+
+    template<class B>
+    void cullScalar(const std::vector<CullPlane>& planes, const B& batch, uint64_t* mask, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            bool visible = true;
+            for (auto& p : planes)
+            {
+                if (scalarDistance(p, batch.x[i], batch.y[i], batch.z[i]) + scalarExtent(p, batch, i) < 0.0f)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+            if (visible) mask[i >> 6] |= uint64_t(1) << (i & 63);
+        }
+    }
+
+#if defined(BATCHCULL_X86)
+    template<class B>
+    BATCHCULL_TARGET_SSE size_t cullSSE(const std::vector<CullPlane>& planes, const B& batch, uint64_t* mask, size_t n)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(batch.x.data() + i);
+            __m128 y = _mm_loadu_ps(batch.y.data() + i);
+            __m128 z = _mm_loadu_ps(batch.z.data() + i);
+            __m128 inside = _mm_cmpeq_ps(zero, zero);
+            for (auto& p : planes)
+            {
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.nx), x), _mm_mul_ps(_mm_set1_ps(p.ny), y)), _mm_mul_ps(_mm_set1_ps(p.nz), z)), _mm_set1_ps(p.w));
+                __m128 r;
+                if constexpr (std::is_same_v<B, BoxBatch>)
+                    r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.ax), _mm_loadu_ps(batch.ex.data() + i)), _mm_mul_ps(_mm_set1_ps(p.ay), _mm_loadu_ps(batch.ey.data() + i))), _mm_mul_ps(_mm_set1_ps(p.az), _mm_loadu_ps(batch.ez.data() + i)));
+                else
+                    r = _mm_loadu_ps(batch.radius.data() + i);
+
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+                if (_mm_movemask_ps(inside) == 0) break;
+            }
+            mask[i >> 6] |= uint64_t(_mm_movemask_ps(inside)) << (i & 63);
+        }
+        return i;
+    }
+
+    template<class B>
+    BATCHCULL_TARGET_AVX2 size_t cullAVX2(const std::vector<CullPlane>& planes, const B& batch, uint64_t* mask, size_t n)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 x = _mm256_loadu_ps(batch.x.data() + i);
+            __m256 y = _mm256_loadu_ps(batch.y.data() + i);
+            __m256 z = _mm256_loadu_ps(batch.z.data() + i);
+            __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+            for (auto& p : planes)
+            {
+                __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.nx), x), _mm256_mul_ps(_mm256_set1_ps(p.ny), y)), _mm256_mul_ps(_mm256_set1_ps(p.nz), z)), _mm256_set1_ps(p.w));
+                __m256 r;
+                if constexpr (std::is_same_v<B, BoxBatch>)
+                    r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.ax), _mm256_loadu_ps(batch.ex.data() + i)), _mm256_mul_ps(_mm256_set1_ps(p.ay), _mm256_loadu_ps(batch.ey.data() + i))), _mm256_mul_ps(_mm256_set1_ps(p.az), _mm256_loadu_ps(batch.ez.data() + i)));
+                else
+                    r = _mm256_loadu_ps(batch.radius.data() + i);
+
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+                if (_mm256_movemask_ps(inside) == 0) break;
+            }
+            mask[i >> 6] |= uint64_t(_mm256_movemask_ps(inside)) << (i & 63);
+        }
+        return i;
+    }
+
+    bool cpuSupportsAVX2()
+    {
+#    if defined(__GNUC__) || defined(__clang__)
+        return __builtin_cpu_supports("avx2");
+#    elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#    else
+        return false;
+#    endif
+    }
+
+    bool cpuSupportsSSE()
+    {
+#    if defined(__x86_64__) || defined(_M_X64) || defined(__SSE__)
+        return true;
+#    elif defined(__GNUC__) || defined(__clang__)
+        return __builtin_cpu_supports("sse");
+#    elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[3] & (1 << 25)) != 0;
+#    else
+        return false;
+#    endif
+    }
+#endif
+
+#if defined(BATCHCULL_NEON)
+    template<class B>
+    size_t cullNEON(const std::vector<CullPlane>& planes, const B& batch, uint64_t* mask, size_t n)
+    {
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        const uint32_t laneBits[4] = {1, 2, 4, 8};
+        const uint32x4_t bits = vld1q_u32(laneBits);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            float32x4_t x = vld1q_f32(batch.x.data() + i);
+            float32x4_t y = vld1q_f32(batch.y.data() + i);
+            float32x4_t z = vld1q_f32(batch.z.data() + i);
+            uint32x4_t inside = vdupq_n_u32(0xffffffff);
+            for (auto& p : planes)
+            {
+                float32x4_t d = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_n_f32(x, p.nx), vmulq_n_f32(y, p.ny)), vmulq_n_f32(z, p.nz)), vdupq_n_f32(p.w));
+                float32x4_t r;
+                if constexpr (std::is_same_v<B, BoxBatch>)
+                    r = vaddq_f32(vaddq_f32(vmulq_n_f32(vld1q_f32(batch.ex.data() + i), p.ax), vmulq_n_f32(vld1q_f32(batch.ey.data() + i), p.ay)), vmulq_n_f32(vld1q_f32(batch.ez.data() + i), p.az));
+                else
+                    r = vld1q_f32(batch.radius.data() + i);
+
+                inside = vandq_u32(inside, vcgeq_f32(vaddq_f32(d, r), zero));
+                if (vmaxvq_u32(inside) == 0) break;
+            }
+            mask[i >> 6] |= uint64_t(vaddvq_u32(vandq_u32(inside, bits))) << (i & 63);
+        }
+        return i;
+    }
+#endif
+
+    size_t countVisible(const VisibilityMask& mask)
+    {
+        size_t count = 0;
+        for (auto bits : mask)
+        {
+            for (; bits != 0; bits &= bits - 1) ++count;
+        }
+        return count;
+    }
+
+    template<class B>
+    size_t cullBatch(const std::vector<vsg::plane>& planes, const B& batch, VisibilityMask& mask, CullInstructionSet instructionSet)
+    {
+        std::vector<CullPlane> cullPlanes;
+        cullPlanes.reserve(planes.size());
+        for (auto& plane : planes)
+        {
+            cullPlanes.push_back(CullPlane{plane.n.x, plane.n.y, plane.n.z, plane.p, std::abs(plane.n.x), std::abs(plane.n.y), std::abs(plane.n.z)});
+        }
+
+        size_t n = batch.size();
+        mask.assign((n + 63) / 64, 0);
+
+        if (!supported(instructionSet)) instructionSet = CullInstructionSet::SCALAR;
+
+        // the vector kernels process whole lanes, leaving the remainder to the scalar kernel
+        size_t i = 0;
+        switch (instructionSet)
+        {
+#if defined(BATCHCULL_X86)
+        case (CullInstructionSet::SSE): i = cullSSE(cullPlanes, batch, mask.data(), n); break;
+        case (CullInstructionSet::AVX2): i = cullAVX2(cullPlanes, batch, mask.data(), n); break;
+#endif
+#if defined(BATCHCULL_NEON)
+        case (CullInstructionSet::NEON): i = cullNEON(cullPlanes, batch, mask.data(), n); break;
+#endif
+        default: break;
+        }
+        cullScalar(cullPlanes, batch, mask.data(), i, n);
+
+        return countVisible(mask);
+    }
+} // namespace
+
+CullInstructionSet bestInstructionSet()
+{
+    static const CullInstructionSet s_best = []() {
+        if (supported(CullInstructionSet::AVX2)) return CullInstructionSet::AVX2;
+        if (supported(CullInstructionSet::NEON)) return CullInstructionSet::NEON;
+        if (supported(CullInstructionSet::SSE)) return CullInstructionSet::SSE;
+        return CullInstructionSet::SCALAR;
+    }();
+    return s_best;
+}
+
+bool supported(CullInstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case (CullInstructionSet::SCALAR): return true;
+#if defined(BATCHCULL_X86)
+    case (CullInstructionSet::SSE): return cpuSupportsSSE();
+    case (CullInstructionSet::AVX2): return cpuSupportsAVX2();
+#endif
+#if defined(BATCHCULL_NEON)
+    // NEON is part of the base ARMv8-A instruction set
+    case (CullInstructionSet::NEON): return true;
+#endif
+    default: return false;
+    }
+}
+
+const char* name(CullInstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case (CullInstructionSet::SCALAR): return "scalar";
+    case (CullInstructionSet::SSE): return "SSE";
+    case (CullInstructionSet::AVX2): return "AVX2";
+    case (CullInstructionSet::NEON): return "NEON";
+    }
+    return "unknown";
+}
+
+size_t cull(const std::vector<vsg::plane>& planes, const SphereBatch& spheres, VisibilityMask& mask, CullInstructionSet instructionSet)
+{
+    return cullBatch(planes, spheres, mask, instructionSet);
+}
+
+size_t cull(const std::vector<vsg::plane>& planes, const BoxBatch& boxes, VisibilityMask& mask, CullInstructionSet instructionSet)
+{
+    return cullBatch(planes, boxes, mask, instructionSet);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vsg/maths/box.h>
+#include <vsg/maths/plane.h>
+#include <vsg/maths/sphere.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
+// Structure of arrays bounding spheres, so that a batch of them can be tested against each plane several at a time.
+struct SphereBatch
+{
+    std::vector<float> x, y, z, radius;
+
+    size_t size() const { return x.size(); }
+    void reserve(size_t n);
+    void clear();
+    void add(const vsg::sphere& sphere);
+};
+
+// Structure of arrays bounding boxes, stored as centre and half extents.
+struct BoxBatch
+{
+    std::vector<float> x, y, z, ex, ey, ez;
+
+    size_t size() const { return x.size(); }
+    void reserve(size_t n);
+    void clear();
+    void add(const vsg::box& box);
+};
+
+// instruction sets the culling kernels are implemented with
+enum class CullInstructionSet
+{
+    SCALAR,
+    SSE,
+    AVX2,
+    NEON
+};
+
+// the fastest instruction set supported by the CPU, checked the first time it's called
+extern CullInstructionSet bestInstructionSet();
+extern bool supported(CullInstructionSet instructionSet);
+extern const char* name(CullInstructionSet instructionSet);
+
+// one bit per element, bit i of word i / 64 is set when element i is inside or intersects all of the planes
+using VisibilityMask = std::vector<uint64_t>;
+
+// test a batch against the half spaces dot(plane.n, p) + plane.p >= 0, the plane normals must be normalized.
+// Returns the number of visible elements, falling back to SCALAR if instructionSet isn't supported.
+extern size_t cull(const std::vector<vsg::plane>& planes, const SphereBatch& spheres, VisibilityMask& mask, CullInstructionSet instructionSet = bestInstructionSet());
+extern size_t cull(const std::vector<vsg::plane>& planes, const BoxBatch& boxes, VisibilityMask& mask, CullInstructionSet instructionSet = bestInstructionSet());
+
+// call func(index) for each set bit of mask in increasing order
+template<typename F>
+void forEachVisible(const VisibilityMask& mask, F func)
+{
+    for (size_t w = 0; w < mask.size(); ++w)
+    {
+        for (uint64_t bits = mask[w]; bits != 0; bits &= bits - 1)
+        {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+            unsigned long bit;
+            _BitScanForward64(&bit, bits);
+#elif defined(_MSC_VER)
+            unsigned long bit = 0;
+            while (((bits >> bit) & 1) == 0) ++bit;
+#else
+            int bit = __builtin_ctzll(bits);
+#endif
+            func(w * 64 + bit);
+        }
+    }
+}
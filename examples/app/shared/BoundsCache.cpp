@@ -0,0 +1,164 @@
+#include "BoundsCache.h"
+
+#include <algorithm>
+
+namespace
+{
+    // collect the immediate children of a node without recursing into them
+    struct CollectChildren : public vsg::Visitor
+    {
+        std::vector<vsg::Node*> children;
+
+        void apply(vsg::Node& node) override { children.push_back(&node); }
+    };
+
+    bool isInterior(const vsg::Node* node)
+    {
+        return node->is_compatible(typeid(vsg::Group)) || node->is_compatible(typeid(vsg::LOD)) || node->is_compatible(typeid(vsg::Switch)) || node->is_compatible(typeid(vsg::CullNode));
+    }
+
+    vsg::dsphere toSphere(const vsg::dbox& box)
+    {
+        if (!box.valid()) return vsg::dsphere();
+        return vsg::dsphere((box.min + box.max) * 0.5, vsg::length(box.max - box.min) * 0.5);
+    }
+} // namespace
+
+BoundsCache::BoundsCache(vsg::ref_ptr<vsg::Node> in_root) :
+    root(in_root)
+{
+    if (root) _add(root);
+}
+
+uint32_t BoundsCache::_add(vsg::Node* node)
+{
+    if (auto itr = _indices.find(node); itr != _indices.end()) return itr->second;
+
+    auto index = static_cast<uint32_t>(_entries.size());
+    _indices[node] = index;
+
+    auto& entry = _entries.emplace_back();
+    entry.node = node;
+    entry.interior = isInterior(node);
+
+    if (entry.interior) _collectChildren(index);
+    return index;
+}
+
+void BoundsCache::_collectChildren(uint32_t index)
+{
+    CollectChildren collect;
+    _entries[index].node->traverse(collect);
+
+    std::vector<uint32_t> children;
+    children.reserve(collect.children.size());
+    for (auto child : collect.children)
+    {
+        // _add() can reallocate _entries, so look the entries up again after it
+        auto childIndex = _add(child);
+        children.push_back(childIndex);
+
+        auto& parents = _entries[childIndex].parents;
+        if (std::find(parents.begin(), parents.end(), index) == parents.end()) parents.push_back(index);
+    }
+
+    _entries[index].children = std::move(children);
+}
+
+void BoundsCache::invalidate(const vsg::Node* node)
+{
+    auto itr = _indices.find(node);
+    if (itr == _indices.end()) return;
+
+    // the ancestors of a dirty entry are already dirty, so propagation stops at the first one found
+    std::vector<uint32_t> pending{itr->second};
+    while (!pending.empty())
+    {
+        auto index = pending.back();
+        pending.pop_back();
+
+        auto& entry = _entries[index];
+        if (entry.dirty) continue;
+
+        entry.dirty = true;
+        ++numInvalidated;
+        pending.insert(pending.end(), entry.parents.begin(), entry.parents.end());
+    }
+}
+
+void BoundsCache::childrenChanged(vsg::Node* node)
+{
+    auto itr = _indices.find(node);
+    if (itr == _indices.end()) return;
+
+    auto index = itr->second;
+    for (auto child : _entries[index].children)
+    {
+        auto& parents = _entries[child].parents;
+        parents.erase(std::remove(parents.begin(), parents.end(), index), parents.end());
+    }
+
+    _collectChildren(index);
+
+    // force the invalidation through to the ancestors even when the entry is already dirty
+    _entries[index].dirty = false;
+    invalidate(node);
+}
+
+vsg::dbox BoundsCache::bounds(const vsg::Node* node)
+{
+    auto itr = _indices.find(node);
+    if (itr == _indices.end()) return {};
+    return _recompute(itr->second);
+}
+
+const vsg::dbox& BoundsCache::_recompute(uint32_t index)
+{
+    if (!_entries[index].dirty) return _entries[index].bounds;
+
+    vsg::dbox bounds;
+    if (_entries[index].interior)
+    {
+        // _recompute() doesn't add entries, so the references stay valid
+        auto& entry = _entries[index];
+        for (auto child : entry.children) bounds.add(_recompute(child));
+
+        if (auto transform = entry.node->cast<vsg::Transform>(); transform && bounds.valid())
+        {
+            auto matrix = transform->transform(vsg::dmat4());
+            vsg::dbox transformed;
+            for (int i = 0; i < 8; ++i)
+            {
+                transformed.add(matrix * vsg::dvec3((i & 1) ? bounds.max.x : bounds.min.x, (i & 2) ? bounds.max.y : bounds.min.y, (i & 4) ? bounds.max.z : bounds.min.z));
+            }
+            bounds = transformed;
+        }
+        else if (auto cullNode = entry.node->cast<vsg::CullNode>())
+        {
+            cullNode->bound = toSphere(bounds);
+        }
+        else if (auto cullGroup = entry.node->cast<vsg::CullGroup>())
+        {
+            cullGroup->bound = toSphere(bounds);
+        }
+    }
+    else
+    {
+        vsg::ComputeBounds computeBounds;
+        _entries[index].node->accept(computeBounds);
+        bounds = computeBounds.bounds;
+        ++numLeavesRecomputed;
+    }
+
+    auto& entry = _entries[index];
+    entry.bounds = bounds;
+    entry.dirty = false;
+    ++numRecomputed;
+    return entry.bounds;
+}
+
+void BoundsCache::report(std::ostream& out) const
+{
+    out << "BoundsCache numEntries = " << _entries.size() << ", numInvalidated = " << numInvalidated << ", numRecomputed = " << numRecomputed
+        << ", numLeavesRecomputed = " << numLeavesRecomputed << std::endl;
+}
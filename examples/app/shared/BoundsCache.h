@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <ostream>
+#include <unordered_map>
+
+// Caches the bounds of every node of a subgraph in the node's parent's coordinate frame, so that when a transform
+// moves or a leaf changes only it and its ancestors are recomputed, on the next query, rather than the whole subgraph.
+// Groups, LODs, Switches and CullNodes are combined from their children, Transforms applying their matrix to them, and
+// anything else is treated as a leaf whose bounds are computed with vsg::ComputeBounds. Nodes shared by several parents
+// have a single entry linked to each parent, invalidating it invalidates all of them.
+// CullNode and CullGroup bounds are updated from their children as they're recomputed, so calling update() once per
+// frame, before record, keeps culling of moving subgraphs correct.
+class BoundsCache : public vsg::Inherit<vsg::Object, BoundsCache>
+{
+public:
+    explicit BoundsCache(vsg::ref_ptr<vsg::Node> in_root);
+
+    vsg::ref_ptr<vsg::Node> root;
+
+    // mark the bounds of node, and so all its ancestors, as needing to be recomputed
+    void invalidate(const vsg::Node* node);
+
+    // re-read the children of node after they've been added or removed, then invalidate it
+    void childrenChanged(vsg::Node* node);
+
+    // bounds of node in its parent's coordinate frame, recomputing any invalidated nodes below it
+    vsg::dbox bounds(const vsg::Node* node);
+
+    // bounds of root, recomputing all the invalidated nodes
+    vsg::dbox update() { return bounds(root); }
+
+    // statistics
+    size_t numEntries() const { return _entries.size(); }
+    uint64_t numInvalidated = 0;
+    uint64_t numRecomputed = 0;
+    uint64_t numLeavesRecomputed = 0;
+
+    void report(std::ostream& out) const;
+
+protected:
+    struct Entry
+    {
+        vsg::Node* node = nullptr;
+        std::vector<uint32_t> parents;
+        std::vector<uint32_t> children; // empty for leaves
+        vsg::dbox bounds;
+        bool interior = false;
+        bool dirty = true;
+    };
+
+    uint32_t _add(vsg::Node* node);
+    void _collectChildren(uint32_t index);
+    const vsg::dbox& _recompute(uint32_t index);
+
+    std::vector<Entry> _entries;
+    std::unordered_map<const vsg::Node*, uint32_t> _indices;
+};
@@ -0,0 +1,78 @@
+#include "DeferredRelease.h"
+
+#include <chrono>
+
+DeferredRelease::DeferredRelease()
+{
+    _thread = std::thread([this]() { _run(); });
+}
+
+DeferredRelease::~DeferredRelease()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _flush(lock);
+        _done = true;
+    }
+    _queued.notify_all();
+    _thread.join();
+}
+
+void DeferredRelease::release(vsg::ref_ptr<vsg::Object> object)
+{
+    if (!object) return;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _current.push_back(std::move(object));
+    if (_current.size() >= batchSize) _flush(lock);
+}
+
+void DeferredRelease::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _flush(lock);
+}
+
+void DeferredRelease::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _flush(lock);
+    _idle.wait(lock, [this]() { return _queue.empty() && !_releasing; });
+}
+
+void DeferredRelease::_flush(std::unique_lock<std::mutex>&)
+{
+    if (_current.empty()) return;
+
+    _queue.push_back(std::move(_current));
+    _current = {};
+    _queued.notify_one();
+}
+
+void DeferredRelease::_run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _queued.wait(lock, [this]() { return _done || !_queue.empty(); });
+        if (_queue.empty()) break;
+
+        Batch batch = std::move(_queue.front());
+        _queue.pop_front();
+        _releasing = true;
+
+        // destroy outside the lock so release() never waits on a destruction
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        size_t count = batch.size();
+        batch.clear();
+        releaseTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        numReleased += count;
+        ++numBatches;
+
+        lock.lock();
+        _releasing = false;
+        if (_queue.empty()) _idle.notify_all();
+    }
+}
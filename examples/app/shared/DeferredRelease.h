@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vsg/core/Inherit.h>
+#include <vsg/core/Object.h>
+#include <vsg/core/ref_ptr.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Moves the destruction of objects off the calling thread. References handed to release() are collected into a batch,
+// and each flush(), or a batch reaching batchSize, passes the batch to a background thread that drops them. Where the
+// reference passed to release() is the last one the object, along with any subgraph only it references, is destroyed on
+// the background thread, so unloading a large subgraph costs the caller little more than a vector push_back.
+class DeferredRelease : public vsg::Inherit<vsg::Object, DeferredRelease>
+{
+public:
+    DeferredRelease();
+
+    // number of references collected before a batch is passed to the background thread without waiting for flush()
+    size_t batchSize = 256;
+
+    // thread safe, pass ownership with std::move() to avoid an extra reference count round trip
+    void release(vsg::ref_ptr<vsg::Object> object);
+
+    // pass the current batch to the background thread
+    void flush();
+
+    // flush and block until all the batches passed to the background thread have been destroyed
+    void wait();
+
+    // statistics
+    std::atomic_uint64_t numReleased{0};
+    std::atomic_uint64_t numBatches{0};
+    std::atomic_uint64_t releaseTime{0}; // nanoseconds spent destroying on the background thread
+
+protected:
+    virtual ~DeferredRelease();
+
+    using Batch = std::vector<vsg::ref_ptr<vsg::Object>>;
+
+    void _flush(std::unique_lock<std::mutex>& lock);
+    void _run();
+
+    std::mutex _mutex;
+    std::condition_variable _queued;
+    std::condition_variable _idle;
+    Batch _current;
+    std::deque<Batch> _queue;
+    bool _releasing = false;
+    bool _done = false;
+    std::thread _thread;
+};
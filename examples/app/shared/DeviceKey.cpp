@@ -0,0 +1,23 @@
+#include "DeviceKey.h"
+
+#include <iomanip>
+#include <sstream>
+
+std::string experimental::deviceKey(const vsg::Instance& instance, vsg::PhysicalDevice& physicalDevice)
+{
+    const auto& properties = physicalDevice.getProperties();
+
+    std::ostringstream key;
+    key << std::hex << std::setfill('0');
+    if (instance.apiVersion >= VK_API_VERSION_1_1 && properties.apiVersion >= VK_API_VERSION_1_1)
+    {
+        auto idProperties = physicalDevice.getProperties<VkPhysicalDeviceIDProperties, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES>();
+        for (auto c : idProperties.deviceUUID) key << std::setw(2) << static_cast<uint32_t>(c);
+    }
+    else
+    {
+        for (auto c : properties.pipelineCacheUUID) key << std::setw(2) << static_cast<uint32_t>(c);
+    }
+    key << "-" << std::setw(8) << properties.driverVersion;
+    return key.str();
+}
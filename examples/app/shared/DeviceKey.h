@@ -0,0 +1,13 @@
+#pragma once
+
+#include <vsg/vk/Instance.h>
+#include <vsg/vk/PhysicalDevice.h>
+
+#include <string>
+
+namespace experimental
+{
+    // identify a physical device and its driver across runs, for keying results cached per device. Uses the device UUID,
+    // which needs vkGetPhysicalDeviceProperties2, otherwise the pipeline cache UUID, which also identifies the device and driver.
+    std::string deviceKey(const vsg::Instance& instance, vsg::PhysicalDevice& physicalDevice);
+} // namespace experimental
@@ -0,0 +1,473 @@
+#include "FrameTrace.h"
+#include "RecursionGuard.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+// Events are appended by one thread to the last chunk of its buffer, the count of each chunk is only increased after
+// the event has been written and a full chunk is only linked after it is constructed, so write() can read a buffer
+// while its thread carries on adding to it.
+struct FrameTrace::Buffer
+{
+    struct Chunk
+    {
+        static constexpr size_t capacity = 1024;
+
+        Event events[capacity];
+        std::atomic_size_t count{0};
+        std::atomic<Chunk*> next{nullptr};
+    };
+
+    Buffer(uint32_t in_threadID, const std::string& in_threadName) :
+        threadID(in_threadID),
+        threadName(in_threadName),
+        first(new Chunk),
+        last(first) {}
+
+    ~Buffer()
+    {
+        for (auto chunk = first; chunk;)
+        {
+            auto next = chunk->next.load();
+            delete chunk;
+            chunk = next;
+        }
+    }
+
+    const uint32_t threadID;
+    const std::string threadName;
+
+    Chunk* const first;
+    Chunk* last; // only accessed by the thread adding events
+
+    void add(Event&& event)
+    {
+        size_t count = last->count.load(std::memory_order_relaxed);
+        if (count == Chunk::capacity)
+        {
+            auto chunk = new Chunk;
+            last->next.store(chunk, std::memory_order_release);
+            last = chunk;
+            count = 0;
+        }
+
+        last->events[count] = std::move(event);
+        last->count.store(count + 1, std::memory_order_release);
+    }
+
+    template<typename F>
+    void for_each(F function) const
+    {
+        for (auto chunk = first; chunk; chunk = chunk->next.load(std::memory_order_acquire))
+        {
+            size_t count = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; ++i) function(chunk->events[i]);
+        }
+    }
+};
+
+// Timestamp queries around one CommandGraph. Each frame uses the next of numSlots query pools, whose previous results
+// are collected when it comes round again, by which time the frame that wrote them has completed. The GPU clock is
+// mapped to the trace's clock by the largest difference seen between a frame starting to record on the CPU and it
+// starting on the GPU, which can't be less than the true offset as the GPU can't start work before it is recorded.
+struct FrameTrace::GpuTimer
+{
+    static constexpr size_t numSlots = 8;
+
+    GpuTimer(Buffer& in_buffer, const char* in_name, double in_timestampPeriod) :
+        buffer(in_buffer),
+        name(in_name),
+        timestampPeriod(in_timestampPeriod)
+    {
+        for (auto& slot : slots)
+        {
+            slot.queryPool = vsg::QueryPool::create();
+            slot.queryPool->queryType = VK_QUERY_TYPE_TIMESTAMP;
+            slot.queryPool->queryCount = 2;
+        }
+    }
+
+    Buffer& buffer;
+    const char* name;
+    const double timestampPeriod; // nanoseconds per timestamp tick
+
+    struct Slot
+    {
+        vsg::ref_ptr<vsg::QueryPool> queryPool;
+        bool pending = false;
+        int64_t recordTime = 0;
+        uint64_t frame = 0;
+    };
+
+    std::mutex mutex;
+    Slot slots[numSlots];
+    size_t current = 0;
+    std::atomic<int64_t> offset{std::numeric_limits<int64_t>::min()};
+
+    void begin(FrameTrace& trace, vsg::CommandBuffer& commandBuffer)
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+
+        current = (current + 1) % numSlots;
+        auto& slot = slots[current];
+        if (slot.pending) collect(trace, slot);
+
+        slot.recordTime = trace.now();
+        slot.frame = trace.frameCount.load();
+
+        auto queryPool = slot.queryPool->vk(commandBuffer.deviceID);
+        vkCmdResetQueryPool(commandBuffer.vk(), queryPool, 0, 2);
+        vkCmdWriteTimestamp(commandBuffer.vk(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+
+    void end(vsg::CommandBuffer& commandBuffer)
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+
+        auto& slot = slots[current];
+        vkCmdWriteTimestamp(commandBuffer.vk(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.queryPool->vk(commandBuffer.deviceID), 1);
+        slot.pending = true;
+    }
+
+    void collect(FrameTrace& trace, Slot& slot)
+    {
+        slot.pending = false;
+
+        std::vector<uint64_t> timestamps(2);
+        if (slot.queryPool->getResults(timestamps) != VK_SUCCESS) return;
+
+        Event event;
+        event.name = name;
+        event.category = "gpu";
+        event.begin = static_cast<int64_t>(static_cast<double>(timestamps[0]) * timestampPeriod);
+        event.end = static_cast<int64_t>(static_cast<double>(timestamps[1]) * timestampPeriod);
+        event.frame = slot.frame;
+
+        int64_t sampleOffset = slot.recordTime - event.begin;
+        if (sampleOffset > offset.load()) offset = sampleOffset;
+
+        // the buffer is only added to by this timer, under its mutex
+        buffer.add(std::move(event));
+        ++trace.numEvents;
+    }
+};
+
+namespace
+{
+    std::atomic_uint64_t s_nextTraceID{0};
+
+    void writeString(std::ostream& out, const std::string& str)
+    {
+        out << '"';
+        for (auto c : str)
+        {
+            switch (c)
+            {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", c);
+                    out << code;
+                }
+                else
+                {
+                    out << c;
+                }
+            }
+        }
+        out << '"';
+    }
+
+    // Commands placed at the start and end of a CommandGraph to write its timestamps
+    class Timestamp : public vsg::Inherit<vsg::Command, Timestamp>
+    {
+    public:
+        Timestamp(FrameTrace* in_trace, FrameTrace::GpuTimer* in_timer, bool in_begin) :
+            trace(in_trace),
+            timer(in_timer),
+            begin(in_begin) {}
+
+        vsg::observer_ptr<FrameTrace> trace;
+        FrameTrace::GpuTimer* timer;
+        bool begin;
+
+        void compile(vsg::Context& context) override
+        {
+            if (begin)
+            {
+                for (auto& slot : timer->slots) slot.queryPool->compile(context);
+            }
+        }
+
+        void record(vsg::CommandBuffer& commandBuffer) const override
+        {
+            if (auto t = trace.ref_ptr())
+            {
+                if (begin) timer->begin(*t, commandBuffer);
+                else timer->end(commandBuffer);
+            }
+        }
+    };
+
+    class TraceReaderWriter : public vsg::Inherit<vsg::ReaderWriter, TraceReaderWriter>
+    {
+    public:
+        explicit TraceReaderWriter(FrameTrace* in_trace) :
+            trace(in_trace) {}
+
+        vsg::observer_ptr<FrameTrace> trace;
+
+        vsg::ref_ptr<vsg::Object> read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) const override
+        {
+            // vsg::read() calls back into this ReaderWriter, pass on it then
+            static thread_local bool reading = false;
+            RecursionGuard guard(reading);
+            if (!guard) return {};
+
+            auto t = trace.ref_ptr();
+            FrameTrace::Scope scope(t, "read", "load", filename.string());
+
+            return vsg::read(filename, options);
+        }
+    };
+} // namespace
+
+FrameTrace::FrameTrace(const vsg::Path& in_filename) :
+    filename(in_filename),
+    _id(++s_nextTraceID),
+    _startTime(vsg::clock::now())
+{
+    // the thread creating the trace is normally the one running the frame loop
+    _threadBuffer("main");
+}
+
+FrameTrace::~FrameTrace()
+{
+}
+
+vsg::ref_ptr<FrameTrace> FrameTrace::create_if_requested(vsg::CommandLine& arguments)
+{
+    auto traceFilename = arguments.value(std::string(), "--trace");
+    if (traceFilename.empty()) return {};
+    return FrameTrace::create(traceFilename);
+}
+
+int64_t FrameTrace::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(vsg::clock::now() - _startTime).count();
+}
+
+FrameTrace::Buffer& FrameTrace::_createBuffer(const std::string& name)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _buffers.emplace_back(new Buffer(static_cast<uint32_t>(_buffers.size() + 1), name));
+    return *_buffers.back();
+}
+
+FrameTrace::Buffer& FrameTrace::_threadBuffer(const char* category)
+{
+    // cache the calling thread's buffer so only its first event takes the mutex, keyed by id rather than address so a
+    // later FrameTrace allocated in the same place doesn't pick up a destroyed one's buffer
+    thread_local uint64_t t_traceID = 0;
+    thread_local Buffer* t_buffer = nullptr;
+    if (t_traceID == _id) return *t_buffer;
+
+    size_t numBuffers = 0;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        numBuffers = _buffers.size();
+    }
+
+    auto& buffer = _createBuffer(numBuffers == 0 ? std::string(category) : (std::string(category) + " thread " + std::to_string(numBuffers)));
+    t_traceID = _id;
+    t_buffer = &buffer;
+    return buffer;
+}
+
+void FrameTrace::add(Event&& event)
+{
+    _threadBuffer(event.category).add(std::move(event));
+    ++numEvents;
+}
+
+FrameTrace::Scope::Scope(FrameTrace* in_trace, const char* name, const char* category, std::string detail) :
+    _trace(in_trace)
+{
+    if (!_trace) return;
+
+    _event.name = name;
+    _event.category = category;
+    _event.detail = std::move(detail);
+    _event.frame = _trace->frameCount.load();
+    _event.begin = _trace->now();
+}
+
+FrameTrace::Scope::~Scope()
+{
+    if (!_trace) return;
+
+    _event.end = _trace->now();
+    _trace->add(std::move(_event));
+}
+
+FrameTrace::Frame::Frame(FrameTrace* in_trace, const vsg::FrameStamp* frameStamp) :
+    _trace(in_trace)
+{
+    if (!_trace) return;
+
+    if (frameStamp) _trace->frameCount = frameStamp->frameCount;
+
+    _frame.name = "frame";
+    _frame.category = "frame";
+    _frame.frame = _trace->frameCount.load();
+    _frame.begin = _trace->now();
+}
+
+FrameTrace::Frame::~Frame()
+{
+    if (!_trace) return;
+
+    phase(nullptr);
+
+    _frame.end = _trace->now();
+    _trace->add(std::move(_frame));
+}
+
+void FrameTrace::Frame::phase(const char* name)
+{
+    if (!_trace) return;
+
+    auto time = _trace->now();
+    if (*_phase.name != 0)
+    {
+        _phase.end = time;
+        _trace->add(std::move(_phase));
+        _phase = Event{};
+    }
+
+    if (name)
+    {
+        _phase.name = name;
+        _phase.category = "phase";
+        _phase.frame = _frame.frame;
+        _phase.begin = time;
+    }
+}
+
+vsg::ref_ptr<vsg::ReaderWriter> FrameTrace::createReaderWriter()
+{
+    return TraceReaderWriter::create(this);
+}
+
+void FrameTrace::addReaderWriter(vsg::Options& options)
+{
+    options.readerWriters.insert(options.readerWriters.begin(), createReaderWriter());
+}
+
+bool FrameTrace::addTimestamps(vsg::CommandGraph& commandGraph, const std::string& name)
+{
+    auto device = commandGraph.device;
+    if (!device && commandGraph.window) device = commandGraph.window->getOrCreateDevice();
+    if (!device) return false;
+
+    auto& limits = device->getPhysicalDevice()->getProperties().limits;
+    if (!limits.timestampComputeAndGraphics)
+    {
+        vsg::warn("FrameTrace device doesn't support timestamps, no GPU events will be recorded for ", name, ".");
+        return false;
+    }
+
+    auto& buffer = _createBuffer(name);
+
+    GpuTimer* timer = nullptr;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _gpuTimers.emplace_back(new GpuTimer(buffer, buffer.threadName.c_str(), limits.timestampPeriod));
+        timer = _gpuTimers.back().get();
+    }
+
+    commandGraph.children.insert(commandGraph.children.begin(), Timestamp::create(this, timer, true));
+    commandGraph.addChild(Timestamp::create(this, timer, false));
+    return true;
+}
+
+bool FrameTrace::write()
+{
+    std::vector<Buffer*> buffers;
+    std::vector<std::pair<Buffer*, int64_t>> gpuOffsets;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        for (auto& buffer : _buffers) buffers.push_back(buffer.get());
+        for (auto& timer : _gpuTimers) gpuOffsets.emplace_back(&timer->buffer, timer->offset.load());
+    }
+
+    std::ofstream fout(filename.string());
+    if (!fout)
+    {
+        vsg::warn("FrameTrace unable to write ", filename);
+        return false;
+    }
+
+    fout << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+    auto separator = [&]() {
+        if (!first) fout << ",";
+        fout << "\n";
+        first = false;
+    };
+
+    for (auto buffer : buffers)
+    {
+        separator();
+        fout << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadID << ",\"args\":{\"name\":";
+        writeString(fout, buffer->threadName);
+        fout << "}}";
+        separator();
+        fout << "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadID << ",\"args\":{\"sort_index\":" << buffer->threadID << "}}";
+
+        // GPU events are in device time, skip those from timers that haven't yet measured an offset
+        int64_t offset = 0;
+        auto itr = std::find_if(gpuOffsets.begin(), gpuOffsets.end(), [&](auto& gpuOffset) { return gpuOffset.first == buffer; });
+        if (itr != gpuOffsets.end())
+        {
+            if (itr->second == std::numeric_limits<int64_t>::min()) continue;
+            offset = itr->second;
+        }
+
+        buffer->for_each([&](const Event& event) {
+            separator();
+            fout << "{\"name\":";
+            writeString(fout, event.name);
+            fout << ",\"cat\":";
+            writeString(fout, event.category);
+            fout << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadID;
+            fout << ",\"ts\":" << static_cast<double>(event.begin + offset) * 1e-3 << ",\"dur\":" << static_cast<double>(event.end - event.begin) * 1e-3;
+            fout << ",\"args\":{\"frame\":" << event.frame;
+            if (!event.detail.empty())
+            {
+                fout << ",\"detail\":";
+                writeString(fout, event.detail);
+            }
+            fout << "}}";
+        });
+    }
+
+    fout << "\n]}\n";
+    return fout.good();
+}
+
+void FrameTrace::report(std::ostream& out) const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    out << "FrameTrace " << filename << " events = " << numEvents << ", threads = " << (_buffers.size() - _gpuTimers.size()) << ", GPU timers = " << _gpuTimers.size() << std::endl;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+// Timeline of what each thread and the GPU spent a run doing, written as a Chrome trace JSON file that can be opened in
+// chrome://tracing, ui.perfetto.dev, or Tracy after conversion with its import-chrome tool. Each thread appends its
+// events to its own buffer of fixed size chunks, so recording an event takes no lock and doesn't wait on write(), the
+// main loop is divided into phases with Frame, loads made through vsg::read() are recorded by the ReaderWriter from
+// createReaderWriter(), including those made by the DatabasePager threads, and addTimestamps() brackets a CommandGraph
+// with timestamp queries so its GPU time appears on its own track alongside the frames that recorded it.
+class FrameTrace : public vsg::Inherit<vsg::Object, FrameTrace>
+{
+public:
+    explicit FrameTrace(const vsg::Path& in_filename);
+    ~FrameTrace();
+
+    // returns a FrameTrace writing to the filename given by --trace, or null if it isn't on the command line
+    static vsg::ref_ptr<FrameTrace> create_if_requested(vsg::CommandLine& arguments);
+
+    const vsg::Path filename;
+
+    struct Event
+    {
+        const char* name = "";     // static string
+        const char* category = ""; // static string
+        std::string detail;        // optional, such as the filename of a load
+        int64_t begin = 0;         // nanoseconds since the FrameTrace was created, GPU events in device time until written
+        int64_t end = 0;
+        uint64_t frame = 0;
+    };
+
+    // record a completed event on the calling thread's buffer
+    void add(Event&& event);
+
+    // nanoseconds since the FrameTrace was created
+    int64_t now() const;
+
+    // the frame count that events are tagged with, set by Frame
+    std::atomic_uint64_t frameCount{0};
+
+    // records an event over its lifetime on the calling thread, does nothing if the trace is null
+    class Scope
+    {
+    public:
+        Scope(FrameTrace* in_trace, const char* name, const char* category, std::string detail = {});
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    protected:
+        FrameTrace* _trace;
+        Event _event;
+    };
+
+    // records a "frame" event over its lifetime, divided by calls to phase() into consecutive phase events, such as
+    // events, update, record and submit, and present. Does nothing if the trace is null.
+    class Frame
+    {
+    public:
+        Frame(FrameTrace* in_trace, const vsg::FrameStamp* frameStamp);
+        ~Frame();
+
+        // end the current phase, if any, and start the named one
+        void phase(const char* name);
+
+        Frame(const Frame&) = delete;
+        Frame& operator=(const Frame&) = delete;
+
+    protected:
+        FrameTrace* _trace;
+        Event _frame;
+        Event _phase;
+    };
+
+    // ReaderWriter that reads through the rest of Options::readerWriters, recording each read as a "load" event
+    vsg::ref_ptr<vsg::ReaderWriter> createReaderWriter();
+
+    // insert createReaderWriter() at the front of options.readerWriters
+    void addReaderWriter(vsg::Options& options);
+
+    // place timestamp queries at the start and end of commandGraph, call before Viewer::compile(). Returns false if
+    // the device doesn't support timestamps on all queues.
+    bool addTimestamps(vsg::CommandGraph& commandGraph, const std::string& name = "GPU");
+
+    // write the events recorded so far to filename, threads may carry on recording while it is written
+    bool write();
+
+    // statistics
+    std::atomic_uint64_t numEvents{0};
+
+    void report(std::ostream& out) const;
+
+    struct Buffer;
+    struct GpuTimer;
+
+protected:
+    Buffer& _threadBuffer(const char* category);
+    Buffer& _createBuffer(const std::string& name);
+
+    const uint64_t _id;
+    const vsg::clock::time_point _startTime;
+
+    mutable std::mutex _mutex;
+    std::deque<std::unique_ptr<Buffer>> _buffers;
+    std::deque<std::unique_ptr<GpuTimer>> _gpuTimers;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64 bit FNV-1a hashing of byte ranges, unlike std::hash it gives the same hash on every platform and run so it can key caches written to disk
+namespace experimental
+{
+    // FNV-1a offset basis, the hash of no bytes
+    constexpr uint64_t hashSeed = 14695981039346656037ull;
+
+    // fold size bytes at data into hash, pass the result of a previous call as hash to hash several ranges
+    inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = hashSeed)
+    {
+        auto ptr = static_cast<const uint8_t*>(data);
+        for (auto end = ptr + size; ptr != end; ++ptr)
+        {
+            hash ^= *ptr;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+} // namespace experimental
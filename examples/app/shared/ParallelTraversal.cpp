@@ -0,0 +1,66 @@
+#include "ParallelTraversal.h"
+
+#include <thread>
+
+using namespace experimental;
+
+size_t ParallelTraversal::estimateSubtreeSize(const vsg::Node& node)
+{
+    size_t size = 1;
+    size_t multiplier = 1;
+    const vsg::Node* current = &node;
+    while (current)
+    {
+        const vsg::Node* firstChild = nullptr;
+        size_t numChildren = 0;
+        if (auto group = current->cast<vsg::Group>(); group && !group->children.empty())
+        {
+            numChildren = group->children.size();
+            firstChild = group->children.front().get();
+        }
+        else if (auto quadGroup = current->cast<vsg::QuadGroup>())
+        {
+            numChildren = quadGroup->children.size();
+            firstChild = quadGroup->children.front().get();
+        }
+
+        if (numChildren == 0) break;
+
+        multiplier *= numChildren;
+        size += multiplier;
+        current = firstChild;
+    }
+    return size;
+}
+
+void experimental::runUntilReady(vsg::OperationThreads& operationThreads, vsg::Latch& latch)
+{
+    while (!latch.is_ready())
+    {
+        if (auto operation = operationThreads.queue->take()) operation->run();
+        else std::this_thread::yield();
+    }
+}
+
+void experimental::runTasks(vsg::OperationThreads* operationThreads, const std::vector<std::function<void()>>& tasks)
+{
+    if (!operationThreads || tasks.size() < 2)
+    {
+        for (auto& task : tasks) task();
+        return;
+    }
+
+    auto latch = vsg::Latch::create(static_cast<int>(tasks.size()));
+    for (size_t t = 1; t < tasks.size(); ++t)
+    {
+        operationThreads->add(FunctionOperation::create([&task = tasks[t], latch]() {
+            task();
+            latch->count_down();
+        }));
+    }
+
+    tasks[0]();
+    latch->count_down();
+
+    runUntilReady(*operationThreads, *latch);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <functional>
+#include <vector>
+
+namespace experimental
+{
+
+    // Operation that calls a std::function, for queuing lambdas on OperationThreads or as Viewer update operations
+    struct FunctionOperation : public vsg::Inherit<vsg::Operation, FunctionOperation>
+    {
+        explicit FunctionOperation(std::function<void()> in_function) :
+            function(std::move(in_function)) {}
+
+        std::function<void()> function;
+        void run() override { function(); }
+    };
+
+    // run queued operations until the latch is released, so that a thread waiting on tasks it queued can't exhaust the threads
+    void runUntilReady(vsg::OperationThreads& operationThreads, vsg::Latch& latch);
+
+    // run the tasks across operationThreads, returning once they have all completed. The calling thread runs tasks[0]
+    // and then other queued operations while it waits, without operationThreads the tasks are run in order on this thread.
+    void runTasks(vsg::OperationThreads* operationThreads, const std::vector<std::function<void()>>& tasks);
+
+    // Splits the traversal of a large group's children across vsg::OperationThreads, each subtree being traversed by a
+    // per task clone of the visitor which is merged back into the original once all the tasks have completed.
+    // Visitors opt in by calling traverse(group, *this) from their apply(Group&) and providing:
+    //     vsg::ref_ptr<V> clone() const;     // a visitor with the same settings and empty results
+    //     void merge(const V& other);        // accumulate another visitor's results
+    // Clones may split their own subtrees in turn, a thread waiting for its tasks runs queued tasks rather than blocking.
+    class ParallelTraversal : public vsg::Inherit<vsg::Object, ParallelTraversal>
+    {
+    public:
+        explicit ParallelTraversal(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads, size_t in_minSubtreeSize = 10000) :
+            operationThreads(in_operationThreads),
+            minSubtreeSize(in_minSubtreeSize)
+        {
+        }
+
+        vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+
+        // groups with estimated subtrees smaller than this are left to the caller to traverse serially
+        size_t minSubtreeSize = 10000;
+
+        // number of tasks to split a group's children into per thread, more tasks balance uneven subtrees better
+        size_t tasksPerThread = 4;
+
+        // estimate the number of nodes in the subtree by following the first child at each level, O(depth) so cheap to call per group.
+        static size_t estimateSubtreeSize(const vsg::Node& node);
+
+        // traverse group's children in parallel, returns false without traversing if the subtree isn't large enough.
+        template<class G, class V>
+        bool traverse(G& group, V& visitor)
+        {
+            size_t numChildren = group.children.size();
+            if (!operationThreads || numChildren < 2 || estimateSubtreeSize(group) < minSubtreeSize) return false;
+
+            size_t numTasks = std::min(numChildren, std::max(operationThreads->threads.size(), size_t(1)) * std::max(tasksPerThread, size_t(1)));
+            std::vector<vsg::ref_ptr<V>> clones(numTasks);
+            std::vector<std::function<void()>> tasks(numTasks);
+
+            for (size_t t = 0; t < numTasks; ++t)
+            {
+                clones[t] = visitor.clone();
+
+                size_t begin = (numChildren * t) / numTasks;
+                size_t end = (numChildren * (t + 1)) / numTasks;
+                tasks[t] = [&group, clone = clones[t], begin, end]() {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        if (group.children[i]) group.children[i]->accept(*clone);
+                    }
+                };
+            }
+
+            runTasks(operationThreads.get(), tasks);
+
+            for (auto& clone : clones) visitor.merge(*clone);
+            return true;
+        }
+    };
+
+} // namespace experimental
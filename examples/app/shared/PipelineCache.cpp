@@ -0,0 +1,369 @@
+#include "PipelineCache.h"
+#include "AtomicSave.h"
+#include "RecursionGuard.h"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+PipelineCache::PipelineCache(const vsg::Path& in_directory) :
+    directory(in_directory)
+{
+}
+
+PipelineCache::~PipelineCache()
+{
+    for (auto& [deviceID, deviceCache] : _deviceCaches)
+    {
+        if (deviceCache.cache) vkDestroyPipelineCache(*deviceCache.device, deviceCache.cache, deviceCache.device->getAllocationCallbacks());
+    }
+}
+
+vsg::Path PipelineCache::filename(vsg::Device* device) const
+{
+    auto& properties = device->getPhysicalDevice()->getProperties();
+
+    std::ostringstream uuid;
+    for (auto byte : properties.pipelineCacheUUID) uuid << std::hex << std::setw(2) << std::setfill('0') << static_cast<uint32_t>(byte);
+
+    return directory / vsg::make_string("pipelines_", std::hex, properties.vendorID, "_", properties.deviceID, "_", properties.driverVersion, "_", uuid.str(), ".bin");
+}
+
+PipelineCache::DeviceCache& PipelineCache::deviceCache(vsg::Device* device)
+{
+    auto& deviceCache = _deviceCaches[device->deviceID];
+    if (deviceCache.cache) return deviceCache;
+
+    deviceCache.device = device;
+
+    // only pass on blobs written for this device and driver, the driver should reject others but not all do so gracefully
+    std::vector<char> blob;
+    std::ifstream fin(filename(device).string(), std::ios::in | std::ios::binary);
+    if (fin)
+    {
+        blob.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+
+        auto& properties = device->getPhysicalDevice()->getProperties();
+        VkPipelineCacheHeaderVersionOne header;
+        if (blob.size() < sizeof(header))
+        {
+            blob.clear();
+        }
+        else
+        {
+            std::memcpy(&header, blob.data(), sizeof(header));
+            if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || header.vendorID != properties.vendorID || header.deviceID != properties.deviceID ||
+                std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+            {
+                vsg::info("PipelineCache: ignoring stale cache ", filename(device));
+                blob.clear();
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = blob.size();
+    createInfo.pInitialData = blob.empty() ? nullptr : blob.data();
+
+    if (vkCreatePipelineCache(*device, &createInfo, device->getAllocationCallbacks(), &deviceCache.cache) != VK_SUCCESS)
+    {
+        // an initial blob that the driver can't take shouldn't stop an empty cache from being created
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        blob.clear();
+        if (vkCreatePipelineCache(*device, &createInfo, device->getAllocationCallbacks(), &deviceCache.cache) != VK_SUCCESS)
+        {
+            throw vsg::Exception{"Error: PipelineCache failed to create VkPipelineCache."};
+        }
+    }
+
+    loadedSize += blob.size();
+    return deviceCache;
+}
+
+void PipelineCache::enableCreationFeedback(vsg::Device* device)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    deviceCache(device).creationFeedback = true;
+}
+
+VkPipelineCache PipelineCache::getOrCreate(vsg::Device* device)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return deviceCache(device).cache;
+}
+
+VkPipeline PipelineCache::createPipeline(vsg::Context& context, VkGraphicsPipelineCreateInfo& pipelineInfo)
+{
+    auto device = context.device.get();
+
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    bool creationFeedback = false;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        auto& dc = deviceCache(device);
+        cache = dc.cache;
+        creationFeedback = dc.creationFeedback;
+    }
+
+    VkPipelineCreationFeedbackEXT feedback = {};
+    std::vector<VkPipelineCreationFeedbackEXT> stageFeedbacks(pipelineInfo.stageCount);
+    VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo = {};
+    if (creationFeedback)
+    {
+        feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+        feedbackInfo.pNext = pipelineInfo.pNext;
+        feedbackInfo.pPipelineCreationFeedback = &feedback;
+        feedbackInfo.pipelineStageCreationFeedbackCount = pipelineInfo.stageCount;
+        feedbackInfo.pPipelineStageCreationFeedbacks = stageFeedbacks.data();
+        pipelineInfo.pNext = &feedbackInfo;
+    }
+
+    auto startTime = vsg::clock::now();
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = vkCreateGraphicsPipelines(*device, cache, 1, &pipelineInfo, device->getAllocationCallbacks(), &pipeline);
+
+    createTime += std::chrono::duration_cast<std::chrono::nanoseconds>(vsg::clock::now() - startTime).count();
+    if (creationFeedback) pipelineInfo.pNext = feedbackInfo.pNext;
+
+    if (result != VK_SUCCESS)
+    {
+        throw vsg::Exception{"Error: PipelineCache failed to create VkPipeline.", result};
+    }
+
+    ++numPipelines;
+    if (!creationFeedback || (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) == 0)
+        ++numWithoutFeedback;
+    else if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)
+        ++numCacheHits;
+
+    return pipeline;
+}
+
+bool PipelineCache::save()
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    if (!_deviceCaches.empty()) vsg::makeDirectory(directory);
+
+    bool success = true;
+    savedSize = 0;
+    for (auto& [deviceID, deviceCache] : _deviceCaches)
+    {
+        size_t size = 0;
+        if (vkGetPipelineCacheData(*deviceCache.device, deviceCache.cache, &size, nullptr) != VK_SUCCESS || size == 0) continue;
+
+        std::vector<char> blob(size);
+        if (vkGetPipelineCacheData(*deviceCache.device, deviceCache.cache, &size, blob.data()) != VK_SUCCESS) continue;
+
+        // write through a temporary file so that an interrupted save can't leave a truncated cache behind
+        auto cacheFilename = filename(deviceCache.device);
+        bool saved = experimental::atomicSave(cacheFilename, [&](const vsg::Path& tempFilename) {
+            std::ofstream fout(tempFilename.string(), std::ios::out | std::ios::binary);
+            fout.write(blob.data(), static_cast<std::streamsize>(size));
+            fout.close();
+            return !fout.fail();
+        });
+        if (!saved)
+        {
+            vsg::warn("PipelineCache: unable to write ", cacheFilename);
+            success = false;
+            continue;
+        }
+        savedSize += size;
+    }
+    return success;
+}
+
+void PipelineCache::report(std::ostream& out) const
+{
+    unsigned int numWithFeedback = numPipelines - numWithoutFeedback;
+    out << "Pipeline cache " << directory << std::endl;
+    out << "    loaded " << loadedSize << " bytes, saved " << savedSize << " bytes" << std::endl;
+    out << "    " << numPipelines << " pipelines created in " << static_cast<double>(createTime) * 1e-6 << "ms" << std::endl;
+    if (numWithFeedback > 0)
+    {
+        out << "    cache hits " << numCacheHits << " of " << numWithFeedback << " (" << (100.0 * numCacheHits / numWithFeedback) << "%)" << std::endl;
+    }
+    if (numWithoutFeedback > 0)
+    {
+        out << "    " << numWithoutFeedback << " pipelines without VK_EXT_pipeline_creation_feedback, hits unknown" << std::endl;
+    }
+}
+
+void PipelineCache::pruneReplacements()
+{
+    for (auto itr = _replacements.begin(); itr != _replacements.end();)
+    {
+        if (!itr->second.original || !itr->second.replacement) itr = _replacements.erase(itr);
+        else ++itr;
+    }
+}
+
+class InjectPipelineCache : public vsg::Inherit<vsg::Visitor, InjectPipelineCache>
+{
+public:
+    explicit InjectPipelineCache(PipelineCache* in_pipelineCache) :
+        pipelineCache(in_pipelineCache) {}
+
+    PipelineCache* pipelineCache;
+    std::set<vsg::Object*> visited;
+
+    vsg::ref_ptr<vsg::BindGraphicsPipeline> replace(vsg::BindGraphicsPipeline* bindGraphicsPipeline)
+    {
+        if (bindGraphicsPipeline->is_compatible(typeid(CachedBindGraphicsPipeline))) return vsg::ref_ptr<vsg::BindGraphicsPipeline>(bindGraphicsPipeline);
+
+        // keep the replacements shared where the originals were
+        std::scoped_lock<std::mutex> lock(pipelineCache->_mutex);
+        auto& entry = pipelineCache->_replacements[bindGraphicsPipeline];
+
+        // an entry whose original has gone is stale, another BindGraphicsPipeline may have been allocated at the same address
+        if (entry.original.ref_ptr().get() != bindGraphicsPipeline)
+        {
+            entry.original = bindGraphicsPipeline;
+            entry.replacement = {};
+        }
+
+        auto replacement = entry.replacement.ref_ptr();
+        if (!replacement)
+        {
+            replacement = CachedBindGraphicsPipeline::create(bindGraphicsPipeline->pipeline, vsg::ref_ptr<PipelineCache>(pipelineCache));
+            entry.replacement = replacement;
+        }
+        return replacement;
+    }
+
+    void apply(vsg::Node& node) override
+    {
+        if (visited.insert(&node).second) node.traverse(*this);
+    }
+
+    void apply(vsg::StateGroup& stateGroup) override
+    {
+        if (!visited.insert(&stateGroup).second) return;
+
+        for (auto& stateCommand : stateGroup.stateCommands)
+        {
+            if (auto bindGraphicsPipeline = stateCommand->cast<vsg::BindGraphicsPipeline>()) stateCommand = replace(bindGraphicsPipeline);
+        }
+        stateGroup.traverse(*this);
+    }
+
+    void apply(vsg::Commands& commands) override
+    {
+        if (!visited.insert(&commands).second) return;
+
+        for (auto& command : commands.children)
+        {
+            if (auto bindGraphicsPipeline = command->cast<vsg::BindGraphicsPipeline>()) command = replace(bindGraphicsPipeline);
+        }
+    }
+};
+
+void PipelineCache::inject(vsg::Node& node)
+{
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        pruneReplacements();
+    }
+
+    auto injectPipelineCache = InjectPipelineCache::create(this);
+    node.accept(*injectPipelineCache);
+}
+
+// ReaderWriter that reads through the rest of the Options::readerWriters and injects the pipeline cache into the result
+class PipelineCacheReaderWriter : public vsg::Inherit<vsg::ReaderWriter, PipelineCacheReaderWriter>
+{
+public:
+    explicit PipelineCacheReaderWriter(vsg::ref_ptr<PipelineCache> in_pipelineCache) :
+        pipelineCache(in_pipelineCache) {}
+
+    vsg::ref_ptr<PipelineCache> pipelineCache;
+
+    vsg::ref_ptr<vsg::Object> read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) const override
+    {
+        // vsg::read() calls back into this ReaderWriter, pass on it then
+        static thread_local bool reading = false;
+        vsg::ref_ptr<vsg::Object> object;
+        {
+            RecursionGuard guard(reading);
+            if (!guard) return {};
+            object = vsg::read(filename, options);
+        }
+
+        if (auto node = object.cast<vsg::Node>()) pipelineCache->inject(*node);
+        return object;
+    }
+};
+
+vsg::ref_ptr<vsg::ReaderWriter> PipelineCache::createReaderWriter()
+{
+    return PipelineCacheReaderWriter::create(vsg::ref_ptr<PipelineCache>(this));
+}
+
+CachedBindGraphicsPipeline::CachedBindGraphicsPipeline(vsg::ref_ptr<vsg::GraphicsPipeline> in_pipeline, vsg::ref_ptr<PipelineCache> in_pipelineCache) :
+    Inherit(in_pipeline),
+    pipelineCache(in_pipelineCache)
+{
+}
+
+CachedBindGraphicsPipeline::~CachedBindGraphicsPipeline()
+{
+    for (auto& implementation : _implementations)
+    {
+        if (implementation.pipeline) vkDestroyPipeline(*implementation.device, implementation.pipeline, implementation.device->getAllocationCallbacks());
+    }
+}
+
+void CachedBindGraphicsPipeline::compile(vsg::Context& context)
+{
+    if (context.viewID >= _implementations.size()) _implementations.resize(context.viewID + 1);
+
+    auto& implementation = _implementations[context.viewID];
+    if (implementation.pipeline) return;
+
+    // mirrors GraphicsPipeline::compile(), with the VkPipeline created through the cache
+    pipeline->layout->compile(context);
+    for (auto& shaderStage : pipeline->stages) shaderStage->compile(context);
+
+    vsg::GraphicsPipelineStates combinedPipelineStates;
+    combinedPipelineStates.insert(combinedPipelineStates.end(), context.defaultPipelineStates.begin(), context.defaultPipelineStates.end());
+    combinedPipelineStates.insert(combinedPipelineStates.end(), pipeline->pipelineStates.begin(), pipeline->pipelineStates.end());
+    combinedPipelineStates.insert(combinedPipelineStates.end(), context.overridePipelineStates.begin(), context.overridePipelineStates.end());
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = pipeline->layout->vk(context.deviceID);
+    pipelineInfo.renderPass = *context.renderPass;
+    pipelineInfo.subpass = pipeline->subpass;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    auto shaderStageCreateInfo = context.scratchMemory->allocate<VkPipelineShaderStageCreateInfo>(pipeline->stages.size());
+    for (size_t i = 0; i < pipeline->stages.size(); ++i)
+    {
+        pipeline->stages[i]->apply(context, shaderStageCreateInfo[i]);
+    }
+    pipelineInfo.stageCount = static_cast<uint32_t>(pipeline->stages.size());
+    pipelineInfo.pStages = shaderStageCreateInfo;
+
+    for (auto& pipelineState : combinedPipelineStates)
+    {
+        pipelineState->apply(context, pipelineInfo);
+    }
+
+    implementation.pipeline = pipelineCache->createPipeline(context, pipelineInfo);
+    implementation.device = context.device;
+
+    context.scratchMemory->release();
+}
+
+void CachedBindGraphicsPipeline::record(vsg::CommandBuffer& commandBuffer) const
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _implementations[commandBuffer.viewID].pipeline);
+    commandBuffer.setCurrentPipelineLayout(pipeline->layout);
+}
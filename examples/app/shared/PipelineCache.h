@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <ostream>
+
+// Persistent VkPipelineCache shared by the main thread and the DatabasePager's compile threads. A cache is created
+// for each Device on first use, seeded from the blob saved in directory for the device's vendor, device ID, driver
+// version and pipelineCacheUUID, and written back by save(). Blobs whose header doesn't match the device are ignored.
+// The VSG creates its VkPipelines without a cache, so inject() replaces the BindGraphicsPipeline of a subgraph with
+// CachedBindGraphicsPipeline which creates them through the cache, and createReaderWriter() does the same for every
+// subgraph loaded later, such as PagedLOD tiles.
+class PipelineCache : public vsg::Inherit<vsg::Object, PipelineCache>
+{
+public:
+    explicit PipelineCache(const vsg::Path& in_directory);
+
+    const vsg::Path directory;
+
+    // call for devices that have been created with VK_EXT_pipeline_creation_feedback enabled so cache hits can be counted
+    void enableCreationFeedback(vsg::Device* device);
+
+    // thread safe, the returned VkPipelineCache is internally synchronized by the driver
+    VkPipelineCache getOrCreate(vsg::Device* device);
+
+    void inject(vsg::Node& node);
+
+    // add to the front of Options::readerWriters so that everything read with the options is injected
+    vsg::ref_ptr<vsg::ReaderWriter> createReaderWriter();
+
+    // write the cache of each device back to directory, returns false if any failed
+    bool save();
+
+    // called by CachedBindGraphicsPipeline
+    VkPipeline createPipeline(vsg::Context& context, VkGraphicsPipelineCreateInfo& pipelineInfo);
+
+    // statistics
+    std::atomic_uint numPipelines{0};
+    std::atomic_uint numCacheHits{0};
+    std::atomic_uint numWithoutFeedback{0};
+    std::atomic_uint64_t createTime{0}; // nanoseconds spent in vkCreateGraphicsPipelines
+    VkDeviceSize loadedSize = 0;
+    VkDeviceSize savedSize = 0;
+
+    void report(std::ostream& out) const;
+
+protected:
+    virtual ~PipelineCache();
+
+    struct DeviceCache
+    {
+        vsg::ref_ptr<vsg::Device> device;
+        VkPipelineCache cache = VK_NULL_HANDLE;
+        bool creationFeedback = false;
+    };
+
+    vsg::Path filename(vsg::Device* device) const;
+    DeviceCache& deviceCache(vsg::Device* device);
+
+    std::mutex _mutex;
+    std::map<uint32_t, DeviceCache> _deviceCaches; // keyed by Device::deviceID
+
+    // the replacement made for each BindGraphicsPipeline, so that they stay shared where the originals were. Both are
+    // observed rather than referenced so the map doesn't keep replaced state alive, the replacements reference the
+    // PipelineCache, and entries whose original or replacement has been deleted are pruned by inject().
+    struct Replacement
+    {
+        vsg::observer_ptr<vsg::BindGraphicsPipeline> original;
+        vsg::observer_ptr<vsg::BindGraphicsPipeline> replacement;
+    };
+
+    friend class InjectPipelineCache;
+    std::map<const vsg::BindGraphicsPipeline*, Replacement> _replacements;
+
+    void pruneReplacements();
+};
+
+// BindGraphicsPipeline that creates its VkPipeline through a PipelineCache rather than with GraphicsPipeline::compile()
+class CachedBindGraphicsPipeline : public vsg::Inherit<vsg::BindGraphicsPipeline, CachedBindGraphicsPipeline>
+{
+public:
+    CachedBindGraphicsPipeline(vsg::ref_ptr<vsg::GraphicsPipeline> in_pipeline, vsg::ref_ptr<PipelineCache> in_pipelineCache);
+
+    vsg::ref_ptr<PipelineCache> pipelineCache;
+
+    void compile(vsg::Context& context) override;
+    void record(vsg::CommandBuffer& commandBuffer) const override;
+
+protected:
+    virtual ~CachedBindGraphicsPipeline();
+
+    struct Implementation
+    {
+        vsg::ref_ptr<vsg::Device> device;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+    };
+
+    std::vector<Implementation> _implementations; // indexed by viewID
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+// Scoped guard for a ReaderWriter that reads through vsg::read(), which calls back into the same ReaderWriter. The
+// first guard on the flag sets it and clears it again on destruction, even if the read throws, so that reads within
+// its scope can test the guard and pass them on.
+//
+//     static thread_local bool reading = false;
+//     RecursionGuard guard(reading);
+//     if (!guard) return {};
+class RecursionGuard
+{
+public:
+    explicit RecursionGuard(bool& in_flag) :
+        _flag(in_flag),
+        _entered(!in_flag)
+    {
+        _flag = true;
+    }
+
+    ~RecursionGuard()
+    {
+        if (_entered) _flag = false;
+    }
+
+    RecursionGuard(const RecursionGuard&) = delete;
+    RecursionGuard& operator=(const RecursionGuard&) = delete;
+
+    // false when constructed within the scope of another guard on the same flag
+    explicit operator bool() const { return _entered; }
+
+protected:
+    bool& _flag;
+    bool _entered;
+};
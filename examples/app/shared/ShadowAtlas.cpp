@@ -0,0 +1,477 @@
+#include "ShadowAtlas.h"
+#include "AssignDescriptorSet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+
+namespace
+{
+    // replaces each StateGroup's BindGraphicsPipeline with a StateSwitch that selects a depth only variant of the pipeline for the shadow Views
+    class InsertShadowPipelines : public vsg::Inherit<vsg::Visitor, InsertShadowPipelines>
+    {
+    public:
+        InsertShadowPipelines(vsg::Mask in_mainMask, vsg::Mask in_shadowMask, float in_depthBiasConstantFactor, float in_depthBiasSlopeFactor) :
+            mainMask(in_mainMask),
+            shadowMask(in_shadowMask),
+            depthBiasConstantFactor(in_depthBiasConstantFactor),
+            depthBiasSlopeFactor(in_depthBiasSlopeFactor)
+        {
+        }
+
+        vsg::Mask mainMask;
+        vsg::Mask shadowMask;
+        float depthBiasConstantFactor;
+        float depthBiasSlopeFactor;
+        size_t numVariants = 0;
+
+        void apply(vsg::Node& node) override
+        {
+            if (_visited.insert(&node).second) node.traverse(*this);
+        }
+
+        void apply(vsg::StateGroup& stateGroup) override
+        {
+            if (!_visited.insert(&stateGroup).second) return;
+
+            for (auto& stateCommand : stateGroup.stateCommands)
+            {
+                auto bindGraphicsPipeline = stateCommand.cast<vsg::BindGraphicsPipeline>();
+                if (!bindGraphicsPipeline || !bindGraphicsPipeline->pipeline) continue;
+
+                auto& stateSwitch = _stateSwitches[bindGraphicsPipeline.get()];
+                if (!stateSwitch)
+                {
+                    stateSwitch = vsg::StateSwitch::create();
+                    stateSwitch->slot = bindGraphicsPipeline->slot;
+                    stateSwitch->add(mainMask, bindGraphicsPipeline);
+                    stateSwitch->add(shadowMask, vsg::BindGraphicsPipeline::create(createDepthOnly(*bindGraphicsPipeline->pipeline)));
+                    ++numVariants;
+                }
+                stateCommand = stateSwitch;
+            }
+
+            stateGroup.traverse(*this);
+        }
+
+        vsg::ref_ptr<vsg::GraphicsPipeline> createDepthOnly(const vsg::GraphicsPipeline& pipeline)
+        {
+            // without a fragment stage only depth is written, the color blend state is kept as the atlas RenderPass has an unused color attachment
+            vsg::ShaderStages stages;
+            for (auto& stage : pipeline.stages)
+            {
+                if (stage->stage != VK_SHADER_STAGE_FRAGMENT_BIT) stages.push_back(stage);
+            }
+
+            auto pipelineStates = pipeline.pipelineStates;
+            for (auto& pipelineState : pipelineStates)
+            {
+                if (auto rasterizationState = pipelineState.cast<vsg::RasterizationState>())
+                {
+                    auto biasedRasterizationState = vsg::RasterizationState::create(*rasterizationState);
+                    biasedRasterizationState->depthBiasEnable = VK_TRUE;
+                    biasedRasterizationState->depthBiasConstantFactor = depthBiasConstantFactor;
+                    biasedRasterizationState->depthBiasSlopeFactor = depthBiasSlopeFactor;
+                    pipelineState = biasedRasterizationState;
+                }
+            }
+
+            return vsg::GraphicsPipeline::create(pipeline.layout, stages, pipelineStates, pipeline.subpass);
+        }
+
+    protected:
+        std::set<vsg::Object*> _visited;
+        std::map<vsg::BindGraphicsPipeline*, vsg::ref_ptr<vsg::StateSwitch>> _stateSwitches;
+    };
+
+    vsg::dmat4 tileTransform(const VkRect2D& tile, uint32_t atlasSize)
+    {
+        // clip coordinates to the tile's texture coordinates, depth is unchanged
+        double scale = 0.5 * static_cast<double>(tile.extent.width) / static_cast<double>(atlasSize);
+        double x = (static_cast<double>(tile.offset.x) + 0.5 * static_cast<double>(tile.extent.width)) / static_cast<double>(atlasSize);
+        double y = (static_cast<double>(tile.offset.y) + 0.5 * static_cast<double>(tile.extent.height)) / static_cast<double>(atlasSize);
+        return vsg::translate(x, y, 0.0) * vsg::scale(scale, scale, 1.0);
+    }
+
+    vsg::dvec3 upVector(const vsg::dvec3& direction)
+    {
+        return std::abs(direction.z) > 0.9 ? vsg::dvec3(0.0, 1.0, 0.0) : vsg::dvec3(0.0, 0.0, 1.0);
+    }
+} // namespace
+
+ShadowAtlas::ShadowAtlas(uint32_t in_atlasSize, uint32_t in_tileSize, uint32_t in_numCascades) :
+    atlasSize(in_atlasSize),
+    tileSize(std::min(in_tileSize, in_atlasSize)),
+    numCascades(std::min(in_numCascades, maxCascades)),
+    _shadowData(ShadowDataValue::create())
+{
+    _shadowData->properties.dataVariance = vsg::DYNAMIC_DATA;
+    descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings());
+}
+
+vsg::DescriptorSetLayoutBindings ShadowAtlas::descriptorBindings() const
+{
+    return vsg::DescriptorSetLayoutBindings{
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}, // shadowAtlas
+        {1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}          // ShadowData
+    };
+}
+
+bool ShadowAtlas::assignShaderSets(vsg::ref_ptr<vsg::Options> options)
+{
+    const char* bindingNames[] = {"shadowAtlas", "shadowData"};
+    auto bindings = descriptorBindings();
+
+    auto shadowed = [&](vsg::ref_ptr<vsg::ShaderSet> shaderSet, const vsg::Path& fragmentShaderFilename) -> bool {
+        // the built in shaders don't sample the shadow atlas so use the ones in vsgExamples/data
+        auto fragmentShader = vsg::read_cast<vsg::ShaderStage>(fragmentShaderFilename, options);
+        if (!shaderSet || !fragmentShader) return false;
+
+        for (auto& stage : shaderSet->stages)
+        {
+            if (stage->stage == VK_SHADER_STAGE_FRAGMENT_BIT) stage = fragmentShader;
+        }
+
+        for (auto& binding : bindings)
+        {
+            shaderSet->addDescriptorBinding(bindingNames[binding.binding], "VSG_SHADOW_ATLAS", shadowDescriptorSet, binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags, {});
+        }
+
+        if (!shaderSet->defaultShaderHints) shaderSet->defaultShaderHints = vsg::ShaderCompileSettings::create();
+        shaderSet->defaultShaderHints->defines.insert("VSG_SHADOW_ATLAS");
+        return true;
+    };
+
+    auto phongShaderSet = vsg::createPhongShaderSet(options);
+    auto pbrShaderSet = vsg::createPhysicsBasedRenderingShaderSet(options);
+    if (!shadowed(phongShaderSet, "shaders/standard_phong.frag") || !shadowed(pbrShaderSet, "shaders/standard_pbr.frag")) return false;
+
+    options->shaderSets["phong"] = phongShaderSet;
+    options->shaderSets["pbr"] = pbrShaderSet;
+    return true;
+}
+
+bool ShadowAtlas::addSpotLight(vsg::ref_ptr<vsg::SpotLight> light)
+{
+    uint32_t numTiles = tilesPerRow() * tilesPerRow();
+    if (_spotLights.size() >= maxSpotShadows || numCascades + _spotLights.size() >= numTiles) return false;
+
+    _spotLights.push_back(light);
+    return true;
+}
+
+vsg::ref_ptr<vsg::Node> ShadowAtlas::createCommands(vsg::Context& context, vsg::ref_ptr<vsg::Node> scene)
+{
+    auto device = context.device;
+
+    auto bounds = vsg::visit<vsg::ComputeBounds>(scene).bounds;
+    _sceneBound.center = (bounds.min + bounds.max) * 0.5;
+    _sceneBound.radius = vsg::length(bounds.max - bounds.min) * 0.5;
+
+    VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+    auto depthImage = vsg::Image::create();
+    depthImage->imageType = VK_IMAGE_TYPE_2D;
+    depthImage->extent = VkExtent3D{atlasSize, atlasSize, 1};
+    depthImage->mipLevels = 1;
+    depthImage->arrayLayers = 1;
+    depthImage->samples = VK_SAMPLE_COUNT_1_BIT;
+    depthImage->format = depthFormat;
+    depthImage->tiling = VK_IMAGE_TILING_OPTIMAL;
+    depthImage->usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    depthImage->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthImage->flags = 0;
+    depthImage->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    auto depthImageView = vsg::createImageView(context, depthImage, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    // linear filtering of a compare sampler gives a bilinear weighted shadow test, the VSG's reverse depth puts the nearest caster at the largest depth
+    auto shadowSampler = vsg::Sampler::create();
+    shadowSampler->magFilter = VK_FILTER_LINEAR;
+    shadowSampler->minFilter = VK_FILTER_LINEAR;
+    shadowSampler->mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    shadowSampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    shadowSampler->addressModeV = shadowSampler->addressModeU;
+    shadowSampler->addressModeW = shadowSampler->addressModeU;
+    shadowSampler->compareEnable = VK_TRUE;
+    shadowSampler->compareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+    shadowSampler->maxLod = 0.0f;
+
+    // the tiles not rendered in a frame keep their contents, so the atlas is loaded and stored and stays readable outside the RenderPass
+    vsg::RenderPass::Attachments attachments(1);
+    attachments[0].format = depthFormat;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    // an unused color attachment keeps the subpass compatible with the scene's pipelines, which are compiled for every View they are under
+    vsg::AttachmentReference colorReference = {VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    vsg::AttachmentReference depthReference = {0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    vsg::RenderPass::Subpasses subpassDescription(1);
+    subpassDescription[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpassDescription[0].colorAttachments.emplace_back(colorReference);
+    subpassDescription[0].depthStencilAttachments.emplace_back(depthReference);
+
+    vsg::RenderPass::Dependencies dependencies(2);
+
+    // the previous frame's fragment shaders must have finished sampling the atlas before tiles are rewritten
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dependencyFlags = 0;
+
+    // and the main RenderGraph's fragment shaders must wait for this frame's tiles
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[1].dependencyFlags = 0;
+
+    auto renderPass = vsg::RenderPass::create(device, attachments, subpassDescription, dependencies);
+    auto framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{depthImageView}, atlasSize, atlasSize, 1);
+
+    auto renderGraph = vsg::RenderGraph::create();
+    renderGraph->renderArea.offset = VkOffset2D{0, 0};
+    renderGraph->renderArea.extent = VkExtent2D{atlasSize, atlasSize};
+    renderGraph->framebuffer = framebuffer;
+
+    // one View per tile, each behind a Switch so tiles that don't need re-rendering are skipped
+    _tileSwitch = vsg::Switch::create();
+    _tiles.resize(numCascades + _spotLights.size());
+    for (uint32_t t = 0; t < _tiles.size(); ++t)
+    {
+        auto& tile = _tiles[t];
+        VkRect2D rect{VkOffset2D{static_cast<int32_t>((t % tilesPerRow()) * tileSize), static_cast<int32_t>((t / tilesPerRow()) * tileSize)}, VkExtent2D{tileSize, tileSize}};
+
+        tile.lookAt = vsg::LookAt::create();
+        if (t < numCascades)
+            tile.projection = vsg::Orthographic::create();
+        else
+            tile.projection = vsg::Perspective::create();
+        tile.tileMatrix = tileTransform(rect, atlasSize);
+
+        auto camera = vsg::Camera::create(tile.projection, tile.lookAt, vsg::ViewportState::create(rect.offset.x, rect.offset.y, rect.extent.width, rect.extent.height));
+
+        auto view = vsg::View::create(camera);
+        view->mask = shadowMask;
+        view->addChild(scene);
+
+        VkClearValue clearValue{};
+        clearValue.depthStencil = VkClearDepthStencilValue{0.0f, 0};
+        VkClearAttachment depthAttachment{VK_IMAGE_ASPECT_DEPTH_BIT, 0, clearValue};
+        VkClearRect clearRect{rect, 0, 1};
+
+        auto group = vsg::Group::create();
+        group->addChild(vsg::ClearAttachments::create(vsg::ClearAttachments::Attachments{depthAttachment}, vsg::ClearAttachments::Rects{clearRect}));
+        group->addChild(view);
+
+        _tileSwitch->addChild(true, group);
+    }
+    renderGraph->addChild(_tileSwitch);
+
+    // the atlas is created in an undefined layout, transition it the first frame so the RenderPass can load it
+    _layoutSwitch = vsg::Switch::create();
+    _layoutSwitch->addChild(true, vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0,
+                                                              vsg::ImageMemoryBarrier::create(0, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                                                                                              VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, depthImage, VkImageSubresourceRange{VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1})));
+
+    auto& shadowData = _shadowData->value();
+    shadowData.texelSize.set(1.0f / static_cast<float>(atlasSize), 1.0f / static_cast<float>(atlasSize), 0.0f, 0.0f);
+
+    auto imageInfo = vsg::ImageInfo::create(shadowSampler, depthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    _descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{
+                                                                         vsg::DescriptorImage::create(imageInfo, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+                                                                         vsg::DescriptorBuffer::create(_shadowData, 1, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)});
+
+    auto commands = vsg::Group::create();
+    commands->addChild(_layoutSwitch);
+    commands->addChild(renderGraph);
+    return commands;
+}
+
+void ShadowAtlas::assign(vsg::Node& scene)
+{
+    if (!_descriptorSet)
+    {
+        vsg::warn("ShadowAtlas::assign() called before createCommands().");
+        return;
+    }
+
+    // the descriptor sets are matched against the BindGraphicsPipeline so are assigned before they are replaced by StateSwitches
+    auto assignDescriptorSet = AssignDescriptorSet::create(_descriptorSet, shadowDescriptorSet);
+    scene.accept(*assignDescriptorSet);
+
+    if (assignDescriptorSet->numAssigned == 0)
+    {
+        vsg::warn("ShadowAtlas::assign() no StateGroups with shadowed pipelines found.");
+    }
+
+    auto insertShadowPipelines = InsertShadowPipelines::create(mainMask, shadowMask, depthBiasConstantFactor, depthBiasSlopeFactor);
+    scene.accept(*insertShadowPipelines);
+}
+
+bool ShadowAtlas::updateCascade(uint32_t c, const vsg::dvec3& direction, const vsg::dvec3& centre, double radius)
+{
+    auto& tile = cascadeTile(c);
+    bool dynamic = c < numDynamicCascades;
+
+    // the rotation into light space is fixed by the light direction so texel snapping keeps the sampled texels stable as the camera moves
+    auto lightRotation = vsg::lookAt(vsg::dvec3(0.0, 0.0, 0.0), direction, upVector(direction));
+    auto lightCentre = lightRotation * centre;
+
+    if (!dynamic && tile.valid && !_invalidated && tile.direction == direction && (vsg::length(lightCentre - tile.centre) + radius) <= tile.radius) return false;
+
+    double fittedRadius = dynamic ? radius : radius * (1.0 + cacheMargin);
+    double texelSize = 2.0 * fittedRadius / static_cast<double>(tileSize);
+    lightCentre.x = std::floor(lightCentre.x / texelSize) * texelSize;
+    lightCentre.y = std::floor(lightCentre.y / texelSize) * texelSize;
+
+    tile.valid = true;
+    tile.direction = direction;
+    tile.centre = lightCentre;
+    tile.radius = fittedRadius;
+
+    tile.lookAt->eye.set(0.0, 0.0, 0.0);
+    tile.lookAt->center = direction;
+    tile.lookAt->up = upVector(direction);
+
+    // the depth range extends back towards the light to include casters outside the cascade
+    double centreDistance = -lightCentre.z;
+    auto orthographic = tile.projection.cast<vsg::Orthographic>();
+    orthographic->left = lightCentre.x - fittedRadius;
+    orthographic->right = lightCentre.x + fittedRadius;
+    orthographic->bottom = lightCentre.y - fittedRadius;
+    orthographic->top = lightCentre.y + fittedRadius;
+    orthographic->nearDistance = centreDistance - fittedRadius - 2.0 * _sceneBound.radius;
+    orthographic->farDistance = centreDistance + fittedRadius;
+    return true;
+}
+
+bool ShadowAtlas::updateSpot(uint32_t s)
+{
+    auto& tile = spotTile(s);
+    auto& light = _spotLights[s];
+    auto direction = vsg::normalize(light->direction);
+
+    if (tile.valid && !_invalidated && tile.position == light->position && tile.direction == direction && tile.radius == light->outerAngle) return false;
+
+    tile.valid = true;
+    tile.position = light->position;
+    tile.direction = direction;
+    tile.radius = light->outerAngle;
+
+    tile.lookAt->eye = light->position;
+    tile.lookAt->center = light->position + direction;
+    tile.lookAt->up = upVector(direction);
+
+    double distance = vsg::length(_sceneBound.center - light->position);
+    double farDistance = distance + _sceneBound.radius;
+    auto perspective = tile.projection.cast<vsg::Perspective>();
+    perspective->fieldOfViewY = vsg::degrees(2.0 * light->outerAngle);
+    perspective->aspectRatio = 1.0;
+    perspective->farDistance = farDistance;
+    perspective->nearDistance = std::max(distance - _sceneBound.radius, farDistance * 0.001);
+    return true;
+}
+
+void ShadowAtlas::update(const vsg::Camera& camera)
+{
+    if (!_tileSwitch) return;
+
+    _layoutSwitch->setAllChildren(_numFrames == 0);
+    ++_numFrames;
+
+    auto projectionMatrix = camera.projectionMatrix->transform();
+    auto inverseProjectionMatrix = vsg::inverse(projectionMatrix);
+    auto inverseViewMatrix = vsg::inverse(camera.viewMatrix->transform());
+
+    // the VSG's reverse depth perspective matrix has m[2][2] = n / (f - n) and m[3][2] = n * f / (f - n)
+    double nearDistance = projectionMatrix[3][2] / (1.0 + projectionMatrix[2][2]);
+    double farDistance = projectionMatrix[3][2] / projectionMatrix[2][2];
+    if (maxShadowDistance > 0.0) farDistance = std::min(farDistance, maxShadowDistance);
+
+    // eye coordinate rays through the view frustum's corners, scaled to unit depth
+    vsg::dvec3 rays[4];
+    vsg::dvec2 corners[4] = {{-1.0, -1.0}, {1.0, -1.0}, {-1.0, 1.0}, {1.0, 1.0}};
+    for (int i = 0; i < 4; ++i)
+    {
+        auto nearPlanePoint = inverseProjectionMatrix * vsg::dvec4(corners[i].x, corners[i].y, 1.0, 1.0);
+        rays[i] = vsg::dvec3(nearPlanePoint.x, nearPlanePoint.y, nearPlanePoint.z) / nearPlanePoint.w;
+        rays[i] /= -rays[i].z;
+    }
+
+    auto& shadowData = _shadowData->value();
+    shadowData.counts.set(_directionalLight ? numCascades : 0, static_cast<uint32_t>(_spotLights.size()), 0, 0);
+
+    uint32_t numTilesRendered = 0;
+    if (_directionalLight)
+    {
+        auto direction = vsg::normalize(_directionalLight->direction);
+
+        double sliceNear = nearDistance;
+        for (uint32_t c = 0; c < numCascades; ++c)
+        {
+            double ratio = static_cast<double>(c + 1) / static_cast<double>(numCascades);
+            double logarithmicSplit = nearDistance * std::pow(farDistance / nearDistance, ratio);
+            double uniformSplit = nearDistance + (farDistance - nearDistance) * ratio;
+            double sliceFar = splitLambda * logarithmicSplit + (1.0 - splitLambda) * uniformSplit;
+
+            // bounding sphere of the slice, its radius only depends on the projection so it doesn't change as the camera rotates
+            vsg::dvec3 sliceCentre;
+            for (auto& ray : rays) sliceCentre += ray * (sliceNear + sliceFar);
+            sliceCentre /= 8.0;
+
+            double sliceRadius = 0.0;
+            for (auto& ray : rays)
+            {
+                sliceRadius = std::max(sliceRadius, vsg::length(ray * sliceNear - sliceCentre));
+                sliceRadius = std::max(sliceRadius, vsg::length(ray * sliceFar - sliceCentre));
+            }
+
+            bool render = updateCascade(c, direction, inverseViewMatrix * sliceCentre, sliceRadius);
+            _tileSwitch->children[c].mask = render ? vsg::MASK_ALL : vsg::MASK_OFF;
+            if (render) ++numTilesRendered;
+
+            auto& tile = cascadeTile(c);
+            shadowData.cascadeMatrices[c] = vsg::mat4(tile.tileMatrix * tile.projection->transform() * tile.lookAt->transform() * inverseViewMatrix);
+            shadowData.cascadeSplits[c] = static_cast<float>(sliceFar);
+
+            sliceNear = sliceFar;
+        }
+    }
+    else
+    {
+        for (uint32_t c = 0; c < numCascades; ++c) _tileSwitch->children[c].mask = vsg::MASK_OFF;
+    }
+
+    for (uint32_t s = 0; s < _spotLights.size(); ++s)
+    {
+        bool render = updateSpot(s);
+        _tileSwitch->children[numCascades + s].mask = render ? vsg::MASK_ALL : vsg::MASK_OFF;
+        if (render) ++numTilesRendered;
+
+        auto& tile = spotTile(s);
+        shadowData.spotMatrices[s] = vsg::mat4(tile.tileMatrix * tile.projection->transform() * tile.lookAt->transform() * inverseViewMatrix);
+    }
+
+    _shadowData->dirty();
+    _numTilesRendered += numTilesRendered;
+    _invalidated = false;
+}
+
+void ShadowAtlas::report(std::ostream& out) const
+{
+    uint64_t numTiles = (_directionalLight ? numCascades : 0) + _spotLights.size();
+    if (_numFrames == 0 || numTiles == 0) return;
+
+    out << "Shadow atlas tiles rendered = " << _numTilesRendered << " of " << (numTiles * _numFrames) << " over " << _numFrames << " frames ("
+        << (100.0 * static_cast<double>(_numTilesRendered) / static_cast<double>(numTiles * _numFrames)) << "%)" << std::endl;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <ostream>
+
+struct ShadowData
+{
+    vsg::mat4 cascadeMatrices[4]; // eye coordinates to atlas texture coordinates and depth
+    vsg::vec4 cascadeSplits;      // far distance of each cascade
+    vsg::mat4 spotMatrices[4];
+    vsg::uivec4 counts;           // numCascades, numSpotShadows
+    vsg::vec4 texelSize;          // 1.0 / atlas width, 1.0 / atlas height
+};
+
+class ShadowDataValue : public vsg::Inherit<vsg::Value<ShadowData>, ShadowDataValue>
+{
+public:
+    ShadowDataValue() {}
+};
+
+// Shadows for the first directional light and the first few spot lights, rendered into tiles of a single depth atlas.
+// The directional light's shadow is split into cascades fitted to slices of the camera's view frustum, the spot lights
+// each get a perspective tile. Tiles are only re-rendered when needed: cascades nearer than numDynamicCascades follow the
+// camera every frame, the farther cascades are fitted with a margin and kept until the camera's slice leaves them or the
+// light moves, and spot light tiles are kept until their light moves. Call invalidate() when static geometry changes.
+//
+// The shadow casters are rendered with depth only variants of each pipeline in the scene, selected through a StateSwitch
+// by the shadow tile Views' mask, and the phong and pbr fragment shaders, compiled with VSG_SHADOW_ATLAS, sample the
+// atlas bound as descriptor set 3.
+//
+// Usage:
+//   1. assignShaderSets(options) before creating or loading the scene so it's built with the shadowed ShaderSets,
+//   2. setDirectionalLight() and addSpotLight() for the lights casting shadows, these must be the first lights of their type in the scene,
+//   3. createCommands() and add them to the CommandGraph ahead of the main RenderGraph, then assign() the scene and set the main View's mask to mainMask,
+//   4. update() with the main View's Camera every frame before Viewer::update().
+class ShadowAtlas : public vsg::Inherit<vsg::Object, ShadowAtlas>
+{
+public:
+    static constexpr uint32_t shadowDescriptorSet = 3;
+    static constexpr uint32_t maxCascades = 4;
+    static constexpr uint32_t maxSpotShadows = 4;
+
+    ShadowAtlas(uint32_t in_atlasSize = 4096, uint32_t in_tileSize = 1024, uint32_t in_numCascades = 4);
+
+    const uint32_t atlasSize;
+    const uint32_t tileSize;
+    const uint32_t numCascades;
+
+    // cascades nearer than this are re-rendered every frame
+    uint32_t numDynamicCascades = 2;
+
+    // blend between logarithmic (1.0) and uniform (0.0) cascade split distances
+    double splitLambda = 0.75;
+
+    // limit on the distance shadows are cast to, 0.0 uses the camera's far plane
+    double maxShadowDistance = 0.0;
+
+    // cached cascades are fitted this much larger than the slice they cover so small camera movements stay inside them
+    double cacheMargin = 0.25;
+
+    // the VSG's reverse depth needs negative biases to push the stored depths away from the light
+    float depthBiasConstantFactor = -1.25f;
+    float depthBiasSlopeFactor = -1.75f;
+
+    vsg::Mask mainMask = 0x1;
+    vsg::Mask shadowMask = 0x2;
+
+    vsg::ref_ptr<vsg::DescriptorSetLayout> descriptorSetLayout;
+
+    // replace the phong and pbr ShaderSets in options with shadowed ones, returns false if the standard shaders aren't found
+    bool assignShaderSets(vsg::ref_ptr<vsg::Options> options);
+
+    // the lights casting shadows, their position and direction are in world coordinates
+    void setDirectionalLight(vsg::ref_ptr<vsg::DirectionalLight> light) { _directionalLight = light; }
+    bool addSpotLight(vsg::ref_ptr<vsg::SpotLight> light);
+
+    // layout transition and RenderGraph rendering the scene into the atlas tiles
+    vsg::ref_ptr<vsg::Node> createCommands(vsg::Context& context, vsg::ref_ptr<vsg::Node> scene);
+
+    // bind the shadow descriptor set and insert the depth only pipeline variants, call after any other descriptor sets are assigned
+    void assign(vsg::Node& scene);
+
+    // re-render every tile on the next update()
+    void invalidate() { _invalidated = true; }
+
+    // fit the cascades to the camera's view, select the tiles to render this frame and update the shadow matrices
+    void update(const vsg::Camera& camera);
+
+    void report(std::ostream& out) const;
+
+protected:
+    struct Tile
+    {
+        vsg::ref_ptr<vsg::LookAt> lookAt;
+        vsg::ref_ptr<vsg::ProjectionMatrix> projection;
+        vsg::dmat4 tileMatrix;
+
+        // the state the tile was last rendered with
+        bool valid = false;
+        vsg::dvec3 position;
+        vsg::dvec3 direction;
+        vsg::dvec3 centre;
+        double radius = 0.0;
+    };
+
+    uint32_t tilesPerRow() const { return atlasSize / tileSize; }
+    Tile& cascadeTile(uint32_t c) { return _tiles[c]; }
+    Tile& spotTile(uint32_t s) { return _tiles[numCascades + s]; }
+
+    bool updateCascade(uint32_t c, const vsg::dvec3& direction, const vsg::dvec3& centre, double radius);
+    bool updateSpot(uint32_t s);
+
+    vsg::ref_ptr<vsg::DirectionalLight> _directionalLight;
+    std::vector<vsg::ref_ptr<vsg::SpotLight>> _spotLights;
+
+    std::vector<Tile> _tiles;
+    vsg::ref_ptr<vsg::Switch> _tileSwitch;
+    vsg::ref_ptr<vsg::Switch> _layoutSwitch;
+
+    vsg::ref_ptr<ShadowDataValue> _shadowData;
+    vsg::ref_ptr<vsg::DescriptorSet> _descriptorSet;
+    vsg::dsphere _sceneBound;
+    bool _invalidated = true;
+
+    uint64_t _numFrames = 0;
+    uint64_t _numTilesRendered = 0;
+
+    vsg::DescriptorSetLayoutBindings descriptorBindings() const;
+};
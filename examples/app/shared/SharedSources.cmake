@@ -0,0 +1,97 @@
+# Sources shared by several examples, included from the top level CMakeLists.txt so that all the example directories see them.
+# Each example adds the variables it needs to its SOURCES and includes the headers by name.
+set(SHARED_SOURCE_DIR ${CMAKE_CURRENT_LIST_DIR})
+include_directories(${SHARED_SOURCE_DIR})
+
+# FrameTrace provides the --trace option shared by the app examples
+set(FRAME_TRACE_SOURCES
+    ${SHARED_SOURCE_DIR}/FrameTrace.h
+    ${SHARED_SOURCE_DIR}/FrameTrace.cpp
+    ${SHARED_SOURCE_DIR}/RecursionGuard.h
+)
+
+# AtomicSave writes files through a temporary file that replaces the original, used by vsgpagedlod, PipelineCache, vsgtext, vsgembed, vsgviewer, vsgskybox, vsgcompute, vsgdeviceselection and vsgshaderset
+set(ATOMIC_SAVE_SOURCES
+    ${SHARED_SOURCE_DIR}/AtomicSave.h
+    ${SHARED_SOURCE_DIR}/AtomicSave.cpp
+)
+
+# ParallelTraversal splits the traversal of large groups across OperationThreads, used by vsggroups and vsgallocator,
+# its FunctionOperation and runTasks() fan other work out across OperationThreads for vsgtextgroup, vsgtext, vsgvolume, vsgio, vsgviewer and vsgarrays
+set(PARALLEL_TRAVERSAL_SOURCES
+    ${SHARED_SOURCE_DIR}/ParallelTraversal.h
+    ${SHARED_SOURCE_DIR}/ParallelTraversal.cpp
+)
+
+# StagingRing streams dirty ranges of vsg::Data to the GPU, used by vsgdynamictexture, vsgdynamicvertex and vsgvolume
+set(STAGING_RING_SOURCES
+    ${SHARED_SOURCE_DIR}/StagingRing.h
+    ${SHARED_SOURCE_DIR}/StagingRing.cpp
+)
+
+# AsyncCompute overlaps compute on a dedicated queue with the graphics that consumes it, used by vsgcomputevertex and vsgdynamictexture_cs
+set(ASYNC_COMPUTE_SOURCES
+    ${SHARED_SOURCE_DIR}/AsyncCompute.h
+    ${SHARED_SOURCE_DIR}/AsyncCompute.cpp
+)
+
+# AssignDescriptorSet binds a descriptor set to the StateGroups whose pipeline layouts include it, used by vsglights, vsgviewer and vsgskybox
+set(ASSIGN_DESCRIPTOR_SET_SOURCES
+    ${SHARED_SOURCE_DIR}/AssignDescriptorSet.h
+    ${SHARED_SOURCE_DIR}/AssignDescriptorSet.cpp
+)
+
+# ShadowAtlas renders cascaded and spot light shadows into one depth atlas, used by vsglights and vsgviewer
+set(SHADOW_ATLAS_SOURCES
+    ${SHARED_SOURCE_DIR}/ShadowAtlas.h
+    ${SHARED_SOURCE_DIR}/ShadowAtlas.cpp
+    ${ASSIGN_DESCRIPTOR_SET_SOURCES}
+)
+
+# PipelineCache persists a VkPipelineCache across runs, used by vsgviewer and vsgheadless
+set(PIPELINE_CACHE_SOURCES
+    ${SHARED_SOURCE_DIR}/PipelineCache.h
+    ${SHARED_SOURCE_DIR}/PipelineCache.cpp
+    ${SHARED_SOURCE_DIR}/RecursionGuard.h
+    ${ATOMIC_SAVE_SOURCES}
+)
+
+# BatchCull tests batches of bounding spheres and boxes against a frustum, used by vsgmaths and vsggroups
+set(BATCH_CULL_SOURCES
+    ${SHARED_SOURCE_DIR}/BatchCull.h
+    ${SHARED_SOURCE_DIR}/BatchCull.cpp
+)
+
+# DeferredRelease destroys released subgraphs on a background thread, used by vsgpointer and vsgpagedlod
+set(DEFERRED_RELEASE_SOURCES
+    ${SHARED_SOURCE_DIR}/DeferredRelease.h
+    ${SHARED_SOURCE_DIR}/DeferredRelease.cpp
+)
+
+# DeviceKey identifies a physical device and driver for results cached per device, used by vsgcompute and vsgdeviceselection
+set(DEVICE_KEY_SOURCES
+    ${SHARED_SOURCE_DIR}/DeviceKey.h
+    ${SHARED_SOURCE_DIR}/DeviceKey.cpp
+)
+
+# Hash is a header only FNV-1a hash that is stable across runs, used by vsgshaderset, vsggraphicspipelineconfigurator, vsgtext, vsgviewer, vsgskybox, vsgimgui_example, vsgdeviceselection and vsgdynamicload
+set(HASH_SOURCES
+    ${SHARED_SOURCE_DIR}/Hash.h
+)
+
+# TimestampQueries rotates a timestamp query pool per frame in flight so reading the results never stalls, used by vsgtimestamps and vsgviewer
+set(TIMESTAMP_QUERIES_SOURCES
+    ${SHARED_SOURCE_DIR}/TimestampQueries.h
+    ${SHARED_SOURCE_DIR}/TimestampQueries.cpp
+)
+
+# BoundsCache computes the bounds of every node of a subgraph once, bottom up, and recomputes only what's invalidated, used by vsgtransform and vsgclip
+set(BOUNDS_CACHE_SOURCES
+    ${SHARED_SOURCE_DIR}/BoundsCache.h
+    ${SHARED_SOURCE_DIR}/BoundsCache.cpp
+)
+
+# TypeIndexedDispatch is a header only jump table dispatch for visitors, used by vsgvisitorcustomtype and vsggroups
+set(TYPE_INDEXED_DISPATCH_SOURCES
+    ${SHARED_SOURCE_DIR}/TypeIndexedDispatch.h
+)
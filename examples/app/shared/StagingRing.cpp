@@ -0,0 +1,327 @@
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <limits>
+
+void DirtyRanges::add(VkDeviceSize offset, VkDeviceSize size)
+{
+    if (size == 0) return;
+
+    // extend the last range in place for the common case of updates in increasing order
+    if (!_ranges.empty())
+    {
+        auto& last = _ranges.back();
+        if (last.offset <= offset && offset <= last.offset + last.size)
+        {
+            last.size = std::max(last.offset + last.size, offset + size) - last.offset;
+            return;
+        }
+    }
+
+    _ranges.push_back(Range{offset, size});
+    _coalesced = _ranges.size() == 1;
+}
+
+const std::vector<DirtyRanges::Range>& DirtyRanges::ranges()
+{
+    if (_coalesced) return _ranges;
+
+    std::sort(_ranges.begin(), _ranges.end(), [](const Range& lhs, const Range& rhs) { return lhs.offset < rhs.offset; });
+
+    size_t numCoalesced = 0;
+    for (auto& range : _ranges)
+    {
+        if (numCoalesced > 0)
+        {
+            auto& previous = _ranges[numCoalesced - 1];
+            if (range.offset <= previous.offset + previous.size)
+            {
+                previous.size = std::max(previous.offset + previous.size, range.offset + range.size) - previous.offset;
+                continue;
+            }
+        }
+        _ranges[numCoalesced++] = range;
+    }
+    _ranges.resize(numCoalesced);
+
+    _coalesced = true;
+    return _ranges;
+}
+
+VkDeviceSize DirtyRanges::totalSize()
+{
+    VkDeviceSize size = 0;
+    for (auto& range : ranges()) size += range.size;
+    return size;
+}
+
+void DirtyRegions::add(const VkOffset3D& offset, const VkExtent3D& extent)
+{
+    if (extent.width == 0 || extent.height == 0 || extent.depth == 0) return;
+
+    _regions.push_back(Region{offset, extent});
+    _coalesced = _regions.size() == 1;
+}
+
+// merge rhs into lhs if the union of the two is a region
+static bool merge(DirtyRegions::Region& lhs, const DirtyRegions::Region& rhs)
+{
+    int32_t lhs_begin[3] = {lhs.offset.x, lhs.offset.y, lhs.offset.z};
+    int32_t lhs_end[3] = {lhs.offset.x + int32_t(lhs.extent.width), lhs.offset.y + int32_t(lhs.extent.height), lhs.offset.z + int32_t(lhs.extent.depth)};
+    int32_t rhs_begin[3] = {rhs.offset.x, rhs.offset.y, rhs.offset.z};
+    int32_t rhs_end[3] = {rhs.offset.x + int32_t(rhs.extent.width), rhs.offset.y + int32_t(rhs.extent.height), rhs.offset.z + int32_t(rhs.extent.depth)};
+
+    int numMatching = 0;
+    int other = -1;
+    for (int i = 0; i < 3; ++i)
+    {
+        if (lhs_begin[i] == rhs_begin[i] && lhs_end[i] == rhs_end[i])
+            ++numMatching;
+        else
+            other = i;
+    }
+
+    if (numMatching < 2) return false;
+    if (other >= 0)
+    {
+        if (rhs_begin[other] > lhs_end[other] || lhs_begin[other] > rhs_end[other]) return false;
+        lhs_begin[other] = std::min(lhs_begin[other], rhs_begin[other]);
+        lhs_end[other] = std::max(lhs_end[other], rhs_end[other]);
+    }
+
+    lhs.offset = VkOffset3D{lhs_begin[0], lhs_begin[1], lhs_begin[2]};
+    lhs.extent = VkExtent3D{uint32_t(lhs_end[0] - lhs_begin[0]), uint32_t(lhs_end[1] - lhs_begin[1]), uint32_t(lhs_end[2] - lhs_begin[2])};
+    return true;
+}
+
+const std::vector<DirtyRegions::Region>& DirtyRegions::regions()
+{
+    if (_coalesced) return _regions;
+
+    // repeat until no more regions merge, each merge can enable others
+    for (bool merged = true; merged;)
+    {
+        merged = false;
+        for (size_t i = 0; i < _regions.size(); ++i)
+        {
+            for (size_t j = i + 1; j < _regions.size();)
+            {
+                if (merge(_regions[i], _regions[j]))
+                {
+                    _regions.erase(_regions.begin() + j);
+                    merged = true;
+                }
+                else
+                {
+                    ++j;
+                }
+            }
+        }
+    }
+
+    _coalesced = true;
+    return _regions;
+}
+
+StagingRing::StagingRing(VkDeviceSize in_regionSize, uint32_t in_numRegions) :
+    regionSize(((std::max(in_regionSize, VkDeviceSize(1)) + 255) / 256) * 256),
+    numRegions(std::max(in_numRegions, 1u))
+{
+}
+
+void StagingRing::beginFrame(vsg::ref_ptr<vsg::Fence> fence)
+{
+    auto startTime = vsg::clock::now();
+    if (fence && fence->hasDependencies()) fence->wait(std::numeric_limits<uint64_t>::max());
+    stallTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (!_bufferCopies.empty() || !_imageCopies.empty())
+        {
+            vsg::warn("StagingRing::beginFrame() discarding ", _bufferCopies.size() + _imageCopies.size(), " copies that weren't recorded");
+            _bufferCopies.clear();
+            _imageCopies.clear();
+        }
+    }
+
+    _currentRegion = static_cast<uint32_t>(numFrames % numRegions);
+    _allocated = 0;
+    ++numFrames;
+}
+
+StagingRing::Allocation StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    if (!_mapped || size == 0) return {};
+
+    alignment = std::max(alignment, VkDeviceSize(1));
+
+    VkDeviceSize offset = _allocated.load(std::memory_order_relaxed);
+    VkDeviceSize alignedOffset = 0;
+    do
+    {
+        alignedOffset = ((offset + alignment - 1) / alignment) * alignment;
+        if (alignedOffset + size > regionSize)
+        {
+            ++numOverflows;
+            return {};
+        }
+    } while (!_allocated.compare_exchange_weak(offset, alignedOffset + size, std::memory_order_relaxed));
+
+    VkDeviceSize ringOffset = _currentRegion * regionSize + alignedOffset;
+    return Allocation{_mapped + ringOffset, ringOffset, size};
+}
+
+bool StagingRing::copy(const Allocation& allocation, vsg::ref_ptr<vsg::BufferInfo> dst)
+{
+    return copy(allocation, dst, 0);
+}
+
+bool StagingRing::copy(const Allocation& allocation, vsg::ref_ptr<vsg::BufferInfo> dst, VkDeviceSize dstOffset)
+{
+    if (!allocation || !dst || !dst->buffer || dstOffset >= dst->range) return false;
+
+    VkBufferCopy region{allocation.offset, dst->offset + dstOffset, std::min(allocation.size, dst->range - dstOffset)};
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _bufferCopies.push_back(BufferCopy{dst->buffer, region});
+    bytesUploaded += region.size;
+    return true;
+}
+
+bool StagingRing::copy(const Allocation& allocation, vsg::ref_ptr<vsg::ImageInfo> dst)
+{
+    if (!dst || !dst->imageView || !dst->imageView->image) return false;
+
+    return copy(allocation, dst, VkOffset3D{0, 0, 0}, dst->imageView->image->extent);
+}
+
+bool StagingRing::copy(const Allocation& allocation, vsg::ref_ptr<vsg::ImageInfo> dst, const VkOffset3D& offset, const VkExtent3D& extent)
+{
+    if (!allocation || !dst || !dst->imageView || !dst->imageView->image) return false;
+
+    // other mip levels would be left out of date
+    auto image = dst->imageView->image;
+    if (image->mipLevels > 1) return false;
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = allocation.offset;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageOffset = offset;
+    region.imageExtent = extent;
+
+    bool wholeImage = offset.x == 0 && offset.y == 0 && offset.z == 0 &&
+                      extent.width == image->extent.width && extent.height == image->extent.height && extent.depth == image->extent.depth;
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _imageCopies.push_back(ImageCopy{image, dst->imageLayout, wholeImage, region});
+    bytesUploaded += allocation.size;
+    return true;
+}
+
+void StagingRing::compile(vsg::Context& context)
+{
+    if (_buffer) return;
+
+    VkDeviceSize totalSize = regionSize * numRegions;
+    _buffer = vsg::createBufferAndMemory(context.device, totalSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    // the memory stays mapped for the lifetime of the buffer
+    void* ptr = nullptr;
+    auto memory = _buffer->getDeviceMemory(context.deviceID);
+    if (memory->map(_buffer->getMemoryOffset(context.deviceID), totalSize, 0, &ptr) != VK_SUCCESS)
+    {
+        vsg::warn("StagingRing::compile() unable to map staging buffer of ", totalSize, " bytes");
+        return;
+    }
+    _mapped = static_cast<uint8_t*>(ptr);
+}
+
+void StagingRing::record(vsg::CommandBuffer& commandBuffer) const
+{
+    std::vector<BufferCopy> bufferCopies;
+    std::vector<ImageCopy> imageCopies;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        bufferCopies.swap(_bufferCopies);
+        imageCopies.swap(_imageCopies);
+    }
+
+    if (bufferCopies.empty() && imageCopies.empty()) return;
+
+    auto deviceID = commandBuffer.deviceID;
+    VkBuffer stagingBuffer = _buffer->vk(deviceID);
+
+    // group the copies by destination so each gets a single copy command
+    std::stable_sort(bufferCopies.begin(), bufferCopies.end(), [](const BufferCopy& lhs, const BufferCopy& rhs) { return lhs.buffer < rhs.buffer; });
+    std::stable_sort(imageCopies.begin(), imageCopies.end(), [](const ImageCopy& lhs, const ImageCopy& rhs) { return lhs.image < rhs.image; });
+
+    // images that are wholly overwritten can discard their previous contents on the transition to TRANSFER_DST
+    std::vector<VkImageMemoryBarrier> preCopyBarriers;
+    std::vector<VkImageMemoryBarrier> postCopyBarriers;
+    for (size_t i = 0; i < imageCopies.size(); ++i)
+    {
+        if (i > 0 && imageCopies[i].image == imageCopies[i - 1].image) continue;
+
+        bool wholeImage = false;
+        for (size_t j = i; j < imageCopies.size() && imageCopies[j].image == imageCopies[i].image; ++j) wholeImage = wholeImage || imageCopies[j].wholeImage;
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = imageCopies[i].image->vk(deviceID);
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = wholeImage ? VK_IMAGE_LAYOUT_UNDEFINED : imageCopies[i].layout;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        preCopyBarriers.push_back(barrier);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = imageCopies[i].layout;
+        postCopyBarriers.push_back(barrier);
+    }
+
+    // the previous frame's reads of the destinations must complete before they are overwritten
+    VkPipelineStageFlags readStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    vkCmdPipelineBarrier(commandBuffer, readStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr,
+                         0, nullptr,
+                         static_cast<uint32_t>(preCopyBarriers.size()), preCopyBarriers.data());
+
+    std::vector<VkBufferCopy> bufferRegions;
+    for (size_t i = 0; i < bufferCopies.size(); ++i)
+    {
+        bufferRegions.push_back(bufferCopies[i].region);
+        if (i + 1 == bufferCopies.size() || bufferCopies[i + 1].buffer != bufferCopies[i].buffer)
+        {
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, bufferCopies[i].buffer->vk(deviceID), static_cast<uint32_t>(bufferRegions.size()), bufferRegions.data());
+            bufferRegions.clear();
+        }
+    }
+
+    std::vector<VkBufferImageCopy> imageRegions;
+    for (size_t i = 0; i < imageCopies.size(); ++i)
+    {
+        imageRegions.push_back(imageCopies[i].region);
+        if (i + 1 == imageCopies.size() || imageCopies[i + 1].image != imageCopies[i].image)
+        {
+            vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, imageCopies[i].image->vk(deviceID), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+            imageRegions.clear();
+        }
+    }
+
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, readStages, 0,
+                         bufferCopies.empty() ? 0 : 1, &memoryBarrier,
+                         0, nullptr,
+                         static_cast<uint32_t>(postCopyBarriers.size()), postCopyBarriers.data());
+}
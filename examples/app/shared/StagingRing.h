@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <mutex>
+
+// Byte ranges of a vsg::Data modified since the last upload. Overlapping and adjacent ranges are coalesced so each byte is
+// copied once, with as few copy regions as possible.
+class DirtyRanges
+{
+public:
+    struct Range
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    void add(VkDeviceSize offset, VkDeviceSize size);
+
+    // the coalesced ranges sorted by offset
+    const std::vector<Range>& ranges();
+
+    VkDeviceSize totalSize();
+    bool empty() const { return _ranges.empty(); }
+    void clear() { _ranges.clear(); }
+
+protected:
+    std::vector<Range> _ranges;
+    bool _coalesced = true;
+};
+
+// Regions of an image modified since the last upload. Regions that match in two dimensions and overlap or adjoin in the
+// third are coalesced.
+class DirtyRegions
+{
+public:
+    struct Region
+    {
+        VkOffset3D offset;
+        VkExtent3D extent;
+    };
+
+    void add(const VkOffset3D& offset, const VkExtent3D& extent);
+
+    const std::vector<Region>& regions();
+
+    bool empty() const { return _regions.empty(); }
+    void clear() { _regions.clear(); }
+
+protected:
+    std::vector<Region> _regions;
+    bool _coalesced = true;
+};
+
+// Command placed at the start of a command graph, outside any render pass, that uploads data written directly into a
+// persistently mapped, host coherent staging buffer. The buffer is divided into one region per frame in flight,
+// beginFrame() waits for the GPU to finish with the region that's about to be reused, after which writers on any thread
+// allocate from it, fill the allocation in place and queue a copy to a buffer or image. When recorded all the copies
+// queued for the frame are issued, batched into one vkCmdCopyBuffer per destination buffer and one
+// vkCmdCopyBufferToImage per destination image, followed by the barriers required before they are read.
+class StagingRing : public vsg::Inherit<vsg::Command, StagingRing>
+{
+public:
+    StagingRing(VkDeviceSize in_regionSize, uint32_t in_numRegions);
+
+    const VkDeviceSize regionSize;
+    const uint32_t numRegions;
+
+    struct Allocation
+    {
+        void* ptr = nullptr;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+
+        explicit operator bool() const { return ptr != nullptr; }
+    };
+
+    // wait for the GPU to complete the submission, signalled by fence, that last read the region used for the new frame.
+    void beginFrame(vsg::ref_ptr<vsg::Fence> fence);
+
+    // thread safe allocation from the current frame's region, returns an empty Allocation if it's full or the ring hasn't been compiled.
+    Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+    // thread safe queuing of a copy of a filled allocation to a compiled buffer, or to a compiled single mip level image.
+    // returns false if the destination can't be updated this way.
+    bool copy(const Allocation& allocation, vsg::ref_ptr<vsg::BufferInfo> dst);
+    bool copy(const Allocation& allocation, vsg::ref_ptr<vsg::ImageInfo> dst);
+
+    // copy to a range of the buffer starting dstOffset bytes into dst, or a region of the image, the allocation holding
+    // the region's texels tightly packed.
+    bool copy(const Allocation& allocation, vsg::ref_ptr<vsg::BufferInfo> dst, VkDeviceSize dstOffset);
+    bool copy(const Allocation& allocation, vsg::ref_ptr<vsg::ImageInfo> dst, const VkOffset3D& offset, const VkExtent3D& extent);
+
+    void compile(vsg::Context& context) override;
+    void record(vsg::CommandBuffer& commandBuffer) const override;
+
+    // stats accumulated over all frames
+    std::atomic_uint64_t bytesUploaded{0};
+    std::atomic_uint64_t numOverflows{0};
+    uint64_t numFrames = 0;
+    double stallTime = 0.0; // milliseconds spent in beginFrame() waiting for the GPU
+
+protected:
+    struct BufferCopy
+    {
+        vsg::ref_ptr<vsg::Buffer> buffer;
+        VkBufferCopy region;
+    };
+
+    struct ImageCopy
+    {
+        vsg::ref_ptr<vsg::Image> image;
+        VkImageLayout layout;
+        bool wholeImage;
+        VkBufferImageCopy region;
+    };
+
+    vsg::ref_ptr<vsg::Buffer> _buffer;
+    uint8_t* _mapped = nullptr;
+
+    uint32_t _currentRegion = 0;
+    std::atomic<VkDeviceSize> _allocated{0};
+
+    mutable std::mutex _mutex;
+    mutable std::vector<BufferCopy> _bufferCopies;
+    mutable std::vector<ImageCopy> _imageCopies;
+};
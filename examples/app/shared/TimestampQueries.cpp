@@ -0,0 +1,73 @@
+#include "TimestampQueries.h"
+
+TimestampQueries::TimestampQueries(uint32_t in_numFramesInFlight, uint32_t in_queriesPerFrame) :
+    numFramesInFlight(std::max(in_numFramesInFlight, 1u)),
+    queriesPerFrame(in_queriesPerFrame),
+    _frames(numFramesInFlight)
+{
+    for (auto& frame : _frames)
+    {
+        frame.queryPool = vsg::QueryPool::create();
+        frame.queryPool->queryType = VK_QUERY_TYPE_TIMESTAMP;
+        frame.queryPool->queryCount = queriesPerFrame;
+    }
+}
+
+void TimestampQueries::compile(vsg::Context& context)
+{
+    for (auto& frame : _frames) frame.queryPool->compile(context);
+}
+
+uint32_t TimestampQueries::beginFrame(vsg::CommandBuffer& commandBuffer)
+{
+    _currentFrame = (_currentFrame + 1) % numFramesInFlight;
+    auto& frame = _frames[_currentFrame];
+
+    // the last use of this pool was numFramesInFlight frames ago so its results will be available without waiting
+    if (frame.pending) _collect(_currentFrame);
+
+    vkCmdResetQueryPool(commandBuffer.vk(), frame.queryPool->vk(commandBuffer.deviceID), 0, queriesPerFrame);
+
+    frame.frameCount = _frameCount++;
+    frame.numWritten = 0;
+    frame.pending = true;
+    return _currentFrame;
+}
+
+void TimestampQueries::write(vsg::CommandBuffer& commandBuffer, VkPipelineStageFlagBits stage, uint32_t query)
+{
+    auto& frame = _frames[_currentFrame];
+    vkCmdWriteTimestamp(commandBuffer.vk(), stage, frame.queryPool->vk(commandBuffer.deviceID), query);
+    frame.numWritten = std::max(frame.numWritten, query + 1);
+}
+
+void TimestampQueries::_collect(uint32_t index)
+{
+    auto& frame = _frames[index];
+    frame.pending = false;
+    if (frame.numWritten == 0) return;
+
+    std::vector<uint64_t> timestamps(frame.numWritten);
+    if (frame.queryPool->getResults(timestamps) != VK_SUCCESS)
+    {
+        ++numDroppedFrames;
+        return;
+    }
+
+    if (collect) collect(index, frame.frameCount, timestamps);
+}
+
+void TimestampQueries::collectAll()
+{
+    // oldest first, starting with the frame after the current one
+    for (uint32_t i = 1; i <= numFramesInFlight; ++i)
+    {
+        auto index = (_currentFrame + i) % numFramesInFlight;
+        if (_frames[index].pending) _collect(index);
+    }
+}
+
+void TimestampQueries::discardAll()
+{
+    for (auto& frame : _frames) frame.pending = false;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <functional>
+#include <vector>
+
+// Timestamp queries written by each frame in flight to its own VkQueryPool, so reading them back never stalls.
+// beginFrame() reads back the pool it's about to reuse, last written numFramesInFlight frames ago so the GPU has
+// finished with it, passes the timestamps to collect, then resets the pool for the new frame. Not thread safe, the
+// owner serializes the calls, collect is called from within beginFrame() and collectAll().
+class TimestampQueries : public vsg::Inherit<vsg::Object, TimestampQueries>
+{
+public:
+    TimestampQueries(uint32_t in_numFramesInFlight, uint32_t in_queriesPerFrame);
+
+    const uint32_t numFramesInFlight;
+    const uint32_t queriesPerFrame;
+
+    // called with the index of the frame's pool, the frame's count since the first beginFrame() and the timestamps written to it
+    std::function<void(uint32_t frameIndex, uint64_t frameCount, const std::vector<uint64_t>& timestamps)> collect;
+
+    // frames whose results weren't available when their pool was reused
+    uint64_t numDroppedFrames = 0;
+
+    void compile(vsg::Context& context);
+
+    // collect the results of the next pool, then reset it and make it the current frame's, returns its index
+    uint32_t beginFrame(vsg::CommandBuffer& commandBuffer);
+
+    // index of the current frame's pool
+    uint32_t currentFrame() const { return _currentFrame; }
+
+    // true between beginFrame() and the frame's results being collected or discarded
+    bool frameBegun() const { return _frames[_currentFrame].pending; }
+
+    // write query, which must be less than queriesPerFrame, of the current frame
+    void write(vsg::CommandBuffer& commandBuffer, VkPipelineStageFlagBits stage, uint32_t query);
+
+    // collect the results of the frames still pending, oldest first, call once the device is idle
+    void collectAll();
+
+    // forget the frames still pending without reading their results
+    void discardAll();
+
+protected:
+    struct Frame
+    {
+        vsg::ref_ptr<vsg::QueryPool> queryPool;
+        uint64_t frameCount = 0;
+        uint32_t numWritten = 0; // one more than the highest query written
+        bool pending = false;    // begun and not yet read back
+    };
+
+    void _collect(uint32_t index);
+
+    std::vector<Frame> _frames;
+    uint32_t _currentFrame = 0;
+    uint64_t _frameCount = 0;
+};
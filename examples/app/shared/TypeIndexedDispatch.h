@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vsg/core/Visitor.h>
+#include <vsg/nodes/Group.h>
+
+#include <mutex>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+// Assigns node types small consecutive integer ids on first use, 0 being reserved for null children.
+// id<T>() is a function local static after the first call, id(object) looks the dynamic type up in a map so is meant to
+// be called once when a subgraph is built rather than on every visit.
+class TypeRegistry
+{
+public:
+    template<class T>
+    static uint32_t id()
+    {
+        static const uint32_t s_id = registerType(typeid(T));
+        return s_id;
+    }
+
+    static uint32_t id(const vsg::Object& object)
+    {
+        return registerType(typeid(object));
+    }
+
+    static uint32_t registerType(const std::type_info& type)
+    {
+        std::scoped_lock<std::mutex> lock(mutex());
+        auto itr = types().emplace(std::type_index(type), static_cast<uint32_t>(types().size() + 1)).first;
+        return itr->second;
+    }
+
+protected:
+    static std::mutex& mutex()
+    {
+        static std::mutex s_mutex;
+        return s_mutex;
+    }
+
+    static std::unordered_map<std::type_index, uint32_t>& types()
+    {
+        static std::unordered_map<std::type_index, uint32_t> s_types;
+        return s_types;
+    }
+};
+
+// Jump table from type id to a visitor's handler for that type, built once per visitor class, so that dispatching a
+// node is a single indirect call with no accept() or cast<>() involved. Types without a handler fall back to accept().
+template<class V>
+class DispatchTable
+{
+public:
+    using Function = void (*)(V&, vsg::Node&);
+
+    // register V::apply(T&) as the handler for nodes of type T
+    template<class T>
+    void add()
+    {
+        uint32_t id = TypeRegistry::id<T>();
+        if (id >= functions.size()) functions.resize(id + 1, &fallback);
+        functions[id] = [](V& visitor, vsg::Node& node) { visitor.apply(static_cast<T&>(node)); };
+    }
+
+    void dispatch(V& visitor, vsg::Node& node, uint32_t id) const
+    {
+        (id < functions.size() ? functions[id] : &fallback)(visitor, node);
+    }
+
+    static void fallback(V& visitor, vsg::Node& node) { node.accept(visitor); }
+
+    std::vector<Function> functions;
+};
+
+// Group that stores the type id of each child next to it, so a traversal can dispatch its children through a
+// DispatchTable without a virtual call. Call updateChildTypes() after adding, removing or replacing children, children
+// without a type id, such as ones added since the last update, fall back to accept().
+class IndexedGroup : public vsg::Inherit<vsg::Group, IndexedGroup>
+{
+public:
+    std::vector<uint32_t> childTypes;
+
+    void updateChildTypes()
+    {
+        childTypes.clear();
+        for (auto& child : children) childTypes.push_back(child ? TypeRegistry::id(*child) : 0);
+    }
+
+    using Group::traverse;
+
+    template<class V>
+    void traverse(V& visitor, const DispatchTable<V>& table)
+    {
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            if (!children[i]) continue;
+
+            if (i < childTypes.size()) table.dispatch(visitor, *children[i], childTypes[i]);
+            else children[i]->accept(visitor);
+        }
+    }
+
+protected:
+    ~IndexedGroup() = default;
+};
@@ -0,0 +1,364 @@
+#include "MultiviewStereo.h"
+
+#include <algorithm>
+#include <set>
+
+namespace
+{
+    // walk the StateGroups of a scene graph converting each graphics pipeline they bind
+    class ConvertToMultiview : public vsg::Visitor
+    {
+    public:
+        explicit ConvertToMultiview(std::function<bool(vsg::StateGroup&, vsg::BindGraphicsPipeline&)> in_convert) :
+            convert(in_convert) {}
+
+        std::function<bool(vsg::StateGroup&, vsg::BindGraphicsPipeline&)> convert;
+        std::set<vsg::StateGroup*> visited;
+        uint32_t numNotConverted = 0;
+
+        void apply(vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(vsg::StateGroup& sg) override
+        {
+            if (visited.count(&sg) > 0) return;
+            visited.insert(&sg);
+
+            std::vector<vsg::ref_ptr<vsg::BindGraphicsPipeline>> pipelines;
+            for (auto& sc : sg.stateCommands)
+            {
+                if (auto bgp = sc->cast<vsg::BindGraphicsPipeline>()) pipelines.emplace_back(bgp);
+            }
+
+            for (auto& bgp : pipelines)
+            {
+                if (!convert(sg, *bgp)) ++numNotConverted;
+            }
+
+            sg.traverse(*this);
+        }
+    };
+
+    const char* composite_vert = R"(
+#version 450
+layout(location = 0) out vec2 texCoord;
+out gl_PerVertex { vec4 gl_Position; };
+void main()
+{
+    // full screen triangle
+    texCoord = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(texCoord * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+    const char* composite_frag = R"(
+#version 450
+layout(binding = 0) uniform sampler2DArray eyes;
+layout(location = 0) in vec2 texCoord;
+layout(location = 0) out vec4 outColor;
+void main()
+{
+#ifdef SIDE_BY_SIDE
+    float layer = texCoord.x < 0.5 ? 0.0 : 1.0;
+    outColor = texture(eyes, vec3(fract(texCoord.x * 2.0), texCoord.y, layer));
+#else
+    // red from the left eye, green and blue from the right
+    vec3 left = texture(eyes, vec3(texCoord, 0.0)).rgb;
+    vec3 right = texture(eyes, vec3(texCoord, 1.0)).rgb;
+    outColor = vec4(left.r, right.g, right.b, 1.0);
+#endif
+}
+)";
+} // namespace
+
+MultiviewStereo::MultiviewStereo()
+{
+    eyeMatrices = vsg::mat4Array::create(2);
+    eyeMatrices->properties.dataVariance = vsg::DYNAMIC_DATA;
+
+    vsg::DescriptorSetLayoutBindings eyeBindings{
+        {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr}};
+    eyeDescriptorSetLayout = vsg::DescriptorSetLayout::create(eyeBindings);
+
+    auto eyeBuffer = vsg::DescriptorBuffer::create(eyeMatrices, 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    eyeDescriptorSet = vsg::DescriptorSet::create(eyeDescriptorSetLayout, vsg::Descriptors{eyeBuffer});
+}
+
+void MultiviewStereo::enableMultiview(vsg::WindowTraits& windowTraits)
+{
+    windowTraits.vulkanVersion = std::max(windowTraits.vulkanVersion, static_cast<uint32_t>(VK_API_VERSION_1_1));
+    if (!windowTraits.deviceFeatures) windowTraits.deviceFeatures = vsg::DeviceFeatures::create();
+    windowTraits.deviceFeatures->get<VkPhysicalDeviceMultiviewFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES>().multiview = VK_TRUE;
+}
+
+uint32_t MultiviewStereo::convertScene(vsg::Node& scene)
+{
+    ConvertToMultiview convertToMultiview([this](vsg::StateGroup& sg, vsg::BindGraphicsPipeline& bgp) {
+        auto& pipeline = bgp.pipeline;
+        if (!pipeline || !pipeline->layout) return false;
+
+        vsg::ShaderStage* vertexStage = nullptr;
+        for (auto& stage : pipeline->stages)
+        {
+            if (stage->stage == VK_SHADER_STAGE_VERTEX_BIT) vertexStage = stage.get();
+            else if (stage->stage != VK_SHADER_STAGE_FRAGMENT_BIT) return false; // gl_Position isn't written by the vertex shader
+        }
+        if (!vertexStage || !vertexStage->module || vertexStage->module->source.empty()) return false;
+
+        // the eye matrices go in the first descriptor set the layout doesn't use
+        auto layout = pipeline->layout.get();
+        auto itr = _layoutSets.find(layout);
+        if (itr == _layoutSets.end())
+        {
+            itr = _layoutSets.emplace(layout, static_cast<uint32_t>(layout->setLayouts.size())).first;
+            layout->setLayouts.push_back(eyeDescriptorSetLayout);
+        }
+        uint32_t set = itr->second;
+
+        if (!_convertShader(*vertexStage, set)) return false;
+
+        sg.add(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, set, eyeDescriptorSet));
+        return true;
+    });
+
+    scene.accept(convertToMultiview);
+    return convertToMultiview.numNotConverted;
+}
+
+bool MultiviewStereo::_convertShader(vsg::ShaderStage& shaderStage, uint32_t set)
+{
+    auto& module = shaderStage.module;
+    if (auto itr = _convertedModules.find(module.get()); itr != _convertedModules.end()) return itr->second == set;
+
+    // rename the shader's main() so a new main() can call it and then map gl_Position to the eye being rendered
+    auto& source = module->source;
+    auto version = source.find("#version");
+    auto main = source.find("void main");
+    if (version == std::string::npos || main == std::string::npos) return false;
+
+    auto versionEnd = source.find('\n', version);
+    if (versionEnd == std::string::npos || versionEnd > main) return false;
+
+    std::string declarations = "layout(set = " + std::to_string(set) + ", binding = 0) uniform MultiviewEyes { mat4 eyeMatrices[2]; } vsg_multiview;\n"
+                               "#define main vsg_multiview_main\n";
+    source.insert(main, declarations);
+    source.insert(versionEnd + 1, "#extension GL_EXT_multiview : enable\n");
+    source.append("\n#undef main\n"
+                  "void main()\n"
+                  "{\n"
+                  "    vsg_multiview_main();\n"
+                  "    gl_Position = vsg_multiview.eyeMatrices[gl_ViewIndex] * gl_Position;\n"
+                  "}\n");
+
+    // discard the original SPIR-V so the patched source is compiled, gl_ViewIndex needs SPIR-V for Vulkan 1.1
+    module->code.clear();
+    if (!module->hints) module->hints = vsg::ShaderCompileSettings::create();
+    module->hints->vulkanVersion = std::max(module->hints->vulkanVersion, static_cast<uint32_t>(VK_API_VERSION_1_1));
+
+    _convertedModules[module.get()] = set;
+    return true;
+}
+
+vsg::ref_ptr<vsg::CommandGraph> MultiviewStereo::createCommandGraph(vsg::ref_ptr<vsg::Window> window, vsg::ref_ptr<vsg::Camera> camera, vsg::ref_ptr<vsg::Node> scene)
+{
+    _window = window;
+    _camera = camera;
+
+    auto device = window->getOrCreateDevice();
+
+    vsg::RenderPass::Attachments attachments(2);
+    attachments[0].format = _colorFormat;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[1].format = _depthFormat;
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    // each draw in the subpass is broadcast to both layers, the views being correlated lets the driver share work between them
+    uint32_t viewMask = 0b11;
+    vsg::RenderPass::Subpasses subpasses(1);
+    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[0].viewMask = viewMask;
+    subpasses[0].colorAttachments.emplace_back(vsg::AttachmentReference{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+    subpasses[0].depthStencilAttachments.emplace_back(vsg::AttachmentReference{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL});
+
+    // wait for the previous frame's composite to finish reading the layers and its depth writes to finish before clearing
+    // them, and make the layers visible to this frame's composite
+    vsg::RenderPass::Dependencies dependencies(2);
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    _renderPass = vsg::RenderPass::create(device, attachments, subpasses, dependencies, vsg::RenderPass::CorrelatedViewMasks{viewMask});
+
+    _multiviewRenderGraph = vsg::RenderGraph::create();
+    _multiviewRenderGraph->renderArea.offset = VkOffset2D{0, 0};
+    _multiviewRenderGraph->clearValues.resize(2);
+    _multiviewRenderGraph->clearValues[0].color = {{0.2f, 0.2f, 0.4f, 1.0f}};
+    _multiviewRenderGraph->clearValues[1].depthStencil = VkClearDepthStencilValue{0.0f, 0};
+
+    // the scene is culled against the centre camera, so objects only just inside the edge of one eye's frustum may be missed
+    _multiviewRenderGraph->addChild(vsg::View::create(camera, scene));
+
+    _createTargets(window->extent2D());
+
+    auto compositeCamera = vsg::Camera::create(vsg::Orthographic::create(), vsg::LookAt::create(), vsg::ViewportState::create(_extent));
+    auto compositeRenderGraph = vsg::createRenderGraphForView(window, compositeCamera, _createComposite());
+
+    auto commandGraph = vsg::CommandGraph::create(window);
+    commandGraph->addChild(_multiviewRenderGraph);
+    commandGraph->addChild(compositeRenderGraph);
+    return commandGraph;
+}
+
+bool MultiviewStereo::resize(vsg::Viewer& viewer)
+{
+    if (!_window || !_multiviewRenderGraph) return false;
+
+    auto extent = _window->extent2D();
+    if (extent.width == _extent.width && extent.height == _extent.height) return false;
+
+    // the swapchain has been rebuilt so rebuild the layers to match, and point the composite at them
+    viewer.deviceWaitIdle();
+
+    _createTargets(extent);
+
+    auto bindDescriptorSet = _bindLayers();
+    _composite->stateCommands.back() = bindDescriptorSet;
+
+    auto result = viewer.compileManager->compile(bindDescriptorSet);
+    if (result) vsg::updateViewer(viewer, result);
+
+    // our RenderGraph isn't associated with the window so the WindowResizeHandler won't update the camera, do it here
+    double aspectRatio = static_cast<double>(extent.width) / static_cast<double>(extent.height);
+    if (_camera->viewportState) _camera->viewportState->set(0, 0, extent.width, extent.height);
+    if (auto perspective = _camera->projectionMatrix.cast<vsg::Perspective>())
+        perspective->aspectRatio = aspectRatio;
+    else if (auto ellipsoidPerspective = _camera->projectionMatrix.cast<vsg::EllipsoidPerspective>())
+        ellipsoidPerspective->aspectRatio = aspectRatio;
+
+    return true;
+}
+
+void MultiviewStereo::_createTargets(const VkExtent2D& extent)
+{
+    auto context = vsg::Context::create(_window->getOrCreateDevice());
+
+    // one layer per eye
+    auto createLayers = [&](VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect) {
+        auto image = vsg::Image::create();
+        image->imageType = VK_IMAGE_TYPE_2D;
+        image->format = format;
+        image->extent = VkExtent3D{extent.width, extent.height, 1};
+        image->mipLevels = 1;
+        image->arrayLayers = 2;
+        image->samples = VK_SAMPLE_COUNT_1_BIT;
+        image->tiling = VK_IMAGE_TILING_OPTIMAL;
+        image->usage = usage;
+        image->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        auto imageView = vsg::ImageView::create(image, aspect);
+        imageView->viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        imageView->subresourceRange = {aspect, 0, 1, 0, 2};
+        imageView->compile(*context);
+        return imageView;
+    };
+
+    _extent = extent;
+    _colorLayers = createLayers(_colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+    auto depthLayers = createLayers(_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    // multiview framebuffers have a single layer, the view mask selects the image layers
+    _multiviewRenderGraph->framebuffer = vsg::Framebuffer::create(_renderPass, vsg::ImageViews{_colorLayers, depthLayers}, extent.width, extent.height, 1);
+    _multiviewRenderGraph->renderArea.extent = extent;
+}
+
+vsg::ref_ptr<vsg::BindDescriptorSet> MultiviewStereo::_bindLayers()
+{
+    auto layers = vsg::ImageInfo::create(_sampler, _colorLayers, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    auto texture = vsg::DescriptorImage::create(layers, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    auto descriptorSet = vsg::DescriptorSet::create(_compositeDescriptorSetLayout, vsg::Descriptors{texture});
+    return vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, _compositePipelineLayout, 0, descriptorSet);
+}
+
+vsg::ref_ptr<vsg::Node> MultiviewStereo::_createComposite()
+{
+    std::string fragmentSource = composite_frag;
+    if (composite == SIDE_BY_SIDE) fragmentSource.insert(fragmentSource.find('\n', 1) + 1, "#define SIDE_BY_SIDE\n");
+
+    auto vertexShader = vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", composite_vert);
+    auto fragmentShader = vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", fragmentSource);
+
+    vsg::DescriptorSetLayoutBindings descriptorBindings{
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}};
+    _compositeDescriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+
+    vsg::PushConstantRanges pushConstantRanges{
+        {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // not used by the shaders, but the View always pushes the projection and modelview matrices
+    };
+
+    auto rasterizationState = vsg::RasterizationState::create();
+    rasterizationState->cullMode = VK_CULL_MODE_NONE;
+
+    auto depthStencilState = vsg::DepthStencilState::create();
+    depthStencilState->depthTestEnable = VK_FALSE;
+    depthStencilState->depthWriteEnable = VK_FALSE;
+
+    vsg::GraphicsPipelineStates pipelineStates{
+        vsg::VertexInputState::create(),
+        vsg::InputAssemblyState::create(),
+        rasterizationState,
+        vsg::MultisampleState::create(),
+        vsg::ColorBlendState::create(),
+        depthStencilState};
+
+    _compositePipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{_compositeDescriptorSetLayout}, pushConstantRanges);
+    auto graphicsPipeline = vsg::GraphicsPipeline::create(_compositePipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
+
+    _sampler = vsg::Sampler::create();
+    _sampler->magFilter = VK_FILTER_LINEAR;
+    _sampler->minFilter = VK_FILTER_LINEAR;
+    _sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    _sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    _sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    // the layers are bound last so resize() can replace the binding
+    _composite = vsg::StateGroup::create();
+    _composite->add(vsg::BindGraphicsPipeline::create(graphicsPipeline));
+    _composite->add(_bindLayers());
+    _composite->addChild(vsg::Draw::create(3, 1, 0, 0));
+    return _composite;
+}
+
+void MultiviewStereo::update(const vsg::Camera& centre, const vsg::Camera& left, const vsg::Camera& right)
+{
+    // gl_Position from the centre camera, back to world coordinates, then forward through each eye's camera
+    auto inverseCentre = vsg::inverse(centre.projectionMatrix->transform() * centre.viewMatrix->transform());
+    eyeMatrices->set(0, vsg::mat4(left.projectionMatrix->transform() * left.viewMatrix->transform() * inverseCentre));
+    eyeMatrices->set(1, vsg::mat4(right.projectionMatrix->transform() * right.viewMatrix->transform() * inverseCentre));
+    eyeMatrices->dirty();
+}
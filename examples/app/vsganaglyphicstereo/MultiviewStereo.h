@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <map>
+
+// Single pass stereo using VK_KHR_multiview. The scene is recorded once, by a View using the centre camera, into a render
+// pass whose subpass viewMask covers both layers of a 2 layer colour and depth target, so every draw is broadcast to both
+// eyes. Each converted vertex shader maps its centre camera gl_Position to the eye for gl_ViewIndex using
+// eyeMatrices[i] = eyeProjection * eyeView * inverse(view) * inverse(projection), stored in a uniform bound at the first
+// free descriptor set of each pipeline layout. A final pass then composites the two layers into the window as an
+// anaglyph or side by side.
+class MultiviewStereo : public vsg::Inherit<vsg::Object, MultiviewStereo>
+{
+public:
+    MultiviewStereo();
+
+    enum Composite
+    {
+        ANAGLYPH,
+        SIDE_BY_SIDE
+    };
+
+    Composite composite = ANAGLYPH;
+
+    // multiview is core in Vulkan 1.1, but the feature still has to be enabled on the device
+    static void enableMultiview(vsg::WindowTraits& windowTraits);
+
+    // patch the GLSL vertex shaders of the scene graph to apply the eye matrices, shaders without GLSL source or with
+    // geometry/tessellation stages after them can't be converted. Returns the number of pipelines that weren't converted.
+    uint32_t convertScene(vsg::Node& scene);
+
+    // create the command graph recording the scene into the layered target then compositing it into the window
+    vsg::ref_ptr<vsg::CommandGraph> createCommandGraph(vsg::ref_ptr<vsg::Window> window, vsg::ref_ptr<vsg::Camera> camera, vsg::ref_ptr<vsg::Node> scene);
+
+    // rebuild the layered targets if the window has been resized, call after viewer->handleEvents()
+    bool resize(vsg::Viewer& viewer);
+
+    // compute the eye matrices for this frame, call after the cameras have been updated and before recordAndSubmit()
+    void update(const vsg::Camera& centre, const vsg::Camera& left, const vsg::Camera& right);
+
+    vsg::ref_ptr<vsg::mat4Array> eyeMatrices;
+    vsg::ref_ptr<vsg::DescriptorSetLayout> eyeDescriptorSetLayout;
+    vsg::ref_ptr<vsg::DescriptorSet> eyeDescriptorSet;
+
+protected:
+    bool _convertShader(vsg::ShaderStage& shaderStage, uint32_t set);
+    void _createTargets(const VkExtent2D& extent);
+    vsg::ref_ptr<vsg::BindDescriptorSet> _bindLayers();
+    vsg::ref_ptr<vsg::Node> _createComposite();
+
+    std::map<vsg::PipelineLayout*, uint32_t> _layoutSets;
+    std::map<vsg::ShaderModule*, uint32_t> _convertedModules;
+
+    const VkFormat _colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    const VkFormat _depthFormat = VK_FORMAT_D32_SFLOAT;
+    VkExtent2D _extent{0, 0};
+
+    vsg::ref_ptr<vsg::Window> _window;
+    vsg::ref_ptr<vsg::Camera> _camera;
+    vsg::ref_ptr<vsg::RenderPass> _renderPass;
+    vsg::ref_ptr<vsg::RenderGraph> _multiviewRenderGraph;
+    vsg::ref_ptr<vsg::ImageView> _colorLayers;
+
+    vsg::ref_ptr<vsg::Sampler> _sampler;
+    vsg::ref_ptr<vsg::DescriptorSetLayout> _compositeDescriptorSetLayout;
+    vsg::ref_ptr<vsg::PipelineLayout> _compositePipelineLayout;
+    vsg::ref_ptr<vsg::StateGroup> _composite;
+};
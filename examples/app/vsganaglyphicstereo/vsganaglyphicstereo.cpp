@@ -7,6 +7,9 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "FrameTrace.h"
+#include "MultiviewStereo.h"
+
 namespace vsg
 {
     class PerViewGraphicsPipelineState : public Inherit<GraphicsPipelineState, PerViewGraphicsPipelineState>
@@ -227,9 +230,26 @@ int main(int argc, char** argv)
     vsg::Path leftImageFilename, rightImageFilename;
     arguments.read({"-s", "--stereo-pair"}, leftImageFilename, rightImageFilename);
 
+    // record the scene once for both eyes using VK_KHR_multiview, compositing the eyes as an anaglyph or side by side
+    bool multiview = arguments.read("--multiview");
+    bool sideBySide = arguments.read("--side-by-side");
+    if (sideBySide) multiview = true;
+
+    if (multiview && leftImageFilename && rightImageFilename)
+    {
+        // the stereo pair quads are selected per eye by View masks, which a single multiview View can't do
+        std::cout << "--multiview not supported with --stereo-pair, falling back to a View per eye." << std::endl;
+        multiview = false;
+    }
+
+    if (multiview) MultiviewStereo::enableMultiview(*windowTraits);
+
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     auto options = vsg::Options::create();
+    if (frameTrace) frameTrace->addReaderWriter(*options);
     options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
     options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
 #ifdef vsgXchange_all
@@ -276,9 +296,23 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    // ColorBlendState needs to be overridden per View, so remove existing instances in the scene graph
-    ReplaceColorBlendState removeColorBlendState;
-    vsg_scene->accept(removeColorBlendState);
+    vsg::ref_ptr<MultiviewStereo> multiviewStereo;
+    if (multiview)
+    {
+        // each layer gets the full colour of its eye, the composite pass then picks the channels
+        multiviewStereo = MultiviewStereo::create();
+        multiviewStereo->composite = sideBySide ? MultiviewStereo::SIDE_BY_SIDE : MultiviewStereo::ANAGLYPH;
+        if (auto numNotConverted = multiviewStereo->convertScene(*vsg_scene); numNotConverted > 0)
+        {
+            std::cout << "Warning: " << numNotConverted << " pipelines without GLSL vertex shader source couldn't be converted to multiview." << std::endl;
+        }
+    }
+    else
+    {
+        // ColorBlendState needs to be overridden per View, so remove existing instances in the scene graph
+        ReplaceColorBlendState removeColorBlendState;
+        vsg_scene->accept(removeColorBlendState);
+    }
 
     // create the viewer and assign window(s) to it
     auto viewer = vsg::Viewer::create();
@@ -332,36 +366,56 @@ int main(int argc, char** argv)
     // add event handlers, in the order we wish event to be handled.
     viewer->addEventHandler(vsg::Trackball::create(master_camera, ellipsoidModel));
 
-    auto renderGraph = vsg::RenderGraph::create(window);
-
-    auto left_view = vsg::View::create(left_camera, vsg_scene);
-    left_view->mask = leftMask;
-    renderGraph->addChild(left_view);
-
-    // clear the depth buffer before view2 gets rendered
-    VkClearValue clearValue{};
-    clearValue.depthStencil = {0.0f, 0};
-    VkClearAttachment depth_attachment{VK_IMAGE_ASPECT_DEPTH_BIT, 1, clearValue};
-    VkClearRect rect{right_camera->getRenderArea(), 0, 1};
-    auto clearAttachments = vsg::ClearAttachments::create(vsg::ClearAttachments::Attachments{depth_attachment}, vsg::ClearAttachments::Rects{rect});
-    renderGraph->addChild(clearAttachments);
+    vsg::ref_ptr<vsg::CommandGraph> commandGraph;
+    if (multiviewStereo)
+    {
+        commandGraph = multiviewStereo->createCommandGraph(window, master_camera, vsg_scene);
+    }
+    else
+    {
+        auto renderGraph = vsg::RenderGraph::create(window);
+
+        auto left_view = vsg::View::create(left_camera, vsg_scene);
+        left_view->mask = leftMask;
+        renderGraph->addChild(left_view);
+
+        // clear the depth buffer before view2 gets rendered
+        VkClearValue clearValue{};
+        clearValue.depthStencil = {0.0f, 0};
+        VkClearAttachment depth_attachment{VK_IMAGE_ASPECT_DEPTH_BIT, 1, clearValue};
+        VkClearRect rect{right_camera->getRenderArea(), 0, 1};
+        auto clearAttachments = vsg::ClearAttachments::create(vsg::ClearAttachments::Attachments{depth_attachment}, vsg::ClearAttachments::Rects{rect});
+        renderGraph->addChild(clearAttachments);
+
+        auto right_view = vsg::View::create(right_camera, vsg_scene);
+        right_view->mask = rightMask;
+        renderGraph->addChild(right_view);
+
+        commandGraph = vsg::CommandGraph::create(window);
+        commandGraph->addChild(renderGraph);
+    }
 
-    auto right_view = vsg::View::create(right_camera, vsg_scene);
-    right_view->mask = rightMask;
-    renderGraph->addChild(right_view);
+    if (frameTrace) frameTrace->addTimestamps(*commandGraph);
 
-    auto commandGraph = vsg::CommandGraph::create(window);
-    commandGraph->addChild(renderGraph);
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     // rendering main loop
     while (viewer->advanceToNextFrame())
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        if (multiviewStereo) multiviewStereo->resize(*viewer);
+
+        traceFrame.phase("update");
         viewer->update();
 
         double lookDistance = vsg::length(lookAt->center - lookAt->eye);
@@ -371,11 +425,21 @@ int main(int argc, char** argv)
         left_relative_view->matrix = vsg::translate(horizontalSeperation, 0.0, 0.0);
         right_relative_view->matrix = vsg::translate(-horizontalSeperation, 0.0, 0.0);
 
+        if (multiviewStereo) multiviewStereo->update(*master_camera, *left_camera, *right_camera);
+
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        traceFrame.phase("present");
         viewer->present();
     }
 
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -0,0 +1,380 @@
+#include "BenchmarkRunner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+#if defined(_WIN32)
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#    include <psapi.h>
+#else
+#    include <sys/resource.h>
+#endif
+
+namespace
+{
+    double milliseconds(vsg::clock::duration duration)
+    {
+        return std::chrono::duration<double, std::chrono::milliseconds::period>(duration).count();
+    }
+
+    // peak resident set size of the process in bytes
+    size_t peakResidentSetSize()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.PeakWorkingSetSize;
+        return 0;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#    if defined(__APPLE__)
+        return static_cast<size_t>(usage.ru_maxrss);
+#    else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#    endif
+#endif
+    }
+
+    vsg::ref_ptr<vsg::ImageView> createAttachment(vsg::ref_ptr<vsg::Device> device, const VkExtent2D& extent, VkFormat format, VkImageUsageFlags usage)
+    {
+        auto image = vsg::Image::create();
+        image->imageType = VK_IMAGE_TYPE_2D;
+        image->format = format;
+        image->extent = VkExtent3D{extent.width, extent.height, 1};
+        image->mipLevels = 1;
+        image->arrayLayers = 1;
+        image->samples = VK_SAMPLE_COUNT_1_BIT;
+        image->tiling = VK_IMAGE_TILING_OPTIMAL;
+        image->usage = usage;
+        image->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        return vsg::createImageView(device, image, vsg::computeAspectFlagsForFormat(format));
+    }
+
+    void writeString(std::ostream& out, const std::string& str)
+    {
+        out << '"';
+        for (auto c : str)
+        {
+            if (c == '"' || c == '\\') out << '\\' << c;
+            else if (c == '\n') out << "\\n";
+            else if (static_cast<unsigned char>(c) >= 0x20) out << c;
+        }
+        out << '"';
+    }
+
+    // mean, percentiles and maximum of a series of milliseconds
+    void writeSeries(std::ostream& out, const std::string& indent, const char* name, std::vector<double> values, bool last = false)
+    {
+        out << indent << '"' << name << "\": ";
+        if (values.empty())
+        {
+            out << "null" << (last ? "" : ",") << "\n";
+            return;
+        }
+
+        std::sort(values.begin(), values.end());
+        auto percentile = [&](double p) {
+            // nearest rank
+            size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(values.size())));
+            return values[std::clamp(rank, size_t(1), values.size()) - 1];
+        };
+        double mean = std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+
+        out << "{\"mean\": " << mean << ", \"p50\": " << percentile(0.5) << ", \"p90\": " << percentile(0.9) << ", \"p99\": " << percentile(0.99)
+            << ", \"min\": " << values.front() << ", \"max\": " << values.back() << "}" << (last ? "" : ",") << "\n";
+    }
+} // namespace
+
+void BenchmarkResult::write(std::ostream& out, const std::string& indent) const
+{
+    std::string inner = indent + "  ";
+
+    out << indent << "{\n";
+    out << inner << "\"name\": ";
+    writeString(out, name);
+    out << ",\n" << inner << "\"status\": ";
+    writeString(out, status);
+    out << ",\n";
+    if (!message.empty())
+    {
+        out << inner << "\"message\": ";
+        writeString(out, message);
+        out << ",\n";
+    }
+    out << inner << "\"frames\": " << numFrames << ",\n";
+    out << inner << "\"setup_ms\": " << setupTime << ",\n";
+    out << inner << "\"compile_ms\": " << compileTime << ",\n";
+    writeSeries(out, inner, "frame_ms", frameTimes);
+    writeSeries(out, inner, "cpu_update_ms", updateTimes);
+    writeSeries(out, inner, "cpu_record_and_submit_ms", recordAndSubmitTimes);
+    writeSeries(out, inner, "cpu_wait_ms", waitTimes);
+    writeSeries(out, inner, "gpu_ms", gpuTimes);
+    out << inner << "\"memory\": {\"peak_rss_bytes\": " << peakResidentSetSize << ", \"device_local_bytes\": " << deviceLocalUsage << "},\n";
+    out << inner << "\"values\": {";
+    for (auto itr = values.begin(); itr != values.end(); ++itr)
+    {
+        if (itr != values.begin()) out << ", ";
+        writeString(out, itr->first);
+        out << ": " << itr->second;
+    }
+    out << "}\n";
+    out << indent << "}";
+}
+
+BenchmarkRunner::BenchmarkRunner(vsg::ref_ptr<vsg::Device> in_device, int in_queueFamily, const VkExtent2D& in_extent, bool in_memoryBudget) :
+    device(in_device),
+    queueFamily(in_queueFamily),
+    extent(in_extent),
+    memoryBudget(in_memoryBudget)
+{
+    VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+
+    // one framebuffer is shared by every scenario, they are run one after another
+    auto colorImageView = createAttachment(device, extent, colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+    auto depthImageView = createAttachment(device, extent, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    auto renderPass = vsg::createRenderPass(device, colorFormat, depthFormat, true);
+    _framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{colorImageView, depthImageView}, extent.width, extent.height, 1);
+}
+
+vsg::ref_ptr<vsg::RenderGraph> BenchmarkRunner::_createRenderGraph(vsg::ref_ptr<vsg::Camera> camera, vsg::ref_ptr<vsg::Node> scene)
+{
+    auto renderGraph = vsg::RenderGraph::create();
+    renderGraph->framebuffer = _framebuffer;
+    renderGraph->renderArea.offset = {0, 0};
+    renderGraph->renderArea.extent = extent;
+    renderGraph->setClearValues({{0.2f, 0.2f, 0.4f, 1.0f}}, VkClearDepthStencilValue{0.0f, 0});
+
+    if (scene) renderGraph->addChild(vsg::View::create(camera, scene));
+    else renderGraph->addChild(vsg::View::create(camera));
+    return renderGraph;
+}
+
+size_t BenchmarkRunner::deviceLocalUsage() const
+{
+    if (!memoryBudget) return 0;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budget;
+
+    vkGetPhysicalDeviceMemoryProperties2(device->getPhysicalDevice()->vk(), &properties);
+
+    size_t usage = 0;
+    for (uint32_t i = 0; i < properties.memoryProperties.memoryHeapCount; ++i)
+    {
+        if (properties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) usage += static_cast<size_t>(budget.heapUsage[i]);
+    }
+    return usage;
+}
+
+BenchmarkResult BenchmarkRunner::run(const Scenario& scenario)
+{
+    BenchmarkResult result;
+    result.name = scenario.name;
+    result.setupTime = scenario.setupTime;
+
+    if (!scenario.scene)
+    {
+        result.status = "failed";
+        result.message = "no scene created";
+        return result;
+    }
+
+    // set up the camera to view the whole scene as vsgheadless does, scenarios may move it in their update
+    vsg::ComputeBounds computeBounds;
+    scenario.scene->accept(computeBounds);
+    vsg::dvec3 centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
+    double radius = std::max(vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.6, 1.0);
+    double nearFarRatio = 0.0001;
+
+    auto lookAt = vsg::LookAt::create(centre + vsg::dvec3(0.0, -radius * 1.5, radius * 1.5), centre, vsg::dvec3(0.0, 0.0, 1.0));
+    vsg::ref_ptr<vsg::ProjectionMatrix> perspective;
+    double aspectRatio = static_cast<double>(extent.width) / static_cast<double>(extent.height);
+    if (auto ellipsoidModel = scenario.scene->getRefObject<vsg::EllipsoidModel>("EllipsoidModel"))
+        perspective = vsg::EllipsoidPerspective::create(lookAt, ellipsoidModel, 30.0, aspectRatio, nearFarRatio, 0.0);
+    else
+        perspective = vsg::Perspective::create(30.0, aspectRatio, nearFarRatio * radius, radius * 10.0);
+    auto camera = vsg::Camera::create(perspective, lookAt, vsg::ViewportState::create(extent));
+
+    auto queryPool = vsg::QueryPool::create();
+    queryPool->queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPool->queryCount = 2;
+
+    auto commandGraph = vsg::CommandGraph::create(device, queueFamily);
+    commandGraph->addChild(vsg::ResetQueryPool::create(queryPool));
+    commandGraph->addChild(vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0));
+    commandGraph->addChild(_createRenderGraph(camera, scenario.scene));
+    commandGraph->addChild(vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1));
+
+    auto viewer = vsg::Viewer::create();
+    viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
+
+    auto compileStart = vsg::clock::now();
+    viewer->compile();
+    result.compileTime = milliseconds(vsg::clock::now() - compileStart);
+
+    double timestampPeriod = device->getPhysicalDevice()->getProperties().limits.timestampPeriod;
+    uint64_t waitTimeout = 1999999999; // 1second in nanoseconds.
+    std::vector<uint64_t> timestamps(2);
+
+    uint64_t frame = 0;
+    uint64_t totalFrames = uint64_t(numWarmupFrames) + numFrames;
+    while (frame < totalFrames && viewer->advanceToNextFrame())
+    {
+        auto frameStart = vsg::clock::now();
+
+        viewer->handleEvents();
+        if (scenario.update) scenario.update(frame, *lookAt);
+        viewer->update();
+
+        auto recordStart = vsg::clock::now();
+        viewer->recordAndSubmit();
+
+        auto waitStart = vsg::clock::now();
+        viewer->waitForFences(0, waitTimeout);
+        auto frameEnd = vsg::clock::now();
+
+        if (frame >= numWarmupFrames)
+        {
+            result.frameTimes.push_back(milliseconds(frameEnd - frameStart));
+            result.updateTimes.push_back(milliseconds(recordStart - frameStart));
+            result.recordAndSubmitTimes.push_back(milliseconds(waitStart - recordStart));
+            result.waitTimes.push_back(milliseconds(frameEnd - waitStart));
+
+            if (queryPool->getResults(timestamps) == VK_SUCCESS)
+            {
+                result.gpuTimes.push_back(timestampPeriod * 1e-6 * static_cast<double>(timestamps[1] - timestamps[0]));
+            }
+        }
+        ++frame;
+    }
+
+    viewer->deviceWaitIdle();
+
+    result.numFrames = static_cast<uint32_t>(result.frameTimes.size());
+    result.peakResidentSetSize = peakResidentSetSize();
+    result.deviceLocalUsage = deviceLocalUsage();
+
+    if (scenario.complete) scenario.complete(*viewer, result);
+
+    return result;
+}
+
+BenchmarkResult BenchmarkRunner::runLoadAndCompile(const std::string& name, const std::vector<std::string>& models, vsg::ref_ptr<vsg::Options> options, uint32_t numThreads)
+{
+    BenchmarkResult result;
+    result.name = name;
+
+    // a viewer with an empty view gives the CompileManager the render pass and view the models are compiled for
+    auto camera = vsg::Camera::create(vsg::Perspective::create(), vsg::LookAt::create(), vsg::ViewportState::create(extent));
+    auto commandGraph = vsg::CommandGraph::create(device, queueFamily);
+    commandGraph->addChild(_createRenderGraph(camera, {}));
+
+    auto viewer = vsg::Viewer::create();
+    viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
+    viewer->compile();
+
+    auto readOptions = vsg::Options::create(*options);
+    readOptions->extensionHint = ".vsgb";
+
+    std::atomic_size_t nextModel{0};
+    std::atomic_size_t numFailed{0};
+    std::mutex timesMutex;
+    std::vector<double> loadTimes, compileTimes;
+
+    auto start = vsg::clock::now();
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < std::max(numThreads, 1u); ++t)
+    {
+        threads.emplace_back([&]() {
+            for (size_t i = nextModel++; i < models.size(); i = nextModel++)
+            {
+                auto loadStart = vsg::clock::now();
+                std::istringstream stream(models[i]);
+                auto node = vsg::read_cast<vsg::Node>(stream, readOptions);
+                auto compileStart = vsg::clock::now();
+
+                auto compileResult = node ? viewer->compileManager->compile(node) : vsg::CompileResult{};
+                auto compileEnd = vsg::clock::now();
+
+                if (!node || !compileResult) ++numFailed;
+
+                std::scoped_lock<std::mutex> lock(timesMutex);
+                loadTimes.push_back(milliseconds(compileStart - loadStart));
+                compileTimes.push_back(milliseconds(compileEnd - compileStart));
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    double duration = milliseconds(vsg::clock::now() - start);
+
+    viewer->deviceWaitIdle();
+
+    size_t numBytes = 0;
+    for (auto& model : models) numBytes += model.size();
+
+    // the per model load and compile times go in the update and record series, there are no frames
+    result.updateTimes = loadTimes;
+    result.recordAndSubmitTimes = compileTimes;
+    result.peakResidentSetSize = peakResidentSetSize();
+    result.deviceLocalUsage = deviceLocalUsage();
+    result.values["models"] = static_cast<double>(models.size());
+    result.values["failed"] = static_cast<double>(numFailed.load());
+    result.values["threads"] = static_cast<double>(threads.size());
+    result.values["total_ms"] = duration;
+    result.values["models_per_second"] = duration > 0.0 ? static_cast<double>(models.size()) * 1000.0 / duration : 0.0;
+    result.values["megabytes_per_second"] = duration > 0.0 ? static_cast<double>(numBytes) / 1000.0 / duration : 0.0;
+
+    if (numFailed > 0)
+    {
+        result.status = "failed";
+        result.message = vsg::make_string(numFailed.load(), " models failed to load or compile");
+    }
+    return result;
+}
+
+void writeReport(std::ostream& out, vsg::PhysicalDevice& physicalDevice, const std::map<std::string, std::string>& settings, const std::vector<BenchmarkResult>& results)
+{
+    auto& properties = physicalDevice.getProperties();
+
+    out << "{\n";
+    out << "  \"device\": {\"name\": ";
+    writeString(out, properties.deviceName);
+    out << ", \"vendor_id\": " << properties.vendorID << ", \"device_id\": " << properties.deviceID << ", \"driver_version\": " << properties.driverVersion
+        << ", \"api_version\": " << properties.apiVersion << "},\n";
+
+    out << "  \"settings\": {";
+    for (auto itr = settings.begin(); itr != settings.end(); ++itr)
+    {
+        if (itr != settings.begin()) out << ", ";
+        writeString(out, itr->first);
+        out << ": ";
+        writeString(out, itr->second);
+    }
+    out << "},\n";
+
+    out << "  \"scenarios\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        results[i].write(out, "    ");
+        out << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
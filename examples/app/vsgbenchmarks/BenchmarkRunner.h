@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Result of one scenario, written as one element of the "scenarios" array of the JSON report
+struct BenchmarkResult
+{
+    std::string name;
+    std::string status = "ok"; // "ok", "skipped" or "failed"
+    std::string message;
+
+    uint32_t numFrames = 0;
+    double setupTime = 0.0;   // milliseconds creating the scene
+    double compileTime = 0.0; // milliseconds in Viewer::compile()
+
+    // per frame milliseconds
+    std::vector<double> frameTimes;
+    std::vector<double> updateTimes;          // handleEvents(), update() and the scenario's own update
+    std::vector<double> recordAndSubmitTimes; // recordAndSubmit(), including culling and dynamic data transfers
+    std::vector<double> waitTimes;            // waiting on the frame's fence, the part of the frame the CPU was GPU bound
+    std::vector<double> gpuTimes;             // between timestamps at the start and end of the command graph
+
+    size_t peakResidentSetSize = 0; // bytes, for the whole process at the end of the scenario
+    size_t deviceLocalUsage = 0;    // bytes, from VK_EXT_memory_budget when supported
+
+    // scenario specific values, such as the number of tiles paged in or models loaded per second
+    std::map<std::string, double> values;
+
+    void write(std::ostream& out, const std::string& indent) const;
+};
+
+// Renders scenarios offscreen on one device, vsgheadless style, each frame waiting for the previous to complete so
+// frames don't overlap and the CPU and GPU times of a frame can be attributed to it. Frames are paced by count rather
+// than by wall clock, with the scenario's update called with the frame index, so repeated runs render the same frames.
+class BenchmarkRunner : public vsg::Inherit<vsg::Object, BenchmarkRunner>
+{
+public:
+    BenchmarkRunner(vsg::ref_ptr<vsg::Device> in_device, int in_queueFamily, const VkExtent2D& in_extent, bool in_memoryBudget);
+
+    const vsg::ref_ptr<vsg::Device> device;
+    const int queueFamily;
+    const VkExtent2D extent;
+    const bool memoryBudget; // VK_EXT_memory_budget is enabled on device
+
+    uint32_t numWarmupFrames = 10;
+    uint32_t numFrames = 300;
+
+    struct Scenario
+    {
+        std::string name;
+        vsg::ref_ptr<vsg::Node> scene;
+        double setupTime = 0.0;
+
+        // called before each frame, including warm up frames, with the frame index and the camera's LookAt
+        std::function<void(uint64_t frame, vsg::LookAt& lookAt)> update;
+
+        // called after the frames, to add scenario specific values
+        std::function<void(vsg::Viewer& viewer, BenchmarkResult& result)> complete;
+    };
+
+    BenchmarkResult run(const Scenario& scenario);
+
+    // load then compile each of the serialized models, from numThreads threads
+    BenchmarkResult runLoadAndCompile(const std::string& name, const std::vector<std::string>& models, vsg::ref_ptr<vsg::Options> options, uint32_t numThreads);
+
+    size_t deviceLocalUsage() const;
+
+protected:
+    vsg::ref_ptr<vsg::RenderGraph> _createRenderGraph(vsg::ref_ptr<vsg::Camera> camera, vsg::ref_ptr<vsg::Node> scene);
+
+    vsg::ref_ptr<vsg::Framebuffer> _framebuffer;
+};
+
+// write the device and settings followed by the results as a JSON document
+void writeReport(std::ostream& out, vsg::PhysicalDevice& physicalDevice, const std::map<std::string, std::string>& settings, const std::vector<BenchmarkResult>& results);
@@ -0,0 +1,208 @@
+#include "BenchmarkScenes.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    uint32_t numColumns(uint32_t count)
+    {
+        return std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count)))));
+    }
+
+    vsg::vec3 gridPosition(uint32_t i, uint32_t columns, float spacing)
+    {
+        return vsg::vec3(static_cast<float>(i % columns) * spacing, static_cast<float>(i / columns) * spacing, 0.0f);
+    }
+
+    // a color that differs for each index, cycling through hues
+    vsg::vec4 indexColor(uint32_t i)
+    {
+        float h = static_cast<float>((i * 37u) % 360u) / 60.0f;
+        float x = 1.0f - std::fabs(std::fmod(h, 2.0f) - 1.0f);
+        switch (static_cast<int>(h))
+        {
+        case 0: return vsg::vec4(1.0f, x, 0.0f, 1.0f);
+        case 1: return vsg::vec4(x, 1.0f, 0.0f, 1.0f);
+        case 2: return vsg::vec4(0.0f, 1.0f, x, 1.0f);
+        case 3: return vsg::vec4(0.0f, x, 1.0f, 1.0f);
+        case 4: return vsg::vec4(x, 0.0f, 1.0f, 1.0f);
+        default: return vsg::vec4(1.0f, 0.0f, x, 1.0f);
+        }
+    }
+} // namespace
+
+vsg::ref_ptr<vsg::Node> createDrawsScene(uint32_t count)
+{
+    auto builder = vsg::Builder::create();
+
+    vsg::GeometryInfo geomInfo;
+    geomInfo.dx.set(0.8f, 0.0f, 0.0f);
+    geomInfo.dy.set(0.0f, 0.8f, 0.0f);
+    geomInfo.dz.set(0.0f, 0.0f, 0.8f);
+
+    // the Builder reuses the state of the same StateInfo, so every box binds the same pipeline and descriptor set
+    vsg::StateInfo stateInfo;
+
+    auto group = vsg::Group::create();
+    auto columns = numColumns(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        geomInfo.position = gridPosition(i, columns, 1.0f);
+        group->addChild(builder->createBox(geomInfo, stateInfo));
+    }
+    return group;
+}
+
+vsg::ref_ptr<vsg::Node> createStateChangesScene(uint32_t count)
+{
+    auto builder = vsg::Builder::create();
+
+    vsg::GeometryInfo geomInfo;
+    geomInfo.dx.set(0.8f, 0.0f, 0.0f);
+    geomInfo.dy.set(0.0f, 0.8f, 0.0f);
+    geomInfo.dz.set(0.0f, 0.0f, 0.8f);
+
+    auto group = vsg::Group::create();
+    auto columns = numColumns(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        // a distinct 1x1 texture gives each box its own descriptor set
+        auto color = indexColor(i);
+        auto image = vsg::ubvec4Array2D::create(1, 1, vsg::Data::Properties{VK_FORMAT_R8G8B8A8_UNORM});
+        image->set(0, 0, vsg::ubvec4(static_cast<uint8_t>(color.r * 255.0f), static_cast<uint8_t>(color.g * 255.0f), static_cast<uint8_t>(color.b * 255.0f), static_cast<uint8_t>(i & 0xff)));
+
+        vsg::StateInfo stateInfo;
+        stateInfo.image = image;
+
+        geomInfo.position = gridPosition(i, columns, 1.0f);
+        group->addChild(builder->createBox(geomInfo, stateInfo));
+    }
+    return group;
+}
+
+vsg::ref_ptr<vsg::Node> createTextLabelsScene(uint32_t count, vsg::ref_ptr<vsg::Font> font, vsg::ref_ptr<vsg::Options> options)
+{
+    auto textgroup = vsg::TextGroup::create();
+
+    auto columns = numColumns(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        auto layout = vsg::StandardLayout::create();
+        layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
+        layout->position = gridPosition(i, columns, 10.0f);
+        layout->horizontal = vsg::vec3(1.0f, 0.0f, 0.0f);
+        layout->vertical = vsg::vec3(0.0f, 1.0f, 0.0f);
+        layout->color = vsg::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+
+        auto text = vsg::Text::create();
+        text->text = vsg::stringValue::create(vsg::make_string("Label ", i));
+        text->font = font;
+        text->layout = layout;
+        textgroup->addChild(text);
+    }
+
+    textgroup->setup(0, options);
+    return textgroup;
+}
+
+std::vector<vsg::ref_ptr<vsg::Node>> createModels(uint32_t count, uint32_t boxesPerModel)
+{
+    std::vector<vsg::ref_ptr<vsg::Node>> models;
+    models.reserve(count);
+
+    auto columns = numColumns(boxesPerModel);
+    for (uint32_t m = 0; m < count; ++m)
+    {
+        // a Builder per model so no state is shared between them, as with models written by different tools
+        auto builder = vsg::Builder::create();
+
+        vsg::GeometryInfo geomInfo;
+        geomInfo.dx.set(0.8f, 0.0f, 0.0f);
+        geomInfo.dy.set(0.0f, 0.8f, 0.0f);
+        geomInfo.dz.set(0.0f, 0.0f, 0.8f);
+        geomInfo.color = indexColor(m);
+
+        vsg::StateInfo stateInfo;
+
+        auto group = vsg::Group::create();
+        for (uint32_t i = 0; i < boxesPerModel; ++i)
+        {
+            geomInfo.position = gridPosition(i, columns, 1.0f);
+            group->addChild(builder->createBox(geomInfo, stateInfo));
+        }
+        models.push_back(group);
+    }
+    return models;
+}
+
+DynamicInstances::DynamicInstances(uint32_t in_count) :
+    count(std::max(in_count, 1u))
+{
+    positions = vsg::vec3Array::create(count);
+    positions->properties.dataVariance = vsg::DYNAMIC_DATA;
+    update(0);
+
+    auto builder = vsg::Builder::create();
+
+    vsg::GeometryInfo geomInfo;
+    geomInfo.dx.set(0.8f, 0.0f, 0.0f);
+    geomInfo.dy.set(0.0f, 0.8f, 0.0f);
+    geomInfo.dz.set(0.0f, 0.0f, 0.8f);
+    geomInfo.positions = positions;
+
+    vsg::StateInfo stateInfo;
+    stateInfo.instance_positions_vec3 = true;
+
+    scene = builder->createBox(geomInfo, stateInfo);
+}
+
+void DynamicInstances::update(uint64_t frame)
+{
+    auto columns = numColumns(count);
+    float phase = static_cast<float>(frame) * 0.05f;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        auto position = gridPosition(i, columns, 1.0f);
+        position.z = std::sin(phase + static_cast<float>(i) * 0.1f);
+        positions->set(i, position);
+    }
+    positions->dirty();
+}
+
+FlyThrough::FlyThrough(vsg::Node& scene, uint32_t in_numFrames) :
+    numFrames(std::max(in_numFrames, 1u))
+{
+    vsg::ComputeBounds computeBounds;
+    scene.accept(computeBounds);
+    _centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
+    _radius = std::max(vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.5, 1.0);
+
+    _ellipsoidModel = scene.getRefObject<vsg::EllipsoidModel>("EllipsoidModel");
+}
+
+void FlyThrough::apply(vsg::LookAt& lookAt, uint64_t frame) const
+{
+    double t = static_cast<double>(frame % numFrames) / static_cast<double>(numFrames);
+    double angle = 2.0 * vsg::PI * t;
+    double descent = std::sin(vsg::PI * t); // 0 at the start and end, 1 half way
+
+    if (_ellipsoidModel)
+    {
+        // circle the centre of the database a quarter of its extent out, dropping from above it all to near the surface
+        auto centre = _ellipsoidModel->convertECEFToLatLongAltitude(_centre);
+        double earthRadius = _ellipsoidModel->radiusEquator();
+        double circleRadius = vsg::degrees(std::min(_radius / earthRadius, 0.5)) * 0.25;
+        double altitude = _radius * (0.005 + 0.995 * (1.0 - descent));
+
+        auto eye = _ellipsoidModel->convertLatLongAltitudeToECEF(vsg::dvec3(centre.x + circleRadius * std::cos(angle), centre.y + circleRadius * std::sin(angle), altitude));
+        auto target = _ellipsoidModel->convertLatLongAltitudeToECEF(vsg::dvec3(centre.x + circleRadius * std::cos(angle + 0.3), centre.y + circleRadius * std::sin(angle + 0.3), 0.0));
+        lookAt.set(eye, target, vsg::normalize(eye));
+    }
+    else
+    {
+        double height = _radius * (0.05 + 1.95 * (1.0 - descent));
+        auto eye = _centre + vsg::dvec3(std::cos(angle) * _radius * 1.5, std::sin(angle) * _radius * 1.5, height);
+        lookAt.set(eye, _centre, vsg::dvec3(0.0, 0.0, 1.0));
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <vector>
+
+// Scenes for the vsgbenchmarks scenarios. Everything is generated from the scenario's counts, with no random numbers or
+// wall clock time, so each run of a scenario renders and uploads the same data in the same frames.
+
+// count boxes in a grid all with the same state, so the cost is dominated by the number of draws
+vsg::ref_ptr<vsg::Node> createDrawsScene(uint32_t count);
+
+// count boxes in a grid each with its own texture, and so its own descriptor set, bound before each draw
+vsg::ref_ptr<vsg::Node> createStateChangesScene(uint32_t count);
+
+// count text labels in a grid, laid out in one TextGroup
+vsg::ref_ptr<vsg::Node> createTextLabelsScene(uint32_t count, vsg::ref_ptr<vsg::Font> font, vsg::ref_ptr<vsg::Options> options);
+
+// count distinct small models, each a grid of boxes with its own colors, for measuring load and compile throughput
+std::vector<vsg::ref_ptr<vsg::Node>> createModels(uint32_t count, uint32_t boxesPerModel);
+
+// Instanced boxes whose positions are rewritten and uploaded every frame
+class DynamicInstances : public vsg::Inherit<vsg::Object, DynamicInstances>
+{
+public:
+    explicit DynamicInstances(uint32_t in_count);
+
+    const uint32_t count;
+
+    vsg::ref_ptr<vsg::vec3Array> positions;
+    vsg::ref_ptr<vsg::Node> scene;
+
+    // set the positions for frame and mark them for upload
+    void update(uint64_t frame);
+
+    size_t bytesPerFrame() const { return positions->dataSize(); }
+};
+
+// camera path for frame of numFrames that flies over the bounds of a scene, down to low altitude and back out again,
+// circling its centre once. Uses the scene's EllipsoidModel when it has one so geocentric databases are flown over
+// their surface.
+class FlyThrough : public vsg::Inherit<vsg::Object, FlyThrough>
+{
+public:
+    FlyThrough(vsg::Node& scene, uint32_t in_numFrames);
+
+    const uint32_t numFrames;
+
+    void apply(vsg::LookAt& lookAt, uint64_t frame) const;
+
+protected:
+    vsg::dvec3 _centre;
+    double _radius = 1.0;
+    vsg::ref_ptr<vsg::EllipsoidModel> _ellipsoidModel;
+};
@@ -0,0 +1,279 @@
+#include <vsg/all.h>
+
+#ifdef vsgXchange_FOUND
+#    include <vsgXchange/all.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "BenchmarkRunner.h"
+#include "BenchmarkScenes.h"
+
+namespace
+{
+    double millisecondsSince(vsg::clock::time_point start)
+    {
+        return std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+    }
+
+    // count the PagedLOD in a subgraph and those with their high resolution child loaded
+    class CountPagedLOD : public vsg::Inherit<vsg::Visitor, CountPagedLOD>
+    {
+    public:
+        size_t numPagedLOD = 0;
+        size_t numLoaded = 0;
+
+        using vsg::Visitor::apply;
+
+        void apply(vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(vsg::PagedLOD& plod) override
+        {
+            ++numPagedLOD;
+            if (plod.children[0].node) ++numLoaded;
+            plod.traverse(*this);
+        }
+    };
+
+    std::vector<std::string> split(const std::string& str, char separator)
+    {
+        std::vector<std::string> parts;
+        std::stringstream stream(str);
+        for (std::string part; std::getline(stream, part, separator);)
+        {
+            if (!part.empty()) parts.push_back(part);
+        }
+        return parts;
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        // set up defaults and read command line arguments to override them
+        vsg::CommandLine arguments(&argc, argv);
+
+        VkExtent2D extent{1920, 1080};
+        arguments.read({"--extent", "-w"}, extent.width, extent.height);
+        auto debugLayer = arguments.read({"--debug", "-d"});
+        auto outputFilename = arguments.value<vsg::Path>("", {"--output", "-o"});
+        auto scenarioNames = split(arguments.value(std::string("draws,state,text,paging,uploads,loading"), "--scenarios"), ',');
+        auto numFrames = arguments.value(300u, "-f");
+        auto numWarmupFrames = arguments.value(10u, "--warmup");
+
+        // scenario sizes
+        auto numDraws = arguments.value(10000u, "--draws");
+        auto numStates = arguments.value(5000u, "--states");
+        auto numLabels = arguments.value(100000u, "--labels");
+        auto fontFilename = arguments.value<vsg::Path>("fonts/times.vsgb", "--font");
+        auto pagedFilename = arguments.value<vsg::Path>("models/openstreetmap.vsgt", "--paged");
+        auto numInstances = arguments.value(100000u, "--instances");
+        auto numModels = arguments.value(200u, "--models");
+        auto boxesPerModel = arguments.value(64u, "--model-boxes");
+        auto numLoadThreads = arguments.value(std::max(std::thread::hardware_concurrency(), 1u), "--load-threads");
+
+        if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+        auto options = vsg::Options::create();
+        options->sharedObjects = vsg::SharedObjects::create();
+        options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
+        options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
+#ifdef vsgXchange_all
+        // add vsgXchange's support for reading and writing 3rd party file formats
+        options->add(vsgXchange::all::create());
+#endif
+
+        // create a headless instance and device, Vulkan 1.1 for vkGetPhysicalDeviceMemoryProperties2
+        vsg::Names instanceExtensions;
+        vsg::Names requestedLayers;
+        if (debugLayer)
+        {
+            instanceExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+            requestedLayers.push_back("VK_LAYER_KHRONOS_validation");
+        }
+        vsg::Names validatedNames = vsg::validateInstancelayerNames(requestedLayers);
+
+        auto instance = vsg::Instance::create(instanceExtensions, validatedNames, VK_API_VERSION_1_1);
+        auto [physicalDevice, queueFamily] = instance->getPhysicalDeviceAndQueueFamily(VK_QUEUE_GRAPHICS_BIT);
+        if (!physicalDevice || queueFamily < 0)
+        {
+            std::cout << "Could not create PhysicalDevice" << std::endl;
+            return 1;
+        }
+
+        vsg::Names deviceExtensions;
+        bool memoryBudget = false;
+        for (auto& extension : physicalDevice->enumerateDeviceExtensionProperties())
+        {
+            if (std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) memoryBudget = true;
+        }
+        if (memoryBudget) deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+        vsg::QueueSettings queueSettings{vsg::QueueSetting{queueFamily, {1.0}}};
+
+        auto deviceFeatures = vsg::DeviceFeatures::create();
+        deviceFeatures->get().samplerAnisotropy = VK_TRUE;
+
+        auto device = vsg::Device::create(physicalDevice, queueSettings, validatedNames, deviceExtensions, deviceFeatures);
+
+        auto runner = BenchmarkRunner::create(device, queueFamily, extent, memoryBudget);
+        runner->numFrames = numFrames;
+        runner->numWarmupFrames = numWarmupFrames;
+
+        std::vector<BenchmarkResult> results;
+        for (auto& name : scenarioNames)
+        {
+            auto setupStart = vsg::clock::now();
+
+            BenchmarkRunner::Scenario scenario;
+            scenario.name = name;
+
+            if (name == "draws")
+            {
+                scenario.scene = createDrawsScene(numDraws);
+                scenario.complete = [&](vsg::Viewer&, BenchmarkResult& result) { result.values["draws"] = numDraws; };
+            }
+            else if (name == "state")
+            {
+                scenario.scene = createStateChangesScene(numStates);
+                scenario.complete = [&](vsg::Viewer&, BenchmarkResult& result) { result.values["descriptor_sets"] = numStates; };
+            }
+            else if (name == "text")
+            {
+                auto font = vsg::read_cast<vsg::Font>(fontFilename, options);
+                if (!font)
+                {
+                    BenchmarkResult result;
+                    result.name = name;
+                    result.status = "skipped";
+                    result.message = vsg::make_string("unable to load font ", fontFilename);
+                    results.push_back(result);
+                    continue;
+                }
+                scenario.scene = createTextLabelsScene(numLabels, font, options);
+                scenario.complete = [&](vsg::Viewer&, BenchmarkResult& result) { result.values["labels"] = numLabels; };
+            }
+            else if (name == "paging")
+            {
+                auto scene = vsg::read_cast<vsg::Node>(pagedFilename, options);
+                if (!scene)
+                {
+                    BenchmarkResult result;
+                    result.name = name;
+                    result.status = "skipped";
+                    result.message = vsg::make_string("unable to load ", pagedFilename);
+                    results.push_back(result);
+                    continue;
+                }
+
+                // fly through in the measured frames, the warm up frames are spent at the starting point
+                auto flyThrough = FlyThrough::create(*scene, numFrames);
+                scenario.scene = scene;
+                scenario.update = [&, flyThrough](uint64_t frame, vsg::LookAt& lookAt) { flyThrough->apply(lookAt, frame < numWarmupFrames ? 0 : frame - numWarmupFrames); };
+                scenario.complete = [scene](vsg::Viewer&, BenchmarkResult& result) {
+                    CountPagedLOD countPagedLOD;
+                    scene->accept(countPagedLOD);
+                    result.values["paged_lod"] = static_cast<double>(countPagedLOD.numPagedLOD);
+                    result.values["paged_lod_loaded"] = static_cast<double>(countPagedLOD.numLoaded);
+                };
+            }
+            else if (name == "uploads")
+            {
+                auto dynamicInstances = DynamicInstances::create(numInstances);
+                scenario.scene = dynamicInstances->scene;
+                scenario.update = [dynamicInstances](uint64_t frame, vsg::LookAt&) { dynamicInstances->update(frame); };
+                scenario.complete = [dynamicInstances](vsg::Viewer&, BenchmarkResult& result) {
+                    result.values["instances"] = dynamicInstances->count;
+                    result.values["bytes_per_frame"] = static_cast<double>(dynamicInstances->bytesPerFrame());
+                };
+            }
+            else if (name == "loading")
+            {
+                // serialize the models to .vsgb in memory so the load times don't depend on the file system
+                auto writeOptions = vsg::Options::create();
+                writeOptions->extensionHint = ".vsgb";
+                auto vsgReaderWriter = vsg::VSG::create();
+
+                std::vector<std::string> models;
+                for (auto& model : createModels(numModels, boxesPerModel))
+                {
+                    std::ostringstream stream;
+                    vsgReaderWriter->write(model, stream, writeOptions);
+                    models.push_back(stream.str());
+                }
+
+                auto result = runner->runLoadAndCompile(name, models, options, numLoadThreads);
+                result.setupTime = millisecondsSince(setupStart);
+                results.push_back(result);
+                continue;
+            }
+            else
+            {
+                BenchmarkResult result;
+                result.name = name;
+                result.status = "skipped";
+                result.message = "unknown scenario";
+                results.push_back(result);
+                continue;
+            }
+
+            scenario.setupTime = millisecondsSince(setupStart);
+            results.push_back(runner->run(scenario));
+        }
+
+        std::map<std::string, std::string> settings;
+        settings["extent"] = vsg::make_string(extent.width, "x", extent.height);
+        settings["frames"] = vsg::make_string(numFrames);
+        settings["warmup_frames"] = vsg::make_string(numWarmupFrames);
+        settings["vsg_version"] = vsg::make_string(VSG_VERSION_STRING);
+        settings["validation"] = debugLayer ? "true" : "false";
+
+        if (outputFilename.empty())
+        {
+            writeReport(std::cout, *physicalDevice, settings, results);
+        }
+        else
+        {
+            std::ofstream fout(outputFilename.string());
+            writeReport(fout, *physicalDevice, settings, results);
+
+            for (auto& result : results)
+            {
+                std::cout << result.name << " : " << result.status;
+                if (!result.frameTimes.empty())
+                {
+                    auto frameTimes = result.frameTimes;
+                    std::sort(frameTimes.begin(), frameTimes.end());
+                    std::cout << ", median frame " << frameTimes[frameTimes.size() / 2] << "ms, worst " << frameTimes.back() << "ms";
+                }
+                if (!result.message.empty()) std::cout << ", " << result.message;
+                std::cout << std::endl;
+            }
+            std::cout << "Results written to " << outputFilename << std::endl;
+        }
+
+        // a failed scenario fails the run, so regression scripts can check the exit code
+        for (auto& result : results)
+        {
+            if (result.status == "failed") return 1;
+        }
+    }
+    catch (const vsg::Exception& ve)
+    {
+        for (int i = 0; i < argc; ++i) std::cerr << argv[i] << " ";
+        std::cerr << "\n[Exception] - " << ve.message << " result = " << ve.result << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
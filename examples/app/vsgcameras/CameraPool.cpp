@@ -0,0 +1,59 @@
+#include "CameraPool.h"
+
+#include <iostream>
+
+uint32_t CameraPool::add(const std::string& name, vsg::ref_ptr<vsg::ProjectionMatrix> projectionMatrix, vsg::ref_ptr<vsg::ViewMatrix> viewMatrix)
+{
+    entries.push_back(Entry{name, projectionMatrix, viewMatrix});
+    return static_cast<uint32_t>(entries.size() - 1);
+}
+
+void CameraPool::changeExtent(const VkExtent2D& prevExtent, const VkExtent2D& newExtent)
+{
+    if (newExtent.width == _extent.width && newExtent.height == _extent.height) return;
+    _extent = newExtent;
+
+    for (auto& entry : entries) entry.projectionMatrix->changeExtent(prevExtent, newExtent);
+}
+
+CameraPool::Slot::Slot(vsg::ref_ptr<CameraPool> in_pool, uint32_t in_cameraID) :
+    pool(in_pool),
+    cameraID(in_cameraID)
+{
+}
+
+void CameraPool::Slot::select(uint32_t id)
+{
+    if (id == cameraID) return;
+
+    cameraID = id;
+    ++pool->numSwitches;
+}
+
+vsg::ref_ptr<vsg::Camera> CameraPool::createCamera(uint32_t cameraID, vsg::ref_ptr<vsg::ViewportState> viewportState, vsg::ref_ptr<Slot>& slot)
+{
+    slot = Slot::create(vsg::ref_ptr<CameraPool>(this), cameraID);
+    return vsg::Camera::create(PooledProjectionMatrix::create(slot), PooledViewMatrix::create(slot), viewportState);
+}
+
+void CameraPoolSwitcher::apply(vsg::KeyPressEvent& keyPress)
+{
+    if (slots.empty() || pool->entries.empty()) return;
+
+    uint32_t step = 0;
+    if (keyPress.keyBase == ']')
+        step = static_cast<uint32_t>(slots.size());
+    else if (keyPress.keyBase == '[')
+        step = pool->size() - static_cast<uint32_t>(slots.size() % pool->size());
+    else
+        return;
+
+    for (auto& slot : slots)
+    {
+        slot->select((slot->cameraID + step) % pool->size());
+    }
+
+    std::cout << "Showing cameras:";
+    for (auto& slot : slots) std::cout << " " << slot->cameraID << " " << slot->entry()->name;
+    std::cout << std::endl;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Cameras held by ID, shown through a fixed set of view slots. Each slot is a vsg::View whose Camera has pooled view and
+// projection matrices that read the matrices of the pool entry its cameraID selects. Every View owns its pipelines'
+// viewport state and its view dependent descriptor sets, so keeping one View per slot rather than per camera means
+// switching the camera a slot shows, or adding cameras to the pool, only changes an index. There are no new Views,
+// descriptor sets or pipelines to compile, whatever the projection type of the cameras involved.
+class CameraPool : public vsg::Inherit<vsg::Object, CameraPool>
+{
+public:
+    struct Entry
+    {
+        std::string name;
+        vsg::ref_ptr<vsg::ProjectionMatrix> projectionMatrix;
+        vsg::ref_ptr<vsg::ViewMatrix> viewMatrix;
+    };
+
+    std::vector<Entry> entries;
+
+    // add a camera to the pool, returning its ID
+    uint32_t add(const std::string& name, vsg::ref_ptr<vsg::ProjectionMatrix> projectionMatrix, vsg::ref_ptr<vsg::ViewMatrix> viewMatrix);
+
+    uint32_t size() const { return static_cast<uint32_t>(entries.size()); }
+
+    // pass a window resize on to the projection matrices of all the entries, not just those shown. Every slot's camera
+    // passes the same resize on, so only the first call for each new extent is applied, the slots' views are expected
+    // to share one window.
+    void changeExtent(const VkExtent2D& prevExtent, const VkExtent2D& newExtent);
+
+    // the pool entry shown by a view, shared by its camera's pooled view and projection matrices
+    class Slot : public vsg::Inherit<vsg::Object, Slot>
+    {
+    public:
+        Slot(vsg::ref_ptr<CameraPool> in_pool, uint32_t in_cameraID);
+
+        vsg::ref_ptr<CameraPool> pool;
+        std::atomic_uint32_t cameraID;
+
+        void select(uint32_t id);
+
+        // nullptr when the pool is empty
+        const Entry* entry() const { return pool->entries.empty() ? nullptr : &pool->entries[cameraID % pool->entries.size()]; }
+    };
+
+    class PooledViewMatrix : public vsg::Inherit<vsg::ViewMatrix, PooledViewMatrix>
+    {
+    public:
+        explicit PooledViewMatrix(vsg::ref_ptr<Slot> in_slot) :
+            slot(in_slot) {}
+
+        vsg::ref_ptr<Slot> slot;
+
+        vsg::dmat4 transform() const override
+        {
+            auto entry = slot->entry();
+            return entry ? entry->viewMatrix->transform() : vsg::dmat4();
+        }
+
+        vsg::dmat4 inverse() const override
+        {
+            auto entry = slot->entry();
+            return entry ? entry->viewMatrix->inverse() : vsg::dmat4();
+        }
+    };
+
+    class PooledProjectionMatrix : public vsg::Inherit<vsg::ProjectionMatrix, PooledProjectionMatrix>
+    {
+    public:
+        explicit PooledProjectionMatrix(vsg::ref_ptr<Slot> in_slot) :
+            slot(in_slot) {}
+
+        vsg::ref_ptr<Slot> slot;
+
+        vsg::dmat4 transform() const override
+        {
+            auto entry = slot->entry();
+            return entry ? entry->projectionMatrix->transform() : vsg::dmat4();
+        }
+
+        vsg::dmat4 inverse() const override
+        {
+            auto entry = slot->entry();
+            return entry ? entry->projectionMatrix->inverse() : vsg::dmat4();
+        }
+
+        void changeExtent(const VkExtent2D& prevExtent, const VkExtent2D& newExtent) override { slot->pool->changeExtent(prevExtent, newExtent); }
+    };
+
+    // create a camera for a view slot, initially showing cameraID
+    vsg::ref_ptr<vsg::Camera> createCamera(uint32_t cameraID, vsg::ref_ptr<vsg::ViewportState> viewportState, vsg::ref_ptr<Slot>& slot);
+
+    // statistics
+    std::atomic_uint64_t numSwitches{0};
+
+protected:
+    VkExtent2D _extent{0, 0}; // the new extent of the last resize applied
+};
+
+// Steps the cameras shown by the view slots through the pool, ']' showing the next page of cameras and '[' the previous
+class CameraPoolSwitcher : public vsg::Inherit<vsg::Visitor, CameraPoolSwitcher>
+{
+public:
+    CameraPoolSwitcher(vsg::ref_ptr<CameraPool> in_pool, const std::vector<vsg::ref_ptr<CameraPool::Slot>>& in_slots) :
+        pool(in_pool),
+        slots(in_slots) {}
+
+    vsg::ref_ptr<CameraPool> pool;
+    std::vector<vsg::ref_ptr<CameraPool::Slot>> slots;
+
+    void apply(vsg::KeyPressEvent& keyPress) override;
+};
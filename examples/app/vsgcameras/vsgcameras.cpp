@@ -1,12 +1,17 @@
 #include <vsg/all.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <iostream>
 
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
 
+#include "CameraPool.h"
+#include "FrameTrace.h"
+
 class CameraSelector : public vsg::Inherit<vsg::Visitor, CameraSelector>
 {
 public:
@@ -80,9 +85,17 @@ int main(int argc, char** argv)
     windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
     if (arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height)) { windowTraits->fullscreen = false; }
 
+    // number of secondary views showing cameras from the pool, 0 for one view per camera
+    auto numSlots = arguments.value<uint32_t>(0, "--slots");
+    // add cameras circling the scene to the pool, to check switching between many cameras
+    auto numCirclingCameras = arguments.value<uint32_t>(0, "--cameras");
+
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     auto options = vsg::Options::create();
+    if (frameTrace) frameTrace->addReaderWriter(*options);
     options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
     options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
 #ifdef vsgXchange_all
@@ -152,6 +165,27 @@ int main(int argc, char** argv)
         scene_cameras = vsg::visit<vsg::FindCameras>(scenegraph).cameras;
     }
 
+    // the pool shares the scene cameras' projection matrices and tracks their positions in the scene graph
+    auto cameraPool = CameraPool::create();
+    for(auto& [nodePath, camera] : scene_cameras)
+    {
+        cameraPool->add(camera->name, camera->projectionMatrix, vsg::TrackingViewMatrix::create(nodePath));
+    }
+
+    if (numCirclingCameras > 0)
+    {
+        // mix in orthographic cameras, the projection type makes no difference to the views showing them
+        auto perspective = vsg::Perspective::create(60.0, 1.0, nearFarRatio * radius, radius * 4.0);
+        auto orthographic = vsg::Orthographic::create(-radius, radius, -radius, radius, nearFarRatio * radius, radius * 4.0);
+        for (uint32_t i = 0; i < numCirclingCameras; ++i)
+        {
+            double angle = 2.0 * vsg::PI * static_cast<double>(i) / static_cast<double>(numCirclingCameras);
+            auto eye = centre + vsg::dvec3(std::cos(angle) * radius * 2.0, std::sin(angle) * radius * 2.0, radius * 0.5);
+            vsg::ref_ptr<vsg::ProjectionMatrix> projectionMatrix = (i % 4 == 3) ? vsg::ref_ptr<vsg::ProjectionMatrix>(orthographic) : vsg::ref_ptr<vsg::ProjectionMatrix>(perspective);
+            cameraPool->add(vsg::make_string("Circling ", i), projectionMatrix, vsg::LookAt::create(eye, centre, vsg::dvec3(0.0, 0.0, 1.0)));
+        }
+    }
+
     for(auto& [nodePath, camera] : scene_cameras)
     {
         std::cout<<"\ncamera = "<<camera<<", "<<camera->name<<" :";
@@ -200,9 +234,11 @@ int main(int argc, char** argv)
         viewer->addEventHandler(CameraSelector::create(main_camera, scene_cameras));
     }
 
-    // set up secondary views, one per camera found in the scene graph
+    // set up secondary views, one per camera in the pool unless a number of slots has been specified
+    if (numSlots == 0 || numSlots > cameraPool->size()) numSlots = cameraPool->size();
+
     uint32_t margin = 10;
-    uint32_t division = scene_cameras.size();
+    uint32_t division = numSlots;
     if (division<3) division = 3;
 
     uint32_t secondary_width = width / division;
@@ -211,14 +247,15 @@ int main(int argc, char** argv)
     uint32_t x = width - secondary_width - margin;
     uint32_t y = margin;
 
-    for(auto& [nodePath, camera] : scene_cameras)
+    std::vector<vsg::ref_ptr<CameraPool::Slot>> slots;
+    for(uint32_t cameraID = 0; cameraID < numSlots; ++cameraID)
     {
         // create an RenderinGraph to add an secondary vsg::View on the top right part of the window.
-        auto projectionMatrix = camera->projectionMatrix;
-        auto viewMatrix = vsg::TrackingViewMatrix::create(nodePath);
         auto viewportState = vsg::ViewportState::create(x, y, secondary_width, secondary_height);
 
-        auto secondary_camera = vsg::Camera::create(projectionMatrix, viewMatrix, viewportState);
+        vsg::ref_ptr<CameraPool::Slot> slot;
+        auto secondary_camera = cameraPool->createCamera(cameraID, viewportState, slot);
+        slots.push_back(slot);
 
         auto secondary_view = vsg::View::create(secondary_camera, scenegraph);
         auto secondary_RenderGraph = vsg::RenderGraph::create(window, secondary_view);
@@ -228,25 +265,48 @@ int main(int argc, char** argv)
         y += secondary_height + margin;
     }
 
+    // switching the cameras shown by the secondary views only changes the slots' camera IDs
+    viewer->addEventHandler(CameraPoolSwitcher::create(cameraPool, slots));
+
+
+    if (frameTrace) frameTrace->addTimestamps(*commandGraph);
+
 
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
 
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     // rendering main loop
     while (viewer->advanceToNextFrame())
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        traceFrame.phase("update");
         viewer->update();
 
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        traceFrame.phase("present");
         viewer->present();
     }
 
+    std::cout << cameraPool->size() << " cameras shown through " << slots.size() << " views, switched " << cameraPool->numSwitches << " times" << std::endl;
+
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -0,0 +1,321 @@
+#include "DeviceSelector.h"
+#include "AtomicSave.h"
+#include "DeviceKey.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+namespace
+{
+    bool supportsDeviceExtension(VkPhysicalDevice physicalDevice, const char* name)
+    {
+        uint32_t count = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+        std::vector<VkExtensionProperties> extensions(count);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+        return std::any_of(extensions.begin(), extensions.end(), [&](const VkExtensionProperties& extension) { return std::strcmp(extension.extensionName, name) == 0; });
+    }
+
+    bool supportsFormat(VkPhysicalDevice physicalDevice, VkFormat format, VkFormatFeatureFlags features)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        return (properties.optimalTilingFeatures & features) == features;
+    }
+} // namespace
+
+DeviceSelector::DeviceSelector(vsg::ref_ptr<vsg::Instance> in_instance, vsg::ref_ptr<vsg::Surface> in_surface, VkQueueFlags in_queueFlags, const vsg::Path& in_cacheFilename) :
+    instance(in_instance),
+    surface(in_surface),
+    queueFlags(in_queueFlags),
+    cacheFilename(in_cacheFilename)
+{
+    if (cacheFilename) _readCache();
+}
+
+void DeviceSelector::_score(Score& score) const
+{
+    auto physicalDevice = score.physicalDevice;
+    VkPhysicalDevice vk_physicalDevice = physicalDevice->vk();
+    const auto& properties = physicalDevice->getProperties();
+
+    // queue families
+    std::tie(score.graphicsFamily, score.presentFamily) = physicalDevice->getQueueFamily(queueFlags, surface);
+    score.eligible = score.graphicsFamily >= 0 && score.presentFamily >= 0;
+
+    auto& queueFamilyProperties = physicalDevice->getQueueFamilyProperties();
+    for (size_t i = 0; i < queueFamilyProperties.size(); ++i)
+    {
+        auto flags = queueFamilyProperties[i].queueFlags;
+        if (queueFamilyProperties[i].queueCount == 0 || (flags & VK_QUEUE_GRAPHICS_BIT)) continue;
+
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && score.computeFamily < 0)
+            score.computeFamily = static_cast<int>(i);
+        else if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT) && score.transferFamily < 0)
+            score.transferFamily = static_cast<int>(i);
+    }
+
+    // dedicated VRAM, integrated GPUs share system memory so their device local heaps don't count
+    if (properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU && properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_CPU)
+    {
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(vk_physicalDevice, &memoryProperties);
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+        {
+            if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) score.dedicatedVRAM += memoryProperties.memoryHeaps[i].size;
+        }
+    }
+
+    // optional features, querying them needs vkGetPhysicalDeviceFeatures2
+    if (instance->apiVersion >= VK_API_VERSION_1_1 && properties.apiVersion >= VK_API_VERSION_1_1)
+    {
+        if (supportsDeviceExtension(vk_physicalDevice, VK_EXT_MESH_SHADER_EXTENSION_NAME))
+        {
+            auto meshFeatures = physicalDevice->getFeatures<VkPhysicalDeviceMeshShaderFeaturesEXT, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT>();
+            score.meshShader = meshFeatures.meshShader && meshFeatures.taskShader;
+        }
+
+        if (supportsDeviceExtension(vk_physicalDevice, VK_KHR_RAY_QUERY_EXTENSION_NAME) && supportsDeviceExtension(vk_physicalDevice, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME))
+        {
+            auto rayQueryFeatures = physicalDevice->getFeatures<VkPhysicalDeviceRayQueryFeaturesKHR, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR>();
+            score.rayQuery = rayQueryFeatures.rayQuery;
+        }
+
+        if (properties.apiVersion >= VK_API_VERSION_1_2 || supportsDeviceExtension(vk_physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+        {
+            auto descriptorIndexingFeatures = physicalDevice->getFeatures<VkPhysicalDeviceDescriptorIndexingFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES>();
+            score.descriptorIndexing = descriptorIndexingFeatures.runtimeDescriptorArray && descriptorIndexingFeatures.descriptorBindingPartiallyBound && descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+        }
+    }
+
+    // optional formats
+    if (supportsFormat(vk_physicalDevice, VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) ++score.numFormats;
+    if (supportsFormat(vk_physicalDevice, VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) ++score.numFormats;
+    if (supportsFormat(vk_physicalDevice, VK_FORMAT_D32_SFLOAT, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)) ++score.numFormats;
+    if (supportsFormat(vk_physicalDevice, VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT)) ++score.numFormats;
+
+    if (benchmark && score.eligible) score.bandwidth = _benchmark(physicalDevice, score.graphicsFamily);
+
+    const double GiB = 1024.0 * 1024.0 * 1024.0;
+    uint32_t numFeatures = (score.meshShader ? 1 : 0) + (score.rayQuery ? 1 : 0) + (score.descriptorIndexing ? 1 : 0);
+    score.total = vramWeight * static_cast<double>(score.dedicatedVRAM) / GiB +
+                  featureWeight * static_cast<double>(numFeatures) +
+                  formatWeight * static_cast<double>(score.numFormats) +
+                  bandwidthWeight * score.bandwidth +
+                  (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ? discreteWeight : 0.0);
+}
+
+double DeviceSelector::_benchmark(vsg::PhysicalDevice* physicalDevice, int queueFamily) const
+{
+    try
+    {
+        // a temporary device with a single queue, destroyed before the device to render with is created
+        vsg::QueueSettings settings{vsg::QueueSetting{queueFamily, {1.0}}};
+        auto device = vsg::Device::create(physicalDevice, settings, vsg::Names{}, vsg::Names{}, nullptr, instance->getAllocationCallbacks());
+        auto queue = device->getQueue(queueFamily);
+        auto commandPool = vsg::CommandPool::create(device, queueFamily);
+
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        auto source = vsg::createBufferAndMemory(device, benchmarkSize, usage, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        auto destination = vsg::createBufferAndMemory(device, benchmarkSize, usage, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        double timestampPeriod = 0.0;
+        auto& queueFamilyProperties = physicalDevice->getQueueFamilyProperties();
+        if (queueFamilyProperties[queueFamily].timestampValidBits > 0) timestampPeriod = static_cast<double>(physicalDevice->getProperties().limits.timestampPeriod);
+
+        auto queryPool = vsg::QueryPool::create();
+        queryPool->queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPool->queryCount = 2;
+        auto context = vsg::Context::create(device);
+        queryPool->compile(*context);
+
+        auto resetQueryPool = vsg::ResetQueryPool::create(queryPool);
+        auto startTimestamp = vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+        auto endTimestamp = vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+
+        // one untimed copy to warm up clocks and page in the allocations
+        std::vector<double> times;
+        for (uint32_t i = 0; i < benchmarkIterations + 1; ++i)
+        {
+            auto fence = vsg::Fence::create(device);
+            auto startTime = vsg::clock::now();
+
+            vsg::submitCommandsToQueue(commandPool, fence, 100000000000, queue, [&](vsg::CommandBuffer& commandBuffer) {
+                resetQueryPool->record(commandBuffer);
+                startTimestamp->record(commandBuffer);
+                VkBufferCopy region{0, 0, benchmarkSize};
+                vkCmdCopyBuffer(commandBuffer, source->vk(device->deviceID), destination->vk(device->deviceID), 1, &region);
+                endTimestamp->record(commandBuffer);
+            });
+
+            double cpuTime = std::chrono::duration<double>(vsg::clock::now() - startTime).count();
+            if (i == 0) continue;
+
+            std::vector<uint64_t> timestamps(2);
+            if (timestampPeriod > 0.0 && queryPool->getResults(timestamps) == VK_SUCCESS)
+                times.push_back(timestampPeriod * 1e-9 * static_cast<double>(timestamps[1] - timestamps[0]));
+            else
+                times.push_back(cpuTime);
+        }
+
+        std::sort(times.begin(), times.end());
+        double time = times.empty() ? 0.0 : times[times.size() / 2];
+        if (time <= 0.0) return 0.0;
+
+        // a copy reads and writes every byte
+        return 2.0 * static_cast<double>(benchmarkSize) / time * 1e-9;
+    }
+    catch (const vsg::Exception& ve)
+    {
+        vsg::warn("DeviceSelector benchmark failed on ", physicalDevice->getProperties().deviceName, " : ", ve.message);
+        return 0.0;
+    }
+}
+
+const DeviceSelector::Score* DeviceSelector::select()
+{
+    scores.clear();
+    selected = nullptr;
+    cached = false;
+
+    auto physicalDevices = instance->getPhysicalDevices();
+
+    std::vector<std::string> deviceKeys;
+    for (auto& physicalDevice : physicalDevices)
+    {
+        auto& score = scores.emplace_back();
+        score.physicalDevice = physicalDevice;
+        score.deviceKey = experimental::deviceKey(*instance, *physicalDevice);
+        deviceKeys.push_back(score.deviceKey);
+    }
+
+    // the machine configuration is identified by the devices and drivers present, and the queue flags required
+    std::sort(deviceKeys.begin(), deviceKeys.end());
+    uint64_t hash = experimental::hashSeed;
+    for (auto& key : deviceKeys) hash = experimental::hashBytes(key.data(), key.size(), hash);
+    hash = experimental::hashBytes(&queueFlags, sizeof(queueFlags), hash);
+
+    std::ostringstream selectionKey;
+    selectionKey << std::hex << std::setw(16) << std::setfill('0') << hash;
+    _selectionKey = selectionKey.str();
+
+    if (auto itr = _cache.find(_selectionKey); itr != _cache.end() && !rescore)
+    {
+        auto& entry = itr->second;
+        for (auto& score : scores)
+        {
+            if (score.deviceKey != entry.deviceKey) continue;
+
+            // check the cached families still make sense before trusting them
+            auto numFamilies = static_cast<int>(score.physicalDevice->getQueueFamilyProperties().size());
+            if (entry.graphicsFamily < 0 || entry.graphicsFamily >= numFamilies || entry.presentFamily < 0 || entry.presentFamily >= numFamilies ||
+                entry.computeFamily >= numFamilies || entry.transferFamily >= numFamilies) break;
+
+            score.eligible = true;
+            score.graphicsFamily = entry.graphicsFamily;
+            score.presentFamily = entry.presentFamily;
+            score.computeFamily = entry.computeFamily;
+            score.transferFamily = entry.transferFamily;
+            selected = &score;
+            cached = true;
+            return selected;
+        }
+    }
+
+    for (auto& score : scores)
+    {
+        _score(score);
+        if (score.eligible && (!selected || score.total > selected->total)) selected = &score;
+    }
+
+    if (!selected) return nullptr;
+
+    _cache[_selectionKey] = CachedSelection{selected->deviceKey, selected->graphicsFamily, selected->presentFamily, selected->computeFamily, selected->transferFamily};
+    if (cacheFilename) _writeCache();
+
+    return selected;
+}
+
+vsg::QueueSettings DeviceSelector::queueSettings() const
+{
+    vsg::QueueSettings settings;
+    if (!selected) return settings;
+
+    std::set<int> families;
+    for (auto family : {selected->graphicsFamily, selected->presentFamily, selected->computeFamily, selected->transferFamily})
+    {
+        if (family >= 0 && families.insert(family).second) settings.push_back(vsg::QueueSetting{family, {1.0}});
+    }
+    return settings;
+}
+
+vsg::ref_ptr<vsg::Device> DeviceSelector::createDevice(const vsg::Names& layers, const vsg::Names& deviceExtensions, vsg::ref_ptr<vsg::DeviceFeatures> deviceFeatures) const
+{
+    if (!selected) return {};
+    return vsg::Device::create(selected->physicalDevice, queueSettings(), layers, deviceExtensions, deviceFeatures, instance->getAllocationCallbacks());
+}
+
+void DeviceSelector::_readCache()
+{
+    std::ifstream fin(cacheFilename.string());
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        // selectionKey deviceKey graphicsFamily presentFamily computeFamily transferFamily
+        std::istringstream str(line);
+        std::string selectionKey;
+        CachedSelection entry;
+        if (str >> selectionKey >> entry.deviceKey >> entry.graphicsFamily >> entry.presentFamily >> entry.computeFamily >> entry.transferFamily) _cache[selectionKey] = entry;
+    }
+}
+
+void DeviceSelector::_writeCache() const
+{
+    // write through a temporary file so a concurrent or interrupted run never sees a partial cache
+    experimental::atomicSave(cacheFilename, [&](const vsg::Path& temporaryFilename) {
+        std::ofstream fout(temporaryFilename.string());
+        for (auto& [key, entry] : _cache)
+        {
+            fout << key << " " << entry.deviceKey << " " << entry.graphicsFamily << " " << entry.presentFamily << " " << entry.computeFamily << " " << entry.transferFamily << std::endl;
+        }
+        fout.close();
+        return !fout.fail();
+    });
+}
+
+void DeviceSelector::report(std::ostream& out) const
+{
+    out << "DeviceSelector configuration = " << _selectionKey << (cached ? " (cached)" : "") << std::endl;
+    for (auto& score : scores)
+    {
+        const auto& properties = score.physicalDevice->getProperties();
+        out << "    " << (&score == selected ? "* " : "  ") << properties.deviceName << " " << score.deviceKey;
+        if (cached)
+        {
+            out << std::endl;
+            continue;
+        }
+
+        if (!score.eligible)
+        {
+            out << ", not eligible, no graphics and present queue family" << std::endl;
+            continue;
+        }
+
+        out << ", score = " << score.total << std::endl;
+        out << "          dedicatedVRAM = " << (score.dedicatedVRAM / (1024 * 1024)) << "MiB, bandwidth = " << score.bandwidth << "GB/s, formats = " << score.numFormats
+            << ", meshShader = " << score.meshShader << ", rayQuery = " << score.rayQuery << ", descriptorIndexing = " << score.descriptorIndexing << std::endl;
+    }
+
+    if (selected)
+    {
+        out << "    queue families graphics = " << selected->graphicsFamily << ", present = " << selected->presentFamily
+            << ", compute = " << selected->computeFamily << ", transfer = " << selected->transferFamily << std::endl;
+    }
+}
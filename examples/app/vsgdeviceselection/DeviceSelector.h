@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <map>
+#include <ostream>
+
+// Chooses the physical device and queue families to use by scoring every device that can render and present to the
+// surface, rather than relying on the order the driver happens to enumerate them in.
+// Each device is scored on its dedicated VRAM, the optional features and formats it supports, and the bandwidth of a
+// short device local buffer copy benchmark, with the weights below controlling how much each contributes.
+// Separate async compute and transfer queue families are chosen when the device has them, falling back to the
+// graphics family when it doesn't.
+// The decision is kept in cacheFilename, keyed by the set of devices and drivers present, so the benchmark is only run
+// on the first run on a machine and again after a device is added or removed, or a driver updated.
+class DeviceSelector : public vsg::Inherit<vsg::Object, DeviceSelector>
+{
+public:
+    DeviceSelector(vsg::ref_ptr<vsg::Instance> in_instance, vsg::ref_ptr<vsg::Surface> in_surface, VkQueueFlags in_queueFlags, const vsg::Path& in_cacheFilename = {});
+
+    vsg::ref_ptr<vsg::Instance> instance;
+    vsg::ref_ptr<vsg::Surface> surface;
+    VkQueueFlags queueFlags;
+    vsg::Path cacheFilename;
+
+    bool benchmark = true;
+    bool rescore = false; // ignore a decision already in the cache
+    VkDeviceSize benchmarkSize = 64 * 1024 * 1024;
+    uint32_t benchmarkIterations = 4;
+
+    // score weights
+    double vramWeight = 10.0;       // per GiB of dedicated VRAM
+    double featureWeight = 25.0;    // per optional feature
+    double formatWeight = 10.0;     // per optional format
+    double bandwidthWeight = 0.25;  // per GB/s of copy bandwidth
+    double discreteWeight = 50.0;   // for discrete GPUs, so they are preferred when nothing else separates devices
+
+    struct Score
+    {
+        vsg::ref_ptr<vsg::PhysicalDevice> physicalDevice;
+        std::string deviceKey;
+        bool eligible = false;
+
+        VkDeviceSize dedicatedVRAM = 0;
+        bool meshShader = false;
+        bool rayQuery = false;
+        bool descriptorIndexing = false;
+        uint32_t numFormats = 0;
+        double bandwidth = 0.0; // GB/s, 0 when not benchmarked
+
+        int graphicsFamily = -1;
+        int presentFamily = -1;
+        int computeFamily = -1;  // async compute, a family with compute but not graphics, -1 if none
+        int transferFamily = -1; // dedicated transfer, a family with neither graphics nor compute, -1 if none
+
+        double total = 0.0;
+    };
+
+    // score all the devices, or use the cached decision, returns the selected device's Score or nullptr if no device is eligible
+    const Score* select();
+
+    std::vector<Score> scores;
+    const Score* selected = nullptr;
+    bool cached = false;
+
+    // queue settings for the graphics, present, compute and transfer families, without duplicates
+    vsg::QueueSettings queueSettings() const;
+
+    // create the device for the selected physical device with a queue from each of its chosen families
+    vsg::ref_ptr<vsg::Device> createDevice(const vsg::Names& layers, const vsg::Names& deviceExtensions, vsg::ref_ptr<vsg::DeviceFeatures> deviceFeatures = {}) const;
+
+    void report(std::ostream& out) const;
+
+protected:
+    void _score(Score& score) const;
+    double _benchmark(vsg::PhysicalDevice* physicalDevice, int queueFamily) const;
+    void _readCache();
+    void _writeCache() const;
+
+    std::string _selectionKey;
+
+    struct CachedSelection
+    {
+        std::string deviceKey;
+        int graphicsFamily = -1;
+        int presentFamily = -1;
+        int computeFamily = -1;
+        int transferFamily = -1;
+    };
+
+    // cached decisions for all machine configurations, so writing the cache keeps the others
+    std::map<std::string, CachedSelection> _cache;
+};
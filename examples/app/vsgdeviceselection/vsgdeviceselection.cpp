@@ -6,6 +6,9 @@
 
 #include <iostream>
 
+#include "DeviceSelector.h"
+#include "FrameTrace.h"
+
 namespace vsg
 {
     /// make a VK_API_VERSION value from a version string, i,e, a string of "1,2" maps to VK_API_VERSION_1_2
@@ -44,6 +47,9 @@ int main(int argc, char** argv)
     #endif
         arguments.read(options);
 
+        auto frameTrace = FrameTrace::create_if_requested(arguments);
+        if (frameTrace) frameTrace->addReaderWriter(*options);
+
         auto windowTraits = vsg::WindowTraits::create();
         windowTraits->windowTitle = "vsgdeviceslection";
         arguments.read("--screen", windowTraits->screenNum);
@@ -85,6 +91,11 @@ int main(int argc, char** argv)
         std::cout<<"VK_API_VERSION = "<<VK_API_VERSION_MAJOR(version) <<"."<<VK_API_VERSION_MINOR(version)<<"."<<VK_API_VERSION_PATCH(version)<<"."<<VK_API_VERSION_VARIANT(version)<<std::endl;
     #endif
 
+        vsg::Path selectionCache = "vsgdeviceselection_cache.txt";
+        arguments.read("--selection-cache", selectionCache);
+        bool rescore = arguments.read("--rescore");
+        bool benchmark = !arguments.read("--no-benchmark");
+
         // create the viewer and assign window(s) to it
         auto viewer = vsg::Viewer::create();
         auto window = vsg::Window::create(windowTraits);
@@ -168,7 +179,46 @@ int main(int argc, char** argv)
         }
 
 
-        if (size_t pd_num = 0; arguments.read("--select", pd_num))
+        if (arguments.read("--auto"))
+        {
+            // use the Window implementation to create the Instance and Surface
+            auto instance = window->getOrCreateInstance();
+            auto surface = window->getOrCreateSurface();
+
+            // score the devices, or reuse the decision of a previous run on this machine, and pick the queue families to use
+            auto selector = DeviceSelector::create(instance, surface, windowTraits->queueFlags, selectionCache);
+            selector->rescore = rescore;
+            selector->benchmark = benchmark;
+
+            auto selected = selector->select();
+            selector->report(std::cout);
+            if (!selected)
+            {
+                std::cout << "Error: no Vulkan PhysicalDevice supports the required queue flags and presenting to the window." << std::endl;
+                return 1;
+            }
+
+            vsg::Names requestedLayers;
+            if (windowTraits->debugLayer)
+            {
+                requestedLayers.push_back("VK_LAYER_KHRONOS_validation");
+                if (windowTraits->apiDumpLayer) requestedLayers.push_back("VK_LAYER_LUNARG_api_dump");
+            }
+
+            vsg::Names validatedNames = vsg::validateInstancelayerNames(requestedLayers);
+
+            vsg::Names deviceExtensions;
+            deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+            deviceExtensions.insert(deviceExtensions.end(), windowTraits->deviceExtensionNames.begin(), windowTraits->deviceExtensionNames.end());
+
+            // the device has a queue from each of the selected families, so async compute and transfer work can use device->getQueue(family)
+            auto device = selector->createDevice(validatedNames, deviceExtensions, windowTraits->deviceFeatures);
+
+            std::cout << "Created vsg::Device " << device << " on " << selected->physicalDevice->getProperties().deviceName << std::endl;
+
+            window->setDevice(device);
+        }
+        else if (size_t pd_num = 0; arguments.read("--select", pd_num))
         {
             // use the Window implementation to create the Instance and Surface
             auto instance = window->getOrCreateInstance();
@@ -297,23 +347,39 @@ int main(int argc, char** argv)
 
         // add the CommandGraph to render the scene
         auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
+        if (frameTrace) frameTrace->addTimestamps(*commandGraph);
         viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
         // compile all Vulkan objects and transfer image, vertex and primitive data to GPU
-        viewer->compile();
+        {
+            FrameTrace::Scope scope(frameTrace, "compile", "compile");
+            viewer->compile();
+        }
 
         // rendering main loop
         while (viewer->advanceToNextFrame())
         {
+            FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+            traceFrame.phase("events");
             // pass any events into EventHandlers assigned to the Viewer
             viewer->handleEvents();
 
+            traceFrame.phase("update");
             viewer->update();
 
+            traceFrame.phase("record and submit");
             viewer->recordAndSubmit();
 
+            traceFrame.phase("present");
             viewer->present();
         }
+
+        if (frameTrace)
+        {
+            frameTrace->write();
+            frameTrace->report(std::cout);
+        }
     }
     catch (const vsg::Exception& ve)
     {
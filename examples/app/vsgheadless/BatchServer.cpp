@@ -0,0 +1,400 @@
+#include "BatchServer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+bool BatchJob::parse(const std::string& line, const VkExtent2D& defaultExtent)
+{
+    std::stringstream str(line);
+    std::string modelName, outputName;
+    if (!(str >> modelName >> outputName) || modelName[0] == '#') return false;
+
+    model = modelName;
+    output = outputName;
+    extent = defaultExtent;
+
+    std::string token;
+    while (str >> token)
+    {
+        if (token == "above")
+            above = true;
+        else if (token == "eye")
+            hasEye = static_cast<bool>(str >> eye.x >> eye.y >> eye.z);
+        else if (token == "center")
+            hasCenter = static_cast<bool>(str >> center.x >> center.y >> center.z);
+        else
+        {
+            // resolution
+            std::stringstream size(token);
+            if (!(size >> extent.width) || !(str >> extent.height)) return false;
+        }
+    }
+    return extent.width > 0 && extent.height > 0;
+}
+
+BatchServer::BatchServer(vsg::ref_ptr<vsg::Device> in_device, int in_queueFamily, vsg::ref_ptr<vsg::Options> in_options, uint32_t in_numSlots, VkFormat in_colorFormat, VkFormat in_depthFormat,
+                         vsg::ref_ptr<PipelineCache> in_pipelineCache) :
+    device(in_device),
+    queueFamily(in_queueFamily),
+    options(vsg::Options::create(*in_options)),
+    numSlots(std::max(in_numSlots, 1u)),
+    colorFormat(in_colorFormat),
+    depthFormat(in_depthFormat),
+    pipelineCache(in_pipelineCache)
+{
+    // share state and shaders between all the models loaded so the pipelines compiled for them are reused by later jobs
+    if (!options->sharedObjects) options->sharedObjects = vsg::SharedObjects::create();
+
+    // create the pipelines of every model loaded through the one PipelineCache, they're saved when run() completes
+    if (pipelineCache) options->readerWriters.insert(options->readerWriters.begin(), pipelineCache->createReaderWriter());
+
+    _renderPass = vsg::createRenderPass(device, colorFormat, depthFormat, true);
+}
+
+size_t BatchServer::run(std::istream& jobs)
+{
+    _viewer = vsg::Viewer::create();
+    _commandGraph = vsg::CommandGraph::create(device, queueFamily);
+    _viewer->assignRecordAndSubmitTaskAndPresentation({_commandGraph});
+    _viewer->compile();
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread loader([&]() { _loaderLoop(jobs); });
+    std::thread writer([&]() { _writerLoop(); });
+
+    uint64_t waitTimeout = 1999999999; // 1second in nanoseconds.
+    size_t numFrames = 0;
+
+    std::vector<vsg::ref_ptr<Slot>> rendering;
+    while (_viewer->advanceToNextFrame())
+    {
+        _releaseWritten();
+
+        // fill the slots with loaded jobs, only blocking on the loader when there's nothing else to render
+        rendering.clear();
+        BatchJob job;
+        while (rendering.size() < numSlots && _nextJob(job, rendering.empty()))
+        {
+            auto slot = _acquireSlot(job.extent);
+            _assign(*slot, job);
+            rendering.push_back(slot);
+        }
+
+        if (rendering.empty()) break;
+
+        _viewer->handleEvents();
+        _viewer->update();
+        _viewer->recordAndSubmit();
+        _viewer->waitForFences(0, waitTimeout);
+        ++numFrames;
+
+        // hand the results to the writer, the slots render again once written
+        {
+            std::scoped_lock<std::mutex> lock(_mutex);
+            for (auto& slot : rendering)
+            {
+                slot->root->setAllChildren(false);
+                slot->state = WRITING;
+                _writing.push_back(slot);
+            }
+        }
+        _condition.notify_all();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return _writing.empty(); });
+        _stop = true;
+    }
+    _condition.notify_all();
+
+    loader.join();
+    writer.join();
+
+    _viewer->deviceWaitIdle();
+    _releaseWritten();
+
+    if (pipelineCache)
+    {
+        pipelineCache->save();
+        pipelineCache->report(std::cout);
+    }
+
+    auto duration = std::chrono::duration<double, std::chrono::seconds::period>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Batch completed " << _numCompleted << " jobs, " << _numFailed << " failed, in " << numFrames << " frames and " << duration << "s, " << _slots.size() << " slots" << std::endl;
+
+    return _numFailed;
+}
+
+void BatchServer::_loaderLoop(std::istream& jobs)
+{
+    size_t index = 0;
+    std::string line;
+    while (std::getline(jobs, line))
+    {
+        BatchJob job;
+        if (!job.parse(line, defaultExtent)) continue;
+        job.index = index++;
+
+        auto loadStart = std::chrono::steady_clock::now();
+        job.scene = vsg::read_cast<vsg::Node>(job.model, options);
+        job.loadTime = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - loadStart).count();
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!job.scene)
+        {
+            std::cout << "failed " << job.index << " " << job.output << " : could not load " << job.model << std::endl;
+            ++_numFailed;
+            continue;
+        }
+
+        // keep a frame's worth of jobs ready ahead of the renderer
+        _condition.wait(lock, [this]() { return _stop || _loaded.size() < numSlots; });
+        if (_stop) break;
+
+        _loaded.push_back(std::move(job));
+        _condition.notify_all();
+    }
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _loaderDone = true;
+    _condition.notify_all();
+}
+
+bool BatchServer::_nextJob(BatchJob& job, bool block)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (block) _condition.wait(lock, [this]() { return _loaderDone || !_loaded.empty(); });
+    if (_loaded.empty()) return false;
+
+    job = std::move(_loaded.front());
+    _loaded.pop_front();
+    _condition.notify_all();
+    return true;
+}
+
+vsg::ref_ptr<BatchServer::Slot> BatchServer::_createSlot(const VkExtent2D& extent, vsg::ref_ptr<Slot> replaced)
+{
+    auto createAttachment = [&](VkFormat format, VkImageUsageFlags usage) {
+        auto image = vsg::Image::create();
+        image->imageType = VK_IMAGE_TYPE_2D;
+        image->format = format;
+        image->extent = VkExtent3D{extent.width, extent.height, 1};
+        image->mipLevels = 1;
+        image->arrayLayers = 1;
+        image->samples = VK_SAMPLE_COUNT_1_BIT;
+        image->tiling = VK_IMAGE_TILING_OPTIMAL;
+        image->usage = usage;
+        image->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        return vsg::createImageView(device, image, vsg::computeAspectFlagsForFormat(format));
+    };
+
+    auto slot = Slot::create();
+    slot->extent = extent;
+
+    auto colorImageView = createAttachment(colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    auto depthImageView = createAttachment(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    auto framebuffer = vsg::Framebuffer::create(_renderPass, vsg::ImageViews{colorImageView, depthImageView}, extent.width, extent.height, 1);
+
+    // the camera is set up for each job in _assign()
+    double aspectRatio = static_cast<double>(extent.width) / static_cast<double>(extent.height);
+    if (replaced)
+    {
+        // take over the replaced slot's View, and with it the compile context added for it. All slots share the one
+        // RenderPass, so only the viewport the context compiles pipelines with needs updating, in place.
+        slot->lookAt = replaced->lookAt;
+        slot->perspective = replaced->perspective;
+        slot->perspective->aspectRatio = aspectRatio;
+        slot->view = replaced->view;
+        slot->view->camera->viewportState->set(0, 0, extent.width, extent.height);
+        slot->view->children.clear();
+    }
+    else
+    {
+        slot->lookAt = vsg::LookAt::create();
+        slot->perspective = vsg::Perspective::create(30.0, aspectRatio, 0.1, 100.0);
+        auto camera = vsg::Camera::create(slot->perspective, slot->lookAt, vsg::ViewportState::create(extent));
+        slot->view = vsg::View::create(camera);
+    }
+
+    slot->renderGraph = vsg::RenderGraph::create();
+    slot->renderGraph->framebuffer = framebuffer;
+    slot->renderGraph->renderArea.offset = {0, 0};
+    slot->renderGraph->renderArea.extent = extent;
+    slot->renderGraph->setClearValues({{1.0f, 1.0f, 0.0f, 0.0f}}, VkClearDepthStencilValue{0.0f, 0});
+    slot->renderGraph->addChild(slot->view);
+
+    // readback buffer, mapped for the lifetime of the slot so the writer writes the image straight from it
+    VkDeviceSize bufferSize = VkDeviceSize(extent.width) * extent.height * sizeof(vsg::ubvec4);
+    auto buffer = vsg::createBufferAndMemory(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    slot->imageData = vsg::MappedData<vsg::ubvec4Array2D>::create(buffer->getDeviceMemory(device->deviceID), buffer->getMemoryOffset(device->deviceID), 0, vsg::Data::Properties{colorFormat}, extent.width, extent.height);
+
+    VkImageSubresourceRange colorRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    auto capture = vsg::Commands::create();
+
+    // the RenderGraph leaves the color image in PRESENT_SRC
+    auto toTransferSource = vsg::ImageMemoryBarrier::create(VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, colorImageView->image, colorRange);
+    capture->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, toTransferSource));
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = VkExtent3D{extent.width, extent.height, 1};
+
+    auto copyImage = vsg::CopyImageToBuffer::create();
+    copyImage->srcImage = colorImageView->image;
+    copyImage->srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    copyImage->dstBuffer = buffer;
+    copyImage->regions.push_back(region);
+    capture->addChild(copyImage);
+
+    auto toHostRead = vsg::BufferMemoryBarrier::create(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, buffer, 0, bufferSize);
+    capture->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, toHostRead));
+
+    slot->root = vsg::Switch::create();
+    slot->root->addChild(false, slot->renderGraph);
+    slot->root->addChild(false, capture);
+
+    _commandGraph->addChild(slot->root);
+
+    // the slot's View needs its own compile context, a replacement reuses the one added for the slot it replaces
+    if (!replaced) _viewer->compileManager->add(*framebuffer, slot->view);
+
+    return slot;
+}
+
+vsg::ref_ptr<BatchServer::Slot> BatchServer::_acquireSlot(const VkExtent2D& extent)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        auto sameExtent = [&](const Slot& slot) { return slot.extent.width == extent.width && slot.extent.height == extent.height; };
+
+        // reuse a slot of the same resolution, its pipelines are already compiled for any shared state
+        for (auto& slot : _slots)
+        {
+            if (slot->state == FREE && sameExtent(*slot))
+            {
+                slot->state = RENDERING;
+                return slot;
+            }
+        }
+
+        if (_slots.size() < numSlots)
+        {
+            _slots.push_back(_createSlot(extent));
+            _slots.back()->state = RENDERING;
+            return _slots.back();
+        }
+
+        // replace an idle slot of another resolution, the GPU and writer have finished with it
+        for (auto itr = _slots.begin(); itr != _slots.end(); ++itr)
+        {
+            if ((*itr)->state != FREE) continue;
+
+            auto& children = _commandGraph->children;
+            children.erase(std::remove(children.begin(), children.end(), (*itr)->root), children.end());
+
+            *itr = _createSlot(extent, *itr);
+            (*itr)->state = RENDERING;
+            return *itr;
+        }
+
+        // every slot is waiting to be written
+        _condition.wait(lock);
+    }
+}
+
+void BatchServer::_assign(Slot& slot, BatchJob& job)
+{
+    vsg::ComputeBounds computeBounds;
+    job.scene->accept(computeBounds);
+    vsg::dvec3 centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
+    double radius = vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.6;
+    double nearFarRatio = 0.001;
+
+    // same default views as the single model vsgheadless
+    if (job.above)
+    {
+        slot.lookAt->eye = centre + vsg::dvec3(0.0, 0.0, radius * 1.5);
+        slot.lookAt->up = vsg::dvec3(0.0, 1.0, 0.0);
+    }
+    else
+    {
+        slot.lookAt->eye = centre + vsg::dvec3(0.0, -radius * 1.5, 0.0);
+        slot.lookAt->up = vsg::dvec3(0.0, 0.0, 1.0);
+    }
+    slot.lookAt->center = job.hasCenter ? job.center : centre;
+    if (job.hasEye) slot.lookAt->eye = job.eye;
+
+    double distance = vsg::length(slot.lookAt->eye - slot.lookAt->center);
+    slot.perspective->nearDistance = nearFarRatio * radius;
+    slot.perspective->farDistance = distance + radius * 3.0;
+
+    slot.view->children = {job.scene};
+
+    // only compile for this slot's View, anything already compiled through the shared objects is skipped
+    auto view = slot.view;
+    auto result = _viewer->compileManager->compile(slot.renderGraph, [&view](vsg::Context& context) { return context.view == view.get(); });
+    vsg::updateViewer(*_viewer, result);
+
+    slot.root->setAllChildren(true);
+    slot.job = std::move(job);
+    slot.renderStart = std::chrono::steady_clock::now();
+}
+
+void BatchServer::_releaseWritten()
+{
+    // release the models whose results have been written, and then any shared objects only they used. Done here rather
+    // than on the writer thread so nothing is removed from a View or pruned while the main thread compiles or records.
+    bool released = false;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        for (auto& slot : _slots)
+        {
+            if (slot->state != FREE || !slot->job.scene) continue;
+
+            slot->view->children.clear();
+            slot->job.scene = {};
+            released = true;
+        }
+    }
+    if (released) options->sharedObjects->prune();
+}
+
+void BatchServer::_writerLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _condition.wait(lock, [this]() { return _stop || !_writing.empty(); });
+        if (_writing.empty()) break;
+
+        auto slot = _writing.front();
+        lock.unlock();
+
+        bool written = vsg::write(slot->imageData, slot->job.output, options);
+        auto duration = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - slot->renderStart).count();
+
+        lock.lock();
+
+        // one line per job so a driving process can stream the results
+        if (written)
+        {
+            std::cout << "done " << slot->job.index << " " << slot->job.output << " load " << slot->job.loadTime << "ms render+write " << duration << "ms" << std::endl;
+            ++_numCompleted;
+        }
+        else
+        {
+            std::cout << "failed " << slot->job.index << " " << slot->job.output << " : could not write" << std::endl;
+            ++_numFailed;
+        }
+
+        _writing.pop_front();
+        slot->state = FREE;
+        _condition.notify_all();
+    }
+}
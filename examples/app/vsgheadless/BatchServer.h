@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "PipelineCache.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <istream>
+#include <mutex>
+#include <thread>
+
+// A render job read from a line of the job stream:
+//     model output [width height] [above] [eye x y z] [center x y z]
+// the camera defaults to looking at the model from the front, as vsgheadless does, eye and center override that.
+struct BatchJob
+{
+    size_t index = 0;
+    vsg::Path model;
+    vsg::Path output;
+    VkExtent2D extent{0, 0};
+    bool above = false;
+    bool hasEye = false;
+    bool hasCenter = false;
+    vsg::dvec3 eye;
+    vsg::dvec3 center;
+
+    vsg::ref_ptr<vsg::Node> scene;
+    double loadTime = 0.0;
+
+    bool parse(const std::string& line, const VkExtent2D& defaultExtent);
+};
+
+// Renders a stream of jobs with a single Instance, Device and Viewer kept warm across all of them. Models are loaded
+// ahead on a loader thread with SharedObjects so state and shaders common to different models are shared, and compiled,
+// once. Up to numSlots jobs are rendered together in each frame, each into its own offscreen RenderGraph and View. The
+// slots, their framebuffers and readback buffers are pooled by resolution and reused, the pipelines compiled for a slot's
+// View are reused by every later job that loads the same shared state. Results are written on a writer thread straight
+// from the mapped readback buffer while the next frame's jobs render, and each is reported on stdout as it completes.
+// Models are released, and the SharedObjects pruned, on the main thread between frames once their results are written.
+// When a PipelineCache is provided every model is loaded through it and it is saved when run() completes.
+class BatchServer : public vsg::Inherit<vsg::Object, BatchServer>
+{
+public:
+    BatchServer(vsg::ref_ptr<vsg::Device> in_device, int in_queueFamily, vsg::ref_ptr<vsg::Options> in_options, uint32_t in_numSlots, VkFormat in_colorFormat, VkFormat in_depthFormat,
+                vsg::ref_ptr<PipelineCache> in_pipelineCache = {});
+
+    const vsg::ref_ptr<vsg::Device> device;
+    const int queueFamily;
+    const vsg::ref_ptr<vsg::Options> options;
+    const uint32_t numSlots;
+    const VkFormat colorFormat;
+    const VkFormat depthFormat;
+    const vsg::ref_ptr<PipelineCache> pipelineCache;
+
+    VkExtent2D defaultExtent{512, 512};
+
+    // render the jobs read from stream until it ends, returns the number of jobs that failed
+    size_t run(std::istream& jobs);
+
+protected:
+    enum State
+    {
+        FREE,
+        RENDERING,
+        WRITING
+    };
+
+    struct Slot : public vsg::Inherit<vsg::Object, Slot>
+    {
+        VkExtent2D extent;
+        State state = FREE;
+
+        vsg::ref_ptr<vsg::LookAt> lookAt;
+        vsg::ref_ptr<vsg::Perspective> perspective;
+        vsg::ref_ptr<vsg::View> view;
+        vsg::ref_ptr<vsg::RenderGraph> renderGraph;
+        vsg::ref_ptr<vsg::Switch> root;
+        vsg::ref_ptr<vsg::ubvec4Array2D> imageData;
+
+        BatchJob job;
+        std::chrono::steady_clock::time_point renderStart;
+    };
+
+    void _loaderLoop(std::istream& jobs);
+    bool _nextJob(BatchJob& job, bool block);
+
+    vsg::ref_ptr<Slot> _createSlot(const VkExtent2D& extent, vsg::ref_ptr<Slot> replaced = {});
+    vsg::ref_ptr<Slot> _acquireSlot(const VkExtent2D& extent);
+    void _assign(Slot& slot, BatchJob& job);
+    void _releaseWritten();
+    void _writerLoop();
+
+    vsg::ref_ptr<vsg::Viewer> _viewer;
+    vsg::ref_ptr<vsg::CommandGraph> _commandGraph;
+    vsg::ref_ptr<vsg::RenderPass> _renderPass;
+    std::vector<vsg::ref_ptr<Slot>> _slots;
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<BatchJob> _loaded;
+    bool _loaderDone = false;
+    std::deque<vsg::ref_ptr<Slot>> _writing;
+    bool _stop = false;
+    size_t _numFailed = 0;
+    size_t _numCompleted = 0;
+};
@@ -0,0 +1,254 @@
+#include "VideoEncoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+#if defined(_WIN32)
+#    define popen _popen
+#    define pclose _pclose
+#else
+#    include <csignal>
+#endif
+
+VideoEncoder::VideoEncoder(vsg::ref_ptr<vsg::Device> in_device, vsg::ref_ptr<vsg::Image> in_sourceImage, const VkExtent2D& in_extent, VkFormat in_format, uint32_t in_numBuffers) :
+    device(in_device),
+    sourceImage(in_sourceImage),
+    extent(in_extent),
+    format(in_format),
+    numBuffers(std::max(in_numBuffers, static_cast<uint32_t>(latency + 1)))
+{
+    _frameSize = VkDeviceSize(extent.width) * extent.height * 4;
+
+    VkImageSubresourceRange colorRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    _slots.resize(numBuffers);
+    for (auto& slot : _slots)
+    {
+        slot.buffer = vsg::createBufferAndMemory(device, _frameSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+        // the memory stays mapped for the lifetime of the buffer so the writer thread passes it straight to the encoder
+        auto memory = slot.buffer->getDeviceMemory(device->deviceID);
+        if (memory->map(slot.buffer->getMemoryOffset(device->deviceID), _frameSize, 0, &slot.mapped) != VK_SUCCESS)
+        {
+            vsg::warn("VideoEncoder() unable to map readback buffer of ", _frameSize, " bytes");
+        }
+
+        slot.commands = vsg::Commands::create();
+
+        // the RenderGraph leaves the color image in PRESENT_SRC
+        auto transitionSourceImageToTransferSourceLayoutBarrier = vsg::ImageMemoryBarrier::create(
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, // srcAccessMask
+            VK_ACCESS_TRANSFER_READ_BIT,          // dstAccessMask
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,      // oldLayout
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, // newLayout
+            VK_QUEUE_FAMILY_IGNORED,              // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,              // dstQueueFamilyIndex
+            sourceImage,                          // image
+            colorRange                            // subresourceRange
+        );
+
+        slot.commands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, transitionSourceImageToTransferSourceLayoutBarrier));
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0; // tightly packed
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = VkOffset3D{0, 0, 0};
+        region.imageExtent = VkExtent3D{extent.width, extent.height, 1};
+
+        auto copyImage = vsg::CopyImageToBuffer::create();
+        copyImage->srcImage = sourceImage;
+        copyImage->srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        copyImage->dstBuffer = slot.buffer;
+        copyImage->regions.push_back(region);
+        slot.commands->addChild(copyImage);
+
+        auto transitionSourceImageBackToPresentBarrier = vsg::ImageMemoryBarrier::create(
+            VK_ACCESS_TRANSFER_READ_BIT,          // srcAccessMask
+            0,                                    // dstAccessMask
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, // oldLayout
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,      // newLayout
+            VK_QUEUE_FAMILY_IGNORED,              // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,              // dstQueueFamilyIndex
+            sourceImage,                          // image
+            colorRange                            // subresourceRange
+        );
+
+        auto transitionDestinationBufferToHostReadBarrier = vsg::BufferMemoryBarrier::create(
+            VK_ACCESS_TRANSFER_WRITE_BIT, // srcAccessMask
+            VK_ACCESS_HOST_READ_BIT,      // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,      // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,      // dstQueueFamilyIndex
+            slot.buffer,                  // buffer
+            0,                            // offset
+            _frameSize                    // size
+        );
+
+        slot.commands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, transitionSourceImageBackToPresentBarrier, transitionDestinationBufferToHostReadBarrier));
+    }
+}
+
+VideoEncoder::~VideoEncoder()
+{
+    close();
+}
+
+std::string VideoEncoder::ffmpegCommand(const VkExtent2D& extent, VkFormat format, const std::string& codec, const std::string& encoder, uint32_t fps, uint32_t bitrate, const vsg::Path& filename)
+{
+    bool h265 = (codec == "h265" || codec == "hevc");
+
+    // the readback is 4 bytes per pixel, the alpha channel is ignored when encoding
+    bool bgra = (format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB);
+
+    std::stringstream command;
+    command << "ffmpeg -hide_banner -loglevel error -y";
+    if (encoder == "vaapi") command << " -vaapi_device /dev/dri/renderD128";
+    command << " -f rawvideo -pix_fmt " << (bgra ? "bgr0" : "rgb0") << " -s " << extent.width << "x" << extent.height << " -r " << fps << " -i -";
+
+    if (encoder == "nvenc")
+    {
+        // NVENC converts from RGB on the GPU
+        command << " -c:v " << (h265 ? "hevc_nvenc" : "h264_nvenc") << " -preset p4";
+    }
+    else if (encoder == "vaapi")
+    {
+        command << " -vf format=nv12,hwupload -c:v " << (h265 ? "hevc_vaapi" : "h264_vaapi");
+    }
+    else if (encoder == "qsv")
+    {
+        command << " -vf format=nv12 -c:v " << (h265 ? "hevc_qsv" : "h264_qsv");
+    }
+    else
+    {
+        command << " -c:v " << (h265 ? "libx265" : "libx264") << " -preset fast -pix_fmt yuv420p";
+    }
+
+    if (bitrate > 0) command << " -b:v " << bitrate << "k";
+    command << " \"" << filename.string() << "\"";
+
+    return command.str();
+}
+
+bool VideoEncoder::open(const std::string& command)
+{
+#if !defined(_WIN32)
+    // report a failed encoder process through fwrite() rather than terminating
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+#if defined(_WIN32)
+    _pipe = popen(command.c_str(), "wb");
+#else
+    _pipe = popen(command.c_str(), "w");
+#endif
+    if (!_pipe)
+    {
+        std::cout << "VideoEncoder : could not start " << command << std::endl;
+        return false;
+    }
+
+    _writer = std::thread([this]() { _writerLoop(); });
+    return true;
+}
+
+void VideoEncoder::beginFrame()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this]() { return _failed || _slots[_nextSlot].state == FREE; });
+
+    stallTime += std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - start).count();
+}
+
+void VideoEncoder::record(vsg::CommandBuffer& commandBuffer) const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    auto& slot = _slots[_nextSlot];
+    if (slot.state != FREE || !slot.mapped) return;
+
+    slot.commands->record(commandBuffer);
+    slot.state = RECORDED;
+    _recorded.push_back(_nextSlot);
+
+    _nextSlot = (_nextSlot + 1) % numBuffers;
+}
+
+void VideoEncoder::encodeCompleted(size_t numInFlight)
+{
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        while (_recorded.size() > numInFlight)
+        {
+            auto index = _recorded.front();
+            _recorded.pop_front();
+
+            _slots[index].state = ENCODING;
+            _encoding.push_back(index);
+        }
+    }
+    _condition.notify_all();
+}
+
+void VideoEncoder::close()
+{
+    if (!_pipe) return;
+
+    vkDeviceWaitIdle(*device);
+    encodeCompleted(0);
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return _failed || _encoding.empty(); });
+        _stop = true;
+    }
+    _condition.notify_all();
+    if (_writer.joinable()) _writer.join();
+
+    // the encoder finishes the stream once its input is closed
+    int result = pclose(_pipe);
+    _pipe = nullptr;
+
+    if (result != 0) std::cout << "VideoEncoder : encoder exited with " << result << std::endl;
+}
+
+void VideoEncoder::_writerLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _condition.wait(lock, [this]() { return _stop || !_encoding.empty(); });
+        if (_encoding.empty()) break;
+
+        auto index = _encoding.front();
+        auto& slot = _slots[index];
+        bool failed = _failed;
+
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        bool written = !failed && std::fwrite(slot.mapped, 1, _frameSize, _pipe) == _frameSize;
+        auto duration = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+
+        _encoding.pop_front();
+        slot.state = FREE;
+        writeTime += duration;
+        if (written)
+        {
+            ++numEncoded;
+        }
+        else if (!_failed)
+        {
+            std::cout << "VideoEncoder : failed to write frame to the encoder, stopping encoding." << std::endl;
+            _failed = true;
+        }
+        _condition.notify_all();
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Command placed after the RenderGraph that copies each rendered frame into one of a ring of persistently mapped
+// readback buffers and streams them, in order, to an encoder process reading raw frames from a pipe. The main loop only
+// waits on the fence of the frame submitted latency frames ago before handing its buffer to the writer thread, so the GPU
+// renders frame N+2 while frame N is being encoded. If the encoder falls behind beginFrame() blocks until a buffer is
+// free rather than dropping frames.
+class VideoEncoder : public vsg::Inherit<vsg::Command, VideoEncoder>
+{
+public:
+    VideoEncoder(vsg::ref_ptr<vsg::Device> in_device, vsg::ref_ptr<vsg::Image> in_sourceImage, const VkExtent2D& in_extent, VkFormat in_format, uint32_t in_numBuffers);
+    ~VideoEncoder();
+
+    // frames in flight on the GPU behind the one being recorded, matches the fences kept by the viewer's RecordAndSubmitTask
+    static constexpr size_t latency = 2;
+
+    const vsg::ref_ptr<vsg::Device> device;
+    const vsg::ref_ptr<vsg::Image> sourceImage;
+    const VkExtent2D extent;
+    const VkFormat format;
+    const uint32_t numBuffers;
+
+    // ffmpeg command line reading raw frames from stdin and encoding them with codec, h264 or h265, using encoder, one
+    // of nvenc, vaapi, qsv or software, the container is chosen by ffmpeg from the filename's extension
+    static std::string ffmpegCommand(const VkExtent2D& extent, VkFormat format, const std::string& codec, const std::string& encoder, uint32_t fps, uint32_t bitrate, const vsg::Path& filename);
+
+    // start the encoder process, the command must read raw frames of extent and format from stdin
+    bool open(const std::string& command);
+
+    // wait until the buffer the next frame will be copied into has been written to the encoder, call before recordAndSubmit()
+    void beginFrame();
+
+    // hand the frames that have completed on the GPU to the writer thread, keeping the most recent numInFlight that may not have
+    void encodeCompleted(size_t numInFlight);
+
+    // wait for the device and encoder to process all the frames and close the stream
+    void close();
+
+    void record(vsg::CommandBuffer& commandBuffer) const override;
+
+    // stats accumulated over all frames
+    uint64_t numEncoded = 0;
+    double stallTime = 0.0;  // milliseconds the frame loop spent in beginFrame() waiting on the encoder
+    double writeTime = 0.0;  // milliseconds the writer thread spent passing frames to the encoder
+
+protected:
+    enum State
+    {
+        FREE,
+        RECORDED,
+        ENCODING
+    };
+
+    struct Slot
+    {
+        vsg::ref_ptr<vsg::Buffer> buffer;
+        void* mapped = nullptr;
+        State state = FREE;
+        vsg::ref_ptr<vsg::Commands> commands;
+    };
+
+    void _writerLoop();
+
+    VkDeviceSize _frameSize = 0;
+    mutable std::vector<Slot> _slots;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _condition;
+    mutable uint32_t _nextSlot = 0;
+    mutable std::deque<uint32_t> _recorded;
+    std::deque<uint32_t> _encoding;
+
+    FILE* _pipe = nullptr;
+    bool _failed = false;
+    bool _stop = false;
+    std::thread _writer;
+};
@@ -19,7 +19,13 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #    include <vsgXchange/all.h>
 #endif
 
+#include "BatchServer.h"
+#include "FrameTrace.h"
+#include "VideoEncoder.h"
+
 #include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <thread>
 
@@ -355,9 +361,25 @@ int main(int argc, char** argv)
     bool above = arguments.read("--above");
     bool enableGeometryShader = arguments.read("--gs");
 
+    // stream the frames to a video encoder rather than writing color and depth images each frame
+    auto encodeFilename = arguments.value<vsg::Path>("", "--encode");
+    auto codec = arguments.value<std::string>("h264", "--codec");
+    auto encoder = arguments.value<std::string>("nvenc", "--encoder");
+    auto fps = arguments.value<uint32_t>(30, "--fps");
+    auto bitrate = arguments.value<uint32_t>(0, "--bitrate");
+    auto encodeBuffers = arguments.value<uint32_t>(4, "--encode-buffers");
+    auto encodeCommand = arguments.value<std::string>("", "--encode-command");
+
+    // batch mode rendering the jobs read from a file, or stdin with -, keeping the device and compiled objects across jobs
+    auto batchFilename = arguments.value<vsg::Path>("", "--batch");
+    auto batchSlots = arguments.value<uint32_t>(4, "--batch-slots");
+    auto pipelineCacheDirectory = arguments.value(std::string(), "--pipeline-cache");
+
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
-    if (argc <= 1)
+    if (argc <= 1 && batchFilename.empty())
     {
         std::cout << "Please specify model to load on command line" << std::endl;
         return 1;
@@ -372,6 +394,7 @@ int main(int argc, char** argv)
     if (samples != VK_SAMPLE_COUNT_1_BIT) vulkanVersion = VK_API_VERSION_1_2;
 
     auto options = vsg::Options::create();
+    if (frameTrace) frameTrace->addReaderWriter(*options);
     options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
     options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
 #ifdef vsgXchange_all
@@ -379,11 +402,15 @@ int main(int argc, char** argv)
     options->add(vsgXchange::all::create());
 #endif
 
-    auto vsg_scene = vsg::read_cast<vsg::Node>(argv[1], options);
-    if (!vsg_scene)
+    vsg::ref_ptr<vsg::Node> vsg_scene;
+    if (batchFilename.empty())
     {
-        std::cout << "No command graph created." << std::endl;
-        return 1;
+        vsg_scene = vsg::read_cast<vsg::Node>(argv[1], options);
+        if (!vsg_scene)
+        {
+            std::cout << "No command graph created." << std::endl;
+            return 1;
+        }
     }
 
     // create instance
@@ -414,7 +441,47 @@ int main(int argc, char** argv)
     deviceFeatures->get().samplerAnisotropy = VK_TRUE;
     deviceFeatures->get().geometryShader = enableGeometryShader;
 
+    // the batch server creates the VkPipelines of all its jobs through one cache that persists between runs
+    vsg::ref_ptr<PipelineCache> pipelineCache;
+    bool creationFeedback = false;
+    if (!batchFilename.empty() && !pipelineCacheDirectory.empty())
+    {
+        pipelineCache = PipelineCache::create(pipelineCacheDirectory);
+
+        // creation feedback reports whether each pipeline was found in the cache
+        for (auto& extension : physicalDevice->enumerateDeviceExtensionProperties())
+        {
+            if (std::strcmp(extension.extensionName, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) == 0) creationFeedback = true;
+        }
+        if (creationFeedback) deviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    }
+
     auto device = vsg::Device::create(physicalDevice, queueSettings, validatedNames, deviceExtensions, deviceFeatures);
+    if (creationFeedback) pipelineCache->enableCreationFeedback(device);
+
+    if (!batchFilename.empty())
+    {
+        auto batchServer = BatchServer::create(device, queueFamily, options, batchSlots, imageFormat, depthFormat, pipelineCache);
+        batchServer->defaultExtent = extent;
+
+        size_t numFailed = 0;
+        if (batchFilename == "-")
+        {
+            numFailed = batchServer->run(std::cin);
+        }
+        else
+        {
+            std::ifstream fin(batchFilename.string());
+            if (!fin)
+            {
+                std::cout << "Could not open job file " << batchFilename << std::endl;
+                return 1;
+            }
+            numFailed = batchServer->run(fin);
+        }
+
+        return numFailed == 0 ? 0 : 1;
+    }
 
     // compute the bounds of the scene graph to help position camera
     vsg::ComputeBounds computeBounds;
@@ -518,11 +585,35 @@ int main(int argc, char** argv)
     else
         renderGraph->addChild(view);
 
+    vsg::ref_ptr<VideoEncoder> videoEncoder;
+    if (!encodeFilename.empty())
+    {
+        // the encoder's readback replaces the per frame color and depth image capture
+        colorBufferCapture = {};
+        copiedColorBuffer = {};
+        depthBufferCapture = {};
+        copiedDepthBuffer = {};
+
+        if (resizeCadence)
+        {
+            std::cout << "Warning: --resize isn't supported when encoding, ignoring." << std::endl;
+            resizeCadence = 0;
+        }
+
+        videoEncoder = VideoEncoder::create(device, colorImageView->image, extent, imageFormat, encodeBuffers);
+
+        auto command = encodeCommand.empty() ? VideoEncoder::ffmpegCommand(extent, imageFormat, codec, encoder, fps, bitrate, encodeFilename) : encodeCommand;
+        std::cout << "Encoding with : " << command << std::endl;
+        if (!videoEncoder->open(command)) return 1;
+    }
+
     auto commandGraph = vsg::CommandGraph::create(device, queueFamily);
     commandGraph->addChild(renderGraph);
     commandGraphs.push_back(commandGraph);
     if (colorBufferCapture) commandGraph->addChild(colorBufferCapture);
     if (depthBufferCapture) commandGraph->addChild(depthBufferCapture);
+    if (videoEncoder) commandGraph->addChild(videoEncoder);
+    if (frameTrace) frameTrace->addTimestamps(*commandGraph);
 
     // create the viewer
     auto viewer = vsg::Viewer::create();
@@ -540,13 +631,18 @@ int main(int argc, char** argv)
 
     viewer->assignRecordAndSubmitTaskAndPresentation(commandGraphs);
 
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     uint64_t waitTimeout = 1999999999; // 1second in nanoseconds.
 
     // rendering main loop
     while (viewer->advanceToNextFrame() && (numFrames--) > 0)
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
         std::cout << "Frame " << viewer->getFrameStamp()->frameCount << std::endl;
         if (resizeCadence && (viewer->getFrameStamp()->frameCount>0) && ((viewer->getFrameStamp()->frameCount) % resizeCadence == 0))
         {
@@ -625,13 +721,24 @@ int main(int argc, char** argv)
 
         }
 
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer, this includes Frame events generated by the viewer each frame
         viewer->handleEvents();
 
+        traceFrame.phase("update");
         viewer->update();
 
+        if (videoEncoder) videoEncoder->beginFrame();
+
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        if (videoEncoder)
+        {
+            // only wait for the frame submitted latency frames ago, the GPU carries on rendering the more recent frames while it's encoded
+            if (viewer->waitForFences(VideoEncoder::latency, waitTimeout)) videoEncoder->encodeCompleted(VideoEncoder::latency);
+        }
+
         if (copiedColorBuffer || copiedDepthBuffer)
         {
             // wait for completion.
@@ -689,6 +796,18 @@ int main(int argc, char** argv)
         }
     }
 
+    if (videoEncoder)
+    {
+        videoEncoder->close();
+        std::cout << "Encoded " << videoEncoder->numEncoded << " frames to " << encodeFilename << ", frame loop stalled on the encoder for " << videoEncoder->stallTime << "ms, writing frames took " << videoEncoder->writeTime << "ms" << std::endl;
+    }
+
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -3,6 +3,8 @@
 
 #include <iostream>
 
+#include "FrameTrace.h"
+
 int main(int argc, char** argv)
 {
     // set up defaults and read command line arguments to override them
@@ -17,6 +19,9 @@ int main(int argc, char** argv)
     vsg::Path filename = "models/openstreetmap.vsgt";
     if (argc > 1) filename = arguments[1];
 
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
+    if (frameTrace) frameTrace->addReaderWriter(*options);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     // load the scene graph
@@ -68,24 +73,40 @@ int main(int argc, char** argv)
 
     // add the CommandGraph to render the scene
     auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
+    if (frameTrace) frameTrace->addTimestamps(*commandGraph);
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     // compile all Vulkan objects and transfer image, vertex and primitive data to GPU
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     // rendering main loop
     while (viewer->advanceToNextFrame())
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        traceFrame.phase("update");
         viewer->update();
 
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        traceFrame.phase("present");
         viewer->present();
     }
 
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
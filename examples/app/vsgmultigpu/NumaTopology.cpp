@@ -0,0 +1,170 @@
+#include "NumaTopology.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#if defined(__linux__)
+#    include <sched.h>
+#endif
+
+namespace
+{
+    // parse a sysfs cpu list such as "0-15,32-47"
+    std::vector<uint32_t> parseCPUList(const std::string& str)
+    {
+        std::vector<uint32_t> cpus;
+        std::stringstream stream(str);
+        std::string range;
+        while (std::getline(stream, range, ','))
+        {
+            uint32_t first = 0, last = 0;
+            int count = std::sscanf(range.c_str(), "%u-%u", &first, &last);
+            if (count == 1) last = first;
+            if (count < 1) continue;
+            for (uint32_t cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+} // namespace
+
+NumaTopology::NumaTopology()
+{
+#if defined(__linux__)
+    for (int node = 0;; ++node)
+    {
+        std::ifstream fin("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!fin) break;
+
+        std::string line;
+        std::getline(fin, line);
+        nodeCPUs.push_back(parseCPUList(line));
+    }
+#endif
+
+    if (nodeCPUs.empty())
+    {
+        std::vector<uint32_t> cpus;
+        for (uint32_t cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); ++cpu) cpus.push_back(cpu);
+        nodeCPUs.push_back(cpus);
+    }
+
+    for (size_t node = 0; node < nodeCPUs.size(); ++node)
+    {
+        for (auto cpu : nodeCPUs[node])
+        {
+            if (cpu >= _cpuNodes.size()) _cpuNodes.resize(cpu + 1, 0);
+            _cpuNodes[cpu] = static_cast<int>(node);
+        }
+    }
+}
+
+int NumaTopology::nodeOfDevice(vsg::PhysicalDevice* physicalDevice) const
+{
+    if (numNodes() == 1) return 0;
+
+#if defined(__linux__)
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice->vk(), nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice->vk(), nullptr, &extensionCount, extensions.data());
+
+    bool supportsPCIBusInfo = false;
+    for (auto& extension : extensions)
+    {
+        if (std::string(extension.extensionName) == VK_EXT_PCI_BUS_INFO_EXTENSION_NAME) supportsPCIBusInfo = true;
+    }
+    if (!supportsPCIBusInfo) return -1;
+
+    auto pciBusInfo = physicalDevice->getProperties<VkPhysicalDevicePCIBusInfoPropertiesEXT, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PCI_BUS_INFO_PROPERTIES_EXT>();
+
+    char path[128];
+    std::snprintf(path, sizeof(path), "/sys/bus/pci/devices/%04x:%02x:%02x.%x/numa_node", pciBusInfo.pciDomain, pciBusInfo.pciBus, pciBusInfo.pciDevice, pciBusInfo.pciFunction);
+
+    int node = -1;
+    std::ifstream fin(path);
+    if (fin >> node && node >= 0 && static_cast<size_t>(node) < numNodes()) return node;
+#else
+    (void)physicalDevice;
+#endif
+    return -1;
+}
+
+int NumaTopology::currentNode() const
+{
+#if defined(__linux__)
+    int cpu = sched_getcpu();
+    if (cpu >= 0) return nodeOfCPU(static_cast<uint32_t>(cpu));
+#endif
+    return 0;
+}
+
+vsg::Affinity NumaTopology::nodeAffinity(int node) const
+{
+    vsg::Affinity affinity;
+    if (node >= 0 && static_cast<size_t>(node) < numNodes())
+    {
+        affinity.cpus.insert(nodeCPUs[node].begin(), nodeCPUs[node].end());
+    }
+    return affinity;
+}
+
+NodeLocalAllocator::NodeLocalAllocator(vsg::ref_ptr<NumaTopology> in_topology, std::unique_ptr<Allocator> in_nestedAllocator) :
+    vsg::Allocator(std::move(in_nestedAllocator)),
+    topology(in_topology)
+{
+    for (size_t node = 0; node < topology->numNodes(); ++node)
+    {
+        _nodeAllocators.emplace_back(new vsg::Allocator());
+        _nodeAllocations.emplace_back(new std::atomic_uint64_t(0));
+    }
+}
+
+void* NodeLocalAllocator::allocate(std::size_t size, vsg::AllocatorAffinity allocatorAffinity)
+{
+    if (_nodeAllocators.size() <= 1) return Allocator::allocate(size, allocatorAffinity);
+
+    auto node = static_cast<size_t>(topology->currentNode()) % _nodeAllocators.size();
+    _nodeAllocations[node]->fetch_add(size, std::memory_order_relaxed);
+    return _nodeAllocators[node]->allocate(size, allocatorAffinity);
+}
+
+bool NodeLocalAllocator::deallocate(void* ptr, std::size_t size)
+{
+    if (ptr == nullptr) return Allocator::deallocate(ptr, size);
+
+    // try the node the calling thread runs on first, as memory is most often freed on the node that allocated it
+    if (_nodeAllocators.size() > 1)
+    {
+        auto current = static_cast<size_t>(topology->currentNode()) % _nodeAllocators.size();
+        if (_nodeAllocators[current]->deallocate(ptr, size)) return true;
+
+        for (size_t node = 0; node < _nodeAllocators.size(); ++node)
+        {
+            if (node != current && _nodeAllocators[node]->deallocate(ptr, size)) return true;
+        }
+    }
+
+    // allocated before this allocator was assigned
+    return Allocator::deallocate(ptr, size);
+}
+
+size_t NodeLocalAllocator::deleteEmptyMemoryBlocks()
+{
+    size_t memoryDeleted = Allocator::deleteEmptyMemoryBlocks();
+    for (auto& nodeAllocator : _nodeAllocators) memoryDeleted += nodeAllocator->deleteEmptyMemoryBlocks();
+    return memoryDeleted;
+}
+
+void NodeLocalAllocator::report(std::ostream& out) const
+{
+    out << "NodeLocalAllocator::report() " << _nodeAllocators.size() << " nodes" << std::endl;
+    for (size_t node = 0; node < _nodeAllocators.size(); ++node)
+    {
+        out << "    node " << node << " bytes allocated " << _nodeAllocations[node]->load() << std::endl;
+    }
+    Allocator::report(out);
+}
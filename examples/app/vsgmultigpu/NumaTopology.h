@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <memory>
+
+// NUMA nodes of the host with their CPUs, and the node each GPU's PCIe root is attached to, read from sysfs on Linux.
+// Elsewhere, or when the kernel doesn't report it, the host is treated as a single node holding all the CPUs so the
+// placement it suggests is the same as leaving the threads unpinned.
+class NumaTopology : public vsg::Inherit<vsg::Object, NumaTopology>
+{
+public:
+    NumaTopology();
+
+    std::vector<std::vector<uint32_t>> nodeCPUs;
+
+    size_t numNodes() const { return nodeCPUs.size(); }
+
+    int nodeOfCPU(uint32_t cpu) const { return cpu < _cpuNodes.size() ? _cpuNodes[cpu] : 0; }
+
+    // node nearest the physical device, read through VK_EXT_pci_bus_info which needs a Vulkan 1.1 instance, -1 when unknown
+    int nodeOfDevice(vsg::PhysicalDevice* physicalDevice) const;
+
+    // node of the CPU the calling thread is running on
+    int currentNode() const;
+
+    // all the CPUs of a node, so the OS can still balance threads across the node's cores
+    vsg::Affinity nodeAffinity(int node) const;
+
+protected:
+    std::vector<int> _cpuNodes;
+};
+
+// Allocator that gives each NUMA node its own set of memory blocks and serves allocations from the blocks of the node the
+// calling thread is running on. With the record threads pinned to the node of their GPU, the blocks they allocate from are
+// first touched, and so placed by the kernel, on that node rather than wherever the main thread's blocks happen to lie.
+class NodeLocalAllocator : public vsg::Allocator
+{
+public:
+    NodeLocalAllocator(vsg::ref_ptr<NumaTopology> in_topology, std::unique_ptr<Allocator> in_nestedAllocator = {});
+
+    const vsg::ref_ptr<NumaTopology> topology;
+
+    void* allocate(std::size_t size, vsg::AllocatorAffinity allocatorAffinity = vsg::ALLOCATOR_AFFINITY_OBJECTS) override;
+    bool deallocate(void* ptr, std::size_t size) override;
+
+    size_t deleteEmptyMemoryBlocks() override;
+    void report(std::ostream& out) const override;
+
+protected:
+    std::vector<std::unique_ptr<vsg::Allocator>> _nodeAllocators;
+    std::vector<std::unique_ptr<std::atomic_uint64_t>> _nodeAllocations;
+};
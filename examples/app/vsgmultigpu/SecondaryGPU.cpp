@@ -0,0 +1,241 @@
+#include "SecondaryGPU.h"
+
+#include <cstring>
+#include <iostream>
+
+SecondaryGPU::SecondaryGPU(vsg::ref_ptr<vsg::Device> in_device, int in_queueFamily, const VkExtent2D& in_extent, VkFormat in_colorFormat) :
+    device(in_device),
+    queueFamily(in_queueFamily),
+    extent(in_extent),
+    colorFormat(in_colorFormat)
+{
+    VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+
+    auto colorImage = vsg::Image::create();
+    colorImage->imageType = VK_IMAGE_TYPE_2D;
+    colorImage->format = colorFormat;
+    colorImage->extent = VkExtent3D{extent.width, extent.height, 1};
+    colorImage->mipLevels = 1;
+    colorImage->arrayLayers = 1;
+    colorImage->samples = VK_SAMPLE_COUNT_1_BIT;
+    colorImage->tiling = VK_IMAGE_TILING_OPTIMAL;
+    colorImage->usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    colorImage->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorImage->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    _colorImageView = vsg::createImageView(device, colorImage, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    auto depthImage = vsg::Image::create();
+    depthImage->imageType = VK_IMAGE_TYPE_2D;
+    depthImage->format = depthFormat;
+    depthImage->extent = VkExtent3D{extent.width, extent.height, 1};
+    depthImage->mipLevels = 1;
+    depthImage->arrayLayers = 1;
+    depthImage->samples = VK_SAMPLE_COUNT_1_BIT;
+    depthImage->tiling = VK_IMAGE_TILING_OPTIMAL;
+    depthImage->usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    depthImage->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthImage->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    _depthImageView = vsg::createImageView(device, depthImage, vsg::computeAspectFlagsForFormat(depthFormat));
+
+    auto renderPass = vsg::createRenderPass(device, colorFormat, depthFormat, false);
+    _framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{_colorImageView, _depthImageView}, extent.width, extent.height, 1);
+
+    // tightly packed host cached buffer to copy the color image into, kept mapped for the lifetime of the SecondaryGPU
+    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(extent.width) * extent.height * sizeof(vsg::ubvec4);
+    _readbackBuffer = vsg::createBufferAndMemory(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    _mappedReadback = vsg::MappedData<vsg::ubvec4Array2D>::create(_readbackBuffer->getDeviceMemory(device->deviceID), _readbackBuffer->getMemoryOffset(device->deviceID), 0, vsg::Data::Properties{colorFormat}, extent.width, extent.height);
+
+    frame = vsg::ubvec4Array2D::create(extent.width, extent.height, vsg::Data::Properties{colorFormat});
+    frame->properties.dataVariance = vsg::DYNAMIC_DATA;
+
+    active = vsg::Switch::create();
+}
+
+std::vector<std::pair<vsg::ref_ptr<vsg::Device>, int>> SecondaryGPU::createDevices(vsg::Window* window, size_t maxDevices)
+{
+    std::vector<std::pair<vsg::ref_ptr<vsg::Device>, int>> devices;
+
+    auto windowPhysicalDevice = window->getOrCreatePhysicalDevice();
+    auto instance = window->getOrCreateInstance();
+    for (auto& physicalDevice : instance->getPhysicalDevices())
+    {
+        if (devices.size() >= maxDevices) break;
+        if (physicalDevice->vk() == windowPhysicalDevice->vk()) continue;
+
+        int queueFamily = physicalDevice->getQueueFamily(VK_QUEUE_GRAPHICS_BIT);
+        if (queueFamily < 0) continue;
+
+        vsg::QueueSettings queueSettings{vsg::QueueSetting{queueFamily, {1.0}}};
+
+        auto deviceFeatures = vsg::DeviceFeatures::create();
+        deviceFeatures->get().samplerAnisotropy = VK_TRUE;
+
+        std::cout << "Secondary GPU : " << physicalDevice->getProperties().deviceName << std::endl;
+        devices.emplace_back(vsg::Device::create(physicalDevice, queueSettings, vsg::Names{}, vsg::Names{}, deviceFeatures), queueFamily);
+    }
+    return devices;
+}
+
+vsg::ref_ptr<vsg::CommandGraph> SecondaryGPU::createCommandGraph(vsg::ref_ptr<vsg::Camera> camera, vsg::ref_ptr<vsg::Node> scenegraph)
+{
+    auto renderGraph = vsg::RenderGraph::create();
+    renderGraph->framebuffer = _framebuffer;
+    renderGraph->renderArea.offset = {0, 0};
+    renderGraph->renderArea.extent = extent;
+    renderGraph->setClearValues();
+    renderGraph->addChild(vsg::View::create(camera, scenegraph));
+
+    // copy the color image, left in PRESENT_SRC_KHR by the render pass, into the readback buffer
+    auto transitionColorImageToTransferSource = vsg::ImageMemoryBarrier::create(
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,                          // srcAccessMask
+        VK_ACCESS_TRANSFER_READ_BIT,                                   // dstAccessMask
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,                               // oldLayout
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,                          // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                                       // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                                       // dstQueueFamilyIndex
+        _colorImageView->image,                                        // image
+        VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1} // subresourceRange
+    );
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = extent.width;
+    region.bufferImageHeight = extent.height;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = VkOffset3D{0, 0, 0};
+    region.imageExtent = VkExtent3D{extent.width, extent.height, 1};
+
+    auto copyImage = vsg::CopyImageToBuffer::create();
+    copyImage->srcImage = _colorImageView->image;
+    copyImage->srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    copyImage->dstBuffer = _readbackBuffer;
+    copyImage->regions.push_back(region);
+
+    auto transitionBufferToHostRead = vsg::BufferMemoryBarrier::create(
+        VK_ACCESS_TRANSFER_WRITE_BIT, // srcAccessMask
+        VK_ACCESS_HOST_READ_BIT,      // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,      // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,      // dstQueueFamilyIndex
+        _readbackBuffer,              // buffer
+        0,                            // offset
+        VK_WHOLE_SIZE                 // size
+    );
+
+    auto capture = vsg::Commands::create();
+    capture->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, transitionColorImageToTransferSource));
+    capture->addChild(copyImage);
+    capture->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, transitionBufferToHostRead));
+
+    active->addChild(true, renderGraph);
+    active->addChild(true, capture);
+
+    auto commandGraph = vsg::CommandGraph::create(device, queueFamily);
+    commandGraph->addChild(active);
+    return commandGraph;
+}
+
+void SecondaryGPU::assignTask(vsg::Viewer& viewer)
+{
+    for (auto& task : viewer.recordAndSubmitTasks)
+    {
+        for (auto& commandGraph : task->commandGraphs)
+        {
+            if (commandGraph->device == device) _task = task;
+        }
+    }
+}
+
+bool SecondaryGPU::readback(uint64_t timeout)
+{
+    if (!_task) return false;
+
+    // advanceToNextFrame() has already advanced the task, so fence() is for the frame about to be recorded, last used
+    // numBuffers frames ago, and fence(1) is for the last submission, whose copy into the readback buffer we want
+    auto fence = _task->fence(1);
+    if (!fence || !fence->hasDependencies() || fence->wait(timeout) != VK_SUCCESS) return false;
+
+    std::memcpy(frame->dataPointer(), _mappedReadback->dataPointer(), frame->dataSize());
+    frame->dirty();
+    return true;
+}
+
+vsg::ref_ptr<vsg::Node> SecondaryGPU::createComposite(vsg::ref_ptr<vsg::Options> options, double ndcMinX, double ndcMaxX) const
+{
+    auto vertexShader = vsg::ShaderStage::read(VK_SHADER_STAGE_VERTEX_BIT, "main", "shaders/vert_PushConstants.spv", options);
+    auto fragmentShader = vsg::ShaderStage::read(VK_SHADER_STAGE_FRAGMENT_BIT, "main", "shaders/frag_PushConstants.spv", options);
+    if (!vertexShader || !fragmentShader)
+    {
+        std::cout << "Could not create shaders." << std::endl;
+        return {};
+    }
+
+    vsg::DescriptorSetLayoutBindings descriptorBindings{
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr} // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
+    };
+
+    auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+
+    vsg::PushConstantRanges pushConstantRanges{
+        {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection view, and model matrices, actual push constant calls automatically provided by the VSG's DispatchTraversal
+    };
+
+    vsg::VertexInputState::Bindings vertexBindingsDescriptions{
+        VkVertexInputBindingDescription{0, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX}, // vertex data
+        VkVertexInputBindingDescription{1, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX}, // colour data
+        VkVertexInputBindingDescription{2, sizeof(vsg::vec2), VK_VERTEX_INPUT_RATE_VERTEX}  // tex coord data
+    };
+
+    vsg::VertexInputState::Attributes vertexAttributeDescriptions{
+        VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0}, // vertex data
+        VkVertexInputAttributeDescription{1, 1, VK_FORMAT_R32G32B32_SFLOAT, 0}, // colour data
+        VkVertexInputAttributeDescription{2, 2, VK_FORMAT_R32G32_SFLOAT, 0},    // tex coord data
+    };
+
+    // the composited region is pixel aligned with the window so neither depth testing nor culling is wanted
+    auto rasterizationState = vsg::RasterizationState::create();
+    rasterizationState->cullMode = VK_CULL_MODE_NONE;
+
+    auto depthStencilState = vsg::DepthStencilState::create();
+    depthStencilState->depthTestEnable = VK_FALSE;
+    depthStencilState->depthWriteEnable = VK_FALSE;
+
+    vsg::GraphicsPipelineStates pipelineStates{
+        vsg::VertexInputState::create(vertexBindingsDescriptions, vertexAttributeDescriptions),
+        vsg::InputAssemblyState::create(),
+        rasterizationState,
+        vsg::MultisampleState::create(),
+        vsg::ColorBlendState::create(),
+        depthStencilState};
+
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, pushConstantRanges);
+    auto graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
+
+    auto sampler = vsg::Sampler::create();
+    sampler->magFilter = VK_FILTER_NEAREST;
+    sampler->minFilter = VK_FILTER_NEAREST;
+    sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    auto texture = vsg::DescriptorImage::create(sampler, frame, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture});
+
+    auto scenegraph = vsg::StateGroup::create();
+    scenegraph->add(vsg::BindGraphicsPipeline::create(graphicsPipeline));
+    scenegraph->add(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->layout, 0, descriptorSet));
+
+    // the first row of frame is the top of the image
+    float x0 = static_cast<float>(ndcMinX), x1 = static_cast<float>(ndcMaxX);
+    auto vertices = vsg::vec3Array::create({{x0, -1.0f, 0.0f}, {x1, -1.0f, 0.0f}, {x1, 1.0f, 0.0f}, {x0, 1.0f, 0.0f}});
+    auto colors = vsg::vec3Array::create({{1.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}});
+    auto texcoords = vsg::vec2Array::create({{0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f}, {0.0f, 0.0f}});
+    auto indices = vsg::ushortArray::create({0, 1, 2, 2, 3, 0});
+
+    auto drawCommands = vsg::Commands::create();
+    drawCommands->addChild(vsg::BindVertexBuffers::create(0, vsg::DataList{vertices, colors, texcoords}));
+    drawCommands->addChild(vsg::BindIndexBuffer::create(indices));
+    drawCommands->addChild(vsg::DrawIndexed::create(6, 1, 0, 0, 0));
+    scenegraph->addChild(drawCommands);
+
+    return scenegraph;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// Renders into an offscreen framebuffer on a GPU other than the one driving the window and reads each frame back to host
+// memory, so the window's GPU can composite it into the final output. Each vsg::Device has its own memory, so the
+// composite goes through host memory; a peer copy between GPUs would need Vulkan device groups and a direct copy would
+// need external memory, neither of which vsg::Device sets up.
+class SecondaryGPU : public vsg::Inherit<vsg::Object, SecondaryGPU>
+{
+public:
+    SecondaryGPU(vsg::ref_ptr<vsg::Device> in_device, int in_queueFamily, const VkExtent2D& in_extent, VkFormat in_colorFormat);
+
+    const vsg::ref_ptr<vsg::Device> device;
+    const int queueFamily;
+    const VkExtent2D extent;
+    const VkFormat colorFormat;
+
+    // the last frame read back, DYNAMIC_DATA so it can be used as the window GPU's composite texture
+    vsg::ref_ptr<vsg::ubvec4Array2D> frame;
+
+    // enables recording of the offscreen render and readback, disable when this GPU has nothing to render in a frame
+    vsg::ref_ptr<vsg::Switch> active;
+
+    // create the devices for all the physical devices other than the window's that support graphics, up to maxDevices
+    static std::vector<std::pair<vsg::ref_ptr<vsg::Device>, int>> createDevices(vsg::Window* window, size_t maxDevices);
+
+    vsg::ref_ptr<vsg::CommandGraph> createCommandGraph(vsg::ref_ptr<vsg::Camera> camera, vsg::ref_ptr<vsg::Node> scenegraph);
+
+    // find the RecordAndSubmitTask that submits our CommandGraph, call after viewer->assignRecordAndSubmitTaskAndPresentation()
+    void assignTask(vsg::Viewer& viewer);
+
+    // wait for the last frame submitted to complete and copy it into frame, call before viewer->recordAndSubmit()
+    bool readback(uint64_t timeout);
+
+    // quad drawing frame into the window between ndcMinX and ndcMaxX, for a View whose Camera has an Orthographic(-1, 1, -1, 1, -1, 1) projection and identity view
+    vsg::ref_ptr<vsg::Node> createComposite(vsg::ref_ptr<vsg::Options> options, double ndcMinX, double ndcMaxX) const;
+
+protected:
+    vsg::ref_ptr<vsg::ImageView> _colorImageView;
+    vsg::ref_ptr<vsg::ImageView> _depthImageView;
+    vsg::ref_ptr<vsg::Framebuffer> _framebuffer;
+    vsg::ref_ptr<vsg::Buffer> _readbackBuffer;
+    vsg::ref_ptr<vsg::ubvec4Array2D> _mappedReadback;
+    vsg::ref_ptr<vsg::RecordAndSubmitTask> _task;
+};
@@ -4,6 +4,11 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "FrameTrace.h"
+#include "NumaTopology.h"
+#include "SecondaryGPU.h"
+
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <thread>
@@ -192,6 +197,14 @@ int main(int argc, char** argv)
 
     bool multiThreading = arguments.read("--mt");
 
+    // place each device's threads and memory on the NUMA node nearest its GPU, explicit --cpu settings take precedence
+    bool numaPlacement = arguments.read("--numa");
+
+    // render a single window's output on all the GPUs, either splitting each frame into columns or alternating whole frames
+    bool splitFrame = arguments.read("--sfr");
+    bool alternateFrame = arguments.read("--afr");
+    auto maxGPUs = arguments.value<size_t>(vsg::Device::maxNumDevices(), "--gpus");
+
     std::vector<int> screensToUse;
     int screen = -1;
     while (arguments.read({"--screen", "-s"}, screen))
@@ -217,8 +230,26 @@ int main(int argc, char** argv)
         affinity.cpus.insert(cpu);
     }
 
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
+    if (frameTrace) frameTrace->addReaderWriter(*options);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
+    vsg::ref_ptr<NumaTopology> numaTopology;
+    if (numaPlacement && !affinity)
+    {
+        numaTopology = NumaTopology::create();
+        std::cout << "NumaTopology : " << numaTopology->numNodes() << " nodes" << std::endl;
+
+        if (numaTopology->numNodes() > 1)
+        {
+            vsg::Allocator::instance().reset(new NodeLocalAllocator(numaTopology, std::move(vsg::Allocator::instance())));
+        }
+
+        // VK_EXT_pci_bus_info is queried through vkGetPhysicalDeviceProperties2 which requires Vulkan 1.1
+        windowTraits->vulkanVersion = std::max(windowTraits->vulkanVersion, static_cast<uint32_t>(VK_API_VERSION_1_1));
+    }
+
     vsg::Path filename;
     if (argc > 1) filename = arguments[1];
 
@@ -255,8 +286,108 @@ int main(int argc, char** argv)
     // create the viewer and assign window(s) to it
     auto viewer = vsg::Viewer::create();
 
-    size_t numScreens = screensToUse.size();
-    for (size_t i = 0; i < screensToUse.size(); ++i)
+    std::vector<vsg::ref_ptr<SecondaryGPU>> secondaryGPUs;
+    std::vector<vsg::ref_ptr<vsg::LookAt>> secondaryLookAts;
+    vsg::ref_ptr<vsg::Switch> primaryScene;
+    vsg::ref_ptr<vsg::Switch> composites;
+    vsg::ref_ptr<vsg::LookAt> primaryLookAt;
+
+    if (splitFrame || alternateFrame)
+    {
+        auto local_windowTraits = vsg::WindowTraits::create(*windowTraits);
+        local_windowTraits->screenNum = screensToUse.front();
+
+        auto window = vsg::Window::create(local_windowTraits);
+        if (!window)
+        {
+            std::cout << "Could not create window." << std::endl;
+            return 1;
+        }
+
+        auto devices = SecondaryGPU::createDevices(window, std::max(std::min(maxGPUs, vsg::Device::maxNumDevices()), size_t(1)) - 1);
+        if (devices.empty()) std::cout << "No secondary GPUs available, rendering on the window's GPU alone." << std::endl;
+
+        auto extent = window->extent2D();
+        size_t numGPUs = devices.size() + 1;
+
+        // the window's GPU renders column 0 with split frame rendering, and every frame at the start of each cycle of numGPUs
+        // frames with alternate frame rendering, with the secondary GPUs rendering the remaining columns or frames
+        auto columnStart = [&](size_t i) { return static_cast<uint32_t>((static_cast<uint64_t>(extent.width) * i) / numGPUs); };
+        auto ndc = [&](uint32_t x) { return 2.0 * static_cast<double>(x) / static_cast<double>(extent.width) - 1.0; };
+        auto columnProjection = [&](size_t i) -> vsg::ref_ptr<vsg::ProjectionMatrix> {
+            // scale and translate the column's range of clip space x to cover the whole of its framebuffer
+            double a = ndc(columnStart(i)), b = ndc(columnStart(i + 1));
+            return vsg::RelativeProjection::create(vsg::translate(-(a + b) / (b - a), 0.0, 0.0) * vsg::scale(2.0 / (b - a), 1.0, 1.0), perspective);
+        };
+
+        composites = vsg::Switch::create();
+        vsg::CommandGraphs commandGraphs;
+        for (size_t i = 0; i < devices.size(); ++i)
+        {
+            auto& [device, queueFamily] = devices[i];
+
+            vsg::ref_ptr<vsg::Camera> camera;
+            vsg::ref_ptr<SecondaryGPU> secondaryGPU;
+            if (splitFrame)
+            {
+                VkExtent2D columnExtent{columnStart(i + 2) - columnStart(i + 1), extent.height};
+                secondaryGPU = SecondaryGPU::create(device, queueFamily, columnExtent, window->surfaceFormat().format);
+                camera = vsg::Camera::create(columnProjection(i + 1), lookAt, vsg::ViewportState::create(columnExtent));
+                composites->addChild(true, secondaryGPU->createComposite(options, ndc(columnStart(i + 1)), ndc(columnStart(i + 2))));
+            }
+            else
+            {
+                // each secondary GPU has its own LookAt so an animation path can be sampled at the time its frame is shown
+                auto secondaryLookAt = vsg::LookAt::create(*lookAt);
+                secondaryLookAts.push_back(secondaryLookAt);
+
+                secondaryGPU = SecondaryGPU::create(device, queueFamily, extent, window->surfaceFormat().format);
+                camera = vsg::Camera::create(perspective, secondaryLookAt, vsg::ViewportState::create(extent));
+                composites->addChild(false, secondaryGPU->createComposite(options, -1.0, 1.0));
+            }
+
+            auto local_scene = sharedScene ? vsg_scene : createScene(filename, options);
+            commandGraphs.push_back(secondaryGPU->createCommandGraph(camera, local_scene));
+            secondaryGPUs.push_back(secondaryGPU);
+        }
+
+        vsg::ref_ptr<vsg::Camera> primaryCamera;
+        if (splitFrame)
+        {
+            // composited columns are read back a frame late, so render the window's column with last frame's view to match
+            primaryLookAt = vsg::LookAt::create(*lookAt);
+            primaryCamera = vsg::Camera::create(columnProjection(0), primaryLookAt, vsg::ViewportState::create(0, 0, columnStart(1), extent.height));
+        }
+        else
+        {
+            primaryCamera = vsg::Camera::create(perspective, lookAt, vsg::ViewportState::create(extent));
+        }
+
+        primaryScene = vsg::Switch::create();
+        primaryScene->addChild(true, vsg_scene);
+
+        auto compositeCamera = vsg::Camera::create(vsg::Orthographic::create(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0), vsg::LookAt::create(vsg::dvec3(0.0, 0.0, 0.0), vsg::dvec3(0.0, 0.0, -1.0), vsg::dvec3(0.0, 1.0, 0.0)), vsg::ViewportState::create(extent));
+
+        auto renderGraph = vsg::createRenderGraphForView(window, primaryCamera, primaryScene);
+        renderGraph->addChild(vsg::View::create(compositeCamera, composites));
+
+        auto commandGraph = vsg::CommandGraph::create(window);
+        commandGraph->addChild(renderGraph);
+        commandGraphs.insert(commandGraphs.begin(), commandGraph);
+
+        if (frameTrace)
+        {
+            for (size_t i = 0; i < commandGraphs.size(); ++i) frameTrace->addTimestamps(*commandGraphs[i], vsg::make_string("GPU ", i));
+        }
+
+        viewer->assignRecordAndSubmitTaskAndPresentation(commandGraphs);
+        viewer->addWindow(window);
+
+        for (auto& secondaryGPU : secondaryGPUs) secondaryGPU->assignTask(*viewer);
+    }
+
+    size_t numScreens = (splitFrame || alternateFrame) ? 0 : screensToUse.size();
+    for (size_t i = 0; i < numScreens; ++i)
     {
         int screenNum = screensToUse[i];
 
@@ -326,10 +457,42 @@ int main(int argc, char** argv)
         vsg::setAffinity(affinity);
     }
 
+    if (numaTopology && numaTopology->numNodes() > 1)
+    {
+        auto& tasks = viewer->recordAndSubmitTasks;
+
+        // the main thread compiles and, when single threaded, records for all devices so follows the first one
+        int mainNode = numaTopology->nodeOfDevice(tasks.front()->device->getPhysicalDevice());
+        if (mainNode >= 0)
+        {
+            std::cout << "Main thread on NUMA node " << mainNode << std::endl;
+            vsg::setAffinity(numaTopology->nodeAffinity(mainNode));
+        }
+
+        // Viewer::setupThreading() creates a thread per RecordAndSubmitTask when each has a single CommandGraph, that
+        // thread records, transfers dynamic data and submits for the task's device
+        if (multiThreading && viewer->threads.size() == tasks.size())
+        {
+            for (size_t i = 0; i < tasks.size(); ++i)
+            {
+                int node = numaTopology->nodeOfDevice(tasks[i]->device->getPhysicalDevice());
+                if (node < 0 || !viewer->threads[i].joinable()) continue;
+
+                std::cout << "Device " << tasks[i]->device->deviceID << " " << tasks[i]->device->getPhysicalDevice()->getProperties().deviceName << " thread on NUMA node " << node << std::endl;
+                vsg::setAffinity(viewer->threads[i], numaTopology->nodeAffinity(node));
+            }
+        }
+        else if (multiThreading)
+        {
+            std::cout << "Viewer threads don't map one to one onto devices, leaving them unpinned." << std::endl;
+        }
+    }
 
     // add close handler to respond the close window button and pressing escape
     viewer->addEventHandler(vsg::CloseHandler::create(viewer));
 
+    vsg::ref_ptr<vsg::AnimationPath> animationPath;
+
     if (pathFilename.empty())
     {
         auto trackball = vsg::Trackball::create(master_camera);
@@ -352,7 +515,7 @@ int main(int argc, char** argv)
     }
     else
     {
-        auto animationPath = vsg::read_cast<vsg::AnimationPath>(pathFilename, options);
+        animationPath = vsg::read_cast<vsg::AnimationPath>(pathFilename, options);
         if (!animationPath)
         {
             std::cout<<"Warning: unable to read animation path : "<<pathFilename<<std::endl;
@@ -363,19 +526,110 @@ int main(int argc, char** argv)
         viewer->addEventHandler(aph);
     }
 
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
+
+    uint64_t waitTimeout = 1999999999; // 1second in nanoseconds.
+    size_t numGPUs = secondaryGPUs.size() + 1;
+    vsg::dvec3 previousEye = lookAt->eye, previousCenter = lookAt->center, previousUp = lookAt->up;
+    double frameInterval = 1.0 / 60.0;
+    auto cycleStart = vsg::clock::now();
+    auto lastPresent = cycleStart;
 
     // rendering main loop
     while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        auto frameCount = viewer->getFrameStamp()->frameCount;
+        if (splitFrame)
+        {
+            // composite the columns rendered last frame, alongside the window's column rendered from last frame's view
+            if (frameCount > 0)
+            {
+                for (auto& secondaryGPU : secondaryGPUs) secondaryGPU->readback(waitTimeout);
+            }
+
+            primaryLookAt->eye = previousEye;
+            primaryLookAt->center = previousCenter;
+            primaryLookAt->up = previousUp;
+            previousEye = lookAt->eye;
+            previousCenter = lookAt->center;
+            previousUp = lookAt->up;
+        }
+        else if (alternateFrame && numGPUs > 1)
+        {
+            // each cycle starts with every GPU rendering a frame, the window's GPU presents its own then composites the
+            // secondary GPUs' frames one per following frame
+            size_t phase = frameCount % numGPUs;
+            if (phase == 0)
+            {
+                auto now = vsg::clock::now();
+                if (frameCount > 0) frameInterval = frameInterval * 0.9 + 0.1 * std::chrono::duration<double, std::chrono::seconds::period>(now - cycleStart).count() / static_cast<double>(numGPUs);
+                cycleStart = now;
+
+                double time = std::chrono::duration<double, std::chrono::seconds::period>(viewer->getFrameStamp()->time - viewer->start_point()).count();
+                for (size_t j = 0; j < secondaryLookAts.size(); ++j)
+                {
+                    if (animationPath)
+                    {
+                        secondaryLookAts[j]->set(animationPath->computeMatrix(time + static_cast<double>(j + 1) * frameInterval));
+                    }
+                    else
+                    {
+                        secondaryLookAts[j]->eye = lookAt->eye;
+                        secondaryLookAts[j]->center = lookAt->center;
+                        secondaryLookAts[j]->up = lookAt->up;
+                    }
+                }
+            }
+            else if (phase == 1)
+            {
+                for (auto& secondaryGPU : secondaryGPUs) secondaryGPU->readback(waitTimeout);
+            }
+
+            primaryScene->setAllChildren(phase == 0);
+            for (size_t j = 0; j < secondaryGPUs.size(); ++j)
+            {
+                secondaryGPUs[j]->active->setAllChildren(phase == 0);
+                composites->children[j].mask = vsg::boolToMask(phase == j + 1);
+            }
+        }
+
+        traceFrame.phase("update");
         viewer->update();
 
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        if (alternateFrame && numGPUs > 1)
+        {
+            // pace presentation so the short composite frames aren't shown straight after the long frame that starts each cycle
+            std::this_thread::sleep_until(lastPresent + std::chrono::duration_cast<vsg::clock::duration>(std::chrono::duration<double>(frameInterval)));
+        }
+
+        traceFrame.phase("present");
         viewer->present();
+        lastPresent = vsg::clock::now();
+    }
+
+    if (splitFrame || alternateFrame)
+    {
+        auto fs = viewer->getFrameStamp();
+        double fps = static_cast<double>(fs->frameCount) / std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - viewer->start_point()).count();
+        std::cout << (splitFrame ? "Split" : "Alternate") << " frame rendering on " << numGPUs << " GPUs, average frame rate = " << fps << " fps" << std::endl;
+    }
+
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
     }
 
     // clean up done automatically thanks to ref_ptr<>
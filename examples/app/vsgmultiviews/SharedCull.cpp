@@ -0,0 +1,153 @@
+#include "SharedCull.h"
+
+#include <algorithm>
+
+void SharedCull::add(const vsg::View& view)
+{
+    if (views.size() < 64) views.push_back(SharedView{view.viewID, view.camera});
+}
+
+int SharedCull::index(uint32_t viewID) const
+{
+    for (size_t i = 0; i < views.size(); ++i)
+    {
+        if (views[i].viewID == viewID) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+SharedCullGroup::SharedCullGroup(vsg::ref_ptr<SharedCull> in_sharedCull, size_t numChildren) :
+    Inherit(numChildren),
+    sharedCull(in_sharedCull)
+{
+}
+
+void SharedCullGroup::update()
+{
+    _bounds.clear();
+    _targets.clear();
+    _bounds.reserve(children.size());
+    _targets.reserve(children.size());
+
+    for (auto& child : children)
+    {
+        if (!child) continue;
+
+        if (auto cullNode = child->cast<vsg::CullNode>())
+        {
+            if (!cullNode->child) continue;
+            _bounds.push_back(cullNode->bound);
+            _targets.push_back(cullNode->child.get());
+            continue;
+        }
+
+        vsg::ComputeBounds computeBounds;
+        child->accept(computeBounds);
+        if (computeBounds.bounds.valid())
+        {
+            auto& bounds = computeBounds.bounds;
+            _bounds.emplace_back((bounds.min + bounds.max) * 0.5, vsg::length(bounds.max - bounds.min) * 0.5);
+        }
+        else
+        {
+            _bounds.emplace_back(vsg::dvec3(), std::numeric_limits<double>::infinity());
+        }
+        _targets.push_back(child.get());
+    }
+
+    _visibleViews.assign(_targets.size(), 0);
+    _frameCount = std::numeric_limits<uint64_t>::max();
+    _numChildren = children.size();
+}
+
+void SharedCullGroup::traverse(vsg::RecordTraversal& visitor) const
+{
+    auto commandBuffer = visitor.getCommandBuffer();
+    int viewIndex = (sharedCull && commandBuffer) ? sharedCull->index(commandBuffer->viewID) : -1;
+    if (viewIndex < 0 || _numChildren != children.size())
+    {
+        Group::traverse(visitor);
+        return;
+    }
+
+    auto frameStamp = visitor.getFrameStamp();
+    uint64_t frameCount = frameStamp ? frameStamp->frameCount : 0;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (frameCount != _frameCount)
+        {
+            // recover the group's local to world transform from the modelview of the View recording it
+            auto& camera = sharedCull->views[viewIndex].camera;
+            _cull(vsg::inverse(camera->viewMatrix->transform()) * visitor.getState()->modelviewMatrixStack.top());
+            _frameCount = frameCount;
+            ++(sharedCull->numCulls);
+        }
+        else
+        {
+            ++(sharedCull->numShared);
+        }
+    }
+
+    uint64_t bit = uint64_t(1) << viewIndex;
+    for (size_t i = 0; i < _targets.size(); ++i)
+    {
+        if (_visibleViews[i] & bit) _targets[i]->accept(visitor);
+    }
+}
+
+void SharedCullGroup::_cull(const vsg::dmat4& localToWorld) const
+{
+    std::fill(_visibleViews.begin(), _visibleViews.end(), 0);
+
+    for (size_t v = 0; v < sharedCull->views.size(); ++v)
+    {
+        // the View's frustum planes in the group's local coordinate frame, from the rows of the projection * view * localToWorld
+        // matrix, with clip space bounded by -w <= x, y <= w and 0 <= z <= w
+        auto& camera = sharedCull->views[v].camera;
+        auto m = camera->projectionMatrix->transform() * camera->viewMatrix->transform() * localToWorld;
+        auto row = [&m](int r) { return vsg::dvec4(m[0][r], m[1][r], m[2][r], m[3][r]); };
+        vsg::dvec4 clipPlanes[6] = {row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2)};
+
+        std::vector<vsg::dvec4> planes;
+        for (auto& p : clipPlanes)
+        {
+            // an infinite far plane has no normal and culls nothing
+            double len = vsg::length(vsg::dvec3(p.x, p.y, p.z));
+            if (len > 0.0) planes.push_back(p / len);
+        }
+
+        uint64_t bit = uint64_t(1) << v;
+        for (size_t i = 0; i < _bounds.size(); ++i)
+        {
+            auto& bound = _bounds[i];
+            bool visible = true;
+            for (auto& p : planes)
+            {
+                if (p.x * bound.center.x + p.y * bound.center.y + p.z * bound.center.z + p.w < -bound.radius)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+            if (visible) _visibleViews[i] |= bit;
+        }
+    }
+}
+
+vsg::ref_ptr<vsg::Node> shareCull(vsg::ref_ptr<vsg::Node> node, vsg::ref_ptr<SharedCull> sharedCull, size_t minChildren)
+{
+    auto group = node.cast<vsg::Group>();
+    if (!group) return node;
+
+    for (auto& child : group->children)
+    {
+        if (child) child = shareCull(child, sharedCull, minChildren);
+    }
+
+    if (typeid(*group) != typeid(vsg::Group) || group->children.size() < minChildren) return node;
+
+    auto sharedCullGroup = SharedCullGroup::create(sharedCull);
+    sharedCullGroup->children = group->children;
+    sharedCullGroup->update();
+    return sharedCullGroup;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <limits>
+#include <mutex>
+
+// The Views whose cull results are shared. Each frame the first View to record a SharedCullGroup culls its children
+// against the frusta of all the Views at once, keeping a bitmask per child of the Views it's visible in, so the other
+// Views record the children visible to them from the bitmasks rather than repeating the tests.
+class SharedCull : public vsg::Inherit<vsg::Object, SharedCull>
+{
+public:
+    // up to 64 Views can share a cull
+    void add(const vsg::View& view);
+
+    // index of the View with viewID in views, -1 if it isn't sharing
+    int index(uint32_t viewID) const;
+
+    struct SharedView
+    {
+        uint32_t viewID;
+        vsg::ref_ptr<vsg::Camera> camera; // the Camera rather than the View, as the View references the scene graph
+    };
+
+    std::vector<SharedView> views;
+
+    // statistics
+    std::atomic_uint64_t numCulls{0};  // SharedCullGroups culled against all Views
+    std::atomic_uint64_t numShared{0}; // SharedCullGroups recorded from a previous View's cull
+};
+
+// Group that culls its children against all the Views of a SharedCull once per frame. Like vsg::CullNode the bounds
+// are in the group's local coordinate frame, the bound of a vsg::CullNode child being used in its place and its child
+// recorded directly. Views not added to the SharedCull record the children without culling.
+// Call update() after changing the children, until then the children are traversed without culling.
+class SharedCullGroup : public vsg::Inherit<vsg::Group, SharedCullGroup>
+{
+public:
+    explicit SharedCullGroup(vsg::ref_ptr<SharedCull> in_sharedCull = {}, size_t numChildren = 0);
+
+    vsg::ref_ptr<SharedCull> sharedCull;
+
+    // recompute the bounds of the children
+    void update();
+
+    using Group::traverse;
+    void traverse(vsg::RecordTraversal& visitor) const override;
+
+protected:
+    void _cull(const vsg::dmat4& localToWorld) const;
+
+    std::vector<vsg::dsphere> _bounds;
+    std::vector<const vsg::Node*> _targets;
+    size_t _numChildren = 0;
+
+    mutable std::mutex _mutex;
+    mutable uint64_t _frameCount = std::numeric_limits<uint64_t>::max();
+    mutable std::vector<uint64_t> _visibleViews; // bit i set where the child is visible in sharedCull->views[i]
+};
+
+// replace the plain vsg::Groups of a subgraph that have at least minChildren children with SharedCullGroups
+extern vsg::ref_ptr<vsg::Node> shareCull(vsg::ref_ptr<vsg::Node> node, vsg::ref_ptr<SharedCull> sharedCull, size_t minChildren);
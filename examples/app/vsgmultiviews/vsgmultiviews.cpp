@@ -7,6 +7,9 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "FrameTrace.h"
+#include "SharedCull.h"
+
 vsg::ref_ptr<vsg::Camera> createCameraForScene(vsg::Node* scenegraph, int32_t x, int32_t y, uint32_t width, uint32_t height)
 {
     // compute the bounds of the scene graph to help position camera
@@ -90,10 +93,15 @@ int main(int argc, char** argv)
     windowTraits->debugLayer = arguments.read({"--debug", "-d"});
     windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
     if (arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height)) { windowTraits->fullscreen = false; }
+    auto numViews = arguments.value<uint32_t>(2, "--views"); // views beyond the first two are insets following the main camera
+    auto sharedCullMinChildren = arguments.value<size_t>(0, "--shared-cull"); // replace Groups with at least this many children with SharedCullGroups
+
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     auto options = vsg::Options::create();
+    if (frameTrace) frameTrace->addReaderWriter(*options);
     options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
     options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
 #ifdef vsgXchange_all
@@ -122,6 +130,16 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    // cull the views of scenegraph once per frame rather than once per view
+    vsg::ref_ptr<SharedCull> sharedCull;
+    if (sharedCullMinChildren > 0)
+    {
+        sharedCull = SharedCull::create();
+        bool sameScene = (scenegraph == scenegraph2);
+        scenegraph = shareCull(scenegraph, sharedCull, sharedCullMinChildren);
+        if (sameScene) scenegraph2 = scenegraph;
+    }
+
     // create the viewer and assign window(s) to it
     auto viewer = vsg::Viewer::create();
     auto window = vsg::Window::create(windowTraits);
@@ -172,28 +190,79 @@ int main(int argc, char** argv)
     // add the second insert view that overlays ontop.
     renderGraph->addChild(secondary_view);
 
+    // add further insets down the right hand side, then in columns to its left, each offset sideways from the main camera
+    std::vector<vsg::ref_ptr<vsg::View>> inset_views;
+    auto main_perspective = main_camera->projectionMatrix.cast<vsg::Perspective>();
+    for (uint32_t i = 2; i < numViews; ++i)
+    {
+        uint32_t slot = i - 1;
+        int32_t x = static_cast<int32_t>(((3 - (slot / 4) % 4) * width) / 4);
+        int32_t y = static_cast<int32_t>(((slot % 4) * height) / 4);
+
+        auto perspective = vsg::Perspective::create(*main_perspective);
+        double spacing = main_perspective->nearDistance * 50.0; // createCameraForScene() sets the near plane at 0.001 * radius
+        double offset = (static_cast<double>(i - 1) - 0.5 * static_cast<double>(numViews - 1)) * spacing;
+        auto relative_view = vsg::RelativeViewMatrix::create(vsg::translate(offset, 0.0, 0.0), main_camera->viewMatrix);
+        auto inset_camera = vsg::Camera::create(perspective, relative_view, vsg::ViewportState::create(x, y, width / 4, height / 4));
+
+        VkClearRect inset_rect{inset_camera->getRenderArea(), 0, 1};
+        renderGraph->addChild(vsg::ClearAttachments::create(vsg::ClearAttachments::Attachments{color_attachment, depth_attachment}, vsg::ClearAttachments::Rects{inset_rect, inset_rect}));
+
+        auto inset_view = vsg::View::create(inset_camera, scenegraph);
+        renderGraph->addChild(inset_view);
+        inset_views.push_back(inset_view);
+    }
+
+    if (sharedCull)
+    {
+        sharedCull->add(*main_view);
+        if (scenegraph2 == scenegraph) sharedCull->add(*secondary_view);
+        for (auto& inset_view : inset_views) sharedCull->add(*inset_view);
+    }
+
     auto commandGraph = vsg::CommandGraph::create(window);
     commandGraph->addChild(renderGraph);
+    if (frameTrace) frameTrace->addTimestamps(*commandGraph);
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     // add the view handler for interactively changing the views
     viewer->addEventHandler(ViewHandler::create(renderGraph));
 
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     // rendering main loop
     while (viewer->advanceToNextFrame())
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        traceFrame.phase("update");
         viewer->update();
 
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        traceFrame.phase("present");
         viewer->present();
     }
 
+    if (sharedCull)
+    {
+        std::cout << "SharedCull views = " << sharedCull->views.size() << ", culls = " << sharedCull->numCulls << ", shared = " << sharedCull->numShared << std::endl;
+    }
+
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -5,6 +5,8 @@
 #include <iostream>
 #include <thread>
 
+#include "FrameTrace.h"
+
 int main(int argc, char** argv)
 {
     // set up defaults and read command line arguments to override them
@@ -18,6 +20,8 @@ int main(int argc, char** argv)
     if (arguments.read({"--fullscreen", "--fs"})) windowTraits->fullscreen = true;
     if (arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height)) { windowTraits->fullscreen = false; }
 
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     if (arguments.argc() <= 1)
@@ -27,6 +31,7 @@ int main(int argc, char** argv)
     }
 
     auto options = vsg::Options::create();
+    if (frameTrace) frameTrace->addReaderWriter(*options);
     options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
     options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
     vsg::Path filename = arguments[1];
@@ -83,23 +88,39 @@ int main(int argc, char** argv)
     viewer->addEventHandler(vsg::Trackball::create(camera));
 
     auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
+    if (frameTrace) frameTrace->addTimestamps(*commandGraph);
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     // rendering main loop
     while (viewer->advanceToNextFrame())
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        traceFrame.phase("update");
         viewer->update();
 
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        traceFrame.phase("present");
         viewer->present();
     }
 
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -0,0 +1,256 @@
+#include "LayeredComposition.h"
+
+namespace
+{
+    const char* composite_vert = R"(
+#version 450
+layout(location = 0) out vec2 texCoord;
+out gl_PerVertex { vec4 gl_Position; };
+void main()
+{
+    // full screen triangle
+    texCoord = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(texCoord * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+    const char* composite_frag = R"(
+#version 450
+layout(binding = 0) uniform sampler2D sceneLayer;
+layout(binding = 1) uniform sampler2D overlayLayer;
+layout(location = 0) in vec2 texCoord;
+layout(location = 0) out vec4 outColor;
+void main()
+{
+    // the overlay layer is cleared to transparent so the scene shows through wherever nothing was drawn over it
+    vec4 scene = texture(sceneLayer, texCoord);
+    vec4 overlay = texture(overlayLayer, texCoord);
+    outColor = vec4(mix(scene.rgb, overlay.rgb, overlay.a), 1.0);
+}
+)";
+
+    vsg::ref_ptr<vsg::RenderPass> createLayerRenderPass(vsg::Device* device, VkFormat colorFormat, VkFormat depthFormat)
+    {
+        vsg::RenderPass::Attachments attachments(2);
+        attachments[0].format = colorFormat;
+        attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        attachments[1].format = depthFormat;
+        attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        vsg::RenderPass::Subpasses subpasses(1);
+        subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpasses[0].colorAttachments.emplace_back(vsg::AttachmentReference{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+        subpasses[0].depthStencilAttachments.emplace_back(vsg::AttachmentReference{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL});
+
+        // wait for the previous frame's composite to finish reading the layer, and make the layer visible to this frame's composite
+        vsg::RenderPass::Dependencies dependencies(2);
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        return vsg::RenderPass::create(device, attachments, subpasses, dependencies);
+    }
+
+    vsg::ref_ptr<vsg::ImageView> createAttachment(vsg::Context& context, const VkExtent2D& extent, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect)
+    {
+        auto image = vsg::Image::create();
+        image->imageType = VK_IMAGE_TYPE_2D;
+        image->format = format;
+        image->extent = VkExtent3D{extent.width, extent.height, 1};
+        image->mipLevels = 1;
+        image->arrayLayers = 1;
+        image->samples = VK_SAMPLE_COUNT_1_BIT;
+        image->tiling = VK_IMAGE_TILING_OPTIMAL;
+        image->usage = usage;
+        image->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        return vsg::createImageView(context, image, aspect);
+    }
+
+    constexpr VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+} // namespace
+
+LayeredComposition::Layer::Layer(vsg::Context& context, vsg::ref_ptr<vsg::View> in_view, const VkExtent2D& extent, const VkClearColorValue& clearColor, VkFormat colorFormat) :
+    view(in_view),
+    _colorFormat(colorFormat)
+{
+    _renderPass = createLayerRenderPass(context.device, colorFormat, depthFormat);
+
+    renderGraph = vsg::RenderGraph::create();
+    renderGraph->renderArea.offset = VkOffset2D{0, 0};
+    renderGraph->clearValues.resize(2);
+    renderGraph->clearValues[0].color = clearColor;
+    renderGraph->clearValues[1].depthStencil = VkClearDepthStencilValue{0.0f, 0};
+    renderGraph->addChild(view);
+    _createTarget(context, extent);
+
+    addChild(renderGraph);
+}
+
+void LayeredComposition::Layer::_createTarget(vsg::Context& context, const VkExtent2D& extent)
+{
+    auto colorImageView = createAttachment(context, extent, _colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+    auto depthImageView = createAttachment(context, extent, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    // the framebuffer is recreated around the new images, reusing the render pass so the layer's pipelines remain compatible
+    renderGraph->framebuffer = vsg::Framebuffer::create(_renderPass, vsg::ImageViews{colorImageView, depthImageView}, extent.width, extent.height, 1);
+    renderGraph->renderArea.extent = extent;
+    view->camera->viewportState->set(0, 0, extent.width, extent.height);
+    if (auto perspective = view->camera->projectionMatrix.cast<vsg::Perspective>())
+    {
+        perspective->aspectRatio = static_cast<double>(extent.width) / static_cast<double>(extent.height);
+    }
+
+    colorImageInfo = vsg::ImageInfo::create(vsg::ref_ptr<vsg::Sampler>(), colorImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    _dirty = true;
+}
+
+void LayeredComposition::Layer::resize(vsg::Context& context, const VkExtent2D& extent)
+{
+    _createTarget(context, extent);
+
+    // the viewport is baked into the graphics pipelines so they need rebuilding for the new extent
+    vsg::UpdateGraphicsPipelines updateGraphicsPipelines;
+    updateGraphicsPipelines.context = vsg::Context::create(context.device);
+    updateGraphicsPipelines.context->renderPass = _renderPass;
+    renderGraph->accept(updateGraphicsPipelines);
+}
+
+void LayeredComposition::Layer::traverse(vsg::RecordTraversal& visitor) const
+{
+    // a camera that has moved, zoomed or been resized needs the layer re-rendered
+    auto& camera = *view->camera;
+    auto projectionMatrix = camera.projectionMatrix->transform();
+    auto viewMatrix = camera.viewMatrix->transform();
+    bool cameraChanged = projectionMatrix != _projectionMatrix || viewMatrix != _viewMatrix;
+
+    if (!_dirty.exchange(false) && !cameraChanged)
+    {
+        ++numSkipped;
+        return;
+    }
+
+    _projectionMatrix = projectionMatrix;
+    _viewMatrix = viewMatrix;
+    ++numRecorded;
+
+    renderGraph->accept(visitor);
+}
+
+LayeredComposition::LayeredComposition(vsg::ref_ptr<vsg::Window> in_window, vsg::ref_ptr<vsg::View> sceneView, vsg::ref_ptr<vsg::View> overlayView) :
+    window(in_window),
+    extent(in_window->extent2D())
+{
+    auto context = vsg::Context::create(window->getOrCreateDevice());
+
+    // matching the swapchain's format means sRGB encoding is applied when rendering the layers and undone when sampling them,
+    // so the composite writes the same values to the window as rendering the views directly would have done
+    VkFormat colorFormat = window->surfaceFormat().format;
+    sceneLayer = Layer::create(*context, sceneView, extent, VkClearColorValue{{0.2f, 0.2f, 0.4f, 1.0f}}, colorFormat);
+    overlayLayer = Layer::create(*context, overlayView, extent, VkClearColorValue{{0.0f, 0.0f, 0.0f, 0.0f}}, colorFormat);
+
+    // the layers are the same size as the window so are sampled texel for texel
+    _sampler = vsg::Sampler::create();
+    _sampler->magFilter = VK_FILTER_NEAREST;
+    _sampler->minFilter = VK_FILTER_NEAREST;
+    _sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    _sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    _sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    vsg::DescriptorSetLayoutBindings descriptorBindings{
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr},
+        {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}};
+    _descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+
+    vsg::PushConstantRanges pushConstantRanges{
+        {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // not used by the shaders, but the View always pushes the projection and modelview matrices
+    };
+
+    auto rasterizationState = vsg::RasterizationState::create();
+    rasterizationState->cullMode = VK_CULL_MODE_NONE;
+
+    auto depthStencilState = vsg::DepthStencilState::create();
+    depthStencilState->depthTestEnable = VK_FALSE;
+    depthStencilState->depthWriteEnable = VK_FALSE;
+
+    vsg::GraphicsPipelineStates pipelineStates{
+        vsg::VertexInputState::create(),
+        vsg::InputAssemblyState::create(),
+        rasterizationState,
+        vsg::MultisampleState::create(),
+        vsg::ColorBlendState::create(),
+        depthStencilState};
+
+    auto vertexShader = vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", composite_vert);
+    auto fragmentShader = vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", composite_frag);
+
+    _pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{_descriptorSetLayout}, pushConstantRanges);
+    auto graphicsPipeline = vsg::GraphicsPipeline::create(_pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
+
+    _composite = vsg::StateGroup::create();
+    _composite->add(vsg::BindGraphicsPipeline::create(graphicsPipeline));
+    _composite->add(_createCompositeDescriptorSet());
+    _composite->addChild(vsg::Draw::create(3, 1, 0, 0));
+
+    auto compositeCamera = vsg::Camera::create(vsg::Orthographic::create(), vsg::LookAt::create(), vsg::ViewportState::create(extent));
+    auto compositeRenderGraph = vsg::RenderGraph::create(window, vsg::View::create(compositeCamera, _composite));
+
+    // the layers are recorded before the window's render pass that composites them
+    addChild(sceneLayer);
+    addChild(overlayLayer);
+    addChild(compositeRenderGraph);
+}
+
+vsg::ref_ptr<vsg::BindDescriptorSet> LayeredComposition::_createCompositeDescriptorSet()
+{
+    sceneLayer->colorImageInfo->sampler = _sampler;
+    overlayLayer->colorImageInfo->sampler = _sampler;
+
+    vsg::Descriptors descriptors{
+        vsg::DescriptorImage::create(sceneLayer->colorImageInfo, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+        vsg::DescriptorImage::create(overlayLayer->colorImageInfo, 1, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)};
+    return vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, vsg::DescriptorSet::create(_descriptorSetLayout, descriptors));
+}
+
+void LayeredComposition::update(vsg::Viewer& viewer)
+{
+    auto windowExtent = window->extent2D();
+    if (windowExtent.width == extent.width && windowExtent.height == extent.height) return;
+
+    // the swapchain has been rebuilt so rebuild the layers to match, and point the composite at the new images
+    viewer.deviceWaitIdle();
+    extent = windowExtent;
+
+    auto context = vsg::Context::create(window->getOrCreateDevice());
+    sceneLayer->resize(*context, extent);
+    overlayLayer->resize(*context, extent);
+
+    auto bindDescriptorSet = _createCompositeDescriptorSet();
+    _composite->stateCommands.back() = bindDescriptorSet;
+
+    auto result = viewer.compileManager->compile(bindDescriptorSet);
+    if (result) vsg::updateViewer(viewer, result);
+}
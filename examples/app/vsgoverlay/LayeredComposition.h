@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+
+// Renders the main scene and the overlay into separate window sized images, then composites them into the window with a
+// full screen triangle. Each layer is only recorded when its camera has changed or it has been marked dirty, otherwise
+// its image keeps the contents of its last update, so a HUD update with a static camera costs an overlay redraw and
+// the composite rather than a full scene redraw. The composite itself is recorded every frame.
+class LayeredComposition : public vsg::Inherit<vsg::Group, LayeredComposition>
+{
+public:
+    LayeredComposition(vsg::ref_ptr<vsg::Window> in_window, vsg::ref_ptr<vsg::View> sceneView, vsg::ref_ptr<vsg::View> overlayView);
+
+    // an offscreen RenderGraph rendering a View into a color image sampled by the composite
+    class Layer : public vsg::Inherit<vsg::Group, Layer>
+    {
+    public:
+        Layer(vsg::Context& context, vsg::ref_ptr<vsg::View> in_view, const VkExtent2D& extent, const VkClearColorValue& clearColor, VkFormat colorFormat);
+
+        vsg::ref_ptr<vsg::View> view;
+        vsg::ref_ptr<vsg::RenderGraph> renderGraph;
+        vsg::ref_ptr<vsg::ImageInfo> colorImageInfo;
+
+        // mark the layer as needing to be recorded, for changes to its scene graph that the camera doesn't reveal
+        void dirty() { _dirty = true; }
+
+        // recreate the color and depth images at a new extent, the device must be idle
+        void resize(vsg::Context& context, const VkExtent2D& extent);
+
+        // statistics
+        mutable std::atomic_uint64_t numRecorded{0};
+        mutable std::atomic_uint64_t numSkipped{0};
+
+        using Group::traverse;
+        void traverse(vsg::RecordTraversal& visitor) const override;
+
+    protected:
+        void _createTarget(vsg::Context& context, const VkExtent2D& extent);
+
+        VkFormat _colorFormat;
+        vsg::ref_ptr<vsg::RenderPass> _renderPass;
+        mutable std::atomic_bool _dirty{true};
+        mutable vsg::dmat4 _projectionMatrix;
+        mutable vsg::dmat4 _viewMatrix;
+    };
+
+    vsg::ref_ptr<vsg::Window> window;
+    vsg::ref_ptr<Layer> sceneLayer;
+    vsg::ref_ptr<Layer> overlayLayer;
+    VkExtent2D extent;
+
+    // resize the layers to match the window when its swapchain has been rebuilt, call each frame before recordAndSubmit()
+    void update(vsg::Viewer& viewer);
+
+protected:
+    vsg::ref_ptr<vsg::BindDescriptorSet> _createCompositeDescriptorSet();
+
+    vsg::ref_ptr<vsg::Sampler> _sampler;
+    vsg::ref_ptr<vsg::DescriptorSetLayout> _descriptorSetLayout;
+    vsg::ref_ptr<vsg::PipelineLayout> _pipelineLayout;
+    vsg::ref_ptr<vsg::StateGroup> _composite;
+};
@@ -7,6 +7,9 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "FrameTrace.h"
+#include "LayeredComposition.h"
+
 vsg::ref_ptr<vsg::Camera> createCameraForScene(vsg::Node* scenegraph, int32_t x, int32_t y, uint32_t width, uint32_t height)
 {
     // compute the bounds of the scene graph to help position camera
@@ -39,9 +42,16 @@ int main(int argc, char** argv)
     windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
     if (arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height)) { windowTraits->fullscreen = false; }
 
+    // render the scene and overlay to separate images composited into the window, each only re-rendered when it changes
+    bool layered = arguments.read("--layered");
+    bool spinOverlay = arguments.read("--spin-overlay"); // animate the overlay to show it updating independently of the scene
+
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     auto options = vsg::Options::create();
+    if (frameTrace) frameTrace->addReaderWriter(*options);
     options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
     options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
 #ifdef vsgXchange_all
@@ -70,6 +80,14 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    vsg::ref_ptr<vsg::MatrixTransform> overlayTransform;
+    if (spinOverlay)
+    {
+        overlayTransform = vsg::MatrixTransform::create();
+        overlayTransform->addChild(scenegraph2);
+        scenegraph2 = overlayTransform;
+    }
+
     // create the viewer and assign window(s) to it
     auto viewer = vsg::Viewer::create();
     auto window = vsg::Window::create(windowTraits);
@@ -87,25 +105,37 @@ int main(int argc, char** argv)
     uint32_t width = window->extent2D().width;
     uint32_t height = window->extent2D().height;
 
-    auto renderGraph = vsg::RenderGraph::create(window);
-
     // create view1
     auto camera = createCameraForScene(scenegraph, 0, 0, width, height);
     auto view1 = vsg::View::create(camera, scenegraph);
-    renderGraph->addChild(view1);
-
-    // clear the depth buffer before view2 gets rendered
-    VkClearValue clearValue{};
-    clearValue.depthStencil = {0.0f, 0};
-    VkClearAttachment attachment{VK_IMAGE_ASPECT_DEPTH_BIT, 1, clearValue};
-    VkClearRect rect{VkRect2D{VkOffset2D{0, 0}, VkExtent2D{width, height}}, 0, 1};
-    auto clearAttachments = vsg::ClearAttachments::create(vsg::ClearAttachments::Attachments{attachment}, vsg::ClearAttachments::Rects{rect});
-    renderGraph->addChild(clearAttachments);
 
     // create view2
     auto secondary_camera = createCameraForScene(scenegraph2, 0, 0, width, height);
     auto view2 = vsg::View::create(secondary_camera, scenegraph2);
-    renderGraph->addChild(view2);
+
+    vsg::ref_ptr<vsg::Node> renderGraph;
+    vsg::ref_ptr<LayeredComposition> layeredComposition;
+    if (layered)
+    {
+        layeredComposition = LayeredComposition::create(window, view1, view2);
+        renderGraph = layeredComposition;
+    }
+    else
+    {
+        auto windowRenderGraph = vsg::RenderGraph::create(window);
+        windowRenderGraph->addChild(view1);
+
+        // clear the depth buffer before view2 gets rendered
+        VkClearValue clearValue{};
+        clearValue.depthStencil = {0.0f, 0};
+        VkClearAttachment attachment{VK_IMAGE_ASPECT_DEPTH_BIT, 1, clearValue};
+        VkClearRect rect{VkRect2D{VkOffset2D{0, 0}, VkExtent2D{width, height}}, 0, 1};
+        auto clearAttachments = vsg::ClearAttachments::create(vsg::ClearAttachments::Attachments{attachment}, vsg::ClearAttachments::Rects{rect});
+        windowRenderGraph->addChild(clearAttachments);
+
+        windowRenderGraph->addChild(view2);
+        renderGraph = windowRenderGraph;
+    }
 
     // add close handler to respond the close window button and pressing escape
     viewer->addEventHandler(vsg::CloseHandler::create(viewer));
@@ -116,23 +146,58 @@ int main(int argc, char** argv)
 
     commandGraph->addChild(renderGraph);
 
+    if (frameTrace) frameTrace->addTimestamps(*commandGraph);
+
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     // rendering main loop
     while (viewer->advanceToNextFrame())
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        if (overlayTransform)
+        {
+            double time = std::chrono::duration<double, std::chrono::seconds::period>(viewer->getFrameStamp()->time - viewer->start_point()).count();
+            overlayTransform->matrix = vsg::rotate(time * vsg::radians(45.0), 0.0, 0.0, 1.0);
+
+            // the overlay camera doesn't move so the layer has to be told its contents have changed
+            if (layeredComposition) layeredComposition->overlayLayer->dirty();
+        }
+
+        traceFrame.phase("update");
         viewer->update();
 
+        // the scene layer is recorded when the Trackball moves its camera, scene graphs with animations or paging would also need to mark it dirty
+        if (layeredComposition) layeredComposition->update(*viewer);
+
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        traceFrame.phase("present");
         viewer->present();
     }
 
+    if (layeredComposition)
+    {
+        std::cout << "Scene layer recorded " << layeredComposition->sceneLayer->numRecorded << " frames, skipped " << layeredComposition->sceneLayer->numSkipped << std::endl;
+        std::cout << "Overlay layer recorded " << layeredComposition->overlayLayer->numRecorded << " frames, skipped " << layeredComposition->overlayLayer->numSkipped << std::endl;
+    }
+
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -0,0 +1,164 @@
+#include "ScheduledRenderGraph.h"
+
+#include <algorithm>
+
+ScheduledRenderGraph::ScheduledRenderGraph(vsg::ref_ptr<vsg::RenderGraph> in_renderGraph, vsg::ref_ptr<vsg::Camera> in_camera, uint32_t numFramesInFlight, double in_timestampPeriod) :
+    renderGraph(in_renderGraph),
+    camera(in_camera),
+    timestampPeriod(in_timestampPeriod),
+    _fullExtent(in_renderGraph->renderArea.extent)
+{
+    // each update writes to its own query pool, the pool being reused numFramesInFlight updates later once the GPU has finished with it
+    _timestamps = Timestamps::create();
+    for (uint32_t i = 0; i < std::max(numFramesInFlight, 1u); ++i)
+    {
+        auto queryPool = vsg::QueryPool::create();
+        queryPool->queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPool->queryCount = 2;
+        _timestamps->queryPools.push_back(queryPool);
+    }
+    _pending.resize(_timestamps->queryPools.size(), false);
+
+    // the Timestamps child is only there so the CompileTraversal compiles the query pools
+    addChild(_timestamps);
+    addChild(renderGraph);
+}
+
+void ScheduledRenderGraph::addTexCoords(vsg::ref_ptr<vsg::vec2Array> texcoords)
+{
+    // must be called before compile so the texture coordinates are transferred to the GPU when modified
+    texcoords->properties.dataVariance = vsg::DYNAMIC_DATA;
+    _texcoords.emplace_back(texcoords, std::vector<vsg::vec2>(texcoords->begin(), texcoords->end()));
+}
+
+void ScheduledRenderGraph::traverse(vsg::RecordTraversal& visitor) const
+{
+    auto frameStamp = visitor.getFrameStamp();
+    uint64_t frameCount = frameStamp ? frameStamp->frameCount : 0;
+
+    bool record = _forceRecord;
+    if (!record)
+    {
+        bool due = interval <= 1 || (frameCount - _lastRecordedFrame) >= interval;
+        bool needed = !onlyWhenDirty || _dirty;
+
+        // the main view is recorded after the offscreen pass so the probe reports the previous frame's visibility
+        bool visible = true;
+        if (visibilityProbe)
+        {
+            uint64_t lastVisibleFrame = visibilityProbe->lastVisibleFrame;
+            visible = lastVisibleFrame != std::numeric_limits<uint64_t>::max() && frameCount <= lastVisibleFrame + 1;
+        }
+
+        record = due && needed && visible;
+    }
+
+    if (!record)
+    {
+        ++numSkipped;
+        return;
+    }
+
+    _forceRecord = false;
+    _dirty = false;
+    _lastRecordedFrame = frameCount;
+    ++numRecorded;
+
+    auto commandBuffer = visitor.getCommandBuffer();
+    if (gpuBudget <= 0.0 || !commandBuffer)
+    {
+        renderGraph->accept(visitor);
+        return;
+    }
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    size_t index = _nextQueryPool;
+    _nextQueryPool = (_nextQueryPool + 1) % _pending.size();
+    if (_pending[index]) _collect(index);
+
+    auto queryPool = _timestamps->queryPools[index]->vk(commandBuffer->deviceID);
+    vkCmdResetQueryPool(commandBuffer->vk(), queryPool, 0, 2);
+    vkCmdWriteTimestamp(commandBuffer->vk(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+
+    renderGraph->accept(visitor);
+
+    vkCmdWriteTimestamp(commandBuffer->vk(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+    _pending[index] = true;
+}
+
+void ScheduledRenderGraph::_collect(size_t index) const
+{
+    _pending[index] = false;
+
+    std::vector<uint64_t> timestamps(2);
+    if (_timestamps->queryPools[index]->getResults(timestamps) != VK_SUCCESS) return;
+
+    double milliseconds = timestampPeriod * 1e-6 * static_cast<double>(timestamps[1] - timestamps[0]);
+    _gpuTime = (_numTimings == 0) ? milliseconds : (_gpuTime * 0.9 + milliseconds * 0.1);
+    ++_numTimings;
+}
+
+void ScheduledRenderGraph::update()
+{
+    if (gpuBudget <= 0.0) return;
+
+    double gpuTime = 0.0;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (_numTimings < 4 || (numRecorded - _lastAdjustment) < adjustInterval) return;
+        gpuTime = _gpuTime;
+    }
+
+    // GPU time is taken as proportional to the render area, only growing when the larger area is predicted to fit
+    float newScale = _scale;
+    if (gpuTime > gpuBudget)
+    {
+        newScale = std::max(minScale, _scale - scaleStep);
+    }
+    else if (_scale < 1.0f)
+    {
+        float larger = std::min(1.0f, _scale + scaleStep);
+        double ratio = static_cast<double>(larger) / static_cast<double>(_scale);
+        if (gpuTime * ratio * ratio < gpuBudget * 0.9) newScale = larger;
+    }
+
+    _lastAdjustment = numRecorded;
+    if (newScale != _scale) _resize(newScale);
+}
+
+void ScheduledRenderGraph::_resize(float newScale)
+{
+    auto renderPass = renderGraph->getRenderPass();
+    if (!renderPass) return;
+
+    // wait until the device is idle to avoid changing state while it's being used.
+    vkDeviceWaitIdle(*(renderPass->device));
+
+    uint32_t width = std::max(1u, static_cast<uint32_t>(static_cast<float>(_fullExtent.width) * newScale));
+    uint32_t height = std::max(1u, static_cast<uint32_t>(static_cast<float>(_fullExtent.height) * newScale));
+
+    // render to the top left corner of the image, the rest of it is left unused
+    renderGraph->renderArea.extent = VkExtent2D{width, height};
+    camera->viewportState->set(0, 0, width, height);
+
+    vsg::UpdateGraphicsPipelines updateGraphicsPipelines;
+    updateGraphicsPipelines.context = vsg::Context::create(renderPass->device);
+    updateGraphicsPipelines.context->renderPass = renderPass;
+    renderGraph->accept(updateGraphicsPipelines);
+
+    float u = static_cast<float>(width) / static_cast<float>(_fullExtent.width);
+    float v = static_cast<float>(height) / static_cast<float>(_fullExtent.height);
+    for (auto& [texcoords, original] : _texcoords)
+    {
+        for (size_t i = 0; i < original.size(); ++i) texcoords->set(i, vsg::vec2(original[i].x * u, original[i].y * v));
+        texcoords->dirty();
+    }
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _scale = newScale;
+    _forceRecord = true;
+    _numTimings = 0;
+    std::fill(_pending.begin(), _pending.end(), false);
+    ++numResizes;
+}
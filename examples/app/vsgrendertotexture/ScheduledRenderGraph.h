@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <limits>
+#include <mutex>
+
+// Node placed in the main scene, under a vsg::CullNode bounding the geometry that samples an offscreen image, to record
+// the last frame in which that geometry was within the main view's frustum.
+class VisibilityProbe : public vsg::Inherit<vsg::Node, VisibilityProbe>
+{
+public:
+    mutable std::atomic_uint64_t lastVisibleFrame{std::numeric_limits<uint64_t>::max()};
+
+    void accept(vsg::RecordTraversal& visitor) const override
+    {
+        if (auto frameStamp = visitor.getFrameStamp()) lastVisibleFrame = frameStamp->frameCount;
+    }
+};
+
+// Wraps an offscreen RenderGraph to decide each frame whether it needs recording, when it's skipped the image it renders
+// to keeps the contents of its last update for the geometry sampling it. The pass is recorded every interval frames,
+// optionally only when marked dirty and/or when the VisibilityProbe of the geometry sampling it was in the previous
+// frame's main view. When a GPU time budget is set, the pass is timed with timestamp queries and update() adjusts the
+// render area, as a fraction of the image's extent, to keep within it. Resizing rebuilds the pass's graphics pipelines,
+// as the viewport is baked into them, so the scale only changes in steps and at most once per adjustInterval frames.
+class ScheduledRenderGraph : public vsg::Inherit<vsg::Group, ScheduledRenderGraph>
+{
+public:
+    ScheduledRenderGraph(vsg::ref_ptr<vsg::RenderGraph> in_renderGraph, vsg::ref_ptr<vsg::Camera> in_camera, uint32_t numFramesInFlight = 3, double in_timestampPeriod = 1.0);
+
+    vsg::ref_ptr<vsg::RenderGraph> renderGraph;
+    vsg::ref_ptr<vsg::Camera> camera;
+
+    // scheduling
+    uint32_t interval = 1;
+    bool onlyWhenDirty = false;
+    vsg::ref_ptr<VisibilityProbe> visibilityProbe; // when set only record when the probe was visible in the previous frame
+
+    // mark the contents as needing to be rendered again
+    void dirty() { _dirty = true; }
+
+    // dynamic resolution, disabled when gpuBudget is 0
+    double gpuBudget = 0.0; // milliseconds
+    double timestampPeriod = 1.0; // nanoseconds per timestamp tick
+    float minScale = 0.25f;
+    float scaleStep = 0.125f;
+    uint32_t adjustInterval = 30;
+
+    // texture coordinates of the geometry sampling the image, rescaled with the render area
+    void addTexCoords(vsg::ref_ptr<vsg::vec2Array> texcoords);
+
+    // adjust the resolution from the GPU timings, call between frames before recordAndSubmit()
+    void update();
+
+    float scale() const { return _scale; }
+    double gpuTime() const { return _gpuTime; } // smoothed milliseconds per update
+
+    // statistics
+    mutable std::atomic_uint64_t numRecorded{0};
+    mutable std::atomic_uint64_t numSkipped{0};
+    uint64_t numResizes = 0;
+
+    using Group::traverse;
+    void traverse(vsg::RecordTraversal& visitor) const override;
+
+    // compiles the timestamp query pools, recording is done by the ScheduledRenderGraph
+    class Timestamps : public vsg::Inherit<vsg::Command, Timestamps>
+    {
+    public:
+        std::vector<vsg::ref_ptr<vsg::QueryPool>> queryPools;
+
+        void compile(vsg::Context& context) override
+        {
+            for (auto& queryPool : queryPools) queryPool->compile(context);
+        }
+
+        void record(vsg::CommandBuffer&) const override {}
+    };
+
+protected:
+    void _collect(size_t index) const;
+    void _resize(float newScale);
+
+    VkExtent2D _fullExtent;
+    std::vector<std::pair<vsg::ref_ptr<vsg::vec2Array>, std::vector<vsg::vec2>>> _texcoords;
+    vsg::ref_ptr<Timestamps> _timestamps;
+
+    mutable std::mutex _mutex;
+    mutable std::atomic_bool _dirty{true};
+    mutable bool _forceRecord = true;
+    mutable uint64_t _lastRecordedFrame = 0;
+    mutable size_t _nextQueryPool = 0;
+    mutable std::vector<bool> _pending;
+    mutable double _gpuTime = 0.0;
+    mutable uint64_t _numTimings = 0;
+    float _scale = 1.0f;
+    uint64_t _lastAdjustment = 0;
+};
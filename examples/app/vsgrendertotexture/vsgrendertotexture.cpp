@@ -16,9 +16,13 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include <vsg/all.h>
 
 #include <chrono>
+#include <cmath>
 #include <iostream>
 #include <thread>
 
+#include "FrameTrace.h"
+#include "ScheduledRenderGraph.h"
+
 // Render a scene to an image, then use the image as a texture on the
 // faces of quads. This is based on Sascha William's offscreenrender
 // example.
@@ -168,7 +172,7 @@ vsg::ref_ptr<vsg::RenderGraph> createOffscreenRendergraph(vsg::Context& context,
     return rendergraph;
 }
 
-vsg::ref_ptr<vsg::Node> createPlanes(vsg::ref_ptr<vsg::ImageInfo> colorImage)
+vsg::ref_ptr<vsg::Node> createPlanes(vsg::ref_ptr<vsg::ImageInfo> colorImage, vsg::ref_ptr<vsg::vec2Array>& texcoords)
 {
     // set up search paths to SPIRV shaders and textures
     vsg::Paths searchPaths = vsg::getEnvPaths("VSG_FILE_PATH");
@@ -257,7 +261,7 @@ vsg::ref_ptr<vsg::Node> createPlanes(vsg::ref_ptr<vsg::ImageInfo> colorImage)
             {1.0f, 1.0f, 1.0f},
         }); // VK_FORMAT_R32G32B32_SFLOAT, VK_VERTEX_INPUT_RATE_VERTEX, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE
 
-    auto texcoords = vsg::vec2Array::create(
+    texcoords = vsg::vec2Array::create(
         {{0.0f, 0.0f},
          {1.0f, 0.0f},
          {1.0f, 1.0f},
@@ -318,6 +322,17 @@ int main(int argc, char** argv)
     bool separateCommandGraph = arguments.read("-s");
     bool multiThreading = arguments.read("--mt");
 
+    // scheduling and resolution scaling of the offscreen pass
+    VkExtent2D targetExtent{512, 512};
+    arguments.read("--rtt-size", targetExtent.width, targetExtent.height);
+    auto rttInterval = arguments.value<uint32_t>(1, "--rtt-interval");       // render every Nth frame
+    bool rttWhenDirty = arguments.read("--rtt-dirty");                       // render only when the animation has stepped, stepping at 10Hz
+    bool rttWhenVisible = arguments.read("--rtt-visible");                   // render only when the planes were in the main view
+    auto rttBudget = arguments.value<double>(0.0, "--rtt-budget");           // GPU milliseconds to scale the render area to fit
+    auto rttMinScale = arguments.value<float>(0.25f, "--rtt-min-scale");
+
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     // read shaders
@@ -327,6 +342,7 @@ int main(int argc, char** argv)
     VsgNodes vsgNodes;
 
     auto options = vsg::Options::create();
+    if (frameTrace) frameTrace->addReaderWriter(*options);
     options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
     options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
 
@@ -392,7 +408,6 @@ int main(int argc, char** argv)
     auto context = vsg::Context::create(window->getOrCreateDevice());
 
     // Framebuffer with attachments
-    VkExtent2D targetExtent{512, 512};
     auto offscreenCamera = createCameraForScene(vsg_scene, targetExtent);
     auto colorImage = vsg::ImageInfo::create();
     auto depthImage = vsg::ImageInfo::create();
@@ -401,7 +416,35 @@ int main(int argc, char** argv)
     rtt_RenderGraph->addChild(rtt_view);
 
     // Planes geometry that uses the rendered scene as a texture map
-    vsg::ref_ptr<vsg::Node> planes = createPlanes(colorImage);
+    vsg::ref_ptr<vsg::vec2Array> planeTexcoords;
+    vsg::ref_ptr<vsg::Node> planes = createPlanes(colorImage, planeTexcoords);
+
+    // the offscreen pass is recorded through a ScheduledRenderGraph that decides which frames it's needed in
+    const auto& limits = window->getOrCreatePhysicalDevice()->getProperties().limits;
+    auto scheduled_RenderGraph = ScheduledRenderGraph::create(rtt_RenderGraph, offscreenCamera, static_cast<uint32_t>(window->numFrames()), static_cast<double>(limits.timestampPeriod));
+    scheduled_RenderGraph->interval = rttInterval;
+    scheduled_RenderGraph->onlyWhenDirty = rttWhenDirty;
+    scheduled_RenderGraph->minScale = rttMinScale;
+    if (rttBudget > 0.0)
+    {
+        if (limits.timestampComputeAndGraphics) scheduled_RenderGraph->gpuBudget = rttBudget;
+        else std::cout << "Timestamps not supported, --rtt-budget ignored." << std::endl;
+    }
+    scheduled_RenderGraph->addTexCoords(planeTexcoords);
+
+    if (rttWhenVisible)
+    {
+        vsg::ComputeBounds computeBounds;
+        planes->accept(computeBounds);
+        vsg::dsphere bound((computeBounds.bounds.min + computeBounds.bounds.max) * 0.5, vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.5);
+
+        scheduled_RenderGraph->visibilityProbe = VisibilityProbe::create();
+        auto planesAndProbe = vsg::Group::create();
+        planesAndProbe->addChild(planes);
+        planesAndProbe->addChild(vsg::CullNode::create(bound, scheduled_RenderGraph->visibilityProbe));
+        planes = planesAndProbe;
+    }
+
     auto camera = createCameraForScene(planes, window->extent2D());
     auto main_RenderGraph = vsg::createRenderGraphForView(window, camera, planes);
 
@@ -413,24 +456,34 @@ int main(int argc, char** argv)
     if (separateCommandGraph)
     {
         auto rtt_commandGraph = vsg::CommandGraph::create(window);
-        rtt_commandGraph->addChild(rtt_RenderGraph);
+        rtt_commandGraph->addChild(scheduled_RenderGraph);
 
         auto main_commandGraph = vsg::CommandGraph::create(window);
         main_commandGraph->addChild(main_RenderGraph);
 
+        if (frameTrace)
+        {
+            frameTrace->addTimestamps(*rtt_commandGraph, "GPU render to texture");
+            frameTrace->addTimestamps(*main_commandGraph, "GPU main");
+        }
+
         viewer->assignRecordAndSubmitTaskAndPresentation({rtt_commandGraph, main_commandGraph});
     }
     else
     {
         // Place the offscreen RenderGraph before the plane geometry RenderGraph
         auto commandGraph = vsg::CommandGraph::create(window);
-        commandGraph->addChild(rtt_RenderGraph);
+        commandGraph->addChild(scheduled_RenderGraph);
         commandGraph->addChild(main_RenderGraph);
+        if (frameTrace) frameTrace->addTimestamps(*commandGraph);
 
         viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
     }
 
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     if (multiThreading)
     {
@@ -438,22 +491,48 @@ int main(int argc, char** argv)
     }
 
     // rendering main loop
+    float animationTime = -1.0f;
     while (viewer->advanceToNextFrame())
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
         // animate the offscreen scenegraph
         float time = std::chrono::duration<float, std::chrono::seconds::period>(viewer->getFrameStamp()->time - viewer->start_point()).count();
-        transform->matrix = vsg::rotate(time * vsg::radians(90.0f), vsg::vec3(0.0f, 0.0, 1.0f));
+        if (rttWhenDirty) time = std::floor(time * 10.0f) / 10.0f;
+
+        if (time != animationTime)
+        {
+            animationTime = time;
+            transform->matrix = vsg::rotate(time * vsg::radians(90.0f), vsg::vec3(0.0f, 0.0, 1.0f));
+            scheduled_RenderGraph->dirty();
+        }
 
+        traceFrame.phase("update");
         viewer->update();
 
+        scheduled_RenderGraph->update();
+
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        traceFrame.phase("present");
         viewer->present();
     }
 
+    std::cout << "Offscreen pass recorded " << scheduled_RenderGraph->numRecorded << " frames, skipped " << scheduled_RenderGraph->numSkipped << ", final scale " << scheduled_RenderGraph->scale();
+    if (scheduled_RenderGraph->gpuBudget > 0.0) std::cout << " after " << scheduled_RenderGraph->numResizes << " resizes, gpu time " << scheduled_RenderGraph->gpuTime() << "ms";
+    std::cout << std::endl;
+
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
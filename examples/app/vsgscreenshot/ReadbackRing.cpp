@@ -0,0 +1,261 @@
+#include "ReadbackRing.h"
+
+#include <algorithm>
+#include <iostream>
+
+ReadbackRing::ReadbackRing(vsg::ref_ptr<vsg::Window> in_window, uint32_t in_numBuffers, bool in_yuv420, Callback in_callback, vsg::ref_ptr<const vsg::Options> options) :
+    numBuffers(std::max(in_numBuffers, 1u)),
+    yuv420(in_yuv420),
+    extent(in_yuv420 ? VkExtent2D{in_window->extent2D().width & ~7u, in_window->extent2D().height & ~1u} : in_window->extent2D()),
+    format(in_yuv420 ? VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM : in_window->surfaceFormat().format),
+    _window(in_window),
+    _device(in_window->getOrCreateDevice()),
+    _callback(in_callback)
+{
+    for (size_t i = 0; i < _window->numFrames(); ++i) _imageViews.push_back(_window->imageView(i));
+
+    _frameSize = yuv420 ? (VkDeviceSize(extent.width) * extent.height * 3) / 2 : VkDeviceSize(extent.width) * extent.height * 4;
+
+    // the conversion is shared by all the slots, each swapchain image has its own source descriptor set and each slot its own destination
+    vsg::ref_ptr<vsg::PipelineLayout> pipelineLayout;
+    vsg::ref_ptr<vsg::BindComputePipeline> bindPipeline;
+    vsg::ref_ptr<vsg::DescriptorSetLayout> bufferLayout;
+    std::vector<vsg::ref_ptr<vsg::BindDescriptorSet>> bindSources;
+    if (yuv420)
+    {
+        auto computeShader = vsg::read_cast<vsg::ShaderStage>("shaders/rgba_to_yuv420.comp", options);
+        if (!computeShader)
+        {
+            std::cout << "ReadbackRing : could not load shaders/rgba_to_yuv420.comp." << std::endl;
+            return;
+        }
+
+        bool srgbSource = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB;
+        computeShader->specializationConstants = vsg::ShaderStage::SpecializationConstants{
+            {0, vsg::uintValue::create(extent.width)},
+            {1, vsg::uintValue::create(extent.height)},
+            {2, vsg::uintValue::create(srgbSource ? 1 : 0)}};
+
+        vsg::DescriptorSetLayoutBindings sourceBindings{{0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}};
+        vsg::DescriptorSetLayoutBindings bufferBindings{{0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}};
+        auto sourceLayout = vsg::DescriptorSetLayout::create(sourceBindings);
+        bufferLayout = vsg::DescriptorSetLayout::create(bufferBindings);
+
+        pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{sourceLayout, bufferLayout}, vsg::PushConstantRanges{});
+        bindPipeline = vsg::BindComputePipeline::create(vsg::ComputePipeline::create(pipelineLayout, computeShader));
+
+        auto sampler = vsg::Sampler::create();
+        sampler->minFilter = VK_FILTER_NEAREST;
+        sampler->magFilter = VK_FILTER_NEAREST;
+        sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+        for (auto& imageView : _imageViews)
+        {
+            auto descriptor = vsg::DescriptorImage::create(vsg::ImageInfo::create(sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+            bindSources.push_back(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, vsg::DescriptorSet::create(sourceLayout, vsg::Descriptors{descriptor})));
+        }
+    }
+
+    VkImageSubresourceRange colorRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    for (uint32_t s = 0; s < numBuffers; ++s)
+    {
+        auto slot = std::make_unique<Slot>();
+
+        VkBufferUsageFlags usage = yuv420 ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        slot->buffer = vsg::createBufferAndMemory(_device, _frameSize, usage, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+        // mapped for the lifetime of the ring, the MappedData is what the callback receives
+        auto memory = slot->buffer->getDeviceMemory(_device->deviceID);
+        slot->data = vsg::MappedData<vsg::ubyteArray>::create(memory, slot->buffer->getMemoryOffset(_device->deviceID), 0, vsg::Data::Properties{format}, _frameSize);
+
+        slot->event = vsg::Event::create(_device);
+
+        auto bufferToHostRead = vsg::BufferMemoryBarrier::create(
+            yuv420 ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_TRANSFER_WRITE_BIT, // srcAccessMask
+            VK_ACCESS_HOST_READ_BIT,                                             // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                                             // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                                             // dstQueueFamilyIndex
+            slot->buffer,                                                        // buffer
+            0,                                                                   // offset
+            _frameSize                                                           // size
+        );
+
+        vsg::ref_ptr<vsg::BindDescriptorSet> bindDestination;
+        if (yuv420)
+        {
+            auto descriptor = vsg::DescriptorBuffer::create(vsg::BufferInfoList{vsg::BufferInfo::create(slot->buffer, 0, _frameSize)}, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            bindDestination = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 1, vsg::DescriptorSet::create(bufferLayout, vsg::Descriptors{descriptor}));
+        }
+
+        for (size_t i = 0; i < _imageViews.size(); ++i)
+        {
+            auto image = _imageViews[i]->image;
+            auto commands = vsg::Commands::create();
+
+            // the RenderGraph leaves the swapchain image in PRESENT_SRC
+            VkImageLayout readLayout = yuv420 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            VkAccessFlags readAccess = yuv420 ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_TRANSFER_READ_BIT;
+            VkPipelineStageFlags readStage = yuv420 ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+            auto imageToRead = vsg::ImageMemoryBarrier::create(VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, readAccess, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, readLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, colorRange);
+            commands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, readStage, 0, imageToRead));
+
+            if (yuv420)
+            {
+                commands->addChild(bindPipeline);
+                commands->addChild(bindSources[i]);
+                commands->addChild(bindDestination);
+
+                // each invocation converts an 8x2 block, writing whole words of each plane
+                commands->addChild(vsg::Dispatch::create((extent.width / 8 + 7) / 8, (extent.height / 2 + 7) / 8, 1));
+            }
+            else
+            {
+                VkBufferImageCopy region{};
+                region.bufferOffset = 0;
+                region.bufferRowLength = 0; // tightly packed
+                region.bufferImageHeight = 0;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.layerCount = 1;
+                region.imageOffset = VkOffset3D{0, 0, 0};
+                region.imageExtent = VkExtent3D{extent.width, extent.height, 1};
+
+                auto copyImage = vsg::CopyImageToBuffer::create();
+                copyImage->srcImage = image;
+                copyImage->srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                copyImage->dstBuffer = slot->buffer;
+                copyImage->regions.push_back(region);
+                commands->addChild(copyImage);
+            }
+
+            auto imageToPresent = vsg::ImageMemoryBarrier::create(readAccess, 0, readLayout, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, colorRange);
+            commands->addChild(vsg::PipelineBarrier::create(readStage, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, imageToPresent, bufferToHostRead));
+
+            // poll() checks the event rather than the frame's fence so completion is known as soon as the readback finishes
+            commands->addChild(vsg::SetEvent::create(slot->event, readStage));
+
+            slot->commands.push_back(commands);
+        }
+
+        _slots.push_back(std::move(slot));
+    }
+
+    _writer = std::thread([this]() { _writerLoop(); });
+}
+
+ReadbackRing::~ReadbackRing()
+{
+    finish();
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+    if (_writer.joinable()) _writer.join();
+}
+
+bool ReadbackRing::compatible(const vsg::Window& window) const
+{
+    if (window.numFrames() != _imageViews.size()) return false;
+    for (size_t i = 0; i < _imageViews.size(); ++i)
+    {
+        if (window.imageView(i) != _imageViews[i]) return false;
+    }
+    return true;
+}
+
+void ReadbackRing::compile(vsg::Context& context)
+{
+    for (auto& slot : _slots)
+    {
+        for (auto& commands : slot->commands) commands->compile(context);
+    }
+}
+
+void ReadbackRing::record(vsg::CommandBuffer& commandBuffer) const
+{
+    uint64_t frameCount = _frameCount++;
+    if (_slots.empty() || _slots.front()->commands.empty()) return;
+
+    auto& slot = *_slots[_nextSlot];
+    if (slot.state.load() != FREE)
+    {
+        // the writer hasn't kept up, drop this frame rather than wait
+        ++numDropped;
+        return;
+    }
+
+    // the event was set by the slot's previous readback, which the writer has finished with
+    vkResetEvent(*_device, slot.event->vk());
+
+    slot.frameCount = frameCount;
+    slot.state = PENDING;
+    slot.commands[_window->imageIndex() % slot.commands.size()]->record(commandBuffer);
+
+    _nextSlot = (_nextSlot + 1) % numBuffers;
+}
+
+void ReadbackRing::poll()
+{
+    // slots are recorded in order so complete in order
+    size_t numReady = 0;
+    for (auto& slot : _slots)
+    {
+        if (slot->state.load() == PENDING && slot->event->status() == VK_EVENT_SET)
+        {
+            slot->state = WRITING;
+            {
+                std::scoped_lock<std::mutex> lock(_mutex);
+                _completed.push_back(slot.get());
+            }
+            ++numReady;
+        }
+    }
+
+    if (numReady > 0) _condition.notify_all();
+}
+
+void ReadbackRing::finish()
+{
+    if (_slots.empty()) return;
+
+    vkDeviceWaitIdle(*_device);
+    poll();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this]() {
+        for (auto& slot : _slots)
+        {
+            if (slot->state.load() != FREE) return false;
+        }
+        return true;
+    });
+}
+
+void ReadbackRing::_writerLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _condition.wait(lock, [this]() { return _stop || !_completed.empty(); });
+        if (_completed.empty()) break;
+
+        // poll() can hand over several frames at once, keep them in frame order
+        std::sort(_completed.begin(), _completed.end(), [](const Slot* lhs, const Slot* rhs) { return lhs->frameCount < rhs->frameCount; });
+        auto slot = _completed.front();
+        _completed.pop_front();
+
+        lock.unlock();
+
+        if (_callback) _callback(Frame{slot->frameCount, extent, yuv420, slot->data});
+        ++numCaptured;
+        bytesReadback += _frameSize;
+
+        lock.lock();
+        slot->state = FREE;
+        _condition.notify_all();
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Command placed after the window's RenderGraph that copies each frame's swapchain image into one of a ring of host
+// visible, persistently mapped buffers. Each copy signals a vsg::Event that poll() checks without blocking, completed
+// frames are then handed to a writer thread as vsg::Data mapping the buffer directly, so nothing is copied on the host and
+// the frame loop never waits on the GPU. The buffer is returned to the ring once the callback returns, if all the buffers
+// are still in use when a frame is recorded that frame is dropped rather than stalling.
+//
+// With yuv420 set a compute pass converts the image to planar BT.709 YUV 4:2:0 (I420) before readback, 1.5 bytes per
+// pixel rather than 4, the extent is rounded down to a multiple of 8x2 for the shader's packing.
+class ReadbackRing : public vsg::Inherit<vsg::Command, ReadbackRing>
+{
+public:
+    struct Frame
+    {
+        uint64_t frameCount = 0;
+        VkExtent2D extent = {0, 0};
+        bool yuv420 = false;
+        vsg::ref_ptr<vsg::Data> data; // maps the ring buffer, only valid during the callback
+    };
+
+    using Callback = std::function<void(const Frame&)>;
+
+    ReadbackRing(vsg::ref_ptr<vsg::Window> in_window, uint32_t in_numBuffers, bool in_yuv420, Callback in_callback, vsg::ref_ptr<const vsg::Options> options = {});
+    ~ReadbackRing();
+
+    const uint32_t numBuffers;
+    const bool yuv420;
+    const VkExtent2D extent;
+    const VkFormat format;
+
+    // false if the conversion shader couldn't be loaded
+    bool valid() const { return !_slots.empty(); }
+
+    // false once the window's swapchain has been recreated, the ring then needs to be replaced
+    bool compatible(const vsg::Window& window) const;
+
+    // hand any readbacks the GPU has completed to the writer thread, call once per frame
+    void poll();
+
+    // wait for the device to complete outstanding readbacks and for the writer thread to process them
+    void finish();
+
+    void compile(vsg::Context& context) override;
+    void record(vsg::CommandBuffer& commandBuffer) const override;
+
+    // stats accumulated over all frames
+    std::atomic_uint64_t numCaptured{0};
+    mutable std::atomic_uint64_t numDropped{0};
+    std::atomic_uint64_t bytesReadback{0};
+
+protected:
+    enum State : uint32_t
+    {
+        FREE,
+        PENDING,
+        WRITING
+    };
+
+    struct Slot
+    {
+        vsg::ref_ptr<vsg::Buffer> buffer;
+        vsg::ref_ptr<vsg::Data> data;
+        vsg::ref_ptr<vsg::Event> event;
+        std::atomic<State> state{FREE};
+        uint64_t frameCount = 0;
+
+        // per swapchain image commands copying that image into this slot's buffer
+        std::vector<vsg::ref_ptr<vsg::Commands>> commands;
+    };
+
+    void _writerLoop();
+
+    vsg::ref_ptr<vsg::Window> _window;
+    vsg::ref_ptr<vsg::Device> _device;
+    std::vector<vsg::ref_ptr<vsg::ImageView>> _imageViews;
+    VkDeviceSize _frameSize = 0;
+    std::vector<std::unique_ptr<Slot>> _slots;
+    mutable uint32_t _nextSlot = 0;
+    mutable uint64_t _frameCount = 0;
+
+    Callback _callback;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<Slot*> _completed;
+    bool _stop = false;
+    std::thread _writer;
+};
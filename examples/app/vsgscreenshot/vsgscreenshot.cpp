@@ -4,8 +4,12 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "FrameTrace.h"
+#include "ReadbackRing.h"
+
 #include <algorithm>
 #include <chrono>
+#include <fstream>
 #include <iostream>
 #include <thread>
 
@@ -527,6 +531,12 @@ int main(int argc, char** argv)
     if (arguments.read("--float")) windowTraits->depthFormat = VK_FORMAT_D32_SFLOAT;
     auto numFrames = arguments.value(-1, "-f");
 
+    // capture every frame through a ring of readback buffers and write them to a raw video stream, optionally converted to YUV 4:2:0 on the GPU
+    auto captureFilename = arguments.value<vsg::Path>("", "--capture");
+    auto captureBuffers = arguments.value<uint32_t>(4, "--capture-buffers");
+    bool captureYUV = arguments.read("--yuv");
+    if (captureYUV) windowTraits->swapchainPreferences.imageUsage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+
     // if we are multisampling then to enable copying of the depth buffer we have to enable a depth buffer resolve extensions in vsg::RenderPass that requires a minim vulkan version of 1.2
     if (windowTraits->samples != VK_SAMPLE_COUNT_1_BIT) windowTraits->vulkanVersion = VK_API_VERSION_1_2;
 
@@ -540,6 +550,9 @@ int main(int argc, char** argv)
         std::cout<<"vk_minor = "<<vk_minor<<std::endl;
     }
 
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
+    if (frameTrace) frameTrace->addReaderWriter(*options);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     auto vsg_scene = vsg::Group::create();
@@ -617,28 +630,103 @@ int main(int argc, char** argv)
     viewer->addEventHandler(screenshotHandler);
 
     auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
+
+    std::ofstream captureStream;
+    vsg::ref_ptr<ReadbackRing> readbackRing;
+    auto createReadbackRing = [&]() -> vsg::ref_ptr<ReadbackRing> {
+        // runs on the ring's writer thread, frame.data maps the readback buffer so is written straight from it
+        auto writeFrame = [&captureStream](const ReadbackRing::Frame& frame) {
+            captureStream.write(static_cast<const char*>(frame.data->dataPointer()), frame.data->dataSize());
+        };
+
+        auto ring = ReadbackRing::create(window, captureBuffers, captureYUV, writeFrame, options);
+        if (!ring->valid()) return {};
+
+        const char* pixelFormat = "bgra";
+        if (ring->yuv420) pixelFormat = "yuv420p";
+        else if (ring->format == VK_FORMAT_R8G8B8A8_UNORM || ring->format == VK_FORMAT_R8G8B8A8_SRGB) pixelFormat = "rgba";
+
+        std::cout << "Capturing " << ring->extent.width << "x" << ring->extent.height << " frames to " << captureFilename << ", encode with:" << std::endl;
+        std::cout << "    ffmpeg -f rawvideo -pix_fmt " << pixelFormat << " -s " << ring->extent.width << "x" << ring->extent.height << " -r 60 -i " << captureFilename << " capture.mp4" << std::endl;
+        return ring;
+    };
+
+    if (!captureFilename.empty())
+    {
+        captureStream.open(captureFilename.string(), std::ios::out | std::ios::binary);
+        if (!captureStream)
+        {
+            std::cout << "Could not open " << captureFilename << " for capture." << std::endl;
+            return 1;
+        }
+
+        readbackRing = createReadbackRing();
+        if (!readbackRing) return 1;
+
+        // copy out of the swapchain image after the RenderGraph has rendered to it
+        commandGraph->addChild(readbackRing);
+    }
+
     if (event) commandGraph->addChild(vsg::SetEvent::create(event, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT));
 
+    if (frameTrace) frameTrace->addTimestamps(*commandGraph);
+
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     // rendering main loop
     while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        traceFrame.phase("update");
         viewer->update();
 
+        if (readbackRing && !readbackRing->compatible(*window))
+        {
+            // the swapchain has been recreated so the ring needs rebuilding for the new images, replacing it waits for its outstanding frames
+            std::cout << "Window resized, the capture stream's frame size changes from here." << std::endl;
+            auto itr = std::find(commandGraph->children.begin(), commandGraph->children.end(), readbackRing);
+            readbackRing = createReadbackRing();
+            if (!readbackRing) break;
+            *itr = readbackRing;
+
+            auto result = viewer->compileManager->compile(readbackRing);
+            vsg::updateViewer(*viewer, result);
+        }
+
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        if (readbackRing) readbackRing->poll();
+
         if (screenshotHandler->do_image_capture) screenshotHandler->screenshot_image(window);
         if (screenshotHandler->do_depth_capture) screenshotHandler->screenshot_depth(window);
 
+        traceFrame.phase("present");
         viewer->present();
     }
 
+    if (readbackRing)
+    {
+        readbackRing->finish();
+        std::cout << "Captured " << readbackRing->numCaptured << " frames, dropped " << readbackRing->numDropped << ", " << double(readbackRing->bytesReadback) / (1024.0 * 1024.0) << " MB read back" << std::endl;
+    }
+
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
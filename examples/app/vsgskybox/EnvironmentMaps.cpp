@@ -0,0 +1,315 @@
+#include "EnvironmentMaps.h"
+#include "AssignDescriptorSet.h"
+#include "AtomicSave.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    // bump when the shaders or the layout of the cached data change so stale cache entries are ignored
+    constexpr uint64_t s_cacheVersion = 1;
+
+    uint32_t numLevelsForSize(uint32_t size)
+    {
+        uint32_t numLevels = 1;
+        while ((size >> numLevels) > 0) ++numLevels;
+        return numLevels;
+    }
+} // namespace
+
+EnvironmentMaps::EnvironmentMaps(vsg::ref_ptr<vsg::Data> in_environment, uint32_t in_prefilteredSize, uint32_t in_numLevels) :
+    environment(in_environment),
+    prefilteredSize(std::max(in_prefilteredSize, 1u)),
+    numLevels(std::clamp(in_numLevels, 1u, numLevelsForSize(prefilteredSize))),
+    _params(EnvironmentParamsValue::create())
+{
+    _params->properties.dataVariance = vsg::DYNAMIC_DATA;
+
+    descriptorSetLayout = vsg::DescriptorSetLayout::create(vsg::DescriptorSetLayoutBindings{
+        {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr},        // EnvironmentParams
+        {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr} // prefilteredMap
+    });
+}
+
+bool EnvironmentMaps::assignShaderSets(vsg::ref_ptr<vsg::Options> options)
+{
+    // the built in shaders don't have the image based lighting code so use the one in vsgExamples/data
+    auto shaderSet = vsg::createPhysicsBasedRenderingShaderSet(options);
+    auto fragmentShader = vsg::read_cast<vsg::ShaderStage>("shaders/standard_pbr.frag", options);
+    if (!shaderSet || !fragmentShader) return false;
+
+    for (auto& stage : shaderSet->stages)
+    {
+        if (stage->stage == VK_SHADER_STAGE_FRAGMENT_BIT) stage = fragmentShader;
+    }
+
+    const char* bindingNames[] = {"environmentParams", "prefilteredMap"};
+    for (auto& binding : descriptorSetLayout->bindings)
+    {
+        shaderSet->addDescriptorBinding(bindingNames[binding.binding], "VSG_IMAGE_BASED_LIGHTING", environmentDescriptorSet, binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags, {});
+    }
+
+    if (!shaderSet->defaultShaderHints) shaderSet->defaultShaderHints = vsg::ShaderCompileSettings::create();
+    shaderSet->defaultShaderHints->defines.insert("VSG_IMAGE_BASED_LIGHTING");
+
+    options->shaderSets["pbr"] = shaderSet;
+    return true;
+}
+
+uint64_t EnvironmentMaps::_hash() const
+{
+    uint64_t hash = experimental::hashSeed;
+    for (uint64_t value : {s_cacheVersion, uint64_t(environment->width()), uint64_t(environment->height()), uint64_t(environment->depth()), uint64_t(environment->properties.format),
+                           uint64_t(prefilteredSize), uint64_t(numLevels), uint64_t(irradianceSampleSize), uint64_t(numPrefilterSamples)})
+    {
+        hash = experimental::hashBytes(&value, sizeof(value), hash);
+    }
+    return experimental::hashBytes(environment->dataPointer(), environment->dataSize(), hash);
+}
+
+vsg::Path EnvironmentMaps::_cacheFilename() const
+{
+    std::ostringstream str;
+    str << std::hex << std::setw(16) << std::setfill('0') << _hash() << ".vsgb";
+    return cacheDirectory / str.str();
+}
+
+bool EnvironmentMaps::_readCache()
+{
+    auto cachedFilename = _cacheFilename();
+    if (!vsg::fileExists(cachedFilename)) return false;
+
+    auto objects = vsg::read_cast<vsg::Objects>(cachedFilename);
+    if (!objects || objects->children.size() != 2) return false;
+
+    auto irradiance = objects->children[0].cast<vsg::vec4Array>();
+    auto prefiltered = objects->children[1].cast<vsg::vec4Array3D>();
+    if (!irradiance || irradiance->size() != 9 || !prefiltered) return false;
+
+    std::copy(irradiance->begin(), irradiance->end(), _params->value().irradianceSH);
+    _prefiltered = prefiltered;
+    return true;
+}
+
+void EnvironmentMaps::_writeCache() const
+{
+    vsg::makeDirectory(cacheDirectory);
+
+    auto& sh = _params->value().irradianceSH;
+    auto objects = vsg::Objects::create();
+    objects->addChild(vsg::vec4Array::create({sh[0], sh[1], sh[2], sh[3], sh[4], sh[5], sh[6], sh[7], sh[8]}));
+    objects->addChild(_prefiltered);
+
+    // write through a temporary file so a concurrent or interrupted run never sees a partial cache entry
+    experimental::atomicSave(_cacheFilename(), [&](const vsg::Path& temporaryFilename) { return vsg::write(objects, temporaryFilename); });
+}
+
+bool EnvironmentMaps::generate(vsg::ref_ptr<vsg::Window> window, vsg::ref_ptr<const vsg::Options> options)
+{
+    if (!environment || environment->properties.imageViewType != VK_IMAGE_VIEW_TYPE_CUBE)
+    {
+        vsg::warn("EnvironmentMaps::generate() environment isn't a cube map.");
+        return false;
+    }
+
+    auto startTime = vsg::clock::now();
+
+    cacheHit = !cacheDirectory.empty() && _readCache();
+    if (!cacheHit)
+    {
+        if (!_compute(window->getOrCreateDevice(), options)) return false;
+        if (!cacheDirectory.empty()) _writeCache();
+    }
+
+    _params->value().params.set(static_cast<float>(numLevels - 1), intensity, 0.0f, 0.0f);
+
+    generateTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+    return true;
+}
+
+bool EnvironmentMaps::_compute(vsg::ref_ptr<vsg::Device> device, vsg::ref_ptr<const vsg::Options> options)
+{
+    auto irradianceShader = vsg::read_cast<vsg::ShaderStage>("shaders/ibl_irradiance_sh.comp", options);
+    auto prefilterShader = vsg::read_cast<vsg::ShaderStage>("shaders/ibl_prefilter.comp", options);
+    if (!irradianceShader || !prefilterShader)
+    {
+        vsg::warn("EnvironmentMaps::generate() unable to load the image based lighting compute shaders.");
+        return false;
+    }
+
+    // sample the environment through its full mip chain, generated by the VSG when the cube map doesn't have one, so the
+    // coarse samples of the irradiance projection and the rough prefiltered levels read from pre-averaged levels
+    uint32_t sourceSize = environment->width();
+    uint32_t sourceLevels = numLevelsForSize(sourceSize);
+    auto sampler = vsg::Sampler::create();
+    sampler->maxLod = static_cast<float>(sourceLevels);
+    auto environmentImage = vsg::DescriptorImage::create(sampler, environment, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+
+    auto memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    // the irradiance workgroups cover 8x8 texels so round the sample size down to a multiple of 8
+    uint32_t sampleSize = std::max(irradianceSampleSize / 8, 1u) * 8;
+    uint32_t numGroups = sampleSize / 8;
+    uint32_t numIrradianceSums = numGroups * numGroups * 6 * 9;
+    VkDeviceSize irradianceBufferSize = sizeof(vsg::vec4) * numIrradianceSums;
+    auto irradianceBuffer = vsg::createBufferAndMemory(device, irradianceBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, memoryFlags);
+
+    uint32_t numPrefilteredTexels = 0;
+    for (uint32_t level = 0; level < numLevels; ++level)
+    {
+        uint32_t size = std::max(prefilteredSize >> level, 1u);
+        numPrefilteredTexels += size * size * 6;
+    }
+    VkDeviceSize prefilteredBufferSize = sizeof(vsg::vec4) * numPrefilteredTexels;
+    auto prefilteredBuffer = vsg::createBufferAndMemory(device, prefilteredBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, memoryFlags);
+
+    // both passes read the environment as binding 0 and write their results to the storage buffer at binding 1
+    auto computeSetLayout = vsg::DescriptorSetLayout::create(vsg::DescriptorSetLayoutBindings{
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}});
+
+    auto irradianceSet = vsg::DescriptorSet::create(computeSetLayout, vsg::Descriptors{environmentImage, vsg::DescriptorBuffer::create(vsg::BufferInfoList{vsg::BufferInfo::create(irradianceBuffer, 0, irradianceBufferSize)}, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)});
+    auto prefilterSet = vsg::DescriptorSet::create(computeSetLayout, vsg::Descriptors{environmentImage, vsg::DescriptorBuffer::create(vsg::BufferInfoList{vsg::BufferInfo::create(prefilteredBuffer, 0, prefilteredBufferSize)}, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)});
+
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{computeSetLayout}, vsg::PushConstantRanges{{VK_SHADER_STAGE_COMPUTE_BIT, 0, static_cast<uint32_t>(2 * sizeof(vsg::vec4))}});
+
+    auto commands = vsg::Commands::create();
+
+    float irradianceLod = std::max(std::log2(static_cast<float>(sourceSize) / static_cast<float>(sampleSize)), 0.0f);
+    commands->addChild(vsg::BindComputePipeline::create(vsg::ComputePipeline::create(pipelineLayout, irradianceShader)));
+    commands->addChild(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, irradianceSet));
+    commands->addChild(vsg::PushConstants::create(VK_SHADER_STAGE_COMPUTE_BIT, 0, vsg::vec4Array::create({vsg::vec4(static_cast<float>(sampleSize), irradianceLod, 0.0f, 0.0f), vsg::vec4()})));
+    commands->addChild(vsg::Dispatch::create(numGroups, numGroups, 6));
+
+    commands->addChild(vsg::BindComputePipeline::create(vsg::ComputePipeline::create(pipelineLayout, prefilterShader)));
+    commands->addChild(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, prefilterSet));
+
+    uint32_t offset = 0;
+    for (uint32_t level = 0; level < numLevels; ++level)
+    {
+        uint32_t size = std::max(prefilteredSize >> level, 1u);
+        float roughness = numLevels > 1 ? static_cast<float>(level) / static_cast<float>(numLevels - 1) : 0.0f;
+
+        auto levelParams = vsg::vec4Array::create({vsg::vec4(static_cast<float>(size), static_cast<float>(offset), static_cast<float>(numPrefilterSamples), roughness),
+                                                   vsg::vec4(static_cast<float>(sourceSize), static_cast<float>(sourceLevels - 1), 0.0f, 0.0f)});
+        commands->addChild(vsg::PushConstants::create(VK_SHADER_STAGE_COMPUTE_BIT, 0, levelParams));
+        commands->addChild(vsg::Dispatch::create((size + 7) / 8, (size + 7) / 8, 6));
+
+        offset += size * size * 6;
+    }
+
+    commands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, vsg::MemoryBarrier::create(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT)));
+
+    // compile the Vulkan objects and transfer the environment cube map
+    auto compileTraversal = vsg::CompileTraversal::create();
+    compileTraversal->queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    compileTraversal->add(device);
+    auto context = compileTraversal->contexts.front();
+
+    commands->accept(*compileTraversal);
+    context->record();
+    context->waitForCompletion();
+
+    auto queueFamily = device->getPhysicalDevice()->getQueueFamily(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+    auto queue = device->getQueue(queueFamily);
+    auto fence = vsg::Fence::create(device);
+
+    vsg::submitCommandsToQueue(context->commandPool, fence, 100000000000, queue, [&](vsg::CommandBuffer& commandBuffer) {
+        commands->record(commandBuffer);
+    });
+
+    // add up the workgroups' sums, normalizing by the total solid angle sampled to remove the texel approximation's error
+    auto irradianceSums = vsg::MappedData<vsg::vec4Array>::create(irradianceBuffer->getDeviceMemory(device->deviceID), irradianceBuffer->getMemoryOffset(device->deviceID), 0, vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT}, numIrradianceSums);
+
+    std::vector<vsg::dvec3> coefficients(9);
+    double totalSolidAngle = 0.0;
+    for (uint32_t i = 0; i < numIrradianceSums; ++i)
+    {
+        auto& sum = irradianceSums->at(i);
+        coefficients[i % 9] += vsg::dvec3(sum.r, sum.g, sum.b);
+        if (i % 9 == 0) totalSolidAngle += sum.a;
+    }
+    for (auto& c : coefficients) c *= 4.0 * vsg::PI / totalSolidAngle;
+    _setIrradiance(coefficients);
+
+    // the prefiltered buffer holds the levels one after the other, each with its 6 faces, which is how the VSG lays out a mipmapped cube map
+    vsg::Data::Properties properties{VK_FORMAT_R32G32B32A32_SFLOAT};
+    properties.maxNumMipmaps = static_cast<uint8_t>(numLevels);
+    properties.imageViewType = VK_IMAGE_VIEW_TYPE_CUBE;
+
+    auto prefiltered = vsg::vec4Array3D::create(prefilteredSize, prefilteredSize, 6, properties);
+    if (prefiltered->dataSize() < prefilteredBufferSize)
+    {
+        vsg::warn("EnvironmentMaps::generate() prefiltered mip chain doesn't match the cube map's data size.");
+        return false;
+    }
+
+    auto prefilteredValues = vsg::MappedData<vsg::vec4Array>::create(prefilteredBuffer->getDeviceMemory(device->deviceID), prefilteredBuffer->getMemoryOffset(device->deviceID), 0, vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT}, numPrefilteredTexels);
+    std::memcpy(prefiltered->dataPointer(), prefilteredValues->dataPointer(), prefilteredBufferSize);
+    _prefiltered = prefiltered;
+
+    return true;
+}
+
+void EnvironmentMaps::_setIrradiance(const std::vector<vsg::dvec3>& coefficients)
+{
+    // convolve the radiance with the clamped cosine lobe, whose zonal coefficients per band are pi, 2pi/3 and pi/4, and
+    // divide by pi so the fragment shader scales the result by the diffuse color directly
+    const double bandScale[3] = {1.0, 2.0 / 3.0, 0.25};
+    const int band[9] = {0, 1, 1, 1, 2, 2, 2, 2, 2};
+
+    auto& sh = _params->value().irradianceSH;
+    for (size_t i = 0; i < 9; ++i)
+    {
+        auto c = coefficients[i] * bandScale[band[i]];
+        sh[i].set(static_cast<float>(c.x), static_cast<float>(c.y), static_cast<float>(c.z), 0.0f);
+    }
+}
+
+void EnvironmentMaps::assign(vsg::Node& scene)
+{
+    if (!_prefiltered)
+    {
+        vsg::warn("EnvironmentMaps::assign() generate() hasn't been called.");
+        return;
+    }
+
+    if (!_descriptorSet)
+    {
+        auto sampler = vsg::Sampler::create();
+        sampler->maxLod = static_cast<float>(numLevels - 1);
+
+        _descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{
+                                                                             vsg::DescriptorBuffer::create(_params, 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER),
+                                                                             vsg::DescriptorImage::create(sampler, _prefiltered, 1, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)});
+    }
+
+    auto assignDescriptorSet = AssignDescriptorSet::create(_descriptorSet, environmentDescriptorSet);
+    scene.accept(*assignDescriptorSet);
+
+    if (assignDescriptorSet->numAssigned == 0)
+    {
+        vsg::warn("EnvironmentMaps::assign() no StateGroups with image based lighting pipelines found.");
+    }
+}
+
+void EnvironmentMaps::update(const vsg::Camera& camera)
+{
+    // only the rotation is needed as the environment is at infinity
+    auto environmentFromEye = vsg::inverse(environmentMatrix) * camera.viewMatrix->inverse();
+    environmentFromEye[3] = vsg::dvec4(0.0, 0.0, 0.0, 1.0);
+
+    _params->value().environmentFromEye = vsg::mat4(environmentFromEye);
+    _params->dirty();
+}
+
+void EnvironmentMaps::report(std::ostream& out) const
+{
+    out << "EnvironmentMaps " << (cacheHit ? "read from cache" : "computed") << " in " << generateTime << "ms, prefiltered size = " << prefilteredSize << ", numLevels = " << numLevels << std::endl;
+}
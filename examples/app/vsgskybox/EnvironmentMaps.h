@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <ostream>
+
+struct EnvironmentParams
+{
+    vsg::vec4 irradianceSH[9];    // cosine convolved radiance divided by pi, so scaled by the diffuse color gives the diffuse light
+    vsg::mat4 environmentFromEye; // rotates eye coordinate directions into the environment cube map's
+    vsg::vec4 params;             // max prefiltered lod, intensity
+};
+
+class EnvironmentParamsValue : public vsg::Inherit<vsg::Value<EnvironmentParams>, EnvironmentParamsValue>
+{
+public:
+    EnvironmentParamsValue() {}
+};
+
+// Image based lighting from the skybox's environment cube map. A compute pass projects the environment onto 9 spherical
+// harmonic irradiance coefficients and prefilters a specular mip chain, each level convolved with the GGX distribution of
+// increasing roughness, and the pbr fragment shader, compiled with VSG_IMAGE_BASED_LIGHTING, adds the diffuse and
+// specular environment light to each fragment. The results are cached in cacheDirectory keyed by a hash of the cube
+// map's contents and the prefilter settings, so later runs with the same environment skip the compute pass.
+// The environment data is bound as descriptor set 4, after the clustered lighting set 2 and shadow atlas set 3.
+//
+// Usage:
+//   1. assignShaderSets(options) before creating or loading the scene so it's built with the image based lighting ShaderSet,
+//   2. generate() once the Window has a Device, which reads the cache or runs the compute pass,
+//   3. assign() the environment descriptor set to the scene,
+//   4. update() with the View's Camera every frame before Viewer::update().
+class EnvironmentMaps : public vsg::Inherit<vsg::Object, EnvironmentMaps>
+{
+public:
+    static constexpr uint32_t environmentDescriptorSet = 4;
+
+    EnvironmentMaps(vsg::ref_ptr<vsg::Data> in_environment, uint32_t in_prefilteredSize = 128, uint32_t in_numLevels = 6);
+
+    vsg::ref_ptr<vsg::Data> environment;
+    const uint32_t prefilteredSize;
+    const uint32_t numLevels; // prefiltered levels, from roughness 0 at level 0 to roughness 1 at the last level
+
+    uint32_t irradianceSampleSize = 64;
+    uint32_t numPrefilterSamples = 512;
+    float intensity = 1.0f;
+
+    // transform of the skybox, directions in world coordinates are rotated by its inverse into the cube map's
+    vsg::dmat4 environmentMatrix;
+
+    // results of generate() are read from and written to cacheDirectory when it's set
+    vsg::Path cacheDirectory;
+
+    vsg::ref_ptr<vsg::DescriptorSetLayout> descriptorSetLayout;
+
+    // replace the pbr ShaderSet in options with an image based lighting one, returns false if the standard shader isn't found
+    bool assignShaderSets(vsg::ref_ptr<vsg::Options> options);
+
+    // read the irradiance and prefiltered maps from the cache or compute them on the window's device, returns false on failure
+    bool generate(vsg::ref_ptr<vsg::Window> window, vsg::ref_ptr<const vsg::Options> options);
+
+    // bind the environment descriptor set in each StateGroup with a pipeline built from the image based lighting ShaderSet
+    void assign(vsg::Node& scene);
+
+    // update the eye to environment rotation for the camera's view
+    void update(const vsg::Camera& camera);
+
+    vsg::ref_ptr<vsg::vec4Array3D> prefiltered() const { return _prefiltered; }
+
+    // statistics
+    bool cacheHit = false;
+    double generateTime = 0.0; // milliseconds
+
+    void report(std::ostream& out) const;
+
+protected:
+    vsg::ref_ptr<EnvironmentParamsValue> _params;
+    vsg::ref_ptr<vsg::vec4Array3D> _prefiltered;
+    vsg::ref_ptr<vsg::DescriptorSet> _descriptorSet;
+
+    uint64_t _hash() const;
+    vsg::Path _cacheFilename() const;
+    bool _readCache();
+    void _writeCache() const;
+    bool _compute(vsg::ref_ptr<vsg::Device> device, vsg::ref_ptr<const vsg::Options> options);
+    void _setIrradiance(const std::vector<vsg::dvec3>& coefficients);
+};
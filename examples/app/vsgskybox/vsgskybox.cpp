@@ -9,17 +9,12 @@
 #include <iostream>
 #include <thread>
 
+#include "EnvironmentMaps.h"
+#include "FrameTrace.h"
 #include "skybox.h"
 
-vsg::ref_ptr<vsg::Node> createSkybox(const vsg::Path& filename, vsg::ref_ptr<vsg::Options> options)
+vsg::ref_ptr<vsg::MatrixTransform> createSkybox(vsg::ref_ptr<vsg::Data> data)
 {
-    auto data = vsg::read_cast<vsg::Data>(filename, options);
-    if (!data)
-    {
-        std::cout << "Error: failed to load cubemap file : " << filename << std::endl;
-        return {};
-    }
-
     auto vertexShader = vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", skybox_vert);
     auto fragmentShader = vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", skybox_frag);
     const vsg::ShaderStages shaders{vertexShader, fragmentShader};
@@ -192,22 +187,51 @@ int main(int argc, char** argv)
     auto horizonMountainHeight = arguments.value(0.0, "--hmh");
     auto skyboxFilename = arguments.value(vsg::Path(), "--skybox");
     auto outputFilename = arguments.value(vsg::Path(), "-o");
+    bool imageBasedLighting = arguments.read("--ibl");
+    auto iblCacheDirectory = arguments.value(vsg::Path(), "--ibl-cache");
+    auto iblSize = arguments.value(128u, "--ibl-size");
+    auto iblLevels = arguments.value(6u, "--ibl-levels");
+    auto iblIntensity = arguments.value(1.0f, "--ibl-intensity");
+
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
+    if (frameTrace) frameTrace->addReaderWriter(*options);
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     auto group = vsg::Group::create();
 
+    vsg::ref_ptr<EnvironmentMaps> environmentMaps;
     if (skyboxFilename)
     {
-        if (auto node = createSkybox(skyboxFilename, options))
+        auto data = vsg::read_cast<vsg::Data>(skyboxFilename, options);
+        if (!data)
         {
-            group->addChild(node);
+            std::cout << "Error: failed to load cubemap file : " << skyboxFilename << std::endl;
+            return 1;
         }
-        else
+
+        auto skybox = createSkybox(data);
+        group->addChild(skybox);
+
+        if (imageBasedLighting)
         {
-            return 1;
+            // the models must be loaded with the image based lighting ShaderSet, so assign it before reading them
+            environmentMaps = EnvironmentMaps::create(data, iblSize, iblLevels);
+            environmentMaps->environmentMatrix = skybox->matrix;
+            environmentMaps->cacheDirectory = iblCacheDirectory;
+            environmentMaps->intensity = iblIntensity;
+            if (!environmentMaps->assignShaderSets(options))
+            {
+                std::cout << "Unable to load shaders/standard_pbr.frag, check VSG_FILE_PATH includes the vsgExamples/data directory." << std::endl;
+                return 1;
+            }
         }
     }
+    else if (imageBasedLighting)
+    {
+        std::cout << "--ibl requires a --skybox cube map." << std::endl;
+        return 1;
+    }
 
     vsg::Path path;
 
@@ -287,24 +311,49 @@ int main(int argc, char** argv)
     viewer->addEventHandler(vsg::CloseHandler::create(viewer));
     viewer->addEventHandler(vsg::Trackball::create(camera));
 
+    if (environmentMaps)
+    {
+        if (!environmentMaps->generate(window, options)) return 1;
+        environmentMaps->assign(*vsg_scene);
+        environmentMaps->report(std::cout);
+    }
+
     auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
+    if (frameTrace) frameTrace->addTimestamps(*commandGraph);
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     // rendering main loop
     while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        if (environmentMaps) environmentMaps->update(*camera);
+
+        traceFrame.phase("update");
         viewer->update();
 
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        traceFrame.phase("present");
         viewer->present();
     }
 
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
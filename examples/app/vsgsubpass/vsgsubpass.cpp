@@ -12,12 +12,25 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 #include <vsg/all.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 
-vsg::ref_ptr<vsg::RenderPass> createRenderPass(vsg::Device* device)
+#include "FrameTrace.h"
+
+// G-buffer layout, the lighting subpass reads these back as input attachments
+const VkFormat albedoFormat = VK_FORMAT_R8G8B8A8_UNORM;
+const VkFormat normalFormat = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+const VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+const uint32_t gbufferBytesPerPixel = 4 + 4 + 4;
+const uint32_t maxLights = 256; // must match MAX_LIGHTS in deferred_lighting.frag and deferred_forward.frag
+
+vsg::ref_ptr<vsg::RenderPass> createDeferredRenderPass(vsg::Device* device, VkFormat imageFormat, bool transient)
 {
-    VkFormat imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
-    VkFormat depthFormat = VK_FORMAT_D24_UNORM_S8_UINT;
+    // when transient the G-buffer is cleared on load and discarded at the end of the render pass, so a tile based GPU
+    // can keep it in on-chip tile memory for both subpasses and never write it out to memory
+    VkAttachmentStoreOp gbufferStoreOp = transient ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
 
     // VkAttachmentDescriptiom
     // https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VkAttachmentDescription.html
@@ -32,315 +45,550 @@ vsg::ref_ptr<vsg::RenderPass> createRenderPass(vsg::Device* device)
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
-    vsg::AttachmentDescription depthAttachment = {};
+    vsg::AttachmentDescription albedoAttachment = colorAttachment;
+    albedoAttachment.format = albedoFormat;
+    albedoAttachment.storeOp = gbufferStoreOp;
+    albedoAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vsg::AttachmentDescription normalAttachment = albedoAttachment;
+    normalAttachment.format = normalFormat;
+
+    vsg::AttachmentDescription depthAttachment = albedoAttachment;
     depthAttachment.format = depthFormat;
-    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
-    vsg::RenderPass::Attachments attachments{colorAttachment, depthAttachment};
+    vsg::RenderPass::Attachments attachments{colorAttachment, albedoAttachment, normalAttachment, depthAttachment};
 
     // VkSubpassDescription
     // https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VkSubpassDescription.html
 
-    vsg::AttachmentReference colorAttachmentRef = {};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    vsg::AttachmentReference depthAttachmentRef = {};
-    depthAttachmentRef.attachment = 1;
-    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    // subpass 0 writes the G-buffer
+    vsg::SubpassDescription gbuffer_subpass;
+    gbuffer_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    gbuffer_subpass.colorAttachments.push_back({1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT});
+    gbuffer_subpass.colorAttachments.push_back({2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT});
+    gbuffer_subpass.depthStencilAttachments.push_back({3, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT});
 
-    vsg::SubpassDescription depth_subpass;
-    depth_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    depth_subpass.colorAttachments.emplace_back(colorAttachmentRef);
-    depth_subpass.depthStencilAttachments.emplace_back(depthAttachmentRef);
+    // subpass 1 reads the G-buffer at the current pixel and writes the lit result to the swapchain image
+    vsg::SubpassDescription lighting_subpass;
+    lighting_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    lighting_subpass.inputAttachments.push_back({1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT});
+    lighting_subpass.inputAttachments.push_back({2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT});
+    lighting_subpass.inputAttachments.push_back({3, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT});
+    lighting_subpass.colorAttachments.push_back({0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT});
 
-    vsg::SubpassDescription classic_subpass;
-    classic_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    classic_subpass.colorAttachments.emplace_back(colorAttachmentRef);
-
-    vsg::RenderPass::Subpasses subpasses{depth_subpass, classic_subpass};
+    vsg::RenderPass::Subpasses subpasses{gbuffer_subpass, lighting_subpass};
 
     // VkSubpassDependency
     // https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VkSubpassDependency.html
 
-    vsg::SubpassDependency classic_dependency = {};
-    classic_dependency.srcSubpass = 0;
-    classic_dependency.dstSubpass = 1;
-    classic_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    classic_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    classic_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
-    classic_dependency.dstAccessMask = 0;
-    classic_dependency.dependencyFlags = 0;
-
-    vsg::RenderPass::Dependencies dependencies{classic_dependency};
+    // the G-buffer is shared by all frames in flight, so wait for the previous frame to finish with it
+    vsg::SubpassDependency gbuffer_dependency = {};
+    gbuffer_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    gbuffer_dependency.dstSubpass = 0;
+    gbuffer_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    gbuffer_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    gbuffer_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    gbuffer_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    gbuffer_dependency.dependencyFlags = 0;
+
+    // the swapchain image is first used by the lighting subpass
+    vsg::SubpassDependency color_dependency = {};
+    color_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    color_dependency.dstSubpass = 1;
+    color_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    color_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    color_dependency.srcAccessMask = 0;
+    color_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    color_dependency.dependencyFlags = 0;
+
+    // by region so each tile's lighting only waits for the same tile's G-buffer writes
+    vsg::SubpassDependency lighting_dependency = {};
+    lighting_dependency.srcSubpass = 0;
+    lighting_dependency.dstSubpass = 1;
+    lighting_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    lighting_dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    lighting_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    lighting_dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    lighting_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    vsg::RenderPass::Dependencies dependencies{gbuffer_dependency, color_dependency, lighting_dependency};
 
     return vsg::RenderPass::create(device, attachments, subpasses, dependencies);
 }
 
-int main(int argc, char** argv)
+// create an attachment image and view, transient attachments are backed by lazily allocated memory where the device
+// provides it so on tile based GPUs no memory is committed for them at all
+vsg::ref_ptr<vsg::ImageView> createAttachment(vsg::Device* device, const VkExtent2D& extent, VkFormat format, VkImageUsageFlags usage, bool transient, bool& lazilyAllocated)
 {
-    // set up defaults and read command line arguments to override them
-    vsg::CommandLine arguments(&argc, argv);
-    auto debugLayer = arguments.read({"--debug", "-d"});
-    auto apiDumpLayer = arguments.read({"--api", "-a"});
-    auto [width, height] = arguments.value(std::pair<uint32_t, uint32_t>(800, 600), {"--window", "-w"});
-    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
-
-    // set up search paths to SPIRV shaders and textures
-    vsg::Paths searchPaths = vsg::getEnvPaths("VSG_FILE_PATH");
-
-    // load shaders
-    auto vertexShader = vsg::ShaderStage::read(VK_SHADER_STAGE_VERTEX_BIT, "main", vsg::findFile("shaders/vert_PushConstants.spv", searchPaths));
-    auto fragmentShader = vsg::ShaderStage::read(VK_SHADER_STAGE_FRAGMENT_BIT, "main", vsg::findFile("shaders/frag_PushConstants.spv", searchPaths));
-    if (!vertexShader || !fragmentShader)
+    auto image = vsg::Image::create();
+    image->imageType = VK_IMAGE_TYPE_2D;
+    image->format = format;
+    image->extent = VkExtent3D{extent.width, extent.height, 1};
+    image->mipLevels = 1;
+    image->arrayLayers = 1;
+    image->samples = VK_SAMPLE_COUNT_1_BIT;
+    image->tiling = VK_IMAGE_TILING_OPTIMAL;
+    image->usage = usage | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | (transient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+    image->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image->flags = 0;
+    image->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image->compile(device);
+
+    lazilyAllocated = false;
+    if (transient)
     {
-        std::cout << "Could not create shaders." << std::endl;
-        return 1;
-    }
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(device->getPhysicalDevice()->vk(), &memoryProperties);
 
-    // read texture image
-    vsg::Path textureFile("textures/lz.vsgb");
-    auto textureData = vsg::read_cast<vsg::Data>(vsg::findFile(textureFile, searchPaths));
-    if (!textureData)
-    {
-        std::cout << "Could not read texture file : " << textureFile << std::endl;
-        return 1;
+        auto requirements = image->getMemoryRequirements(device->deviceID);
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+        {
+            if ((requirements.memoryTypeBits & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) lazilyAllocated = true;
+        }
     }
 
-    vsg::DescriptorSetLayoutBindings descriptorBindings{
-        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr} // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
-    };
+    VkMemoryPropertyFlags memoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if (lazilyAllocated) memoryFlags |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    image->allocateAndBindMemory(device, memoryFlags);
 
-    auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+    auto imageView = vsg::ImageView::create(image, vsg::computeAspectFlagsForFormat(format));
+    imageView->compile(device);
+    return imageView;
+}
 
-    vsg::ref_ptr<vsg::GraphicsPipeline> graphicsPipelinepass1;
+// the G-buffer attachments, shared by all frames, and a Framebuffer per swapchain image pairing them with the window's color image
+struct DeferredTargets : public vsg::Inherit<vsg::Object, DeferredTargets>
+{
+    DeferredTargets(vsg::Window* window, vsg::ref_ptr<vsg::RenderPass> renderPass, bool transient) :
+        extent(window->extent2D())
     {
-        // set up graphics pipeline
-        vsg::PushConstantRanges pushConstantRanges{
-            {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection view, and model matrices, actual push constant calls automatically provided by the VSG's DispatchTraversal
-        };
-
-        vsg::VertexInputState::Bindings vertexBindingsDescriptions{
-            VkVertexInputBindingDescription{0, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX}, // vertex data
-            VkVertexInputBindingDescription{1, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX}, // colour data
-            VkVertexInputBindingDescription{2, sizeof(vsg::vec2), VK_VERTEX_INPUT_RATE_VERTEX}  // tex coord data
-        };
+        auto device = window->getOrCreateDevice();
 
-        vsg::VertexInputState::Attributes vertexAttributeDescriptions{
-            VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0}, // vertex data
-            VkVertexInputAttributeDescription{1, 1, VK_FORMAT_R32G32B32_SFLOAT, 0}, // colour data
-            VkVertexInputAttributeDescription{2, 2, VK_FORMAT_R32G32_SFLOAT, 0},    // tex coord data
-        };
+        bool lazyAlbedo, lazyNormal, lazyDepth;
+        albedo = createAttachment(device, extent, albedoFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, transient, lazyAlbedo);
+        normal = createAttachment(device, extent, normalFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, transient, lazyNormal);
+        depth = createAttachment(device, extent, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, transient, lazyDepth);
+        lazilyAllocated = lazyAlbedo && lazyNormal && lazyDepth;
 
-        vsg::GraphicsPipelineStates pipelineStates{
-            vsg::VertexInputState::create(vertexBindingsDescriptions, vertexAttributeDescriptions),
-            vsg::InputAssemblyState::create(),
-            vsg::RasterizationState::create(),
-            vsg::MultisampleState::create(),
-            vsg::ColorBlendState::create(),
-            vsg::DepthStencilState::create()};
-
-        auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, pushConstantRanges);
-        graphicsPipelinepass1 = vsg::GraphicsPipeline::create(pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
+        for (size_t i = 0; i < window->numFrames(); ++i)
+        {
+            framebuffers.push_back(vsg::Framebuffer::create(renderPass, vsg::ImageViews{window->imageView(i), albedo, normal, depth}, extent.width, extent.height, 1));
+        }
     }
 
-    vsg::ref_ptr<vsg::GraphicsPipeline> graphicsPipelinepass2;
+    // input attachment descriptors for deferred_lighting.frag's bindings 1 to 3
+    vsg::Descriptors inputAttachments() const
     {
-        // set up graphics pipeline
-        vsg::PushConstantRanges pushConstantRanges{
-            {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection view, and model matrices, actual push constant calls automatically provided by the VSG's DispatchTraversal
-        };
+        return vsg::Descriptors{
+            vsg::DescriptorImage::create(vsg::ImageInfo::create(vsg::ref_ptr<vsg::Sampler>(), albedo, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), 1, 0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT),
+            vsg::DescriptorImage::create(vsg::ImageInfo::create(vsg::ref_ptr<vsg::Sampler>(), normal, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), 2, 0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT),
+            vsg::DescriptorImage::create(vsg::ImageInfo::create(vsg::ref_ptr<vsg::Sampler>(), depth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL), 3, 0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT)};
+    }
 
-        vsg::VertexInputState::Bindings vertexBindingsDescriptions{
-            VkVertexInputBindingDescription{0, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX}, // vertex data
-            VkVertexInputBindingDescription{1, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX}, // colour data
-            VkVertexInputBindingDescription{2, sizeof(vsg::vec2), VK_VERTEX_INPUT_RATE_VERTEX}  // tex coord data
-        };
+    VkExtent2D extent;
+    vsg::ref_ptr<vsg::ImageView> albedo;
+    vsg::ref_ptr<vsg::ImageView> normal;
+    vsg::ref_ptr<vsg::ImageView> depth;
+    std::vector<vsg::ref_ptr<vsg::Framebuffer>> framebuffers;
+    bool lazilyAllocated = false;
+};
 
-        vsg::VertexInputState::Attributes vertexAttributeDescriptions{
-            VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0}, // vertex data
-            VkVertexInputAttributeDescription{1, 1, VK_FORMAT_R32G32B32_SFLOAT, 0}, // colour data
-            VkVertexInputAttributeDescription{2, 2, VK_FORMAT_R32G32_SFLOAT, 0},    // tex coord data
-        };
+// ground plane with a grid of boxes on it, enough overdraw and surfaces for the lights to make the deferred/forward comparison meaningful
+vsg::ref_ptr<vsg::Node> createScene(uint32_t gridSize)
+{
+    std::vector<vsg::vec3> vertices;
+    std::vector<vsg::vec3> normals;
+    std::vector<vsg::vec2> texcoords;
+    std::vector<uint32_t> indices;
+
+    auto addQuad = [&](const vsg::vec3& origin, const vsg::vec3& u, const vsg::vec3& v, float texScale) {
+        auto base = static_cast<uint32_t>(vertices.size());
+        auto normal = vsg::normalize(vsg::cross(u, v));
+        vertices.insert(vertices.end(), {origin, origin + u, origin + u + v, origin + v});
+        normals.insert(normals.end(), {normal, normal, normal, normal});
+        texcoords.insert(texcoords.end(), {{0.0f, 0.0f}, {texScale, 0.0f}, {texScale, texScale}, {0.0f, texScale}});
+        indices.insert(indices.end(), {base, base + 1, base + 2, base + 2, base + 3, base});
+    };
 
-        vsg::GraphicsPipelineStates pipelineStates{
-            vsg::VertexInputState::create(vertexBindingsDescriptions, vertexAttributeDescriptions),
-            vsg::InputAssemblyState::create(),
-            vsg::RasterizationState::create(),
-            vsg::MultisampleState::create(),
-            vsg::ColorBlendState::create(),
-            vsg::DepthStencilState::create()};
+    float extent = static_cast<float>(gridSize);
+    addQuad(vsg::vec3(0.0f, 0.0f, 0.0f), vsg::vec3(extent, 0.0f, 0.0f), vsg::vec3(0.0f, extent, 0.0f), extent * 0.25f);
 
-        auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, pushConstantRanges);
-        graphicsPipelinepass2 = vsg::GraphicsPipeline::create(pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates, 1);
+    for (uint32_t r = 0; r < gridSize; ++r)
+    {
+        for (uint32_t c = 0; c < gridSize; ++c)
+        {
+            float size = 0.5f;
+            float height = 0.5f + 1.5f * static_cast<float>((r * 7 + c * 13) % 5) / 4.0f;
+            vsg::vec3 min(static_cast<float>(c) + 0.25f, static_cast<float>(r) + 0.25f, 0.0f);
+            vsg::vec3 dx(size, 0.0f, 0.0f), dy(0.0f, size, 0.0f), dz(0.0f, 0.0f, height);
+
+            addQuad(min, dz, dx, 1.0f);           // -y
+            addQuad(min + dy + dx, dz, -dx, 1.0f); // +y
+            addQuad(min + dy, dz, -dy, 1.0f);      // -x
+            addQuad(min + dx, dz, dy, 1.0f);       // +x
+            addQuad(min + dz, dx, dy, 1.0f);       // +z
+        }
     }
 
-    auto bindGraphicsPipeline1 = vsg::BindGraphicsPipeline::create(graphicsPipelinepass1);
-    auto bindGraphicsPipeline2 = vsg::BindGraphicsPipeline::create(graphicsPipelinepass2);
+    auto vertexArray = vsg::vec3Array::create(static_cast<uint32_t>(vertices.size()), vertices.data());
+    auto normalArray = vsg::vec3Array::create(static_cast<uint32_t>(normals.size()), normals.data());
+    auto texcoordArray = vsg::vec2Array::create(static_cast<uint32_t>(texcoords.size()), texcoords.data());
+    auto indexArray = vsg::uintArray::create(static_cast<uint32_t>(indices.size()), indices.data());
+
+    auto drawCommands = vsg::VertexIndexDraw::create();
+    drawCommands->assignArrays(vsg::DataList{vertexArray, normalArray, texcoordArray});
+    drawCommands->assignIndices(indexArray);
+    drawCommands->indexCount = static_cast<uint32_t>(indexArray->size());
+    drawCommands->instanceCount = 1;
+    return drawCommands;
+}
 
-    // create texture image and associated DescriptorSets and binding
-    auto texture = vsg::DescriptorImage::create(vsg::Sampler::create(), textureData, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+// lights orbit the grid, positions are written in eye coordinates so neither lighting shader needs the view matrix
+void updateLights(vsg::vec4Array& lights, uint32_t numLights, uint32_t gridSize, double time, const vsg::dmat4& viewMatrix)
+{
+    lights[0].set(static_cast<float>(numLights), 0.05f, 0.05f, 0.05f);
 
-    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture});
-    auto bindDescriptorSets1 = vsg::BindDescriptorSets::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelinepass1->layout, 0, vsg::DescriptorSets{descriptorSet});
-    auto bindDescriptorSets2 = vsg::BindDescriptorSets::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelinepass2->layout, 0, vsg::DescriptorSets{descriptorSet});
+    double center = static_cast<double>(gridSize) * 0.5;
+    for (uint32_t i = 0; i < numLights; ++i)
+    {
+        double phase = static_cast<double>(i) * 2.399963; // golden angle spreads the lights over the grid
+        double radius = center * std::sqrt((static_cast<double>(i) + 0.5) / static_cast<double>(numLights));
+        double angle = phase + time * (0.2 + 0.1 * static_cast<double>(i % 3));
+        vsg::dvec3 position(center + radius * std::cos(angle), center + radius * std::sin(angle), 0.5 + 0.5 * static_cast<double>(i % 4));
 
-    // create StateGroup as the root of the scene/command graph to hold the GraphicsProgram, and binding of Descriptors to decorate the whole graph
-    auto scenegraph = vsg::StateGroup::create();
+        auto eye = viewMatrix * position;
+        float hue = static_cast<float>(i) / static_cast<float>(numLights) * 6.0f;
+        vsg::vec3 color(std::clamp(std::abs(hue - 3.0f) - 1.0f, 0.0f, 1.0f), std::clamp(2.0f - std::abs(hue - 2.0f), 0.0f, 1.0f), std::clamp(2.0f - std::abs(hue - 4.0f), 0.0f, 1.0f));
 
-    auto scenegraph1 = vsg::StateGroup::create();
-    scenegraph1->add(bindGraphicsPipeline1);
-    scenegraph1->add(bindDescriptorSets1);
+        lights[1 + i * 2].set(static_cast<float>(eye.x), static_cast<float>(eye.y), static_cast<float>(eye.z), 3.0f);
+        lights[2 + i * 2].set(color.r, color.g, color.b, 2.0f);
+    }
 
-    auto scenegraph2 = vsg::StateGroup::create();
-    scenegraph2->add(bindGraphicsPipeline2);
-    scenegraph2->add(bindDescriptorSets2);
+    lights.dirty();
+}
 
-    // set up model transformation node
-    auto transform = vsg::MatrixTransform::create(); // VK_SHADER_STAGE_VERTEX_BIT
+vsg::ref_ptr<vsg::GraphicsPipeline> createPipeline(vsg::ref_ptr<vsg::DescriptorSetLayout> descriptorSetLayout, const vsg::ShaderStages& shaders, const vsg::GraphicsPipelineStates& pipelineStates, uint32_t subpass)
+{
+    vsg::PushConstantRanges pushConstantRanges{
+        {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection view, and model matrices, actual push constant calls automatically provided by the VSG's DispatchTraversal
+    };
 
-    // set up vertex and index arrays
-    auto vertices = vsg::vec3Array::create(
-        {{-0.5f, -0.5f, 0.0f},
-         {0.5f, -0.5f, 0.05f},
-         {0.5f, 0.5f, 0.0f},
-         {-0.5f, 0.5f, 0.0f},
-         {-0.5f, -0.5f, -0.5f},
-         {0.5f, -0.5f, -0.5f},
-         {0.5f, 0.5f, -0.5},
-         {-0.5f, 0.5f, -0.5}}); // VK_FORMAT_R32G32B32_SFLOAT, VK_VERTEX_INPUT_RATE_INSTANCE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, pushConstantRanges);
+    return vsg::GraphicsPipeline::create(pipelineLayout, shaders, pipelineStates, subpass);
+}
 
-    auto colors = vsg::vec3Array::create(
-        {
-            {1.0f, 0.0f, 0.0f},
-            {0.0f, 1.0f, 0.0f},
-            {0.0f, 0.0f, 1.0f},
-            {1.0f, 1.0f, 1.0f},
-            {1.0f, 0.0f, 0.0f},
-            {0.0f, 1.0f, 0.0f},
-            {0.0f, 0.0f, 1.0f},
-            {1.0f, 1.0f, 1.0f},
-        }); // VK_FORMAT_R32G32B32_SFLOAT, VK_VERTEX_INPUT_RATE_VERTEX, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE
-
-    auto texcoords = vsg::vec2Array::create(
-        {{0.0f, 0.0f},
-         {1.0f, 0.0f},
-         {1.0f, 1.0f},
-         {0.0f, 1.0f},
-         {0.0f, 0.0f},
-         {1.0f, 0.0f},
-         {1.0f, 1.0f},
-         {0.0f, 1.0f}}); // VK_FORMAT_R32G32_SFLOAT, VK_VERTEX_INPUT_RATE_VERTEX, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE
-
-    auto indices = vsg::ushortArray::create(
-        {0, 1, 2,
-         2, 3, 0,
-         4, 5, 6,
-         6, 7, 4}); // VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE
-    // set up vertex and index arrays
-    auto vertices2 = vsg::vec3Array::create(
-        {{-0.5f, -0.5f, -0.00f},
-         {0.5f, -0.5f, -0.00},
-         {0.5f, 0.5f, -0.00f}
-
-        }); // VK_FORMAT_R32G32B32_SFLOAT, VK_VERTEX_INPUT_RATE_INSTANCE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE
-
-    auto colors2 = vsg::vec3Array::create(
-        {
-            {1.0f, 0.0f, 0.0f},
-            {0.0f, 1.0f, 0.0f},
-            {1.0f, 1.0f, 1.0f},
-        }); // VK_FORMAT_R32G32B32_SFLOAT, VK_VERTEX_INPUT_RATE_VERTEX, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE
+int main(int argc, char** argv)
+{
+    // set up defaults and read command line arguments to override them
+    vsg::CommandLine arguments(&argc, argv);
+    auto debugLayer = arguments.read({"--debug", "-d"});
+    auto apiDumpLayer = arguments.read({"--api", "-a"});
+    auto [width, height] = arguments.value(std::pair<uint32_t, uint32_t>(800, 600), {"--window", "-w"});
 
-    auto texcoords2 = vsg::vec2Array::create(
-        {
-            {0.0f, 0.0f},
-            {1.0f, 0.0f},
-            {1.0f, 1.0f},
-        }); // VK_FORMAT_R32G32_SFLOAT, VK_VERTEX_INPUT_RATE_VERTEX, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE
+    // deferred shading in two subpasses by default, --forward shades every light in the geometry pass instead for comparison
+    // and --store-gbuffer writes the G-buffer out to memory as a renderer without subpasses would have to
+    auto forward = arguments.read("--forward");
+    auto storeGBuffer = arguments.read("--store-gbuffer");
+    auto numLights = std::min(arguments.value<uint32_t>(64, "--lights"), maxLights);
+    auto gridSize = arguments.value<uint32_t>(16, "--grid");
+    auto numFrames = arguments.value(-1, "-f");
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
 
-    auto indices2 = vsg::ushortArray::create(
-        {0, 1, 2}); // VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
-    // setup geometry
-    auto drawCommandspass1 = vsg::Commands::create();
+    // set up search paths to SPIRV shaders and textures
+    auto options = vsg::Options::create();
+    if (frameTrace) frameTrace->addReaderWriter(*options);
+    options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
 
-    drawCommandspass1->addChild(vsg::BindVertexBuffers::create(0, vsg::DataList{vertices, colors, texcoords}));
-    drawCommandspass1->addChild(vsg::BindIndexBuffer::create(indices));
-    drawCommandspass1->addChild(vsg::DrawIndexed::create(12, 1, 0, 0, 0));
+    // load shaders
+    auto gbufferVertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/deferred_gbuffer.vert", options);
+    auto gbufferFragmentShader = vsg::read_cast<vsg::ShaderStage>("shaders/deferred_gbuffer.frag", options);
+    auto lightingVertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/deferred_lighting.vert", options);
+    auto lightingFragmentShader = vsg::read_cast<vsg::ShaderStage>("shaders/deferred_lighting.frag", options);
+    auto forwardFragmentShader = vsg::read_cast<vsg::ShaderStage>("shaders/deferred_forward.frag", options);
+    if (!gbufferVertexShader || !gbufferFragmentShader || !lightingVertexShader || !lightingFragmentShader || !forwardFragmentShader)
+    {
+        std::cout << "Could not create shaders." << std::endl;
+        return 1;
+    }
 
-    scenegraph1->addChild(transform);
-    transform->addChild(drawCommandspass1);
+    // read texture image
+    vsg::Path textureFile("textures/lz.vsgb");
+    auto textureData = vsg::read_cast<vsg::Data>(textureFile, options);
+    if (!textureData)
+    {
+        std::cout << "Could not read texture file : " << textureFile << std::endl;
+        return 1;
+    }
 
-    auto drawCommandspass2 = vsg::Commands::create();
-    drawCommandspass2->addChild(vsg::BindVertexBuffers::create(0, vsg::DataList{vertices2, colors2, texcoords2}));
-    drawCommandspass2->addChild(vsg::BindIndexBuffer::create(indices2));
-    drawCommandspass2->addChild(vsg::DrawIndexed::create(3, 1, 0, 0, 0));
-    // add drawCommands to transform
+    auto sampler = vsg::Sampler::create();
+    sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    auto texture = vsg::DescriptorImage::create(sampler, textureData, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 
-    scenegraph2->addChild(drawCommandspass2);
+    auto lights = vsg::vec4Array::create(1 + maxLights * 2);
+    lights->properties.dataVariance = vsg::DYNAMIC_DATA;
 
     // create the viewer and assign window(s) to it
     auto viewer = vsg::Viewer::create();
 
     auto traits = vsg::WindowTraits::create();
-    traits->windowTitle = "vsgsubpass - RenderPass setup + Subpass handling";
+    traits->windowTitle = forward ? "vsgsubpass - forward shading" : "vsgsubpass - deferred shading in subpasses";
     traits->width = width;
     traits->height = height;
-    //traits->shareWindow = shareWindow;
     traits->debugLayer = debugLayer;
     traits->apiDumpLayer = apiDumpLayer;
 
-    auto window = vsg::Window::create(traits); // width, height, debugLayer, apiDumpLayer));
-    viewer->addWindow(window);
+    auto window = vsg::Window::create(traits);
+    if (!window)
+    {
+        std::cout << "Could not create windows." << std::endl;
+        return 1;
+    }
 
-    // provide a custom RenderPass
-    window->setRenderPass(createRenderPass(window->getOrCreateDevice()));
+    viewer->addWindow(window);
 
     // camera related details
-    auto viewport = vsg::ViewportState::create(VkExtent2D{width, height});
-    auto perspective = vsg::Perspective::create(60.0, static_cast<double>(width) / static_cast<double>(height), 0.1, 10.0);
-    auto lookAt = vsg::LookAt::create(vsg::dvec3(1.0, 1.0, 1.0), vsg::dvec3(0.0, 0.0, 0.0), vsg::dvec3(0.0, 0.0, 1.0));
+    double center = static_cast<double>(gridSize) * 0.5;
+    auto viewport = vsg::ViewportState::create(window->extent2D());
+    auto perspective = vsg::Perspective::create(60.0, static_cast<double>(window->extent2D().width) / static_cast<double>(window->extent2D().height), 0.1, center * 8.0);
+    auto lookAt = vsg::LookAt::create(vsg::dvec3(center, -center, center * 1.5), vsg::dvec3(center, center, 0.0), vsg::dvec3(0.0, 0.0, 1.0));
     auto camera = vsg::Camera::create(perspective, lookAt, viewport);
 
-    scenegraph->addChild(scenegraph1);
+    auto geometry = createScene(gridSize);
+
+    vsg::ref_ptr<vsg::CommandGraph> commandGraph;
+    vsg::ref_ptr<vsg::RenderGraph> renderGraph;
+    vsg::ref_ptr<DeferredTargets> targets;
+    vsg::ref_ptr<vsg::RenderPass> renderPass;
+    vsg::ref_ptr<vsg::StateGroup> lightingStateGroup;
+    vsg::ref_ptr<vsg::DescriptorSetLayout> lightingDescriptorSetLayout;
+    vsg::ref_ptr<vsg::GraphicsPipeline> lightingPipeline;
+    auto lightsDescriptor = vsg::DescriptorBuffer::create(lights, forward ? 1 : 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+
+    vsg::VertexInputState::Bindings vertexBindingsDescriptions{
+        VkVertexInputBindingDescription{0, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX}, // vertex data
+        VkVertexInputBindingDescription{1, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX}, // normal data
+        VkVertexInputBindingDescription{2, sizeof(vsg::vec2), VK_VERTEX_INPUT_RATE_VERTEX}  // tex coord data
+    };
 
-    scenegraph->addChild(vsg::NextSubPass::create(VK_SUBPASS_CONTENTS_INLINE));
+    vsg::VertexInputState::Attributes vertexAttributeDescriptions{
+        VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0}, // vertex data
+        VkVertexInputAttributeDescription{1, 1, VK_FORMAT_R32G32B32_SFLOAT, 0}, // normal data
+        VkVertexInputAttributeDescription{2, 2, VK_FORMAT_R32G32_SFLOAT, 0},    // tex coord data
+    };
 
-    scenegraph->addChild(scenegraph2);
+    if (forward)
+    {
+        vsg::DescriptorSetLayoutBindings descriptorBindings{
+            {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}, // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
+            {1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}          // Lights
+        };
+        auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+
+        vsg::GraphicsPipelineStates pipelineStates{
+            vsg::VertexInputState::create(vertexBindingsDescriptions, vertexAttributeDescriptions),
+            vsg::InputAssemblyState::create(),
+            vsg::RasterizationState::create(),
+            vsg::MultisampleState::create(),
+            vsg::ColorBlendState::create(),
+            vsg::DepthStencilState::create()};
+
+        auto pipeline = createPipeline(descriptorSetLayout, vsg::ShaderStages{gbufferVertexShader, forwardFragmentShader}, pipelineStates, 0);
+        auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture, lightsDescriptor});
+
+        auto scenegraph = vsg::StateGroup::create();
+        scenegraph->add(vsg::BindGraphicsPipeline::create(pipeline));
+        scenegraph->add(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, descriptorSet));
+        scenegraph->addChild(geometry);
+
+        commandGraph = vsg::createCommandGraphForView(window, camera, scenegraph);
+    }
+    else
+    {
+        auto device = window->getOrCreateDevice();
+        renderPass = createDeferredRenderPass(device, window->surfaceFormat().format, !storeGBuffer);
+        targets = DeferredTargets::create(window, renderPass, !storeGBuffer);
+
+        // subpass 0 : rasterize the scene into the G-buffer
+        vsg::ref_ptr<vsg::StateGroup> gbufferStateGroup = vsg::StateGroup::create();
+        {
+            vsg::DescriptorSetLayoutBindings descriptorBindings{
+                {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr} // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
+            };
+            auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+
+            VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+            colorBlendAttachment.blendEnable = VK_FALSE;
+            colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+            auto colorBlendState = vsg::ColorBlendState::create();
+            colorBlendState->attachments = vsg::ColorBlendState::ColorBlendAttachments{colorBlendAttachment, colorBlendAttachment};
+
+            vsg::GraphicsPipelineStates pipelineStates{
+                vsg::VertexInputState::create(vertexBindingsDescriptions, vertexAttributeDescriptions),
+                vsg::InputAssemblyState::create(),
+                vsg::RasterizationState::create(),
+                vsg::MultisampleState::create(),
+                colorBlendState,
+                vsg::DepthStencilState::create()};
+
+            auto pipeline = createPipeline(descriptorSetLayout, vsg::ShaderStages{gbufferVertexShader, gbufferFragmentShader}, pipelineStates, 0);
+            auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture});
+
+            gbufferStateGroup->add(vsg::BindGraphicsPipeline::create(pipeline));
+            gbufferStateGroup->add(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, descriptorSet));
+            gbufferStateGroup->addChild(geometry);
+        }
+
+        // subpass 1 : a full screen triangle shades each pixel once from the G-buffer input attachments
+        lightingStateGroup = vsg::StateGroup::create();
+        {
+            vsg::DescriptorSetLayoutBindings descriptorBindings{
+                {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr},   // Lights
+                {1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}, // albedo
+                {2, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}, // normal
+                {3, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}  // depth
+            };
+            lightingDescriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+
+            auto rasterizationState = vsg::RasterizationState::create();
+            rasterizationState->cullMode = VK_CULL_MODE_NONE;
+
+            auto depthStencilState = vsg::DepthStencilState::create();
+            depthStencilState->depthTestEnable = VK_FALSE;
+            depthStencilState->depthWriteEnable = VK_FALSE;
+
+            vsg::GraphicsPipelineStates pipelineStates{
+                vsg::VertexInputState::create(),
+                vsg::InputAssemblyState::create(),
+                rasterizationState,
+                vsg::MultisampleState::create(),
+                vsg::ColorBlendState::create(),
+                depthStencilState};
+
+            lightingPipeline = createPipeline(lightingDescriptorSetLayout, vsg::ShaderStages{lightingVertexShader, lightingFragmentShader}, pipelineStates, 1);
+
+            auto descriptors = targets->inputAttachments();
+            descriptors.insert(descriptors.begin(), lightsDescriptor);
+            auto descriptorSet = vsg::DescriptorSet::create(lightingDescriptorSetLayout, descriptors);
+
+            lightingStateGroup->add(vsg::BindGraphicsPipeline::create(lightingPipeline));
+            lightingStateGroup->add(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline->layout, 0, descriptorSet));
+            lightingStateGroup->addChild(vsg::Draw::create(3, 1, 0, 0));
+        }
+
+        auto scenegraph = vsg::Group::create();
+        scenegraph->addChild(gbufferStateGroup);
+        scenegraph->addChild(vsg::NextSubPass::create(VK_SUBPASS_CONTENTS_INLINE));
+        scenegraph->addChild(lightingStateGroup);
+
+        // the window's own framebuffers only hold its color and depth images, so render through our own Framebuffers,
+        // selecting the one for the acquired swapchain image each frame
+        renderGraph = vsg::RenderGraph::create();
+        renderGraph->framebuffer = targets->framebuffers[0];
+        renderGraph->renderArea.offset = {0, 0};
+        renderGraph->renderArea.extent = targets->extent;
+        renderGraph->clearValues.resize(4);
+        renderGraph->clearValues[0].color = {{0.2f, 0.2f, 0.4f, 1.0f}};
+        renderGraph->clearValues[1].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+        renderGraph->clearValues[2].color = {{0.5f, 0.5f, 0.5f, 0.0f}};
+        renderGraph->clearValues[3].depthStencil = {0.0f, 0};
+        renderGraph->addChild(vsg::View::create(camera, scenegraph));
+
+        commandGraph = vsg::CommandGraph::create(window);
+        commandGraph->addChild(renderGraph);
+    }
+
+    if (frameTrace) frameTrace->addTimestamps(*commandGraph);
 
-    auto commandGraph = vsg::createCommandGraphForView(window, camera, scenegraph);
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     // compile the Vulkan objects
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     // assign a CloseHandler to the Viewer to respond to pressing Escape or press the window close button
     viewer->addEventHandlers({vsg::CloseHandler::create(viewer)});
+    viewer->addEventHandler(vsg::Trackball::create(camera));
 
     // main frame loop
-    while (viewer->advanceToNextFrame())
+    while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
-        // animate the transform
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(viewer->getFrameStamp()->time - viewer->start_point()).count();
-        transform->matrix = vsg::rotate(time * vsg::radians(90.0f), vsg::vec3(0.0f, 0.0, 1.0f));
+        if (targets)
+        {
+            auto extent = window->extent2D();
+            if (extent.width != targets->extent.width || extent.height != targets->extent.height)
+            {
+                // the swapchain has been rebuilt so rebuild the G-buffer to match, and point the lighting subpass at it
+                viewer->deviceWaitIdle();
+
+                targets = DeferredTargets::create(window, renderPass, !storeGBuffer);
+                renderGraph->renderArea.extent = targets->extent;
 
+                // our RenderGraph isn't associated with the window so the WindowResizeHandler won't update the camera, do it here
+                viewport->set(0, 0, targets->extent.width, targets->extent.height);
+                perspective->aspectRatio = static_cast<double>(targets->extent.width) / static_cast<double>(targets->extent.height);
+
+                auto descriptors = targets->inputAttachments();
+                descriptors.insert(descriptors.begin(), lightsDescriptor);
+                auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline->layout, 0, vsg::DescriptorSet::create(lightingDescriptorSetLayout, descriptors));
+                lightingStateGroup->stateCommands.back() = bindDescriptorSet;
+
+                auto result = viewer->compileManager->compile(bindDescriptorSet);
+                if (result) vsg::updateViewer(*viewer, result);
+            }
+
+            renderGraph->framebuffer = targets->framebuffers[window->imageIndex()];
+        }
+
+        double time = std::chrono::duration<double, std::chrono::seconds::period>(viewer->getFrameStamp()->time - viewer->start_point()).count();
+        updateLights(*lights, numLights, gridSize, time, lookAt->transform());
+
+        traceFrame.phase("update");
         viewer->update();
 
+        traceFrame.phase("record and submit");
         viewer->recordAndSubmit();
 
+        traceFrame.phase("present");
         viewer->present();
     }
 
+    // report the frame rate along with the attachment traffic to and from memory a tile based GPU would need per frame,
+    // use the GPU vendor's profiling tools to measure the actual bandwidth
+    auto fs = viewer->getFrameStamp();
+    double fps = static_cast<double>(fs->frameCount) / std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - viewer->start_point()).count();
+    auto extent = window->extent2D();
+    double pixels = static_cast<double>(extent.width) * static_cast<double>(extent.height);
+    double colorBytes = pixels * 4.0;
+    double gbufferBytes = (!forward && storeGBuffer) ? pixels * static_cast<double>(gbufferBytesPerPixel) : 0.0;
+
+    std::cout << (forward ? "Forward" : "Deferred") << " shading of " << numLights << " lights" << std::endl;
+    std::cout << "    Average frame rate = " << fps << " fps" << std::endl;
+    std::cout << "    Attachment writes per frame = " << (colorBytes + gbufferBytes) / (1024.0 * 1024.0) << " MB";
+    if (gbufferBytes > 0.0)
+        std::cout << " including " << gbufferBytes / (1024.0 * 1024.0) << " MB of G-buffer";
+    else if (!forward)
+        std::cout << ", G-buffer kept on chip" << (targets->lazilyAllocated ? " in lazily allocated memory" : ", no lazily allocated memory type available");
+    std::cout << std::endl;
+
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -0,0 +1,320 @@
+#include "FrameGovernor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const char* upscale_vert = R"(
+#version 450
+layout(location = 0) out vec2 texCoord;
+out gl_PerVertex { vec4 gl_Position; };
+void main()
+{
+    // full screen triangle
+    texCoord = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(texCoord * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+    const char* upscale_frag = R"(
+#version 450
+layout(set = 0, binding = 0) uniform sampler2D scene;
+layout(set = 0, binding = 1) uniform TexCoordScale { vec2 texCoordScale; };
+layout(location = 0) in vec2 texCoord;
+layout(location = 0) out vec4 outColor;
+void main()
+{
+    // the scene only covers the top left part of the image given by the render area
+    outColor = texture(scene, texCoord * texCoordScale);
+}
+)";
+} // namespace
+
+FrameGovernor::FrameGovernor(double in_targetFrameTime, uint32_t in_numFramesInFlight, double in_timestampPeriod) :
+    targetFrameTime(in_targetFrameTime),
+    numFramesInFlight(std::max(in_numFramesInFlight, 1u)),
+    timestampPeriod(in_timestampPeriod),
+    _timestampQueries(TimestampQueries::create(numFramesInFlight, 2))
+{
+    _timestampQueries->collect = [this](uint32_t, uint64_t, const std::vector<uint64_t>& timestamps) { _collect(timestamps); };
+}
+
+void FrameGovernor::Timestamp::compile(vsg::Context& context)
+{
+    if (auto g = governor.ref_ptr(); g && begin) g->_timestampQueries->compile(context);
+}
+
+void FrameGovernor::Timestamp::record(vsg::CommandBuffer& commandBuffer) const
+{
+    if (auto g = governor.ref_ptr())
+    {
+        if (begin) g->_begin(commandBuffer);
+        else g->_end(commandBuffer);
+    }
+}
+
+void FrameGovernor::_begin(vsg::CommandBuffer& commandBuffer)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    _timestampQueries->beginFrame(commandBuffer);
+    _timestampQueries->write(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+}
+
+void FrameGovernor::_end(vsg::CommandBuffer& commandBuffer)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    _timestampQueries->write(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+}
+
+void FrameGovernor::_collect(const std::vector<uint64_t>& timestamps)
+{
+    if (timestamps.size() < 2) return;
+
+    double milliseconds = timestampPeriod * 1e-6 * static_cast<double>(timestamps[1] - timestamps[0]);
+    _gpuTime = (_numTimings == 0) ? milliseconds : (_gpuTime * 0.8 + milliseconds * 0.2);
+    ++_numTimings;
+
+    ++numFramesTimed;
+    if (milliseconds > targetFrameTime) ++numFramesOverTarget;
+    maxGpuTime = std::max(maxGpuTime, milliseconds);
+}
+
+double FrameGovernor::gpuTime() const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return _gpuTime;
+}
+
+vsg::ref_ptr<vsg::CommandGraph> FrameGovernor::createCommandGraph(vsg::ref_ptr<vsg::Window> window, vsg::ref_ptr<vsg::Camera> camera, vsg::ref_ptr<vsg::Node> scene)
+{
+    auto device = window->getOrCreateDevice();
+    auto context = vsg::Context::create(device);
+
+    _windowExtent = window->extent2D();
+    _imageExtent = VkExtent2D{static_cast<uint32_t>(std::ceil(static_cast<float>(_windowExtent.width) * maxScale)),
+                              static_cast<uint32_t>(std::ceil(static_cast<float>(_windowExtent.height) * maxScale))};
+    _scale = std::clamp(1.0f, minScale, maxScale);
+
+    auto createAttachment = [&](VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect) {
+        auto image = vsg::Image::create();
+        image->imageType = VK_IMAGE_TYPE_2D;
+        image->format = format;
+        image->extent = VkExtent3D{_imageExtent.width, _imageExtent.height, 1};
+        image->mipLevels = 1;
+        image->arrayLayers = 1;
+        image->samples = VK_SAMPLE_COUNT_1_BIT;
+        image->tiling = VK_IMAGE_TILING_OPTIMAL;
+        image->usage = usage;
+        image->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        return vsg::createImageView(*context, image, aspect);
+    };
+
+    VkFormat colorFormat = window->surfaceFormat().format;
+    VkFormat depthFormat = window->depthFormat();
+    auto colorImageView = createAttachment(colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+    auto depthImageView = createAttachment(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, vsg::computeAspectFlagsForFormat(depthFormat));
+
+    vsg::RenderPass::Attachments attachments(2);
+    attachments[0].format = colorFormat;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[1].format = depthFormat;
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    vsg::RenderPass::Subpasses subpasses(1);
+    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[0].colorAttachments.emplace_back(vsg::AttachmentReference{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+    subpasses[0].depthStencilAttachments.emplace_back(vsg::AttachmentReference{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL});
+
+    // wait for the previous frame's upscale to finish reading the image, and make this frame's rendering visible to the upscale
+    vsg::RenderPass::Dependencies dependencies(2);
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    auto renderPass = vsg::RenderPass::create(device, attachments, subpasses, dependencies);
+    auto framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{colorImageView, depthImageView}, _imageExtent.width, _imageExtent.height, 1);
+
+    VkExtent2D renderExtent{std::max(1u, static_cast<uint32_t>(static_cast<float>(_windowExtent.width) * _scale)),
+                            std::max(1u, static_cast<uint32_t>(static_cast<float>(_windowExtent.height) * _scale))};
+
+    _renderGraph = vsg::RenderGraph::create();
+    _renderGraph->renderArea.offset = VkOffset2D{0, 0};
+    _renderGraph->renderArea.extent = renderExtent;
+    _renderGraph->framebuffer = framebuffer;
+    _renderGraph->clearValues.resize(2);
+    _renderGraph->clearValues[0].color = window->clearColor();
+    _renderGraph->clearValues[1].depthStencil = VkClearDepthStencilValue{0.0f, 0};
+
+    // same projection and view matrices as camera, which keeps the full window extent for event handlers, but a scaled viewport
+    _renderCamera = vsg::Camera::create(camera->projectionMatrix, camera->viewMatrix, vsg::ViewportState::create(renderExtent));
+    _renderGraph->addChild(vsg::View::create(_renderCamera, scene));
+
+    auto sampler = vsg::Sampler::create();
+    sampler->magFilter = VK_FILTER_LINEAR;
+    sampler->minFilter = VK_FILTER_LINEAR;
+    sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    _texCoordScale = vsg::vec2Value::create(vsg::vec2(static_cast<float>(renderExtent.width) / static_cast<float>(_imageExtent.width),
+                                                      static_cast<float>(renderExtent.height) / static_cast<float>(_imageExtent.height)));
+    _texCoordScale->properties.dataVariance = vsg::DYNAMIC_DATA;
+
+    auto colorImage = vsg::ImageInfo::create(sampler, colorImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    auto upscaleCamera = vsg::Camera::create(vsg::Orthographic::create(), vsg::LookAt::create(), vsg::ViewportState::create(_windowExtent));
+
+    auto commandGraph = vsg::CommandGraph::create(window);
+    commandGraph->addChild(Timestamp::create(this, true));
+    commandGraph->addChild(_renderGraph);
+    commandGraph->addChild(vsg::createRenderGraphForView(window, upscaleCamera, _createUpscale(colorImage)));
+    commandGraph->addChild(Timestamp::create(this, false));
+    return commandGraph;
+}
+
+vsg::ref_ptr<vsg::Node> FrameGovernor::_createUpscale(vsg::ref_ptr<vsg::ImageInfo> colorImage)
+{
+    auto vertexShader = vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", upscale_vert);
+    auto fragmentShader = vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", upscale_frag);
+
+    vsg::DescriptorSetLayoutBindings descriptorBindings{
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr},
+        {1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}};
+    auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+
+    vsg::PushConstantRanges pushConstantRanges{
+        {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // not used by the shaders, but the View always pushes the projection and modelview matrices
+    };
+
+    auto rasterizationState = vsg::RasterizationState::create();
+    rasterizationState->cullMode = VK_CULL_MODE_NONE;
+
+    auto depthStencilState = vsg::DepthStencilState::create();
+    depthStencilState->depthTestEnable = VK_FALSE;
+    depthStencilState->depthWriteEnable = VK_FALSE;
+
+    vsg::GraphicsPipelineStates pipelineStates{
+        vsg::VertexInputState::create(),
+        vsg::InputAssemblyState::create(),
+        rasterizationState,
+        vsg::MultisampleState::create(),
+        vsg::ColorBlendState::create(),
+        depthStencilState};
+
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, pushConstantRanges);
+    auto graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
+
+    auto texture = vsg::DescriptorImage::create(colorImage, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    auto texCoordScale = vsg::DescriptorBuffer::create(_texCoordScale, 1, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture, texCoordScale});
+
+    auto upscale = vsg::StateGroup::create();
+    upscale->add(vsg::BindGraphicsPipeline::create(graphicsPipeline));
+    upscale->add(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, descriptorSet));
+    upscale->addChild(vsg::Draw::create(3, 1, 0, 0));
+    return upscale;
+}
+
+void FrameGovernor::update()
+{
+    ++_frameCount;
+    if (!_renderGraph) return;
+
+    double gpuTime = 0.0;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (_numTimings < numFramesInFlight) return;
+        gpuTime = _gpuTime;
+    }
+
+    uint64_t framesSinceChange = _frameCount - _lastChange;
+
+    // GPU time is taken as proportional to the number of pixels rendered, aiming a little under the target to leave headroom
+    float newScale = _scale;
+    if (gpuTime > targetFrameTime * 0.95 && framesSinceChange >= decreaseInterval)
+    {
+        newScale = _scale * static_cast<float>(std::sqrt(targetFrameTime * 0.85 / gpuTime));
+        newScale = std::floor(newScale / scaleStep) * scaleStep;
+        newScale = std::max(minScale, std::min(newScale, _scale - scaleStep));
+    }
+    else if (gpuTime < targetFrameTime * 0.75 && _scale < maxScale && framesSinceChange >= increaseInterval)
+    {
+        float larger = std::min(maxScale, _scale + scaleStep);
+        double ratio = static_cast<double>(larger) / static_cast<double>(_scale);
+        if (gpuTime * ratio * ratio < targetFrameTime * 0.85) newScale = larger;
+    }
+
+    if (newScale == _scale) return;
+
+    decisions.push_back(Decision{_frameCount, gpuTime, _scale, newScale});
+    _resize(newScale);
+    _lastChange = _frameCount;
+}
+
+void FrameGovernor::_resize(float newScale)
+{
+    auto renderPass = _renderGraph->getRenderPass();
+    if (!renderPass) return;
+
+    // wait until the device is idle to avoid changing state while it's being used.
+    vkDeviceWaitIdle(*(renderPass->device));
+
+    uint32_t width = std::max(1u, static_cast<uint32_t>(static_cast<float>(_windowExtent.width) * newScale));
+    uint32_t height = std::max(1u, static_cast<uint32_t>(static_cast<float>(_windowExtent.height) * newScale));
+
+    _renderGraph->renderArea.extent = VkExtent2D{width, height};
+    _renderCamera->viewportState->set(0, 0, width, height);
+
+    vsg::UpdateGraphicsPipelines updateGraphicsPipelines;
+    updateGraphicsPipelines.context = vsg::Context::create(renderPass->device);
+    updateGraphicsPipelines.context->renderPass = renderPass;
+    _renderGraph->accept(updateGraphicsPipelines);
+
+    _texCoordScale->value() = vsg::vec2(static_cast<float>(width) / static_cast<float>(_imageExtent.width), static_cast<float>(height) / static_cast<float>(_imageExtent.height));
+    _texCoordScale->dirty();
+
+    _scale = newScale;
+
+    // timings from before the change no longer apply, and after vkDeviceWaitIdle() all the pending results are available
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _timestampQueries->discardAll();
+    _numTimings = 0;
+}
+
+void FrameGovernor::report(std::ostream& out) const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    out << "FrameGovernor target = " << targetFrameTime << "ms, frames timed = " << numFramesTimed << ", over target = " << numFramesOverTarget
+        << ", max gpu time = " << maxGpuTime << "ms, final scale = " << _scale << ", scale changes = " << decisions.size() << std::endl;
+    for (auto& decision : decisions)
+    {
+        out << "    frame " << decision.frame << " gpu time " << decision.gpuTime << "ms, scale " << decision.previousScale << " -> " << decision.scale << std::endl;
+    }
+}
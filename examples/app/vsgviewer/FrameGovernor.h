@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "TimestampQueries.h"
+
+#include <mutex>
+#include <ostream>
+
+// Holds a target frame time by adjusting the resolution the scene is rendered at. The scene is rendered into an
+// offscreen colour/depth target sized for maxScale times the window's extent, using a render area of scale() times the
+// window's extent, and then upscaled into the window. The GPU time of each frame is measured with timestamps written at
+// the start and end of the command graph to TimestampQueries, which gives each frame in flight its own query pool, read
+// back when it's next reused so reading never stalls. update() reduces the scale quickly when the smoothed GPU time goes over the target
+// and raises it slowly when the larger area is predicted to fit, each change being recorded in decisions. The viewport
+// is baked into the scene's pipelines so changing the scale waits for the device and rebuilds them, the scale is
+// therefore quantized to scaleStep and rate limited.
+class FrameGovernor : public vsg::Inherit<vsg::Object, FrameGovernor>
+{
+public:
+    FrameGovernor(double in_targetFrameTime, uint32_t in_numFramesInFlight, double in_timestampPeriod);
+
+    double targetFrameTime; // milliseconds
+    const uint32_t numFramesInFlight;
+    const double timestampPeriod; // nanoseconds per timestamp tick
+
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float scaleStep = 0.05f;
+    uint32_t decreaseInterval = 5;  // minimum frames between reductions in scale
+    uint32_t increaseInterval = 60; // minimum frames between increases in scale
+
+    // create the command graph that renders scene through camera at the current scale then upscales it into window.
+    // The camera is still used with the window's full extent so it can be shared with event handlers such as Trackball.
+    vsg::ref_ptr<vsg::CommandGraph> createCommandGraph(vsg::ref_ptr<vsg::Window> window, vsg::ref_ptr<vsg::Camera> camera, vsg::ref_ptr<vsg::Node> scene);
+
+    // adjust the scale from the GPU timings, call between frames before recordAndSubmit()
+    void update();
+
+    float scale() const { return _scale; }
+    double gpuTime() const; // smoothed milliseconds per frame
+
+    struct Decision
+    {
+        uint64_t frame;
+        double gpuTime;
+        float previousScale;
+        float scale;
+    };
+
+    std::vector<Decision> decisions;
+
+    // statistics
+    uint64_t numFramesTimed = 0;
+    uint64_t numFramesOverTarget = 0;
+    double maxGpuTime = 0.0;
+
+    void report(std::ostream& out) const;
+
+    // Commands placed at the start and end of the command graph to write the frame's timestamps
+    class Timestamp : public vsg::Inherit<vsg::Command, Timestamp>
+    {
+    public:
+        Timestamp(FrameGovernor* in_governor, bool in_begin) :
+            governor(in_governor),
+            begin(in_begin) {}
+
+        vsg::observer_ptr<FrameGovernor> governor;
+        bool begin;
+
+        void compile(vsg::Context& context) override;
+        void record(vsg::CommandBuffer& commandBuffer) const override;
+    };
+
+protected:
+    void _begin(vsg::CommandBuffer& commandBuffer);
+    void _end(vsg::CommandBuffer& commandBuffer);
+    void _collect(const std::vector<uint64_t>& timestamps);
+    void _resize(float newScale);
+    vsg::ref_ptr<vsg::Node> _createUpscale(vsg::ref_ptr<vsg::ImageInfo> colorImage);
+
+    mutable std::mutex _mutex;
+    vsg::ref_ptr<TimestampQueries> _timestampQueries;
+    double _gpuTime = 0.0;
+    uint64_t _numTimings = 0;
+
+    VkExtent2D _windowExtent{0, 0};
+    VkExtent2D _imageExtent{0, 0};
+    vsg::ref_ptr<vsg::RenderGraph> _renderGraph;
+    vsg::ref_ptr<vsg::Camera> _renderCamera;
+    vsg::ref_ptr<vsg::vec2Value> _texCoordScale;
+
+    float _scale = 1.0f;
+    uint64_t _frameCount = 0;
+    uint64_t _lastChange = 0;
+};
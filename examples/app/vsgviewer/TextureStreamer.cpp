@@ -0,0 +1,332 @@
+#include "TextureStreamer.h"
+#include "ParallelTraversal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+namespace
+{
+    bool isPowerOfTwo(uint32_t value) { return value != 0 && (value & (value - 1)) == 0; }
+
+    // the frames in flight that may still be using a replaced descriptor set
+    constexpr uint64_t s_numFramesToRelease = 4;
+} // namespace
+
+// find the BindDescriptorSets with large RGBA8 textures, the StateGroups they are assigned to and the world bounds of the subgraphs using them
+class CollectStreamedSets : public vsg::Inherit<vsg::Visitor, CollectStreamedSets>
+{
+public:
+    explicit CollectStreamedSets(const TextureStreamer& in_streamer) :
+        streamer(in_streamer) {}
+
+    const TextureStreamer& streamer;
+    std::map<vsg::BindDescriptorSet*, vsg::ref_ptr<TextureStreamer::StreamedSet>> sets;
+    std::vector<vsg::dmat4> matrixStack{vsg::dmat4()};
+
+    void apply(vsg::Node& node) override
+    {
+        node.traverse(*this);
+    }
+
+    void apply(vsg::Transform& transform) override
+    {
+        matrixStack.push_back(transform.transform(matrixStack.back()));
+        transform.traverse(*this);
+        matrixStack.pop_back();
+    }
+
+    void apply(vsg::StateGroup& stateGroup) override
+    {
+        for (auto& stateCommand : stateGroup.stateCommands)
+        {
+            auto bind = stateCommand.cast<vsg::BindDescriptorSet>();
+            if (!bind || !bind->descriptorSet) continue;
+
+            auto& set = sets[bind.get()];
+            if (!set)
+            {
+                set = TextureStreamer::StreamedSet::create();
+                set->bind = bind;
+                auto& descriptors = bind->descriptorSet->descriptors;
+                for (size_t i = 0; i < descriptors.size(); ++i)
+                {
+                    TextureStreamer::StreamedImage image;
+                    if (createStreamedImage(descriptors[i], image))
+                    {
+                        image.descriptorIndex = i;
+                        set->images.push_back(std::move(image));
+                    }
+                }
+            }
+
+            if (set->images.empty()) continue;
+
+            if (std::find(set->parents.begin(), set->parents.end(), &stateGroup) == set->parents.end()) set->parents.push_back(&stateGroup);
+
+            vsg::ComputeBounds computeBounds;
+            stateGroup.accept(computeBounds);
+            if (computeBounds.bounds.valid())
+            {
+                auto& matrix = matrixStack.back();
+                vsg::dvec3 center = matrix * ((computeBounds.bounds.min + computeBounds.bounds.max) * 0.5);
+                double scale = std::max({vsg::length(vsg::dvec3(matrix[0][0], matrix[0][1], matrix[0][2])),
+                                         vsg::length(vsg::dvec3(matrix[1][0], matrix[1][1], matrix[1][2])),
+                                         vsg::length(vsg::dvec3(matrix[2][0], matrix[2][1], matrix[2][2]))});
+                set->worldBounds.emplace_back(center, vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.5 * scale);
+            }
+        }
+
+        stateGroup.traverse(*this);
+    }
+
+    bool createStreamedImage(vsg::ref_ptr<vsg::Descriptor> descriptor, TextureStreamer::StreamedImage& image) const
+    {
+        auto descriptorImage = descriptor.cast<vsg::DescriptorImage>();
+        if (!descriptorImage || descriptorImage->imageInfoList.size() != 1) return false;
+
+        auto& imageInfo = descriptorImage->imageInfoList.front();
+        if (!imageInfo || !imageInfo->imageView || !imageInfo->imageView->image) return false;
+
+        // already block compressed, carrying its own mipmaps or too small to be worth streaming
+        auto data = imageInfo->imageView->image->data.cast<vsg::ubvec4Array2D>();
+        if (!data || data->properties.maxNumMipmaps > 1) return false;
+
+        uint32_t width = data->width(), height = data->height();
+        if (!isPowerOfTwo(width) || !isPowerOfTwo(height) || std::max(width, height) < streamer.minStreamSize) return false;
+
+        image.width = width;
+        image.height = height;
+        image.descriptorImage = descriptorImage;
+
+        // build the full mip chain with a box filter, each level's layout matches the Vulkan image of the levels it's the finest of
+        image.levels.push_back(data);
+        while (width > 1 || height > 1)
+        {
+            auto& previous = *image.levels.back();
+            uint32_t nextWidth = std::max(width / 2, 1u), nextHeight = std::max(height / 2, 1u);
+            auto next = vsg::ubvec4Array2D::create(nextWidth, nextHeight, vsg::Data::Properties{data->properties.format});
+            for (uint32_t y = 0; y < nextHeight; ++y)
+            {
+                uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+                for (uint32_t x = 0; x < nextWidth; ++x)
+                {
+                    uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                    auto& c00 = previous.at(x0, y0);
+                    auto& c10 = previous.at(x1, y0);
+                    auto& c01 = previous.at(x0, y1);
+                    auto& c11 = previous.at(x1, y1);
+                    auto& c = next->at(x, y);
+                    for (int i = 0; i < 4; ++i) c[i] = static_cast<uint8_t>((c00[i] + c10[i] + c01[i] + c11[i] + 2) / 4);
+                }
+            }
+            image.levels.push_back(next);
+            width = nextWidth;
+            height = nextHeight;
+        }
+
+        image.numLevels = static_cast<uint32_t>(image.levels.size());
+        image.coarsestLevel = 0;
+        while (image.coarsestLevel + 1 < image.numLevels && std::max(image.width, image.height) >> image.coarsestLevel > streamer.initialSize) ++image.coarsestLevel;
+        image.residentLevel = image.coarsestLevel;
+        return true;
+    }
+};
+
+TextureStreamer::TextureStreamer() :
+    _compileThreads(vsg::OperationThreads::create(1))
+{
+}
+
+size_t TextureStreamer::numStreamedTextures() const
+{
+    size_t count = 0;
+    for (auto& set : _sets) count += set->images.size();
+    return count;
+}
+
+void TextureStreamer::setup(vsg::Node& scene)
+{
+    auto collect = CollectStreamedSets::create(*this);
+    scene.accept(*collect);
+
+    for (auto& [original, set] : collect->sets)
+    {
+        if (set->images.empty()) continue;
+
+        // the initial levels are compiled together with the rest of the scene
+        std::vector<uint32_t> levels;
+        for (auto& image : set->images) levels.push_back(image.residentLevel);
+
+        auto bind = _createBind(*set, levels);
+        for (auto parent : set->parents) std::replace(parent->stateCommands.begin(), parent->stateCommands.end(), vsg::ref_ptr<vsg::StateCommand>(set->bind), vsg::ref_ptr<vsg::StateCommand>(bind));
+        set->bind = bind;
+
+        for (auto& image : set->images)
+        {
+            residentBytes += _levelsSize(image, image.residentLevel);
+            fullBytes += _levelsSize(image, 0);
+        }
+
+        _sets.push_back(set);
+    }
+}
+
+vsg::ref_ptr<vsg::ubvec4Array2D> TextureStreamer::_createLevels(const StreamedImage& image, uint32_t level) const
+{
+    auto& finest = image.levels[level];
+
+    vsg::Data::Properties properties = image.levels.front()->properties;
+    properties.maxNumMipmaps = static_cast<uint8_t>(image.numLevels - level);
+
+    // the CPU copy isn't needed once uploaded, the full mip chain is kept in image.levels
+    properties.dataVariance = vsg::STATIC_DATA_UNREF_AFTER_TRANSFER;
+
+    auto data = vsg::ubvec4Array2D::create(finest->width(), finest->height(), properties);
+    auto ptr = reinterpret_cast<uint8_t*>(data->dataPointer());
+    for (uint32_t l = level; l < image.numLevels; ++l)
+    {
+        std::memcpy(ptr, image.levels[l]->dataPointer(), image.levels[l]->dataSize());
+        ptr += image.levels[l]->dataSize();
+    }
+    return data;
+}
+
+uint64_t TextureStreamer::_levelsSize(const StreamedImage& image, uint32_t level) const
+{
+    uint64_t size = 0;
+    for (uint32_t l = level; l < image.numLevels; ++l) size += image.levels[l]->dataSize();
+    return size;
+}
+
+vsg::ref_ptr<vsg::BindDescriptorSet> TextureStreamer::_createBind(const StreamedSet& set, const std::vector<uint32_t>& levels) const
+{
+    auto& original = *set.bind;
+
+    // the descriptors that aren't streamed are shared with the replaced set
+    auto descriptors = original.descriptorSet->descriptors;
+    for (size_t i = 0; i < set.images.size(); ++i)
+    {
+        auto& image = set.images[i];
+        auto& descriptorImage = *image.descriptorImage;
+        descriptors[image.descriptorIndex] = vsg::DescriptorImage::create(descriptorImage.imageInfoList.front()->sampler, _createLevels(image, levels[i]), descriptorImage.dstBinding, descriptorImage.dstArrayElement, descriptorImage.descriptorType);
+    }
+
+    auto descriptorSet = vsg::DescriptorSet::create(original.descriptorSet->setLayout, descriptors);
+    return vsg::BindDescriptorSet::create(original.pipelineBindPoint, original.layout, original.firstSet, descriptorSet);
+}
+
+uint32_t TextureStreamer::_selectLevel(const StreamedSet& set, const StreamedImage& image, const vsg::dmat4& view, double projectionScale) const
+{
+    // largest size on screen in pixels over the instances of the subgraphs using the texture
+    double projectedSize = 0.0;
+    for (auto& bound : set.worldBounds)
+    {
+        auto eyeCenter = view * bound.center;
+        double distance = -eyeCenter.z;
+        if (distance + bound.radius <= 0.0) continue; // behind the camera
+
+        double nearestDistance = std::max(distance - bound.radius, bound.radius * 0.01);
+        projectedSize = std::max(projectedSize, (2.0 * bound.radius / nearestDistance) * projectionScale);
+    }
+
+    if (projectedSize < 1.0) return image.coarsestLevel;
+
+    double level = std::log2(static_cast<double>(std::max(image.width, image.height)) / projectedSize) + lodBias;
+    if (level <= 0.0) return 0;
+    return std::min(static_cast<uint32_t>(level), image.coarsestLevel);
+}
+
+void TextureStreamer::update(vsg::Viewer& viewer, const vsg::Camera& camera)
+{
+    auto frameCount = viewer.getFrameStamp()->frameCount;
+    while (!_released.empty() && _released.front().frameCount + s_numFramesToRelease <= frameCount) _released.pop_front();
+
+    if (!viewer.compileManager || !camera.viewMatrix || !camera.projectionMatrix) return;
+
+    auto view = camera.viewMatrix->transform();
+    auto projection = camera.projectionMatrix->transform();
+
+    // pixels per unit of size at unit distance
+    double projectionScale = std::abs(projection[1][1]) * 0.5 * static_cast<double>(camera.getViewport().height);
+
+    for (auto& set : _sets)
+    {
+        if (_numPending >= maxPendingUploads) break;
+        if (set->pending) continue;
+
+        bool changed = false;
+        std::vector<uint32_t> levels;
+        for (auto& image : set->images)
+        {
+            uint32_t required = _selectLevel(*set, image, view, projectionScale);
+            uint32_t level = image.residentLevel;
+            if (required < level) level = level - 1; // sharpen one level at a time
+            else if (required > level + evictionHysteresis) level = required;
+
+            changed = changed || (level != image.residentLevel);
+            levels.push_back(level);
+        }
+        if (!changed) continue;
+
+        set->pending = true;
+        ++_numPending;
+
+        auto bind = _createBind(*set, levels);
+        vsg::observer_ptr<vsg::Viewer> observerViewer(&viewer);
+        vsg::ref_ptr<TextureStreamer> streamer(this);
+        _compileThreads->add(experimental::FunctionOperation::create([streamer, observerViewer, set, bind, levels]() {
+            vsg::ref_ptr<vsg::Viewer> ref_viewer = observerViewer;
+            if (!ref_viewer) return;
+
+            auto result = ref_viewer->compileManager->compile(bind);
+
+            // swap on the main thread during Viewer::update()
+            ref_viewer->addUpdateOperation(experimental::FunctionOperation::create([streamer, observerViewer, set, bind, levels, result]() {
+                vsg::ref_ptr<vsg::Viewer> swap_viewer = observerViewer;
+                if (swap_viewer) streamer->_swap(*swap_viewer, *set, bind, levels, result);
+            }));
+        }));
+    }
+}
+
+void TextureStreamer::_swap(vsg::Viewer& viewer, StreamedSet& set, vsg::ref_ptr<vsg::BindDescriptorSet> bind, const std::vector<uint32_t>& levels, const vsg::CompileResult& result)
+{
+    set.pending = false;
+    --_numPending;
+
+    if (!result)
+    {
+        vsg::warn("TextureStreamer : failed to compile ", set.images.size(), " streamed textures, result = ", result.result);
+        return;
+    }
+
+    vsg::updateViewer(viewer, result);
+
+    for (auto parent : set.parents) std::replace(parent->stateCommands.begin(), parent->stateCommands.end(), vsg::ref_ptr<vsg::StateCommand>(set.bind), vsg::ref_ptr<vsg::StateCommand>(bind));
+    _released.push_back(Released{set.bind, viewer.getFrameStamp()->frameCount});
+    set.bind = bind;
+
+    for (size_t i = 0; i < set.images.size(); ++i)
+    {
+        auto& image = set.images[i];
+        if (levels[i] == image.residentLevel) continue;
+
+        residentBytes -= _levelsSize(image, image.residentLevel);
+        auto uploaded = _levelsSize(image, levels[i]);
+        residentBytes += uploaded;
+        bytesUploaded += uploaded;
+
+        if (levels[i] < image.residentLevel) ++numUploads;
+        else ++numEvictions;
+
+        image.residentLevel = levels[i];
+    }
+}
+
+void TextureStreamer::report(std::ostream& out) const
+{
+    out << "TextureStreamer : " << numStreamedTextures() << " textures streamed, " << numUploads << " levels uploaded, " << numEvictions << " evictions, " << bytesUploaded << " bytes uploaded" << std::endl;
+    out << "    " << residentBytes << " bytes resident of " << fullBytes << " bytes for all levels" << std::endl;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <deque>
+#include <ostream>
+
+// Streams the mip levels of large RGBA8 textures by how large the geometry using them appears on screen. Each texture
+// starts with only its levels of initialSize or less resident, so the scene is visible at low resolution as soon as
+// it's compiled, and gains one finer level at a time, coarsest first, as the screen space size of its bounds asks for
+// it. Textures whose geometry shrinks on screen, or moves behind the camera, drop their finer levels again.
+// The resident levels of a texture are a complete Vulkan image whose level 0 is the finest resident level, so the
+// image itself clamps the LOD sampled and non-resident levels take no device memory. When the resident levels change
+// a replacement BindDescriptorSet is compiled on a background thread and swapped into the StateGroups on the main
+// thread, the replaced one is released once the frames that may still use it have completed.
+class TextureStreamer : public vsg::Inherit<vsg::Object, TextureStreamer>
+{
+public:
+    TextureStreamer();
+
+    // textures smaller than this are left fully resident
+    uint32_t minStreamSize = 512;
+
+    // largest dimension of the levels made resident initially, and the coarsest textures are evicted to
+    uint32_t initialSize = 64;
+
+    // number of level changes compiling at once
+    uint32_t maxPendingUploads = 4;
+
+    // added to the level selected from screen space size, positive values stream less
+    double lodBias = 0.0;
+
+    // number of levels coarser than resident that is required before finer levels are evicted
+    uint32_t evictionHysteresis = 1;
+
+    // replace the textures of a scene that hasn't been compiled yet with their initial resident levels
+    void setup(vsg::Node& scene);
+
+    // call each frame after Viewer::update(), selects the levels required from camera's view and compiles any changes
+    void update(vsg::Viewer& viewer, const vsg::Camera& camera);
+
+    size_t numStreamedTextures() const;
+
+    // statistics
+    uint64_t numUploads = 0;
+    uint64_t numEvictions = 0;
+    uint64_t bytesUploaded = 0;
+    uint64_t residentBytes = 0;
+    uint64_t fullBytes = 0;
+
+    void report(std::ostream& out) const;
+
+protected:
+    struct StreamedImage
+    {
+        size_t descriptorIndex = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t numLevels = 0;
+        uint32_t coarsestLevel = 0;
+        uint32_t residentLevel = 0;
+        std::vector<vsg::ref_ptr<vsg::ubvec4Array2D>> levels; // full mip chain kept on the CPU
+        vsg::ref_ptr<vsg::DescriptorImage> descriptorImage;    // the original, for its sampler, binding and type
+    };
+
+    struct StreamedSet : public vsg::Inherit<vsg::Object, StreamedSet>
+    {
+        vsg::ref_ptr<vsg::BindDescriptorSet> bind;
+        std::vector<StreamedImage> images;
+        std::vector<vsg::StateGroup*> parents;
+        std::vector<vsg::dsphere> worldBounds;
+        bool pending = false;
+    };
+
+    struct Released
+    {
+        vsg::ref_ptr<vsg::BindDescriptorSet> bind;
+        uint64_t frameCount;
+    };
+
+    friend class CollectStreamedSets;
+
+    vsg::ref_ptr<vsg::ubvec4Array2D> _createLevels(const StreamedImage& image, uint32_t level) const;
+    uint64_t _levelsSize(const StreamedImage& image, uint32_t level) const;
+    vsg::ref_ptr<vsg::BindDescriptorSet> _createBind(const StreamedSet& set, const std::vector<uint32_t>& levels) const;
+    uint32_t _selectLevel(const StreamedSet& set, const StreamedImage& image, const vsg::dmat4& view, double projectionScale) const;
+    void _swap(vsg::Viewer& viewer, StreamedSet& set, vsg::ref_ptr<vsg::BindDescriptorSet> bind, const std::vector<uint32_t>& levels, const vsg::CompileResult& result);
+
+    std::vector<vsg::ref_ptr<StreamedSet>> _sets;
+    std::deque<Released> _released;
+    uint32_t _numPending = 0;
+    vsg::ref_ptr<vsg::OperationThreads> _compileThreads;
+};
@@ -0,0 +1,424 @@
+#include "TextureTranscoder.h"
+#include "AtomicSave.h"
+#include "Hash.h"
+#include "ParallelTraversal.h"
+#include "RecursionGuard.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+
+// bump when the encoder changes so stale cache entries are no longer found
+static constexpr uint64_t s_encoderVersion = 1;
+
+namespace
+{
+    bool isPowerOfTwo(uint32_t value) { return value != 0 && (value & (value - 1)) == 0; }
+
+    uint16_t to565(const vsg::ubvec4& c)
+    {
+        return static_cast<uint16_t>(((c.r >> 3) << 11) | ((c.g >> 2) << 5) | (c.b >> 3));
+    }
+
+    vsg::ubvec4 from565(uint16_t v)
+    {
+        uint8_t r = static_cast<uint8_t>((v >> 11) & 31);
+        uint8_t g = static_cast<uint8_t>((v >> 5) & 63);
+        uint8_t b = static_cast<uint8_t>(v & 31);
+        return vsg::ubvec4(static_cast<uint8_t>((r << 3) | (r >> 2)), static_cast<uint8_t>((g << 2) | (g >> 4)), static_cast<uint8_t>((b << 3) | (b >> 2)), 255);
+    }
+
+    // BC1 color block from the bounding box of the block's colors, inset slightly to reduce the error at its ends
+    uint64_t encodeColorBlock(const vsg::ubvec4* pixels)
+    {
+        vsg::ubvec4 minColor(255, 255, 255, 255), maxColor(0, 0, 0, 0);
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                minColor[c] = std::min(minColor[c], pixels[i][c]);
+                maxColor[c] = std::max(maxColor[c], pixels[i][c]);
+            }
+        }
+
+        for (int c = 0; c < 3; ++c)
+        {
+            uint8_t inset = static_cast<uint8_t>((maxColor[c] - minColor[c]) >> 4);
+            minColor[c] = static_cast<uint8_t>(minColor[c] + inset);
+            maxColor[c] = static_cast<uint8_t>(maxColor[c] - inset);
+        }
+
+        uint16_t color0 = to565(maxColor);
+        uint16_t color1 = to565(minColor);
+        if (color0 < color1) std::swap(color0, color1);
+        if (color0 == color1) return uint64_t(color0) | (uint64_t(color1) << 16);
+
+        // color0 > color1 selects the four color mode
+        vsg::ubvec4 palette[4];
+        palette[0] = from565(color0);
+        palette[1] = from565(color1);
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+            palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+        }
+
+        uint32_t indices = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            int best = 0, bestDistance = std::numeric_limits<int>::max();
+            for (int p = 0; p < 4; ++p)
+            {
+                int distance = 0;
+                for (int c = 0; c < 3; ++c)
+                {
+                    int delta = int(pixels[i][c]) - int(palette[p][c]);
+                    distance += delta * delta;
+                }
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= uint32_t(best) << (2 * i);
+        }
+
+        return uint64_t(color0) | (uint64_t(color1) << 16) | (uint64_t(indices) << 32);
+    }
+
+    // BC3 alpha block, interpolating eight levels between the block's minimum and maximum alpha
+    uint64_t encodeAlphaBlock(const vsg::ubvec4* pixels)
+    {
+        uint8_t alpha0 = 0, alpha1 = 255;
+        for (int i = 0; i < 16; ++i)
+        {
+            alpha0 = std::max(alpha0, pixels[i].a);
+            alpha1 = std::min(alpha1, pixels[i].a);
+        }
+
+        uint64_t block = uint64_t(alpha0) | (uint64_t(alpha1) << 8);
+        if (alpha0 == alpha1) return block;
+
+        // alpha0 > alpha1 selects the eight level mode, index 0 is alpha0, 1 is alpha1 and 2 to 7 step from alpha0 to alpha1
+        int range = alpha0 - alpha1;
+        for (int i = 0; i < 16; ++i)
+        {
+            int step = ((alpha0 - pixels[i].a) * 7 + range / 2) / range;
+            uint64_t index = (step == 0) ? 0 : (step == 7) ? 1 : uint64_t(step + 1);
+            block |= index << (16 + 3 * i);
+        }
+        return block;
+    }
+
+    class CollectImageInfos : public vsg::Inherit<vsg::Visitor, CollectImageInfos>
+    {
+    public:
+        std::map<vsg::Image*, std::vector<vsg::ImageInfo*>> imageInfos;
+        std::set<const vsg::Object*> visited;
+
+        void apply(vsg::Object& object) override
+        {
+            // shared state is only traversed once
+            if (object.referenceCount() > 1 && !visited.insert(&object).second) return;
+            object.traverse(*this);
+        }
+
+        void apply(vsg::DescriptorImage& descriptorImage) override
+        {
+            for (auto& imageInfo : descriptorImage.imageInfoList)
+            {
+                if (imageInfo && imageInfo->imageView && imageInfo->imageView->image && imageInfo->imageView->image->data)
+                {
+                    imageInfos[imageInfo->imageView->image.get()].push_back(imageInfo.get());
+                }
+            }
+        }
+    };
+
+    class TextureTranscoderReaderWriter : public vsg::Inherit<vsg::ReaderWriter, TextureTranscoderReaderWriter>
+    {
+    public:
+        explicit TextureTranscoderReaderWriter(vsg::ref_ptr<TextureTranscoder> in_transcoder) :
+            transcoder(in_transcoder) {}
+
+        vsg::ref_ptr<TextureTranscoder> transcoder;
+
+        vsg::ref_ptr<vsg::Object> read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) const override
+        {
+            // vsg::read() calls back into this ReaderWriter, pass on it then
+            static thread_local bool reading = false;
+            vsg::ref_ptr<vsg::Object> object;
+            {
+                RecursionGuard guard(reading);
+                if (!guard) return {};
+                object = vsg::read(filename, options);
+            }
+
+            if (auto data = object.cast<vsg::Data>()) return transcoder->transcode(data);
+            if (auto node = object.cast<vsg::Node>()) transcoder->transcode(*node);
+            return object;
+        }
+    };
+} // namespace
+
+TextureTranscoder::TextureTranscoder(const vsg::Path& in_cacheDirectory, vsg::ref_ptr<vsg::OperationThreads> in_operationThreads) :
+    cacheDirectory(in_cacheDirectory),
+    operationThreads(in_operationThreads)
+{
+    if (!cacheDirectory.empty()) vsg::makeDirectory(cacheDirectory);
+}
+
+bool TextureTranscoder::selectFormats(vsg::PhysicalDevice* physicalDevice)
+{
+    _bc = false;
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(*physicalDevice, &features);
+    if (!features.textureCompressionBC) return false;
+
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    for (auto format : {VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK})
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(*physicalDevice, format, &properties);
+        if ((properties.optimalTilingFeatures & required) != required) return false;
+    }
+
+    _bc = true;
+    return true;
+}
+
+vsg::Path TextureTranscoder::_cacheFilename(uint64_t hash) const
+{
+    std::ostringstream str;
+    str << std::hex << std::setw(16) << std::setfill('0') << hash << ".vsgb";
+    return cacheDirectory / str.str();
+}
+
+vsg::ref_ptr<vsg::Data> TextureTranscoder::transcode(vsg::ref_ptr<vsg::Data> data)
+{
+    if (!_bc || !data) return data;
+
+    auto& properties = data->properties;
+    uint32_t width = data->width();
+    uint32_t height = data->height();
+    bool srgb = properties.format == VK_FORMAT_R8G8B8A8_SRGB || properties.format == VK_FORMAT_R8G8B8_SRGB;
+    bool unorm = properties.format == VK_FORMAT_R8G8B8A8_UNORM || properties.format == VK_FORMAT_R8G8B8_UNORM;
+
+    // the mip chain is laid out in halving blocks, which only matches the image's levels for power of two dimensions
+    if ((!srgb && !unorm) || properties.blockWidth > 1 || properties.blockHeight > 1 || properties.maxNumMipmaps > 1 || data->depth() > 1 ||
+        !isPowerOfTwo(width) || !isPowerOfTwo(height) || width < 4 || height < 4)
+    {
+        ++numSkipped;
+        return data;
+    }
+
+    std::vector<vsg::ubvec4> pixels;
+    if (auto rgba = data.cast<vsg::ubvec4Array2D>())
+    {
+        pixels.assign(rgba->begin(), rgba->end());
+    }
+    else if (auto rgb = data.cast<vsg::ubvec3Array2D>())
+    {
+        pixels.reserve(rgb->valueCount());
+        for (auto& c : *rgb) pixels.emplace_back(c.r, c.g, c.b, 255);
+    }
+    else
+    {
+        ++numSkipped;
+        return data;
+    }
+
+    bool alpha = std::any_of(pixels.begin(), pixels.end(), [](const vsg::ubvec4& c) { return c.a != 255; });
+
+    sourceSize += data->dataSize();
+
+    uint64_t hash = 0;
+    if (!cacheDirectory.empty())
+    {
+        hash = experimental::hashSeed;
+        for (uint64_t value : {s_encoderVersion, uint64_t(width), uint64_t(height), uint64_t(srgb)})
+        {
+            hash = experimental::hashBytes(&value, sizeof(value), hash);
+        }
+        hash = experimental::hashBytes(pixels.data(), pixels.size() * sizeof(vsg::ubvec4), hash);
+
+        auto cachedFilename = _cacheFilename(hash);
+        if (vsg::fileExists(cachedFilename))
+        {
+            if (auto cached = vsg::read_cast<vsg::Data>(cachedFilename))
+            {
+                ++numCacheHits;
+                transcodedSize += cached->dataSize();
+                return cached;
+            }
+        }
+    }
+
+    auto start = vsg::clock::now();
+    auto transcoded = _encode(pixels, width, height, alpha, srgb, properties);
+    encodeTime += std::chrono::duration_cast<std::chrono::nanoseconds>(vsg::clock::now() - start).count();
+
+    ++numTranscoded;
+    transcodedSize += transcoded->dataSize();
+
+    // write through a temporary file so a concurrent or interrupted run never sees a partial cache entry
+    if (!cacheDirectory.empty())
+    {
+        experimental::atomicSave(_cacheFilename(hash), [&](const vsg::Path& temporaryFilename) { return vsg::write(transcoded, temporaryFilename); });
+    }
+
+    return transcoded;
+}
+
+vsg::ref_ptr<vsg::Data> TextureTranscoder::_encode(const std::vector<vsg::ubvec4>& pixels, uint32_t width, uint32_t height, bool alpha, bool srgb, const vsg::Data::Properties& sourceProperties)
+{
+    uint32_t numLevels = 1;
+    while ((std::max(width, height) >> numLevels) > 0) ++numLevels;
+
+    auto properties = sourceProperties;
+    properties.blockWidth = 4;
+    properties.blockHeight = 4;
+    properties.maxNumMipmaps = static_cast<uint8_t>(numLevels);
+    if (alpha) properties.format = srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    else properties.format = srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+
+    vsg::ref_ptr<vsg::Data> transcoded;
+    uint8_t* destination = nullptr;
+    size_t blockSize = alpha ? sizeof(vsg::block128) : sizeof(vsg::block64);
+    if (alpha)
+    {
+        auto blocks = vsg::block128Array2D::create(width / 4, height / 4, properties);
+        destination = reinterpret_cast<uint8_t*>(blocks->dataPointer());
+        transcoded = blocks;
+    }
+    else
+    {
+        auto blocks = vsg::block64Array2D::create(width / 4, height / 4, properties);
+        destination = reinterpret_cast<uint8_t*>(blocks->dataPointer());
+        transcoded = blocks;
+    }
+
+    std::vector<vsg::ubvec4> level = pixels;
+    uint32_t levelWidth = width, levelHeight = height;
+    size_t numThreads = operationThreads ? std::max(operationThreads->threads.size(), size_t(1)) : size_t(1);
+
+    for (uint32_t l = 0; l < numLevels; ++l)
+    {
+        // levels smaller than a block are encoded as a single block with their edge pixels repeated
+        uint32_t blocksWide = std::max(levelWidth / 4, 1u);
+        uint32_t blocksHigh = std::max(levelHeight / 4, 1u);
+
+        auto encodeRows = [&, destination](uint32_t beginRow, uint32_t endRow) {
+            vsg::ubvec4 block[16];
+            for (uint32_t by = beginRow; by < endRow; ++by)
+            {
+                for (uint32_t bx = 0; bx < blocksWide; ++bx)
+                {
+                    for (uint32_t j = 0; j < 4; ++j)
+                    {
+                        uint32_t y = std::min(by * 4 + j, levelHeight - 1);
+                        for (uint32_t i = 0; i < 4; ++i)
+                        {
+                            uint32_t x = std::min(bx * 4 + i, levelWidth - 1);
+                            block[j * 4 + i] = level[size_t(y) * levelWidth + x];
+                        }
+                    }
+
+                    auto ptr = destination + (size_t(by) * blocksWide + bx) * blockSize;
+                    if (alpha)
+                    {
+                        uint64_t alphaBlock = encodeAlphaBlock(block);
+                        std::memcpy(ptr, &alphaBlock, sizeof(alphaBlock));
+                        ptr += sizeof(alphaBlock);
+                    }
+                    uint64_t colorBlock = encodeColorBlock(block);
+                    std::memcpy(ptr, &colorBlock, sizeof(colorBlock));
+                }
+            }
+        };
+
+        size_t numTasks = std::min(size_t(blocksHigh), numThreads * 4);
+        std::vector<std::function<void()>> tasks;
+        for (size_t t = 0; t < numTasks; ++t)
+        {
+            uint32_t beginRow = static_cast<uint32_t>((blocksHigh * t) / numTasks);
+            uint32_t endRow = static_cast<uint32_t>((blocksHigh * (t + 1)) / numTasks);
+            tasks.push_back([&encodeRows, beginRow, endRow]() { encodeRows(beginRow, endRow); });
+        }
+        experimental::runTasks(operationThreads, tasks);
+
+        destination += size_t(blocksWide) * blocksHigh * blockSize;
+
+        // box filter down to the next level
+        uint32_t nextWidth = std::max(levelWidth / 2, 1u);
+        uint32_t nextHeight = std::max(levelHeight / 2, 1u);
+        std::vector<vsg::ubvec4> next(size_t(nextWidth) * nextHeight);
+        for (uint32_t y = 0; y < nextHeight; ++y)
+        {
+            uint32_t y0 = std::min(y * 2, levelHeight - 1), y1 = std::min(y * 2 + 1, levelHeight - 1);
+            for (uint32_t x = 0; x < nextWidth; ++x)
+            {
+                uint32_t x0 = std::min(x * 2, levelWidth - 1), x1 = std::min(x * 2 + 1, levelWidth - 1);
+                auto& c00 = level[size_t(y0) * levelWidth + x0];
+                auto& c10 = level[size_t(y0) * levelWidth + x1];
+                auto& c01 = level[size_t(y1) * levelWidth + x0];
+                auto& c11 = level[size_t(y1) * levelWidth + x1];
+                auto& c = next[size_t(y) * nextWidth + x];
+                for (int i = 0; i < 4; ++i) c[i] = static_cast<uint8_t>((c00[i] + c10[i] + c01[i] + c11[i] + 2) / 4);
+            }
+        }
+
+        level.swap(next);
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    return transcoded;
+}
+
+void TextureTranscoder::transcode(vsg::Node& node)
+{
+    if (!_bc) return;
+
+    auto collect = CollectImageInfos::create();
+    node.accept(*collect);
+
+    std::vector<std::function<void()>> tasks;
+    for (auto& [image, imageInfos] : collect->imageInfos)
+    {
+        tasks.push_back([this, image = image, &imageInfos = imageInfos]() {
+            auto transcoded = transcode(image->data);
+            if (transcoded == image->data) return;
+
+            // the Image and ImageViews took their format and mip levels from the original data when they were created
+            image->data = transcoded;
+            image->format = transcoded->properties.format;
+            image->mipLevels = transcoded->properties.maxNumMipmaps;
+            for (auto imageInfo : imageInfos)
+            {
+                imageInfo->imageView->format = image->format;
+                imageInfo->imageView->subresourceRange.levelCount = image->mipLevels;
+            }
+        });
+    }
+    experimental::runTasks(operationThreads, tasks);
+}
+
+vsg::ref_ptr<vsg::ReaderWriter> TextureTranscoder::createReaderWriter()
+{
+    return TextureTranscoderReaderWriter::create(vsg::ref_ptr<TextureTranscoder>(this));
+}
+
+void TextureTranscoder::report(std::ostream& out) const
+{
+    out << "TextureTranscoder : " << numTranscoded << " textures transcoded in " << (double(encodeTime) * 1e-6) << "ms, " << numCacheHits << " read from the cache, " << numSkipped << " skipped" << std::endl;
+    if (sourceSize > 0) out << "    " << sourceSize << " bytes reduced to " << transcodedSize << " bytes including mipmaps" << std::endl;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <ostream>
+
+// Transcodes RGB8/RGBA8 textures to BC1, or BC3 when they have alpha, with a full mip chain, cutting their memory and
+// bandwidth by 4 to 8 times. The formats are only used where selectFormats() finds them supported by the device, and
+// where textureCompressionBC is then requested on the device. Images are encoded in rows of blocks across the
+// OperationThreads, and encoded results are kept in cacheDirectory keyed by a hash of the source pixels, so later runs
+// only pay for the hash. Images whose dimensions aren't powers of two of at least 4, that already carry mipmaps or are
+// already compressed, such as KTX2 files read by vsgXchange, are left as they are.
+class TextureTranscoder : public vsg::Inherit<vsg::Object, TextureTranscoder>
+{
+public:
+    explicit TextureTranscoder(const vsg::Path& in_cacheDirectory = {}, vsg::ref_ptr<vsg::OperationThreads> in_operationThreads = {});
+
+    const vsg::Path cacheDirectory;
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+
+    // check which compressed formats physicalDevice can sample from, returns false if there are none to transcode to.
+    // When true set deviceFeatures.textureCompressionBC before the device is created.
+    bool selectFormats(vsg::PhysicalDevice* physicalDevice);
+
+    bool supported() const { return _bc; }
+
+    // returns a compressed copy of data, or data itself if it can't or needn't be transcoded
+    vsg::ref_ptr<vsg::Data> transcode(vsg::ref_ptr<vsg::Data> data);
+
+    // transcode the images of the DescriptorImages in a subgraph that hasn't been compiled yet, in parallel
+    void transcode(vsg::Node& node);
+
+    // add to the front of Options::readerWriters so that images and subgraphs read later, such as paged tiles, are transcoded
+    vsg::ref_ptr<vsg::ReaderWriter> createReaderWriter();
+
+    // statistics
+    std::atomic_uint numTranscoded{0};
+    std::atomic_uint numCacheHits{0};
+    std::atomic_uint numSkipped{0};
+    std::atomic_uint64_t sourceSize{0};
+    std::atomic_uint64_t transcodedSize{0};
+    std::atomic_uint64_t encodeTime{0}; // nanoseconds spent encoding
+
+    void report(std::ostream& out) const;
+
+protected:
+    vsg::ref_ptr<vsg::Data> _encode(const std::vector<vsg::ubvec4>& pixels, uint32_t width, uint32_t height, bool alpha, bool srgb, const vsg::Data::Properties& sourceProperties);
+    vsg::Path _cacheFilename(uint64_t hash) const;
+
+    bool _bc = false;
+};
@@ -1,14 +1,45 @@
 #include <vsg/all.h>
 
+#include "FrameGovernor.h"
+#include "FrameTrace.h"
+#include "PipelineCache.h"
+#include "ShadowAtlas.h"
+#include "TextureStreamer.h"
+#include "TextureTranscoder.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
 
 #include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <iostream>
 #include <thread>
 
+// the first directional light and the spot lights in a scene, which ShadowAtlas can cast shadows for
+struct FindLights : public vsg::Visitor
+{
+    bool foundLights = false;
+    vsg::ref_ptr<vsg::DirectionalLight> directionalLight;
+    std::vector<vsg::ref_ptr<vsg::SpotLight>> spotLights;
+
+    void apply(vsg::Node& node) override { node.traverse(*this); }
+    void apply(vsg::Light&) override { foundLights = true; }
+
+    void apply(vsg::DirectionalLight& light) override
+    {
+        foundLights = true;
+        if (!directionalLight) directionalLight = &light;
+    }
+
+    void apply(vsg::SpotLight& light) override
+    {
+        foundLights = true;
+        spotLights.emplace_back(&light);
+    }
+};
+
 vsg::ref_ptr<vsg::Node> createTextureQuad(vsg::ref_ptr<vsg::Data> sourceData, vsg::ref_ptr<vsg::Options> options)
 {
     auto builder = vsg::Builder::create();
@@ -105,6 +136,23 @@ int main(int argc, char** argv)
         auto horizonMountainHeight = arguments.value(0.0, "--hmh");
         auto nearFarRatio = arguments.value<double>(0.001, "--nfr");
         if (arguments.read("--rgb")) options->mapRGBtoRGBAHint = false;
+        auto pipelineCacheDirectory = arguments.value(std::string(), "--pipeline-cache");
+
+        // transcode RGB/RGBA textures to block compressed formats supported by the device, optionally caching the results
+        bool transcodeTextures = arguments.read("--transcode");
+        auto transcodeCacheDirectory = arguments.value(std::string(), "--transcode-cache");
+        auto transcodeThreads = arguments.value(std::thread::hardware_concurrency(), "--transcode-threads");
+
+        // stream the mip levels of large textures by their size on screen, starting from levels of the initial size
+        bool streamTextures = arguments.read("--stream-textures");
+        auto streamInitialSize = arguments.value(64u, "--stream-initial-size");
+        auto streamMinSize = arguments.value(512u, "--stream-min-size");
+        auto streamUploads = arguments.value(4u, "--stream-uploads");
+
+        // hold a GPU frame time in milliseconds by rendering the scene at a lower resolution and upscaling it
+        auto governorFrameTime = arguments.value(0.0, "--governor");
+        auto governorMinScale = arguments.value(0.5f, "--governor-min-scale");
+        auto governorMaxScale = arguments.value(1.0f, "--governor-max-scale");
 
         if (arguments.read({"--shader-debug-info", "--sdi"}))
         {
@@ -114,6 +162,15 @@ int main(int argc, char** argv)
 
         if (int log_level = 0; arguments.read("--log-level", log_level)) vsg::Logger::instance()->level = vsg::Logger::Level(log_level);
 
+        // shadows for the scene's first directional light and its spot lights, see vsglights
+        bool shadows = arguments.read("--shadows");
+        auto shadowAtlasSize = arguments.value(4096u, "--shadow-atlas-size");
+        auto shadowTileSize = arguments.value(1024u, "--shadow-tile-size");
+        auto shadowCascades = arguments.value(4u, "--shadow-cascades");
+
+        auto frameTrace = FrameTrace::create_if_requested(arguments);
+        if (frameTrace) frameTrace->addReaderWriter(*options);
+
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
         if (argc <= 1)
@@ -122,6 +179,26 @@ int main(int argc, char** argv)
             return 1;
         }
 
+        // create the VkPipelines of everything loaded, including paged subgraphs, through a cache that persists between runs
+        vsg::ref_ptr<PipelineCache> pipelineCache;
+        if (!pipelineCacheDirectory.empty())
+        {
+            pipelineCache = PipelineCache::create(pipelineCacheDirectory);
+            options->readerWriters.insert(options->readerWriters.begin(), pipelineCache->createReaderWriter());
+        }
+
+        // the shadowed ShaderSets need to be in place before the models are loaded so their pipelines are built with them
+        vsg::ref_ptr<ShadowAtlas> shadowAtlas;
+        if (shadows)
+        {
+            shadowAtlas = ShadowAtlas::create(shadowAtlasSize, shadowTileSize, shadowCascades);
+            if (!shadowAtlas->assignShaderSets(options))
+            {
+                std::cout << "Warning: could not read shaders/standard_phong.frag and shaders/standard_pbr.frag, --shadows ignored." << std::endl;
+                shadowAtlas = {};
+            }
+        }
+
         auto group = vsg::Group::create();
 
         vsg::Path path;
@@ -165,6 +242,34 @@ int main(int argc, char** argv)
         else
             vsg_scene = group;
 
+        if (shadowAtlas)
+        {
+            // the headlight isn't used with shadows, so light scenes without their own lights from above
+            FindLights findLights;
+            vsg_scene->accept(findLights);
+            if (!findLights.foundLights)
+            {
+                auto ambientLight = vsg::AmbientLight::create();
+                ambientLight->name = "ambient";
+                ambientLight->intensity = 0.05f;
+
+                findLights.directionalLight = vsg::DirectionalLight::create();
+                findLights.directionalLight->name = "directional";
+                findLights.directionalLight->intensity = 0.95f;
+                findLights.directionalLight->direction.set(0.0, -1.0, -1.0);
+
+                auto litScene = vsg::Group::create();
+                litScene->addChild(ambientLight);
+                litScene->addChild(findLights.directionalLight);
+                litScene->addChild(vsg_scene);
+                vsg_scene = litScene;
+            }
+
+            // the lights are assumed to be in world coordinates
+            if (findLights.directionalLight) shadowAtlas->setDirectionalLight(findLights.directionalLight);
+            for (auto& spotLight : findLights.spotLights) shadowAtlas->addSpotLight(spotLight);
+        }
+
         // create the viewer and assign window(s) to it
         auto viewer = vsg::Viewer::create();
         auto window = vsg::Window::create(windowTraits);
@@ -176,6 +281,47 @@ int main(int argc, char** argv)
 
         viewer->addWindow(window);
 
+        vsg::ref_ptr<TextureTranscoder> transcoder;
+        if (transcodeTextures || !transcodeCacheDirectory.empty())
+        {
+            transcoder = TextureTranscoder::create(transcodeCacheDirectory, transcodeThreads > 1 ? vsg::OperationThreads::create(transcodeThreads) : vsg::ref_ptr<vsg::OperationThreads>());
+            if (transcoder->selectFormats(window->getOrCreatePhysicalDevice()))
+            {
+                // the device isn't created until first required so the compressed formats can still be enabled
+                if (!windowTraits->deviceFeatures) windowTraits->deviceFeatures = vsg::DeviceFeatures::create();
+                windowTraits->deviceFeatures->get().textureCompressionBC = VK_TRUE;
+
+                auto startTime = vsg::clock::now();
+                transcoder->transcode(*vsg_scene);
+                auto time = std::chrono::duration<float, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+                std::cout << "Textures transcoded in " << time << "ms." << std::endl;
+
+                options->readerWriters.insert(options->readerWriters.begin(), transcoder->createReaderWriter());
+            }
+            else
+            {
+                std::cout << "Device doesn't support BC compressed textures, textures left uncompressed." << std::endl;
+                transcoder = {};
+            }
+        }
+
+        if (pipelineCache)
+        {
+            // creation feedback reports whether each pipeline was found in the cache
+            bool creationFeedback = false;
+            for (auto& extension : window->getOrCreatePhysicalDevice()->enumerateDeviceExtensionProperties())
+            {
+                if (std::strcmp(extension.extensionName, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) == 0) creationFeedback = true;
+            }
+            if (creationFeedback) windowTraits->deviceExtensionNames.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+
+            auto device = window->getOrCreateDevice();
+            if (creationFeedback) pipelineCache->enableCreationFeedback(device);
+
+            // subgraphs created by createTextureQuad() weren't read through the Options
+            pipelineCache->inject(*vsg_scene);
+        }
+
         // compute the bounds of the scene graph to help position camera
         vsg::ComputeBounds computeBounds;
         vsg_scene->accept(computeBounds);
@@ -232,10 +378,60 @@ int main(int argc, char** argv)
             std::cout << "No. of tiles loaded " << loadPagedLOD.numTiles << " in " << time << "ms." << std::endl;
         }
 
-        auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
+        vsg::ref_ptr<FrameGovernor> governor;
+        if (governorFrameTime > 0.0)
+        {
+            auto physicalDevice = window->getOrCreatePhysicalDevice();
+            auto& limits = physicalDevice->getProperties().limits;
+            if (limits.timestampComputeAndGraphics)
+            {
+                governor = FrameGovernor::create(governorFrameTime, windowTraits->swapchainPreferences.imageCount, limits.timestampPeriod);
+                governor->minScale = governorMinScale;
+                governor->maxScale = governorMaxScale;
+            }
+            else
+            {
+                std::cout << "Warning: device doesn't support timestamps, --governor ignored." << std::endl;
+            }
+        }
+
+        auto commandGraph = governor ? governor->createCommandGraph(window, camera, vsg_scene) : vsg::createCommandGraphForView(window, camera, vsg_scene, VK_SUBPASS_CONTENTS_INLINE, !shadowAtlas);
+        if (shadowAtlas)
+        {
+            // the main views only record the main pipelines of the StateSwitches, the shadow tiles are rendered ahead of them
+            for (auto& child : commandGraph->children)
+            {
+                if (auto renderGraph = child.cast<vsg::RenderGraph>())
+                {
+                    for (auto& renderGraphChild : renderGraph->children)
+                    {
+                        if (auto view = renderGraphChild.cast<vsg::View>()) view->mask = shadowAtlas->mainMask;
+                    }
+                }
+            }
+
+            auto context = vsg::Context::create(window->getOrCreateDevice());
+            commandGraph->children.insert(commandGraph->children.begin(), shadowAtlas->createCommands(*context, vsg_scene));
+            shadowAtlas->assign(*vsg_scene);
+        }
+        if (frameTrace) frameTrace->addTimestamps(*commandGraph);
         viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
-        viewer->compile();
+        vsg::ref_ptr<TextureStreamer> textureStreamer;
+        if (streamTextures)
+        {
+            textureStreamer = TextureStreamer::create();
+            textureStreamer->initialSize = streamInitialSize;
+            textureStreamer->minStreamSize = streamMinSize;
+            textureStreamer->maxPendingUploads = streamUploads;
+            textureStreamer->setup(*vsg_scene);
+            std::cout << "Streaming " << textureStreamer->numStreamedTextures() << " textures." << std::endl;
+        }
+
+        {
+            FrameTrace::Scope scope(frameTrace, "compile", "compile");
+            viewer->compile();
+        }
 
         if (maxPagedLOD > 0)
         {
@@ -251,13 +447,24 @@ int main(int argc, char** argv)
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
+            FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+            traceFrame.phase("events");
             // pass any events into EventHandlers assigned to the Viewer
             viewer->handleEvents();
 
+            traceFrame.phase("update");
+            if (shadowAtlas) shadowAtlas->update(*camera);
             viewer->update();
 
+            if (textureStreamer) textureStreamer->update(*viewer, *camera);
+
+            if (governor) governor->update();
+
+            traceFrame.phase("record and submit");
             viewer->recordAndSubmit();
 
+            traceFrame.phase("present");
             viewer->present();
         }
 
@@ -267,6 +474,23 @@ int main(int argc, char** argv)
             double fps = static_cast<double>(fs->frameCount) / std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - viewer->start_point()).count();
             std::cout<<"Average frame rate = "<<fps<<" fps"<<std::endl;
         }
+
+        if (transcoder) transcoder->report(std::cout);
+        if (textureStreamer) textureStreamer->report(std::cout);
+        if (governor) governor->report(std::cout);
+        if (shadowAtlas) shadowAtlas->report(std::cout);
+
+        if (pipelineCache)
+        {
+            pipelineCache->save();
+            pipelineCache->report(std::cout);
+        }
+
+        if (frameTrace)
+        {
+            frameTrace->write();
+            frameTrace->report(std::cout);
+        }
     }
     catch (const vsg::Exception& ve)
     {
@@ -0,0 +1,99 @@
+#include "MultiWindowFrame.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    double milliseconds(vsg::clock::duration duration)
+    {
+        return std::chrono::duration<double, std::chrono::milliseconds::period>(duration).count();
+    }
+} // namespace
+
+MultiWindowFrame::MultiWindowFrame(vsg::ref_ptr<vsg::Viewer> in_viewer) :
+    viewer(in_viewer)
+{
+}
+
+bool MultiWindowFrame::assign(const vsg::CommandGraphs& commandGraphs)
+{
+    if (commandGraphs.empty()) return false;
+
+    auto device = commandGraphs.front()->device;
+    int queueFamily = commandGraphs.front()->queueFamily;
+    if (!device || queueFamily < 0) return false;
+
+    vsg::Windows windows;
+    for (auto& commandGraph : commandGraphs)
+    {
+        if (commandGraph->device != device || commandGraph->queueFamily != queueFamily)
+        {
+            vsg::warn("MultiWindowFrame CommandGraphs don't share a vsg::Device and queue family, using a submit per device.");
+            return false;
+        }
+        if (commandGraph->window && std::find(windows.begin(), windows.end(), commandGraph->window) == windows.end()) windows.push_back(commandGraph->window);
+    }
+
+    // one vkQueuePresentKHR needs a queue that can present to every surface, the swapchain images are owned by the graphics family so use that
+    auto physicalDevice = device->getPhysicalDevice();
+    for (auto& window : windows)
+    {
+        VkBool32 supported = VK_FALSE;
+        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice->vk(), static_cast<uint32_t>(queueFamily), window->getOrCreateSurface()->vk(), &supported);
+        if (!supported)
+        {
+            vsg::warn("MultiWindowFrame queue family ", queueFamily, " can't present to all the windows, using a present per present family.");
+            return false;
+        }
+    }
+
+    uint32_t numBuffers = 3;
+    for (auto& window : windows) numBuffers = std::max(numBuffers, static_cast<uint32_t>(window->numFrames()));
+
+    for (auto& commandGraph : commandGraphs) commandGraph->presentFamily = queueFamily;
+
+    auto queue = device->getQueue(queueFamily);
+    auto renderFinishedSemaphore = vsg::Semaphore::create(device);
+
+    auto recordAndSubmitTask = vsg::RecordAndSubmitTask::create(device, numBuffers);
+    recordAndSubmitTask->commandGraphs = commandGraphs;
+    recordAndSubmitTask->signalSemaphores.push_back(renderFinishedSemaphore);
+    recordAndSubmitTask->windows = windows;
+    recordAndSubmitTask->queue = queue;
+
+    auto presentation = vsg::Presentation::create();
+    presentation->waitSemaphores.push_back(renderFinishedSemaphore);
+    presentation->windows = windows;
+    presentation->queue = queue;
+
+    viewer->recordAndSubmitTasks = {recordAndSubmitTask};
+    viewer->presentations = {presentation};
+
+    numWindows = windows.size();
+    return true;
+}
+
+void MultiWindowFrame::recordAndSubmit()
+{
+    auto startTime = vsg::clock::now();
+    viewer->recordAndSubmit();
+    totalRecordAndSubmitTime += milliseconds(vsg::clock::now() - startTime);
+    ++numFrames;
+}
+
+void MultiWindowFrame::present()
+{
+    auto startTime = vsg::clock::now();
+    viewer->present();
+    totalPresentTime += milliseconds(vsg::clock::now() - startTime);
+}
+
+void MultiWindowFrame::report(std::ostream& out) const
+{
+    out << "MultiWindowFrame windows = " << numWindows << ", RecordAndSubmitTasks = " << viewer->recordAndSubmitTasks.size() << ", Presentations = " << viewer->presentations.size() << std::endl;
+    if (numFrames == 0) return;
+
+    double frames = static_cast<double>(numFrames);
+    out << "    frames = " << numFrames << ", average recordAndSubmit = " << totalRecordAndSubmitTime / frames << "ms, average present = " << totalPresentTime / frames << "ms" << std::endl;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <ostream>
+
+// Renders all the windows sharing a vsg::Device as one frame: a single RecordAndSubmitTask records every window's
+// CommandGraph and submits them with one vkQueueSubmit, and a single Presentation presents all the swapchains with one
+// vkQueuePresentKHR. When Viewer::setupThreading() is called afterwards the task records each CommandGraph on its own
+// thread, so the recording for the windows runs in parallel before the one submit.
+// Viewer::assignRecordAndSubmitTaskAndPresentation() also groups CommandGraphs by device, but keys them by present
+// family too, so windows whose surfaces were matched to different present families are split into separate submits and
+// presents. assign() instead presents from the graphics family when every window's surface supports it.
+// The scene graph data shared by the windows, its buffers and images, is kept per vsg::Device so it is compiled and
+// transferred once whichever window's View reaches it first; pipelines are still compiled per View.
+class MultiWindowFrame : public vsg::Inherit<vsg::Object, MultiWindowFrame>
+{
+public:
+    explicit MultiWindowFrame(vsg::ref_ptr<vsg::Viewer> in_viewer);
+
+    vsg::ref_ptr<vsg::Viewer> viewer;
+
+    // replace the viewer's RecordAndSubmitTasks and Presentations with one of each covering all commandGraphs, returns
+    // false and leaves the viewer unchanged if the CommandGraphs don't share a device and queue family that can present to every window
+    bool assign(const vsg::CommandGraphs& commandGraphs);
+
+    // timed versions of the Viewer methods, call in place of them in the frame loop
+    void recordAndSubmit();
+    void present();
+
+    // statistics
+    size_t numWindows = 0;
+    uint64_t numFrames = 0;
+    double totalRecordAndSubmitTime = 0.0; // milliseconds
+    double totalPresentTime = 0.0;         // milliseconds
+
+    void report(std::ostream& out) const;
+};
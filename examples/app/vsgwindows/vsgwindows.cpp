@@ -7,6 +7,9 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "FrameTrace.h"
+#include "MultiWindowFrame.h"
+
 vsg::ref_ptr<vsg::Camera> createCameraForScene(vsg::Node* scenegraph, int32_t x, int32_t y, uint32_t width, uint32_t height)
 {
     // compute the bounds of the scene graph to help position camera
@@ -38,6 +41,11 @@ int main(int argc, char** argv)
     windowTraits->debugLayer = arguments.read({"--debug", "-d"});
     windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
     if (arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height)) { windowTraits->fullscreen = false; }
+    auto numWindows = arguments.value<size_t>(2, "--windows");
+    bool screens = arguments.read("--screens");
+    bool singleFrame = arguments.read("--single-frame");
+
+    auto frameTrace = FrameTrace::create_if_requested(arguments);
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -45,6 +53,7 @@ int main(int argc, char** argv)
     bool multiThreading = arguments.read("--mt");
 
     auto options = vsg::Options::create();
+    if (frameTrace) frameTrace->addReaderWriter(*options);
     options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
     options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
 #ifdef vsgXchange_all
@@ -54,12 +63,27 @@ int main(int argc, char** argv)
 
     options->readOptions(arguments);
 
-    if (seperateDevices && VSG_MAX_DEVICES<2)
+    if (numWindows < 2) numWindows = 2;
+
+    if (seperateDevices && VSG_MAX_DEVICES<numWindows)
     {
-        std::cout<<"VulkanSceneGraph built with VSG_MAX_DEVICES = "<<VSG_MAX_DEVICES<<", so using a two windows, with a vsg::Device per vsg::Window is not supported."<<std::endl;
+        std::cout<<"VulkanSceneGraph built with VSG_MAX_DEVICES = "<<VSG_MAX_DEVICES<<", so using "<<numWindows<<" windows, with a vsg::Device per vsg::Window is not supported."<<std::endl;
         return 1;
     }
 
+    if (seperateDevices && singleFrame)
+    {
+        std::cout<<"--single-frame requires the windows to share a vsg::Device, ignoring it."<<std::endl;
+        singleFrame = false;
+    }
+
+    if (screens)
+    {
+        // one fullscreen window per screen
+        windowTraits->screenNum = 0;
+        windowTraits->fullscreen = true;
+    }
+
     vsg::ref_ptr<vsg::Node> scenegraph;
     vsg::ref_ptr<vsg::Node> scenegraph2;
     if (argc > 1)
@@ -96,6 +120,11 @@ int main(int argc, char** argv)
     windowTraits2->apiDumpLayer = windowTraits->apiDumpLayer;
     windowTraits2->width = 640;
     windowTraits2->height = 480;
+    if (screens)
+    {
+        windowTraits2->screenNum = 1;
+        windowTraits2->fullscreen = true;
+    }
     if (!seperateDevices)
     {
         windowTraits2->device = window1->getOrCreateDevice(); // share the same vsg::Instance/vsg::Device as window1
@@ -146,26 +175,93 @@ int main(int argc, char** argv)
     auto commandGraph2 = vsg::CommandGraph::create(window2);
     commandGraph2->addChild(secondary_RenderGraph);
 
-    viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph1, commandGraph2});
+    vsg::CommandGraphs commandGraphs{commandGraph1, commandGraph2};
+
+    // additional windows viewing the main scene graph, e.g. one per monitor of a multi-monitor station
+    for (size_t i = 2; i < numWindows; ++i)
+    {
+        auto traits = vsg::WindowTraits::create(*windowTraits2);
+        traits->windowTitle = vsg::make_string("window ", i + 1);
+        traits->device = windowTraits2->device;
+        if (screens)
+            traits->screenNum = static_cast<int>(i);
+        else
+            traits->x = windowTraits2->x + static_cast<int32_t>((i - 1) * (windowTraits2->width + 20));
+
+        auto window = vsg::Window::create(traits);
+        if (!window)
+        {
+            std::cout << "Could not create window " << i + 1 << "." << std::endl;
+            return 1;
+        }
+        viewer->addWindow(window);
+
+        auto camera = createCameraForScene(scenegraph, 0, 0, window->extent2D().width, window->extent2D().height);
+        auto trackball = vsg::Trackball::create(camera);
+        trackball->addWindow(window);
+        viewer->addEventHandler(trackball);
+
+        auto commandGraph = vsg::CommandGraph::create(window);
+        commandGraph->addChild(vsg::RenderGraph::create(window, vsg::View::create(camera, scenegraph)));
+        commandGraphs.push_back(commandGraph);
+    }
+
+    if (frameTrace)
+    {
+        for (size_t i = 0; i < commandGraphs.size(); ++i) frameTrace->addTimestamps(*commandGraphs[i], vsg::make_string("GPU window ", i + 1));
+    }
+
+    // record all the windows in one RecordAndSubmitTask with a single submit and present
+    auto multiWindowFrame = MultiWindowFrame::create(viewer);
+    if (!singleFrame || !multiWindowFrame->assign(commandGraphs))
+    {
+        viewer->assignRecordAndSubmitTaskAndPresentation(commandGraphs);
+    }
 
     if (multiThreading)
     {
         viewer->setupThreading();
     }
 
-    viewer->compile();
+    {
+        FrameTrace::Scope scope(frameTrace, "compile", "compile");
+        viewer->compile();
+    }
 
     // rendering main loop
     while (viewer->advanceToNextFrame())
     {
+        FrameTrace::Frame traceFrame(frameTrace, viewer->getFrameStamp());
+
+        traceFrame.phase("events");
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        traceFrame.phase("update");
         viewer->update();
 
-        viewer->recordAndSubmit();
+        if (singleFrame)
+        {
+            traceFrame.phase("record and submit");
+            multiWindowFrame->recordAndSubmit();
+            traceFrame.phase("present");
+            multiWindowFrame->present();
+        }
+        else
+        {
+            traceFrame.phase("record and submit");
+            viewer->recordAndSubmit();
+            traceFrame.phase("present");
+            viewer->present();
+        }
+    }
+
+    if (singleFrame) multiWindowFrame->report(std::cout);
 
-        viewer->present();
+    if (frameTrace)
+    {
+        frameTrace->write();
+        frameTrace->report(std::cout);
     }
 
     // clean up done automatically thanks to ref_ptr<>
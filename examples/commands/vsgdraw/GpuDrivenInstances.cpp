@@ -0,0 +1,232 @@
+#include "GpuDrivenInstances.h"
+
+#include <cstring>
+
+static char cull_comp[] = R"(
+#version 450
+
+layout(local_size_x = 64) in;
+
+layout(push_constant) uniform PushConstants {
+    vec4 planes[6];
+    uint numInstances;
+    uint useDrawCount;
+} pc;
+
+struct DrawIndexedIndirectCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(set = 0, binding = 0) readonly buffer Instances { vec4 instances[]; };
+layout(set = 0, binding = 1) readonly buffer MeshIDs { uint meshIDs[]; };
+layout(set = 0, binding = 2) readonly buffer Meshes { uvec4 meshes[]; };
+layout(set = 0, binding = 3) writeonly buffer DrawCommands { DrawIndexedIndirectCommand drawCommands[]; };
+layout(set = 0, binding = 4) buffer DrawCount { uint drawCount; };
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= pc.numInstances) return;
+
+    vec4 instance = instances[i];
+    uvec4 mesh = meshes[meshIDs[i]];
+    float radius = uintBitsToFloat(mesh.w) * instance.w;
+
+    bool visible = true;
+    for (int p = 0; p < 6; ++p)
+    {
+        if (dot(pc.planes[p].xyz, instance.xyz) + pc.planes[p].w < -radius) visible = false;
+    }
+
+    DrawIndexedIndirectCommand command;
+    command.indexCount = mesh.x;
+    command.instanceCount = 1;
+    command.firstIndex = mesh.y;
+    command.vertexOffset = int(mesh.z);
+    command.firstInstance = i;
+
+    if (pc.useDrawCount != 0)
+    {
+        if (visible) drawCommands[atomicAdd(drawCount, 1)] = command;
+    }
+    else
+    {
+        if (!visible) command.instanceCount = 0;
+        drawCommands[i] = command;
+    }
+}
+)";
+
+// fills in the push constants from the camera's frustum and dispatches the culling compute shader
+class CullInstances : public vsg::Inherit<vsg::Command, CullInstances>
+{
+public:
+    vsg::ref_ptr<vsg::Camera> camera;
+    vsg::ref_ptr<vsg::PipelineLayout> pipelineLayout;
+    vsg::ref_ptr<vsg::BufferInfo> drawCommands;
+    vsg::ref_ptr<vsg::BufferInfo> drawCount;
+    uint32_t numInstances = 0;
+    bool useDrawCount = false;
+
+    struct PushConstants
+    {
+        vsg::vec4 planes[6];
+        uint32_t numInstances;
+        uint32_t useDrawCount;
+    };
+
+    void record(vsg::CommandBuffer& commandBuffer) const override
+    {
+        auto deviceID = commandBuffer.deviceID;
+
+        // the previous frame's indirect draws must complete before their commands are overwritten
+        VkMemoryBarrier clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+        vkCmdFillBuffer(commandBuffer, drawCount->buffer->vk(deviceID), drawCount->offset, sizeof(uint32_t), 0);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+        // extract the world space frustum planes from the rows of the projection * view matrix
+        auto m = camera->projectionMatrix->transform() * camera->viewMatrix->transform();
+        auto row = [&m](int r) { return vsg::dvec4(m[0][r], m[1][r], m[2][r], m[3][r]); };
+        vsg::dvec4 planes[6] = {row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2)};
+
+        PushConstants pushConstants;
+        for (int p = 0; p < 6; ++p)
+        {
+            double length = vsg::length(vsg::dvec3(planes[p].x, planes[p].y, planes[p].z));
+            pushConstants.planes[p] = vsg::vec4(planes[p] / length);
+        }
+        pushConstants.numInstances = numInstances;
+        pushConstants.useDrawCount = useDrawCount ? 1 : 0;
+
+        vkCmdPushConstants(commandBuffer, pipelineLayout->vk(deviceID), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+        vkCmdDispatch(commandBuffer, (numInstances + 63) / 64, 1, 1);
+
+        VkMemoryBarrier drawBarrier{};
+        drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+    }
+};
+
+// draws the commands written by CullInstances
+class DrawInstancesIndirect : public vsg::Inherit<vsg::Command, DrawInstancesIndirect>
+{
+public:
+    vsg::ref_ptr<vsg::BufferInfo> drawCommands;
+    vsg::ref_ptr<vsg::BufferInfo> drawCount;
+    uint32_t maxDrawCount = 0;
+    PFN_vkCmdDrawIndexedIndirectCount drawIndexedIndirectCount = nullptr;
+
+    void record(vsg::CommandBuffer& commandBuffer) const override
+    {
+        auto deviceID = commandBuffer.deviceID;
+        if (drawIndexedIndirectCount)
+        {
+            drawIndexedIndirectCount(commandBuffer, drawCommands->buffer->vk(deviceID), drawCommands->offset, drawCount->buffer->vk(deviceID), drawCount->offset, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+        else
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer, drawCommands->buffer->vk(deviceID), drawCommands->offset, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+};
+
+static vsg::ref_ptr<vsg::BufferInfo> createDeviceBuffer(vsg::Device* device, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+    auto bufferInfo = vsg::BufferInfo::create();
+    bufferInfo->buffer = vsg::createBufferAndMemory(device, size, usage, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    bufferInfo->offset = 0;
+    bufferInfo->range = size;
+    return bufferInfo;
+}
+
+GpuDrivenInstances::GpuDrivenInstances(vsg::ref_ptr<vsg::Device> in_device, vsg::ref_ptr<vsg::vec4Array> in_instances, vsg::ref_ptr<vsg::uintArray> in_meshIDs, const std::vector<Mesh>& in_meshes) :
+    device(in_device),
+    instances(in_instances),
+    meshIDs(in_meshIDs),
+    numInstances(static_cast<uint32_t>(std::min(in_instances->size(), in_meshIDs->size())))
+{
+    _meshes = vsg::uivec4Array::create(static_cast<uint32_t>(in_meshes.size()));
+    for (size_t i = 0; i < in_meshes.size(); ++i)
+    {
+        auto& mesh = in_meshes[i];
+        uint32_t radiusBits;
+        std::memcpy(&radiusBits, &mesh.radius, sizeof(float));
+        _meshes->set(i, vsg::uivec4(mesh.indexCount, mesh.firstIndex, static_cast<uint32_t>(mesh.vertexOffset), radiusBits));
+    }
+
+    instancesDescriptor = vsg::DescriptorBuffer::create(instances, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+    _drawCommands = createDeviceBuffer(device, sizeof(VkDrawIndexedIndirectCommand) * std::max(numInstances, 1u), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    _drawCount = createDeviceBuffer(device, sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    // core in Vulkan 1.2, otherwise provided by VK_KHR_draw_indirect_count
+    useDrawCount = vkGetDeviceProcAddr(*device, "vkCmdDrawIndexedIndirectCount") != nullptr || vkGetDeviceProcAddr(*device, "vkCmdDrawIndexedIndirectCountKHR") != nullptr;
+}
+
+vsg::ref_ptr<vsg::Node> GpuDrivenInstances::createCullingCommands(vsg::ref_ptr<vsg::Camera> camera)
+{
+    vsg::DescriptorSetLayoutBindings descriptorBindings{
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // instances
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // mesh ids
+        {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // meshes
+        {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // draw commands
+        {4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}  // draw count
+    };
+    auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+
+    vsg::PushConstantRanges pushConstantRanges{
+        {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullInstances::PushConstants)}};
+
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, pushConstantRanges);
+    auto computeShader = vsg::ShaderStage::create(VK_SHADER_STAGE_COMPUTE_BIT, "main", cull_comp);
+    auto pipeline = vsg::ComputePipeline::create(pipelineLayout, computeShader);
+
+    vsg::Descriptors descriptors{
+        instancesDescriptor,
+        vsg::DescriptorBuffer::create(meshIDs, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+        vsg::DescriptorBuffer::create(_meshes, 2, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+        vsg::DescriptorBuffer::create(vsg::BufferInfoList{_drawCommands}, 3, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+        vsg::DescriptorBuffer::create(vsg::BufferInfoList{_drawCount}, 4, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)};
+    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, descriptors);
+
+    auto cullInstances = CullInstances::create();
+    cullInstances->camera = camera;
+    cullInstances->pipelineLayout = pipelineLayout;
+    cullInstances->drawCommands = _drawCommands;
+    cullInstances->drawCount = _drawCount;
+    cullInstances->numInstances = numInstances;
+    cullInstances->useDrawCount = useDrawCount;
+
+    auto commands = vsg::Commands::create();
+    commands->addChild(vsg::BindComputePipeline::create(pipeline));
+    commands->addChild(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, descriptorSet));
+    commands->addChild(cullInstances);
+    return commands;
+}
+
+vsg::ref_ptr<vsg::Command> GpuDrivenInstances::createDrawCommand()
+{
+    auto draw = DrawInstancesIndirect::create();
+    draw->drawCommands = _drawCommands;
+    draw->drawCount = _drawCount;
+    draw->maxDrawCount = numInstances;
+
+    if (useDrawCount)
+    {
+        auto function = vkGetDeviceProcAddr(*device, "vkCmdDrawIndexedIndirectCount");
+        if (!function) function = vkGetDeviceProcAddr(*device, "vkCmdDrawIndexedIndirectCountKHR");
+        draw->drawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(function);
+    }
+    return draw;
+}
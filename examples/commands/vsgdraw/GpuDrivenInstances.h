@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// GPU driven drawing of many instances of a set of meshes that share vertex and index arrays.
+// The per instance positions, scales and mesh ids live in storage buffers. Each frame a compute shader culls the
+// instances' bounding spheres against the camera's view frustum and writes a VkDrawIndexedIndirectCommand for each
+// visible instance along with the count, consumed by vkCmdDrawIndexedIndirectCount, so the CPU cost of recording is
+// independent of the number of instances. When the draw count isn't available, from Vulkan 1.2 or VK_KHR_draw_indirect_count,
+// a command is written for every instance, culled instances getting an instanceCount of 0, and drawn with vkCmdDrawIndexedIndirect.
+// The instance's index is passed to the vertex shader as gl_InstanceIndex via firstInstance, so the drawIndirectFirstInstance
+// and multiDrawIndirect features are required.
+class GpuDrivenInstances : public vsg::Inherit<vsg::Object, GpuDrivenInstances>
+{
+public:
+    struct Mesh
+    {
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        float radius; // radius of the bounding sphere centred on the mesh's origin
+    };
+
+    // instances are xyz position and w scale.
+    GpuDrivenInstances(vsg::ref_ptr<vsg::Device> in_device, vsg::ref_ptr<vsg::vec4Array> in_instances, vsg::ref_ptr<vsg::uintArray> in_meshIDs, const std::vector<Mesh>& in_meshes);
+
+    const vsg::ref_ptr<vsg::Device> device;
+    const vsg::ref_ptr<vsg::vec4Array> instances;
+    const vsg::ref_ptr<vsg::uintArray> meshIDs;
+    const uint32_t numInstances;
+
+    // true when vkCmdDrawIndexedIndirectCount is available
+    bool useDrawCount = false;
+
+    // storage buffer of the instances, binding 0, for use in the vertex shader's descriptor set
+    vsg::ref_ptr<vsg::DescriptorBuffer> instancesDescriptor;
+
+    // compute pass culling the instances against the camera's frustum, to be placed in the command graph before the render graph.
+    vsg::ref_ptr<vsg::Node> createCullingCommands(vsg::ref_ptr<vsg::Camera> camera);
+
+    // indirect draw to be placed in the scene graph after the graphics pipeline and the vertex and index arrays have been bound.
+    vsg::ref_ptr<vsg::Command> createDrawCommand();
+
+protected:
+    vsg::ref_ptr<vsg::uivec4Array> _meshes;
+    vsg::ref_ptr<vsg::BufferInfo> _drawCommands;
+    vsg::ref_ptr<vsg::BufferInfo> _drawCount;
+};
@@ -1,6 +1,55 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "GpuDrivenInstances.h"
+
+static char instance_vert[] = R"(
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+    mat4 modelview;
+} pc;
+
+// xyz position, w scale
+layout(set = 1, binding = 0) readonly buffer Instances { vec4 instances[]; };
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    vec4 instance = instances[gl_InstanceIndex];
+    gl_Position = (pc.projection * pc.modelview) * vec4(inPosition * instance.w + instance.xyz, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+}
+)";
+
+static char instance_frag[] = R"(
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform sampler2D texSampler;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(texSampler, fragTexCoord) * vec4(fragColor, 1.0);
+}
+)";
+
 int main(int argc, char** argv)
 {
     // set up defaults and read command line arguments to override them
@@ -10,6 +59,21 @@ int main(int argc, char** argv)
     windowTraits->debugLayer = arguments.read({"--debug", "-d"});
     windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
     arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height);
+    auto numInstances = arguments.value<uint32_t>(0, "--instances"); // draw this many instances with GPU culling and indirect draws
+    bool useDrawCount = !arguments.read("--no-draw-count");
+
+    if (numInstances > 0)
+    {
+        // the instance index is passed through firstInstance of each indirect draw command
+        windowTraits->deviceFeatures = vsg::DeviceFeatures::create();
+        windowTraits->deviceFeatures->get().multiDrawIndirect = VK_TRUE;
+        windowTraits->deviceFeatures->get().drawIndirectFirstInstance = VK_TRUE;
+        if (useDrawCount)
+        {
+            windowTraits->vulkanVersion = VK_API_VERSION_1_2;
+            windowTraits->deviceFeatures->get<VkPhysicalDeviceVulkan12Features, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES>().drawIndirectCount = VK_TRUE;
+        }
+    }
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -152,7 +216,71 @@ int main(int argc, char** argv)
     auto lookAt = vsg::LookAt::create(vsg::dvec3(1.0, 1.0, 1.0), vsg::dvec3(0.0, 0.0, 0.0), vsg::dvec3(0.0, 0.0, 1.0));
     auto camera = vsg::Camera::create(perspective, lookAt, viewport);
 
-    auto commandGraph = vsg::createCommandGraphForView(window, camera, scenegraph);
+    vsg::ref_ptr<vsg::CommandGraph> commandGraph;
+    if (numInstances > 0)
+    {
+        // lay the instances out on a grid, cycling through meshes made of the two quads and of both together
+        uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(numInstances))));
+        float spacing = 1.5f;
+        auto instances = vsg::vec4Array::create(numInstances);
+        auto meshIDs = vsg::uintArray::create(numInstances);
+        for (uint32_t i = 0; i < numInstances; ++i)
+        {
+            float x = (static_cast<float>(i % gridSize) - static_cast<float>(gridSize) * 0.5f) * spacing;
+            float y = (static_cast<float>(i / gridSize) - static_cast<float>(gridSize) * 0.5f) * spacing;
+            instances->set(i, vsg::vec4(x, y, 0.0f, 1.0f));
+            meshIDs->set(i, i % 3);
+        }
+
+        float radius = vsg::length(vsg::vec3(0.5f, 0.5f, 0.5f));
+        std::vector<GpuDrivenInstances::Mesh> meshes{
+            {6, 0, 0, radius},
+            {6, 6, 0, radius},
+            {12, 0, 0, radius}};
+
+        auto gpuInstances = GpuDrivenInstances::create(window->getOrCreateDevice(), instances, meshIDs, meshes);
+        if (!useDrawCount) gpuInstances->useDrawCount = false;
+        std::cout << "GPU culling " << numInstances << " instances, " << (gpuInstances->useDrawCount ? "using vkCmdDrawIndexedIndirectCount" : "using vkCmdDrawIndexedIndirect") << std::endl;
+
+        // the instanced shaders read the instance positions from a storage buffer in descriptor set 1
+        vsg::DescriptorSetLayoutBindings instanceBindings{
+            {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr}};
+        auto instanceSetLayout = vsg::DescriptorSetLayout::create(instanceBindings);
+
+        auto instancePipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout, instanceSetLayout}, pushConstantRanges);
+        auto instanceShaders = vsg::ShaderStages{
+            vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", instance_vert),
+            vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", instance_frag)};
+        auto instancePipeline = vsg::GraphicsPipeline::create(instancePipelineLayout, instanceShaders, pipelineStates);
+
+        auto instanceSet = vsg::DescriptorSet::create(instanceSetLayout, vsg::Descriptors{gpuInstances->instancesDescriptor});
+
+        auto instancedScenegraph = vsg::StateGroup::create();
+        instancedScenegraph->add(vsg::BindGraphicsPipeline::create(instancePipeline));
+        instancedScenegraph->add(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, instancePipelineLayout, 0, descriptorSet));
+        instancedScenegraph->add(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, instancePipelineLayout, 1, instanceSet));
+
+        auto instancedDrawCommands = vsg::Commands::create();
+        instancedDrawCommands->addChild(vsg::BindVertexBuffers::create(0, vsg::DataList{vertices, colors, texcoords}));
+        instancedDrawCommands->addChild(vsg::BindIndexBuffer::create(indices));
+        instancedDrawCommands->addChild(gpuInstances->createDrawCommand());
+        instancedScenegraph->addChild(instancedDrawCommands);
+
+        // view the grid from above, with a trackball to move the frustum around, the culling pass is recorded before the render pass
+        double gridRadius = static_cast<double>(gridSize) * spacing;
+        lookAt->eye = vsg::dvec3(0.0, -gridRadius * 0.5, gridRadius * 0.25);
+        lookAt->center = vsg::dvec3(0.0, 0.0, 0.0);
+        perspective->farDistance = gridRadius * 2.0;
+        viewer->addEventHandler(vsg::Trackball::create(camera));
+
+        commandGraph = vsg::CommandGraph::create(window);
+        commandGraph->addChild(gpuInstances->createCullingCommands(camera));
+        commandGraph->addChild(vsg::createRenderGraphForView(window, camera, instancedScenegraph));
+    }
+    else
+    {
+        commandGraph = vsg::createCommandGraphForView(window, camera, scenegraph);
+    }
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     // compile the Vulkan objects
@@ -161,6 +289,9 @@ int main(int argc, char** argv)
     // assign a CloseHandler to the Viewer to respond to pressing Escape or press the window close button
     viewer->addEventHandlers({vsg::CloseHandler::create(viewer)});
 
+    double recordAndSubmitTime = 0.0;
+    double numFramesCompleted = 0.0;
+
     // main frame loop
     while (viewer->advanceToNextFrame())
     {
@@ -173,11 +304,19 @@ int main(int argc, char** argv)
 
         viewer->update();
 
+        auto startOfRecordAndSubmit = vsg::clock::now();
+
         viewer->recordAndSubmit();
 
+        recordAndSubmitTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startOfRecordAndSubmit).count();
+        numFramesCompleted += 1.0;
+
         viewer->present();
     }
 
+    // with --instances the CPU cost stays constant whatever the number of instances
+    if (numFramesCompleted > 0.0) std::cout << "Average recordAndSubmit time " << (recordAndSubmitTime / numFramesCompleted) << " ms" << std::endl;
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -16,6 +16,7 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #    include <vsgXchange/all.h>
 #endif
 
+#include <chrono>
 #include <iostream>
 
 vsg::ref_ptr<vsg::Node> createScene(vsg::ref_ptr<const vsg::Options> options)
@@ -141,6 +142,164 @@ vsg::ref_ptr<vsg::Node> createScene(vsg::ref_ptr<const vsg::Options> options)
     return scenegraph;
 }
 
+// count the nodes in a subgraph, used to balance the subgraphs assigned to each secondary CommandGraph
+class CountNodes : public vsg::ConstVisitor
+{
+public:
+    size_t numNodes = 0;
+
+    void apply(const vsg::Object& object) override
+    {
+        ++numNodes;
+        object.traverse(*this);
+    }
+};
+
+// collect the lights in a subgraph with their transforms relative to the subgraph's root
+class CollectLights : public vsg::Visitor
+{
+public:
+    std::vector<std::pair<vsg::dmat4, vsg::ref_ptr<vsg::Light>>> lights;
+    std::vector<vsg::dmat4> matrixStack{vsg::dmat4()};
+
+    void apply(vsg::Node& node) override
+    {
+        node.traverse(*this);
+    }
+
+    void apply(vsg::Transform& transform) override
+    {
+        matrixStack.push_back(transform.transform(matrixStack.back()));
+        transform.traverse(*this);
+        matrixStack.pop_back();
+    }
+
+    void apply(vsg::Light& light) override
+    {
+        lights.emplace_back(matrixStack.back(), vsg::ref_ptr<vsg::Light>(&light));
+    }
+};
+
+// shallow copy of the node types that can sit above the split point, returns null for types that can't be copied
+vsg::ref_ptr<vsg::Group> shallowCopy(const vsg::Node& node)
+{
+    auto& type = typeid(node);
+    if (type == typeid(vsg::Group))
+    {
+        return vsg::Group::create();
+    }
+    else if (type == typeid(vsg::StateGroup))
+    {
+        auto stateGroup = vsg::StateGroup::create();
+        stateGroup->stateCommands = static_cast<const vsg::StateGroup&>(node).stateCommands;
+        return stateGroup;
+    }
+    else if (type == typeid(vsg::MatrixTransform))
+    {
+        auto& source = static_cast<const vsg::MatrixTransform&>(node);
+        auto transform = vsg::MatrixTransform::create(source.matrix);
+        transform->subgraphRequiresLocalFrustum = source.subgraphRequiresLocalFrustum;
+        return transform;
+    }
+    return {};
+}
+
+// split the scene into up to numSplits subgraphs that together draw the scene, for recording on separate threads.
+// Descends through single child Group, StateGroup and MatrixTransform nodes to the first node with several children, then
+// divides its children between the subgraphs by node count, each subgraph getting copies of the nodes above the split point.
+// Each subgraph is recorded by its own View, whose ViewDependentState only sees the lights recorded in that View, so the
+// lights found under the split point's children are added to every subgraph. Limitations: lights are collected from
+// every child of LOD and Switch nodes whether active or not, and each View renders its own shadow maps, so shadow casting
+// lights have their shadow maps rendered once per subgraph with only that subgraph's geometry casting shadows.
+std::vector<vsg::ref_ptr<vsg::Node>> splitScene(vsg::ref_ptr<vsg::Node> scene, size_t numSplits)
+{
+    std::vector<vsg::ref_ptr<const vsg::Node>> path;
+    vsg::ref_ptr<vsg::Group> splitGroup;
+    for (vsg::ref_ptr<vsg::Node> node = scene; node;)
+    {
+        auto group = node.cast<vsg::Group>();
+        if (!group || !shallowCopy(*group)) break;
+
+        if (group->children.size() >= 2)
+        {
+            splitGroup = group;
+            break;
+        }
+
+        path.push_back(node);
+        node = group->children.empty() ? vsg::ref_ptr<vsg::Node>() : group->children[0];
+    }
+
+    if (!splitGroup || numSplits < 2) return {scene};
+
+    numSplits = std::min(numSplits, splitGroup->children.size());
+
+    size_t totalNodes = 0;
+    std::vector<size_t> childNodes;
+    std::vector<decltype(CollectLights::lights)> childLights;
+    for (auto& child : splitGroup->children)
+    {
+        CountNodes countNodes;
+        child->accept(countNodes);
+        childNodes.push_back(countNodes.numNodes);
+        totalNodes += countNodes.numNodes;
+
+        CollectLights collectLights;
+        child->accept(collectLights);
+        childLights.push_back(std::move(collectLights.lights));
+    }
+
+    std::vector<vsg::ref_ptr<vsg::Node>> subgraphs;
+    size_t child = 0;
+    size_t assignedNodes = 0;
+    for (size_t split = 0; split < numSplits; ++split)
+    {
+        auto copy = shallowCopy(*splitGroup);
+        size_t firstChild = child;
+
+        // assign children until this split's share of the nodes is reached, leaving at least one child for each of the remaining splits
+        size_t targetNodes = (totalNodes * (split + 1)) / numSplits;
+        while (child < splitGroup->children.size() && (splitGroup->children.size() - child) > (numSplits - split - 1) &&
+               (copy->children.empty() || assignedNodes + childNodes[child] <= targetNodes || split + 1 == numSplits))
+        {
+            copy->addChild(splitGroup->children[child]);
+            assignedNodes += childNodes[child];
+            ++child;
+        }
+
+        // add the lights of the children assigned to the other splits
+        for (size_t i = 0; i < childLights.size(); ++i)
+        {
+            if (i >= firstChild && i < child) continue;
+
+            for (auto& [matrix, light] : childLights[i])
+            {
+                if (matrix == vsg::dmat4())
+                {
+                    copy->addChild(light);
+                }
+                else
+                {
+                    auto transform = vsg::MatrixTransform::create(matrix);
+                    transform->addChild(light);
+                    copy->addChild(transform);
+                }
+            }
+        }
+
+        vsg::ref_ptr<vsg::Node> subgraph = copy;
+        for (auto itr = path.rbegin(); itr != path.rend(); ++itr)
+        {
+            auto parent = shallowCopy(**itr);
+            parent->addChild(subgraph);
+            subgraph = parent;
+        }
+        subgraphs.push_back(subgraph);
+    }
+
+    return subgraphs;
+}
+
 int main(int argc, char** argv)
 {
     // set up defaults and read command line arguments to override them
@@ -167,6 +326,7 @@ int main(int argc, char** argv)
     if (arguments.read({"-t", "--test"})) { traits->swapchainPreferences.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR; }
     bool multiThreading = arguments.read("--mt");
     bool useExecuteCommands = !arguments.read("--no-ec"); // by default use ExecuteCommands, but allow it to be disabled using --no-ec
+    auto numSplits = arguments.value<size_t>(1, "--split"); // split the scene across this many secondary CommandGraphs
     auto numFrames = arguments.value(-1, "-f");
     auto pathFilename = arguments.value(std::string(), "-p");
 
@@ -243,24 +403,34 @@ int main(int argc, char** argv)
 
     if (useExecuteCommands)
     {
-        std::cout << "Using Secondary CommandGraph and ExecuteCommands" << std::endl;
-        auto seccommandGraph1 = vsg::createSecondaryCommandGraphForView(window1, camera, vsg_scene, 0);
-
-        auto scenegraphwin1 = vsg::Group::create();
         auto pass1 = vsg::ExecuteCommands::create();
-        pass1->connect(seccommandGraph1);
+        auto pass2 = vsg::ExecuteCommands::create();
+
+        // each secondary CommandGraph has its own command pools, with --mt the viewer records each of them on its own thread
+        vsg::CommandGraphs commandGraphs;
+        auto subgraphs = splitScene(vsg_scene, numSplits);
+        for (auto& subgraph : subgraphs)
+        {
+            auto seccommandGraph = vsg::createSecondaryCommandGraphForView(window1, camera, subgraph, 0);
+            pass1->connect(seccommandGraph);
+            pass2->connect(seccommandGraph);
+            commandGraphs.push_back(seccommandGraph);
+        }
+
+        std::cout << "Using " << subgraphs.size() << " Secondary CommandGraph and ExecuteCommands" << std::endl;
 
+        auto scenegraphwin1 = vsg::Group::create();
         auto scenegraphwin2 = vsg::Group::create();
-        auto pass2 = vsg::ExecuteCommands::create();
-        pass2->connect(seccommandGraph1);
 
         scenegraphwin1->addChild(pass1);
         scenegraphwin2->addChild(pass2);
 
         auto commandGraphwin1 = vsg::createCommandGraphForView(window1, camera, scenegraphwin1, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
         auto commandGraphwin2 = vsg::createCommandGraphForView(window2, camera, scenegraphwin2, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        commandGraphs.push_back(commandGraphwin1);
+        commandGraphs.push_back(commandGraphwin2);
 
-        viewer->assignRecordAndSubmitTaskAndPresentation({seccommandGraph1, commandGraphwin1, commandGraphwin2});
+        viewer->assignRecordAndSubmitTaskAndPresentation(commandGraphs);
     }
     else
     {
@@ -294,6 +464,9 @@ int main(int argc, char** argv)
         viewer->addEventHandler(vsg::AnimationPathHandler::create(camera, animationPath, viewer->start_point()));
     }
 
+    double recordTime = 0.0;
+    uint64_t numFramesRecorded = 0;
+
     // main frame loop
     while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
     {
@@ -302,11 +475,18 @@ int main(int argc, char** argv)
 
         viewer->update();
 
+        auto startOfRecord = vsg::clock::now();
+
         viewer->recordAndSubmit();
 
+        recordTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startOfRecord).count();
+        ++numFramesRecorded;
+
         viewer->present();
     }
 
+    if (numFramesRecorded > 0) std::cout << "Average recordAndSubmit time " << (recordTime / static_cast<double>(numFramesRecorded)) << "ms" << std::endl;
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
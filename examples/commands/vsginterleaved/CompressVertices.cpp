@@ -0,0 +1,472 @@
+#include "CompressVertices.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// GLSL decoding of the octahedral normals, for vertex shaders supporting VSG_OCTAHEDRAL_NORMALS:
+//
+//   vec3 octahedralDecode(vec2 e)
+//   {
+//       vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//       float t = max(-n.z, 0.0);
+//       n.x += (n.x >= 0.0) ? -t : t;
+//       n.y += (n.y >= 0.0) ? -t : t;
+//       return normalize(n);
+//   }
+
+static vsg::vec2 octahedralEncode(const vsg::vec3& n)
+{
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 == 0.0f) return vsg::vec2(0.0f, 0.0f);
+
+    vsg::vec2 e(n.x / l1, n.y / l1);
+    if (n.z < 0.0f)
+    {
+        auto signOf = [](float v) { return v >= 0.0f ? 1.0f : -1.0f; };
+        e = vsg::vec2((1.0f - std::abs(e.y)) * signOf(e.x), (1.0f - std::abs(e.x)) * signOf(e.y));
+    }
+    return e;
+}
+
+static uint16_t toHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(float));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t floatExponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (floatExponent == 0xff) return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0)); // inf and nan
+
+    int32_t exponent = static_cast<int32_t>(floatExponent) - 127 + 15;
+    if (exponent >= 31) return static_cast<uint16_t>(sign | 0x7c00); // overflow to inf
+    if (exponent <= 0)
+    {
+        // subnormal or zero
+        if (exponent < -10) return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1) ++half;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    // round to nearest, a carry out of the mantissa correctly increments the exponent
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) ++half;
+    return static_cast<uint16_t>(half);
+}
+
+static uint32_t numFloatComponents(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R32_SFLOAT: return 1;
+    case VK_FORMAT_R32G32_SFLOAT: return 2;
+    case VK_FORMAT_R32G32B32_SFLOAT: return 3;
+    case VK_FORMAT_R32G32B32A32_SFLOAT: return 4;
+    default: return 0;
+    }
+}
+
+template<typename T>
+static void write(uint8_t* dest, const T& value)
+{
+    std::memcpy(dest, &value, sizeof(T));
+}
+
+void CompressVertices::compress(vsg::Node& node)
+{
+    _collecting = true;
+    node.accept(*this);
+
+    for (auto& [pipeline, layout] : _layouts)
+    {
+        if (!layout.valid) continue;
+        rewritePipeline(pipeline, layout);
+        ++numPipelines;
+    }
+
+    _collecting = false;
+    node.accept(*this);
+
+    _drawPipelines.clear();
+    _compressed.clear();
+    _transforms.clear();
+}
+
+void CompressVertices::apply(vsg::Node& node)
+{
+    node.traverse(*this);
+}
+
+void CompressVertices::apply(vsg::Group& group)
+{
+    for (auto& child : group.children)
+    {
+        auto previous = _groupChild;
+        _groupChild = child.get();
+        child->accept(*this);
+        _groupChild = previous;
+
+        // the quantized positions are mapped back into the mesh's bounding box by a transform above the draw
+        if (!_collecting)
+        {
+            if (auto itr = _transforms.find(child.get()); itr != _transforms.end())
+            {
+                auto transform = vsg::MatrixTransform::create(itr->second);
+                transform->addChild(child);
+                child = transform;
+            }
+        }
+    }
+}
+
+void CompressVertices::apply(vsg::StateGroup& stateGroup)
+{
+    vsg::GraphicsPipeline* pipeline = nullptr;
+    for (auto& stateCommand : stateGroup.stateCommands)
+    {
+        if (auto bindGraphicsPipeline = stateCommand->cast<vsg::BindGraphicsPipeline>()) pipeline = bindGraphicsPipeline->pipeline.get();
+    }
+
+    if (pipeline) _pipelineStack.push_back(pipeline);
+    apply(static_cast<vsg::Group&>(stateGroup));
+    if (pipeline) _pipelineStack.pop_back();
+}
+
+void CompressVertices::apply(vsg::Commands& commands)
+{
+    for (auto& command : commands.children)
+    {
+        if (auto bindVertexBuffers = command->cast<vsg::BindVertexBuffers>()) draw(*bindVertexBuffers, bindVertexBuffers->firstBinding, bindVertexBuffers->arrays, &commands);
+    }
+}
+
+void CompressVertices::apply(vsg::VertexDraw& vd)
+{
+    draw(vd, vd.firstBinding, vd.arrays, &vd);
+}
+
+void CompressVertices::apply(vsg::VertexIndexDraw& vid)
+{
+    draw(vid, vid.firstBinding, vid.arrays, &vid);
+}
+
+void CompressVertices::apply(vsg::Geometry& geometry)
+{
+    draw(geometry, geometry.firstBinding, geometry.arrays, &geometry);
+}
+
+void CompressVertices::draw(vsg::Object& object, uint32_t firstBinding, vsg::BufferInfoList& arrays, vsg::Object* node)
+{
+    if (_collecting)
+    {
+        if (_pipelineStack.empty()) return;
+
+        auto pipeline = _pipelineStack.back();
+        auto [itr, inserted] = _layouts.try_emplace(pipeline);
+        auto& layout = itr->second;
+        if (inserted) createLayout(pipeline, layout);
+
+        // draws that aren't the direct child of a Group can't have a transform inserted above them
+        if (node != _groupChild || !checkArrays(layout, firstBinding, arrays)) layout.valid = false;
+
+        _drawPipelines[&object] = pipeline;
+        return;
+    }
+
+    auto itr = _drawPipelines.find(&object);
+    if (itr == _drawPipelines.end()) return;
+
+    auto& layout = _layouts[itr->second];
+    if (!layout.valid) return;
+
+    // shared draws are converted once but need the transform under each of their parents
+    if (_converted.count(&object) == 0)
+    {
+        CompressedKey key{&layout, {}};
+        for (auto& binding : layout.vertexBindings) key.second.push_back(arrays[binding.binding - firstBinding]->data.get());
+
+        auto compressedItr = _compressed.find(key);
+        if (compressedItr == _compressed.end())
+        {
+            for (auto& binding : layout.vertexBindings) originalSize += arrays[binding.binding - firstBinding]->data->dataSize();
+
+            compressedItr = _compressed.emplace(std::move(key), compressArrays(layout, arrays)).first;
+            compressedSize += compressedItr->second.vertices->dataSize();
+        }
+
+        vsg::BufferInfoList compressedArrays{vsg::BufferInfo::create(compressedItr->second.vertices)};
+        for (auto& binding : layout.instanceBindings) compressedArrays.push_back(arrays[binding.binding - firstBinding]);
+
+        arrays = compressedArrays;
+        _converted.insert(&object);
+        _transforms[node] = compressedItr->second.dequantize;
+        ++numDraws;
+    }
+    else
+    {
+        // the draw's arrays have already been replaced, so look up the transform by node
+        for (auto& [arraysKey, compressed] : _compressed)
+        {
+            if (compressed.vertices == arrays.front()->data) _transforms[node] = compressed.dequantize;
+        }
+    }
+}
+
+void CompressVertices::createLayout(vsg::GraphicsPipeline* pipeline, Layout& layout)
+{
+    vsg::VertexInputState* vertexInputState = nullptr;
+    for (auto& pipelineState : pipeline->pipelineStates)
+    {
+        if (auto vis = pipelineState->cast<vsg::VertexInputState>()) vertexInputState = vis;
+    }
+
+    if (!vertexInputState || vertexInputState->vertexBindingDescriptions.empty())
+    {
+        layout.valid = false;
+        return;
+    }
+
+    layout.firstBinding = std::numeric_limits<uint32_t>::max();
+    for (auto& binding : vertexInputState->vertexBindingDescriptions)
+    {
+        layout.firstBinding = std::min(layout.firstBinding, binding.binding);
+        if (binding.inputRate == VK_VERTEX_INPUT_RATE_VERTEX)
+            layout.vertexBindings.push_back(binding);
+        else
+            layout.instanceBindings.push_back(binding);
+    }
+
+    if (layout.vertexBindings.empty())
+    {
+        layout.valid = false;
+        return;
+    }
+
+    // the interleaved array takes the first binding, followed by the per instance bindings
+    std::map<uint32_t, uint32_t> instanceBindingNumbers;
+    for (size_t i = 0; i < layout.instanceBindings.size(); ++i) instanceBindingNumbers[layout.instanceBindings[i].binding] = layout.firstBinding + 1 + static_cast<uint32_t>(i);
+
+    // only vertex shaders that declare support for them get octahedral normals
+    for (auto& stage : pipeline->stages)
+    {
+        if (stage->stage == VK_SHADER_STAGE_VERTEX_BIT && stage->module && stage->module->source.find("VSG_OCTAHEDRAL_NORMALS") != std::string::npos) layout.octahedralNormals = true;
+    }
+
+    uint32_t offset = 0;
+    for (auto& attribute : vertexInputState->vertexAttributeDescriptions)
+    {
+        if (auto instanceItr = instanceBindingNumbers.find(attribute.binding); instanceItr != instanceBindingNumbers.end())
+        {
+            auto instanceAttribute = attribute;
+            instanceAttribute.binding = instanceItr->second;
+            layout.instanceAttributes.push_back(instanceAttribute);
+            continue;
+        }
+
+        auto numComponents = numFloatComponents(attribute.format);
+        if (numComponents == 0)
+        {
+            layout.valid = false;
+            return;
+        }
+
+        auto semanticItr = semantics.find(attribute.location);
+        auto semantic = semanticItr != semantics.end() ? semanticItr->second : OTHER;
+
+        VkFormat format = attribute.format;
+        uint32_t size = numComponents * 4;
+        if (semantic == POSITION && numComponents == 3)
+        {
+            format = VK_FORMAT_R16G16B16A16_UNORM;
+            size = 8;
+        }
+        else if (semantic == NORMAL && numComponents == 3)
+        {
+            format = layout.octahedralNormals ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R8G8B8A8_SNORM;
+            size = 4;
+        }
+        else if (semantic == TEXCOORD && numComponents == 2)
+        {
+            format = VK_FORMAT_R16G16_SFLOAT;
+            size = 4;
+        }
+        else if (semantic == COLOR && numComponents >= 3)
+        {
+            format = VK_FORMAT_R8G8B8A8_UNORM;
+            size = 4;
+        }
+
+        layout.attributes.emplace_back(attribute, VkVertexInputAttributeDescription{attribute.location, layout.firstBinding, format, offset});
+        offset += size;
+    }
+
+    layout.stride = offset;
+    if (layout.stride == 0) layout.valid = false;
+}
+
+bool CompressVertices::checkArrays(Layout& layout, uint32_t firstBinding, const vsg::BufferInfoList& arrays) const
+{
+    if (!layout.valid || firstBinding != layout.firstBinding) return false;
+
+    size_t numVertices = 0;
+    for (auto& binding : layout.vertexBindings)
+    {
+        size_t index = binding.binding - firstBinding;
+        if (index >= arrays.size() || !arrays[index] || !arrays[index]->data) return false;
+
+        auto& data = arrays[index]->data;
+        if (data->stride() != data->valueSize() || binding.stride == 0 || (data->dataSize() % binding.stride) != 0) return false;
+
+        size_t count = data->dataSize() / binding.stride;
+        if (numVertices != 0 && count != numVertices) return false;
+        numVertices = count;
+    }
+
+    for (auto& binding : layout.instanceBindings)
+    {
+        if (binding.binding - firstBinding >= arrays.size()) return false;
+    }
+
+    return numVertices > 0;
+}
+
+CompressVertices::Compressed CompressVertices::compressArrays(const Layout& layout, const vsg::BufferInfoList& arrays) const
+{
+    auto firstBinding = layout.firstBinding;
+    auto bindingStride = [&](uint32_t bindingNumber) {
+        for (auto& binding : layout.vertexBindings)
+        {
+            if (binding.binding == bindingNumber) return binding.stride;
+        }
+        return 0u;
+    };
+
+    auto& firstBindingDescription = layout.vertexBindings.front();
+    size_t numVertices = arrays[firstBindingDescription.binding - firstBinding]->data->dataSize() / firstBindingDescription.stride;
+
+    auto read = [&](const VkVertexInputAttributeDescription& attribute, size_t vertex, float* values) {
+        auto& data = arrays[attribute.binding - firstBinding]->data;
+        auto source = static_cast<const uint8_t*>(data->dataPointer()) + vertex * bindingStride(attribute.binding) + attribute.offset;
+        std::memcpy(values, source, numFloatComponents(attribute.format) * sizeof(float));
+    };
+
+    Compressed compressed;
+
+    // uniform scale so that the dequantizing transform doesn't skew normals
+    vsg::vec3 offset;
+    float scale = 1.0f;
+    for (auto& [original, packed] : layout.attributes)
+    {
+        if (packed.format != VK_FORMAT_R16G16B16A16_UNORM) continue;
+
+        vsg::box bounds;
+        float values[4];
+        for (size_t v = 0; v < numVertices; ++v)
+        {
+            read(original, v, values);
+            bounds.add(vsg::vec3(values[0], values[1], values[2]));
+        }
+
+        offset = bounds.min;
+        auto extents = bounds.max - bounds.min;
+        scale = std::max({extents.x, extents.y, extents.z});
+        if (scale <= 0.0f) scale = 1.0f;
+    }
+    compressed.dequantize = vsg::translate(vsg::dvec3(offset)) * vsg::scale(double(scale), double(scale), double(scale));
+
+    auto vertices = vsg::ubyteArray::create(static_cast<uint32_t>(numVertices * layout.stride));
+    auto dest = vertices->data();
+
+    for (size_t v = 0; v < numVertices; ++v)
+    {
+        for (auto& [original, packed] : layout.attributes)
+        {
+            float values[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+            read(original, v, values);
+
+            auto ptr = dest + v * layout.stride + packed.offset;
+            switch (packed.format)
+            {
+            case VK_FORMAT_R16G16B16A16_UNORM:
+                for (int c = 0; c < 3; ++c)
+                {
+                    float q = std::clamp((values[c] - offset[c]) / scale, 0.0f, 1.0f);
+                    write(ptr + c * 2, static_cast<uint16_t>(std::lround(q * 65535.0f)));
+                }
+                write(ptr + 6, uint16_t(65535));
+                break;
+            case VK_FORMAT_R16G16_SNORM: {
+                auto e = octahedralEncode(vsg::vec3(values[0], values[1], values[2]));
+                write(ptr, static_cast<int16_t>(std::lround(std::clamp(e.x, -1.0f, 1.0f) * 32767.0f)));
+                write(ptr + 2, static_cast<int16_t>(std::lround(std::clamp(e.y, -1.0f, 1.0f) * 32767.0f)));
+                break;
+            }
+            case VK_FORMAT_R8G8B8A8_SNORM: {
+                auto n = vsg::normalize(vsg::vec3(values[0], values[1], values[2]));
+                for (int c = 0; c < 3; ++c) write(ptr + c, static_cast<int8_t>(std::lround(std::clamp(n[c], -1.0f, 1.0f) * 127.0f)));
+                write(ptr + 3, int8_t(0));
+                break;
+            }
+            case VK_FORMAT_R16G16_SFLOAT:
+                write(ptr, toHalf(values[0]));
+                write(ptr + 2, toHalf(values[1]));
+                break;
+            case VK_FORMAT_R8G8B8A8_UNORM:
+                for (int c = 0; c < 4; ++c) write(ptr + c, static_cast<uint8_t>(std::lround(std::clamp(values[c], 0.0f, 1.0f) * 255.0f)));
+                break;
+            default:
+                std::memcpy(ptr, values, numFloatComponents(packed.format) * sizeof(float));
+                break;
+            }
+        }
+    }
+
+    compressed.vertices = vertices;
+    return compressed;
+}
+
+void CompressVertices::rewritePipeline(vsg::GraphicsPipeline* pipeline, const Layout& layout) const
+{
+    vsg::VertexInputState::Bindings bindings{VkVertexInputBindingDescription{layout.firstBinding, layout.stride, VK_VERTEX_INPUT_RATE_VERTEX}};
+    for (size_t i = 0; i < layout.instanceBindings.size(); ++i)
+    {
+        auto binding = layout.instanceBindings[i];
+        binding.binding = layout.firstBinding + 1 + static_cast<uint32_t>(i);
+        bindings.push_back(binding);
+    }
+
+    vsg::VertexInputState::Attributes attributes;
+    for (auto& [original, packed] : layout.attributes) attributes.push_back(packed);
+    attributes.insert(attributes.end(), layout.instanceAttributes.begin(), layout.instanceAttributes.end());
+
+    // replace rather than modify the VertexInputState as it may be shared with pipelines that aren't converted
+    for (auto& pipelineState : pipeline->pipelineStates)
+    {
+        if (pipelineState->cast<vsg::VertexInputState>()) pipelineState = vsg::VertexInputState::create(bindings, attributes);
+    }
+
+    if (!layout.octahedralNormals) return;
+
+    bool hasNormals = false;
+    for (auto& [original, packed] : layout.attributes) hasNormals = hasNormals || packed.format == VK_FORMAT_R16G16_SNORM;
+    if (!hasNormals) return;
+
+    // add the define to copies of the shader stages, modules and hints which may also be shared
+    for (auto& stage : pipeline->stages)
+    {
+        if (!stage->module || stage->module->source.empty()) continue;
+
+        auto hints = stage->module->hints ? vsg::ShaderCompileSettings::create(*stage->module->hints) : vsg::ShaderCompileSettings::create();
+        hints->defines.insert("VSG_OCTAHEDRAL_NORMALS");
+
+        auto shaderStage = vsg::ShaderStage::create(stage->stage, stage->entryPointName, vsg::ShaderModule::create(stage->module->source, hints));
+        shaderStage->specializationConstants = stage->specializationConstants;
+        stage = shaderStage;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <map>
+#include <set>
+
+// Scene optimization pass that repacks the per vertex float arrays drawn with each GraphicsPipeline into a single
+// interleaved array of compact formats, rewriting the pipeline's VertexInputState to match:
+//   position  - R16G16B16A16_UNORM, quantized to the mesh's bounding box with a uniform scale so normals are unaffected,
+//               the dequantizing scale and offset are applied by a MatrixTransform inserted above the draw.
+//   normal    - R16G16_SNORM octahedral encoding when the vertex shader source declares support for VSG_OCTAHEDRAL_NORMALS,
+//               which is then added to the shader's defines, otherwise R8G8B8A8_SNORM. Such shaders declare the normal as
+//               a vec2 and decode it as shown by octahedralDecode in CompressVertices.cpp.
+//   texcoord  - R16G16_SFLOAT.
+//   colour    - R8G8B8A8_UNORM.
+// Other per vertex attributes are copied unchanged and per instance bindings are left as they are. The fixed function
+// vertex fetch converts the normalized and half formats to float, so shaders declaring float inputs need no changes.
+// A pipeline is only converted if every draw that uses it has float arrays matching its VertexInputState.
+class CompressVertices : public vsg::Inherit<vsg::Visitor, CompressVertices>
+{
+public:
+    enum Semantic
+    {
+        POSITION,
+        NORMAL,
+        TEXCOORD,
+        COLOR,
+        OTHER
+    };
+
+    // attribute location to semantic, defaults to the layout of the VSG's standard shaders
+    std::map<uint32_t, Semantic> semantics{{0, POSITION}, {1, NORMAL}, {2, TEXCOORD}, {3, COLOR}};
+
+    // convert the subgraph
+    void compress(vsg::Node& node);
+
+    // statistics
+    size_t numPipelines = 0;
+    size_t numDraws = 0;
+    size_t originalSize = 0;   // bytes of the per vertex arrays that were replaced
+    size_t compressedSize = 0; // bytes of the interleaved arrays that replaced them
+
+    void apply(vsg::Node& node) override;
+    void apply(vsg::StateGroup& stateGroup) override;
+    void apply(vsg::Group& group) override;
+    void apply(vsg::Commands& commands) override;
+    void apply(vsg::VertexDraw& vd) override;
+    void apply(vsg::VertexIndexDraw& vid) override;
+    void apply(vsg::Geometry& geometry) override;
+
+protected:
+    struct Layout
+    {
+        bool valid = true;
+        bool octahedralNormals = false;
+        uint32_t firstBinding = 0;
+        uint32_t stride = 0;
+        std::vector<VkVertexInputBindingDescription> vertexBindings;   // bindings that are interleaved
+        std::vector<VkVertexInputBindingDescription> instanceBindings; // bindings that are left alone
+        std::vector<std::pair<VkVertexInputAttributeDescription, VkVertexInputAttributeDescription>> attributes; // original and compressed
+        std::vector<VkVertexInputAttributeDescription> instanceAttributes;                                          // with bindings renumbered
+    };
+
+    struct Compressed
+    {
+        vsg::ref_ptr<vsg::Data> vertices;
+        vsg::dmat4 dequantize;
+    };
+
+    bool _collecting = true;
+    vsg::Object* _groupChild = nullptr; // the child of a Group currently being visited, draws can only be wrapped in a transform there
+    std::vector<vsg::GraphicsPipeline*> _pipelineStack;
+    std::map<vsg::GraphicsPipeline*, Layout> _layouts;
+    std::map<vsg::Object*, vsg::GraphicsPipeline*> _drawPipelines;
+    // a draw's vertex arrays are identified by all of the arrays they're interleaved from and the layout they're packed to
+    using CompressedKey = std::pair<const Layout*, std::vector<vsg::Data*>>;
+    std::map<CompressedKey, Compressed> _compressed;
+    std::map<vsg::Object*, vsg::dmat4> _transforms;
+    std::set<vsg::Object*> _converted;
+
+    void draw(vsg::Object& object, uint32_t firstBinding, vsg::BufferInfoList& arrays, vsg::Object* node);
+    bool checkArrays(Layout& layout, uint32_t firstBinding, const vsg::BufferInfoList& arrays) const;
+    Compressed compressArrays(const Layout& layout, const vsg::BufferInfoList& arrays) const;
+    void createLayout(vsg::GraphicsPipeline* pipeline, Layout& layout);
+    void rewritePipeline(vsg::GraphicsPipeline* pipeline, const Layout& layout) const;
+};
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "CompressVertices.h"
+
 int main(int argc, char** argv)
 {
     // set up defaults and read command line arguments to override them
@@ -10,6 +12,7 @@ int main(int argc, char** argv)
     windowTraits->debugLayer = arguments.read({"--debug", "-d"});
     windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
     arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height);
+    auto compress = arguments.read("--compress");
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -110,6 +113,17 @@ int main(int argc, char** argv)
     // add drawCommands to transform
     transform->addChild(drawCommands);
 
+    if (compress)
+    {
+        // repack the float attributes into compact formats, the attribute locations follow this example's shader rather than the VSG's standard shaders
+        auto compressVertices = CompressVertices::create();
+        compressVertices->semantics = {{0, CompressVertices::POSITION}, {1, CompressVertices::COLOR}, {2, CompressVertices::TEXCOORD}};
+        compressVertices->compress(*scenegraph);
+
+        std::cout << "Compressed " << compressVertices->numDraws << " draws in " << compressVertices->numPipelines << " pipelines, vertex data "
+                  << compressVertices->originalSize << " bytes -> " << compressVertices->compressedSize << " bytes" << std::endl;
+    }
+
     // create the viewer and assign window(s) to it
     auto viewer = vsg::Viewer::create();
 
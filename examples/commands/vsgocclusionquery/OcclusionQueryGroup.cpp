@@ -0,0 +1,287 @@
+#include "OcclusionQueryGroup.h"
+
+static char proxy_vert[] = R"(
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+    mat4 modelview;
+} pc;
+
+layout(location = 0) in vec3 inPosition;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    gl_Position = (pc.projection * pc.modelview) * vec4(inPosition, 1.0);
+}
+)";
+
+static char proxy_frag[] = R"(
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+void main() {
+}
+)";
+
+OcclusionQueries::OcclusionQueries(uint32_t in_numFramesInFlight, uint32_t in_capacity) :
+    numFramesInFlight(std::max(in_numFramesInFlight, 1u)),
+    capacity(in_capacity),
+    _frames(numFramesInFlight),
+    _samples(capacity, -1)
+{
+    for (auto& frame : _frames)
+    {
+        frame.queryPool = vsg::QueryPool::create();
+        frame.queryPool->queryType = VK_QUERY_TYPE_OCCLUSION;
+        frame.queryPool->queryCount = capacity;
+        frame.issued.resize(capacity, 0);
+    }
+}
+
+uint32_t OcclusionQueries::allocate(uint32_t count)
+{
+    if (_numAllocated + count > capacity) return capacity;
+
+    uint32_t first = _numAllocated;
+    _numAllocated += count;
+    return first;
+}
+
+void OcclusionQueries::compile(vsg::Context& context)
+{
+    _device = context.device;
+    for (auto& frame : _frames) frame.queryPool->compile(context);
+}
+
+void OcclusionQueries::collect(Frame& frame) const
+{
+    // a pool is only reset by its first use, so there is nothing valid to read until that has been submitted
+    if (_numAllocated == 0 || !_device || !frame.reset) return;
+
+    // pairs of result and availability so that queries still in flight, or not issued, don't prevent reading the rest
+    std::vector<uint64_t> results(_numAllocated * 2);
+    vkGetQueryPoolResults(_device->vk(), frame.queryPool->vk(_device->deviceID), 0, _numAllocated, results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    for (uint32_t query = 0; query < _numAllocated; ++query)
+    {
+        if (!frame.issued[query]) continue;
+
+        if (results[query * 2 + 1] != 0) _samples[query] = static_cast<int64_t>(results[query * 2]);
+        else ++numUnavailable;
+
+        frame.issued[query] = 0;
+    }
+}
+
+void OcclusionQueries::record(vsg::CommandBuffer& commandBuffer) const
+{
+    _currentFrame = (_currentFrame + 1) % numFramesInFlight;
+    auto& frame = _frames[_currentFrame];
+
+    // this pool was last used numFramesInFlight frames ago so its queries have completed, if it has been used at all
+    collect(frame);
+
+    vkCmdResetQueryPool(commandBuffer.vk(), frame.queryPool->vk(commandBuffer.deviceID), 0, capacity);
+    frame.reset = true;
+}
+
+void OcclusionQueries::begin(vsg::CommandBuffer& commandBuffer, uint32_t query)
+{
+    auto& frame = _frames[_currentFrame];
+    frame.issued[query] = 1;
+    vkCmdBeginQuery(commandBuffer.vk(), frame.queryPool->vk(commandBuffer.deviceID), query, 0);
+}
+
+void OcclusionQueries::end(vsg::CommandBuffer& commandBuffer, uint32_t query)
+{
+    auto& frame = _frames[_currentFrame];
+    vkCmdEndQuery(commandBuffer.vk(), frame.queryPool->vk(commandBuffer.deviceID), query);
+}
+
+OcclusionQueryGroup::OcclusionQueryGroup(vsg::ref_ptr<OcclusionQueries> in_queries, VkSampleCountFlagBits in_samples) :
+    queries(in_queries),
+    samples(in_samples)
+{
+}
+
+vsg::ref_ptr<vsg::BindGraphicsPipeline> OcclusionQueryGroup::createProxyPipeline() const
+{
+    auto vertexShader = vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", proxy_vert);
+    auto fragmentShader = vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", proxy_frag);
+
+    vsg::PushConstantRanges pushConstantRanges{
+        {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection and modelview matrices, provided automatically by the RecordTraversal
+    };
+
+    vsg::VertexInputState::Bindings vertexBindingsDescriptions{
+        VkVertexInputBindingDescription{0, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX}};
+
+    vsg::VertexInputState::Attributes vertexAttributeDescriptions{
+        VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0}};
+
+    // draw both faces so that the box still counts when the near plane cuts through it
+    auto rasterizationState = vsg::RasterizationState::create();
+    rasterizationState->cullMode = VK_CULL_MODE_NONE;
+
+    auto multisampleState = vsg::MultisampleState::create();
+    multisampleState->rasterizationSamples = samples;
+
+    // test against, but don't write to, the depth buffer, VSG uses a reversed depth range
+    auto depthStencilState = vsg::DepthStencilState::create();
+    depthStencilState->depthWriteEnable = VK_FALSE;
+    depthStencilState->depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+
+    VkPipelineColorBlendAttachmentState noColorWrites = {};
+    noColorWrites.blendEnable = VK_FALSE;
+    noColorWrites.colorWriteMask = 0;
+    auto colorBlendState = vsg::ColorBlendState::create();
+    colorBlendState->attachments = {noColorWrites};
+
+    vsg::GraphicsPipelineStates pipelineStates{
+        vsg::VertexInputState::create(vertexBindingsDescriptions, vertexAttributeDescriptions),
+        vsg::InputAssemblyState::create(),
+        rasterizationState,
+        multisampleState,
+        colorBlendState,
+        depthStencilState};
+
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{}, pushConstantRanges);
+    auto graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
+    return vsg::BindGraphicsPipeline::create(graphicsPipeline);
+}
+
+void OcclusionQueryGroup::setup()
+{
+    _childQueries.clear();
+    _childQueries.resize(children.size());
+    _firstQuery = queries->allocate(static_cast<uint32_t>(children.size()));
+    if (_firstQuery == queries->capacity)
+    {
+        vsg::warn("OcclusionQueryGroup::setup() insufficient queries available for ", children.size(), " children, occlusion culling disabled.");
+        _childQueries.clear();
+        return;
+    }
+
+    auto bindPipeline = createProxyPipeline();
+
+    // 12 triangles of the box with corners indexed by bit 0 -> x, bit 1 -> y, bit 2 -> z
+    auto indices = vsg::ushortArray::create(
+        {0, 2, 1, 1, 2, 3,
+         4, 5, 6, 5, 7, 6,
+         0, 1, 4, 1, 5, 4,
+         2, 6, 3, 3, 6, 7,
+         0, 4, 2, 2, 4, 6,
+         1, 3, 5, 3, 7, 5});
+
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        auto& childQuery = _childQueries[i];
+
+        vsg::ComputeBounds computeBounds;
+        children[i]->accept(computeBounds);
+        childQuery.bounds = computeBounds.bounds;
+        if (!childQuery.bounds.valid()) continue;
+
+        auto& bounds = childQuery.bounds;
+        auto vertices = vsg::vec3Array::create(8);
+        for (size_t c = 0; c < 8; ++c)
+        {
+            (*vertices)[c] = vsg::vec3(vsg::dvec3((c & 1) ? bounds.max.x : bounds.min.x, (c & 2) ? bounds.max.y : bounds.min.y, (c & 4) ? bounds.max.z : bounds.min.z));
+        }
+
+        auto draw = vsg::VertexIndexDraw::create();
+        draw->assignArrays(vsg::DataList{vertices});
+        draw->assignIndices(indices);
+        draw->indexCount = static_cast<uint32_t>(indices->size());
+        draw->instanceCount = 1;
+
+        auto proxy = vsg::StateGroup::create();
+        proxy->add(bindPipeline);
+        proxy->addChild(draw);
+        childQuery.proxy = proxy;
+    }
+}
+
+void OcclusionQueryGroup::traverse(vsg::Visitor& visitor)
+{
+    Group::traverse(visitor);
+
+    if (visitor.cast<vsg::CompileTraversal>())
+    {
+        for (auto& childQuery : _childQueries)
+        {
+            if (childQuery.proxy) childQuery.proxy->accept(visitor);
+        }
+    }
+}
+
+void OcclusionQueryGroup::accept(vsg::RecordTraversal& visitor) const
+{
+    auto commandBuffer = visitor.getCommandBuffer();
+    if (_childQueries.size() != children.size() || !commandBuffer || !visitor.getFrameStamp())
+    {
+        visitor.apply(*this);
+        return;
+    }
+
+    uint64_t frameCount = visitor.getFrameStamp()->frameCount;
+    if (frameCount != _statsFrame)
+    {
+        _statsFrame = frameCount;
+        numDrawn = numOccluded = numQueried = 0;
+    }
+
+    // eye point in the local coordinate frame of the children
+    auto eye = vsg::inverse(visitor.getState()->modelviewMatrixStack.top()) * vsg::dvec3(0.0, 0.0, 0.0);
+
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        auto& childQuery = _childQueries[i];
+        if (!childQuery.proxy)
+        {
+            children[i]->accept(visitor);
+            ++numDrawn;
+            continue;
+        }
+
+        // expand the bounds slightly so that the near plane clipping the box doesn't hide a child the eye is inside
+        auto& bounds = childQuery.bounds;
+        auto margin = (bounds.max - bounds.min) * 0.01;
+        bool eyeInside = eye.x >= bounds.min.x - margin.x && eye.x <= bounds.max.x + margin.x &&
+                         eye.y >= bounds.min.y - margin.y && eye.y <= bounds.max.y + margin.y &&
+                         eye.z >= bounds.min.z - margin.z && eye.z <= bounds.max.z + margin.z;
+
+        uint32_t query = _firstQuery + static_cast<uint32_t>(i);
+        int64_t samplesPassed = queries->samples(query);
+        bool visible = eyeInside || samplesPassed != 0;
+
+        // visible children stay visible for retestInterval frames before paying for another query
+        bool requery = !eyeInside && (!visible || !childQuery.queried || (frameCount - childQuery.lastQueryFrame) >= retestInterval);
+        if (requery)
+        {
+            queries->begin(*commandBuffer, query);
+            childQuery.proxy->accept(visitor);
+            queries->end(*commandBuffer, query);
+
+            childQuery.lastQueryFrame = frameCount;
+            childQuery.queried = true;
+            ++numQueried;
+        }
+
+        if (visible)
+        {
+            children[i]->accept(visitor);
+            ++numDrawn;
+        }
+        else
+        {
+            ++numOccluded;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// Command placed at the start of a command graph, outside any render pass, that manages the occlusion queries of
+// OcclusionQueryGroups. Each frame in flight has its own query pool; before resetting the pool for the new frame the
+// results of the queries last issued with it, which the GPU has completed, are read back without waiting.
+class OcclusionQueries : public vsg::Inherit<vsg::Command, OcclusionQueries>
+{
+public:
+    explicit OcclusionQueries(uint32_t in_numFramesInFlight, uint32_t in_capacity = 4096);
+
+    const uint32_t numFramesInFlight;
+    const uint32_t capacity;
+
+    // allocate count consecutive queries, returns the first or capacity if there aren't enough left.
+    uint32_t allocate(uint32_t count);
+
+    // samples passed in the most recent completed query, negative if no result is available yet.
+    int64_t samples(uint32_t query) const { return query < _samples.size() ? _samples[query] : -1; }
+
+    void begin(vsg::CommandBuffer& commandBuffer, uint32_t query);
+    void end(vsg::CommandBuffer& commandBuffer, uint32_t query);
+
+    void compile(vsg::Context& context) override;
+    void record(vsg::CommandBuffer& commandBuffer) const override;
+
+    // queries whose results weren't available when their pool was reused
+    mutable uint64_t numUnavailable = 0;
+
+protected:
+    struct Frame
+    {
+        vsg::ref_ptr<vsg::QueryPool> queryPool;
+        std::vector<uint8_t> issued;
+        bool reset = false; // a reset of the pool has been recorded, until then its queries mustn't be read
+    };
+
+    void collect(Frame& frame) const;
+
+    mutable std::vector<Frame> _frames;
+    mutable uint32_t _currentFrame = 0;
+    mutable std::vector<int64_t> _samples;
+    uint32_t _numAllocated = 0;
+    vsg::ref_ptr<vsg::Device> _device;
+};
+
+// Group that skips recording children that the previous frames' occlusion queries found to be hidden.
+// For each child the bounding box is drawn, without writing colour or depth, within an occlusion query, the result
+// being used a frame or more later so recording never waits for the GPU. Hidden children are re-queried every frame
+// so they reappear promptly, visible children only every retestInterval frames. Children without a result yet, or
+// whose bounding box contains the eye point, are treated as visible.
+class OcclusionQueryGroup : public vsg::Inherit<vsg::Group, OcclusionQueryGroup>
+{
+public:
+    explicit OcclusionQueryGroup(vsg::ref_ptr<OcclusionQueries> in_queries, VkSampleCountFlagBits in_samples = VK_SAMPLE_COUNT_1_BIT);
+
+    vsg::ref_ptr<OcclusionQueries> queries;
+    VkSampleCountFlagBits samples;
+
+    // number of frames a visible child is drawn for before being queried again
+    uint32_t retestInterval = 8;
+
+    // create the bounding box proxies and allocate queries for the current children, call after adding the children and before compiling.
+    void setup();
+
+    // the proxies are only visited by the CompileTraversal so that other visitors such as intersectors don't see them
+    using Group::traverse;
+    void traverse(vsg::Visitor& visitor) override;
+
+    void accept(vsg::RecordTraversal& visitor) const override;
+
+    // per frame stats, reset at each frame
+    mutable uint32_t numDrawn = 0;
+    mutable uint32_t numOccluded = 0;
+    mutable uint32_t numQueried = 0;
+
+protected:
+    struct ChildQuery
+    {
+        vsg::dbox bounds;
+        vsg::ref_ptr<vsg::Node> proxy;
+        uint64_t lastQueryFrame = 0;
+        bool queried = false;
+    };
+
+    vsg::ref_ptr<vsg::BindGraphicsPipeline> createProxyPipeline() const;
+
+    uint32_t _firstQuery = 0;
+    mutable std::vector<ChildQuery> _childQueries;
+    mutable uint64_t _statsFrame = 0;
+};
@@ -1,5 +1,7 @@
 #include <vsg/all.h>
 
+#include "OcclusionQueryGroup.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -58,6 +60,8 @@ int main(int argc, char** argv)
     auto numFrames = arguments.value(-1, "-f");
     auto pathFilename = arguments.value(std::string(), "-p");
     if (arguments.read("--rgb")) options->mapRGBtoRGBAHint = false;
+    auto occlusionCulling = arguments.read("--cull");
+    auto retestInterval = arguments.value(8u, "--retest");
 
     if (int log_level = 0; arguments.read("--log-level", log_level)) vsg::Logger::instance()->level = vsg::Logger::Level(log_level);
 
@@ -145,23 +149,47 @@ int main(int argc, char** argv)
 
     auto commandGraph = vsg::CommandGraph::create(window);
 
-    // create the query pool to to collect occlusion query info
-    auto query_pool = vsg::QueryPool::create();
-    query_pool->queryType = VK_QUERY_TYPE_OCCLUSION;
-    query_pool->queryCount = 1;
+    vsg::ref_ptr<vsg::QueryPool> query_pool;
+    vsg::ref_ptr<OcclusionQueryGroup> occlusionQueryGroup;
+    if (occlusionCulling)
+    {
+        // cull the top level children of the scene, or of its root group when there is only one, using their occlusion query results
+        vsg::ref_ptr<vsg::Group> parent = group;
+        if (group->children.size() == 1)
+        {
+            if (auto childGroup = group->children[0].cast<vsg::Group>(); childGroup && typeid(*childGroup) == typeid(vsg::Group)) parent = childGroup;
+        }
+
+        auto occlusionQueries = OcclusionQueries::create(static_cast<uint32_t>(window->numFrames()));
+        commandGraph->addChild(occlusionQueries);
+
+        occlusionQueryGroup = OcclusionQueryGroup::create(occlusionQueries, windowTraits->samples);
+        occlusionQueryGroup->retestInterval = retestInterval;
+        occlusionQueryGroup->children = parent->children;
+        occlusionQueryGroup->setup();
+
+        commandGraph->addChild(vsg::createRenderGraphForView(window, camera, occlusionQueryGroup));
+    }
+    else
+    {
+        // create the query pool to to collect occlusion query info
+        query_pool = vsg::QueryPool::create();
+        query_pool->queryType = VK_QUERY_TYPE_OCCLUSION;
+        query_pool->queryCount = 1;
 
-    // reset the query pool
-    auto reset_query = vsg::ResetQueryPool::create(query_pool);
-    commandGraph->addChild(reset_query);
+        // reset the query pool
+        auto reset_query = vsg::ResetQueryPool::create(query_pool);
+        commandGraph->addChild(reset_query);
 
-    // begin query
-    commandGraph->addChild(vsg::BeginQuery::create(query_pool, 0, 0));
+        // begin query
+        commandGraph->addChild(vsg::BeginQuery::create(query_pool, 0, 0));
 
-    // add RenderGraph to render the main scene graph
-    commandGraph->addChild(vsg::createRenderGraphForView(window, camera, vsg_scene));
+        // add RenderGraph to render the main scene graph
+        commandGraph->addChild(vsg::createRenderGraphForView(window, camera, vsg_scene));
 
-    // add end query
-    commandGraph->addChild(vsg::EndQuery::create(query_pool, 0));
+        // add end query
+        commandGraph->addChild(vsg::EndQuery::create(query_pool, 0));
+    }
 
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
@@ -179,6 +207,12 @@ int main(int argc, char** argv)
 
         viewer->present();
 
+        if (occlusionQueryGroup)
+        {
+            std::cout << "drawn = " << occlusionQueryGroup->numDrawn << ", occluded = " << occlusionQueryGroup->numOccluded << ", queried = " << occlusionQueryGroup->numQueried << std::endl;
+            continue;
+        }
+
         std::vector<uint64_t> results(1);
         if (query_pool->getResults(results) == VK_SUCCESS)
         {
@@ -0,0 +1,254 @@
+#include "GpuProfiler.h"
+
+#include <fstream>
+
+namespace
+{
+    class Instrumenter : public vsg::Visitor
+    {
+    public:
+        Instrumenter(GpuProfiler& in_profiler, std::function<uint32_t(const std::string&, int32_t)> in_addScope) :
+            profiler(in_profiler),
+            addScope(in_addScope) {}
+
+        GpuProfiler& profiler;
+        std::function<uint32_t(const std::string&, int32_t)> addScope;
+        std::vector<int32_t> parentStack{-1};
+        uint32_t viewDepth = 0;
+        uint32_t stateGroupDepth = 0;
+        bool secondaryContents = false;
+
+        using Visitor::apply;
+
+        void apply(vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(vsg::Group& group) override
+        {
+            for (auto& child : group.children)
+            {
+                if (!child || child->cast<GpuProfiler::ProfileGroup>()) continue;
+
+                // only vkCmdExecuteCommands may be recorded within a subpass that uses secondary command buffers
+                if (secondaryContents) continue;
+
+                std::string name;
+                bool isView = false, isStateGroup = false, isSecondary = false;
+                if (auto renderGraph = child->cast<vsg::RenderGraph>())
+                {
+                    name = "RenderGraph";
+                    isSecondary = renderGraph->contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+                }
+                else if (auto view = child->cast<vsg::View>())
+                {
+                    name = "View " + std::to_string(view->viewID);
+                    isView = true;
+                }
+                else if (child->cast<vsg::ExecuteCommands>())
+                {
+                    name = "ExecuteCommands";
+                }
+                else if (child->cast<vsg::StateGroup>() && viewDepth > 0 && stateGroupDepth < profiler.maxStateGroupDepth)
+                {
+                    if (!child->getValue("name", name)) name = "StateGroup";
+                    isStateGroup = true;
+                }
+
+                if (name.empty())
+                {
+                    child->accept(*this);
+                    continue;
+                }
+
+                auto scope = addScope(name, parentStack.back());
+
+                parentStack.push_back(static_cast<int32_t>(scope));
+                if (isView) ++viewDepth;
+                if (isStateGroup) ++stateGroupDepth;
+                if (isSecondary) secondaryContents = true;
+
+                child->accept(*this);
+
+                if (isView) --viewDepth;
+                if (isStateGroup) --stateGroupDepth;
+                if (isSecondary) secondaryContents = false;
+                parentStack.pop_back();
+
+                auto profileGroup = GpuProfiler::ProfileGroup::create(&profiler, scope);
+                profileGroup->addChild(child);
+                child = profileGroup;
+            }
+        }
+    };
+
+    std::string escape(const std::string& str)
+    {
+        std::string result;
+        for (auto c : str)
+        {
+            if (c == '"' || c == '\\') result.push_back('\\');
+            result.push_back(c);
+        }
+        return result;
+    }
+} // namespace
+
+GpuProfiler::GpuProfiler(uint32_t in_numFramesInFlight, double in_timestampPeriod, uint32_t in_maxScopesPerFrame) :
+    numFramesInFlight(std::max(in_numFramesInFlight, 1u)),
+    timestampPeriod(in_timestampPeriod),
+    maxScopesPerFrame(in_maxScopesPerFrame),
+    _timestampQueries(TimestampQueries::create(numFramesInFlight, maxScopesPerFrame * 2)),
+    _slotScopes(numFramesInFlight)
+{
+    _timestampQueries->collect = [this](uint32_t frameIndex, uint64_t frameCount, const std::vector<uint64_t>& timestamps) { collect(frameIndex, frameCount, timestamps); };
+}
+
+uint32_t GpuProfiler::addScope(const std::string& name, int32_t parent)
+{
+    uint32_t depth = parent >= 0 ? scopes[parent].depth + 1 : 0;
+    scopes.push_back(Scope{name, parent, depth});
+    return static_cast<uint32_t>(scopes.size() - 1);
+}
+
+void GpuProfiler::instrument(vsg::CommandGraph& commandGraph)
+{
+    Instrumenter instrumenter(*this, [this](const std::string& name, int32_t parent) { return addScope(name, parent); });
+    commandGraph.accept(instrumenter);
+
+    commandGraph.children.insert(commandGraph.children.begin(), BeginFrame::create(this));
+}
+
+void GpuProfiler::compile(vsg::Context& context)
+{
+    _timestampQueries->compile(context);
+}
+
+void GpuProfiler::beginFrame(vsg::CommandBuffer& commandBuffer)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    auto frameIndex = _timestampQueries->beginFrame(commandBuffer);
+    _slotScopes[frameIndex].clear();
+}
+
+uint32_t GpuProfiler::beginScope(vsg::CommandBuffer& commandBuffer, uint32_t scope)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    auto& slotScopes = _slotScopes[_timestampQueries->currentFrame()];
+    if (!_timestampQueries->frameBegun() || slotScopes.size() >= maxScopesPerFrame) return std::numeric_limits<uint32_t>::max();
+
+    auto slot = static_cast<uint32_t>(slotScopes.size());
+    slotScopes.push_back(scope);
+
+    _timestampQueries->write(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot * 2);
+    return slot;
+}
+
+void GpuProfiler::endScope(vsg::CommandBuffer& commandBuffer, uint32_t slot)
+{
+    if (slot == std::numeric_limits<uint32_t>::max()) return;
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    _timestampQueries->write(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot * 2 + 1);
+}
+
+void GpuProfiler::collect(uint32_t frameIndex, uint64_t frameCount, const std::vector<uint64_t>& timestamps)
+{
+    auto& slotScopes = _slotScopes[frameIndex];
+
+    uint64_t frameStart = timestamps[0];
+    for (size_t i = 0; i < timestamps.size(); i += 2) frameStart = std::min(frameStart, timestamps[i]);
+
+    if (!_haveFirstTimestamp)
+    {
+        _firstTimestamp = frameStart;
+        _haveFirstTimestamp = true;
+    }
+
+    double scale = timestampPeriod * 1e-6;
+
+    FrameTimings frame;
+    frame.frameCount = frameCount;
+    frame.gpuStartMilliseconds = scale * static_cast<double>(frameStart - _firstTimestamp);
+    for (size_t slot = 0; slot < slotScopes.size(); ++slot)
+    {
+        uint64_t start = timestamps[slot * 2];
+        uint64_t end = timestamps[slot * 2 + 1];
+        frame.timings.push_back(ScopeTiming{slotScopes[slot], scale * static_cast<double>(start - frameStart), scale * static_cast<double>(end - start)});
+    }
+
+    frames.push_back(std::move(frame));
+    while (frames.size() > maxFrameHistory) frames.pop_front();
+}
+
+void GpuProfiler::collectAll()
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _timestampQueries->collectAll();
+}
+
+void GpuProfiler::print(std::ostream& out) const
+{
+    if (frames.empty()) return;
+
+    auto& frame = frames.back();
+    out << "GPU frame " << frame.frameCount << std::endl;
+    for (auto& timing : frame.timings)
+    {
+        auto& scope = scopes[timing.scope];
+        out << std::string(2 * (scope.depth + 1), ' ') << scope.name << " : " << timing.durationMilliseconds << "ms" << std::endl;
+    }
+}
+
+bool GpuProfiler::writeChromeTrace(const vsg::Path& filename) const
+{
+    std::ofstream fout(filename);
+    if (!fout) return false;
+
+    fout << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (auto& frame : frames)
+    {
+        for (auto& timing : frame.timings)
+        {
+            if (!first) fout << ",\n";
+            first = false;
+
+            double ts = (frame.gpuStartMilliseconds + timing.startMilliseconds) * 1000.0;
+            double dur = timing.durationMilliseconds * 1000.0;
+            fout << "{\"name\":\"" << escape(scopes[timing.scope].name) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":" << ts << ",\"dur\":" << dur
+                 << ",\"args\":{\"frame\":" << frame.frameCount << "}}";
+        }
+    }
+    fout << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return true;
+}
+
+void GpuProfiler::BeginFrame::compile(vsg::Context& context)
+{
+    if (auto p = profiler.ref_ptr()) p->compile(context);
+}
+
+void GpuProfiler::BeginFrame::record(vsg::CommandBuffer& commandBuffer) const
+{
+    if (auto p = profiler.ref_ptr()) p->beginFrame(commandBuffer);
+}
+
+void GpuProfiler::ProfileGroup::accept(vsg::RecordTraversal& visitor) const
+{
+    auto p = profiler.ref_ptr();
+    auto commandBuffer = visitor.getCommandBuffer();
+    if (!p || !commandBuffer)
+    {
+        traverse(visitor);
+        return;
+    }
+
+    auto slot = p->beginScope(*commandBuffer, scope);
+    traverse(visitor);
+    p->endScope(*commandBuffer, slot);
+}
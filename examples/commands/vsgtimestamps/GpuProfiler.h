@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "TimestampQueries.h"
+
+#include <list>
+#include <ostream>
+
+// Hierarchical GPU profiler built on VkQueryPool timestamps.
+// instrument() wraps the RenderGraph, View, ExecuteCommands and top level StateGroup nodes of a command graph in
+// ProfileGroup nodes that write a timestamp before and after recording their children, and inserts a BeginFrame command at
+// the start of the command graph. The timestamps go to TimestampQueries, so each frame in flight writes to its own query
+// pool and BeginFrame reads back the results of the pool it is about to reuse, which the GPU has finished with.
+// Results are kept as a per frame list of scope timings that reference the tree of scopes built by instrument().
+class GpuProfiler : public vsg::Inherit<vsg::Object, GpuProfiler>
+{
+public:
+    GpuProfiler(uint32_t in_numFramesInFlight, double in_timestampPeriod, uint32_t in_maxScopesPerFrame = 256);
+
+    const uint32_t numFramesInFlight;
+    const double timestampPeriod; // nanoseconds per timestamp tick
+    const uint32_t maxScopesPerFrame;
+
+    // depth of StateGroup nesting below each View to wrap in ProfileGroups
+    uint32_t maxStateGroupDepth = 1;
+
+    // number of frames of results to keep for export
+    size_t maxFrameHistory = 1000;
+
+    struct Scope
+    {
+        std::string name;
+        int32_t parent = -1;
+        uint32_t depth = 0;
+    };
+
+    struct ScopeTiming
+    {
+        uint32_t scope;
+        double startMilliseconds; // relative to the first timestamp of the frame
+        double durationMilliseconds;
+    };
+
+    struct FrameTimings
+    {
+        uint64_t frameCount = 0;
+        double gpuStartMilliseconds = 0.0; // relative to the first profiled frame
+        std::vector<ScopeTiming> timings;
+    };
+
+    std::vector<Scope> scopes;
+    std::list<FrameTimings> frames;
+
+    // insert the profiling commands and ProfileGroups into commandGraph
+    void instrument(vsg::CommandGraph& commandGraph);
+
+    // collect the results of the frames still pending, call after vkDeviceWaitIdle() once rendering has finished.
+    void collectAll();
+
+    // frames whose results weren't available when their query pool was reused
+    uint64_t numDroppedFrames() const { return _timestampQueries->numDroppedFrames; }
+
+    // write the per frame tree of the latest frame with results
+    void print(std::ostream& out) const;
+
+    // write the frame history in the Chrome trace event format, viewable in chrome://tracing or Perfetto.
+    bool writeChromeTrace(const vsg::Path& filename) const;
+
+    // Command placed at the start of the command graph, rotates the query pools and collects the results of completed frames.
+    class BeginFrame : public vsg::Inherit<vsg::Command, BeginFrame>
+    {
+    public:
+        explicit BeginFrame(GpuProfiler* in_profiler) :
+            profiler(in_profiler) {}
+
+        vsg::observer_ptr<GpuProfiler> profiler;
+
+        void compile(vsg::Context& context) override;
+        void record(vsg::CommandBuffer& commandBuffer) const override;
+    };
+
+    // Group that brackets the recording of its children with a pair of timestamps.
+    class ProfileGroup : public vsg::Inherit<vsg::Group, ProfileGroup>
+    {
+    public:
+        ProfileGroup(GpuProfiler* in_profiler, uint32_t in_scope) :
+            profiler(in_profiler),
+            scope(in_scope) {}
+
+        vsg::observer_ptr<GpuProfiler> profiler;
+        uint32_t scope;
+
+        void accept(vsg::RecordTraversal& visitor) const override;
+    };
+
+protected:
+    friend BeginFrame;
+    friend ProfileGroup;
+
+    uint32_t addScope(const std::string& name, int32_t parent);
+
+    void compile(vsg::Context& context);
+    void beginFrame(vsg::CommandBuffer& commandBuffer);
+    uint32_t beginScope(vsg::CommandBuffer& commandBuffer, uint32_t scope);
+    void endScope(vsg::CommandBuffer& commandBuffer, uint32_t slot);
+    void collect(uint32_t frameIndex, uint64_t frameCount, const std::vector<uint64_t>& timestamps);
+
+    std::mutex _mutex;
+    vsg::ref_ptr<TimestampQueries> _timestampQueries;
+    std::vector<std::vector<uint32_t>> _slotScopes; // per frame in flight, the scope written to each pair of queries
+    bool _haveFirstTimestamp = false;
+    uint64_t _firstTimestamp = 0;
+};
@@ -1,5 +1,7 @@
 #include <vsg/all.h>
 
+#include "GpuProfiler.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -58,6 +60,10 @@ int main(int argc, char** argv)
     auto numFrames = arguments.value(-1, "-f");
     auto pathFilename = arguments.value(std::string(), "-p");
     if (arguments.read("--rgb")) options->mapRGBtoRGBAHint = false;
+    auto profile = arguments.read("--profile");
+    auto traceFilename = arguments.value(vsg::Path(), "--trace");
+    auto profileDepth = arguments.value(1u, "--profile-depth");
+    if (traceFilename) profile = true;
 
     if (int log_level = 0; arguments.read("--log-level", log_level)) vsg::Logger::instance()->level = vsg::Logger::Level(log_level);
 
@@ -164,25 +170,39 @@ int main(int argc, char** argv)
 
     auto commandGraph = vsg::CommandGraph::create(window);
 
-    // create the query pool to to collect timing info
-    auto query_pool = vsg::QueryPool::create();
-    query_pool->queryType = VK_QUERY_TYPE_TIMESTAMP;
-    query_pool->queryCount = 2;
+    vsg::ref_ptr<vsg::QueryPool> query_pool;
+    vsg::ref_ptr<GpuProfiler> profiler;
+    if (profile)
+    {
+        // let the profiler bracket each RenderGraph, View and top level StateGroup with timestamps
+        commandGraph->addChild(vsg::createRenderGraphForView(window, camera, vsg_scene));
+
+        profiler = GpuProfiler::create(static_cast<uint32_t>(window->numFrames()), static_cast<double>(limits.timestampPeriod));
+        profiler->maxStateGroupDepth = profileDepth;
+        profiler->instrument(*commandGraph);
+    }
+    else
+    {
+        // create the query pool to to collect timing info
+        query_pool = vsg::QueryPool::create();
+        query_pool->queryType = VK_QUERY_TYPE_TIMESTAMP;
+        query_pool->queryCount = 2;
 
-    // reset the query pool
-    auto reset_query = vsg::ResetQueryPool::create(query_pool);
-    commandGraph->addChild(reset_query);
+        // reset the query pool
+        auto reset_query = vsg::ResetQueryPool::create(query_pool);
+        commandGraph->addChild(reset_query);
 
-    // write first timestamp
-    auto write1 = vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, 0);
-    commandGraph->addChild(write1);
+        // write first timestamp
+        auto write1 = vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, 0);
+        commandGraph->addChild(write1);
 
-    // add RenderGraph to render the main scene graph
-    commandGraph->addChild(vsg::createRenderGraphForView(window, camera, vsg_scene));
+        // add RenderGraph to render the main scene graph
+        commandGraph->addChild(vsg::createRenderGraphForView(window, camera, vsg_scene));
 
-    // add second timestamp
-    auto write2 = vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, 1);
-    commandGraph->addChild(write2);
+        // add second timestamp
+        auto write2 = vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, 1);
+        commandGraph->addChild(write2);
+    }
 
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
@@ -200,6 +220,12 @@ int main(int argc, char** argv)
 
         viewer->present();
 
+        if (profiler)
+        {
+            profiler->print(std::cout);
+            continue;
+        }
+
         std::vector<uint64_t> timestamps(2);
         if (query_pool->getResults(timestamps) == VK_SUCCESS)
         {
@@ -208,6 +234,19 @@ int main(int argc, char** argv)
         }
     }
 
+    if (profiler)
+    {
+        viewer->deviceWaitIdle();
+        profiler->collectAll();
+
+        if (profiler->numDroppedFrames() > 0) std::cout << "GpuProfiler dropped " << profiler->numDroppedFrames() << " frames whose results weren't ready." << std::endl;
+        if (traceFilename)
+        {
+            if (profiler->writeChromeTrace(traceFilename)) std::cout << "Written Chrome trace to " << traceFilename << std::endl;
+            else std::cout << "Unable to write Chrome trace to " << traceFilename << std::endl;
+        }
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -0,0 +1,258 @@
+#include "ThreadCacheAllocator.h"
+
+#include <unordered_map>
+
+static std::atomic_uint64_t s_nextThreadCacheAllocatorID{0};
+
+namespace
+{
+    // trivially destructible so it can still be read while the thread's, or the program's, other thread_local and static
+    // objects are destroyed, when objects freed by their destructors can call back into the allocator
+    enum ThreadCachesState : uint8_t
+    {
+        THREAD_CACHES_UNCONSTRUCTED,
+        THREAD_CACHES_ALIVE,
+        THREAD_CACHES_DESTROYED
+    };
+    thread_local ThreadCachesState s_threadCachesState = THREAD_CACHES_UNCONSTRUCTED;
+
+    // held by each thread so that its caches are marked inactive on thread exit, shared with the allocator so either may outlive the other
+    struct ThreadCaches
+    {
+        std::unordered_map<uint64_t, std::shared_ptr<void>> caches;
+        std::vector<std::atomic_bool*> activeFlags;
+
+        ThreadCaches()
+        {
+            s_threadCachesState = THREAD_CACHES_ALIVE;
+        }
+
+        ~ThreadCaches()
+        {
+            s_threadCachesState = THREAD_CACHES_DESTROYED;
+            for (auto active : activeFlags) active->store(false, std::memory_order_release);
+        }
+    };
+} // namespace
+
+ThreadCacheAllocator::ThreadCacheAllocator(std::unique_ptr<Allocator> in_nestedAllocator, size_t in_batchSize, size_t in_maxCachedPerClass) :
+    vsg::Allocator(std::move(in_nestedAllocator)),
+    batchSize(std::max(in_batchSize, size_t(1))),
+    maxCachedPerClass(std::max(in_maxCachedPerClass, batchSize)),
+    _id(s_nextThreadCacheAllocatorID++)
+{
+}
+
+bool ThreadCacheAllocator::hasLocalCache()
+{
+    return s_threadCachesState != THREAD_CACHES_DESTROYED;
+}
+
+ThreadCacheAllocator::ThreadCache& ThreadCacheAllocator::localCache()
+{
+    // keyed by id rather than address so a new ThreadCacheAllocator allocated at the address of a deleted one gets fresh caches
+    thread_local ThreadCaches s_threadCaches;
+
+    auto& cache = s_threadCaches.caches[_id];
+    if (!cache)
+    {
+        auto threadCache = std::make_shared<ThreadCache>(std::this_thread::get_id());
+        {
+            std::scoped_lock<std::mutex> lock(_cachesMutex);
+            _caches.push_back(threadCache);
+        }
+        s_threadCaches.activeFlags.push_back(&threadCache->active);
+        cache = threadCache;
+    }
+    return *static_cast<ThreadCache*>(cache.get());
+}
+
+void* ThreadCacheAllocator::allocate(std::size_t size, vsg::AllocatorAffinity allocatorAffinity)
+{
+    if (size > maxCachedSize || allocatorAffinity >= maxAffinities) return Allocator::allocate(size, allocatorAffinity);
+
+    // small allocations are always rounded up to their size class so that any freed pointer can be reused for its whole class
+    size_t index = sizeClass(size);
+    if (!hasLocalCache()) return Allocator::allocate(classSize(index), allocatorAffinity);
+
+    auto& cache = localCache();
+    auto& freeList = cache.freeLists[allocatorAffinity][index];
+    if (freeList.pointers.empty()) refill(cache, allocatorAffinity, index);
+    if (freeList.pointers.empty()) return Allocator::allocate(classSize(index), allocatorAffinity);
+
+    void* ptr = freeList.pointers.back();
+    freeList.pointers.pop_back();
+
+    cache.numHits.fetch_add(1, std::memory_order_relaxed);
+    cache.cachedBytes.fetch_sub(static_cast<int64_t>(classSize(index)), std::memory_order_relaxed);
+    return ptr;
+}
+
+bool ThreadCacheAllocator::deallocate(void* ptr, std::size_t size)
+{
+    if (ptr == nullptr || size > maxCachedSize) return Allocator::deallocate(ptr, size);
+    if (!hasLocalCache())
+    {
+        // memory in our blocks was allocated rounded up to its size class, anything else with the caller's size
+        {
+            std::scoped_lock<std::mutex> lock(mutex);
+            size_t affinity = 0;
+            if (findAffinity(ptr, affinity)) return allocatorMemoryBlocks[affinity]->deallocate(ptr, classSize(sizeClass(size)));
+        }
+        return Allocator::deallocate(ptr, size);
+    }
+
+    // the affinity of a freed pointer isn't known until its memory block is found, so defer that to the next batch
+    auto& cache = localCache();
+    cache.pending.push_back(PendingFree{ptr, static_cast<uint32_t>(sizeClass(size)), size});
+    if (cache.pending.size() >= batchSize) flushPending(cache);
+    return true;
+}
+
+bool ThreadCacheAllocator::findAffinity(void* ptr, size_t& affinity) const
+{
+    // caller must hold mutex
+    for (affinity = 0; affinity < std::min(allocatorMemoryBlocks.size(), maxAffinities); ++affinity)
+    {
+        auto& memoryBlocks = allocatorMemoryBlocks[affinity];
+        if (!memoryBlocks || memoryBlocks->memoryBlocks.empty()) continue;
+
+        auto itr = memoryBlocks->memoryBlocks.upper_bound(ptr);
+        if (itr == memoryBlocks->memoryBlocks.begin()) continue;
+        --itr;
+
+        auto& block = itr->second;
+        auto memory = static_cast<uint8_t*>(ptr);
+        if (memory >= block->memory && memory < block->memory + block->memorySlots.totalMemorySize()) return true;
+    }
+    return false;
+}
+
+void ThreadCacheAllocator::refill(ThreadCache& cache, size_t affinity, size_t index)
+{
+    if (allocatorType != vsg::ALLOCATOR_TYPE_VSG_ALLOCATOR) return;
+
+    auto& pointers = cache.freeLists[affinity][index].pointers;
+    size_t size = classSize(index);
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+
+        if (affinity >= allocatorMemoryBlocks.size() || !allocatorMemoryBlocks[affinity]) return;
+
+        auto& memoryBlocks = allocatorMemoryBlocks[affinity];
+        for (size_t i = 0; i < batchSize; ++i)
+        {
+            void* ptr = memoryBlocks->allocate(size);
+            if (!ptr) break;
+            pointers.push_back(ptr);
+        }
+    }
+
+    cache.numRefills.fetch_add(1, std::memory_order_relaxed);
+    cache.cachedBytes.fetch_add(static_cast<int64_t>(pointers.size() * size), std::memory_order_relaxed);
+}
+
+void ThreadCacheAllocator::flushPending(ThreadCache& cache)
+{
+    std::vector<PendingFree> foreign;
+    int64_t deltaBytes = 0;
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+
+        for (auto& pending : cache.pending)
+        {
+            auto [ptr, index, size] = pending;
+            size_t affinity = 0;
+            if (!findAffinity(ptr, affinity))
+            {
+                foreign.push_back(pending);
+                continue;
+            }
+
+            auto& pointers = cache.freeLists[affinity][index].pointers;
+            if (pointers.size() < maxCachedPerClass)
+            {
+                pointers.push_back(ptr);
+                deltaBytes += static_cast<int64_t>(classSize(index));
+            }
+            else
+            {
+                // found in our blocks, so allocated by allocate() or refill() rounded up to the size class
+                allocatorMemoryBlocks[affinity]->deallocate(ptr, classSize(index));
+            }
+        }
+    }
+    cache.pending.clear();
+
+    cache.numFlushes.fetch_add(1, std::memory_order_relaxed);
+    cache.cachedBytes.fetch_add(deltaBytes, std::memory_order_relaxed);
+
+    // allocated before this allocator was assigned, by the nested allocator or with an affinity outside the cached range,
+    // none of which were rounded up so they're released with the size the caller allocated
+    for (auto& pending : foreign) Allocator::deallocate(pending.ptr, pending.size);
+}
+
+void ThreadCacheAllocator::releaseCache(ThreadCache& cache)
+{
+    flushPending(cache);
+
+    int64_t deltaBytes = 0;
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+
+        for (auto& affinityFreeLists : cache.freeLists)
+        {
+            for (size_t index = 0; index < numSizeClasses; ++index)
+            {
+                auto& pointers = affinityFreeLists[index].pointers;
+                for (auto ptr : pointers)
+                {
+                    size_t affinity = 0;
+                    if (findAffinity(ptr, affinity)) allocatorMemoryBlocks[affinity]->deallocate(ptr, classSize(index));
+                }
+                deltaBytes += static_cast<int64_t>(pointers.size() * classSize(index));
+                pointers.clear();
+            }
+        }
+    }
+    cache.cachedBytes.fetch_sub(deltaBytes, std::memory_order_relaxed);
+}
+
+size_t ThreadCacheAllocator::deleteEmptyMemoryBlocks()
+{
+    if (hasLocalCache()) releaseCache(localCache());
+
+    std::vector<std::shared_ptr<ThreadCache>> exited;
+    {
+        std::scoped_lock<std::mutex> lock(_cachesMutex);
+        for (auto itr = _caches.begin(); itr != _caches.end();)
+        {
+            if (!(*itr)->active.load(std::memory_order_acquire))
+            {
+                exited.push_back(*itr);
+                itr = _caches.erase(itr);
+            }
+            else
+            {
+                ++itr;
+            }
+        }
+    }
+    for (auto& cache : exited) releaseCache(*cache);
+
+    return Allocator::deleteEmptyMemoryBlocks();
+}
+
+void ThreadCacheAllocator::report(std::ostream& out) const
+{
+    out << "ThreadCacheAllocator::report() batchSize = " << batchSize << ", maxCachedPerClass = " << maxCachedPerClass << std::endl;
+    {
+        std::scoped_lock<std::mutex> lock(_cachesMutex);
+        for (auto& cache : _caches)
+        {
+            out << "    thread " << cache->id << (cache->active ? "" : " (exited)") << " cachedBytes = " << cache->cachedBytes << ", hits = " << cache->numHits
+                << ", refills = " << cache->numRefills << ", flushes = " << cache->numFlushes << std::endl;
+        }
+    }
+    vsg::Allocator::report(out);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+// Allocator that places per thread free list caches, one for each AllocatorAffinity and size class, in front of the
+// shared memory blocks. Small allocations are served from the calling thread's cache without taking the Allocator's
+// mutex, caches are refilled from, and freed memory is returned to, the memory blocks in batches under a single lock.
+// Allocations larger than maxCachedSize, or with an affinity outside the cached range, go straight to vsg::Allocator.
+class ThreadCacheAllocator : public vsg::Allocator
+{
+public:
+    static constexpr size_t sizeGranularity = 16;
+    static constexpr size_t numSizeClasses = 16;
+    static constexpr size_t maxCachedSize = sizeGranularity * numSizeClasses;
+    static constexpr size_t maxAffinities = 4;
+
+    explicit ThreadCacheAllocator(std::unique_ptr<Allocator> in_nestedAllocator = {}, size_t in_batchSize = 32, size_t in_maxCachedPerClass = 128);
+
+    // number of pointers moved between a thread cache and the memory blocks per lock
+    const size_t batchSize;
+
+    // beyond this number of free pointers per affinity and size class a thread returns the excess to the memory blocks
+    const size_t maxCachedPerClass;
+
+    void* allocate(std::size_t size, vsg::AllocatorAffinity allocatorAffinity = vsg::ALLOCATOR_AFFINITY_OBJECTS) override;
+    bool deallocate(void* ptr, std::size_t size) override;
+
+    // returns the calling thread's cache and the caches of threads that have exited to the memory blocks before deleting empty blocks.
+    size_t deleteEmptyMemoryBlocks() override;
+
+    // reports the balance of each thread cache followed by the vsg::Allocator report.
+    void report(std::ostream& out) const override;
+
+protected:
+    struct FreeList
+    {
+        std::vector<void*> pointers;
+    };
+
+    // a freed pointer awaiting classification, with its size class and the size the caller allocated
+    struct PendingFree
+    {
+        void* ptr;
+        uint32_t index;
+        size_t size;
+    };
+
+    struct ThreadCache
+    {
+        explicit ThreadCache(std::thread::id in_id) :
+            id(in_id) {}
+
+        std::thread::id id;
+        std::array<std::array<FreeList, numSizeClasses>, maxAffinities> freeLists;
+        std::vector<PendingFree> pending;
+
+        // balances, written by the owning thread and read by report()
+        std::atomic_uint64_t numHits{0};
+        std::atomic_uint64_t numRefills{0};
+        std::atomic_uint64_t numFlushes{0};
+        std::atomic<int64_t> cachedBytes{0};
+
+        // cleared when the owning thread exits, after which the allocator may reclaim the cache
+        std::atomic_bool active{true};
+    };
+
+    static size_t sizeClass(size_t size) { return size == 0 ? 0 : (size - 1) / sizeGranularity; }
+    static size_t classSize(size_t index) { return (index + 1) * sizeGranularity; }
+
+    // false once the calling thread's caches have been destroyed, which thread exit and static destruction can outlast
+    static bool hasLocalCache();
+    ThreadCache& localCache();
+    void refill(ThreadCache& cache, size_t affinity, size_t index);
+    void flushPending(ThreadCache& cache);
+    void releaseCache(ThreadCache& cache);
+    bool findAffinity(void* ptr, size_t& affinity) const;
+
+    const uint64_t _id;
+
+    mutable std::mutex _cachesMutex;
+    std::vector<std::shared_ptr<ThreadCache>> _caches;
+};
@@ -1,14 +1,29 @@
 #include <vsg/all.h>
 
+#include "ParallelTraversal.h"
+#include "ThreadCacheAllocator.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <thread>
 
+#if defined(_WIN32)
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#    include <psapi.h>
+#else
+#    include <sys/resource.h>
+#endif
+
 class CustomAllocator : public vsg::Allocator
 {
 public:
@@ -57,10 +72,192 @@ public:
 };
 
 
+// Counts of allocations and frees, and the time spent in allocate, recorded by BenchmarkAllocator.
+struct BenchmarkStats
+{
+    static constexpr size_t maxAffinities = 8;
+
+    struct AffinityStats
+    {
+        std::atomic_uint64_t numAllocations{0};
+        std::atomic_uint64_t bytesAllocated{0};
+        std::atomic_uint64_t allocateNanoseconds{0};
+    };
+
+    std::array<AffinityStats, maxAffinities> affinityStats;
+    std::atomic_uint64_t numDeallocations{0};
+    std::atomic_uint64_t bytesDeallocated{0};
+
+    struct Fragmentation
+    {
+        std::string name;
+        size_t memorySize = 0;   // bytes held in memory blocks
+        size_t reservedSize = 0; // bytes of those in use by allocations
+    };
+
+    virtual std::vector<Fragmentation> fragmentation() const = 0;
+
+protected:
+    virtual ~BenchmarkStats() {}
+};
+
+// Allocator that records BenchmarkStats for the allocations made through the Base allocator, for benchmarking the Allocator settings.
+template<class Base>
+class BenchmarkAllocator : public Base, public BenchmarkStats
+{
+public:
+    template<typename... Args>
+    BenchmarkAllocator(Args&&... args) :
+        Base(std::forward<Args>(args)...)
+    {
+    }
+
+    void* allocate(std::size_t size, vsg::AllocatorAffinity allocatorAffinity = vsg::ALLOCATOR_AFFINITY_OBJECTS) override
+    {
+        auto start = std::chrono::steady_clock::now();
+        void* ptr = Base::allocate(size, allocatorAffinity);
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        auto& stats = affinityStats[std::min(static_cast<size_t>(allocatorAffinity), maxAffinities - 1)];
+        stats.numAllocations.fetch_add(1, std::memory_order_relaxed);
+        stats.bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+        stats.allocateNanoseconds.fetch_add(static_cast<uint64_t>(duration), std::memory_order_relaxed);
+        return ptr;
+    }
+
+    bool deallocate(void* ptr, std::size_t size) override
+    {
+        numDeallocations.fetch_add(1, std::memory_order_relaxed);
+        bytesDeallocated.fetch_add(size, std::memory_order_relaxed);
+        return Base::deallocate(ptr, size);
+    }
+
+    std::vector<Fragmentation> fragmentation() const override
+    {
+        std::scoped_lock<std::mutex> lock(this->mutex);
+
+        std::vector<Fragmentation> result;
+        for (auto& memoryBlocks : this->allocatorMemoryBlocks)
+        {
+            if (memoryBlocks) result.push_back(Fragmentation{memoryBlocks->name, memoryBlocks->totalMemorySize(), memoryBlocks->totalReservedSize()});
+            else result.push_back(Fragmentation{});
+        }
+        return result;
+    }
+};
+
+// peak resident set size of the process in bytes
+size_t peakResidentSetSize()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#    if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss);
+#    else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#    endif
+#endif
+}
+
+// repeatedly load and release the models from several threads, reporting allocator throughput, fragmentation at the peak of the churn and peak RSS.
+int runBenchmark(BenchmarkStats& allocator, const vsg::Paths& filenames, vsg::ref_ptr<vsg::Options> options, uint32_t numIterations, uint32_t numThreads)
+{
+    std::vector<BenchmarkStats::Fragmentation> peakFragmentation;
+    size_t peakMemorySize = 0;
+    std::mutex peakMutex;
+
+    auto startOfBenchmark = vsg::clock::now();
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            for (uint32_t iteration = 0; iteration < numIterations; ++iteration)
+            {
+                // each thread starts at a different model so loads and releases of different models interleave
+                auto group = vsg::Group::create();
+                for (size_t i = 0; i < filenames.size(); ++i)
+                {
+                    if (auto node = vsg::read_cast<vsg::Node>(filenames[(i + t) % filenames.size()], options)) group->addChild(node);
+                }
+
+                auto fragmentation = allocator.fragmentation();
+                size_t memorySize = 0;
+                for (auto& f : fragmentation) memorySize += f.memorySize;
+                {
+                    std::scoped_lock<std::mutex> lock(peakMutex);
+                    if (memorySize > peakMemorySize)
+                    {
+                        peakMemorySize = memorySize;
+                        peakFragmentation = fragmentation;
+                    }
+                }
+
+                // release the loaded subgraphs before the next reload
+                group = {};
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    double duration = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startOfBenchmark).count();
+
+    uint64_t numAllocations = 0;
+    uint64_t allocateNanoseconds = 0;
+    for (auto& stats : allocator.affinityStats)
+    {
+        numAllocations += stats.numAllocations;
+        allocateNanoseconds += stats.allocateNanoseconds;
+    }
+
+    std::cout << "Benchmark of " << numIterations << " iterations of loading " << filenames.size() << " models on " << numThreads << " threads took " << duration << "s" << std::endl;
+    std::cout << "  allocations = " << numAllocations << ", " << (static_cast<double>(numAllocations) / duration) << " per second" << std::endl;
+    std::cout << "  frees = " << allocator.numDeallocations << ", " << (static_cast<double>(allocator.numDeallocations) / duration) << " per second" << std::endl;
+    std::cout << "  time in Allocator::allocate = " << (static_cast<double>(allocateNanoseconds) * 1e-6) << "ms" << std::endl;
+    std::cout << "  peak RSS = " << peakResidentSetSize() << " bytes" << std::endl;
+
+    for (size_t i = 0; i < BenchmarkStats::maxAffinities; ++i)
+    {
+        auto& stats = allocator.affinityStats[i];
+        if (stats.numAllocations == 0) continue;
+
+        std::cout << "  affinity " << i;
+        if (i < peakFragmentation.size())
+        {
+            auto& f = peakFragmentation[i];
+            double fragmentationRatio = f.memorySize > 0 ? 1.0 - static_cast<double>(f.reservedSize) / static_cast<double>(f.memorySize) : 0.0;
+            std::cout << " " << f.name << " : peak reserved = " << f.memorySize << ", peak used = " << f.reservedSize << ", fragmentation = " << (fragmentationRatio * 100.0) << "%";
+        }
+        std::cout << ", allocations = " << stats.numAllocations << ", bytes = " << stats.bytesAllocated << ", allocate time = " << (static_cast<double>(stats.allocateNanoseconds) * 1e-6) << "ms" << std::endl;
+    }
+
+    return 0;
+}
+
 struct SceneStatstics : public vsg::Inherit<vsg::ConstVisitor, SceneStatstics>
 {
     std::map<const char*, size_t> objectCounts;
 
+    // optional ParallelTraversal that large groups are split across
+    vsg::ref_ptr<experimental::ParallelTraversal> parallelTraversal;
+
+    vsg::ref_ptr<SceneStatstics> clone() const
+    {
+        auto statistics = SceneStatstics::create();
+        statistics->parallelTraversal = parallelTraversal;
+        return statistics;
+    }
+
+    void merge(const SceneStatstics& other)
+    {
+        for(auto& [str, count] : other.objectCounts) objectCounts[str] += count;
+    }
+
     void report(std::ostream& out)
     {
         for(auto& [str, count] : objectCounts) out<<"  "<<str<<" "<<count<<std::endl;
@@ -72,6 +269,13 @@ struct SceneStatstics : public vsg::Inherit<vsg::ConstVisitor, SceneStatstics>
         node.traverse(*this);
     }
 
+    void apply(const vsg::Group& group) override
+    {
+        ++objectCounts[group.className()];
+        if (parallelTraversal && parallelTraversal->traverse(group, *this)) return;
+        group.traverse(*this);
+    }
+
     void apply(const vsg::StateGroup& stateGroup) override
     {
         ++objectCounts[stateGroup.className()];
@@ -92,6 +296,27 @@ int main(int argc, char** argv)
 
     // Allocaotor related command line settings
     if (arguments.read("--custom")) vsg::Allocator::instance().reset(new CustomAllocator(std::move(vsg::Allocator::instance())));
+    auto benchmarkIterations = arguments.value<uint32_t>(0, "--benchmark");
+    auto benchmarkThreads = arguments.value<uint32_t>(4, "--benchmark-threads");
+    bool threadCache = arguments.read("--thread-cache");
+    auto threadCacheBatchSize = arguments.value<size_t>(32, "--thread-cache-batch");
+    BenchmarkStats* benchmarkAllocator = nullptr;
+    if (benchmarkIterations > 0 && threadCache)
+    {
+        auto allocator = new BenchmarkAllocator<ThreadCacheAllocator>(std::move(vsg::Allocator::instance()), threadCacheBatchSize);
+        vsg::Allocator::instance().reset(allocator);
+        benchmarkAllocator = allocator;
+    }
+    else if (benchmarkIterations > 0)
+    {
+        auto allocator = new BenchmarkAllocator<vsg::Allocator>(std::move(vsg::Allocator::instance()));
+        vsg::Allocator::instance().reset(allocator);
+        benchmarkAllocator = allocator;
+    }
+    else if (threadCache)
+    {
+        vsg::Allocator::instance().reset(new ThreadCacheAllocator(std::move(vsg::Allocator::instance()), threadCacheBatchSize));
+    }
     if (int mt; arguments.read({"--memory-tracking", "--mt"}, mt)) vsg::Allocator::instance()->setMemoryTracking(mt);
     if (int type; arguments.read("--allocator", type)) vsg::Allocator::instance()->allocatorType = vsg::AllocatorType(type);
     if (int  type; arguments.read("--blocks", type)) vsg::Allocator::instance()->memoryBlocksAllocatorType = vsg::AllocatorType(type);
@@ -164,6 +389,8 @@ int main(int argc, char** argv)
         size_t stats = 0;
         if (arguments.read("--stats")) stats = 1;
         if (arguments.read("--num-stats", stats)) {}
+        auto numStatsThreads = arguments.value(0u, "--stats-threads");
+        auto minSubtreeSize = arguments.value(size_t(10000), "--min-subtree");
 
         bool useViewer = !arguments.read("--no-viewer");
 
@@ -185,6 +412,14 @@ int main(int argc, char** argv)
             return 1;
         }
 
+        if (benchmarkAllocator)
+        {
+            vsg::Paths filenames;
+            for (int i = 1; i < argc; ++i) filenames.push_back(arguments[i]);
+
+            return runBenchmark(*benchmarkAllocator, filenames, options, benchmarkIterations, benchmarkThreads);
+        }
+
         // record time point just before loading the scene graph
         auto startOfLoad = vsg::clock::now();
 
@@ -224,6 +459,10 @@ int main(int argc, char** argv)
             auto startOfStats = vsg::clock::now();
 
             auto sceneStatistics = SceneStatstics::create();
+            if (numStatsThreads > 0)
+            {
+                sceneStatistics->parallelTraversal = experimental::ParallelTraversal::create(vsg::OperationThreads::create(numStatsThreads), minSubtreeSize);
+            }
 
             for(size_t i=0; i<stats; ++i)
             {
@@ -233,7 +472,9 @@ int main(int argc, char** argv)
 
             auto statsDuration = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startOfStats).count();
 
-            std::cout<<"Stats collection took "<<statsDuration<<"ms"<<" for "<<stats<<" traversals."<<std::endl;
+            std::cout<<"Stats collection took "<<statsDuration<<"ms"<<" for "<<stats<<" traversals";
+            if (numStatsThreads > 0) std::cout<<" with "<<numStatsThreads<<" threads";
+            std::cout<<"."<<std::endl;
             sceneStatistics->report(std::cout);
         }
 
@@ -0,0 +1,708 @@
+#include "ArrayKernels.h"
+#include "ParallelTraversal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#    define ARRAYKERNELS_AVX2
+#    include <immintrin.h>
+#    if defined(__GNUC__) || defined(__clang__)
+#        define ARRAYKERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#    else
+#        include <intrin.h>
+#        define ARRAYKERNELS_TARGET_AVX2
+#    endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#    define ARRAYKERNELS_NEON
+#    include <arm_neon.h>
+#endif
+
+namespace
+{
+    // call func(task, begin, end) over ranges of [0, n), splitting them across operationThreads when n is large enough,
+    // returns the number of tasks so that callers can size per task results
+    size_t parallelFor(vsg::OperationThreads* operationThreads, size_t parallelThreshold, size_t n, const std::function<void(size_t, size_t, size_t)>& func)
+    {
+        size_t numTasks = 1;
+        if (operationThreads && n > parallelThreshold) numTasks = std::min(operationThreads->threads.size() + 1, n / std::max(parallelThreshold / 2, size_t(1)));
+
+        std::vector<std::function<void()>> tasks;
+        tasks.reserve(numTasks);
+        for (size_t t = 0; t < numTasks; ++t)
+        {
+            tasks.push_back([&func, t, n, numTasks]() { func(t, (n * t) / numTasks, (n * (t + 1)) / numTasks); });
+        }
+
+        experimental::runTasks(operationThreads, tasks);
+        return numTasks;
+    }
+
+    bool isAffine(const vsg::mat4& m) { return m[0][3] == 0.0f && m[1][3] == 0.0f && m[2][3] == 0.0f && m[3][3] == 1.0f; }
+    bool isAffine(const vsg::dmat4& m) { return m[0][3] == 0.0 && m[1][3] == 0.0 && m[2][3] == 0.0 && m[3][3] == 1.0; }
+
+    template<class A>
+    bool contiguous(const A& array) { return array.stride() == sizeof(typename A::value_type); }
+
+    //
+    // scalar kernels, m is column major
+    //
+    template<typename T>
+    void transform3Scalar(const T* m, T* p, size_t n)
+    {
+        for (T* end = p + n * 3; p < end; p += 3)
+        {
+            T x = p[0], y = p[1], z = p[2];
+            p[0] = m[0] * x + m[4] * y + m[8] * z + m[12];
+            p[1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+            p[2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+        }
+    }
+
+    void transform4Scalar(const float* m, float* p, size_t n)
+    {
+        for (float* end = p + n * 4; p < end; p += 4)
+        {
+            float x = p[0], y = p[1], z = p[2], w = p[3];
+            p[0] = m[0] * x + m[4] * y + m[8] * z + m[12] * w;
+            p[1] = m[1] * x + m[5] * y + m[9] * z + m[13] * w;
+            p[2] = m[2] * x + m[6] * y + m[10] * z + m[14] * w;
+            p[3] = m[3] * x + m[7] * y + m[11] * z + m[15] * w;
+        }
+    }
+
+    void bounds3Scalar(const float* p, size_t n, float* minimum, float* maximum)
+    {
+        for (const float* end = p + n * 3; p < end; p += 3)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                minimum[i] = std::min(minimum[i], p[i]);
+                maximum[i] = std::max(maximum[i], p[i]);
+            }
+        }
+    }
+
+    float maxDistance2Scalar(const float* p, size_t n, const float* c)
+    {
+        float result = 0.0f;
+        for (const float* end = p + n * 3; p < end; p += 3)
+        {
+            float dx = p[0] - c[0], dy = p[1] - c[1], dz = p[2] - c[2];
+            result = std::max(result, dx * dx + dy * dy + dz * dz);
+        }
+        return result;
+    }
+
+    void convert3Scalar(const double* src, float* dst, size_t n, const double* origin)
+    {
+        for (size_t i = 0; i < n * 3; ++i) dst[i] = static_cast<float>(src[i] - origin[i % 3]);
+    }
+
+    void normalize3Scalar(float* p, size_t n)
+    {
+        for (float* end = p + n * 3; p < end; p += 3)
+        {
+            float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+            if (length <= 0.0f) continue;
+            float inv = 1.0f / length;
+            p[0] *= inv;
+            p[1] *= inv;
+            p[2] *= inv;
+        }
+    }
+
+#if defined(ARRAYKERNELS_AVX2)
+    //
+    // AVX2 kernels, vec3 arrays are processed eight elements at a time by loading vertices 0-3 into the low 128 bit
+    // lanes and 4-7 into the high ones, then shuffling each lane from xyz triples into x, y and z vectors and back.
+    //
+    struct XYZ8
+    {
+        __m256 x, y, z;
+    };
+
+    ARRAYKERNELS_TARGET_AVX2 inline __m256 load2x128(const float* lo, const float* hi)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 inline void store2x128(float* lo, float* hi, __m256 v)
+    {
+        _mm_storeu_ps(lo, _mm256_castps256_ps128(v));
+        _mm_storeu_ps(hi, _mm256_extractf128_ps(v, 1));
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 inline XYZ8 load8(const float* p)
+    {
+        // per lane a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+        __m256 a = load2x128(p, p + 12);
+        __m256 b = load2x128(p + 4, p + 16);
+        __m256 c = load2x128(p + 8, p + 20);
+
+        XYZ8 v;
+        v.x = _mm256_shuffle_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)), _mm256_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+        v.y = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        v.z = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm256_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+        return v;
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 inline void store8(float* p, const XYZ8& v)
+    {
+        __m256 a = _mm256_shuffle_ps(_mm256_shuffle_ps(v.x, v.y, _MM_SHUFFLE(0, 0, 0, 0)), _mm256_shuffle_ps(v.z, v.x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 b = _mm256_shuffle_ps(_mm256_shuffle_ps(v.y, v.z, _MM_SHUFFLE(1, 1, 1, 1)), _mm256_shuffle_ps(v.x, v.y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 c = _mm256_shuffle_ps(_mm256_shuffle_ps(v.z, v.x, _MM_SHUFFLE(3, 3, 2, 2)), _mm256_shuffle_ps(v.y, v.z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        store2x128(p, p + 12, a);
+        store2x128(p + 4, p + 16, b);
+        store2x128(p + 8, p + 20, c);
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 size_t transform3AVX2(const float* m, float* p, size_t n)
+    {
+        __m256 mv[12];
+        for (int c = 0; c < 4; ++c)
+        {
+            for (int r = 0; r < 3; ++r) mv[c * 3 + r] = _mm256_set1_ps(m[c * 4 + r]);
+        }
+
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8, p += 24)
+        {
+            XYZ8 v = load8(p);
+            XYZ8 result;
+            result.x = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(mv[0], v.x), _mm256_mul_ps(mv[3], v.y)), _mm256_add_ps(_mm256_mul_ps(mv[6], v.z), mv[9]));
+            result.y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(mv[1], v.x), _mm256_mul_ps(mv[4], v.y)), _mm256_add_ps(_mm256_mul_ps(mv[7], v.z), mv[10]));
+            result.z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(mv[2], v.x), _mm256_mul_ps(mv[5], v.y)), _mm256_add_ps(_mm256_mul_ps(mv[8], v.z), mv[11]));
+            store8(p, result);
+        }
+        return i;
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 size_t transform3dAVX2(const double* m, double* p, size_t n)
+    {
+        // one element per vector, the columns broadcast by its coordinates
+        __m256d c0 = _mm256_loadu_pd(m), c1 = _mm256_loadu_pd(m + 4), c2 = _mm256_loadu_pd(m + 8), c3 = _mm256_loadu_pd(m + 12);
+        __m256i xyz = _mm256_set_epi64x(0, -1, -1, -1);
+
+        size_t i = 0;
+        for (; i < n; ++i, p += 3)
+        {
+            __m256d r = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(c0, _mm256_broadcast_sd(p)), _mm256_mul_pd(c1, _mm256_broadcast_sd(p + 1))), _mm256_add_pd(_mm256_mul_pd(c2, _mm256_broadcast_sd(p + 2)), c3));
+            _mm256_maskstore_pd(p, xyz, r);
+        }
+        return i;
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 size_t transform4AVX2(const float* m, float* p, size_t n)
+    {
+        // two elements per vector, each lane holding the columns broadcast by its element's coordinates
+        __m256 c0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m));
+        __m256 c1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 4));
+        __m256 c2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 8));
+        __m256 c3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 12));
+
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2, p += 8)
+        {
+            __m256 v = _mm256_loadu_ps(p);
+            __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c0, _mm256_permute_ps(v, 0x00)), _mm256_mul_ps(c1, _mm256_permute_ps(v, 0x55))),
+                                     _mm256_add_ps(_mm256_mul_ps(c2, _mm256_permute_ps(v, 0xaa)), _mm256_mul_ps(c3, _mm256_permute_ps(v, 0xff))));
+            _mm256_storeu_ps(p, r);
+        }
+        return i;
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 inline float horizontalMin(__m256 v)
+    {
+        __m128 m = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+        m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(m);
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 inline float horizontalMax(__m256 v)
+    {
+        __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(m);
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 size_t bounds3AVX2(const float* p, size_t n, float* minimum, float* maximum)
+    {
+        if (n < 8) return 0;
+
+        XYZ8 lo = load8(p), hi = lo;
+        size_t i = 8;
+        for (p += 24; i + 8 <= n; i += 8, p += 24)
+        {
+            XYZ8 v = load8(p);
+            lo.x = _mm256_min_ps(lo.x, v.x);
+            lo.y = _mm256_min_ps(lo.y, v.y);
+            lo.z = _mm256_min_ps(lo.z, v.z);
+            hi.x = _mm256_max_ps(hi.x, v.x);
+            hi.y = _mm256_max_ps(hi.y, v.y);
+            hi.z = _mm256_max_ps(hi.z, v.z);
+        }
+
+        minimum[0] = std::min(minimum[0], horizontalMin(lo.x));
+        minimum[1] = std::min(minimum[1], horizontalMin(lo.y));
+        minimum[2] = std::min(minimum[2], horizontalMin(lo.z));
+        maximum[0] = std::max(maximum[0], horizontalMax(hi.x));
+        maximum[1] = std::max(maximum[1], horizontalMax(hi.y));
+        maximum[2] = std::max(maximum[2], horizontalMax(hi.z));
+        return i;
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 size_t maxDistance2AVX2(const float* p, size_t n, const float* c, float& result)
+    {
+        __m256 cx = _mm256_set1_ps(c[0]), cy = _mm256_set1_ps(c[1]), cz = _mm256_set1_ps(c[2]);
+        __m256 d2 = _mm256_setzero_ps();
+
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8, p += 24)
+        {
+            XYZ8 v = load8(p);
+            __m256 dx = _mm256_sub_ps(v.x, cx), dy = _mm256_sub_ps(v.y, cy), dz = _mm256_sub_ps(v.z, cz);
+            d2 = _mm256_max_ps(d2, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+        }
+
+        result = std::max(result, horizontalMax(d2));
+        return i;
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 size_t convert3AVX2(const double* src, float* dst, size_t n, const double* origin)
+    {
+        // four elements at a time as twelve consecutive doubles, the origin repeating every three
+        __m256d o0 = _mm256_setr_pd(origin[0], origin[1], origin[2], origin[0]);
+        __m256d o1 = _mm256_setr_pd(origin[1], origin[2], origin[0], origin[1]);
+        __m256d o2 = _mm256_setr_pd(origin[2], origin[0], origin[1], origin[2]);
+
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4, src += 12, dst += 12)
+        {
+            _mm_storeu_ps(dst, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(src), o0)));
+            _mm_storeu_ps(dst + 4, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(src + 4), o1)));
+            _mm_storeu_ps(dst + 8, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(src + 8), o2)));
+        }
+        return i;
+    }
+
+    ARRAYKERNELS_TARGET_AVX2 size_t normalize3AVX2(float* p, size_t n)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8, p += 24)
+        {
+            XYZ8 v = load8(p);
+            __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(v.x, v.x), _mm256_mul_ps(v.y, v.y)), _mm256_mul_ps(v.z, v.z)));
+            __m256 nonzero = _mm256_cmp_ps(length, zero, _CMP_GT_OQ);
+            __m256 inv = _mm256_blendv_ps(one, _mm256_div_ps(one, length), nonzero);
+            v.x = _mm256_mul_ps(v.x, inv);
+            v.y = _mm256_mul_ps(v.y, inv);
+            v.z = _mm256_mul_ps(v.z, inv);
+            store8(p, v);
+        }
+        return i;
+    }
+
+    bool cpuSupportsAVX2()
+    {
+#    if defined(__GNUC__) || defined(__clang__)
+        return __builtin_cpu_supports("avx2");
+#    else
+        int info[4];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#    endif
+    }
+#endif
+
+#if defined(ARRAYKERNELS_NEON)
+    //
+    // NEON kernels, vld3/vst3 deinterleave and interleave xyz triples directly
+    //
+    size_t transform3NEON(const float* m, float* p, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4, p += 12)
+        {
+            float32x4x3_t v = vld3q_f32(p);
+            float32x4x3_t result;
+            for (int r = 0; r < 3; ++r)
+            {
+                float32x4_t acc = vdupq_n_f32(m[12 + r]);
+                acc = vmlaq_n_f32(acc, v.val[0], m[r]);
+                acc = vmlaq_n_f32(acc, v.val[1], m[4 + r]);
+                result.val[r] = vmlaq_n_f32(acc, v.val[2], m[8 + r]);
+            }
+            vst3q_f32(p, result);
+        }
+        return i;
+    }
+
+    size_t transform3dNEON(const double* m, double* p, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2, p += 6)
+        {
+            float64x2x3_t v = vld3q_f64(p);
+            float64x2x3_t result;
+            for (int r = 0; r < 3; ++r)
+            {
+                float64x2_t acc = vdupq_n_f64(m[12 + r]);
+                acc = vaddq_f64(acc, vmulq_n_f64(v.val[0], m[r]));
+                acc = vaddq_f64(acc, vmulq_n_f64(v.val[1], m[4 + r]));
+                result.val[r] = vaddq_f64(acc, vmulq_n_f64(v.val[2], m[8 + r]));
+            }
+            vst3q_f64(p, result);
+        }
+        return i;
+    }
+
+    size_t transform4NEON(const float* m, float* p, size_t n)
+    {
+        float32x4_t c0 = vld1q_f32(m), c1 = vld1q_f32(m + 4), c2 = vld1q_f32(m + 8), c3 = vld1q_f32(m + 12);
+
+        size_t i = 0;
+        for (; i < n; ++i, p += 4)
+        {
+            float32x4_t v = vld1q_f32(p);
+            float32x4_t r = vmulq_laneq_f32(c0, v, 0);
+            r = vmlaq_laneq_f32(r, c1, v, 1);
+            r = vmlaq_laneq_f32(r, c2, v, 2);
+            r = vmlaq_laneq_f32(r, c3, v, 3);
+            vst1q_f32(p, r);
+        }
+        return i;
+    }
+
+    size_t bounds3NEON(const float* p, size_t n, float* minimum, float* maximum)
+    {
+        if (n < 4) return 0;
+
+        float32x4x3_t lo = vld3q_f32(p), hi = lo;
+        size_t i = 4;
+        for (p += 12; i + 4 <= n; i += 4, p += 12)
+        {
+            float32x4x3_t v = vld3q_f32(p);
+            for (int c = 0; c < 3; ++c)
+            {
+                lo.val[c] = vminq_f32(lo.val[c], v.val[c]);
+                hi.val[c] = vmaxq_f32(hi.val[c], v.val[c]);
+            }
+        }
+
+        for (int c = 0; c < 3; ++c)
+        {
+            minimum[c] = std::min(minimum[c], vminvq_f32(lo.val[c]));
+            maximum[c] = std::max(maximum[c], vmaxvq_f32(hi.val[c]));
+        }
+        return i;
+    }
+
+    size_t maxDistance2NEON(const float* p, size_t n, const float* c, float& result)
+    {
+        float32x4_t d2 = vdupq_n_f32(0.0f);
+
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4, p += 12)
+        {
+            float32x4x3_t v = vld3q_f32(p);
+            float32x4_t dx = vsubq_f32(v.val[0], vdupq_n_f32(c[0]));
+            float32x4_t dy = vsubq_f32(v.val[1], vdupq_n_f32(c[1]));
+            float32x4_t dz = vsubq_f32(v.val[2], vdupq_n_f32(c[2]));
+            d2 = vmaxq_f32(d2, vmlaq_f32(vmlaq_f32(vmulq_f32(dx, dx), dy, dy), dz, dz));
+        }
+
+        result = std::max(result, vmaxvq_f32(d2));
+        return i;
+    }
+
+    size_t convert3NEON(const double* src, float* dst, size_t n, const double* origin)
+    {
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2, src += 6, dst += 6)
+        {
+            float64x2x3_t v = vld3q_f64(src);
+            float32x2x3_t result;
+            for (int c = 0; c < 3; ++c) result.val[c] = vcvt_f32_f64(vsubq_f64(v.val[c], vdupq_n_f64(origin[c])));
+            vst3_f32(dst, result);
+        }
+        return i;
+    }
+
+    size_t normalize3NEON(float* p, size_t n)
+    {
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        const float32x4_t one = vdupq_n_f32(1.0f);
+
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4, p += 12)
+        {
+            float32x4x3_t v = vld3q_f32(p);
+            float32x4_t length = vsqrtq_f32(vmlaq_f32(vmlaq_f32(vmulq_f32(v.val[0], v.val[0]), v.val[1], v.val[1]), v.val[2], v.val[2]));
+            float32x4_t inv = vbslq_f32(vcgtq_f32(length, zero), vdivq_f32(one, length), one);
+            for (int c = 0; c < 3; ++c) v.val[c] = vmulq_f32(v.val[c], inv);
+            vst3q_f32(p, v);
+        }
+        return i;
+    }
+#endif
+
+    template<typename T>
+    void columnMajor(const vsg::t_mat4<T>& matrix, T* m)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            for (int r = 0; r < 4; ++r) m[c * 4 + r] = matrix[c][r];
+        }
+    }
+} // namespace
+
+ArrayKernels::ArrayKernels(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads) :
+    operationThreads(in_operationThreads)
+{
+}
+
+ArrayKernels::InstructionSet ArrayKernels::bestInstructionSet()
+{
+    static const InstructionSet s_best = supported(AVX2) ? AVX2 : (supported(NEON) ? NEON : SCALAR);
+    return s_best;
+}
+
+bool ArrayKernels::supported(InstructionSet in_instructionSet)
+{
+    switch (in_instructionSet)
+    {
+    case (SCALAR): return true;
+#if defined(ARRAYKERNELS_AVX2)
+    case (AVX2): return cpuSupportsAVX2();
+#endif
+#if defined(ARRAYKERNELS_NEON)
+    // NEON is part of the base ARMv8-A instruction set
+    case (NEON): return true;
+#endif
+    default: return false;
+    }
+}
+
+const char* ArrayKernels::name(InstructionSet in_instructionSet)
+{
+    switch (in_instructionSet)
+    {
+    case (SCALAR): return "scalar";
+    case (AVX2): return "AVX2";
+    case (NEON): return "NEON";
+    }
+    return "unknown";
+}
+
+void ArrayKernels::transform(const vsg::mat4& matrix, vsg::vec3Array& array) const
+{
+    if (!contiguous(array) || !isAffine(matrix))
+    {
+        for (auto& v : array) v = matrix * v;
+        array.dirty();
+        return;
+    }
+
+    float m[16];
+    columnMajor(matrix, m);
+    float* data = &(array.data()->x);
+
+    parallelFor(operationThreads, parallelThreshold, array.size(), [&](size_t, size_t begin, size_t end) {
+        float* p = data + begin * 3;
+        size_t n = end - begin, i = 0;
+#if defined(ARRAYKERNELS_AVX2)
+        if (instructionSet == AVX2) i = transform3AVX2(m, p, n);
+#elif defined(ARRAYKERNELS_NEON)
+        if (instructionSet == NEON) i = transform3NEON(m, p, n);
+#endif
+        transform3Scalar(m, p + i * 3, n - i);
+    });
+    array.dirty();
+}
+
+void ArrayKernels::transform(const vsg::dmat4& matrix, vsg::vec3Array& array) const
+{
+    transform(vsg::mat4(matrix), array);
+}
+
+void ArrayKernels::transform(const vsg::dmat4& matrix, vsg::dvec3Array& array) const
+{
+    if (!contiguous(array) || !isAffine(matrix))
+    {
+        for (auto& v : array) v = matrix * v;
+        array.dirty();
+        return;
+    }
+
+    double m[16];
+    columnMajor(matrix, m);
+    double* data = &(array.data()->x);
+
+    parallelFor(operationThreads, parallelThreshold, array.size(), [&](size_t, size_t begin, size_t end) {
+        double* p = data + begin * 3;
+        size_t n = end - begin, i = 0;
+#if defined(ARRAYKERNELS_AVX2)
+        if (instructionSet == AVX2) i = transform3dAVX2(m, p, n);
+#elif defined(ARRAYKERNELS_NEON)
+        if (instructionSet == NEON) i = transform3dNEON(m, p, n);
+#endif
+        transform3Scalar(m, p + i * 3, n - i);
+    });
+    array.dirty();
+}
+
+void ArrayKernels::transform(const vsg::mat4& matrix, vsg::vec4Array& array) const
+{
+    if (!contiguous(array))
+    {
+        for (auto& v : array) v = matrix * v;
+        array.dirty();
+        return;
+    }
+
+    float m[16];
+    columnMajor(matrix, m);
+    float* data = &(array.data()->x);
+
+    parallelFor(operationThreads, parallelThreshold, array.size(), [&](size_t, size_t begin, size_t end) {
+        float* p = data + begin * 4;
+        size_t n = end - begin, i = 0;
+#if defined(ARRAYKERNELS_AVX2)
+        if (instructionSet == AVX2) i = transform4AVX2(m, p, n);
+#elif defined(ARRAYKERNELS_NEON)
+        if (instructionSet == NEON) i = transform4NEON(m, p, n);
+#endif
+        transform4Scalar(m, p + i * 4, n - i);
+    });
+    array.dirty();
+}
+
+vsg::box ArrayKernels::computeBounds(const vsg::vec3Array& array) const
+{
+    vsg::box bounds;
+    if (!contiguous(array))
+    {
+        for (auto& v : array) bounds.add(v);
+        return bounds;
+    }
+
+    const float* data = &(array.data()->x);
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    std::vector<vsg::box> taskBounds(operationThreads ? operationThreads->threads.size() + 1 : 1, vsg::box(vsg::vec3(inf, inf, inf), vsg::vec3(-inf, -inf, -inf)));
+
+    parallelFor(operationThreads, parallelThreshold, array.size(), [&](size_t task, size_t begin, size_t end) {
+        const float* p = data + begin * 3;
+        size_t n = end - begin, i = 0;
+        float* minimum = &taskBounds[task].min.x;
+        float* maximum = &taskBounds[task].max.x;
+#if defined(ARRAYKERNELS_AVX2)
+        if (instructionSet == AVX2) i = bounds3AVX2(p, n, minimum, maximum);
+#elif defined(ARRAYKERNELS_NEON)
+        if (instructionSet == NEON) i = bounds3NEON(p, n, minimum, maximum);
+#endif
+        bounds3Scalar(p + i * 3, n - i, minimum, maximum);
+    });
+
+    for (auto& b : taskBounds)
+    {
+        if (b.valid()) bounds.add(b);
+    }
+    return bounds;
+}
+
+vsg::sphere ArrayKernels::computeBoundingSphere(const vsg::vec3Array& array) const
+{
+    auto bounds = computeBounds(array);
+    if (!bounds.valid()) return vsg::sphere(vsg::vec3(), -1.0f);
+
+    vsg::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    if (!contiguous(array))
+    {
+        float radius2 = 0.0f;
+        for (auto& v : array) radius2 = std::max(radius2, vsg::length2(v - center));
+        return vsg::sphere(center, std::sqrt(radius2));
+    }
+
+    const float* data = &(array.data()->x);
+    std::vector<float> taskRadius2(operationThreads ? operationThreads->threads.size() + 1 : 1, 0.0f);
+
+    parallelFor(operationThreads, parallelThreshold, array.size(), [&](size_t task, size_t begin, size_t end) {
+        const float* p = data + begin * 3;
+        size_t n = end - begin, i = 0;
+        float& radius2 = taskRadius2[task];
+#if defined(ARRAYKERNELS_AVX2)
+        if (instructionSet == AVX2) i = maxDistance2AVX2(p, n, &center.x, radius2);
+#elif defined(ARRAYKERNELS_NEON)
+        if (instructionSet == NEON) i = maxDistance2NEON(p, n, &center.x, radius2);
+#endif
+        radius2 = std::max(radius2, maxDistance2Scalar(p + i * 3, n - i, &center.x));
+    });
+
+    return vsg::sphere(center, std::sqrt(*std::max_element(taskRadius2.begin(), taskRadius2.end())));
+}
+
+vsg::ref_ptr<vsg::vec3Array> ArrayKernels::convert(const vsg::dvec3Array& array, const vsg::dvec3& origin) const
+{
+    auto result = vsg::vec3Array::create(array.size());
+    if (!contiguous(array))
+    {
+        auto itr = result->begin();
+        for (auto& v : array) *(itr++) = vsg::vec3(v - origin);
+        return result;
+    }
+
+    const double* src = &(array.data()->x);
+    float* dst = &(result->data()->x);
+
+    parallelFor(operationThreads, parallelThreshold, array.size(), [&](size_t, size_t begin, size_t end) {
+        const double* s = src + begin * 3;
+        float* d = dst + begin * 3;
+        size_t n = end - begin, i = 0;
+#if defined(ARRAYKERNELS_AVX2)
+        if (instructionSet == AVX2) i = convert3AVX2(s, d, n, &origin.x);
+#elif defined(ARRAYKERNELS_NEON)
+        if (instructionSet == NEON) i = convert3NEON(s, d, n, &origin.x);
+#endif
+        convert3Scalar(s + i * 3, d + i * 3, n - i, &origin.x);
+    });
+    return result;
+}
+
+void ArrayKernels::normalize(vsg::vec3Array& array) const
+{
+    if (!contiguous(array))
+    {
+        for (auto& v : array)
+        {
+            if (auto length = vsg::length(v); length > 0.0f) v *= (1.0f / length);
+        }
+        array.dirty();
+        return;
+    }
+
+    float* data = &(array.data()->x);
+
+    parallelFor(operationThreads, parallelThreshold, array.size(), [&](size_t, size_t begin, size_t end) {
+        float* p = data + begin * 3;
+        size_t n = end - begin, i = 0;
+#if defined(ARRAYKERNELS_AVX2)
+        if (instructionSet == AVX2) i = normalize3AVX2(p, n);
+#elif defined(ARRAYKERNELS_NEON)
+        if (instructionSet == NEON) i = normalize3NEON(p, n);
+#endif
+        normalize3Scalar(p + i * 3, n - i);
+    });
+    array.dirty();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// Bulk kernels over vertex arrays, for the loops of model import and bound computation that otherwise touch one
+// element at a time. AVX2 kernels are used where the CPU supports them, NEON ones on AArch64, and arrays larger than
+// parallelThreshold are split in ranges across operationThreads, with the calling thread taking a share of the work.
+// Arrays with a stride other than their element size, such as views into interleaved vertex data, and projective
+// matrices are handled by the scalar path.
+class ArrayKernels : public vsg::Inherit<vsg::Object, ArrayKernels>
+{
+public:
+    enum InstructionSet
+    {
+        SCALAR,
+        AVX2,
+        NEON
+    };
+
+    explicit ArrayKernels(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads = {});
+
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+
+    // number of elements above which the work is split across operationThreads
+    size_t parallelThreshold = 65536;
+
+    static InstructionSet bestInstructionSet();
+    static bool supported(InstructionSet instructionSet);
+    static const char* name(InstructionSet instructionSet);
+
+    // defaults to the best supported, set to a lesser one to compare them
+    InstructionSet instructionSet = bestInstructionSet();
+
+    // transform the elements in place, dmat4 is applied in single precision to float arrays
+    void transform(const vsg::mat4& matrix, vsg::vec3Array& array) const;
+    void transform(const vsg::dmat4& matrix, vsg::vec3Array& array) const;
+    void transform(const vsg::dmat4& matrix, vsg::dvec3Array& array) const;
+    void transform(const vsg::mat4& matrix, vsg::vec4Array& array) const;
+
+    // axis aligned bounding box of the elements, invalid if the array is empty
+    vsg::box computeBounds(const vsg::vec3Array& array) const;
+
+    // sphere centred on the bounding box that encloses all the elements, negative radius if the array is empty
+    vsg::sphere computeBoundingSphere(const vsg::vec3Array& array) const;
+
+    // double precision coordinates converted to single precision relative to origin, so that geometry far from the
+    // world origin keeps its precision when origin is applied by a MatrixTransform
+    vsg::ref_ptr<vsg::vec3Array> convert(const vsg::dvec3Array& array, const vsg::dvec3& origin) const;
+
+    // normalize the elements in place, zero length elements are left as they are
+    void normalize(vsg::vec3Array& array) const;
+};
@@ -2,11 +2,21 @@
 #include <vsg/core/Visitor.h>
 #include <vsg/core/ConstVisitor.h>
 #include <vsg/io/stream.h>
+#include <vsg/utils/CommandLine.h>
 
+#include "ArrayKernels.h"
+
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <random>
 
-int main(int /*argc*/, char** /*argv*/)
+int main(int argc, char** argv)
 {
+    vsg::CommandLine arguments(&argc, argv);
+    auto numVertices = arguments.value<size_t>(1000000, "--vertices");
+    auto numThreads = arguments.value(0u, "--threads");
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     auto floats = vsg::floatArray::create(10);
 
@@ -51,5 +61,46 @@ int main(int /*argc*/, char** /*argv*/)
         std::cout << "    colour " << c.r << ", " << c.g << ", " << c.b << ", " << c.a << std::endl;
     }
 
+    // benchmark the bulk array kernels against the equivalent element-wise loops
+    std::cout << std::endl
+              << "Bulk kernels on " << numVertices << " vertices" << std::endl;
+
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<double> position(-1000.0, 1000.0);
+
+    auto dvertices = vsg::dvec3Array::create(numVertices);
+    for (auto& v : *dvertices) v.set(position(generator) + 6378137.0, position(generator), position(generator));
+
+    vsg::dvec3 origin(6378137.0, 0.0, 0.0);
+    auto matrix = vsg::mat4(vsg::rotate(vsg::radians(30.0), 0.0, 0.0, 1.0) * vsg::translate(10.0, 20.0, 30.0));
+
+    using clock = std::chrono::high_resolution_clock;
+    auto time = [](clock::time_point start) { return std::chrono::duration<double, std::milli>(clock::now() - start).count(); };
+
+    auto vertices = vsg::vec3Array::create(numVertices);
+    auto start = clock::now();
+    std::transform(dvertices->begin(), dvertices->end(), vertices->begin(), [&origin](const vsg::dvec3& v) { return vsg::vec3(v - origin); });
+    std::for_each(vertices->begin(), vertices->end(), [&matrix](vsg::vec3& v) { v = matrix * v; });
+    vsg::box loopBounds;
+    std::for_each(vertices->begin(), vertices->end(), [&loopBounds](const vsg::vec3& v) { loopBounds.add(v); });
+    std::for_each(vertices->begin(), vertices->end(), [](vsg::vec3& v) { v = vsg::normalize(v); });
+    std::cout << "   element-wise : " << time(start) << "ms, bounds " << loopBounds.min << " " << loopBounds.max << std::endl;
+
+    auto operationThreads = numThreads > 0 ? vsg::OperationThreads::create(numThreads) : vsg::ref_ptr<vsg::OperationThreads>();
+    for (auto instructionSet : {ArrayKernels::SCALAR, ArrayKernels::AVX2, ArrayKernels::NEON})
+    {
+        if (!ArrayKernels::supported(instructionSet)) continue;
+
+        auto kernels = ArrayKernels::create(operationThreads);
+        kernels->instructionSet = instructionSet;
+
+        start = clock::now();
+        auto converted = kernels->convert(*dvertices, origin);
+        kernels->transform(matrix, *converted);
+        auto bounds = kernels->computeBounds(*converted);
+        kernels->normalize(*converted);
+        std::cout << "   " << ArrayKernels::name(instructionSet) << (operationThreads ? " parallel" : "") << " : " << time(start) << "ms, bounds " << bounds.min << " " << bounds.max << std::endl;
+    }
+
     return 0;
 }
@@ -5,13 +5,20 @@
 
 #include <vsg/nodes/Group.h>
 #include <vsg/nodes/LOD.h>
+#include <vsg/nodes/PagedLOD.h>
 #include <vsg/nodes/QuadGroup.h>
 
 #include <vsg/maths/vec3.h>
 
+#include <vsg/utils/CommandLine.h>
+
+#include "DeferredRelease.h"
+
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <thread>
 #include <vector>
 
 class SharerdPtrAuxilary : public std::enable_shared_from_this<SharerdPtrAuxilary>
@@ -51,8 +58,169 @@ public:
     Children _children;
 };
 
-int main(int /*argc*/, char** /*argv*/)
+using clock_type = std::chrono::steady_clock;
+
+double milliseconds(clock_type::time_point start, clock_type::time_point end = clock_type::now())
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// run func(threadIndex) on numThreads threads released together, returns the time until the last one completes
+template<typename F>
+double runThreads(unsigned int numThreads, F func)
 {
+    std::atomic_bool go{false};
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([&go, &func, t]() {
+            while (!go) std::this_thread::yield();
+            func(t);
+        });
+    }
+
+    auto start = clock_type::now();
+    go = true;
+    for (auto& thread : threads) thread.join();
+    return milliseconds(start);
+}
+
+// copy and release a pointer repeatedly from every thread, each thread sharing one object or having its own
+void benchmarkContention(unsigned int numThreads, size_t numIterations)
+{
+    std::cout << std::endl
+              << "Reference count contention, " << numThreads << " threads x " << numIterations << " copies" << std::endl;
+
+    auto ref_shared = vsg::Node::create();
+    std::vector<vsg::ref_ptr<vsg::Node>> ref_private(numThreads);
+    for (auto& node : ref_private) node = vsg::Node::create();
+
+    auto std_shared = std::make_shared<SharedPtrQuadGroup>();
+    std::vector<std::shared_ptr<SharedPtrQuadGroup>> std_private(numThreads);
+    for (auto& node : std_private) node = std::make_shared<SharedPtrQuadGroup>();
+
+    auto report = [&](const char* name, double time) {
+        std::cout << "   " << name << " : " << time << "ms, " << (time * 1e6) / double(numIterations) << "ns per copy" << std::endl;
+    };
+
+    report("vsg::ref_ptr shared object", runThreads(numThreads, [&](unsigned int) {
+               for (size_t i = 0; i < numIterations; ++i) { vsg::ref_ptr<vsg::Node> copy = ref_shared; }
+           }));
+    report("vsg::ref_ptr private objects", runThreads(numThreads, [&](unsigned int t) {
+               for (size_t i = 0; i < numIterations; ++i) { vsg::ref_ptr<vsg::Node> copy = ref_private[t]; }
+           }));
+    report("std::shared_ptr shared object", runThreads(numThreads, [&](unsigned int) {
+               for (size_t i = 0; i < numIterations; ++i) { std::shared_ptr<SharedPtrQuadGroup> copy = std_shared; }
+           }));
+    report("std::shared_ptr private objects", runThreads(numThreads, [&](unsigned int t) {
+               for (size_t i = 0; i < numIterations; ++i) { std::shared_ptr<SharedPtrQuadGroup> copy = std_private[t]; }
+           }));
+}
+
+// cost of taking a strong reference from a weak one, compared to copying a strong one
+void benchmarkObserverPromotion(unsigned int numThreads, size_t numIterations)
+{
+    std::cout << std::endl
+              << "observer_ptr promotion, " << numThreads << " threads x " << numIterations << " promotions" << std::endl;
+
+    auto node = vsg::Node::create();
+    vsg::observer_ptr<vsg::Node> observer(node);
+
+    auto std_node = std::make_shared<SharedPtrQuadGroup>();
+    std::weak_ptr<SharedPtrQuadGroup> weak(std_node);
+
+    auto report = [&](const char* name, double time) {
+        std::cout << "   " << name << " : " << time << "ms, " << (time * 1e6) / double(numIterations) << "ns per promotion" << std::endl;
+    };
+
+    for (unsigned int threads : {1u, numThreads})
+    {
+        std::cout << "   " << threads << " thread(s)" << std::endl;
+        report("   vsg::ref_ptr copy", runThreads(threads, [&](unsigned int) {
+                   for (size_t i = 0; i < numIterations; ++i) { vsg::ref_ptr<vsg::Node> copy = node; }
+               }));
+        report("   vsg::observer_ptr to ref_ptr", runThreads(threads, [&](unsigned int) {
+                   for (size_t i = 0; i < numIterations; ++i) { vsg::ref_ptr<vsg::Node> promoted = observer; }
+               }));
+        report("   std::weak_ptr::lock()", runThreads(threads, [&](unsigned int) {
+                   for (size_t i = 0; i < numIterations; ++i) { auto promoted = weak.lock(); }
+               }));
+        if (threads == numThreads) break;
+    }
+}
+
+vsg::ref_ptr<vsg::Node> createQuadTree(unsigned int numLevels, size_t& numNodes)
+{
+    ++numNodes;
+    if (numLevels == 0) return vsg::Node::create();
+
+    auto group = vsg::Group::create(4);
+    for (auto& child : group->children) child = createQuadTree(numLevels - 1, numNodes);
+    return group;
+}
+
+std::shared_ptr<SharedPtrQuadGroup> createSharedPtrQuadTree(unsigned int numLevels)
+{
+    auto group = std::make_shared<SharedPtrQuadGroup>();
+    if (numLevels > 0)
+    {
+        for (auto& child : group->_children) child = createSharedPtrQuadTree(numLevels - 1);
+    }
+    return group;
+}
+
+// destruction of large trees, directly on this thread and handed to a DeferredRelease, and unloading the high
+// resolution subgraph of a PagedLOD in the same two ways
+void benchmarkDestruction(unsigned int numLevels)
+{
+    size_t numNodes = 0;
+    auto tree = createQuadTree(numLevels, numNodes);
+    auto std_tree = createSharedPtrQuadTree(numLevels);
+
+    std::cout << std::endl
+              << "Destruction of " << numNodes << " node trees" << std::endl;
+
+    auto start = clock_type::now();
+    tree = {};
+    std::cout << "   vsg::ref_ptr tree : " << milliseconds(start) << "ms" << std::endl;
+
+    start = clock_type::now();
+    std_tree = {};
+    std::cout << "   std::shared_ptr tree : " << milliseconds(start) << "ms" << std::endl;
+
+    auto deferredRelease = DeferredRelease::create();
+
+    tree = createQuadTree(numLevels, numNodes);
+    start = clock_type::now();
+    deferredRelease->release(std::move(tree));
+    deferredRelease->flush();
+    auto released = clock_type::now();
+    deferredRelease->wait();
+    std::cout << "   DeferredRelease tree : " << milliseconds(start, released) << "ms on this thread, " << milliseconds(start) << "ms until destroyed" << std::endl;
+
+    auto plod = vsg::PagedLOD::create();
+    plod->children[0].node = createQuadTree(numLevels, numNodes);
+    start = clock_type::now();
+    plod->children[0].node = nullptr;
+    std::cout << "   PagedLOD unload : " << milliseconds(start) << "ms on this thread" << std::endl;
+
+    plod->children[0].node = createQuadTree(numLevels, numNodes);
+    start = clock_type::now();
+    deferredRelease->release(std::move(plod->children[0].node));
+    deferredRelease->flush();
+    released = clock_type::now();
+    deferredRelease->wait();
+    std::cout << "   PagedLOD unload with DeferredRelease : " << milliseconds(start, released) << "ms on this thread, " << milliseconds(start) << "ms until destroyed" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    vsg::CommandLine arguments(&argc, argv);
+    bool benchmark = arguments.read("--benchmark");
+    auto numThreads = arguments.value(std::max(std::thread::hardware_concurrency(), 2u), "--threads");
+    auto numIterations = arguments.value<size_t>(1000000, "--iterations");
+    auto numLevels = arguments.value(10u, {"-l", "--levels"});
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     vsg::ref_ptr<vsg::QuadGroup> ref_node = vsg::QuadGroup::create();
     std::cout << "sizeof(Object)=" << sizeof(vsg::Object) << std::endl;
@@ -89,5 +257,12 @@ int main(int /*argc*/, char** /*argv*/)
     std::cout << "offsetof<vsg::vec3,y> " << offsetof(vsg::vec3, y) << std::endl;
     std::cout << "offsetof<vsg::vec3,z> " << offsetof(vsg::vec3, z) << std::endl;
 
+    if (benchmark)
+    {
+        benchmarkContention(numThreads, numIterations);
+        benchmarkObserverPromotion(numThreads, numIterations);
+        benchmarkDestruction(numLevels);
+    }
+
     return 0;
 }
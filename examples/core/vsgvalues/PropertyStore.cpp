@@ -0,0 +1,477 @@
+#include "PropertyStore.h"
+
+#include <vsg/core/Visitor.h>
+#include <vsg/io/ObjectFactory.h>
+#include <vsg/io/Logger.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+// Register the create() methods with vsg::ObjectFactory::instance() so they can be used for creating objects during reading.
+vsg::RegisterWithObjectFactoryProxy<Properties> s_Register_Properties;
+vsg::RegisterWithObjectFactoryProxy<PropertyTable> s_Register_PropertyTable;
+
+namespace
+{
+    struct VisitNodes : public vsg::Visitor
+    {
+        explicit VisitNodes(std::function<void(vsg::Node&)> in_function) :
+            function(in_function) {}
+
+        std::function<void(vsg::Node&)> function;
+
+        void apply(vsg::Node& node) override
+        {
+            function(node);
+            node.traverse(*this);
+        }
+    };
+
+    template<class A, typename T>
+    vsg::ref_ptr<A> createArray(const std::vector<T>& values)
+    {
+        if (values.empty()) return {};
+        auto array = A::create(values.size());
+        std::copy(values.begin(), values.end(), array->data());
+        return array;
+    }
+
+    template<typename T>
+    uint32_t bits(T value)
+    {
+        static_assert(sizeof(T) == sizeof(uint32_t));
+        uint32_t result;
+        std::memcpy(&result, &value, sizeof(result));
+        return result;
+    }
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// PropertyStrings
+//
+PropertyStrings& PropertyStrings::instance()
+{
+    static PropertyStrings s_strings;
+    return s_strings;
+}
+
+uint32_t PropertyStrings::intern(const std::string_view& str)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    if (auto itr = _indices.find(str); itr != _indices.end()) return itr->second;
+
+    auto index = static_cast<uint32_t>(_strings.size());
+    auto& stored = _strings.emplace_back(str);
+    _indices[std::string_view(stored)] = index;
+    return index;
+}
+
+uint32_t PropertyStrings::find(const std::string_view& str) const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    auto itr = _indices.find(str);
+    return itr != _indices.end() ? itr->second : npos;
+}
+
+const std::string& PropertyStrings::string(uint32_t index) const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return _strings[index];
+}
+
+size_t PropertyStrings::size() const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return _strings.size();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Properties
+//
+Properties::Entry Properties::entry(uint32_t key, bool value)
+{
+    Entry result;
+    result.key = key;
+    result.type = BOOL;
+    result.b = value;
+    return result;
+}
+
+Properties::Entry Properties::entry(uint32_t key, int32_t value)
+{
+    Entry result;
+    result.key = key;
+    result.type = INT;
+    result.i = value;
+    return result;
+}
+
+Properties::Entry Properties::entry(uint32_t key, uint32_t value)
+{
+    Entry result;
+    result.key = key;
+    result.type = UINT;
+    result.u = value;
+    return result;
+}
+
+Properties::Entry Properties::entry(uint32_t key, float value)
+{
+    Entry result;
+    result.key = key;
+    result.type = FLOAT;
+    result.f = value;
+    return result;
+}
+
+Properties::Entry Properties::entry(uint32_t key, double value)
+{
+    Entry result;
+    result.key = key;
+    result.type = DOUBLE;
+    result.d = value;
+    return result;
+}
+
+Properties::Entry Properties::entry(uint32_t key, const std::string_view& value)
+{
+    Entry result;
+    result.key = key;
+    result.type = STRING;
+    result.s = PropertyStrings::instance().intern(value);
+    return result;
+}
+
+bool Properties::get(const Entry& entry, bool& value)
+{
+    if (entry.type != BOOL) return false;
+    value = entry.b;
+    return true;
+}
+
+bool Properties::get(const Entry& entry, int32_t& value)
+{
+    if (entry.type != INT) return false;
+    value = entry.i;
+    return true;
+}
+
+bool Properties::get(const Entry& entry, uint32_t& value)
+{
+    if (entry.type != UINT) return false;
+    value = entry.u;
+    return true;
+}
+
+bool Properties::get(const Entry& entry, float& value)
+{
+    if (entry.type != FLOAT) return false;
+    value = entry.f;
+    return true;
+}
+
+bool Properties::get(const Entry& entry, double& value)
+{
+    if (entry.type != DOUBLE) return false;
+    value = entry.d;
+    return true;
+}
+
+bool Properties::get(const Entry& entry, std::string& value)
+{
+    if (entry.type != STRING) return false;
+    value = PropertyStrings::instance().string(entry.s);
+    return true;
+}
+
+void Properties::set(const Entry& entry)
+{
+    auto itr = std::lower_bound(_entries.begin(), _entries.end(), entry.key, [](const Entry& lhs, uint32_t key) { return lhs.key < key; });
+    if (itr != _entries.end() && itr->key == entry.key)
+        *itr = entry;
+    else
+        _entries.insert(itr, entry);
+}
+
+const Properties::Entry* Properties::find(uint32_t key) const
+{
+    auto itr = std::lower_bound(_entries.begin(), _entries.end(), key, [](const Entry& lhs, uint32_t rhs) { return lhs.key < rhs; });
+    return (itr != _entries.end() && itr->key == key) ? &*itr : nullptr;
+}
+
+bool Properties::remove(const std::string_view& key)
+{
+    auto found = find(PropertyStrings::instance().find(key));
+    if (!found) return false;
+    _entries.erase(_entries.begin() + (found - _entries.data()));
+    return true;
+}
+
+void Properties::read(vsg::Input& input)
+{
+    vsg::Object::read(input);
+
+    uint32_t count = 0;
+    input.read("count", count);
+
+    _entries.clear();
+    _entries.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        std::string key;
+        uint32_t type = DOUBLE;
+        input.read("key", key);
+        input.read("type", type);
+
+        auto keyIndex = PropertyStrings::instance().intern(key);
+        switch (type)
+        {
+        case (BOOL): {
+            bool value = false;
+            input.read("value", value);
+            set(entry(keyIndex, value));
+            break;
+        }
+        case (INT): {
+            int32_t value = 0;
+            input.read("value", value);
+            set(entry(keyIndex, value));
+            break;
+        }
+        case (UINT): {
+            uint32_t value = 0;
+            input.read("value", value);
+            set(entry(keyIndex, value));
+            break;
+        }
+        case (FLOAT): {
+            float value = 0.0f;
+            input.read("value", value);
+            set(entry(keyIndex, value));
+            break;
+        }
+        case (STRING): {
+            std::string value;
+            input.read("value", value);
+            set(entry(keyIndex, value));
+            break;
+        }
+        default: {
+            double value = 0.0;
+            input.read("value", value);
+            set(entry(keyIndex, value));
+            break;
+        }
+        }
+    }
+}
+
+void Properties::write(vsg::Output& output) const
+{
+    vsg::Object::write(output);
+
+    auto& strings = PropertyStrings::instance();
+
+    output.write("count", static_cast<uint32_t>(_entries.size()));
+    for (auto& entry : _entries)
+    {
+        output.write("key", strings.string(entry.key));
+        output.write("type", static_cast<uint32_t>(entry.type));
+
+        switch (entry.type)
+        {
+        case (BOOL): output.write("value", entry.b); break;
+        case (INT): output.write("value", entry.i); break;
+        case (UINT): output.write("value", entry.u); break;
+        case (FLOAT): output.write("value", entry.f); break;
+        case (STRING): output.write("value", strings.string(entry.s)); break;
+        default: output.write("value", entry.d); break;
+        }
+    }
+}
+
+Properties* getOrCreateProperties(vsg::Object& object)
+{
+    if (auto properties = object.getObject<Properties>("properties")) return properties;
+
+    auto properties = Properties::create();
+    object.setObject("properties", properties);
+    return properties;
+}
+
+const Properties* getProperties(const vsg::Object& object)
+{
+    return object.getObject<Properties>("properties");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// PropertyTable
+//
+void PropertyTable::collect(vsg::Node& subgraph)
+{
+    auto& strings = PropertyStrings::instance();
+
+    std::vector<uint32_t> localStringOffsets{0};
+    std::vector<uint8_t> localStringData;
+    std::unordered_map<uint32_t, uint32_t> localStrings; // PropertyStrings index to table index
+    auto localString = [&](uint32_t index) {
+        auto [itr, inserted] = localStrings.emplace(index, static_cast<uint32_t>(localStrings.size()));
+        if (inserted)
+        {
+            auto& str = strings.string(index);
+            localStringData.insert(localStringData.end(), str.begin(), str.end());
+            localStringOffsets.push_back(static_cast<uint32_t>(localStringData.size()));
+        }
+        return itr->second;
+    };
+
+    std::vector<uint32_t> localRowSizes, localKeys, localValues;
+    std::vector<uint8_t> localTypes;
+    std::vector<double> localDoubleValues;
+
+    VisitNodes visitNodes([&](vsg::Node& node) {
+        auto properties = node.getObject<Properties>("properties");
+        if (!properties)
+        {
+            localRowSizes.push_back(0);
+            return;
+        }
+
+        auto& entries = properties->entries();
+        localRowSizes.push_back(static_cast<uint32_t>(entries.size()));
+        for (auto& entry : entries)
+        {
+            localKeys.push_back(localString(entry.key));
+            localTypes.push_back(entry.type);
+            switch (entry.type)
+            {
+            case (Properties::BOOL): localValues.push_back(entry.b ? 1 : 0); break;
+            case (Properties::INT): localValues.push_back(bits(entry.i)); break;
+            case (Properties::UINT): localValues.push_back(entry.u); break;
+            case (Properties::FLOAT): localValues.push_back(bits(entry.f)); break;
+            case (Properties::STRING): localValues.push_back(localString(entry.s)); break;
+            default: localDoubleValues.push_back(entry.d); break;
+            }
+        }
+
+        node.removeObject("properties");
+    });
+    subgraph.accept(visitNodes);
+
+    stringOffsets = createArray<vsg::uintArray>(localStringOffsets);
+    stringData = createArray<vsg::ubyteArray>(localStringData);
+    rowSizes = createArray<vsg::uintArray>(localRowSizes);
+    keys = createArray<vsg::uintArray>(localKeys);
+    types = createArray<vsg::ubyteArray>(localTypes);
+    values = createArray<vsg::uintArray>(localValues);
+    doubleValues = createArray<vsg::doubleArray>(localDoubleValues);
+}
+
+size_t PropertyTable::assign(vsg::Node& subgraph) const
+{
+    if (!rowSizes) return 0;
+
+    // check the columns are consistent before indexing into them
+    size_t numEntries = 0;
+    for (auto rowSize : *rowSizes) numEntries += rowSize;
+
+    size_t numDoubles = 0;
+    if (types)
+    {
+        for (auto type : *types) numDoubles += (type == Properties::DOUBLE) ? 1 : 0;
+    }
+
+    size_t numStrings = (stringOffsets && stringOffsets->size() > 0) ? stringOffsets->size() - 1 : 0;
+    auto size = [](auto& array) -> size_t { return array ? array->size() : 0; };
+    if (size(keys) != numEntries || size(types) != numEntries || size(values) != numEntries - numDoubles || size(doubleValues) != numDoubles ||
+        (numStrings > 0 && size(stringData) < stringOffsets->at(numStrings)))
+    {
+        vsg::warn("PropertyTable::assign() columns are inconsistent, not assigning Properties.");
+        return 0;
+    }
+
+    // intern the table's strings
+    std::vector<uint32_t> interned(numStrings);
+    auto& strings = PropertyStrings::instance();
+    for (size_t i = 0; i < numStrings; ++i)
+    {
+        auto begin = stringOffsets->at(i);
+        auto end = stringOffsets->at(i + 1);
+        interned[i] = strings.intern(std::string_view(reinterpret_cast<const char*>(stringData->data()) + begin, end - begin));
+    }
+
+    auto stringIndex = [&](uint32_t index) { return index < numStrings ? interned[index] : strings.intern({}); };
+
+    size_t row = 0, entryIndex = 0, valueIndex = 0, doubleIndex = 0, numAssigned = 0;
+    VisitNodes visitNodes([&](vsg::Node& node) {
+        if (row >= rowSizes->size()) return;
+
+        auto rowSize = rowSizes->at(row++);
+        if (rowSize == 0) return;
+
+        auto properties = Properties::create();
+        properties->reserve(rowSize);
+        for (uint32_t i = 0; i < rowSize; ++i, ++entryIndex)
+        {
+            Properties::Entry entry;
+            entry.key = stringIndex(keys->at(entryIndex));
+            entry.type = static_cast<Properties::Type>(types->at(entryIndex));
+
+            if (entry.type == Properties::DOUBLE)
+            {
+                entry.d = doubleValues->at(doubleIndex++);
+            }
+            else
+            {
+                uint32_t value = values->at(valueIndex++);
+                switch (entry.type)
+                {
+                case (Properties::BOOL): entry.b = value != 0; break;
+                case (Properties::INT): std::memcpy(&entry.i, &value, sizeof(value)); break;
+                case (Properties::FLOAT): std::memcpy(&entry.f, &value, sizeof(value)); break;
+                case (Properties::STRING): entry.s = stringIndex(value); break;
+                default: entry.u = value; break;
+                }
+            }
+
+            // keys interned in a different order to when the table was collected can change the sort order, so go through set()
+            properties->set(entry);
+        }
+
+        node.setObject("properties", properties);
+        ++numAssigned;
+    });
+    subgraph.accept(visitNodes);
+
+    return numAssigned;
+}
+
+void PropertyTable::read(vsg::Input& input)
+{
+    vsg::Object::read(input);
+
+    input.read("stringOffsets", stringOffsets);
+    input.read("stringData", stringData);
+    input.read("rowSizes", rowSizes);
+    input.read("keys", keys);
+    input.read("types", types);
+    input.read("values", values);
+    input.read("doubleValues", doubleValues);
+}
+
+void PropertyTable::write(vsg::Output& output) const
+{
+    vsg::Object::write(output);
+
+    output.write("stringOffsets", stringOffsets);
+    output.write("stringData", stringData);
+    output.write("rowSizes", rowSizes);
+    output.write("keys", keys);
+    output.write("types", types);
+    output.write("values", values);
+    output.write("doubleValues", doubleValues);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vsg/core/Array.h>
+#include <vsg/core/Inherit.h>
+#include <vsg/io/Input.h>
+#include <vsg/io/Output.h>
+#include <vsg/nodes/Node.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Interned strings shared by all Properties, each distinct key or string value is stored once and referred to by its index.
+class PropertyStrings
+{
+public:
+    static PropertyStrings& instance();
+
+    static constexpr uint32_t npos = 0xffffffff;
+
+    // return the index of str, adding it if it isn't already interned
+    uint32_t intern(const std::string_view& str);
+
+    // return the index of str, or npos if it isn't interned, so looking up an unknown key doesn't grow the table
+    uint32_t find(const std::string_view& str) const;
+
+    const std::string& string(uint32_t index) const;
+
+    size_t size() const;
+
+protected:
+    mutable std::mutex _mutex;
+    std::deque<std::string> _strings; // a deque so the string_view keys of _indices stay valid as it grows
+    std::unordered_map<std::string_view, uint32_t> _indices;
+};
+
+// Compact alternative to storing each user value as its own vsg::Value<T> in the vsg::Auxiliary ObjectMap. All the
+// properties of an object are held in one vector of 16 byte entries sorted by interned key, with scalar values stored
+// inline and strings as PropertyStrings indices, so an object with P properties costs one allocation rather than P
+// Value objects and P map nodes, and a lookup is a binary search over integers rather than string compares and a
+// dynamic_cast. As with vsg::Object::getValue(), getValue() only succeeds when the type matches the type set.
+class Properties : public vsg::Inherit<vsg::Object, Properties>
+{
+public:
+    enum Type : uint8_t
+    {
+        BOOL,
+        INT,
+        UINT,
+        FLOAT,
+        DOUBLE,
+        STRING
+    };
+
+    struct Entry
+    {
+        uint32_t key = 0;
+        Type type = DOUBLE;
+        union
+        {
+            bool b;
+            int32_t i;
+            uint32_t u;
+            float f;
+            double d = 0.0;
+            uint32_t s; // PropertyStrings index
+        };
+    };
+
+    static Entry entry(uint32_t key, bool value);
+    static Entry entry(uint32_t key, int32_t value);
+    static Entry entry(uint32_t key, uint32_t value);
+    static Entry entry(uint32_t key, float value);
+    static Entry entry(uint32_t key, double value);
+    static Entry entry(uint32_t key, const std::string_view& value);
+    static Entry entry(uint32_t key, const std::string& value) { return entry(key, std::string_view(value)); }
+    static Entry entry(uint32_t key, const char* value) { return entry(key, std::string_view(value)); }
+
+    static bool get(const Entry& entry, bool& value);
+    static bool get(const Entry& entry, int32_t& value);
+    static bool get(const Entry& entry, uint32_t& value);
+    static bool get(const Entry& entry, float& value);
+    static bool get(const Entry& entry, double& value);
+    static bool get(const Entry& entry, std::string& value);
+
+    template<typename T>
+    void setValue(const std::string_view& key, const T& value) { set(entry(PropertyStrings::instance().intern(key), value)); }
+
+    template<typename T>
+    bool getValue(const std::string_view& key, T& value) const { return getValue(PropertyStrings::instance().find(key), value); }
+
+    // look up by interned key, avoiding the PropertyStrings lookup when the same keys are queried on many objects
+    template<typename T>
+    bool getValue(uint32_t key, T& value) const
+    {
+        auto found = find(key);
+        return found && get(*found, value);
+    }
+
+    void set(const Entry& entry);
+    const Entry* find(uint32_t key) const;
+    bool remove(const std::string_view& key);
+
+    const std::vector<Entry>& entries() const { return _entries; }
+
+    // reserve space for the number of properties to be set, so the vector holds no more than it needs
+    void reserve(size_t size) { _entries.reserve(size); }
+
+    void read(vsg::Input& input) override;
+    void write(vsg::Output& output) const override;
+
+protected:
+    std::vector<Entry> _entries;
+};
+EVSG_type_name(Properties);
+
+// the Properties of an object, held as its "properties" user object
+Properties* getOrCreateProperties(vsg::Object& object);
+const Properties* getProperties(const vsg::Object& object);
+
+// Columnar form of the Properties of every node in a subgraph, so writing them to .vsgb writes a few large arrays
+// rather than a Properties object per node. collect() moves the Properties off the nodes, in traversal order, into the
+// table's columns, and assign() moves them back onto the nodes of the same subgraph after reading, so the table is
+// best written along with the subgraph, e.g. as a user object of its root.
+class PropertyTable : public vsg::Inherit<vsg::Object, PropertyTable>
+{
+public:
+    // the keys and string values, the characters of string i are stringData[stringOffsets[i], stringOffsets[i+1])
+    vsg::ref_ptr<vsg::uintArray> stringOffsets;
+    vsg::ref_ptr<vsg::ubyteArray> stringData;
+
+    vsg::ref_ptr<vsg::uintArray> rowSizes; // number of properties of each node in traversal order
+    vsg::ref_ptr<vsg::uintArray> keys;     // per property, index into the strings
+    vsg::ref_ptr<vsg::ubyteArray> types;   // per property, Properties::Type
+    vsg::ref_ptr<vsg::uintArray> values;   // per BOOL, INT, UINT, FLOAT and STRING property, bit pattern of the value
+    vsg::ref_ptr<vsg::doubleArray> doubleValues; // per DOUBLE property
+
+    void collect(vsg::Node& subgraph);
+
+    // returns the number of nodes assigned Properties
+    size_t assign(vsg::Node& subgraph) const;
+
+    void read(vsg::Input& input) override;
+    void write(vsg::Output& output) const override;
+};
+EVSG_type_name(PropertyTable);
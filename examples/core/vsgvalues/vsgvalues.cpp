@@ -1,12 +1,26 @@
+#include <vsg/core/Allocator.h>
 #include <vsg/core/Auxiliary.h>
 #include <vsg/core/Object.h>
 #include <vsg/core/Value.h>
 #include <vsg/core/Visitor.h>
 #include <vsg/core/ConstVisitor.h>
+#include <vsg/io/FileSystem.h>
+#include <vsg/io/read.h>
 #include <vsg/io/stream.h>
+#include <vsg/io/write.h>
+#include <vsg/nodes/Group.h>
+#include <vsg/utils/CommandLine.h>
+
+#include "PropertyStore.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <new>
+#include <random>
 #include <typeinfo>
 
 namespace engine
@@ -23,8 +37,296 @@ namespace engine
 // provide a vsg::type_name<> for our custom propertyValue class using EVSG_type_name() macro, note must be done in global scope.
 EVSG_type_name(engine::propertyValue)
 
-int main(int /*argc*/, char** /*argv*/)
+// Live bytes allocated through the vsg::Allocator, which vsg::Object subclasses such as vsg::Value<T>, vsg::Auxiliary
+// and Properties are allocated from.
+class CountingAllocator : public vsg::Allocator
 {
+public:
+    CountingAllocator(std::unique_ptr<Allocator> in_nestedAllocator) :
+        vsg::Allocator(std::move(in_nestedAllocator))
+    {
+    }
+
+    std::atomic_int64_t liveBytes{0};
+
+    void* allocate(std::size_t size, vsg::AllocatorAffinity allocatorAffinity = vsg::ALLOCATOR_AFFINITY_OBJECTS) override
+    {
+        liveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+        return Allocator::allocate(size, allocatorAffinity);
+    }
+
+    bool deallocate(void* ptr, std::size_t size) override
+    {
+        liveBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+        return Allocator::deallocate(ptr, size);
+    }
+};
+
+#if !defined(_WIN32)
+// Live bytes allocated through the global operator new, which the std::map nodes, std::string and std::vector
+// storage of vsg::Auxiliary and Properties come from. Not counted on Windows where replacing operator new in the
+// executable doesn't replace it in the VulkanSceneGraph DLL, so memory could be freed by the other module's delete.
+static std::atomic_int64_t s_heapBytes{0};
+
+void* operator new(std::size_t size)
+{
+    auto ptr = static_cast<std::max_align_t*>(std::malloc(size + sizeof(std::max_align_t)));
+    if (!ptr) throw std::bad_alloc();
+    *reinterpret_cast<std::size_t*>(ptr) = size;
+    s_heapBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    return ptr + 1;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (!ptr) return;
+    auto base = static_cast<std::max_align_t*>(ptr) - 1;
+    s_heapBytes.fetch_sub(static_cast<int64_t>(*reinterpret_cast<std::size_t*>(base)), std::memory_order_relaxed);
+    std::free(base);
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { operator delete(ptr); }
+
+int64_t heapBytes() { return s_heapBytes.load(); }
+#else
+int64_t heapBytes() { return 0; }
+#endif
+
+// Compare storing numProperties user values on each of numObjects nodes with vsg::Object::setValue(), a vsg::Value<T>
+// per property in the Auxiliary's ObjectMap, against a Properties per node, reporting memory use, build time and the
+// time of numLookups getValue() calls. When filename is set the Properties are also written to and read back from it
+// as a PropertyTable, and the ObjectMap layout from a file alongside it for comparison.
+int runBenchmark(CountingAllocator& allocator, size_t numObjects, size_t numProperties, size_t numLookups, const vsg::Path& filename)
+{
+    using clock = std::chrono::steady_clock;
+    auto milliseconds = [](clock::duration duration) { return std::chrono::duration<double, std::chrono::milliseconds::period>(duration).count(); };
+
+    // BIM style properties, the string values drawn from a small set as materials, levels and classifications repeat
+    std::vector<std::string> keys;
+    for (size_t j = 0; j < numProperties; ++j) keys.push_back(vsg::make_string("Pset_Property_", j));
+    std::vector<std::string> stringValues;
+    for (size_t k = 0; k < 16; ++k) stringValues.push_back(vsg::make_string("Level ", k, " Concrete C30/37"));
+
+    enum ValueType { STRING_VALUE, DOUBLE_VALUE, FLOAT_VALUE, INT_VALUE, UINT_VALUE, NUM_VALUE_TYPES };
+    auto valueType = [](size_t j) { return static_cast<ValueType>(j % NUM_VALUE_TYPES); };
+
+    std::mt19937 generator(5489u);
+    std::uniform_int_distribution<size_t> objectDistribution(0, numObjects - 1);
+    std::uniform_int_distribution<size_t> propertyDistribution(0, numProperties - 1);
+    std::vector<std::pair<size_t, size_t>> lookups(numLookups);
+    for (auto& lookup : lookups) lookup = {objectDistribution(generator), propertyDistribution(generator)};
+
+    struct Measurement
+    {
+        int64_t objectBytes = 0;
+        int64_t heapBytes = 0;
+        double buildTime = 0.0;
+    };
+
+    auto build = [&](auto setProperties, Measurement& measurement) {
+        auto objectBytes = allocator.liveBytes.load();
+        auto heap = heapBytes();
+        auto start = clock::now();
+
+        auto group = vsg::Group::create();
+        group->children.reserve(numObjects);
+        for (size_t i = 0; i < numObjects; ++i)
+        {
+            auto node = vsg::Node::create();
+            setProperties(*node, i);
+            group->children.push_back(node);
+        }
+
+        measurement.buildTime = milliseconds(clock::now() - start);
+        measurement.objectBytes = allocator.liveBytes.load() - objectBytes;
+        measurement.heapBytes = heapBytes() - heap;
+        return group;
+    };
+
+    // nodes without properties, subtracted from the others to leave the cost of the properties
+    Measurement baseline, objectMap, compact;
+    build([](vsg::Node&, size_t) {}, baseline);
+
+    auto objectMapScene = build([&](vsg::Node& node, size_t i) {
+        for (size_t j = 0; j < numProperties; ++j)
+        {
+            switch (valueType(j))
+            {
+            case (STRING_VALUE): node.setValue(keys[j], stringValues[(i + j) % stringValues.size()]); break;
+            case (DOUBLE_VALUE): node.setValue(keys[j], static_cast<double>(i) * 0.5 + static_cast<double>(j)); break;
+            case (FLOAT_VALUE): node.setValue(keys[j], static_cast<float>(j) * 0.25f); break;
+            case (INT_VALUE): node.setValue(keys[j], static_cast<int32_t>(i + j)); break;
+            default: node.setValue(keys[j], static_cast<uint32_t>(i * j)); break;
+            }
+        }
+    }, objectMap);
+
+    auto compactScene = build([&](vsg::Node& node, size_t i) {
+        auto properties = getOrCreateProperties(node);
+        properties->reserve(numProperties);
+        for (size_t j = 0; j < numProperties; ++j)
+        {
+            switch (valueType(j))
+            {
+            case (STRING_VALUE): properties->setValue(keys[j], stringValues[(i + j) % stringValues.size()]); break;
+            case (DOUBLE_VALUE): properties->setValue(keys[j], static_cast<double>(i) * 0.5 + static_cast<double>(j)); break;
+            case (FLOAT_VALUE): properties->setValue(keys[j], static_cast<float>(j) * 0.25f); break;
+            case (INT_VALUE): properties->setValue(keys[j], static_cast<int32_t>(i + j)); break;
+            default: properties->setValue(keys[j], static_cast<uint32_t>(i * j)); break;
+            }
+        }
+    }, compact);
+
+    // look up each property with the type it was set with, summing the values so the lookups can't be optimized away
+    auto lookup = [&](auto getValue) {
+        double sum = 0.0;
+        size_t numFound = 0;
+        auto start = clock::now();
+        for (auto& [i, j] : lookups)
+        {
+            bool found = false;
+            switch (valueType(j))
+            {
+            case (STRING_VALUE): {
+                std::string value;
+                found = getValue(i, j, value);
+                sum += static_cast<double>(value.size());
+                break;
+            }
+            case (DOUBLE_VALUE): {
+                double value = 0.0;
+                found = getValue(i, j, value);
+                sum += value;
+                break;
+            }
+            case (FLOAT_VALUE): {
+                float value = 0.0f;
+                found = getValue(i, j, value);
+                sum += value;
+                break;
+            }
+            case (INT_VALUE): {
+                int32_t value = 0;
+                found = getValue(i, j, value);
+                sum += value;
+                break;
+            }
+            default: {
+                uint32_t value = 0;
+                found = getValue(i, j, value);
+                sum += value;
+                break;
+            }
+            }
+            if (found) ++numFound;
+        }
+        auto time = milliseconds(clock::now() - start);
+        if (numFound != lookups.size()) std::cout << "    only found " << numFound << " of " << lookups.size() << " values, checksum " << sum << std::endl;
+        return time;
+    };
+
+    auto& objectMapNodes = objectMapScene->children;
+    auto& compactNodes = compactScene->children;
+    double objectMapLookupTime = lookup([&](size_t i, size_t j, auto& value) { return objectMapNodes[i]->getValue(keys[j], value); });
+    double compactLookupTime = lookup([&](size_t i, size_t j, auto& value) { return getProperties(*compactNodes[i])->getValue(keys[j], value); });
+
+    std::vector<uint32_t> keyIndices;
+    for (auto& key : keys) keyIndices.push_back(PropertyStrings::instance().find(key));
+    double internedLookupTime = lookup([&](size_t i, size_t j, auto& value) { return getProperties(*compactNodes[i])->getValue(keyIndices[j], value); });
+
+    double numValues = static_cast<double>(numObjects * numProperties);
+    auto report = [&](const char* name, const Measurement& measurement) {
+        auto objectBytes = measurement.objectBytes - baseline.objectBytes;
+        auto heap = measurement.heapBytes - baseline.heapBytes;
+        std::cout << "    " << name << " objects = " << objectBytes / (1024 * 1024) << "MiB, heap = " << heap / (1024 * 1024) << "MiB, "
+                  << static_cast<double>(objectBytes + heap) / numValues << " bytes per value, build = " << measurement.buildTime << "ms" << std::endl;
+    };
+
+    std::cout << "\nBenchmark " << numObjects << " nodes with " << numProperties << " properties each" << std::endl;
+#if defined(_WIN32)
+    std::cout << "    heap allocations aren't counted on Windows, only vsg::Allocator allocations" << std::endl;
+#endif
+    report("ObjectMap of vsg::Value<T>", objectMap);
+    report("Properties                ", compact);
+    std::cout << "    " << numLookups << " lookups, ObjectMap = " << objectMapLookupTime << "ms, Properties = " << compactLookupTime << "ms, Properties with interned keys = " << internedLookupTime << "ms" << std::endl;
+
+    if (!filename) return 0;
+
+    // write the ObjectMap layout row by row for comparison
+    auto objectMapFilename = vsg::make_string(vsg::removeExtension(filename).string(), "_objectmap", vsg::fileExtension(filename).string());
+    auto start = clock::now();
+    vsg::write(objectMapScene, objectMapFilename);
+    double objectMapWriteTime = milliseconds(clock::now() - start);
+
+    // move the Properties into a PropertyTable written as a user object of the root
+    start = clock::now();
+    auto table = PropertyTable::create();
+    table->collect(*compactScene);
+    compactScene->setObject("propertyTable", table);
+    vsg::write(compactScene, filename);
+    double tableWriteTime = milliseconds(clock::now() - start);
+
+    objectMapScene = {};
+    compactScene = {};
+
+    start = clock::now();
+    auto loadedObjectMap = vsg::read_cast<vsg::Group>(objectMapFilename);
+    double objectMapReadTime = milliseconds(clock::now() - start);
+
+    start = clock::now();
+    size_t numAssigned = 0;
+    auto loaded = vsg::read_cast<vsg::Group>(filename);
+    if (loaded)
+    {
+        if (auto loadedTable = loaded->getObject<PropertyTable>("propertyTable"))
+        {
+            numAssigned = loadedTable->assign(*loaded);
+            loaded->removeObject("propertyTable");
+        }
+    }
+    double tableReadTime = milliseconds(clock::now() - start);
+
+    std::error_code error;
+    auto fileSize = [&error](const vsg::Path& path) { return std::filesystem::file_size(path.string(), error) / 1024; };
+
+    std::cout << "    " << objectMapFilename << " " << fileSize(objectMapFilename) << "KiB, write = " << objectMapWriteTime << "ms, read = " << objectMapReadTime << "ms" << (loadedObjectMap ? "" : " failed to read") << std::endl;
+    std::cout << "    " << filename << " " << fileSize(filename) << "KiB, write = " << tableWriteTime << "ms, read and assign = " << tableReadTime << "ms, " << numAssigned << " nodes assigned Properties" << std::endl;
+
+    // check the values survived the round trip
+    if (loaded && numAssigned == numObjects && numProperties > DOUBLE_VALUE)
+    {
+        size_t numMismatched = 0;
+        for (size_t i = 0; i < numObjects; i += std::max(size_t(1), numObjects / 100))
+        {
+            auto properties = getProperties(*loaded->children[i]);
+            double value = 0.0;
+            if (!properties || !properties->getValue(keys[DOUBLE_VALUE], value) || value != static_cast<double>(i) * 0.5 + static_cast<double>(DOUBLE_VALUE)) ++numMismatched;
+        }
+        if (numMismatched > 0) std::cout << "    " << numMismatched << " nodes read back with the wrong values" << std::endl;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    vsg::CommandLine arguments(&argc, argv);
+    auto numObjects = arguments.value<size_t>(0, "--benchmark");
+    auto numProperties = arguments.value<size_t>(30, "--properties");
+    auto numLookups = arguments.value<size_t>(1000000, "--lookups");
+    auto filename = arguments.value<vsg::Path>("", "--write");
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+    CountingAllocator* countingAllocator = nullptr;
+    if (numObjects > 0)
+    {
+        countingAllocator = new CountingAllocator(std::move(vsg::Allocator::instance()));
+        vsg::Allocator::instance().reset(countingAllocator);
+    }
+
     vsg::ref_ptr<vsg::Object> object(new vsg::Object());
     object->setValue("name", "Name field contents");
     object->setValue("time", 10.0);
@@ -102,5 +404,22 @@ int main(int /*argc*/, char** /*argv*/)
     prop.speed *= 2.0f; // modifying a member of the struct
     std::cout<<"    after multiplication my_property->value->speed = "<<prop.speed<<std::endl;
 
+    // the same values held in a compact Properties, a single user object with the values stored inline
+    auto properties = getOrCreateProperties(*object);
+    properties->setValue("name", "Name field contents");
+    properties->setValue("time", 10.0);
+    properties->setValue("size", 3.1f);
+    properties->setValue("count", 5);
+    properties->setValue("pos", 4u);
+
+    std::string name;
+    double time = 0.0;
+    if (properties->getValue("name", name) && properties->getValue("time", time))
+    {
+        std::cout<<"\nProperties has "<<properties->entries().size()<<" entries, name = "<<name<<", time = "<<time<<std::endl;
+    }
+
+    if (numProperties > 0 && countingAllocator) return runBenchmark(*countingAllocator, numObjects, numProperties, std::max(numLookups, size_t(1)), filename);
+
     return 0;
 }
@@ -0,0 +1,70 @@
+#include "TypeIndexedDispatch.h"
+
+#include <iostream>
+
+class IndexedCustomGroupNode : public vsg::Inherit<IndexedGroup, IndexedCustomGroupNode>
+{
+public:
+
+    std::string name = "indexed car";
+
+protected:
+
+    ~IndexedCustomGroupNode() = default;
+};
+
+class IndexedCustomLODNode : public vsg::Inherit<IndexedGroup, IndexedCustomLODNode>
+{
+public:
+
+    double maxDistance = 3.0;
+
+protected:
+
+    ~IndexedCustomLODNode() = default;
+};
+
+// custom types are handled through a DispatchTable built once for the visitor class, the nodes need no accept()
+// override and there is no cast<>() per visit, at the cost of children being held by IndexedGroup.
+class IndexedVisitCustomTypes : public vsg::Inherit<vsg::Visitor, IndexedVisitCustomTypes>
+{
+    public:
+
+        static const DispatchTable<IndexedVisitCustomTypes>& table()
+        {
+            static const auto s_table = []() {
+                DispatchTable<IndexedVisitCustomTypes> t;
+                t.add<IndexedGroup>();
+                t.add<IndexedCustomGroupNode>();
+                t.add<IndexedCustomLODNode>();
+                return t;
+            }();
+            return s_table;
+        }
+
+        // entry point for the root of the subgraph, children are dispatched by their IndexedGroup
+        void dispatch(vsg::Node& node)
+        {
+            table().dispatch(*this, node, TypeRegistry::id(node));
+        }
+
+        using Visitor::apply;
+
+        void apply(IndexedGroup& group)
+        {
+            std::cout << "apply(IndexedGroup& node)"<<std::endl;
+            group.traverse(*this, table());
+        }
+
+        void apply(IndexedCustomGroupNode& node)
+        {
+            std::cout << "apply(IndexedCustomGroupNode& node) name = "<<node.name<<std::endl;
+            node.traverse(*this, table());
+        }
+
+        void apply(IndexedCustomLODNode& node)
+        {
+            std::cout << "apply(IndexedCustomLODNode& node) maxDistance = "<<node.maxDistance<<std::endl;
+            node.traverse(*this, table());
+        }
+};
@@ -8,6 +8,7 @@
 
 #include "VisitorCustomType.h"
 #include "AlternateVisitorCustomType.h"
+#include "IndexedVisitorCustomType.h"
 
 int main(int, char**)
 {
@@ -43,5 +44,22 @@ int main(int, char**)
         group->accept(v);
     }
 
+    // Approach 3
+    {
+        std::cout<<"\nThird approach, dispatching custom types through a jump table indexed by registered type ids."<<std::endl;
+
+        auto group = IndexedGroup::create();
+
+        auto child1 = IndexedCustomGroupNode::create();
+        auto child2 = IndexedCustomLODNode::create();
+
+        group->addChild(child1);
+        group->addChild(child2);
+        group->updateChildTypes();
+
+        IndexedVisitCustomTypes v;
+        v.dispatch(*group);
+    }
+
     return 0;
 }
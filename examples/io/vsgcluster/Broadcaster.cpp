@@ -256,3 +256,50 @@ void Broadcaster::broadcast(const void* buffer, unsigned int buffer_size)
 
 #endif
 }
+
+void Broadcaster::broadcast(const std::vector<BufferView>& buffers)
+{
+    if (!_initialized) init();
+
+#if defined(__linux)
+
+    // reuse the iovec and mmsghdr containers from previous calls so steady state broadcasting doesn't allocate
+    _iovecs.resize(buffers.size());
+    _messages.resize(buffers.size());
+
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        _iovecs[i].iov_base = const_cast<void*>(buffers[i].data);
+        _iovecs[i].iov_len = buffers[i].size;
+
+        memset(&_messages[i], 0, sizeof(struct mmsghdr));
+        _messages[i].msg_hdr.msg_name = &saddr;
+        _messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        _messages[i].msg_hdr.msg_iov = &_iovecs[i];
+        _messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    size_t sent = 0;
+    while (sent < _messages.size())
+    {
+        int result = sendmmsg(_so, _messages.data() + sent, static_cast<unsigned int>(_messages.size() - sent), 0);
+        if (result < 0)
+        {
+            if (errno == EINTR) continue;
+
+            std::cerr << "Broadcaster::broadcast() - errno = "<<errno<<", error : " << strerror(errno) << std::endl;
+            return;
+        }
+        sent += static_cast<size_t>(result);
+    }
+
+#else
+
+    // WSASendTo() gathers all WSABUF into a single datagram so doesn't help batching separate packets, fallback to one sendto() per buffer.
+    for (auto& buffer : buffers)
+    {
+        broadcast(buffer.data, buffer.size);
+    }
+
+#endif
+}
@@ -20,6 +20,7 @@
 */
 
 #include <string>
+#include <vector>
 #include <vsg/core/Inherit.h>
 
 ////////////////////////////////////////////////////////////
@@ -35,8 +36,17 @@
 #    include <winsock.h>
 #else
 #    include <netinet/in.h>
+#    include <sys/socket.h>
+#    include <sys/uio.h>
 #endif
 
+// View of a buffer to be sent as a single datagram, used for batching multiple datagrams into one call.
+struct BufferView
+{
+    const void* data = nullptr;
+    unsigned int size = 0;
+};
+
 std::vector<std::string> listNetworkConnections();
 
 class Broadcaster : public vsg::Inherit<vsg::Object, Broadcaster>
@@ -51,6 +61,9 @@ public:
 
     void broadcast(const void* buffer, unsigned int buffer_size);
 
+    // Broadcast each BufferView as a separate datagram, using scatter/gather sendmmsg() where the platform supports it.
+    void broadcast(const std::vector<BufferView>& buffers);
+
 private:
     bool init(void);
 
@@ -72,4 +85,9 @@ private:
     struct sockaddr_in saddr;
 #endif
     unsigned long _address;
+
+#if defined(__linux)
+    std::vector<struct iovec> _iovecs;
+    std::vector<struct mmsghdr> _messages;
+#endif
 };
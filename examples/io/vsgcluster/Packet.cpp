@@ -1,5 +1,9 @@
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <optional>
 #include <sstream>
 
 #include "Packet.h"
@@ -31,15 +35,166 @@ void PacketSet::clear()
         pool.emplace(std::move(packet.second));
     }
     packets.clear();
+
+    for(auto& packet : parity)
+    {
+        pool.emplace(std::move(packet.second));
+    }
+    parity.clear();
+
+    packetCount = 0;
+    totalSize = 0;
+    parityGroupSize = 0;
+    nackCount = 0;
 }
 
-bool PacketSet::add(std::unique_ptr<Packet> packet)
+bool PacketSet::add(std::unique_ptr<Packet> packet, std::size_t receivedSize)
 {
-    bool complete = (packets.size() + 1) == packet->header.packetCount;
+    auto& header = packet->header;
+
+    // the payload has to fit in the Packet and have been received in full, or assembling the set would overrun it
+    if (header.packetSize > DATA_SIZE || sizeof(Packet::Header) + header.packetSize > receivedSize)
+    {
+        pool.emplace(std::move(packet));
+        return false;
+    }
+
+    set = header.set;
+    packetCount = header.packetCount;
+    totalSize = header.totalSize;
+    parityGroupSize = header.parityGroupSize;
+
+    bool isParity = header.packetIndex >= header.packetCount;
+    auto& container = isParity ? parity : packets;
+    uint32_t index = isParity ? (header.packetIndex - header.packetCount) : header.packetIndex;
+
+    if (container.count(index) != 0)
+    {
+        // duplicate, such as from a retransmit, so just return the packet to the pool
+        pool.emplace(std::move(packet));
+    }
+    else
+    {
+        container[index] = std::move(packet);
+    }
+
+    if (packets.size() == packetCount) return true;
+
+    // the parity packets are sent after the data packets, so once the last one has arrived no more of the set are
+    // coming and it's worth trying to recover, rather than rescanning the groups on every packet
+    if (!isParity || index + 1 != numParityGroups()) return false;
+
+    return recover();
+}
+
+static void xorInto(uint8_t* dest, const uint8_t* src, std::size_t size)
+{
+    std::size_t i = 0;
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t a, b;
+        std::memcpy(&a, dest + i, sizeof(uint64_t));
+        std::memcpy(&b, src + i, sizeof(uint64_t));
+        a ^= b;
+        std::memcpy(dest + i, &a, sizeof(uint64_t));
+    }
+    for(; i < size; ++i)
+    {
+        dest[i] ^= src[i];
+    }
+}
+
+void PacketSet::addParity(uint32_t groupSize)
+{
+    for(auto& packet : parity)
+    {
+        pool.emplace(std::move(packet.second));
+    }
+    parity.clear();
+
+    if (groupSize == 0 || packets.empty()) return;
+
+    packetCount = static_cast<uint32_t>(packets.size());
+    parityGroupSize = groupSize;
+
+    uint32_t numGroups = (packetCount + groupSize - 1) / groupSize;
+    for(uint32_t group = 0; group < numGroups; ++group)
+    {
+        auto parityPacket = createPacket();
+        parityPacket->header = packets.begin()->second->header;
+        parityPacket->header.packetIndex = packetCount + group;
+        parityPacket->header.parityGroupSize = groupSize;
+
+        // the parity covers the largest packet in the group, which is always the first.
+        uint32_t begin = group * groupSize;
+        uint32_t end = std::min(begin + groupSize, packetCount);
+        parityPacket->header.packetSize = packets[begin]->header.packetSize;
+
+        std::memset(parityPacket->data, 0, parityPacket->header.packetSize);
+        for(uint32_t i = begin; i < end; ++i)
+        {
+            auto& packet = packets[i];
+            packet->header.parityGroupSize = groupSize;
+            xorInto(parityPacket->data, packet->data, packet->header.packetSize);
+        }
+
+        parity[group] = std::move(parityPacket);
+    }
+}
+
+bool PacketSet::recover()
+{
+    if (parityGroupSize == 0 || packetCount == 0) return false;
+
+    for(auto& [group, parityPacket] : parity)
+    {
+        uint32_t begin = group * parityGroupSize;
+        uint32_t end = std::min(begin + parityGroupSize, packetCount);
 
-    packets[packet->header.packetIndex] = std::move(packet);
+        uint32_t missingCount = 0;
+        uint32_t missingIndex = 0;
+        for(uint32_t i = begin; i < end && missingCount < 2; ++i)
+        {
+            if (packets.count(i) == 0)
+            {
+                ++missingCount;
+                missingIndex = i;
+            }
+        }
+
+        if (missingCount != 1) continue;
+
+        // only the last packet is short, so a totalSize that doesn't put it within DATA_SIZE is corrupt
+        uint64_t offset = uint64_t(missingIndex) * DATA_SIZE;
+        if (totalSize <= offset || (missingIndex + 1 == packetCount && totalSize - offset > DATA_SIZE)) continue;
+
+        // missing packet = parity XOR all the other packets of the group
+        auto packet = createPacket();
+        packet->header = parityPacket->header;
+        packet->header.packetIndex = missingIndex;
+        packet->header.packetSize = (missingIndex + 1 < packetCount) ? static_cast<uint32_t>(DATA_SIZE) : static_cast<uint32_t>(totalSize - offset);
 
-    return complete;
+        std::memcpy(packet->data, parityPacket->data, parityPacket->header.packetSize);
+        for(uint32_t i = begin; i < end; ++i)
+        {
+            if (i == missingIndex) continue;
+            auto& other = packets[i];
+            xorInto(packet->data, other->data, other->header.packetSize);
+        }
+
+        packets[missingIndex] = std::move(packet);
+    }
+
+    return packets.size() == packetCount;
+}
+
+void PacketSet::missing(std::vector<uint32_t>& indices) const
+{
+    indices.clear();
+    for(uint32_t i = 0; i < packetCount; ++i)
+    {
+        if (packets.count(i) == 0) indices.push_back(i);
+    }
 }
 
 void PacketSet::copy(const std::string& str)
@@ -58,7 +213,7 @@ void PacketSet::copy(const std::string& str)
         std::size_t remaining = totalSize - i;
 
         packet->header.packetIndex = packetIndex;
-        packet->header.packetSize = (remaining < DATA_SIZE) ? remaining : DATA_SIZE;
+        packet->header.packetSize = static_cast<uint32_t>((remaining < DATA_SIZE) ? remaining : DATA_SIZE);
 
         for(std::size_t j = 0; j < packet->header.packetSize; ++j, ++i)
         {
@@ -90,6 +245,8 @@ std::string PacketSet::assemble() const
 
     for(auto& packet : packets)
     {
+        if (i + packet.second->header.packetSize > totalSize) break;
+
         for(std::size_t j=0; j<packet.second->header.packetSize; ++j, ++i)
         {
             str[i] = packet.second->data[j];
@@ -99,30 +256,248 @@ std::string PacketSet::assemble() const
     return str;
 }
 
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// PacketOutputBuffer
+//
+PacketOutputBuffer::PacketOutputBuffer(PacketSet& in_packetSet) :
+    packetSet(in_packetSet)
+{
+    packetSet.clear();
+}
+
+void PacketOutputBuffer::nextPacket()
+{
+    if (currentPacket)
+    {
+        currentPacket->header.packetSize = static_cast<uint32_t>(pptr() - pbase());
+        totalSize += currentPacket->header.packetSize;
+    }
+
+    auto packet = packetSet.createPacket();
+    packet->header.packetIndex = packetIndex;
+    packet->header.packetSize = 0;
+
+    currentPacket = packet.get();
+    packetSet.packets[packetIndex++] = std::move(packet);
+
+    char_type* begin = reinterpret_cast<char_type*>(currentPacket->data);
+    setp(begin, begin + DATA_SIZE);
+}
+
+PacketOutputBuffer::int_type PacketOutputBuffer::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+
+    if (pptr() == epptr()) nextPacket();
+
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+
+    return c;
+}
+
+std::streamsize PacketOutputBuffer::xsputn(const char_type* s, std::streamsize n)
+{
+    std::streamsize written = 0;
+    while (written < n)
+    {
+        if (pptr() == epptr()) nextPacket();
+
+        std::streamsize available = epptr() - pptr();
+        std::streamsize count = std::min(available, n - written);
+
+        std::memcpy(pptr(), s + written, static_cast<std::size_t>(count));
+        pbump(static_cast<int>(count));
+        written += count;
+    }
+    return written;
+}
+
+PacketOutputBuffer::pos_type PacketOutputBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    // only support querying the current position, tellp()
+    if (off != 0 || dir != std::ios_base::cur || (which & std::ios_base::out) == 0) return pos_type(off_type(-1));
+
+    return pos_type(static_cast<off_type>(totalSize + (pptr() - pbase())));
+}
+
+void PacketOutputBuffer::finish()
+{
+    if (currentPacket)
+    {
+        currentPacket->header.packetSize = static_cast<uint32_t>(pptr() - pbase());
+        totalSize += currentPacket->header.packetSize;
+        currentPacket = nullptr;
+    }
+    setp(nullptr, nullptr);
+
+    packetSet.packetCount = packetIndex;
+    packetSet.totalSize = totalSize;
+
+    for(auto& packet : packetSet.packets)
+    {
+        packet.second->header.packetCount = packetIndex;
+        packet.second->header.totalSize = totalSize;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// PacketInputBuffer
+//
+PacketInputBuffer::PacketInputBuffer(const PacketSet& in_packetSet)
+{
+    orderedPackets.reserve(in_packetSet.packets.size());
+    for(auto& packet : in_packetSet.packets)
+    {
+        orderedPackets.push_back(packet.second.get());
+    }
+
+    itr = orderedPackets.data();
+    end = itr + orderedPackets.size();
+}
+
+PacketInputBuffer::PacketInputBuffer(const Packet* const* in_packets, std::size_t in_count) :
+    itr(in_packets),
+    end(in_packets + in_count)
+{
+}
+
+PacketInputBuffer::int_type PacketInputBuffer::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    // move on to the next non empty packet
+    consumed += static_cast<std::size_t>(egptr() - eback());
+    while (itr != end)
+    {
+        const Packet& packet = **itr;
+        ++itr;
+
+        if (packet.header.packetSize > 0)
+        {
+            char_type* begin = const_cast<char_type*>(reinterpret_cast<const char_type*>(packet.data));
+            setg(begin, begin, begin + packet.header.packetSize);
+            return traits_type::to_int_type(*gptr());
+        }
+    }
+
+    setg(nullptr, nullptr, nullptr);
+    return traits_type::eof();
+}
+
+PacketInputBuffer::pos_type PacketInputBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    // only support querying the current position, tellg()
+    if (off != 0 || dir != std::ios_base::cur || (which & std::ios_base::in) == 0) return pos_type(off_type(-1));
+
+    return pos_type(static_cast<off_type>(consumed + (gptr() - eback())));
+}
+
 //////////////////////////////////////////////////////////////////////////////////////
 //
 // PacketBroadcaster
 //
+PacketBroadcaster::~PacketBroadcaster()
+{
+    stopRetransmitService();
+}
+
 void PacketBroadcaster::broadcast(uint64_t set, vsg::ref_ptr<vsg::Object> object)
 {
     auto options = vsg::Options::create();
     options->extensionHint = "vsgb";
 
-    std::ostringstream ostr(std::ios::out | std::ios::binary);
+    std::scoped_lock<std::mutex> lock(historyMutex);
+
+    // reuse the oldest PacketSet in the history, or create a new one if the history isn't full yet
+    std::unique_ptr<PacketSet> packets;
+    if (history.size() >= std::max(historySize, 1u))
+    {
+        packets = std::move(history.front());
+        history.pop_front();
+    }
+    else
+    {
+        packets.reset(new PacketSet);
+    }
+
+    // serialize straight into the packets rather than via an std::ostringstream and PacketSet::copy()
+    PacketOutputBuffer buffer(*packets);
+    std::ostream ostr(&buffer);
     vsg::VSG rw;
     rw.write(object, ostr, options);
+    buffer.finish();
+
+    packets->set = set;
+    packets->addParity(parityGroupSize);
+
+    buffers.clear();
+    for(auto* container : {&packets->packets, &packets->parity})
+    {
+        for(auto& packet : *container)
+        {
+            Packet& ref = *packet.second;
+            ref.header.set = set;
+            std::size_t size = sizeof(Packet::Header) + ref.header.packetSize;
+            buffers.push_back(BufferView{&ref, static_cast<unsigned int>(size)});
+        }
+    }
+
+    broadcaster->broadcast(buffers);
 
-    packets.copy(ostr.str());
+    history.push_back(std::move(packets));
+}
+
+void PacketBroadcaster::retransmit(const Nack& nack)
+{
+    std::scoped_lock<std::mutex> lock(historyMutex);
 
-    for(auto& packet : packets.packets)
+    for(auto& packets : history)
     {
-        Packet& ref = *packet.second;
-        ref.header.set = set;
-        std::size_t size = sizeof(Packet::Header) + ref.header.packetSize;
-        broadcaster->broadcast(&ref, static_cast<unsigned int>(size));
+        if (packets->set != nack.set) continue;
+
+        uint32_t count = std::min(nack.count, Nack::MAX_INDICES);
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            auto itr = packets->packets.find(nack.indices[i]);
+            if (itr == packets->packets.end()) continue;
+
+            Packet& ref = *itr->second;
+            std::size_t size = sizeof(Packet::Header) + ref.header.packetSize;
+            broadcaster->broadcast(&ref, static_cast<unsigned int>(size));
+        }
+        return;
     }
 }
 
+void PacketBroadcaster::startRetransmitService(vsg::ref_ptr<Receiver> in_nackReceiver)
+{
+    stopRetransmitService();
+
+    nackReceiver = in_nackReceiver;
+    retransmitActive = true;
+
+    retransmitThread = std::thread([this]() {
+        Nack nack;
+        while (retransmitActive)
+        {
+            // receive() times out after a second so retransmitActive is checked regularly
+            unsigned int size = nackReceiver->receive(&nack, sizeof(Nack));
+            if (size < offsetof(Nack, indices)) continue;
+
+            nack.count = std::min(nack.count, static_cast<uint32_t>((size - offsetof(Nack, indices)) / sizeof(uint32_t)));
+            retransmit(nack);
+        }
+    });
+}
+
+void PacketBroadcaster::stopRetransmitService()
+{
+    retransmitActive = false;
+    if (retransmitThread.joinable()) retransmitThread.join();
+}
 
 //////////////////////////////////////////////////////////////////////////////////////
 //
@@ -166,8 +541,9 @@ vsg::ref_ptr<vsg::Object> PacketReceiver::completed(uint64_t set)
     auto set_itr = packetSetMap.find(set);
     if (set_itr == packetSetMap.end()) return {};
 
-    // convert the PacketSet into a vsg::Object
-    std::istringstream istr((set_itr->second)->assemble());
+    // convert the PacketSet into a vsg::Object, reading directly from the packets rather than PacketSet::assemble()
+    PacketInputBuffer buffer(*(set_itr->second));
+    std::istream istr(&buffer);
     vsg::VSG rw;
     auto object = rw.read(istr);
 
@@ -185,12 +561,47 @@ vsg::ref_ptr<vsg::Object> PacketReceiver::completed(uint64_t set)
     return object;
 }
 
-bool PacketReceiver::add(std::unique_ptr<Packet> packet)
+void PacketReceiver::requestRetransmit(PacketSet& packetSet)
+{
+    if (!nackBroadcaster || packetSet.nackCount >= maxNacks) return;
+
+    std::vector<uint32_t> indices;
+    packetSet.missing(indices);
+    if (indices.empty()) return;
+
+    Nack nack;
+    nack.set = packetSet.set;
+    nack.count = std::min(static_cast<uint32_t>(indices.size()), Nack::MAX_INDICES);
+    std::memcpy(nack.indices, indices.data(), nack.count * sizeof(uint32_t));
+
+    nackBroadcaster->broadcast(&nack, static_cast<unsigned int>(offsetof(Nack, indices) + nack.count * sizeof(uint32_t)));
+
+    ++packetSet.nackCount;
+}
+
+bool PacketReceiver::recoverOrRequestRetransmit(PacketSet& packetSet)
+{
+    if (packetSet.recover()) return true;
+
+    requestRetransmit(packetSet);
+    return false;
+}
+
+bool PacketReceiver::add(std::unique_ptr<Packet> packet, std::size_t receivedSize, uint64_t& completedSet)
 {
     uint64_t set = packet->header.set;
+    std::optional<uint64_t> recoveredSet;
 
     if (packetSetMap.count(set) == 0)
     {
+        // a new set has started arriving, so any packets still missing from the most recent earlier set have been lost.
+        auto previous_itr = packetSetMap.lower_bound(set);
+        if (previous_itr != packetSetMap.begin())
+        {
+            --previous_itr;
+            if (recoverOrRequestRetransmit(*(previous_itr->second))) recoveredSet = previous_itr->first;
+        }
+
         // packet applies to a new set.
         // need to get a PacketSet from the pool if one is available.
         if (!packetSetPool.empty())
@@ -205,7 +616,14 @@ bool PacketReceiver::add(std::unique_ptr<Packet> packet)
             packetSetMap[set] = std::unique_ptr<PacketSet>(new PacketSet);
         }
     }
-    return packetSetMap[set]->add(std::move(packet));
+    completedSet = set;
+    if (packetSetMap[set]->add(std::move(packet), receivedSize)) return true;
+
+    // completed() discards the earlier sets, so the recovered set is only reported if the new one isn't complete
+    if (!recoveredSet) return false;
+
+    completedSet = *recoveredSet;
+    return true;
 }
 
 vsg::ref_ptr<vsg::Object> PacketReceiver::receive()
@@ -215,11 +633,12 @@ vsg::ref_ptr<vsg::Object> PacketReceiver::receive()
     if (first_size == 0)
     {
         packetPool.emplace(std::move(first_packet));
+        if (!packetSetMap.empty() && recoverOrRequestRetransmit(*(packetSetMap.rbegin()->second))) return completed(packetSetMap.rbegin()->first);
         return {};
     }
 
-    uint64_t set = first_packet->header.set;
-    if (add(std::move(first_packet)))
+    uint64_t set = 0;
+    if (add(std::move(first_packet), first_size, set))
     {
         return completed(set);
     }
@@ -231,11 +650,11 @@ vsg::ref_ptr<vsg::Object> PacketReceiver::receive()
         if (size == 0)
         {
             packetPool.emplace(std::move(packet));
+            if (!packetSetMap.empty() && recoverOrRequestRetransmit(*(packetSetMap.rbegin()->second))) return completed(packetSetMap.rbegin()->first);
             return {};
         }
 
-        set = packet->header.set;
-        if (add(std::move(packet)))
+        if (add(std::move(packet), size, set))
         {
             return completed(set);
         }
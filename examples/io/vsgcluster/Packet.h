@@ -1,8 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <map>
-#include <stack>
 #include <memory>
+#include <mutex>
+#include <stack>
+#include <streambuf>
+#include <thread>
+#include <vector>
 
 #include "Broadcaster.h"
 #include "Receiver.h"
@@ -22,8 +28,12 @@ struct Packet
         uint64_t totalSize = 0;
         uint32_t packetCount = 0;
 
+        // packetIndex >= packetCount denotes a parity packet covering the data packets of group (packetIndex - packetCount)
         uint32_t packetIndex = 0;
-        uint64_t packetSize = 0;
+        uint32_t packetSize = 0;
+
+        // number of data packets covered by each XOR parity packet, 0 when no parity packets are sent
+        uint32_t parityGroupSize = 0;
 
         uint64_t hash = 0;
     } header;
@@ -31,10 +41,26 @@ struct Packet
     uint8_t data[DATA_SIZE];
 };
 
+// Negative acknowledgement sent by a receiver to request retransmission of the listed packets of a set
+struct Nack
+{
+    static constexpr uint32_t MAX_INDICES = 1024;
+
+    uint64_t set = 0;
+    uint32_t count = 0;
+    uint32_t indices[MAX_INDICES];
+};
+
 struct PacketSet
 {
     uint64_t set = 0;
+    uint32_t packetCount = 0;
+    uint64_t totalSize = 0;
+    uint32_t parityGroupSize = 0;
+    uint32_t nackCount = 0;
+
     std::map<uint32_t, std::unique_ptr<Packet>> packets;
+    std::map<uint32_t, std::unique_ptr<Packet>> parity;
     std::stack<std::unique_ptr<Packet>> pool;
 
     std::unique_ptr<Packet> takePacketFromPool()
@@ -59,32 +85,122 @@ struct PacketSet
     }
 
     void clear();
-    bool add(std::unique_ptr<Packet> packet);
+
+    // add a packet of receivedSize bytes, returns true if the set is then complete. Packets whose packetSize overruns
+    // Packet::data or the bytes received are dropped.
+    bool add(std::unique_ptr<Packet> packet, std::size_t receivedSize);
+
+    // number of parity packets sent with the set
+    uint32_t numParityGroups() const { return parityGroupSize > 0 ? (packetCount + parityGroupSize - 1) / parityGroupSize : 0; }
+
+    // create an XOR parity packet for each group of groupSize data packets, called after the data packets are complete.
+    void addParity(uint32_t groupSize);
+
+    // rebuild any data packet that is the only one missing from its parity group, returns true if the set is then complete.
+    // Called by add() once the set's last parity packet has arrived, and by PacketReceiver when the set times out.
+    bool recover();
+
+    // the index of data packets not yet received
+    void missing(std::vector<uint32_t>& indices) const;
 
     void copy(const std::string& str);
     std::string assemble() const;
 };
 
+// std::streambuf that serializes straight into pooled Packet::data, avoiding the intermediate std::string and per byte copy of PacketSet::copy()
+class PacketOutputBuffer : public std::streambuf
+{
+public:
+    explicit PacketOutputBuffer(PacketSet& in_packetSet);
+
+    // complete the last packet and assign the packetCount and totalSize to all packets headers.
+    void finish();
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char_type* s, std::streamsize n) override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+
+    void nextPacket();
+
+    PacketSet& packetSet;
+    Packet* currentPacket = nullptr;
+    uint32_t packetIndex = 0;
+    std::size_t totalSize = 0;
+};
+
+// std::streambuf that reads directly from the Packet::data of a complete PacketSet, avoiding the copies of PacketSet::assemble()
+class PacketInputBuffer : public std::streambuf
+{
+public:
+    explicit PacketInputBuffer(const PacketSet& in_packetSet);
+
+    // read from an array of packets ordered by packetIndex, such as a PacketRing slot
+    PacketInputBuffer(const Packet* const* in_packets, std::size_t in_count);
+
+protected:
+    int_type underflow() override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+
+    std::vector<const Packet*> orderedPackets;
+    const Packet* const* itr = nullptr;
+    const Packet* const* end = nullptr;
+    std::size_t consumed = 0;
+};
+
 struct PacketBroadcaster
 {
+    ~PacketBroadcaster();
+
     vsg::ref_ptr<Broadcaster> broadcaster;
 
-    PacketSet packets;
+    // number of data packets covered by each parity packet, 0 disables parity packets
+    uint32_t parityGroupSize = 0;
+
+    // number of recent PacketSet retained for retransmission
+    uint32_t historySize = 4;
+
+    std::mutex historyMutex;
+    std::deque<std::unique_ptr<PacketSet>> history;
+    std::vector<BufferView> buffers;
 
     void broadcast(uint64_t set, vsg::ref_ptr<vsg::Object> object);
+
+    // resend the packets listed in nack if the set is still in the history
+    void retransmit(const Nack& nack);
+
+    // start a thread that listens for Nack from receivers and retransmits the requested packets
+    void startRetransmitService(vsg::ref_ptr<Receiver> in_nackReceiver);
+    void stopRetransmitService();
+
+    vsg::ref_ptr<Receiver> nackReceiver;
+    std::atomic<bool> retransmitActive{false};
+    std::thread retransmitThread;
 };
 
 struct PacketReceiver
 {
     vsg::ref_ptr<Receiver> receiver;
 
+    // optional channel back to the PacketBroadcaster for requesting retransmission of missing packets
+    vsg::ref_ptr<Broadcaster> nackBroadcaster;
+
+    // maximum number of Nack sent for any one set
+    uint32_t maxNacks = 2;
+
     std::map<uint64_t, std::unique_ptr<PacketSet>> packetSetMap;
 
     std::stack<std::unique_ptr<Packet>> packetPool;
     std::stack<std::unique_ptr<PacketSet>> packetSetPool;
 
     std::unique_ptr<Packet> createPacket();
-    bool add(std::unique_ptr<Packet> packet);
+
+    // add a packet of receivedSize bytes, returns true and assigns completedSet when a set is complete
+    bool add(std::unique_ptr<Packet> packet, std::size_t receivedSize, uint64_t& completedSet);
+
+    // try to recover the set's missing packets from parity, and failing that request their retransmission
+    bool recoverOrRequestRetransmit(PacketSet& packetSet);
+    void requestRetransmit(PacketSet& packetSet);
 
     vsg::ref_ptr<vsg::Object> completed(uint64_t set);
     vsg::ref_ptr<vsg::Object> receive();
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <iostream>
+
+#include "PacketRing.h"
+
+#include <vsg/io/VSG.h>
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// PacketRing
+//
+PacketRing::PacketRing(vsg::ref_ptr<Receiver> in_receiver, uint32_t in_numSlots, uint32_t in_maxPacketsPerSet, uint32_t in_batchSize) :
+    receiver(in_receiver),
+    numSlots(std::max(in_numSlots, 2u)),
+    maxPacketsPerSet(std::max(in_maxPacketsPerSet, 1u))
+{
+    uint32_t batchSize = std::max(in_batchSize, 1u);
+
+    // allocate all the packets up front, each slot entry and each batch entry always points to a unique Packet and these are swapped as packets arrive.
+    storage.reserve(numSlots * maxPacketsPerSet + batchSize);
+
+    slots.reset(new Slot[numSlots]);
+    for (uint32_t s = 0; s < numSlots; ++s)
+    {
+        auto& slot = slots[s];
+        slot.packets.resize(maxPacketsPerSet);
+        slot.filled.resize(maxPacketsPerSet, 0);
+        for (auto& packet : slot.packets)
+        {
+            storage.emplace_back(new Packet);
+            packet = storage.back().get();
+        }
+    }
+
+    batch.resize(batchSize);
+    buffers.resize(batchSize);
+    for (uint32_t i = 0; i < batchSize; ++i)
+    {
+        storage.emplace_back(new Packet);
+        batch[i] = storage.back().get();
+        buffers[i] = batch[i];
+    }
+}
+
+PacketRing::~PacketRing()
+{
+    stop();
+}
+
+void PacketRing::start()
+{
+    if (active.exchange(true)) return;
+
+    thread = std::thread([this]() { run(); });
+}
+
+void PacketRing::stop()
+{
+    active = false;
+
+    if (thread.joinable()) thread.join();
+}
+
+void PacketRing::run()
+{
+    while (active)
+    {
+        unsigned int count = receiver->receive(buffers, sizeof(Packet), sizes);
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            if (sizes[i] < sizeof(Packet::Header))
+            {
+                ++droppedPackets;
+                continue;
+            }
+
+            insert(batch[i], sizes[i]);
+
+            // insert() may have swapped in a different Packet so update the buffer we receive into next
+            buffers[i] = batch[i];
+        }
+    }
+}
+
+void PacketRing::reset(Slot& slot, const Packet::Header& header)
+{
+    slot.set = header.set;
+    slot.packetCount = header.packetCount;
+    slot.received = 0;
+    std::fill(slot.filled.begin(), slot.filled.begin() + header.packetCount, 0);
+}
+
+void PacketRing::insert(Packet*& packet, unsigned int receivedSize)
+{
+    const auto& header = packet->header;
+
+    // the payload has to fit in the slot's Packet and have been received in full, or reading the set would overrun it
+    if (header.packetSize > DATA_SIZE || sizeof(Packet::Header) + header.packetSize > receivedSize)
+    {
+        ++droppedPackets;
+        return;
+    }
+
+    // parity packets are only used by the PacketSet code path
+    if (header.packetIndex >= header.packetCount && header.parityGroupSize > 0) return;
+
+    if (header.packetCount == 0 || header.packetCount > maxPacketsPerSet || header.packetIndex >= header.packetCount)
+    {
+        ++droppedPackets;
+        return;
+    }
+
+    Slot& slot = slots[header.set % numSlots];
+
+    // only the network thread moves a slot out of FREE or FILLING, the render thread only claims COMPLETE slots and releases them back to FREE.
+    uint32_t state = slot.state.load(std::memory_order_acquire);
+    switch (state)
+    {
+    case (FREE):
+        reset(slot, header);
+        slot.state.store(FILLING, std::memory_order_relaxed);
+        break;
+    case (FILLING):
+        if (slot.set != header.set)
+        {
+            // packet from an older set than the one being filled
+            if (header.set < slot.set)
+            {
+                ++droppedPackets;
+                return;
+            }
+
+            // newer set has started so abandon the incomplete one
+            reset(slot, header);
+        }
+        break;
+    case (COMPLETE):
+        if (header.set <= slot.set)
+        {
+            ++droppedPackets;
+            return;
+        }
+
+        // reclaim the unread, older set, unless the render thread has just started reading it
+        if (!slot.state.compare_exchange_strong(state, FILLING, std::memory_order_acquire))
+        {
+            ++droppedPackets;
+            return;
+        }
+        reset(slot, header);
+        break;
+    default:
+        // slot is being read by the render thread
+        ++droppedPackets;
+        return;
+    }
+
+    if (slot.filled[header.packetIndex] != 0)
+    {
+        // duplicate packet
+        return;
+    }
+
+    std::swap(slot.packets[header.packetIndex], packet);
+    slot.filled[header.packetIndex] = 1;
+
+    if (++slot.received == slot.packetCount)
+    {
+        ++completedSets;
+        slot.state.store(COMPLETE, std::memory_order_release);
+    }
+}
+
+vsg::ref_ptr<vsg::Object> PacketRing::read()
+{
+    // find the most recent completed set that is newer than the last one read
+    Slot* latest = nullptr;
+    for (uint32_t s = 0; s < numSlots; ++s)
+    {
+        auto& slot = slots[s];
+        uint32_t expected = COMPLETE;
+        if (!slot.state.compare_exchange_strong(expected, READING, std::memory_order_acquire)) continue;
+
+        if ((hasRead && slot.set <= lastReadSet) || (latest && slot.set < latest->set))
+        {
+            // stale set, release it back to the network thread
+            slot.state.store(FREE, std::memory_order_release);
+            continue;
+        }
+
+        if (latest) latest->state.store(FREE, std::memory_order_release);
+        latest = &slot;
+    }
+
+    if (!latest) return {};
+
+    // convert the slot's packets into a vsg::Object, reading directly from the packets
+    vsg::ref_ptr<vsg::Object> object;
+    {
+        PacketInputBuffer buffer(latest->packets.data(), latest->packetCount);
+        std::istream istr(&buffer);
+        vsg::VSG rw;
+        object = rw.read(istr);
+    }
+
+    hasRead = true;
+    lastReadSet = latest->set;
+
+    latest->state.store(FREE, std::memory_order_release);
+
+    return object;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Packet.h"
+
+// Fixed capacity ring of frame slots, each slot holding a table of packets indexed by packetIndex.
+// A dedicated network thread receives batches of packets via Receiver::receive(buffers, ...) and swaps them into the slot for their set,
+// while the render thread reads the most recently completed set. All Packets are allocated up front so steady state receiving does
+// no heap allocation or map rebalancing, and the two threads only synchronize through the atomic state of each slot.
+class PacketRing
+{
+public:
+    PacketRing(vsg::ref_ptr<Receiver> in_receiver, uint32_t in_numSlots = 3, uint32_t in_maxPacketsPerSet = 64, uint32_t in_batchSize = 32);
+    ~PacketRing();
+
+    // start and stop the network thread
+    void start();
+    void stop();
+
+    // non blocking read of the most recently completed set, returns null if no new set has completed since the last read. Called from the render thread.
+    vsg::ref_ptr<vsg::Object> read();
+
+    std::atomic<uint64_t> droppedPackets{0};
+    std::atomic<uint64_t> completedSets{0};
+
+protected:
+    enum SlotState : uint32_t
+    {
+        FREE,
+        FILLING,
+        COMPLETE,
+        READING
+    };
+
+    struct Slot
+    {
+        std::atomic<uint32_t> state{FREE};
+        uint64_t set = 0;
+        uint32_t packetCount = 0;
+        uint32_t received = 0;
+        std::vector<Packet*> packets;
+        std::vector<uint8_t> filled;
+    };
+
+    void run();
+    void insert(Packet*& packet, unsigned int receivedSize);
+    void reset(Slot& slot, const Packet::Header& header);
+
+    vsg::ref_ptr<Receiver> receiver;
+    uint32_t numSlots;
+    uint32_t maxPacketsPerSet;
+
+    std::vector<std::unique_ptr<Packet>> storage;
+    std::unique_ptr<Slot[]> slots;
+
+    // network thread's batch of packets being received into
+    std::vector<Packet*> batch;
+    std::vector<void*> buffers;
+    std::vector<unsigned int> sizes;
+
+    // render thread's record of the last set read
+    bool hasRead = false;
+    uint64_t lastReadSet = 0;
+
+    std::atomic<bool> active{false};
+    std::thread thread;
+};
@@ -37,7 +37,8 @@
 
 Receiver::Receiver(uint16_t port) :
     _initialized(false),
-    _port(port)
+    _port(port),
+    _timeout(1.0)
 {
 #if defined(WIN32) && !defined(__CYGWIN__)
     WORD version = MAKEWORD(1, 1);
@@ -88,9 +89,29 @@ bool Receiver::init(void)
     saddr.sin_addr.s_addr = 0;
 #endif
 
-    // set up a 1 second timeout.
+    if (!applyTimeout()) return false;
+
+    if (bind(_so, (struct sockaddr*)&saddr, sizeof(saddr)) < 0)
+    {
+        perror("bind");
+        return false;
+    }
+
+    _initialized = true;
+    return _initialized;
+}
+
+void Receiver::setTimeout(double timeout)
+{
+    _timeout = timeout;
+    if (_initialized) applyTimeout();
+}
+
+bool Receiver::applyTimeout(void)
+{
 #if defined(WIN32) && !defined(__CYGWIN__)
-    DWORD tv = 1000; // 1 sec in ms
+    DWORD tv = static_cast<DWORD>(_timeout * 1000.0);
+    if (tv == 0) tv = 1; // a zero timeout would block indefinitely
     if (setsockopt(_so, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv), sizeof(DWORD)))
     {
         perror("setsockopt");
@@ -98,23 +119,16 @@ bool Receiver::init(void)
     }
 #else
     struct timeval tv;
-    tv.tv_sec = 1;
-    tv.tv_usec = 0;
+    tv.tv_sec = static_cast<time_t>(_timeout);
+    tv.tv_usec = static_cast<suseconds_t>((_timeout - static_cast<double>(tv.tv_sec)) * 1000000.0);
+    if (tv.tv_sec == 0 && tv.tv_usec == 0) tv.tv_usec = 1; // a zero timeout would block indefinitely
     if (setsockopt(_so, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
     {
         perror("setsockopt");
         return false;
     }
 #endif
-
-    if (bind(_so, (struct sockaddr*)&saddr, sizeof(saddr)) < 0)
-    {
-        perror("bind");
-        return false;
-    }
-
-    _initialized = true;
-    return _initialized;
+    return true;
 }
 
 unsigned int Receiver::receive(void* buffer, const unsigned int buffer_size)
@@ -147,7 +161,8 @@ unsigned int Receiver::receive(void* buffer, const unsigned int buffer_size)
         int err = WSAGetLastError();
         if (err == WSAETIMEDOUT)
         {
-            std::cout << "Receiver::sync() : Connection timed out." << std::endl;
+            // timeouts are expected when using short timeouts, so only report them when using the default
+            if (_timeout >= 1.0) std::cout << "Receiver::sync() : Connection timed out." << std::endl;
             return 0;
         }
 
@@ -171,7 +186,8 @@ unsigned int Receiver::receive(void* buffer, const unsigned int buffer_size)
 
     if (read_bytes < 0)
     {
-        std::cerr << "Receiver::sync() : " << strerror(errno) << std::endl;
+        // timeouts are expected when using short timeouts, so only report them when using the default
+        if ((errno != EAGAIN && errno != EWOULDBLOCK) || _timeout >= 1.0) std::cerr << "Receiver::sync() : " << strerror(errno) << std::endl;
         return 0;
     }
 
@@ -179,3 +195,52 @@ unsigned int Receiver::receive(void* buffer, const unsigned int buffer_size)
 
     return static_cast<unsigned int>(read_bytes);
 }
+
+unsigned int Receiver::receive(const std::vector<void*>& buffers, const unsigned int buffer_size, std::vector<unsigned int>& sizes)
+{
+    if (!_initialized) init();
+
+    sizes.resize(buffers.size());
+    if (buffers.empty()) return 0;
+
+#if defined(__linux)
+
+    // reuse the iovec and mmsghdr containers from previous calls so steady state receiving doesn't allocate
+    _iovecs.resize(buffers.size());
+    _messages.resize(buffers.size());
+
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        _iovecs[i].iov_base = buffers[i];
+        _iovecs[i].iov_len = buffer_size;
+
+        memset(&_messages[i], 0, sizeof(struct mmsghdr));
+        _messages[i].msg_hdr.msg_iov = &_iovecs[i];
+        _messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // MSG_WAITFORONE blocks, up to the SO_RCVTIMEO timeout, for the first message then returns whatever else is already queued.
+    int result = recvmmsg(_so, _messages.data(), static_cast<unsigned int>(_messages.size()), MSG_WAITFORONE, nullptr);
+    if (result < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            std::cerr << "Receiver::receive() : " << strerror(errno) << std::endl;
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < result; ++i)
+    {
+        sizes[i] = _messages[i].msg_len;
+    }
+
+    return static_cast<unsigned int>(result);
+
+#else
+
+    sizes[0] = receive(buffers[0], buffer_size);
+    return sizes[0] > 0 ? 1 : 0;
+
+#endif
+}
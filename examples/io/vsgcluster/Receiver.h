@@ -32,8 +32,12 @@
 #    include <winsock.h>
 #else
 #    include <netinet/in.h>
+#    include <sys/socket.h>
+#    include <sys/uio.h>
 #endif
 
+#include <vector>
+
 #include <vsg/core/Inherit.h>
 
 class Receiver : public vsg::Inherit<vsg::Object, Receiver>
@@ -41,11 +45,19 @@ class Receiver : public vsg::Inherit<vsg::Object, Receiver>
 public:
     Receiver(uint16_t port);
 
+    // Set the time in seconds that receive() will wait for a message before returning, defaults to 1 second.
+    void setTimeout(double timeout);
+
     // Sync does a blocking wait to receive next message
     unsigned int receive(void* buffer, const unsigned int buffer_size);
 
+    // Batched receive, does a blocking wait for the first message then reads as many queued messages as will fit in buffers, using recvmmsg() where available.
+    // Returns the number of messages received with the size of each written to sizes.
+    unsigned int receive(const std::vector<void*>& buffers, const unsigned int buffer_size, std::vector<unsigned int>& sizes);
+
 private:
     bool init(void);
+    bool applyTimeout(void);
 
 private:
     virtual ~Receiver();
@@ -60,4 +72,10 @@ private:
 
     bool _initialized;
     short _port;
+    double _timeout;
+
+#if defined(__linux)
+    std::vector<struct iovec> _iovecs;
+    std::vector<struct mmsghdr> _messages;
+#endif
 };
@@ -0,0 +1,254 @@
+#include "Replication.h"
+
+#include <vsg/core/Visitor.h>
+#include <vsg/io/ObjectFactory.h>
+
+using namespace cluster;
+
+// Register the ReplicationUpdate::create() method with vsg::ObjectFactory::instance() so it can be used for creating objects during reading.
+vsg::RegisterWithObjectFactoryProxy<cluster::ReplicationUpdate> s_Register_ReplicationUpdate;
+
+namespace
+{
+    struct CollectMatrixTransforms : public vsg::Visitor
+    {
+        std::vector<vsg::ref_ptr<vsg::MatrixTransform>> transforms;
+
+        void apply(vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(vsg::MatrixTransform& transform) override
+        {
+            transforms.push_back(vsg::ref_ptr<vsg::MatrixTransform>(&transform));
+            transform.traverse(*this);
+        }
+    };
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// ReplicationUpdate
+//
+void ReplicationUpdate::read(vsg::Input& input)
+{
+    vsg::Object::read(input);
+
+    input.read("set", set);
+    input.read("keyframe", keyframe);
+
+    uint32_t count = 0;
+    input.read("count", count);
+    entries.resize(count);
+
+    for (auto& entry : entries)
+    {
+        uint32_t type = OBJECT;
+        input.read("id", entry.id);
+        input.read("type", type);
+        entry.type = static_cast<Type>(type);
+
+        switch (entry.type)
+        {
+        case (LOOKAT):
+            input.read("eye", entry.eye);
+            input.read("center", entry.center);
+            input.read("up", entry.up);
+            break;
+        case (MATRIX):
+            input.read("matrix", entry.matrix);
+            break;
+        default:
+            input.read("object", entry.object);
+            break;
+        }
+    }
+}
+
+void ReplicationUpdate::write(vsg::Output& output) const
+{
+    vsg::Object::write(output);
+
+    output.write("set", set);
+    output.write("keyframe", keyframe);
+
+    output.write("count", static_cast<uint32_t>(entries.size()));
+    for (auto& entry : entries)
+    {
+        output.write("id", entry.id);
+        output.write("type", static_cast<uint32_t>(entry.type));
+
+        switch (entry.type)
+        {
+        case (LOOKAT):
+            output.write("eye", entry.eye);
+            output.write("center", entry.center);
+            output.write("up", entry.up);
+            break;
+        case (MATRIX):
+            output.write("matrix", entry.matrix);
+            break;
+        default:
+            output.write("object", entry.object);
+            break;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// ReplicationMaster
+//
+uint32_t ReplicationMaster::track(vsg::ref_ptr<vsg::Object> object)
+{
+    auto itr = ids.find(object.get());
+    if (itr != ids.end()) return itr->second;
+
+    uint32_t id = static_cast<uint32_t>(tracked.size());
+    ids[object.get()] = id;
+
+    Tracked entry;
+    entry.object = object;
+    if (object->is_compatible(typeid(vsg::LookAt)))
+        entry.type = ReplicationUpdate::LOOKAT;
+    else if (object->is_compatible(typeid(vsg::MatrixTransform)))
+        entry.type = ReplicationUpdate::MATRIX;
+
+    tracked.push_back(entry);
+
+    return id;
+}
+
+void ReplicationMaster::trackSubgraph(vsg::ref_ptr<vsg::Node> node)
+{
+    CollectMatrixTransforms collect;
+    node->accept(collect);
+
+    for (auto& transform : collect.transforms) track(transform);
+}
+
+void ReplicationMaster::dirty(const vsg::Object* object)
+{
+    auto itr = ids.find(object);
+    if (itr != ids.end()) tracked[itr->second].dirty = true;
+}
+
+vsg::ref_ptr<ReplicationUpdate> ReplicationMaster::update(uint64_t set)
+{
+    auto update = ReplicationUpdate::create();
+    update->set = set;
+    update->keyframe = (updatesSinceKeyframe == 0);
+
+    if (++updatesSinceKeyframe >= keyframeInterval) updatesSinceKeyframe = 0;
+
+    for (uint32_t id = 0; id < static_cast<uint32_t>(tracked.size()); ++id)
+    {
+        auto& entry = tracked[id];
+
+        bool changed = entry.dirty || update->keyframe;
+        switch (entry.type)
+        {
+        case (ReplicationUpdate::LOOKAT): {
+            auto lookAt = static_cast<vsg::LookAt*>(entry.object.get());
+            changed = changed || lookAt->eye != entry.eye || lookAt->center != entry.center || lookAt->up != entry.up;
+            if (changed)
+            {
+                entry.eye = lookAt->eye;
+                entry.center = lookAt->center;
+                entry.up = lookAt->up;
+            }
+            break;
+        }
+        case (ReplicationUpdate::MATRIX): {
+            auto transform = static_cast<vsg::MatrixTransform*>(entry.object.get());
+            changed = changed || transform->matrix != entry.matrix;
+            if (changed) entry.matrix = transform->matrix;
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (!changed) continue;
+
+        entry.dirty = false;
+
+        ReplicationUpdate::Entry updateEntry;
+        updateEntry.id = id;
+        updateEntry.type = entry.type;
+        updateEntry.eye = entry.eye;
+        updateEntry.center = entry.center;
+        updateEntry.up = entry.up;
+        updateEntry.matrix = entry.matrix;
+        if (entry.type == ReplicationUpdate::OBJECT) updateEntry.object = entry.object;
+
+        update->entries.push_back(updateEntry);
+    }
+
+    return update;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// ReplicationMirror
+//
+void ReplicationMirror::bind(uint32_t id, vsg::ref_ptr<vsg::Object> object)
+{
+    objects[id] = object;
+    if (id >= nextBindID) nextBindID = id + 1;
+}
+
+void ReplicationMirror::bindSubgraph(vsg::ref_ptr<vsg::Node> node)
+{
+    CollectMatrixTransforms collect;
+    node->accept(collect);
+
+    for (auto& transform : collect.transforms) bind(nextBindID, transform);
+}
+
+bool ReplicationMirror::apply(const ReplicationUpdate& update)
+{
+    // deltas are only meaningful against a mirror initialized by a keyframe
+    if (!update.keyframe && !receivedKeyframe) return false;
+
+    // discard updates that arrive out of order
+    if (receivedKeyframe && update.set <= lastSet) return false;
+
+    for (auto& entry : update.entries)
+    {
+        switch (entry.type)
+        {
+        case (ReplicationUpdate::LOOKAT):
+            if (auto lookAt = objects[entry.id].cast<vsg::LookAt>())
+            {
+                lookAt->eye = entry.eye;
+                lookAt->center = entry.center;
+                lookAt->up = entry.up;
+            }
+            else
+            {
+                objects[entry.id] = vsg::LookAt::create(entry.eye, entry.center, entry.up);
+            }
+            break;
+        case (ReplicationUpdate::MATRIX):
+            if (auto transform = objects[entry.id].cast<vsg::MatrixTransform>())
+            {
+                transform->matrix = entry.matrix;
+            }
+            else
+            {
+                objects[entry.id] = vsg::MatrixTransform::create(entry.matrix);
+            }
+            break;
+        default:
+            objects[entry.id] = entry.object;
+            break;
+        }
+    }
+
+    if (update.keyframe) receivedKeyframe = true;
+    lastSet = update.set;
+
+    return true;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <vsg/core/Inherit.h>
+#include <vsg/app/ViewMatrix.h>
+#include <vsg/nodes/MatrixTransform.h>
+#include <vsg/io/Input.h>
+#include <vsg/io/Output.h>
+
+namespace cluster
+{
+
+// Set of changes to replicated objects for a single frame, either a keyframe containing all tracked objects or a delta of just the changed ones.
+class ReplicationUpdate : public vsg::Inherit<vsg::Object, ReplicationUpdate>
+{
+public:
+    enum Type : uint32_t
+    {
+        LOOKAT,
+        MATRIX,
+        OBJECT
+    };
+
+    struct Entry
+    {
+        uint32_t id = 0;
+        Type type = OBJECT;
+
+        // LOOKAT
+        vsg::dvec3 eye;
+        vsg::dvec3 center;
+        vsg::dvec3 up;
+
+        // MATRIX
+        vsg::dmat4 matrix;
+
+        // OBJECT
+        vsg::ref_ptr<vsg::Object> object;
+    };
+
+    uint64_t set = 0;
+    bool keyframe = false;
+    std::vector<Entry> entries;
+
+    void read(vsg::Input& input) override;
+    void write(vsg::Output& output) const override;
+};
+
+// Tracks objects on the master by identity and generates ReplicationUpdate containing only the fields of the objects that have changed since the last update.
+// LookAt and MatrixTransform are compared against their last sent values automatically, other objects are only sent when marked dirty or in a keyframe.
+class ReplicationMaster
+{
+public:
+    // number of updates between full keyframes used to recover receivers from lost updates.
+    uint32_t keyframeInterval = 60;
+
+    // track an object, returning the id used to refer to it on the receivers
+    uint32_t track(vsg::ref_ptr<vsg::Object> object);
+
+    // track all the MatrixTransform in a subgraph, in traversal order, to match ReplicationMirror::bindSubgraph() on the receivers
+    void trackSubgraph(vsg::ref_ptr<vsg::Node> node);
+
+    // mark an object as needing to be sent in the next update
+    void dirty(const vsg::Object* object);
+
+    // create the update for frame set, containing only the changed objects unless a keyframe is due.
+    vsg::ref_ptr<ReplicationUpdate> update(uint64_t set);
+
+protected:
+    struct Tracked
+    {
+        vsg::ref_ptr<vsg::Object> object;
+        ReplicationUpdate::Type type = ReplicationUpdate::OBJECT;
+        bool dirty = true;
+
+        // last sent values
+        vsg::dvec3 eye;
+        vsg::dvec3 center;
+        vsg::dvec3 up;
+        vsg::dmat4 matrix;
+    };
+
+    std::vector<Tracked> tracked;
+    std::map<const vsg::Object*, uint32_t> ids;
+    uint32_t updatesSinceKeyframe = 0;
+};
+
+// Mirrored object table on a receiver that ReplicationUpdate from the master are applied to.
+class ReplicationMirror
+{
+public:
+    // bind a local object to the id used by the master
+    void bind(uint32_t id, vsg::ref_ptr<vsg::Object> object);
+
+    // bind all the MatrixTransform in a subgraph, in traversal order, to match ReplicationMaster::trackSubgraph() on the master
+    void bindSubgraph(vsg::ref_ptr<vsg::Node> node);
+
+    // apply update to the mirrored objects, returns false if the update was discarded as stale or as a delta without a preceding keyframe.
+    bool apply(const ReplicationUpdate& update);
+
+    std::map<uint32_t, vsg::ref_ptr<vsg::Object>> objects;
+    uint32_t nextBindID = 0;
+
+    bool receivedKeyframe = false;
+    uint64_t lastSet = 0;
+};
+
+} // namespace cluster
+
+EVSG_type_name(cluster::ReplicationUpdate);
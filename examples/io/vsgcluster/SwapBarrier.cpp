@@ -0,0 +1,163 @@
+#include "SwapBarrier.h"
+
+#include <algorithm>
+#include <iostream>
+
+using clock_type = std::chrono::steady_clock;
+
+static double secondsSince(clock_type::time_point start)
+{
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// SwapBarrierMaster
+//
+SwapBarrierMaster::SwapBarrierMaster(vsg::ref_ptr<Receiver> in_readyReceiver, vsg::ref_ptr<Broadcaster> in_releaseBroadcaster) :
+    readyReceiver(in_readyReceiver),
+    releaseBroadcaster(in_releaseBroadcaster)
+{
+}
+
+void SwapBarrierMaster::wait(uint64_t frame)
+{
+    auto start = clock_type::now();
+
+    std::map<uint32_t, bool> ready;
+    for (auto& [nodeID, stats] : nodes)
+    {
+        if (stats.active) ready[nodeID] = false;
+    }
+
+    // poll in small steps so the overall timeout is respected, with no active nodes only check for joining nodes without waiting
+    readyReceiver->setTimeout(ready.empty() ? 0.0 : std::min(timeout, 0.005));
+
+    size_t numReady = 0;
+    double elapsed = 0.0;
+    while ((elapsed = secondsSince(start)) < timeout)
+    {
+        BarrierMessage message;
+        unsigned int size = readyReceiver->receive(&message, sizeof(BarrierMessage));
+        if (size != sizeof(BarrierMessage) || message.type != BarrierMessage::READY)
+        {
+            // with no active nodes just poll once so new nodes can join without holding up the master
+            if (ready.empty()) break;
+            continue;
+        }
+
+        if (message.frame != frame)
+        {
+            // register new nodes so they are waited on from the next frame
+            if (nodes.count(message.nodeID) == 0)
+            {
+                std::cout << "SwapBarrierMaster node " << message.nodeID << " joined" << std::endl;
+                nodes[message.nodeID];
+            }
+        }
+        else if (!ready[message.nodeID])
+        {
+            if (nodes.count(message.nodeID) == 0) std::cout << "SwapBarrierMaster node " << message.nodeID << " joined" << std::endl;
+
+            auto& stats = nodes[message.nodeID];
+            if (!stats.active)
+            {
+                std::cout << "SwapBarrierMaster node " << message.nodeID << " rejoined" << std::endl;
+                stats.active = true;
+            }
+
+            double wait = secondsSince(start);
+            stats.totalWait += wait;
+            stats.maxWait = std::max(stats.maxWait, wait);
+            stats.consecutiveMisses = 0;
+            ++stats.frames;
+
+            ready[message.nodeID] = true;
+            ++numReady;
+        }
+
+        if (numReady == ready.size()) break;
+    }
+
+    for (auto& [nodeID, nodeReady] : ready)
+    {
+        if (nodeReady) continue;
+
+        auto& stats = nodes[nodeID];
+        ++stats.misses;
+        if (++stats.consecutiveMisses >= maxMissedFrames && stats.active)
+        {
+            std::cout << "SwapBarrierMaster ejecting node " << nodeID << " after " << stats.consecutiveMisses << " missed frames" << std::endl;
+            stats.active = false;
+            ++stats.ejections;
+        }
+    }
+
+    BarrierMessage release;
+    release.type = BarrierMessage::RELEASE;
+    release.frame = frame;
+    releaseBroadcaster->broadcast(&release, sizeof(BarrierMessage));
+}
+
+void SwapBarrierMaster::report(std::ostream& out) const
+{
+    out << "SwapBarrierMaster nodes = " << nodes.size() << std::endl;
+    for (auto& [nodeID, stats] : nodes)
+    {
+        double averageWait = stats.frames > 0 ? (stats.totalWait / static_cast<double>(stats.frames)) : 0.0;
+        out << "    node " << nodeID << (stats.active ? "" : " (ejected)") << " frames = " << stats.frames << ", misses = " << stats.misses << ", ejections = " << stats.ejections
+            << ", average wait = " << averageWait * 1000.0 << "ms, max wait = " << stats.maxWait * 1000.0 << "ms" << std::endl;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// SwapBarrierClient
+//
+SwapBarrierClient::SwapBarrierClient(uint32_t in_nodeID, vsg::ref_ptr<Broadcaster> in_readyBroadcaster, vsg::ref_ptr<Receiver> in_releaseReceiver) :
+    nodeID(in_nodeID),
+    readyBroadcaster(in_readyBroadcaster),
+    releaseReceiver(in_releaseReceiver)
+{
+}
+
+bool SwapBarrierClient::wait(uint64_t frame)
+{
+    auto start = clock_type::now();
+
+    releaseReceiver->setTimeout(std::min(timeout, 0.005));
+
+    BarrierMessage ready;
+    ready.type = BarrierMessage::READY;
+    ready.nodeID = nodeID;
+    ready.frame = frame;
+    readyBroadcaster->broadcast(&ready, sizeof(BarrierMessage));
+
+    ++frames;
+
+    double elapsed = 0.0;
+    while ((elapsed = secondsSince(start)) < timeout)
+    {
+        BarrierMessage message;
+        unsigned int size = releaseReceiver->receive(&message, sizeof(BarrierMessage));
+        if (size == sizeof(BarrierMessage) && message.type == BarrierMessage::RELEASE && message.frame >= frame)
+        {
+            releasedFrame = message.frame;
+            elapsed = secondsSince(start);
+            totalWait += elapsed;
+            maxWait = std::max(maxWait, elapsed);
+            return true;
+        }
+    }
+
+    ++timeouts;
+    totalWait += elapsed;
+    maxWait = std::max(maxWait, elapsed);
+    return false;
+}
+
+void SwapBarrierClient::report(std::ostream& out) const
+{
+    double averageWait = frames > 0 ? (totalWait / static_cast<double>(frames)) : 0.0;
+    out << "SwapBarrierClient node " << nodeID << " frames = " << frames << ", timeouts = " << timeouts << ", average wait = " << averageWait * 1000.0 << "ms, max wait = " << maxWait * 1000.0 << "ms" << std::endl;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <ostream>
+
+#include "Broadcaster.h"
+#include "Receiver.h"
+
+// Message exchanged between the SwapBarrierMaster and SwapBarrierClient
+struct BarrierMessage
+{
+    enum Type : uint32_t
+    {
+        READY = 1,
+        RELEASE = 2
+    };
+
+    uint32_t type = READY;
+    uint32_t nodeID = 0;
+    uint64_t frame = 0;
+};
+
+// Runs on the master, waits for all active nodes to report they are ready to present a frame before releasing them all to present together.
+// Nodes that miss maxMissedFrames consecutive barriers are ejected so they no longer hold up the cluster, and rejoin once they report ready in time again.
+class SwapBarrierMaster
+{
+public:
+    SwapBarrierMaster(vsg::ref_ptr<Receiver> in_readyReceiver, vsg::ref_ptr<Broadcaster> in_releaseBroadcaster);
+
+    // maximum time in seconds to wait for nodes
+    double timeout = 0.1;
+
+    // number of consecutive missed barriers after which a node is ejected
+    uint32_t maxMissedFrames = 10;
+
+    // wait for all active nodes to be ready for frame, then release them
+    void wait(uint64_t frame);
+
+    // write per node barrier statistics
+    void report(std::ostream& out) const;
+
+    struct NodeStats
+    {
+        bool active = true;
+        uint32_t consecutiveMisses = 0;
+        uint64_t frames = 0;
+        uint64_t misses = 0;
+        uint64_t ejections = 0;
+
+        // time from the start of the barrier until the node reported ready
+        double totalWait = 0.0;
+        double maxWait = 0.0;
+    };
+
+    std::map<uint32_t, NodeStats> nodes;
+
+protected:
+    vsg::ref_ptr<Receiver> readyReceiver;
+    vsg::ref_ptr<Broadcaster> releaseBroadcaster;
+};
+
+// Runs on each render node, reports ready for a frame and waits for the master to release it.
+class SwapBarrierClient
+{
+public:
+    SwapBarrierClient(uint32_t in_nodeID, vsg::ref_ptr<Broadcaster> in_readyBroadcaster, vsg::ref_ptr<Receiver> in_releaseReceiver);
+
+    // maximum time in seconds to wait for the release
+    double timeout = 0.1;
+
+    // report ready for frame then wait for its release, returns false if the wait timed out.
+    bool wait(uint64_t frame);
+
+    void report(std::ostream& out) const;
+
+    uint32_t nodeID = 0;
+
+    // frame of the most recent release received, clients that can't tell which frame the master is waiting on can wait for releasedFrame + 1
+    uint64_t releasedFrame = 0;
+
+    uint64_t frames = 0;
+    uint64_t timeouts = 0;
+    double totalWait = 0.0;
+    double maxWait = 0.0;
+
+protected:
+    vsg::ref_ptr<Broadcaster> readyBroadcaster;
+    vsg::ref_ptr<Receiver> releaseReceiver;
+};
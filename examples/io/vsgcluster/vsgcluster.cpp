@@ -5,10 +5,14 @@
 #endif
 
 #include <iostream>
+#include <random>
 
 #include "Broadcaster.h"
 #include "Receiver.h"
 #include "Packet.h"
+#include "PacketRing.h"
+#include "Replication.h"
+#include "SwapBarrier.h"
 
 namespace cluster
 {
@@ -91,6 +95,17 @@ int main(int argc, char** argv)
     auto portNumber = arguments.value<uint16_t>(9000, "--port");
     auto ifrName = arguments.value(std::string(), "--ifr-name");
     auto hostName = arguments.value(std::string(), "--host");
+    bool useRing = arguments.read("--ring");
+    auto ringSlots = arguments.value<uint32_t>(3, "--ring-slots");
+    auto ringPackets = arguments.value<uint32_t>(64, "--ring-packets");
+    bool useDelta = arguments.read("--delta");
+    auto keyframeInterval = arguments.value<uint32_t>(60, "--keyframe-interval");
+    auto parityGroupSize = arguments.value<uint32_t>(0, "--parity");
+    bool useRetransmit = arguments.read("--retransmit");
+    bool useBarrier = arguments.read("--barrier");
+    auto barrierTimeout = arguments.value(0.1, "--barrier-timeout");
+    auto barrierMaxMissed = arguments.value<uint32_t>(10, "--barrier-max-missed");
+    auto nodeID = arguments.value<uint32_t>(static_cast<uint32_t>(std::random_device{}()), "--node-id");
 
     ViewerMode viewerMode = STAND_ALONE;
     if (arguments.read({"-s", "--serve"})) viewerMode = SERVER;
@@ -214,10 +229,70 @@ int main(int argc, char** argv)
 
     PacketBroadcaster broadcaster;
     broadcaster.broadcaster = bc;
+    broadcaster.parityGroupSize = parityGroupSize;
 
     PacketReceiver receiver;
     receiver.receiver = rc;
 
+    // optional NACK channel on portNumber + 1, from clients back to the server, for retransmitting lost packets
+    if (useRetransmit)
+    {
+        uint16_t nackPortNumber = portNumber + 1;
+        if (bc)
+        {
+            broadcaster.startRetransmitService(Receiver::create(nackPortNumber));
+        }
+        if (rc)
+        {
+            if (hostName.empty())
+                receiver.nackBroadcaster = Broadcaster::create(nackPortNumber, ifrName);
+            else
+                receiver.nackBroadcaster = Broadcaster::create(hostName, nackPortNumber, ifrName);
+        }
+    }
+
+    // optionally receive on a dedicated network thread into a preallocated packet ring
+    std::unique_ptr<PacketRing> packetRing;
+    if (rc && useRing)
+    {
+        packetRing.reset(new PacketRing(rc, ringSlots, ringPackets));
+        packetRing->start();
+    }
+
+    // optional swap barrier, clients report ready on portNumber + 2 and the server releases them on portNumber + 3
+    std::unique_ptr<SwapBarrierMaster> barrierMaster;
+    std::unique_ptr<SwapBarrierClient> barrierClient;
+    if (useBarrier)
+    {
+        uint16_t readyPortNumber = portNumber + 2;
+        uint16_t releasePortNumber = portNumber + 3;
+        if (bc)
+        {
+            barrierMaster.reset(new SwapBarrierMaster(Receiver::create(readyPortNumber), Broadcaster::create(releasePortNumber, ifrName)));
+            barrierMaster->timeout = barrierTimeout;
+            barrierMaster->maxMissedFrames = barrierMaxMissed;
+        }
+        if (rc)
+        {
+            auto readyBroadcaster = hostName.empty() ? Broadcaster::create(readyPortNumber, ifrName) : Broadcaster::create(hostName, readyPortNumber, ifrName);
+            barrierClient.reset(new SwapBarrierClient(nodeID, readyBroadcaster, Receiver::create(releasePortNumber)));
+            barrierClient->timeout = barrierTimeout;
+        }
+    }
+
+    // frame number of the most recent state received from the server, used to identify the frame at the swap barrier
+    uint64_t serverFrame = 0;
+
+    // optionally replicate just the changed camera and MatrixTransform state, with periodic keyframes, rather than the full ViewerData each frame
+    cluster::ReplicationMaster master;
+    master.keyframeInterval = keyframeInterval;
+    master.track(lookAt);
+    master.trackSubgraph(scene);
+
+    cluster::ReplicationMirror mirror;
+    mirror.bind(0, lookAt);
+    mirror.bindSubgraph(scene);
+
     auto viewerData = cluster::ViewerData::create();
     viewerData->frameStamp = viewer->getFrameStamp();
     viewerData->lookAt = lookAt;
@@ -227,30 +302,36 @@ int main(int argc, char** argv)
     {
         if (bc)
         {
-            viewerData->frameStamp = viewer->getFrameStamp();
-            viewerData->lookAt = lookAt;
+            if (useDelta)
+            {
+                broadcaster.broadcast(viewer->getFrameStamp()->frameCount, master.update(viewer->getFrameStamp()->frameCount));
+            }
+            else
+            {
+                viewerData->frameStamp = viewer->getFrameStamp();
+                viewerData->lookAt = lookAt;
 
-            broadcaster.broadcast(viewer->getFrameStamp()->frameCount, viewerData);
+                broadcaster.broadcast(viewer->getFrameStamp()->frameCount, viewerData);
+            }
         }
 
         if (rc)
         {
-            //unsigned int size = rc->receive(buffer.data(), buffer_size);
-            //std::cout << "received size = " << size << std::endl;
-            auto object = receiver.receive();
-            viewerData = object.cast<cluster::ViewerData>();
-            if (viewerData)
+            // the PacketRing read is non blocking, keep the previous camera if no new frame has arrived
+            auto object = packetRing ? packetRing->read() : receiver.receive();
+            if (auto update = object.cast<cluster::ReplicationUpdate>())
+            {
+                if (mirror.apply(*update)) serverFrame = update->set;
+            }
+            else if (auto receivedViewerData = object.cast<cluster::ViewerData>())
             {
-                std::cout<<"received viewerData "<<viewerData->alive<<std::endl;
+                viewerData = receivedViewerData;
+                serverFrame = viewerData->frameStamp->frameCount;
 
                 lookAt->eye = viewerData->lookAt->eye;
                 lookAt->center = viewerData->lookAt->center;
                 lookAt->up = viewerData->lookAt->up;
             }
-            else
-            {
-                std::cout<<"received "<<object<<std::endl;
-            }
         }
 
         // pass any events into EventHandlers assigned to the Viewer
@@ -260,9 +341,27 @@ int main(int argc, char** argv)
 
         viewer->recordAndSubmit();
 
+        // hold present() until all the nodes are ready
+        if (barrierMaster) barrierMaster->wait(viewer->getFrameStamp()->frameCount);
+        if (barrierClient)
+        {
+            // the master waits on its own frame number, which serverFrame matches when receive() blocks for each frame's state,
+            // but the PacketRing may still hold an earlier state so follow the master's releases instead
+            barrierClient->wait(packetRing ? barrierClient->releasedFrame + 1 : serverFrame);
+        }
+
         viewer->present();
     }
 
+    if (barrierMaster) barrierMaster->report(std::cout);
+    if (barrierClient) barrierClient->report(std::cout);
+
+    if (packetRing)
+    {
+        packetRing->stop();
+        std::cout << "PacketRing completedSets = " << packetRing->completedSets << ", droppedPackets = " << packetRing->droppedPackets << std::endl;
+    }
+
     if (bc)
     {
         viewerData->alive = false;
@@ -0,0 +1,626 @@
+#include "ChunkedBinary.h"
+#include "ParallelTraversal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <numeric>
+#include <set>
+#include <sstream>
+
+#ifdef lz4_FOUND
+#    include <lz4.h>
+#    include <lz4hc.h>
+#endif
+
+#ifdef zstd_FOUND
+#    include <zstd.h>
+#endif
+
+static const char s_magic[5] = {'#', 'v', 's', 'g', 'c'};
+static constexpr uint32_t s_version = 1;
+static constexpr uint32_t s_noSplit = ~0u;
+
+namespace
+{
+    // collect the objects in a subtree that are referenced more than once, and so may be shared with other subtrees
+    class CollectSharedObjects : public vsg::Inherit<vsg::ConstVisitor, CollectSharedObjects>
+    {
+    public:
+        std::set<const vsg::Object*> shared;
+        size_t numObjects = 0;
+
+        void apply(const vsg::Object& object) override
+        {
+            ++numObjects;
+
+            // objects referenced once can only be reached once, so only shared objects need checking for revisits
+            if (object.referenceCount() > 1 && !shared.insert(&object).second) return;
+            object.traverse(*this);
+        }
+    };
+
+    // returns false if the block wasn't compressed, either because the codec isn't available or it didn't reduce the size
+    bool compressBlock(ChunkCodec codec, int level, const uint8_t* source, size_t size, std::vector<uint8_t>& destination)
+    {
+#ifdef lz4_FOUND
+        if (codec == ChunkCodec::LZ4)
+        {
+            destination.resize(static_cast<size_t>(LZ4_compressBound(static_cast<int>(size))));
+            int result = 0;
+            if (level > 0)
+                result = LZ4_compress_HC(reinterpret_cast<const char*>(source), reinterpret_cast<char*>(destination.data()), static_cast<int>(size), static_cast<int>(destination.size()), level);
+            else
+                result = LZ4_compress_default(reinterpret_cast<const char*>(source), reinterpret_cast<char*>(destination.data()), static_cast<int>(size), static_cast<int>(destination.size()));
+
+            if (result <= 0 || static_cast<size_t>(result) >= size) return false;
+            destination.resize(static_cast<size_t>(result));
+            return true;
+        }
+#endif
+
+#ifdef zstd_FOUND
+        if (codec == ChunkCodec::ZSTD)
+        {
+            destination.resize(ZSTD_compressBound(size));
+
+            // level 0 selects zstd's default level
+            size_t result = ZSTD_compress(destination.data(), destination.size(), source, size, level);
+            if (ZSTD_isError(result) || result >= size) return false;
+            destination.resize(result);
+            return true;
+        }
+#endif
+
+        (void)codec;
+        (void)level;
+        (void)source;
+        (void)size;
+        (void)destination;
+        return false;
+    }
+
+    template<typename T>
+    void writeValue(std::ostream& out, T value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // bounds checked reads from the chunk table
+    struct TableReader
+    {
+        const uint8_t* ptr;
+        const uint8_t* end;
+
+        template<typename T>
+        bool read(T& value)
+        {
+            if (static_cast<size_t>(end - ptr) < sizeof(T)) return false;
+            std::memcpy(&value, ptr, sizeof(T));
+            ptr += sizeof(T);
+            return true;
+        }
+    };
+} // namespace
+
+bool codecSupported(ChunkCodec codec)
+{
+    switch (codec)
+    {
+    case ChunkCodec::NONE: return true;
+#ifdef lz4_FOUND
+    case ChunkCodec::LZ4: return true;
+#endif
+#ifdef zstd_FOUND
+    case ChunkCodec::ZSTD: return true;
+#endif
+    default: return false;
+    }
+}
+
+bool codecFromString(const std::string& name, ChunkCodec& codec)
+{
+    if (name == "none") codec = ChunkCodec::NONE;
+    else if (name == "lz4") codec = ChunkCodec::LZ4;
+    else if (name == "zstd") codec = ChunkCodec::ZSTD;
+    else return false;
+    return true;
+}
+
+ChunkedWriter::ChunkedWriter(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads) :
+    operationThreads(in_operationThreads)
+{
+}
+
+bool ChunkedWriter::write(vsg::Object* object, const vsg::Path& filename)
+{
+    stats = {};
+    if (!object) return false;
+
+    if (!codecSupported(codec))
+    {
+        vsg::warn("ChunkedWriter::write() codec ", static_cast<uint32_t>(codec), " not supported by this build, writing uncompressed.");
+        codec = ChunkCodec::NONE;
+    }
+
+    // descend through groups with a single child to find the group to split
+    auto splitGroup = object->cast<vsg::Group>();
+    uint32_t splitDepth = 0;
+    while (splitGroup && splitGroup->children.size() == 1 && splitDepth < maxSplitDepth)
+    {
+        auto& child = splitGroup->children.front();
+        splitGroup = child ? child->cast<vsg::Group>() : nullptr;
+        ++splitDepth;
+    }
+    if (!splitGroup || splitGroup->children.size() < 2)
+    {
+        splitGroup = nullptr;
+        splitDepth = s_noSplit;
+    }
+
+    vsg::Group::Children children;
+    std::vector<std::vector<uint32_t>> chunkChildren(1); // chunk 0 is the skeleton
+    if (splitGroup)
+    {
+        children.swap(splitGroup->children);
+
+        // find which children share objects with each other and with the skeleton, the last collector is the skeleton's
+        size_t skeletonIndex = children.size();
+        std::vector<vsg::ref_ptr<CollectSharedObjects>> collectors(children.size() + 1);
+        std::vector<std::function<void()>> tasks;
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            collectors[i] = CollectSharedObjects::create();
+            if (children[i]) tasks.push_back([&child = children[i], &collector = collectors[i]]() { child->accept(*collector); });
+        }
+        collectors[skeletonIndex] = CollectSharedObjects::create();
+        tasks.push_back([&]() { object->accept(*collectors[skeletonIndex]); });
+        experimental::runTasks(operationThreads, tasks);
+
+        std::vector<size_t> parents(collectors.size());
+        std::iota(parents.begin(), parents.end(), 0);
+        auto find = [&parents](size_t i) {
+            while (parents[i] != i) i = parents[i] = parents[parents[i]];
+            return i;
+        };
+
+        std::map<const vsg::Object*, size_t> owners;
+        for (size_t i = 0; i < collectors.size(); ++i)
+        {
+            for (auto shared : collectors[i]->shared)
+            {
+                auto [itr, inserted] = owners.emplace(shared, i);
+                if (!inserted)
+                {
+                    auto a = find(i), b = find(itr->second);
+                    if (a != b) parents[std::max(a, b)] = std::min(a, b);
+                }
+            }
+        }
+
+        // children sharing objects with the skeleton go in chunk 0 with it, the other sets of children sharing objects are
+        // packed into chunks of roughly equal numbers of objects
+        auto skeletonRoot = find(skeletonIndex);
+        std::map<size_t, std::vector<uint32_t>> sets;
+        std::map<size_t, size_t> setSizes;
+        size_t totalSize = 0;
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            auto root = find(i);
+            if (root == skeletonRoot)
+            {
+                chunkChildren[0].push_back(static_cast<uint32_t>(i));
+                continue;
+            }
+
+            sets[root].push_back(static_cast<uint32_t>(i));
+            setSizes[root] += collectors[i]->numObjects;
+            totalSize += collectors[i]->numObjects;
+        }
+
+        size_t numThreads = operationThreads ? std::max(operationThreads->threads.size(), size_t(1)) : size_t(1);
+        size_t targetSize = totalSize / std::max(numThreads * chunksPerThread, size_t(1));
+
+        size_t currentSize = 0;
+        for (auto& [root, indices] : sets)
+        {
+            if (chunkChildren.size() == 1 || currentSize >= targetSize)
+            {
+                chunkChildren.emplace_back();
+                currentSize = 0;
+            }
+            chunkChildren.back().insert(chunkChildren.back().end(), indices.begin(), indices.end());
+            currentSize += setSizes[root];
+        }
+
+        for (auto index : chunkChildren[0]) splitGroup->children.push_back(children[index]);
+    }
+
+    auto writeOptions = options ? vsg::Options::create(*options) : vsg::Options::create();
+    writeOptions->extensionHint = ".vsgb";
+
+    // serialize the skeleton and the chunks in parallel, the skeleton keeps only the children that share objects with it
+    // attached so no object is reachable from more than one task
+    std::vector<std::string> serialized(chunkChildren.size());
+    {
+        std::vector<std::function<void()>> tasks;
+        for (size_t c = 0; c < chunkChildren.size(); ++c)
+        {
+            tasks.push_back([&, c]() {
+                vsg::ref_ptr<vsg::Object> chunkObject(object);
+                if (c > 0)
+                {
+                    auto group = vsg::Group::create();
+                    for (auto index : chunkChildren[c]) group->addChild(children[index]);
+                    chunkObject = group;
+                }
+
+                std::ostringstream out(std::ios::out | std::ios::binary);
+                vsg::VSG io;
+                io.write(chunkObject, out, writeOptions);
+                serialized[c] = out.str();
+            });
+        }
+        experimental::runTasks(operationThreads, tasks);
+    }
+
+    if (splitGroup)
+    {
+        splitGroup->children.clear();
+        splitGroup->children.swap(children);
+    }
+
+    // compress the blocks of every chunk
+    struct BlockOutput
+    {
+        size_t chunk = 0;
+        size_t offset = 0;
+        size_t size = 0;
+        ChunkCodec codec = ChunkCodec::NONE;
+        std::vector<uint8_t> compressed;
+    };
+
+    size_t size = std::max(blockSize, size_t(1));
+    std::vector<BlockOutput> blocks;
+    for (size_t c = 0; c < serialized.size(); ++c)
+    {
+        size_t chunkSize = serialized[c].size();
+        size_t offset = 0;
+        do
+        {
+            BlockOutput block;
+            block.chunk = c;
+            block.offset = offset;
+            block.size = std::min(size, chunkSize - offset);
+            offset += block.size;
+            blocks.push_back(std::move(block));
+        } while (offset < chunkSize);
+    }
+
+    if (codec != ChunkCodec::NONE)
+    {
+        std::vector<std::function<void()>> tasks;
+        for (auto& block : blocks)
+        {
+            tasks.push_back([&, &block = block]() {
+                auto source = reinterpret_cast<const uint8_t*>(serialized[block.chunk].data()) + block.offset;
+                if (compressBlock(codec, level, source, block.size, block.compressed)) block.codec = codec;
+                else block.compressed.clear();
+            });
+        }
+        experimental::runTasks(operationThreads, tasks);
+    }
+
+    std::ofstream fout(filename, std::ios::out | std::ios::binary);
+    if (!fout)
+    {
+        vsg::warn("ChunkedWriter::write() could not open ", filename);
+        return false;
+    }
+
+    fout.write(s_magic, sizeof(s_magic));
+    writeValue(fout, s_version);
+
+    std::vector<uint64_t> blockOffsets;
+    uint64_t position = sizeof(s_magic) + sizeof(s_version);
+    for (auto& block : blocks)
+    {
+        blockOffsets.push_back(position);
+        if (block.codec == ChunkCodec::NONE)
+        {
+            fout.write(serialized[block.chunk].data() + block.offset, static_cast<std::streamsize>(block.size));
+            position += block.size;
+        }
+        else
+        {
+            fout.write(reinterpret_cast<const char*>(block.compressed.data()), static_cast<std::streamsize>(block.compressed.size()));
+            position += block.compressed.size();
+        }
+    }
+
+    std::ostringstream table(std::ios::out | std::ios::binary);
+    writeValue(table, splitDepth);
+    writeValue(table, static_cast<uint32_t>(splitGroup ? splitGroup->children.size() : 0));
+    writeValue(table, static_cast<uint32_t>(chunkChildren.size()));
+
+    size_t b = 0;
+    for (size_t c = 0; c < chunkChildren.size(); ++c)
+    {
+        size_t firstBlock = b;
+        while (b < blocks.size() && blocks[b].chunk == c) ++b;
+
+        writeValue(table, static_cast<uint32_t>(chunkChildren[c].size()));
+        for (auto index : chunkChildren[c]) writeValue(table, index);
+
+        writeValue(table, static_cast<uint32_t>(b - firstBlock));
+        for (size_t i = firstBlock; i < b; ++i)
+        {
+            auto& block = blocks[i];
+            uint64_t compressedSize = block.codec == ChunkCodec::NONE ? block.size : block.compressed.size();
+            writeValue(table, static_cast<uint32_t>(block.codec));
+            writeValue(table, blockOffsets[i]);
+            writeValue(table, compressedSize);
+            writeValue(table, static_cast<uint64_t>(block.size));
+
+            ++stats.numBlocks;
+            stats.uncompressedSize += block.size;
+            stats.compressedSize += compressedSize;
+        }
+    }
+    stats.numChunks = chunkChildren.size();
+
+    auto tableData = table.str();
+    fout.write(tableData.data(), static_cast<std::streamsize>(tableData.size()));
+    writeValue(fout, position);
+    writeValue(fout, static_cast<uint64_t>(tableData.size()));
+
+    return static_cast<bool>(fout);
+}
+
+ChunkedReader::ChunkedReader(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads) :
+    operationThreads(in_operationThreads)
+{
+}
+
+bool ChunkedReader::open(const vsg::Path& filename)
+{
+    stats = {};
+    _chunks.clear();
+
+    _mappedFile = MappedFile::create(filename);
+    if (!_mappedFile->valid()) return false;
+
+    auto data = _mappedFile->data;
+    auto fileSize = _mappedFile->size;
+
+    constexpr size_t headerSize = sizeof(s_magic) + sizeof(uint32_t);
+    constexpr size_t trailerSize = 2 * sizeof(uint64_t);
+    uint32_t version = 0;
+    if (fileSize < headerSize + trailerSize || std::memcmp(data, s_magic, sizeof(s_magic)) != 0)
+    {
+        vsg::warn("ChunkedReader::open() ", filename, " is not a chunked native binary file.");
+        return false;
+    }
+
+    std::memcpy(&version, data + sizeof(s_magic), sizeof(version));
+    if (version != s_version)
+    {
+        vsg::warn("ChunkedReader::open() ", filename, " has unsupported version ", version);
+        return false;
+    }
+
+    uint64_t tableOffset = 0, tableSize = 0;
+    std::memcpy(&tableOffset, data + fileSize - trailerSize, sizeof(uint64_t));
+    std::memcpy(&tableSize, data + fileSize - sizeof(uint64_t), sizeof(uint64_t));
+    if (tableOffset < headerSize || tableSize > fileSize - trailerSize || tableOffset > fileSize - trailerSize - tableSize)
+    {
+        vsg::warn("ChunkedReader::open() ", filename, " has a corrupt chunk table.");
+        return false;
+    }
+
+    TableReader table{data + tableOffset, data + tableOffset + tableSize};
+    uint32_t numChunks = 0;
+    bool valid = table.read(_splitDepth) && table.read(_numChildren) && table.read(numChunks) && numChunks > 0;
+
+    for (uint32_t c = 0; valid && c < numChunks; ++c)
+    {
+        Chunk chunk;
+        uint32_t numIndices = 0, numBlocks = 0;
+        valid = table.read(numIndices) && numIndices <= _numChildren;
+        for (uint32_t i = 0; valid && i < numIndices; ++i)
+        {
+            uint32_t index = 0;
+            valid = table.read(index) && index < _numChildren;
+            chunk.childIndices.push_back(index);
+        }
+
+        valid = valid && table.read(numBlocks);
+        for (uint32_t b = 0; valid && b < numBlocks; ++b)
+        {
+            Block block;
+            uint32_t codec = 0;
+            valid = table.read(codec) && table.read(block.offset) && table.read(block.compressedSize) && table.read(block.size) &&
+                    block.offset <= tableOffset && block.compressedSize <= tableOffset - block.offset;
+            block.codec = static_cast<ChunkCodec>(codec);
+            chunk.blocks.push_back(block);
+
+            stats.uncompressedSize += static_cast<size_t>(block.size);
+            stats.compressedSize += static_cast<size_t>(block.compressedSize);
+        }
+
+        stats.numBlocks += chunk.blocks.size();
+        _chunks.push_back(std::move(chunk));
+    }
+
+    if (!valid)
+    {
+        vsg::warn("ChunkedReader::open() ", filename, " has a corrupt chunk table.");
+        _chunks.clear();
+        stats = {};
+        return false;
+    }
+
+    stats.numChunks = _chunks.size();
+    return true;
+}
+
+bool ChunkedReader::_decompress(const Block& block, uint8_t* destination) const
+{
+    auto source = _mappedFile->data + block.offset;
+    switch (block.codec)
+    {
+    case ChunkCodec::NONE:
+        if (block.compressedSize != block.size) return false;
+        std::memcpy(destination, source, static_cast<size_t>(block.size));
+        return true;
+#ifdef lz4_FOUND
+    case ChunkCodec::LZ4:
+        return LZ4_decompress_safe(reinterpret_cast<const char*>(source), reinterpret_cast<char*>(destination), static_cast<int>(block.compressedSize), static_cast<int>(block.size)) == static_cast<int>(block.size);
+#endif
+#ifdef zstd_FOUND
+    case ChunkCodec::ZSTD:
+        return ZSTD_decompress(destination, static_cast<size_t>(block.size), source, static_cast<size_t>(block.compressedSize)) == block.size;
+#endif
+    default:
+        vsg::warn("ChunkedReader : codec ", static_cast<uint32_t>(block.codec), " not supported by this build.");
+        return false;
+    }
+}
+
+vsg::ref_ptr<vsg::Object> ChunkedReader::readChunk(size_t index) const
+{
+    if (index >= _chunks.size()) return {};
+
+    auto& chunk = _chunks[index];
+    vsg::VSG io;
+
+    // a single uncompressed block is parsed straight from the mapping
+    if (chunk.blocks.size() == 1 && chunk.blocks.front().codec == ChunkCodec::NONE)
+    {
+        auto& block = chunk.blocks.front();
+        return io.read(_mappedFile->data + block.offset, static_cast<size_t>(block.size), options);
+    }
+
+    size_t size = 0;
+    for (auto& block : chunk.blocks) size += static_cast<size_t>(block.size);
+
+    std::vector<uint8_t> buffer(size);
+    size_t offset = 0;
+    for (auto& block : chunk.blocks)
+    {
+        if (!_decompress(block, buffer.data() + offset)) return {};
+        offset += static_cast<size_t>(block.size);
+    }
+
+    return io.read(buffer.data(), buffer.size(), options);
+}
+
+vsg::ref_ptr<vsg::Object> ChunkedReader::read()
+{
+    if (_chunks.empty()) return {};
+
+    // decompress every block in parallel, chunks with a single uncompressed block are parsed from the mapping
+    std::vector<std::vector<uint8_t>> buffers(_chunks.size());
+    std::vector<char> blockFailed;
+    {
+        std::vector<std::function<void()>> tasks;
+        std::vector<std::pair<const Block*, uint8_t*>> work;
+        for (size_t c = 0; c < _chunks.size(); ++c)
+        {
+            auto& chunk = _chunks[c];
+            if (chunk.blocks.size() == 1 && chunk.blocks.front().codec == ChunkCodec::NONE) continue;
+
+            size_t size = 0;
+            for (auto& block : chunk.blocks) size += static_cast<size_t>(block.size);
+            buffers[c].resize(size);
+
+            size_t offset = 0;
+            for (auto& block : chunk.blocks)
+            {
+                work.emplace_back(&block, buffers[c].data() + offset);
+                offset += static_cast<size_t>(block.size);
+            }
+        }
+
+        blockFailed.resize(work.size(), 0);
+        for (size_t w = 0; w < work.size(); ++w)
+        {
+            tasks.push_back([this, &work, &blockFailed, w]() { blockFailed[w] = _decompress(*work[w].first, work[w].second) ? 0 : 1; });
+        }
+        experimental::runTasks(operationThreads, tasks);
+    }
+
+    if (std::find(blockFailed.begin(), blockFailed.end(), 1) != blockFailed.end())
+    {
+        vsg::warn("ChunkedReader::read() failed to decompress chunk data.");
+        return {};
+    }
+
+    // parse the chunks in parallel
+    std::vector<vsg::ref_ptr<vsg::Object>> objects(_chunks.size());
+    {
+        std::vector<std::function<void()>> tasks;
+        for (size_t c = 0; c < _chunks.size(); ++c)
+        {
+            tasks.push_back([this, &buffers, &objects, c]() {
+                vsg::VSG io;
+                if (buffers[c].empty())
+                {
+                    auto& block = _chunks[c].blocks.front();
+                    objects[c] = io.read(_mappedFile->data + block.offset, static_cast<size_t>(block.size), options);
+                }
+                else
+                {
+                    objects[c] = io.read(buffers[c].data(), buffers[c].size(), options);
+                }
+            });
+        }
+        experimental::runTasks(operationThreads, tasks);
+    }
+
+    auto skeleton = objects[0];
+    if (!skeleton || _splitDepth == s_noSplit) return skeleton;
+
+    // reattach the children in their original order
+    auto splitGroup = skeleton->cast<vsg::Group>();
+    for (uint32_t depth = 0; splitGroup && depth < _splitDepth; ++depth)
+    {
+        auto child = splitGroup->children.empty() ? nullptr : splitGroup->children.front().get();
+        splitGroup = child ? child->cast<vsg::Group>() : nullptr;
+    }
+
+    if (!splitGroup)
+    {
+        vsg::warn("ChunkedReader::read() skeleton doesn't match the chunk table.");
+        return {};
+    }
+
+    // the skeleton holds the children that share objects with it, the other chunks hold the rest
+    vsg::Group::Children skeletonChildren;
+    skeletonChildren.swap(splitGroup->children);
+    if (skeletonChildren.size() != _chunks[0].childIndices.size())
+    {
+        vsg::warn("ChunkedReader::read() skeleton doesn't match the chunk table.");
+        return {};
+    }
+
+    splitGroup->children.resize(_numChildren);
+    for (size_t i = 0; i < skeletonChildren.size(); ++i) splitGroup->children[_chunks[0].childIndices[i]] = skeletonChildren[i];
+
+    for (size_t c = 1; c < _chunks.size(); ++c)
+    {
+        auto chunkGroup = objects[c].cast<vsg::Group>();
+        auto& childIndices = _chunks[c].childIndices;
+        if (!chunkGroup || chunkGroup->children.size() != childIndices.size())
+        {
+            vsg::warn("ChunkedReader::read() failed to read chunk ", c);
+            return {};
+        }
+
+        for (size_t i = 0; i < childIndices.size(); ++i) splitGroup->children[childIndices[i]] = chunkGroup->children[i];
+    }
+
+    return skeleton;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "MappedBinaryInput.h"
+
+// Chunked container for the native binary format, written as .vsgc:
+//     "#vsgc" uint32 version
+//     compressed blocks
+//     chunk table
+//     uint64 tableOffset, uint64 tableSize
+// Chunk 0 is the skeleton, the object with the children of its first Group that has more than one child removed, other
+// than those that share objects with the rest of the skeleton. The remaining chunks each hold a set of those children
+// serialized as .vsgb, children that share objects are kept in the same chunk so each chunk can be read independently.
+// Every chunk is split into blocks of at most blockSize bytes that are compressed independently, so a single large
+// subtree or data block still compresses and decompresses in parallel.
+enum class ChunkCodec : uint32_t
+{
+    NONE = 0,
+    LZ4 = 1,
+    ZSTD = 2
+};
+
+// codecs are only available if their library was found at build time
+extern bool codecSupported(ChunkCodec codec);
+extern bool codecFromString(const std::string& name, ChunkCodec& codec);
+
+struct ChunkedStats
+{
+    size_t numChunks = 0;
+    size_t numBlocks = 0;
+    size_t uncompressedSize = 0;
+    size_t compressedSize = 0;
+};
+
+class ChunkedWriter : public vsg::Inherit<vsg::Object, ChunkedWriter>
+{
+public:
+    explicit ChunkedWriter(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads = {});
+
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+    vsg::ref_ptr<const vsg::Options> options;
+
+    ChunkCodec codec = ChunkCodec::NONE;
+    int level = 3;
+    size_t blockSize = 4 * 1024 * 1024;
+
+    // number of chunks per thread to aim for, more chunks balance uneven subtrees better
+    size_t chunksPerThread = 4;
+
+    // number of single child groups to descend looking for a group to split
+    uint32_t maxSplitDepth = 8;
+
+    // the children of the split group are detached while the skeleton is serialized and restored afterwards
+    bool write(vsg::Object* object, const vsg::Path& filename);
+
+    ChunkedStats stats;
+};
+
+class ChunkedReader : public vsg::Inherit<vsg::Object, ChunkedReader>
+{
+public:
+    explicit ChunkedReader(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads = {});
+
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+    vsg::ref_ptr<const vsg::Options> options;
+
+    // map the file and read its chunk table
+    bool open(const vsg::Path& filename);
+
+    size_t numChunks() const { return _chunks.size(); }
+
+    // read a single chunk, chunk 0 is the skeleton with the children it shares objects with and the others a vsg::Group
+    // holding the children they contain
+    vsg::ref_ptr<vsg::Object> readChunk(size_t index) const;
+
+    // read all the chunks in parallel and reassemble the original object
+    vsg::ref_ptr<vsg::Object> read();
+
+    ChunkedStats stats;
+
+protected:
+    struct Block
+    {
+        ChunkCodec codec = ChunkCodec::NONE;
+        uint64_t offset = 0;
+        uint64_t compressedSize = 0;
+        uint64_t size = 0;
+    };
+
+    struct Chunk
+    {
+        std::vector<uint32_t> childIndices;
+        std::vector<Block> blocks;
+    };
+
+    bool _decompress(const Block& block, uint8_t* destination) const;
+
+    vsg::ref_ptr<MappedFile> _mappedFile;
+    uint32_t _splitDepth = 0;
+    uint32_t _numChildren = 0;
+    std::vector<Chunk> _chunks;
+};
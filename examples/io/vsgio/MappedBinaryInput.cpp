@@ -0,0 +1,258 @@
+#include "MappedBinaryInput.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#if defined(_WIN32)
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+// the reader whose payloads MappedDataAllocator may alias, set by readMapped() for the duration of the read
+static thread_local MappedBinaryInput* s_activeInput = nullptr;
+
+MappedFile::MappedFile(const vsg::Path& filename)
+{
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+    {
+        // PAGE_WRITECOPY and FILE_MAP_COPY give a private copy-on-write view
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if (mapping)
+        {
+            data = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+            if (data) size = static_cast<size_t>(fileSize.QuadPart);
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(filename.string().c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+    {
+        // MAP_PRIVATE with write access gives copy-on-write pages
+        void* ptr = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED)
+        {
+            data = static_cast<uint8_t*>(ptr);
+            size = static_cast<size_t>(fileStat.st_size);
+        }
+    }
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    if (!data) return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+MappedStreamBuf::MappedStreamBuf(uint8_t* begin, uint8_t* end)
+{
+    setg(reinterpret_cast<char*>(begin), reinterpret_cast<char*>(begin), reinterpret_cast<char*>(end));
+}
+
+MappedStreamBuf::pos_type MappedStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if (dir == std::ios_base::cur)
+        return seekpos(pos_type(static_cast<off_type>(position()) + off), which);
+    else if (dir == std::ios_base::end)
+        return seekpos(pos_type(static_cast<off_type>(egptr() - eback()) + off), which);
+    else
+        return seekpos(pos_type(off), which);
+}
+
+MappedStreamBuf::pos_type MappedStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    off_type offset = static_cast<off_type>(pos);
+    if ((which & std::ios_base::in) == 0 || offset < 0 || offset > static_cast<off_type>(egptr() - eback())) return pos_type(off_type(-1));
+
+    setg(eback(), eback() + offset, egptr());
+    return pos;
+}
+
+std::streamsize MappedStreamBuf::xsgetn(char* s, std::streamsize count)
+{
+    auto num = std::min(count, static_cast<std::streamsize>(remaining()));
+
+    // the destination may be an earlier alias of the mapping, so the ranges can overlap
+    std::memmove(s, gptr(), static_cast<size_t>(num));
+    skip(static_cast<size_t>(num));
+    return num;
+}
+
+MappedBinaryInput::MappedBinaryInput(std::istream& in_input, vsg::ref_ptr<MappedFile> in_mappedFile, MappedStreamBuf& in_streamBuf, vsg::ref_ptr<vsg::ObjectFactory> in_objectFactory, vsg::ref_ptr<const vsg::Options> in_options) :
+    vsg::BinaryInput(in_input, in_objectFactory, in_options),
+    mappedFile(in_mappedFile),
+    _streamBuf(in_streamBuf)
+{
+}
+
+void* MappedBinaryInput::alias(size_t size)
+{
+    _aliased = nullptr;
+    if (size < minAliasSize || size > _streamBuf.remaining()) return nullptr;
+
+    // the largest power of two dividing the size bounds the alignment its element type requires
+    size_t alignment = 1;
+    while (alignment < 16 && (size % (alignment * 2)) == 0) alignment *= 2;
+
+    uint8_t* ptr = _streamBuf.current();
+    if ((reinterpret_cast<uintptr_t>(ptr) % alignment) != 0) return nullptr;
+
+    _aliased = ptr;
+    ++numAliased;
+    bytesAliased += size;
+    return ptr;
+}
+
+MappedDataAllocator::MappedDataAllocator(std::unique_ptr<Allocator> in_nestedAllocator) :
+    vsg::Allocator(std::move(in_nestedAllocator))
+{
+}
+
+void MappedDataAllocator::registerMapping(vsg::ref_ptr<MappedFile> mappedFile)
+{
+    std::scoped_lock<std::mutex> lock(_mappingsMutex);
+    mappedFile->reading = true;
+    _mappings.push_back(mappedFile);
+}
+
+void MappedDataAllocator::releaseMapping(MappedFile* mappedFile)
+{
+    std::scoped_lock<std::mutex> lock(_mappingsMutex);
+    mappedFile->reading = false;
+
+    // nothing aliases it so unmap now, otherwise when the last aliasing array is deallocated
+    if (mappedFile->numAliases == 0)
+    {
+        _mappings.erase(std::remove(_mappings.begin(), _mappings.end(), vsg::ref_ptr<MappedFile>(mappedFile)), _mappings.end());
+    }
+}
+
+void* MappedDataAllocator::allocate(std::size_t size, vsg::AllocatorAffinity allocatorAffinity)
+{
+    if (allocatorAffinity == vsg::ALLOCATOR_AFFINITY_DATA && s_activeInput)
+    {
+        if (void* ptr = s_activeInput->alias(size))
+        {
+            std::scoped_lock<std::mutex> lock(_mappingsMutex);
+            ++s_activeInput->mappedFile->numAliases;
+            return ptr;
+        }
+    }
+
+    return Allocator::allocate(size, allocatorAffinity);
+}
+
+bool MappedDataAllocator::deallocate(void* ptr, std::size_t size)
+{
+    if (ptr)
+    {
+        std::scoped_lock<std::mutex> lock(_mappingsMutex);
+        for (auto itr = _mappings.begin(); itr != _mappings.end(); ++itr)
+        {
+            auto& mappedFile = *itr;
+            if (!mappedFile->contains(ptr)) continue;
+
+            if (--mappedFile->numAliases == 0 && !mappedFile->reading) _mappings.erase(itr);
+            return true;
+        }
+    }
+
+    return Allocator::deallocate(ptr, size);
+}
+
+void MappedDataAllocator::report(std::ostream& out) const
+{
+    {
+        std::scoped_lock<std::mutex> lock(_mappingsMutex);
+        out << "MappedDataAllocator::report() " << _mappings.size() << " mappings" << std::endl;
+        for (auto& mappedFile : _mappings)
+        {
+            out << "    mapping " << mappedFile->size << " bytes, aliased by " << mappedFile->numAliases << " arrays" << std::endl;
+        }
+    }
+    Allocator::report(out);
+}
+
+vsg::ref_ptr<vsg::Object> readMapped(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options, MappedReadStats* stats)
+{
+    auto mappedFile = MappedFile::create(filename);
+    if (!mappedFile->valid()) return {};
+
+    MappedStreamBuf streamBuf(mappedFile->data, mappedFile->data + mappedFile->size);
+    std::istream fin(&streamBuf);
+    fin.imbue(std::locale::classic());
+
+    // same header as vsg::VSG reads, "#vsgb" followed by the version on the rest of the line
+    char token[5];
+    fin.read(token, 5);
+    if (!fin || std::strncmp(token, "#vsgb", 5) != 0)
+    {
+        vsg::warn("readMapped() ", filename, " is not a native binary file.");
+        return {};
+    }
+
+    std::string versionString;
+    std::getline(fin, versionString);
+
+    uint32_t major = 0, minor = 0, patch = 0;
+    char dot;
+    std::stringstream versionStream(versionString);
+    versionStream >> major >> dot >> minor >> dot >> patch;
+
+    auto allocator = dynamic_cast<MappedDataAllocator*>(vsg::Allocator::instance().get());
+    if (allocator) allocator->registerMapping(mappedFile);
+
+    MappedBinaryInput input(fin, mappedFile, streamBuf, vsg::ObjectFactory::instance(), options);
+    input.version.major = static_cast<decltype(input.version.major)>(major);
+    input.version.minor = static_cast<decltype(input.version.minor)>(minor);
+    input.version.patch = static_cast<decltype(input.version.patch)>(patch);
+
+    vsg::ref_ptr<vsg::Object> object;
+    s_activeInput = allocator ? &input : nullptr;
+    try
+    {
+        object = input.readObject("Root");
+    }
+    catch (...)
+    {
+        s_activeInput = nullptr;
+        if (allocator) allocator->releaseMapping(mappedFile);
+        throw;
+    }
+    s_activeInput = nullptr;
+    if (allocator) allocator->releaseMapping(mappedFile);
+
+    if (stats)
+    {
+        stats->fileSize = mappedFile->size;
+        stats->numAliased = input.numAliased;
+        stats->bytesAliased = input.bytesAliased;
+    }
+
+    return object;
+}
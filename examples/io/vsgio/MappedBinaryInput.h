@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <mutex>
+#include <streambuf>
+
+// Private, copy-on-write memory mapping of a whole file. Pages are only read from disk when first touched and are
+// copied by the kernel if written to, so arrays aliasing the mapping can still be modified in place.
+class MappedFile : public vsg::Inherit<vsg::Object, MappedFile>
+{
+public:
+    explicit MappedFile(const vsg::Path& filename);
+
+    uint8_t* data = nullptr;
+    size_t size = 0;
+
+    bool valid() const { return data != nullptr; }
+    bool contains(const void* ptr) const { return ptr >= data && ptr < data + size; }
+
+    // number of arrays whose storage aliases the mapping, and whether a reader may still create more, guarded by MappedDataAllocator
+    size_t numAliases = 0;
+    bool reading = true;
+
+protected:
+    virtual ~MappedFile();
+};
+
+// std::streambuf reading directly from a memory range, without the copy through an ifstream's buffer.
+class MappedStreamBuf : public std::streambuf
+{
+public:
+    MappedStreamBuf(uint8_t* begin, uint8_t* end);
+
+    size_t position() const { return static_cast<size_t>(gptr() - eback()); }
+    size_t remaining() const { return static_cast<size_t>(egptr() - gptr()); }
+    uint8_t* current() const { return reinterpret_cast<uint8_t*>(gptr()); }
+    void skip(size_t num) { setg(eback(), gptr() + num, egptr()); }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+    std::streamsize xsgetn(char* s, std::streamsize count) override;
+};
+
+// BinaryInput reading a .vsgb file from a MappedFile. While it reads, vsg::Data allocations made by MappedDataAllocator
+// are matched to the array payload about to be read, if the payload's position in the mapping is aligned for its
+// elements the allocation returns that position and the read that follows is skipped, so the array aliases the mapping.
+// Unaligned or small payloads are copied straight from the mapping.
+class MappedBinaryInput : public vsg::BinaryInput
+{
+public:
+    MappedBinaryInput(std::istream& in_input, vsg::ref_ptr<MappedFile> in_mappedFile, MappedStreamBuf& in_streamBuf, vsg::ref_ptr<vsg::ObjectFactory> in_objectFactory, vsg::ref_ptr<const vsg::Options> in_options = {});
+
+    const vsg::ref_ptr<MappedFile> mappedFile;
+
+    // payloads smaller than this are copied, aliasing them saves little and keeps their pages resident
+    size_t minAliasSize = 4096;
+
+    // position of a payload of size bytes at the current read position, or nullptr if it can't be aliased
+    void* alias(size_t size);
+
+    using vsg::BinaryInput::read;
+
+    void read(size_t num, int8_t* value) override { _read(num, value); }
+    void read(size_t num, uint8_t* value) override { _read(num, value); }
+    void read(size_t num, int16_t* value) override { _read(num, value); }
+    void read(size_t num, uint16_t* value) override { _read(num, value); }
+    void read(size_t num, int32_t* value) override { _read(num, value); }
+    void read(size_t num, uint32_t* value) override { _read(num, value); }
+    void read(size_t num, int64_t* value) override { _read(num, value); }
+    void read(size_t num, uint64_t* value) override { _read(num, value); }
+    void read(size_t num, float* value) override { _read(num, value); }
+    void read(size_t num, double* value) override { _read(num, value); }
+
+    // stats accumulated while reading
+    size_t numAliased = 0;
+    size_t bytesAliased = 0;
+
+protected:
+    template<typename T>
+    void _read(size_t num, T* value)
+    {
+        if (_aliased && value == _aliased && _streamBuf.current() == _aliased)
+        {
+            // the allocation already points at this payload
+            _streamBuf.skip(num * sizeof(T));
+            _aliased = nullptr;
+            return;
+        }
+
+        _aliased = nullptr;
+        vsg::BinaryInput::read(num, value);
+    }
+
+    MappedStreamBuf& _streamBuf;
+    void* _aliased = nullptr;
+};
+
+// Allocator handing out aliases of the active MappedBinaryInput's mapping for vsg::Data payloads, and releasing a
+// mapping once the reader and all the arrays aliasing it are done with it. Assign before reading with readMapped().
+class MappedDataAllocator : public vsg::Allocator
+{
+public:
+    MappedDataAllocator(std::unique_ptr<Allocator> in_nestedAllocator = {});
+
+    void registerMapping(vsg::ref_ptr<MappedFile> mappedFile);
+    void releaseMapping(MappedFile* mappedFile);
+
+    void* allocate(std::size_t size, vsg::AllocatorAffinity allocatorAffinity = vsg::ALLOCATOR_AFFINITY_OBJECTS) override;
+    bool deallocate(void* ptr, std::size_t size) override;
+
+    void report(std::ostream& out) const override;
+
+protected:
+    mutable std::mutex _mappingsMutex;
+    std::vector<vsg::ref_ptr<MappedFile>> _mappings;
+};
+
+struct MappedReadStats
+{
+    size_t fileSize = 0;
+    size_t numAliased = 0;
+    size_t bytesAliased = 0;
+};
+
+// read a .vsgb file through a memory mapping, array payloads alias the mapping when a MappedDataAllocator is assigned
+extern vsg::ref_ptr<vsg::Object> readMapped(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}, MappedReadStats* stats = nullptr);
@@ -1,7 +1,12 @@
 #include <vsg/all.h>
 
+#include "ChunkedBinary.h"
+#include "MappedBinaryInput.h"
+
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <thread>
 #include <unordered_map>
 
 vsg::ref_ptr<vsg::Node> createQuadTree(unsigned int numLevels, vsg::Node* sharedLeaf)
@@ -44,6 +49,29 @@ int main(int argc, char** argv)
     auto inputFilename = arguments.value(std::string(), "-i");
     auto outputFilename = arguments.value(std::string(), "-o");
 
+    // read .vsgb files through a copy-on-write memory mapping with array payloads aliasing it
+    auto useMapping = arguments.read("--mmap");
+
+    // settings for reading and writing chunked .vsgc files
+    auto numThreads = arguments.value(std::thread::hardware_concurrency(), "--threads");
+    auto codecName = arguments.value(std::string("zstd"), "--codec");
+    auto level = arguments.value(0, "--level");
+    auto blockSize = arguments.value(4u, "--block-size");
+
+    ChunkCodec codec = ChunkCodec::NONE;
+    if (!codecFromString(codecName, codec))
+    {
+        std::cout << "Unknown codec " << codecName << ", choose from none, lz4 or zstd." << std::endl;
+        return 1;
+    }
+    if (blockSize == 0 || blockSize > 1024)
+    {
+        std::cout << "--block-size must be between 1 and 1024 megabytes." << std::endl;
+        return 1;
+    }
+
+    auto operationThreads = numThreads > 1 ? vsg::OperationThreads::create(numThreads) : vsg::ref_ptr<vsg::OperationThreads>();
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     vsg::ref_ptr<vsg::Object> object;
@@ -87,7 +115,39 @@ int main(int argc, char** argv)
     }
     else
     {
-        if (vsg::fileExists(inputFilename))
+        if (vsg::lowerCaseFileExtension(inputFilename) == ".vsgc")
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            auto reader = ChunkedReader::create(operationThreads);
+            if (reader->open(inputFilename)) object = reader->read();
+            if (!object)
+            {
+                std::cout << "Warning: file not read : " << inputFilename << std::endl;
+                return 1;
+            }
+
+            auto duration = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Chunked read of " << reader->stats.numChunks << " chunks, " << reader->stats.numBlocks << " blocks, " << reader->stats.compressedSize << " -> " << reader->stats.uncompressedSize << " bytes in " << duration << "ms" << std::endl;
+        }
+        else if (useMapping && vsg::lowerCaseFileExtension(inputFilename) == ".vsgb")
+        {
+            vsg::Allocator::instance().reset(new MappedDataAllocator(std::move(vsg::Allocator::instance())));
+
+            auto start = std::chrono::steady_clock::now();
+
+            MappedReadStats stats;
+            object = readMapped(inputFilename, {}, &stats);
+            if (!object)
+            {
+                std::cout << "Warning: file not read : " << inputFilename << std::endl;
+                return 1;
+            }
+
+            auto duration = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Mapped read of " << stats.fileSize << " bytes in " << duration << "ms, " << stats.numAliased << " arrays aliasing " << stats.bytesAliased << " bytes of the mapping" << std::endl;
+        }
+        else if (vsg::fileExists(inputFilename))
         {
             vsg::VSG io;
             object = io.read(inputFilename);
@@ -112,6 +172,23 @@ int main(int argc, char** argv)
             vsg::VSG io;
             io.write(object, std::cout);
         }
+        else if (vsg::lowerCaseFileExtension(outputFilename) == ".vsgc")
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            auto writer = ChunkedWriter::create(operationThreads);
+            writer->codec = codec;
+            writer->level = level;
+            writer->blockSize = size_t(blockSize) * 1024 * 1024;
+            if (!writer->write(object, outputFilename))
+            {
+                std::cout << "Warning: file not written : " << outputFilename << std::endl;
+                return 1;
+            }
+
+            auto duration = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Chunked write of " << writer->stats.numChunks << " chunks, " << writer->stats.numBlocks << " blocks, " << writer->stats.uncompressedSize << " -> " << writer->stats.compressedSize << " bytes in " << duration << "ms" << std::endl;
+        }
         else
         {
             vsg::write(object, outputFilename);
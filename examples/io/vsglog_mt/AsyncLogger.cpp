@@ -0,0 +1,219 @@
+#include "AsyncLogger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+static std::atomic_uint64_t s_nextAsyncLoggerID{0};
+
+AsyncLogger::Ring::Ring(std::thread::id in_id, size_t size, size_t maxMessageLength) :
+    id(in_id),
+    records(size),
+    text(size * maxMessageLength)
+{
+    for (size_t i = 0; i < size; ++i) records[i].text = text.data() + i * maxMessageLength;
+}
+
+AsyncLogger::AsyncLogger(size_t in_ringSize, size_t in_maxMessageLength) :
+    ringSize(std::max(in_ringSize, size_t(2))),
+    maxMessageLength(std::max(in_maxMessageLength, size_t(1))),
+    _id(s_nextAsyncLoggerID++)
+{
+    _thread = std::thread([this]() { run(); });
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop();
+
+    // threads that are still running hold on to their rings, so release the records they no longer need
+    for (auto& ring : _rings)
+    {
+        ring->records = {};
+        ring->text = {};
+    }
+}
+
+void AsyncLogger::stop()
+{
+    _active = false;
+    if (_thread.joinable()) _thread.join();
+
+    // write anything that was queued after the flusher thread exited
+    drain();
+}
+
+void AsyncLogger::setThreadPrefix(std::thread::id id, const std::string& str)
+{
+    std::scoped_lock<std::mutex> lock(_prefixMutex);
+    _threadPrefixes[id] = str;
+}
+
+AsyncLogger::Ring& AsyncLogger::localRing()
+{
+    // keyed by id rather than address so a new AsyncLogger allocated at the address of a deleted one gets fresh rings,
+    // and shared with the AsyncLogger so the rings of a thread that exits can be reclaimed by drain()
+    struct LocalRings
+    {
+        std::unordered_map<uint64_t, std::shared_ptr<Ring>> rings;
+
+        ~LocalRings()
+        {
+            for (auto& [id, ring] : rings) ring->threadExited.store(true, std::memory_order_release);
+        }
+    };
+    thread_local LocalRings s_localRings;
+
+    auto& ring = s_localRings.rings[_id];
+    if (!ring)
+    {
+        ring = std::make_shared<Ring>(std::this_thread::get_id(), ringSize, maxMessageLength);
+
+        std::scoped_lock<std::mutex> lock(_ringsMutex);
+        _rings.push_back(ring);
+    }
+    return *ring;
+}
+
+void AsyncLogger::push(Level msg_level, const std::string_view& message)
+{
+    auto& ring = localRing();
+
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= ringSize)
+    {
+        ++numDropped;
+        return;
+    }
+
+    auto& record = ring.records[head % ringSize];
+    record.level = msg_level;
+    record.length = static_cast<uint32_t>(std::min(message.size(), maxMessageLength));
+    std::memcpy(record.text, message.data(), record.length);
+
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+size_t AsyncLogger::drain()
+{
+    std::scoped_lock<std::mutex> drainLock(_drainMutex);
+
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::scoped_lock<std::mutex> lock(_ringsMutex);
+        rings = _rings;
+    }
+
+    size_t numRecords = 0;
+    std::vector<std::shared_ptr<Ring>> exitedRings;
+    for (auto& ring : rings)
+    {
+        // checked before reading head, so once set every record the thread pushed is visible
+        if (ring->threadExited.load(std::memory_order_acquire)) exitedRings.push_back(ring);
+
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        if (tail == head) continue;
+
+        std::string prefix;
+        {
+            std::scoped_lock<std::mutex> lock(_prefixMutex);
+            if (auto itr = _threadPrefixes.find(ring->id); itr != _threadPrefixes.end()) prefix = itr->second;
+        }
+
+        for (; tail != head; ++tail)
+        {
+            auto& record = ring->records[tail % ringSize];
+            std::string_view message(record.text, record.length);
+            switch (record.level)
+            {
+            case LOGGER_DEBUG: std::cout << prefix << "debug: " << message << '\n'; break;
+            case LOGGER_INFO: std::cout << prefix << message << '\n'; break;
+            case LOGGER_WARN: std::cerr << prefix << "Warning: " << message << '\n'; break;
+            case LOGGER_ERROR: std::cerr << prefix << "ERROR: " << message << '\n'; break;
+            case LOGGER_FATAL: std::cerr << prefix << "FATAL: " << message << '\n'; break;
+            default: break;
+            }
+            ++numRecords;
+        }
+
+        ring->tail.store(tail, std::memory_order_release);
+    }
+
+    if (numRecords > 0)
+    {
+        std::cout.flush();
+        std::cerr.flush();
+        numWritten += numRecords;
+    }
+
+    // the exited threads' rings are now empty and will stay so
+    if (!exitedRings.empty())
+    {
+        std::scoped_lock<std::mutex> lock(_ringsMutex);
+        for (auto& ring : exitedRings) _rings.erase(std::find(_rings.begin(), _rings.end(), ring));
+    }
+
+    return numRecords;
+}
+
+void AsyncLogger::flush()
+{
+    if (!_active || std::this_thread::get_id() == _thread.get_id())
+    {
+        drain();
+        return;
+    }
+
+    // wait for the flusher thread to catch up with everything queued before the call to flush()
+    std::vector<std::pair<std::shared_ptr<Ring>, size_t>> targets;
+    {
+        std::scoped_lock<std::mutex> lock(_ringsMutex);
+        for (auto& ring : _rings) targets.emplace_back(ring, ring->head.load(std::memory_order_acquire));
+    }
+
+    for (auto& [ring, head] : targets)
+    {
+        while (ring->tail.load(std::memory_order_acquire) < head)
+        {
+            // the flusher thread may have been stopped since, in which case drain from this thread
+            if (!_active) drain();
+            else std::this_thread::yield();
+        }
+    }
+}
+
+void AsyncLogger::run()
+{
+    while (_active)
+    {
+        if (drain() == 0) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+void AsyncLogger::debug_implementation(const std::string_view& message)
+{
+    push(LOGGER_DEBUG, message);
+}
+
+void AsyncLogger::info_implementation(const std::string_view& message)
+{
+    push(LOGGER_INFO, message);
+}
+
+void AsyncLogger::warn_implementation(const std::string_view& message)
+{
+    push(LOGGER_WARN, message);
+}
+
+void AsyncLogger::error_implementation(const std::string_view& message)
+{
+    push(LOGGER_ERROR, message);
+}
+
+void AsyncLogger::fatal_implementation(const std::string_view& message)
+{
+    push(LOGGER_FATAL, message);
+    flush();
+}
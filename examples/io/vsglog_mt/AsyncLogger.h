@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Logger backend that defers writing of messages to a background flusher thread.
+// Each logging thread copies its messages into its own single producer, single consumer ring buffer of fixed size
+// records, the flusher thread drains the rings, applies any thread prefix and writes them to std::cout/std::cerr.
+// Records are dropped and counted when a thread's ring is full rather than blocking the thread. Messages longer than
+// maxMessageLength are truncated. Fatal messages are flushed before returning. The rings of threads that have exited are
+// released once they've been drained.
+class AsyncLogger : public vsg::Inherit<vsg::Logger, AsyncLogger>
+{
+public:
+    explicit AsyncLogger(size_t in_ringSize = 4096, size_t in_maxMessageLength = 248);
+
+    const size_t ringSize;
+    const size_t maxMessageLength;
+
+    void setThreadPrefix(std::thread::id id, const std::string& str);
+
+    // block until all the records queued so far have been written.
+    void flush() override;
+
+    // stop the flusher thread, writing any remaining records.
+    void stop();
+
+    std::atomic_uint64_t numWritten{0};
+    std::atomic_uint64_t numDropped{0};
+
+protected:
+    virtual ~AsyncLogger();
+
+    struct Record
+    {
+        Level level;
+        uint32_t length;
+        char* text;
+    };
+
+    struct Ring
+    {
+        Ring(std::thread::id in_id, size_t size, size_t maxMessageLength);
+
+        std::thread::id id;
+        std::vector<Record> records;
+        std::vector<char> text;
+
+        alignas(64) std::atomic_size_t head{0}; // next record to write, only modified by the producer
+        alignas(64) std::atomic_size_t tail{0}; // next record to read, only modified by drain()
+        std::atomic_bool threadExited{false};   // set by the producer's thread_local on exit, nothing more will be pushed
+    };
+
+    Ring& localRing();
+    void push(Level msg_level, const std::string_view& message);
+    size_t drain();
+    void run();
+
+    void debug_implementation(const std::string_view& message) override;
+    void info_implementation(const std::string_view& message) override;
+    void warn_implementation(const std::string_view& message) override;
+    void error_implementation(const std::string_view& message) override;
+    void fatal_implementation(const std::string_view& message) override;
+
+    const uint64_t _id;
+
+    std::mutex _ringsMutex;
+    std::vector<std::shared_ptr<Ring>> _rings;
+
+    // held by drain() so the rings keep a single consumer when flush() or stop() drain from the calling thread
+    std::mutex _drainMutex;
+
+    std::mutex _prefixMutex;
+    std::map<std::thread::id, std::string> _threadPrefixes;
+
+    std::atomic_bool _active{true};
+    std::thread _thread;
+};
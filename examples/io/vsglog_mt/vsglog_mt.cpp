@@ -1,7 +1,10 @@
 #include <vsg/all.h>
 
+#include <chrono>
 #include <iostream>
 
+#include "AsyncLogger.h"
+
 struct MyOperation : public vsg::Inherit<vsg::Operation, MyOperation>
 {
     uint32_t value = 0;
@@ -15,20 +18,100 @@ struct MyOperation : public vsg::Inherit<vsg::Operation, MyOperation>
     }
 };
 
-int main(int argc, char** argv)
+// streambuf that discards everything written to it, used to measure logging without the cost of the console
+class NullBuffer : public std::streambuf
 {
-    // assign our custom ThreadLogger
-    auto mt_logger = vsg::ThreadLogger::create();
-    vsg::Logger::instance() = mt_logger;
+protected:
+    int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
 
-    // set thread main thread prefix
-    mt_logger->setThreadPrefix(std::this_thread::get_id(), "main | ");
+// log count messages from each of numThreads threads and return the number of messages per second written through the logger
+double benchmark(vsg::ref_ptr<vsg::Logger> logger, size_t numThreads, size_t count)
+{
+    auto previous = vsg::Logger::instance();
+    vsg::Logger::instance() = logger;
+    logger->level = vsg::Logger::LOGGER_INFO;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([t, count]() {
+            for (size_t i = 0; i < count; ++i) vsg::info("benchmark message ", i, " from thread ", t);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    logger->flush();
 
+    auto duration = std::chrono::duration<double, std::chrono::seconds::period>(std::chrono::steady_clock::now() - start).count();
+
+    vsg::Logger::instance() = previous;
+
+    return static_cast<double>(numThreads * count) / duration;
+}
+
+int main(int argc, char** argv)
+{
     vsg::CommandLine arguments(&argc, argv);
     auto numThreads = arguments.value<size_t>(16, "-t");
     auto count = arguments.value<size_t>(100, "-n");
     auto level = vsg::Logger::Level(arguments.value(0, "-l"));
     auto defaultThreadPrefix = arguments.read({"-d", "--default"});
+    auto useAsyncLogger = arguments.read("--async");
+    auto ringSize = arguments.value<size_t>(4096, "--ring-size");
+
+    if (arguments.read("--benchmark"))
+    {
+        // compare the ThreadLogger against the AsyncLogger at 1 to maxThreads threads, discarding the output so only the logging cost is measured
+        auto maxThreads = arguments.value<size_t>(64, "--max-threads");
+        auto benchmarkCount = arguments.value<size_t>(100000, "--messages");
+
+        NullBuffer nullBuffer;
+        auto coutBuffer = std::cout.rdbuf(&nullBuffer);
+        auto cerrBuffer = std::cerr.rdbuf(&nullBuffer);
+        std::ostream report(coutBuffer);
+
+        report << "threads, ThreadLogger msgs/sec, AsyncLogger msgs/sec, AsyncLogger written, AsyncLogger dropped" << std::endl;
+        for (size_t benchmarkThreads = 1; benchmarkThreads <= maxThreads; benchmarkThreads *= 2)
+        {
+            double threadLoggerRate = benchmark(vsg::ThreadLogger::create(), benchmarkThreads, benchmarkCount);
+
+            auto asyncLogger = AsyncLogger::create(ringSize);
+            double asyncLoggerRate = benchmark(asyncLogger, benchmarkThreads, benchmarkCount);
+            asyncLogger->stop();
+
+            report << benchmarkThreads << ", " << threadLoggerRate << ", " << asyncLoggerRate << ", " << asyncLogger->numWritten << ", " << asyncLogger->numDropped << std::endl;
+        }
+
+        std::cout.rdbuf(coutBuffer);
+        std::cerr.rdbuf(cerrBuffer);
+        return 0;
+    }
+
+    // assign our custom ThreadLogger, or the AsyncLogger that defers writing to a background thread
+    vsg::ref_ptr<vsg::ThreadLogger> mt_logger;
+    vsg::ref_ptr<AsyncLogger> async_logger;
+    if (useAsyncLogger)
+    {
+        async_logger = AsyncLogger::create(ringSize);
+        vsg::Logger::instance() = async_logger;
+    }
+    else
+    {
+        mt_logger = vsg::ThreadLogger::create();
+        vsg::Logger::instance() = mt_logger;
+    }
+
+    auto setThreadPrefix = [&](std::thread::id id, const std::string& prefix) {
+        if (mt_logger) mt_logger->setThreadPrefix(id, prefix);
+        if (async_logger) async_logger->setThreadPrefix(id, prefix);
+    };
+
+    // set thread main thread prefix
+    setThreadPrefix(std::this_thread::get_id(), "main | ");
 
     // default to logger level 0 to print all messages, but allow command line to override.
     vsg::Logger::instance()->level = level;
@@ -41,7 +124,7 @@ int main(int argc, char** argv)
         for(auto& thread : operationThreads->threads)
         {
             auto prefix = vsg::make_string("thread ", threadNum++, " | ");
-            mt_logger->setThreadPrefix(thread.get_id(), prefix);
+            setThreadPrefix(thread.get_id(), prefix);
             vsg::info("set thread prefix for thread::id = ", thread.get_id(), " to ", prefix);
         }
     }
@@ -70,5 +153,11 @@ int main(int argc, char** argv)
 
     vsg::info("OperationThreads destroyed.");
 
+    if (async_logger)
+    {
+        async_logger->stop();
+        std::cout << "AsyncLogger numWritten = " << async_logger->numWritten << ", numDropped = " << async_logger->numDropped << std::endl;
+    }
+
     return 0;
 }
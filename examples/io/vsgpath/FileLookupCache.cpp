@@ -0,0 +1,148 @@
+#include "FileLookupCache.h"
+
+#include <algorithm>
+#include <cwctype>
+
+void FileLookupCache::assign(vsg::Options& options)
+{
+    vsg::ref_ptr<FileLookupCache> cache(this);
+    options.findFileCallback = [cache](const vsg::Path& filename, const vsg::Options* opt) { return cache->findFile(filename, opt); };
+}
+
+vsg::Path FileLookupCache::findFile(const vsg::Path& filename, const vsg::Options* options)
+{
+    ++numLookups;
+    if (!filename) return {};
+
+    // results are keyed by the filename and the search paths it was looked for in
+    std::string key = filename.string();
+    if (options)
+    {
+        for (auto& path : options->paths)
+        {
+            key.push_back('\n');
+            key.append(path.string());
+        }
+    }
+
+    auto now = clock::now();
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        if (auto itr = _results.find(key); itr != _results.end() && (now - itr->second.validated) < validationInterval)
+        {
+            ++numResultHits;
+            return itr->second.path ? *itr->second.path : vsg::Path();
+        }
+    }
+
+    const vsg::Path* found = nullptr;
+    if (_exists(filename))
+    {
+        found = intern(filename);
+    }
+    else if (options && !std::filesystem::path(filename.native()).is_absolute())
+    {
+        for (auto& path : options->paths)
+        {
+            auto candidate = path / filename;
+            if (_exists(candidate))
+            {
+                found = intern(candidate);
+                break;
+            }
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    _results[key] = Result{found, now};
+    return found ? *found : vsg::Path();
+}
+
+const vsg::Path* FileLookupCache::intern(const vsg::Path& path)
+{
+    auto str = path.string();
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        if (auto itr = _interned.find(str); itr != _interned.end()) return itr->second.get();
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    auto& interned = _interned[str];
+    if (!interned) interned = std::make_unique<const vsg::Path>(path);
+    return interned.get();
+}
+
+void FileLookupCache::report(std::ostream& out) const
+{
+    out << "FileLookupCache lookups = " << numLookups << ", result hits = " << numResultHits << ", directory listings = " << numListings
+        << ", directory validations = " << numValidations << std::endl;
+}
+
+bool FileLookupCache::_exists(const vsg::Path& path)
+{
+    std::filesystem::path fspath(path.native());
+    auto name = fspath.filename();
+    if (name.empty()) return false;
+
+    auto directory = fspath.parent_path();
+    if (directory.empty()) directory = ".";
+
+    auto listing = _directory(directory);
+    return listing->exists && listing->entries.count(_key(name)) != 0;
+}
+
+std::shared_ptr<const FileLookupCache::Directory> FileLookupCache::_directory(const std::filesystem::path& directory)
+{
+    auto key = directory.native();
+    auto now = clock::now();
+
+    std::shared_ptr<const Directory> previous;
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        if (auto itr = _directories.find(key); itr != _directories.end())
+        {
+            if ((now - itr->second->validated) < validationInterval) return itr->second;
+            previous = itr->second;
+        }
+    }
+
+    // list or revalidate outside the lock so other loader threads keep using the cached listings meanwhile
+    std::error_code ec;
+    auto modified = std::filesystem::last_write_time(directory, ec);
+    bool exists = !ec && std::filesystem::is_directory(directory, ec);
+
+    auto listing = std::make_shared<Directory>();
+    listing->exists = exists;
+    listing->modified = modified;
+    listing->validated = now;
+
+    if (previous)
+    {
+        ++numValidations;
+        if (previous->exists == exists && (!exists || previous->modified == modified)) listing->entries = previous->entries;
+        else previous.reset();
+    }
+
+    if (!previous && exists)
+    {
+        ++numListings;
+        for (auto& entry : std::filesystem::directory_iterator(directory, ec))
+        {
+            listing->entries.insert(_key(entry.path().filename()));
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    _directories[key] = listing;
+    return listing;
+}
+
+FileLookupCache::Key FileLookupCache::_key(const std::filesystem::path& name)
+{
+    Key key = name.native();
+#if defined(_WIN32)
+    // Windows file systems are case insensitive
+    std::transform(key.begin(), key.end(), key.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+#endif
+    return key;
+}
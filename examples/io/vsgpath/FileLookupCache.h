@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+// Replaces the per search path stat() calls that vsg::findFile() makes for every file it looks for with lookups into
+// cached directory listings, each directory being listed once and only listed again when its modification time changes.
+// Modification times are checked at most once per validationInterval, and the results of lookups are kept as interned
+// paths keyed by the filename and search paths, so repeated lookups of the same file cost a single hash lookup.
+// assign() installs the cache as an Options::findFileCallback, so it's used by every reader and shared by the loader
+// threads using copies of those Options.
+class FileLookupCache : public vsg::Inherit<vsg::Object, FileLookupCache>
+{
+public:
+    // how long a directory listing or lookup result is trusted before the directory's modification time is checked again
+    std::chrono::steady_clock::duration validationInterval = std::chrono::seconds(1);
+
+    // use the cache for all files found with options
+    void assign(vsg::Options& options);
+
+    // look for filename as vsg::findFile() does, first as given then in each of the options search paths
+    vsg::Path findFile(const vsg::Path& filename, const vsg::Options* options);
+
+    // return the one shared copy of path, so that interned paths can be compared by pointer
+    const vsg::Path* intern(const vsg::Path& path);
+
+    // statistics
+    std::atomic_uint64_t numLookups{0};
+    std::atomic_uint64_t numResultHits{0};
+    std::atomic_uint64_t numListings{0};
+    std::atomic_uint64_t numValidations{0};
+
+    void report(std::ostream& out) const;
+
+protected:
+    using clock = std::chrono::steady_clock;
+    using Key = std::filesystem::path::string_type;
+
+    struct Directory
+    {
+        bool exists = false;
+        std::filesystem::file_time_type modified;
+        clock::time_point validated;
+        std::unordered_set<Key> entries;
+    };
+
+    struct Result
+    {
+        const vsg::Path* path = nullptr; // nullptr when the file wasn't found
+        clock::time_point validated;
+    };
+
+    bool _exists(const vsg::Path& path);
+    std::shared_ptr<const Directory> _directory(const std::filesystem::path& directory);
+    static Key _key(const std::filesystem::path& name);
+
+    std::shared_mutex _mutex;
+    std::unordered_map<Key, std::shared_ptr<const Directory>> _directories;
+    std::unordered_map<std::string, Result> _results;
+    std::unordered_map<std::string, std::unique_ptr<const vsg::Path>> _interned;
+};
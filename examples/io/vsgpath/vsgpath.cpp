@@ -1,13 +1,22 @@
 #include <vsg/all.h>
 
+#include <chrono>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 
+#include "FileLookupCache.h"
+
 
 int main(int argc, char** argv)
 {
     vsg::CommandLine arguments(&argc, argv);
 
+    // benchmark vsg::findFile() against FileLookupCache, numFiles spread over numSearchPaths directories
+    auto numFiles = arguments.value<uint32_t>(0, "--find-files");
+    auto numSearchPaths = arguments.value<uint32_t>(10, "--search-paths");
+    auto numPasses = arguments.value<uint32_t>(3, "--passes");
+
     std::vector<vsg::Path> paths;
     paths.emplace_back("one");
     paths.emplace_back("one.dot");
@@ -110,5 +119,62 @@ int main(int argc, char** argv)
 
     }
 
+    if (numFiles > 0 && numSearchPaths > 0)
+    {
+        std::cout<<"\nvsg::findFile() vs FileLookupCache, "<<numFiles<<" files in "<<numSearchPaths<<" search paths"<<std::endl;
+
+        auto root = std::filesystem::temp_directory_path() / "vsgpath_find_benchmark";
+        std::filesystem::remove_all(root);
+
+        auto options = vsg::Options::create();
+        std::vector<vsg::Path> filenames;
+        for(uint32_t d = 0; d<numSearchPaths; ++d)
+        {
+            auto directory = root / ("dir" + std::to_string(d));
+            std::filesystem::create_directories(directory);
+            options->paths.emplace_back(directory.string());
+        }
+        for(uint32_t i = 0; i<numFiles; ++i)
+        {
+            // spread the files over the search paths so on average half of them are checked per lookup
+            std::string filename = "texture" + std::to_string(i) + ".png";
+            std::ofstream(root / ("dir" + std::to_string(i % numSearchPaths)) / filename);
+            filenames.emplace_back(filename);
+        }
+        filenames.emplace_back("missing.png");
+
+        auto run = [&](const char* name, vsg::ref_ptr<vsg::Options> opt) {
+            std::vector<vsg::Path> found;
+            for(uint32_t pass = 0; pass<numPasses; ++pass)
+            {
+                found.clear();
+                auto start = std::chrono::steady_clock::now();
+                for(auto& filename : filenames) found.push_back(vsg::findFile(filename, opt));
+                auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                std::cout<<"    "<<name<<" pass "<<pass<<" : "<<duration<<"ms"<<std::endl;
+            }
+            return found;
+        };
+
+        auto expected = run("vsg::findFile()", options);
+
+        auto cache = FileLookupCache::create();
+        auto cachedOptions = vsg::Options::create(*options);
+        cache->assign(*cachedOptions);
+        auto found = run("FileLookupCache", cachedOptions);
+
+        std::cout<<"    results "<<(found == expected ? "match" : "differ")<<std::endl;
+        std::cout<<"    interned paths compare by pointer : "<<(cache->intern(found.front()) == cache->intern(expected.front()))<<std::endl;
+        std::cout<<"    ";
+        cache->report(std::cout);
+
+        // adding a file changes the directory's modification time, so it's picked up once validationInterval has passed
+        cache->validationInterval = std::chrono::milliseconds(0);
+        std::ofstream(root / "dir0" / "added.png");
+        std::cout<<"    added.png found after it was created : "<<vsg::findFile("added.png", cachedOptions)<<std::endl;
+
+        std::filesystem::remove_all(root);
+    }
+
     return 0;
 }
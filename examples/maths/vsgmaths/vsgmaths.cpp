@@ -12,10 +12,14 @@
 #include <vsg/maths/vec4.h>
 
 #include <vsg/io/stream.h>
+#include <vsg/utils/CommandLine.h>
+
+#include "BatchCull.h"
 
 #include <chrono>
 #include <cstddef>
 #include <iostream>
+#include <random>
 #include <vector>
 
 template<class M>
@@ -40,8 +44,12 @@ bool test_inverse(const M& m)
     return true;
 }
 
-int main(int /*argc*/, char** /*argv*/)
+int main(int argc, char** argv)
 {
+    vsg::CommandLine arguments(&argc, argv);
+    auto numSpheres = arguments.value<size_t>(1000000, "--spheres");
+    auto numIterations = arguments.value(10u, "--iterations");
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     vsg::vec2 v;
 
@@ -260,5 +268,69 @@ int main(int /*argc*/, char** /*argv*/)
     std::cout << "z_to_x * x_to_z = "  << z_to_x * x_to_z << std::endl;
     std::cout << "z_to_y * y_to_z = "  << z_to_y * y_to_z << std::endl;
 
+    // benchmark culling spheres against the six planes of a box, one sphere at a time with vsg::intersect() and in
+    // batches with each of the supported culling kernels
+    std::cout << std::endl
+              << "Culling " << numSpheres << " spheres against 6 planes, " << numIterations << " iterations" << std::endl;
+
+    Polytope box_polytope{
+        vsg::plane(1.0, 0.0, 0.0, 1.0),  // left plane
+        vsg::plane(-1.0, 0.0, 0.0, 1.0), // right plane
+        vsg::plane(0.0, 1.0, 0.0, 1.0),  // bottom plane
+        vsg::plane(0.0, -1.0, 0.0, 1.0), // top plane
+        vsg::plane(0.0, 0.0, 1.0, 1.0),  // near plane
+        vsg::plane(0.0, 0.0, -1.0, 1.0)  // far plane
+    };
+
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> size(0.01f, 0.1f);
+
+    Sphres random_spheres;
+    SphereBatch sphereBatch;
+    random_spheres.reserve(numSpheres);
+    sphereBatch.reserve(numSpheres);
+    for (size_t i = 0; i < numSpheres; ++i)
+    {
+        random_spheres.emplace_back(vsg::vec3(position(generator), position(generator), position(generator)), size(generator));
+        sphereBatch.add(random_spheres.back());
+    }
+
+    using clock = std::chrono::high_resolution_clock;
+
+    size_t numIntersecting = 0;
+    auto start = clock::now();
+    for (unsigned int i = 0; i < numIterations; ++i)
+    {
+        numIntersecting = 0;
+        for (auto& sphere : random_spheres)
+        {
+            if (vsg::intersect(box_polytope, sphere)) ++numIntersecting;
+        }
+    }
+    double intersectTime = std::chrono::duration<double, std::milli>(clock::now() - start).count() / double(numIterations);
+    std::cout << "   vsg::intersect() : " << numIntersecting << " visible, " << intersectTime << "ms" << std::endl;
+
+    VisibilityMask reference;
+    cull(box_polytope, sphereBatch, reference, CullInstructionSet::SCALAR);
+
+    for (auto instructionSet : {CullInstructionSet::SCALAR, CullInstructionSet::SSE, CullInstructionSet::AVX2, CullInstructionSet::NEON})
+    {
+        if (!supported(instructionSet)) continue;
+
+        VisibilityMask mask;
+        size_t numVisible = 0;
+        start = clock::now();
+        for (unsigned int i = 0; i < numIterations; ++i)
+        {
+            numVisible = cull(box_polytope, sphereBatch, mask, instructionSet);
+        }
+        double time = std::chrono::duration<double, std::milli>(clock::now() - start).count() / double(numIterations);
+
+        std::cout << "   " << name(instructionSet) << " : " << numVisible << " visible, " << time << "ms, " << intersectTime / time << "x vsg::intersect()";
+        if (mask != reference) std::cout << ", mask differs from scalar";
+        std::cout << std::endl;
+    }
+
     return 0;
 }
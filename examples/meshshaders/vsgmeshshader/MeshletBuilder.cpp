@@ -0,0 +1,232 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+static vsg::vec3 xyz(const vsg::vec4& v)
+{
+    return vsg::vec3(v.x, v.y, v.z);
+}
+
+MeshletBuilder::MeshletBuilder(uint32_t in_maxVertices, uint32_t in_maxTriangles) :
+    maxVertices(std::clamp(in_maxVertices, 3u, 256u)), // local indices are packed into 8 bits
+    maxTriangles(std::max(in_maxTriangles, 1u))
+{
+}
+
+void MeshletBuilder::apply(const vsg::Node& node)
+{
+    node.traverse(*this);
+}
+
+void MeshletBuilder::apply(const vsg::Transform& transform)
+{
+    _matrixStack.push_back(transform.transform(_matrixStack.back()));
+    transform.traverse(*this);
+    _matrixStack.pop_back();
+}
+
+void MeshletBuilder::apply(const vsg::LOD& lod)
+{
+    if (!lod.children.empty() && lod.children.front().node) lod.children.front().node->accept(*this);
+}
+
+void MeshletBuilder::apply(const vsg::PagedLOD& plod)
+{
+    for (auto& child : plod.children)
+    {
+        if (child.node)
+        {
+            child.node->accept(*this);
+            return;
+        }
+    }
+}
+
+void MeshletBuilder::apply(const vsg::VertexIndexDraw& vid)
+{
+    if (vid.indices) add(vid.arrays, vid.indices->data, vid.firstIndex, vid.indexCount);
+}
+
+void MeshletBuilder::apply(const vsg::Geometry& geometry)
+{
+    if (!geometry.indices) return;
+
+    for (auto& command : geometry.commands)
+    {
+        if (auto drawIndexed = command->cast<vsg::DrawIndexed>()) add(geometry.arrays, geometry.indices->data, drawIndexed->firstIndex, drawIndexed->indexCount);
+    }
+}
+
+void MeshletBuilder::add(const vsg::BufferInfoList& arrays, const vsg::Data* indices, uint32_t firstIndex, uint32_t indexCount)
+{
+    // triangle lists only, other topologies would need the pipeline's input assembly state
+    if (arrays.empty() || !arrays[0] || !indices) return;
+
+    auto positions = arrays[0]->data.cast<vsg::vec3Array>();
+    if (!positions) return;
+
+    // per vertex normals only, an overall normal is recomputed from the triangles
+    auto vertexNormals = (arrays.size() > 1 && arrays[1]) ? arrays[1]->data.cast<vsg::vec3Array>() : vsg::ref_ptr<vsg::vec3Array>();
+    if (vertexNormals && vertexNormals->size() != positions->size()) vertexNormals = {};
+
+    auto ushortIndices = indices->cast<vsg::ushortArray>();
+    auto uintIndices = indices->cast<vsg::uintArray>();
+    if (!ushortIndices && !uintIndices) return;
+
+    auto index = [&](uint32_t i) -> uint32_t { return ushortIndices ? ushortIndices->at(i) : uintIndices->at(i); };
+    uint32_t endIndex = std::min(firstIndex + indexCount, static_cast<uint32_t>(ushortIndices ? ushortIndices->size() : uintIndices->size()));
+
+    // append the vertices transformed into the root's coordinate frame, normals by the inverse transpose
+    auto& matrix = _matrixStack.back();
+    auto inverse = vsg::inverse(matrix);
+    auto transformNormal = [&inverse](const vsg::dvec3& n) {
+        return vsg::normalize(vsg::dvec3(vsg::dot(vsg::dvec3(inverse[0][0], inverse[0][1], inverse[0][2]), n),
+                                         vsg::dot(vsg::dvec3(inverse[1][0], inverse[1][1], inverse[1][2]), n),
+                                         vsg::dot(vsg::dvec3(inverse[2][0], inverse[2][1], inverse[2][2]), n)));
+    };
+
+    auto base = static_cast<uint32_t>(vertices.size());
+    uint32_t numVertices = static_cast<uint32_t>(positions->size());
+    for (uint32_t i = 0; i < numVertices; ++i)
+    {
+        vertices.emplace_back(vsg::vec3(matrix * vsg::dvec3(positions->at(i))), 1.0f);
+        normals.emplace_back(vertexNormals ? vsg::vec3(transformNormal(vsg::dvec3(vertexNormals->at(i)))) : vsg::vec3(), 0.0f);
+    }
+
+    if (!vertexNormals)
+    {
+        for (uint32_t i = firstIndex; i + 2 < endIndex; i += 3)
+        {
+            uint32_t i0 = index(i), i1 = index(i + 1), i2 = index(i + 2);
+            if (i0 >= numVertices || i1 >= numVertices || i2 >= numVertices) continue;
+
+            auto& v0 = vertices[base + i0];
+            auto n = vsg::cross(xyz(vertices[base + i1] - v0), xyz(vertices[base + i2] - v0)); // area weighted
+            for (auto v : {i0, i1, i2}) normals[base + v] += vsg::vec4(n, 0.0f);
+        }
+        for (uint32_t i = 0; i < numVertices; ++i)
+        {
+            auto& n = normals[base + i];
+            float length = vsg::length(xyz(n));
+            if (length > 0.0f) n /= length;
+        }
+    }
+
+    // greedily fill meshlets with the triangles in index order
+    const uint32_t unassigned = ~0u;
+    std::vector<uint32_t> localIndex(numVertices, unassigned);
+    std::vector<uint32_t> localVertices;
+    std::vector<uint32_t> triangles;
+
+    auto flush = [&]() {
+        if (triangles.empty()) return;
+
+        for (auto& v : localVertices)
+        {
+            localIndex[v] = unassigned;
+            v += base;
+        }
+        addMeshlet(localVertices, triangles);
+
+        localVertices.clear();
+        triangles.clear();
+    };
+
+    for (uint32_t i = firstIndex; i + 2 < endIndex; i += 3)
+    {
+        uint32_t triangle[3] = {index(i), index(i + 1), index(i + 2)};
+        if (triangle[0] >= numVertices || triangle[1] >= numVertices || triangle[2] >= numVertices) continue;
+        if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) continue;
+
+        uint32_t numNewVertices = 0;
+        for (auto v : triangle)
+        {
+            if (localIndex[v] == unassigned) ++numNewVertices;
+        }
+
+        if (localVertices.size() + numNewVertices > maxVertices || triangles.size() >= maxTriangles) flush();
+
+        uint32_t packed = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            auto& local = localIndex[triangle[k]];
+            if (local == unassigned)
+            {
+                local = static_cast<uint32_t>(localVertices.size());
+                localVertices.push_back(triangle[k]);
+            }
+            packed |= local << (8 * k);
+        }
+        triangles.push_back(packed);
+    }
+
+    flush();
+}
+
+void MeshletBuilder::addMeshlet(const std::vector<uint32_t>& localVertices, const std::vector<uint32_t>& triangles)
+{
+    // bounding sphere centred on the bounding box
+    vsg::box bounds;
+    for (auto v : localVertices) bounds.add(xyz(vertices[v]));
+
+    auto centre = (bounds.min + bounds.max) * 0.5f;
+    float radius = 0.0f;
+    for (auto v : localVertices) radius = std::max(radius, vsg::length(xyz(vertices[v]) - centre));
+
+    // normal cone around the average of the triangles' normals
+    std::vector<vsg::vec3> triangleNormals;
+    vsg::vec3 axis;
+    for (auto packed : triangles)
+    {
+        auto& v0 = vertices[localVertices[packed & 0xff]];
+        auto& v1 = vertices[localVertices[(packed >> 8) & 0xff]];
+        auto& v2 = vertices[localVertices[(packed >> 16) & 0xff]];
+        auto n = vsg::cross(xyz(v1 - v0), xyz(v2 - v0));
+        float length = vsg::length(n);
+        if (length == 0.0f) continue;
+
+        triangleNormals.push_back(n / length);
+        axis += triangleNormals.back();
+    }
+
+    float cutoff = 2.0f;
+    float axisLength = vsg::length(axis);
+    if (axisLength > 0.0f)
+    {
+        axis /= axisLength;
+
+        float minDot = 1.0f;
+        for (auto& n : triangleNormals) minDot = std::min(minDot, vsg::dot(axis, n));
+
+        // the cone of view directions from which every triangle is backfacing has a half angle of 90 degrees minus the
+        // normals' spread, so the test against the view direction uses sin(spread) = sqrt(1 - minDot^2).
+        if (minDot > 0.0f) cutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+
+    meshletBounds.emplace_back(centre, radius);
+    meshletBounds.emplace_back(axis, cutoff);
+    meshletRanges.emplace_back(static_cast<uint32_t>(meshletVertices.size()), static_cast<uint32_t>(localVertices.size()), static_cast<uint32_t>(meshletTriangles.size()), static_cast<uint32_t>(triangles.size()));
+
+    meshletVertices.insert(meshletVertices.end(), localVertices.begin(), localVertices.end());
+    meshletTriangles.insert(meshletTriangles.end(), triangles.begin(), triangles.end());
+}
+
+template<class A, typename T>
+static vsg::ref_ptr<vsg::DescriptorBuffer> createStorageBuffer(const std::vector<T>& values, uint32_t binding)
+{
+    auto array = A::create(static_cast<uint32_t>(values.size()));
+    std::copy(values.begin(), values.end(), array->begin());
+    return vsg::DescriptorBuffer::create(array, binding, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+}
+
+vsg::Descriptors MeshletBuilder::createDescriptors() const
+{
+    return vsg::Descriptors{
+        createStorageBuffer<vsg::vec4Array>(meshletBounds, 0),
+        createStorageBuffer<vsg::uivec4Array>(meshletRanges, 1),
+        createStorageBuffer<vsg::vec4Array>(vertices, 2),
+        createStorageBuffer<vsg::vec4Array>(normals, 3),
+        createStorageBuffer<vsg::uintArray>(meshletVertices, 4),
+        createStorageBuffer<vsg::uintArray>(meshletTriangles, 5)};
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// Splits the indexed triangle lists of a subgraph into meshlets of at most maxVertices vertices and maxTriangles
+// triangles for drawing with task and mesh shaders. Triangles are added greedily in index order, starting a new
+// meshlet whenever the next triangle would overflow the current one, so vertex cache optimized meshes give the most
+// compact meshlets. Each meshlet gets a bounding sphere and a normal cone so that the task shader can cull meshlets
+// that are outside the view frustum or whose triangles all face away from the eye.
+// Vertices are flattened into the coordinate frame of the root of the visited subgraph, only the highest
+// resolution child of LOD and PagedLOD nodes is visited.
+class MeshletBuilder : public vsg::Inherit<vsg::ConstVisitor, MeshletBuilder>
+{
+public:
+    explicit MeshletBuilder(uint32_t in_maxVertices = 64, uint32_t in_maxTriangles = 124);
+
+    const uint32_t maxVertices;
+    const uint32_t maxTriangles;
+
+    // xyz position/normal, w unused
+    std::vector<vsg::vec4> vertices;
+    std::vector<vsg::vec4> normals;
+
+    // indices into vertices, referenced by the meshlets' vertexOffset and vertexCount
+    std::vector<uint32_t> meshletVertices;
+
+    // three 8 bit indices into the meshlet's vertices per triangle, referenced by the meshlets' triangleOffset and triangleCount
+    std::vector<uint32_t> meshletTriangles;
+
+    // two vec4 per meshlet, the bounding sphere (centre, radius) and the normal cone (axis, cutoff).
+    // The cutoff is greater than 1 when the triangles' normals are too widely spread for the meshlet to be backface culled.
+    std::vector<vsg::vec4> meshletBounds;
+
+    // vertexOffset, vertexCount, triangleOffset, triangleCount per meshlet
+    std::vector<vsg::uivec4> meshletRanges;
+
+    size_t numMeshlets() const { return meshletRanges.size(); }
+
+    using ConstVisitor::apply;
+
+    void apply(const vsg::Node& node) override;
+    void apply(const vsg::Transform& transform) override;
+    void apply(const vsg::LOD& lod) override;
+    void apply(const vsg::PagedLOD& plod) override;
+    void apply(const vsg::VertexIndexDraw& vid) override;
+    void apply(const vsg::Geometry& geometry) override;
+
+    // storage buffers, bindings 0 to 5: meshletBounds, meshletRanges, vertices, normals, meshletVertices and meshletTriangles
+    vsg::Descriptors createDescriptors() const;
+
+protected:
+    std::vector<vsg::dmat4> _matrixStack{vsg::dmat4()};
+
+    void add(const vsg::BufferInfoList& arrays, const vsg::Data* indices, uint32_t firstIndex, uint32_t indexCount);
+    void addMeshlet(const std::vector<uint32_t>& localVertices, const std::vector<uint32_t>& triangles);
+};
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "MeshletBuilder.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -22,6 +24,9 @@ int main(int argc, char** argv)
         auto type = arguments.value<int>(0, {"--type", "-t"});
         auto outputFilename = arguments.value<vsg::Path>("", "-o");
         bool barycentric = arguments.read({"--barycentric", "--bc"});
+        bool classic = arguments.read("--classic");
+        bool cull = !arguments.read("--no-cull");
+        bool meshletColors = arguments.read("--meshlet-colors");
 
         auto numFrames = arguments.value(-1, "-f");
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
@@ -85,14 +90,43 @@ int main(int argc, char** argv)
         std::cout << "mesh_properites.maxMeshOutputVertices = " << mesh_properites.maxMeshOutputVertices << std::endl;
         std::cout << "mesh_properites.maxMeshOutputPrimitives = " << mesh_properites.maxMeshOutputPrimitives << std::endl;
 
-        auto meshShaderPath = "shaders/meshshader.mesh";
+        // load a model to draw as meshlets, or with the classic vertex pipeline for comparison
+        vsg::ref_ptr<vsg::Node> model;
+        vsg::ref_ptr<MeshletBuilder> meshletBuilder;
+        if (argc > 1)
+        {
+            vsg::Path filename = arguments[1];
+            model = vsg::read_cast<vsg::Node>(filename, options);
+            if (!model)
+            {
+                std::cout << "Failed to load " << filename << std::endl;
+                return 1;
+            }
+
+            meshletBuilder = MeshletBuilder::create();
+            model->accept(*meshletBuilder);
+
+            auto numMeshlets = meshletBuilder->numMeshlets();
+            if (numMeshlets == 0)
+            {
+                std::cout << "No indexed triangle lists found in " << filename << std::endl;
+                return 1;
+            }
+
+            std::cout << "Built " << numMeshlets << " meshlets, average of " << double(meshletBuilder->meshletVertices.size()) / double(numMeshlets) << " vertices and "
+                      << double(meshletBuilder->meshletTriangles.size()) / double(numMeshlets) << " triangles per meshlet" << std::endl;
+        }
+
+        auto taskShaderPath = "shaders/meshlet.task";
+        auto meshShaderPath = meshletBuilder ? "shaders/meshlet.mesh" : "shaders/meshshader.mesh";
         auto fragShaderPath = barycentric ? "shaders/barycentric.frag" : "shaders/meshshader.frag";
         // load shaders
 
+        auto taskShader = meshletBuilder ? vsg::read_cast<vsg::ShaderStage>(taskShaderPath, options) : vsg::ref_ptr<vsg::ShaderStage>();
         auto meshShader = vsg::read_cast<vsg::ShaderStage>(meshShaderPath, options);
         auto fragmentShader = vsg::read_cast<vsg::ShaderStage>(fragShaderPath, options);
 
-        if (!meshShader || !fragmentShader)
+        if (!meshShader || !fragmentShader || (meshletBuilder && !taskShader))
         {
             std::cout << "Could not create shaders." << std::endl;
             return 1;
@@ -104,8 +138,29 @@ int main(int argc, char** argv)
             {VK_SHADER_STAGE_MESH_BIT_EXT, 0, 128} // projection view, and model matrices, actual push constant calls automatically provided by the VSG's DispatchTraversal
         };
 
-        // set up graphics pipeline
         vsg::DescriptorSetLayoutBindings descriptorBindings{};
+        vsg::Descriptors descriptors{};
+
+        if (meshletBuilder)
+        {
+            taskShader->specializationConstants = vsg::ShaderStage::SpecializationConstants{{0, vsg::uintValue::create(cull ? 1 : 0)}};
+            meshShader->specializationConstants = vsg::ShaderStage::SpecializationConstants{{0, vsg::uintValue::create(meshletColors ? 1 : 0)}};
+            shaderStages.insert(shaderStages.begin(), taskShader);
+
+            pushConstantRanges = {{VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 0, 128}};
+
+            descriptorBindings = {
+                {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_TASK_BIT_EXT, nullptr},                                // meshlet bounds
+                {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, nullptr}, // meshlet ranges
+                {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_MESH_BIT_EXT, nullptr},                                // vertices
+                {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_MESH_BIT_EXT, nullptr},                                // normals
+                {4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_MESH_BIT_EXT, nullptr},                                // meshlet vertices
+                {5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_MESH_BIT_EXT, nullptr}                                 // meshlet triangles
+            };
+            descriptors = meshletBuilder->createDescriptors();
+        }
+
+        // set up graphics pipeline
         auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
         vsg::GraphicsPipelineStates pipelineStates{
             vsg::InputAssemblyState::create(),
@@ -118,7 +173,7 @@ int main(int argc, char** argv)
         auto graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, shaderStages, pipelineStates);
         auto bindGraphicsPipeline = vsg::BindGraphicsPipeline::create(graphicsPipeline);
 
-        auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{});
+        auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, descriptors);
         auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, descriptorSet);
 
         // state group to bind the pipeline and descriptor set
@@ -126,7 +181,14 @@ int main(int argc, char** argv)
         scenegraph->add(bindGraphicsPipeline);
         scenegraph->add(bindDescriptorSet);
 
-        if (type <= 1)
+        if (meshletBuilder)
+        {
+            // one task shader workgroup per 32 meshlets, matching meshlet.task's local_size_x
+            auto numMeshlets = static_cast<uint32_t>(meshletBuilder->numMeshlets());
+            std::cout << "Using vsg::DrawMeshTasks with task shader " << (cull ? "culling" : "without culling") << std::endl;
+            scenegraph->addChild(vsg::DrawMeshTasks::create((numMeshlets + 31) / 32, 1, 1));
+        }
+        else if (type <= 1)
         {
             std::cout << "Using vsg::DrawMeshTasks" << std::endl;
             scenegraph->addChild(vsg::DrawMeshTasks::create(2, 1, 1));
@@ -146,15 +208,35 @@ int main(int argc, char** argv)
             scenegraph->addChild(vsg::DrawMeshTasksIndirectCount::create(data, count, 1, 12));
         }
 
+        vsg::ref_ptr<vsg::Node> root = scenegraph;
+        if (model && classic)
+        {
+            std::cout << "Using the classic vertex pipeline" << std::endl;
+            root = model;
+        }
+
         if (outputFilename)
         {
-            vsg::write(scenegraph, outputFilename);
+            vsg::write(root, outputFilename);
             return 1;
         }
 
-
         auto perspective = vsg::Perspective::create(60.0, static_cast<double>(window->extent2D().width) / static_cast<double>(window->extent2D().height), 0.001, 10.0);
         auto lookAt = vsg::LookAt::create(vsg::dvec3(0.0, 2.0, -5.0), vsg::dvec3(0.0, 0.0, 0.0), vsg::dvec3(0.0, 0.0, 1.0));
+        if (model)
+        {
+            // fit the camera to the model's bounds
+            vsg::ComputeBounds computeBounds;
+            model->accept(computeBounds);
+            vsg::dvec3 centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
+            double radius = vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.6;
+
+            perspective->nearDistance = radius * 0.001;
+            perspective->farDistance = radius * 4.5;
+            lookAt->eye = centre + vsg::dvec3(0.0, -radius * 3.5, 0.0);
+            lookAt->center = centre;
+            lookAt->up = vsg::dvec3(0.0, 0.0, 1.0);
+        }
         auto camera = vsg::Camera::create(perspective, lookAt, vsg::ViewportState::create(window->extent2D()));
 
         // assign a CloseHandler to the Viewer to respond to pressing Escape or press the window close button
@@ -162,14 +244,19 @@ int main(int argc, char** argv)
         viewer->addEventHandler(vsg::Trackball::create(camera));
 
         // set up commandGraph for rendering
-        auto commandGraph = vsg::createCommandGraphForView(window, camera, scenegraph);
+        auto commandGraph = vsg::createCommandGraphForView(window, camera, root);
         viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
         viewer->compile();
 
+        auto startTime = vsg::clock::now();
+        uint64_t frameCount = 0;
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
+            ++frameCount;
+
             // pass any events into EventHandlers assigned to the Viewer
             viewer->handleEvents();
 
@@ -179,6 +266,12 @@ int main(int argc, char** argv)
 
             viewer->present();
         }
+
+        if (frameCount > 0)
+        {
+            auto duration = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+            std::cout << "Average frame time = " << duration / double(frameCount) << " ms" << std::endl;
+        }
     }
     catch (const vsg::Exception& exception)
     {
@@ -0,0 +1,93 @@
+#include "BatchCullGroup.h"
+
+#include <limits>
+
+using namespace experimental;
+
+BatchCullGroup::BatchCullGroup(size_t numChildren) :
+    Inherit(numChildren)
+{
+}
+
+void BatchCullGroup::update()
+{
+    _bounds.clear();
+    _targets.clear();
+    _bounds.reserve(children.size());
+    _targets.reserve(children.size());
+
+    for (auto& child : children)
+    {
+        if (!child) continue;
+
+        if (auto cullNode = child->cast<vsg::CullNode>())
+        {
+            if (!cullNode->child) continue;
+            _bounds.add(vsg::sphere(vsg::vec3(cullNode->bound.center), static_cast<float>(cullNode->bound.radius)));
+            _targets.push_back(cullNode->child.get());
+            continue;
+        }
+
+        vsg::ComputeBounds computeBounds;
+        child->accept(computeBounds);
+        if (computeBounds.bounds.valid())
+        {
+            auto& bounds = computeBounds.bounds;
+            _bounds.add(vsg::sphere(vsg::vec3((bounds.min + bounds.max) * 0.5), static_cast<float>(vsg::length(bounds.max - bounds.min) * 0.5)));
+        }
+        else
+        {
+            _bounds.add(vsg::sphere(vsg::vec3(), std::numeric_limits<float>::infinity()));
+        }
+        _targets.push_back(child.get());
+    }
+
+    _numChildren = children.size();
+}
+
+void BatchCullGroup::traverse(vsg::RecordTraversal& visitor) const
+{
+    if (_numChildren != children.size())
+    {
+        Group::traverse(visitor);
+        return;
+    }
+
+    // the frustum planes in the group's local coordinate frame, from the rows of the projection * modelview matrix,
+    // with clip space bounded by -w <= x, y <= w and 0 <= z <= w
+    auto state = visitor.getState();
+    auto m = state->projectionMatrixStack.top() * state->modelviewMatrixStack.top();
+    auto row = [&m](int r) { return vsg::dvec4(m[0][r], m[1][r], m[2][r], m[3][r]); };
+    vsg::dvec4 clipPlanes[6] = {row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2)};
+
+    std::vector<vsg::plane> planes;
+    for (auto& p : clipPlanes)
+    {
+        // an infinite far plane has no normal and culls nothing
+        double len = vsg::length(vsg::dvec3(p.x, p.y, p.z));
+        if (len <= 0.0) continue;
+        planes.push_back(vsg::plane(p.x / len, p.y / len, p.z / len, p.w / len));
+    }
+
+    VisibilityMask mask;
+    cull(planes, _bounds, mask);
+    forEachVisible(mask, [&](size_t i) { _targets[i]->accept(visitor); });
+}
+
+vsg::ref_ptr<vsg::Node> experimental::batchCull(vsg::ref_ptr<vsg::Node> node, size_t minChildren)
+{
+    auto group = node.cast<vsg::Group>();
+    if (!group) return node;
+
+    for (auto& child : group->children)
+    {
+        if (child) child = batchCull(child, minChildren);
+    }
+
+    if (typeid(*group) != typeid(vsg::Group) || group->children.size() < minChildren) return node;
+
+    auto batchCullGroup = BatchCullGroup::create();
+    batchCullGroup->children = group->children;
+    batchCullGroup->update();
+    return batchCullGroup;
+}
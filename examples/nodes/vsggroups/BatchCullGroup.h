@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "BatchCull.h"
+
+namespace experimental
+{
+
+    // Group that holds the bounding spheres of its children as a SphereBatch so that the RecordTraversal culls all of
+    // them against the view frustum in one batch, several children at a time, rather than testing them one by one.
+    // The bound of a vsg::CullNode child is used in its place and, when visible, its child is recorded directly so the
+    // test isn't repeated. Other children are bounded with vsg::ComputeBounds, unbounded ones are never culled.
+    // Call update() after changing the children, until then the children are traversed without culling.
+    class BatchCullGroup : public vsg::Inherit<vsg::Group, BatchCullGroup>
+    {
+    public:
+        explicit BatchCullGroup(size_t numChildren = 0);
+
+        // recompute the bounds of the children
+        void update();
+
+        using Group::traverse;
+        void traverse(vsg::RecordTraversal& visitor) const override;
+
+    protected:
+        SphereBatch _bounds;
+        std::vector<const vsg::Node*> _targets;
+        size_t _numChildren = 0;
+    };
+
+    // replace the plain vsg::Groups of a subgraph that have at least minChildren children with BatchCullGroups
+    extern vsg::ref_ptr<vsg::Node> batchCull(vsg::ref_ptr<vsg::Node> node, size_t minChildren);
+
+} // namespace experimental
@@ -0,0 +1,107 @@
+#include "FlatNodeTree.h"
+
+namespace experimental
+{
+
+    namespace
+    {
+        struct Flattener
+        {
+            FlatNodeTree& tree;
+            std::vector<vsg::dbox> boxes;
+
+            uint32_t addRecord(const vsg::Node* leaf)
+            {
+                auto index = static_cast<uint32_t>(tree.subtreeEnd.size());
+                tree.subtreeEnd.push_back(index + 1);
+                tree.numChildren.push_back(0);
+                tree.leaves.push_back(leaf);
+                boxes.emplace_back();
+                return index;
+            }
+
+            void addChildren(uint32_t index, const vsg::Node* const* begin, const vsg::Node* const* end)
+            {
+                for (auto itr = begin; itr != end; ++itr)
+                {
+                    if (!*itr) continue;
+                    auto child = add(**itr);
+                    if (boxes[child].valid()) boxes[index].add(boxes[child]);
+                    ++tree.numChildren[index];
+                }
+                tree.subtreeEnd[index] = static_cast<uint32_t>(tree.subtreeEnd.size());
+            }
+
+            template<class G>
+            uint32_t addGroup(const G& group)
+            {
+                std::vector<const vsg::Node*> children;
+                for (auto& child : group.children) children.push_back(child.get());
+
+                auto index = addRecord(nullptr);
+                addChildren(index, children.data(), children.data() + children.size());
+                return index;
+            }
+
+            uint32_t add(const vsg::Node& node)
+            {
+                auto& type = typeid(node);
+                if (type == typeid(vsg::Group)) return addGroup(static_cast<const vsg::Group&>(node));
+                if (type == typeid(vsg::QuadGroup)) return addGroup(static_cast<const vsg::QuadGroup&>(node));
+                if (type == typeid(vsg::CullGroup))
+                {
+                    auto index = addGroup(static_cast<const vsg::CullGroup&>(node));
+                    setBound(index, static_cast<const vsg::CullGroup&>(node).bound);
+                    return index;
+                }
+                if (type == typeid(vsg::CullNode))
+                {
+                    auto& cullNode = static_cast<const vsg::CullNode&>(node);
+                    const vsg::Node* child = cullNode.child.get();
+                    auto index = addRecord(nullptr);
+                    addChildren(index, &child, &child + 1);
+                    setBound(index, cullNode.bound);
+                    return index;
+                }
+
+                auto index = addRecord(&node);
+
+                vsg::ComputeBounds computeBounds;
+                node.accept(computeBounds);
+                boxes[index] = computeBounds.bounds;
+                return index;
+            }
+
+            void setBound(uint32_t index, const vsg::dsphere& bound)
+            {
+                // the declared bound of a cull node takes precedence over the bounds of its children
+                boxes[index] = vsg::dbox(bound.center - vsg::dvec3(bound.radius, bound.radius, bound.radius), bound.center + vsg::dvec3(bound.radius, bound.radius, bound.radius));
+            }
+        };
+    } // namespace
+
+    size_t FlatNodeTree::numBytes() const
+    {
+        return subtreeEnd.size() * (sizeof(uint32_t) * 2 + sizeof(vsg::dsphere) + sizeof(const vsg::Node*));
+    }
+
+    FlatNodeTree flatten(vsg::ref_ptr<const vsg::Node> root)
+    {
+        FlatNodeTree tree;
+        tree.source = root;
+        if (!root) return tree;
+
+        Flattener flattener{tree, {}};
+        flattener.add(*root);
+
+        tree.bounds.reserve(flattener.boxes.size());
+        for (auto& box : flattener.boxes)
+        {
+            if (box.valid()) tree.bounds.emplace_back((box.min + box.max) * 0.5, vsg::length(box.max - box.min) * 0.5);
+            else tree.bounds.emplace_back(vsg::dvec3(), -1.0);
+        }
+
+        return tree;
+    }
+
+} // namespace experimental
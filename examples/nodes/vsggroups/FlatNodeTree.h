@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <vector>
+
+namespace experimental
+{
+
+    // Contiguous, structure of arrays representation of a scene graph's vsg::Group hierarchy.
+    // Records are stored in depth first order so that the subtree of record i occupies [i, subtreeEnd[i]), allowing a
+    // traversal to walk the arrays linearly and skip culled subtrees with a single index jump rather than chasing child
+    // pointers. Plain vsg::Group, vsg::QuadGroup, vsg::CullGroup and vsg::CullNode are flattened, any other node becomes a
+    // leaf record whose subtree is passed on to the visitor as a regular scene graph.
+    class FlatNodeTree
+    {
+    public:
+        // index one past the last record of each record's subtree
+        std::vector<uint32_t> subtreeEnd;
+
+        // number of direct children, 0 for leaves
+        std::vector<uint32_t> numChildren;
+
+        // world bounds of each record's subtree, a negative radius marks an unbounded record that is never culled
+        std::vector<vsg::dsphere> bounds;
+
+        // the node that a leaf record delegates to, nullptr for flattened groups
+        std::vector<const vsg::Node*> leaves;
+
+        // keeps the leaves alive
+        vsg::ref_ptr<const vsg::Node> source;
+
+        size_t size() const { return subtreeEnd.size(); }
+        size_t numBytes() const;
+
+        // visit every record, calling visitLeaf(const vsg::Node&) for each leaf, returns the number of records visited.
+        template<typename F>
+        size_t traverse(F visitLeaf) const
+        {
+            size_t count = leaves.size();
+            for (auto leaf : leaves)
+            {
+                if (leaf) visitLeaf(*leaf);
+            }
+            return count;
+        }
+
+        // visit the records whose bounds intersect the half spaces dot(plane.xyz, p) + plane.w >= 0, skipping culled subtrees.
+        template<typename F>
+        size_t traverse(const std::vector<vsg::dvec4>& planes, F visitLeaf) const
+        {
+            size_t count = 0;
+            for (size_t i = 0; i < subtreeEnd.size();)
+            {
+                auto& bs = bounds[i];
+                bool culled = false;
+                if (bs.radius >= 0.0)
+                {
+                    for (auto& plane : planes)
+                    {
+                        if (plane.x * bs.center.x + plane.y * bs.center.y + plane.z * bs.center.z + plane.w < -bs.radius)
+                        {
+                            culled = true;
+                            break;
+                        }
+                    }
+                }
+
+                if (culled)
+                {
+                    i = subtreeEnd[i];
+                    continue;
+                }
+
+                ++count;
+                if (leaves[i]) visitLeaf(*leaves[i]);
+                ++i;
+            }
+            return count;
+        }
+    };
+
+    // convert a loaded scene graph into a FlatNodeTree
+    FlatNodeTree flatten(vsg::ref_ptr<const vsg::Node> root);
+
+} // namespace experimental
@@ -5,7 +5,18 @@
 #include <memory>
 #include <vector>
 
+#include "BatchCullGroup.h"
+#include "FlatNodeTree.h"
+#include "ParallelTraversal.h"
 #include "SharedPtrNode.h"
+#include "TypeIndexedDispatch.h"
+
+#if defined(__linux__)
+#    include <linux/perf_event.h>
+#    include <sys/ioctl.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
 
 //#define INLINE_TRAVERSE
 
@@ -51,6 +62,21 @@ class VsgConstVisitor : public vsg::ConstVisitor
 public:
     unsigned int numNodes = 0;
 
+    // optional ParallelTraversal that large groups are split across
+    vsg::ref_ptr<experimental::ParallelTraversal> parallelTraversal;
+
+    vsg::ref_ptr<VsgConstVisitor> clone() const
+    {
+        vsg::ref_ptr<VsgConstVisitor> visitor(new VsgConstVisitor);
+        visitor->parallelTraversal = parallelTraversal;
+        return visitor;
+    }
+
+    void merge(const VsgConstVisitor& other)
+    {
+        numNodes += other.numNodes;
+    }
+
     using ConstVisitor::apply;
 
     void apply(const vsg::Object& object) final
@@ -64,6 +90,7 @@ public:
     {
         //std::cout<<"VsgVisitor::apply(vsg::Group&)"<<std::endl;
         ++numNodes;
+        if (parallelTraversal && parallelTraversal->traverse(group, *this)) return;
 #ifdef INLINE_TRAVERSE
         vsg::Group::t_traverse(group, *this);
 #else
@@ -75,6 +102,7 @@ public:
     {
         //std::cout<<"VsgVisitor::apply(vsg::QuadGroup&)"<<std::endl;
         ++numNodes;
+        if (parallelTraversal && parallelTraversal->traverse(group, *this)) return;
 #ifdef INLINE_TRAVERSE
         vsg::QuadGroup::t_traverse(group, *this);
 #else
@@ -83,6 +111,78 @@ public:
     }
 };
 
+// group whose accept() casts the visitor to find its custom handler on every visit, as AlternateCustomGroupNode in
+// vsgvisitorcustomtype does
+class CastDispatchGroup : public vsg::Inherit<vsg::Group, CastDispatchGroup>
+{
+public:
+    explicit CastDispatchGroup(size_t numChildren = 0) :
+        Inherit(numChildren) {}
+
+    void accept(vsg::Visitor& visitor) override;
+};
+
+class CastDispatchVisitor : public vsg::Inherit<vsg::Visitor, CastDispatchVisitor>
+{
+public:
+    unsigned int numNodes = 0;
+
+    using Visitor::apply;
+
+    void apply(vsg::Node&) override
+    {
+        ++numNodes;
+    }
+
+    virtual void apply(CastDispatchGroup& group)
+    {
+        ++numNodes;
+        group.traverse(*this);
+    }
+};
+
+void CastDispatchGroup::accept(vsg::Visitor& visitor)
+{
+    if (auto cdv = visitor.cast<CastDispatchVisitor>()) cdv->apply(*this);
+    else visitor.apply(*this);
+}
+
+// visits IndexedGroup trees through a DispatchTable, so neither accept() nor cast<>() is called per node
+class IndexedVisitor : public vsg::Inherit<vsg::Visitor, IndexedVisitor>
+{
+public:
+    unsigned int numNodes = 0;
+
+    static const DispatchTable<IndexedVisitor>& table()
+    {
+        static const auto s_table = []() {
+            DispatchTable<IndexedVisitor> t;
+            t.add<vsg::Node>();
+            t.add<IndexedGroup>();
+            return t;
+        }();
+        return s_table;
+    }
+
+    void dispatch(vsg::Node& node)
+    {
+        table().dispatch(*this, node, TypeRegistry::id(node));
+    }
+
+    using Visitor::apply;
+
+    void apply(vsg::Node&) override
+    {
+        ++numNodes;
+    }
+
+    void apply(IndexedGroup& group)
+    {
+        ++numNodes;
+        group.traverse(*this, table());
+    }
+};
+
 class ExperimentVisitor : public experimental::SharedPtrVisitor
 {
 public:
@@ -105,6 +205,57 @@ public:
     }
 };
 
+// counts the hardware cache misses of the calling thread between start() and stop(), only supported on Linux.
+class CacheMissCounter
+{
+public:
+    CacheMissCounter()
+    {
+#if defined(__linux__)
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        _fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    ~CacheMissCounter()
+    {
+#if defined(__linux__)
+        if (_fd >= 0) close(_fd);
+#endif
+    }
+
+    bool valid() const { return _fd >= 0; }
+
+    void start()
+    {
+#if defined(__linux__)
+        if (_fd < 0) return;
+        ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    uint64_t stop()
+    {
+        uint64_t count = 0;
+#if defined(__linux__)
+        if (_fd < 0) return 0;
+        ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(_fd, &count, sizeof(count)) != sizeof(count)) count = 0;
+#endif
+        return count;
+    }
+
+protected:
+    int _fd = -1;
+};
+
 vsg::ref_ptr<vsg::Node> createVsgQuadTree(unsigned int numLevels, unsigned int& numNodes, unsigned int& numBytes)
 {
     if (numLevels == 0)
@@ -155,6 +306,63 @@ vsg::ref_ptr<vsg::Node> createFixedQuadTree(unsigned int numLevels, unsigned int
     return t;
 }
 
+vsg::ref_ptr<vsg::Node> createCastDispatchQuadTree(unsigned int numLevels, unsigned int& numNodes, unsigned int& numBytes)
+{
+    numNodes += 1;
+    if (numLevels == 0)
+    {
+        numBytes += sizeof(vsg::Node);
+        return vsg::Node::create();
+    }
+
+    auto t = CastDispatchGroup::create(4);
+    numBytes += sizeof(CastDispatchGroup) + 4 * sizeof(vsg::ref_ptr<vsg::Node>);
+    for (auto& child : t->children) child = createCastDispatchQuadTree(numLevels - 1, numNodes, numBytes);
+    return t;
+}
+
+vsg::ref_ptr<vsg::Node> createIndexedQuadTree(unsigned int numLevels, unsigned int& numNodes, unsigned int& numBytes)
+{
+    numNodes += 1;
+    if (numLevels == 0)
+    {
+        numBytes += sizeof(vsg::Node);
+        return vsg::Node::create();
+    }
+
+    auto t = IndexedGroup::create();
+    numBytes += sizeof(IndexedGroup) + 4 * (sizeof(vsg::ref_ptr<vsg::Node>) + sizeof(uint32_t));
+    for (int i = 0; i < 4; ++i) t->addChild(createIndexedQuadTree(numLevels - 1, numNodes, numBytes));
+    t->updateChildTypes();
+    return t;
+}
+
+// a single group of CullNodes on a grid of 2^numLevels by 2^numLevels spheres spanning x, y = [-2, 2] at z = 0.5, so a
+// quarter of them lie within the clip space frustum -1 <= x, y <= 1, 0 <= z <= 1 of an identity projection and view
+vsg::ref_ptr<vsg::Node> createCullNodeGrid(unsigned int numLevels, unsigned int& numNodes, unsigned int& numBytes)
+{
+    uint32_t numColumns = 1u << numLevels;
+    double spacing = 4.0 / double(numColumns);
+
+    auto group = vsg::Group::create();
+    group->children.reserve(numColumns * numColumns);
+    numNodes += 1;
+    numBytes += sizeof(vsg::Group) + numColumns * numColumns * sizeof(vsg::ref_ptr<vsg::Node>);
+
+    for (uint32_t r = 0; r < numColumns; ++r)
+    {
+        for (uint32_t c = 0; c < numColumns; ++c)
+        {
+            vsg::dsphere bound(-2.0 + spacing * (double(c) + 0.5), -2.0 + spacing * (double(r) + 0.5), 0.5, spacing * 0.5);
+            group->addChild(vsg::CullNode::create(bound, vsg::Node::create()));
+            numNodes += 2;
+            numBytes += sizeof(vsg::CullNode) + sizeof(vsg::Node);
+        }
+    }
+
+    return group;
+}
+
 std::shared_ptr<experimental::SharedPtrNode> createSharedPtrQuadTree(unsigned int numLevels, unsigned int& numNodes, unsigned int& numBytes)
 {
     if (numLevels == 0)
@@ -191,6 +399,18 @@ int main(int argc, char** argv)
     auto outputFilename = arguments.value(std::string(""), "-o");
     vsg::ref_ptr<vsg::RecordTraversal> vsg_recordTraversal(arguments.read("-d") ? new vsg::RecordTraversal : nullptr);
     vsg::ref_ptr<VsgConstVisitor> vsg_ConstVisitor(arguments.read("-c") ? new VsgConstVisitor : nullptr);
+    auto flat = arguments.read("--flat");
+    auto cull = arguments.read("--cull");
+    auto reportCacheMisses = arguments.read("--cache-misses");
+    auto numParallelThreads = arguments.value(0u, "--parallel");
+    auto minSubtreeSize = arguments.value(size_t(10000), "--min-subtree");
+    auto batchCullSize = arguments.value(0u, "--batch-cull");
+    if (numParallelThreads > 0)
+    {
+        // parallel traversal is supported by VsgConstVisitor
+        if (!vsg_ConstVisitor) vsg_ConstVisitor = new VsgConstVisitor;
+        vsg_ConstVisitor->parallelTraversal = experimental::ParallelTraversal::create(vsg::OperationThreads::create(numParallelThreads), minSubtreeSize);
+    }
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     using clock = std::chrono::high_resolution_clock;
@@ -216,6 +436,9 @@ int main(int argc, char** argv)
     {
         if (type == "vsg::Group") vsg_root = createVsgQuadTree(numLevels, numNodes, numBytes);
         if (type == "vsg::QuadGroup") vsg_root = createFixedQuadTree(numLevels, numNodes, numBytes);
+        if (type == "vsg::CullNode") vsg_root = createCullNodeGrid(numLevels, numNodes, numBytes);
+        if (type == "CastDispatchGroup") vsg_root = createCastDispatchQuadTree(numLevels, numNodes, numBytes);
+        if (type == "IndexedGroup") vsg_root = createIndexedQuadTree(numLevels, numNodes, numBytes);
         if (type == "SharedPtrGroup") shared_root = createSharedPtrQuadTree(numLevels, numNodes, numBytes)->shared_from_this();
     }
 
@@ -225,15 +448,84 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    // replace groups with many children by BatchCullGroups that the RecordTraversal culls in SIMD batches, timed as part of construction
+    if (batchCullSize > 0 && vsg_root)
+    {
+        vsg_root = experimental::batchCull(vsg_root, batchCullSize);
+        std::cout << "using BatchCullGroup for groups with " << batchCullSize << " or more children, " << name(bestInstructionSet()) << " culling" << std::endl;
+    }
+
+    // convert the pointer based tree into the flattened representation, timed as part of construction
+    experimental::FlatNodeTree flat_tree;
+    if (flat && vsg_root)
+    {
+        flat_tree = experimental::flatten(vsg_root);
+        if (numNodes == 0) numNodes = static_cast<unsigned int>(flat_tree.size());
+        numBytes = static_cast<unsigned int>(flat_tree.numBytes());
+    }
+
     clock::time_point after_construction = clock::now();
 
     unsigned int numNodesVisited = 0;
 
-    if (vsg_root)
+    CacheMissCounter cacheMissCounter;
+    if (reportCacheMisses) cacheMissCounter.start();
+
+    if (flat && vsg_root)
+    {
+        // cull against the plane through the centre of the scene's bound, typically discarding half of it
+        std::vector<vsg::dvec4> planes;
+        if (cull && flat_tree.size() > 0 && flat_tree.bounds[0].radius >= 0.0) planes.emplace_back(1.0, 0.0, 0.0, -flat_tree.bounds[0].center.x);
+
+        vsg::ref_ptr<VsgConstVisitor> visitor = vsg_ConstVisitor ? vsg_ConstVisitor : vsg::ref_ptr<VsgConstVisitor>(new VsgConstVisitor);
+        std::cout << "using FlatNodeTree" << (vsg_recordTraversal ? " with RecordTraversal" : " with VsgConstVisitor") << (planes.empty() ? "" : ", culled") << std::endl;
+
+        for (unsigned int i = 0; i < numTraversals; ++i)
+        {
+            // leaf records are counted by the flat traversal and again by the visitor, so don't count them twice
+            unsigned int numLeaves = 0;
+            auto visitLeaf = [&](const vsg::Node& leaf) {
+                ++numLeaves;
+                if (vsg_recordTraversal) leaf.accept(*vsg_recordTraversal);
+                else leaf.accept(*visitor);
+            };
+
+            numNodesVisited += static_cast<unsigned int>(planes.empty() ? flat_tree.traverse(visitLeaf) : flat_tree.traverse(planes, visitLeaf));
+            if (!vsg_recordTraversal) numNodesVisited += visitor->numNodes - numLeaves;
+            visitor->numNodes = 0;
+        }
+    }
+    else if (vsg_root && type == "CastDispatchGroup")
+    {
+        CastDispatchVisitor castDispatchVisitor;
+        std::cout << "using CastDispatchVisitor" << std::endl;
+        for (unsigned int i = 0; i < numTraversals; ++i)
+        {
+            vsg_root->accept(castDispatchVisitor);
+            numNodesVisited += castDispatchVisitor.numNodes;
+            castDispatchVisitor.numNodes = 0;
+        }
+    }
+    else if (vsg_root && type == "IndexedGroup")
+    {
+        IndexedVisitor indexedVisitor;
+        std::cout << "using IndexedVisitor" << std::endl;
+        for (unsigned int i = 0; i < numTraversals; ++i)
+        {
+            indexedVisitor.dispatch(*vsg_root);
+            numNodesVisited += indexedVisitor.numNodes;
+            indexedVisitor.numNodes = 0;
+        }
+    }
+    else if (vsg_root)
     {
         if (vsg_recordTraversal)
         {
             std::cout << "using RecordTraversal" << std::endl;
+
+            // cull against the clip space frustum of an identity projection and view
+            vsg_recordTraversal->getState()->setProjectionAndViewMatrix(vsg::dmat4(), vsg::dmat4());
+
             for (unsigned int i = 0; i < numTraversals; ++i)
             {
                 vsg_root->accept(*vsg_recordTraversal);
@@ -244,7 +536,9 @@ int main(int argc, char** argv)
         }
         else if (vsg_ConstVisitor)
         {
-            std::cout << "using VsgConstVisitor" << std::endl;
+            std::cout << "using VsgConstVisitor";
+            if (numParallelThreads > 0) std::cout << " with " << numParallelThreads << " threads";
+            std::cout << std::endl;
             for (unsigned int i = 0; i < numTraversals; ++i)
             {
                 vsg_root->accept(*vsg_ConstVisitor);
@@ -276,6 +570,8 @@ int main(int argc, char** argv)
         }
     }
 
+    uint64_t numCacheMisses = reportCacheMisses ? cacheMissCounter.stop() : 0;
+
     clock::time_point after_traversal = clock::now();
 
     if (!outputFilename.empty())
@@ -287,6 +583,7 @@ int main(int argc, char** argv)
 
     vsg_root = 0;
     shared_root = 0;
+    flat_tree = {};
 
     clock::time_point after_destruction = clock::now();
 
@@ -297,6 +594,11 @@ int main(int argc, char** argv)
         std::cout << "numBytes : " << numBytes << std::endl;
         std::cout << "average node size : " << double(numBytes) / double(numNodes) << std::endl;
         std::cout << "numNodesVisited : " << numNodesVisited << std::endl;
+        if (reportCacheMisses)
+        {
+            if (cacheMissCounter.valid()) std::cout << "cache misses : " << numCacheMisses << ", per node visited : " << double(numCacheMisses) / double(numNodesVisited) << std::endl;
+            else std::cout << "cache misses : hardware counters not available" << std::endl;
+        }
 
         if (!inputFilename.empty())
             std::cout << "read time : " << std::chrono::duration<double>(after_construction - start).count() << std::endl;
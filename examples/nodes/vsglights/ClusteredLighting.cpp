@@ -0,0 +1,159 @@
+#include "ClusteredLighting.h"
+#include "AssignDescriptorSet.h"
+
+#include <algorithm>
+#include <cmath>
+
+ClusteredLighting::ClusteredLighting(uint32_t in_numClustersX, uint32_t in_numClustersY, uint32_t in_numClustersZ, uint32_t in_maxLightsPerCluster) :
+    numClustersX(in_numClustersX),
+    numClustersY(in_numClustersY),
+    numClustersZ(in_numClustersZ),
+    maxLightsPerCluster(in_maxLightsPerCluster),
+    _params(ClusterParamsValue::create())
+{
+    _params->properties.dataVariance = vsg::DYNAMIC_DATA;
+    descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings());
+}
+
+vsg::DescriptorSetLayoutBindings ClusteredLighting::descriptorBindings() const
+{
+    // the same layout is bound to the compute pipelines as set 0 and to the graphics pipelines as set 2
+    VkShaderStageFlags stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    return vsg::DescriptorSetLayoutBindings{
+        {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, stageFlags, nullptr}, // ClusterParams
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, stageFlags, nullptr}, // ClusterLights
+        {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, stageFlags, nullptr}, // ClusterViewLights
+        {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, stageFlags, nullptr}, // ClusterLightCounts
+        {4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, stageFlags, nullptr}  // ClusterLightIndices
+    };
+}
+
+bool ClusteredLighting::assignShaderSets(vsg::ref_ptr<vsg::Options> options)
+{
+    const char* bindingNames[] = {"clusterParams", "clusterLights", "clusterViewLights", "clusterLightCounts", "clusterLightIndices"};
+    auto bindings = descriptorBindings();
+
+    auto clustered = [&](vsg::ref_ptr<vsg::ShaderSet> shaderSet, const vsg::Path& fragmentShaderFilename) -> bool {
+        // the built in shaders don't have the clustered lighting code so use the ones in vsgExamples/data
+        auto fragmentShader = vsg::read_cast<vsg::ShaderStage>(fragmentShaderFilename, options);
+        if (!shaderSet || !fragmentShader) return false;
+
+        for (auto& stage : shaderSet->stages)
+        {
+            if (stage->stage == VK_SHADER_STAGE_FRAGMENT_BIT) stage = fragmentShader;
+        }
+
+        for (auto& binding : bindings)
+        {
+            shaderSet->addDescriptorBinding(bindingNames[binding.binding], "VSG_CLUSTERED_LIGHTING", clusterDescriptorSet, binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags, {});
+        }
+
+        if (!shaderSet->defaultShaderHints) shaderSet->defaultShaderHints = vsg::ShaderCompileSettings::create();
+        shaderSet->defaultShaderHints->defines.insert("VSG_CLUSTERED_LIGHTING");
+        return true;
+    };
+
+    auto phongShaderSet = vsg::createPhongShaderSet(options);
+    auto pbrShaderSet = vsg::createPhysicsBasedRenderingShaderSet(options);
+    if (!clustered(phongShaderSet, "shaders/standard_phong.frag") || !clustered(pbrShaderSet, "shaders/standard_pbr.frag")) return false;
+
+    options->shaderSets["phong"] = phongShaderSet;
+    options->shaderSets["pbr"] = pbrShaderSet;
+    return true;
+}
+
+void ClusteredLighting::add(const vsg::dvec3& position, const vsg::vec3& color, float intensity)
+{
+    // vsg::PointLight attenuates with the inverse square of distance, so the radius is where the brightest channel drops below the cutoff
+    float radius = std::sqrt(intensity * std::max({color.r, color.g, color.b}) / intensityCutoff);
+
+    _lights.emplace_back(static_cast<float>(position.x), static_cast<float>(position.y), static_cast<float>(position.z), radius);
+    _lights.emplace_back(color.r, color.g, color.b, intensity);
+}
+
+vsg::ref_ptr<vsg::DescriptorSet> ClusteredLighting::getOrCreateDescriptorSet()
+{
+    if (_descriptorSet) return _descriptorSet;
+
+    uint32_t numClusters = numClustersX * numClustersY * numClustersZ;
+    auto& params = _params->value();
+    params.counts.set(numClustersX, numClustersY, numClustersZ, numLights());
+    params.limits.set(maxLightsPerCluster, 0, 0, 0);
+
+    // storage buffers can't be empty so keep a slot for one light
+    auto lights = vsg::vec4Array::create(std::max(numLights(), 1u) * 2);
+    std::copy(_lights.begin(), _lights.end(), lights->begin());
+
+    auto viewLights = vsg::vec4Array::create(std::max(numLights(), 1u));
+    auto lightCounts = vsg::uintArray::create(numClusters);
+    auto lightIndices = vsg::uintArray::create(numClusters * maxLightsPerCluster);
+
+    _descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{
+                                                                         vsg::DescriptorBuffer::create(_params, 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER),
+                                                                         vsg::DescriptorBuffer::create(lights, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+                                                                         vsg::DescriptorBuffer::create(viewLights, 2, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+                                                                         vsg::DescriptorBuffer::create(lightCounts, 3, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+                                                                         vsg::DescriptorBuffer::create(lightIndices, 4, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)});
+    return _descriptorSet;
+}
+
+vsg::ref_ptr<vsg::Node> ClusteredLighting::createComputeCommands(vsg::ref_ptr<const vsg::Options> options)
+{
+    auto transformShader = vsg::read_cast<vsg::ShaderStage>("shaders/clustered_lights_transform.comp", options);
+    auto cullShader = vsg::read_cast<vsg::ShaderStage>("shaders/clustered_lights_cull.comp", options);
+    if (!transformShader || !cullShader) return {};
+
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, vsg::PushConstantRanges{});
+    auto transformPipeline = vsg::ComputePipeline::create(pipelineLayout, transformShader);
+    auto cullPipeline = vsg::ComputePipeline::create(pipelineLayout, cullShader);
+
+    uint32_t numClusters = numClustersX * numClustersY * numClustersZ;
+    uint32_t workgroupSize = 64;
+
+    auto commands = vsg::Commands::create();
+
+    // the previous frame's fragment shaders must have finished reading the clusters before they are rewritten
+    commands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, vsg::MemoryBarrier::create(VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT)));
+
+    commands->addChild(vsg::BindComputePipeline::create(transformPipeline));
+    commands->addChild(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, getOrCreateDescriptorSet()));
+    commands->addChild(vsg::Dispatch::create((numLights() + workgroupSize - 1) / workgroupSize, 1, 1));
+
+    commands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, vsg::MemoryBarrier::create(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT)));
+
+    // the pipelines share a layout so the descriptor set stays bound
+    commands->addChild(vsg::BindComputePipeline::create(cullPipeline));
+    commands->addChild(vsg::Dispatch::create((numClusters + workgroupSize - 1) / workgroupSize, 1, 1));
+
+    commands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, vsg::MemoryBarrier::create(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT)));
+
+    return commands;
+}
+
+void ClusteredLighting::assign(vsg::Node& scene)
+{
+    auto assignDescriptorSet = AssignDescriptorSet::create(getOrCreateDescriptorSet(), clusterDescriptorSet);
+    scene.accept(*assignDescriptorSet);
+
+    if (assignDescriptorSet->numAssigned == 0)
+    {
+        vsg::warn("ClusteredLighting::assign() no StateGroups with clustered lighting pipelines found.");
+    }
+}
+
+void ClusteredLighting::update(const vsg::Camera& camera)
+{
+    auto projectionMatrix = camera.projectionMatrix->transform();
+    auto viewport = camera.getViewport();
+
+    // the VSG's reverse depth perspective matrix has m[2][2] = n / (f - n) and m[3][2] = n * f / (f - n)
+    double nearDistance = projectionMatrix[3][2] / (1.0 + projectionMatrix[2][2]);
+    double farDistance = projectionMatrix[3][2] / projectionMatrix[2][2];
+
+    auto& params = _params->value();
+    params.viewMatrix = vsg::mat4(camera.viewMatrix->transform());
+    params.inverseProjectionMatrix = vsg::mat4(vsg::inverse(projectionMatrix));
+    params.viewport.set(viewport.x, viewport.y, viewport.width, viewport.height);
+    params.depthRange.set(static_cast<float>(nearDistance), static_cast<float>(farDistance), static_cast<float>(std::log(farDistance / nearDistance)), 0.0f);
+    _params->dirty();
+}
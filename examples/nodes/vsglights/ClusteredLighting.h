@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vsg/all.h>
+
+struct ClusterParams
+{
+    vsg::mat4 viewMatrix;
+    vsg::mat4 inverseProjectionMatrix;
+    vsg::vec4 viewport;   // x, y, width, height
+    vsg::vec4 depthRange; // near, far, log(far / near)
+    vsg::uivec4 counts;   // numClustersX, numClustersY, numClustersZ, numLights
+    vsg::uivec4 limits;   // maxLightsPerCluster
+};
+
+class ClusterParamsValue : public vsg::Inherit<vsg::Value<ClusterParams>, ClusterParamsValue>
+{
+public:
+    ClusterParamsValue() {}
+};
+
+// Clustered forward lighting for large numbers of point lights. Each frame a compute pass transforms the lights into
+// eye coordinates and bins them into view space froxel clusters, and the phong and pbr fragment shaders, compiled with
+// VSG_CLUSTERED_LIGHTING, light each fragment with only the lights listed for its cluster. The cluster data is bound
+// as descriptor set 2, alongside the material set 0 and the view's light data set 1 that still provide the other lights.
+//
+// Usage:
+//   1. assignShaderSets(options) before creating or loading the scene so it's built with the clustered ShaderSets,
+//   2. add() the point lights,
+//   3. assign() the cluster descriptor set to the scene and add createComputeCommands() to the CommandGraph ahead of the RenderGraph,
+//   4. update() with the View's Camera every frame before Viewer::update().
+class ClusteredLighting : public vsg::Inherit<vsg::Object, ClusteredLighting>
+{
+public:
+    static constexpr uint32_t clusterDescriptorSet = 2;
+
+    ClusteredLighting(uint32_t in_numClustersX = 16, uint32_t in_numClustersY = 9, uint32_t in_numClustersZ = 24, uint32_t in_maxLightsPerCluster = 128);
+
+    const uint32_t numClustersX;
+    const uint32_t numClustersY;
+    const uint32_t numClustersZ;
+    const uint32_t maxLightsPerCluster;
+
+    // lights are culled beyond the distance their contribution falls below the cutoff
+    float intensityCutoff = 1.0f / 256.0f;
+
+    vsg::ref_ptr<vsg::DescriptorSetLayout> descriptorSetLayout;
+
+    // replace the phong and pbr ShaderSets in options with clustered ones, returns false if the standard shaders aren't found
+    bool assignShaderSets(vsg::ref_ptr<vsg::Options> options);
+
+    // add a point light with the same attenuation as vsg::PointLight, call before createComputeCommands()
+    void add(const vsg::dvec3& position, const vsg::vec3& color, float intensity);
+    uint32_t numLights() const { return static_cast<uint32_t>(_lights.size() / 2); }
+
+    // barriers and dispatches binning the lights, returns null if the compute shaders can't be loaded
+    vsg::ref_ptr<vsg::Node> createComputeCommands(vsg::ref_ptr<const vsg::Options> options);
+
+    // bind the cluster descriptor set in each StateGroup with a pipeline built from a clustered ShaderSet
+    void assign(vsg::Node& scene);
+
+    // update the cluster parameters for the camera's view, projection and viewport
+    void update(const vsg::Camera& camera);
+
+protected:
+    std::vector<vsg::vec4> _lights; // pairs of position_radius, color_intensity
+    vsg::ref_ptr<ClusterParamsValue> _params;
+    vsg::ref_ptr<vsg::DescriptorSet> _descriptorSet;
+
+    vsg::DescriptorSetLayoutBindings descriptorBindings() const;
+    vsg::ref_ptr<vsg::DescriptorSet> getOrCreateDescriptorSet();
+};
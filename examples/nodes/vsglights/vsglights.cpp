@@ -4,7 +4,11 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "ClusteredLighting.h"
+#include "ShadowAtlas.h"
+
 #include <iostream>
+#include <random>
 
 vsg::ref_ptr<vsg::Node> createTestScene(vsg::ref_ptr<vsg::Options> options)
 {
@@ -83,6 +87,17 @@ int main(int argc, char** argv)
 
     auto outputFilename = arguments.value<std::string>("", "-o");
 
+    // stress test with many point lights, binned into view space clusters with --clustered so each fragment only
+    // iterates over the lights near it, rather than the standard shaders looping over every light for every fragment
+    auto numLights = arguments.value(0u, "--num-lights");
+    bool clustered = arguments.read("--clustered");
+
+    // shadows for the directional and spot lights, packed into tiles of one depth atlas with the far cascades cached between frames
+    bool shadows = arguments.read("--shadows");
+    auto atlasSize = arguments.value(4096u, "--shadow-atlas-size");
+    auto shadowTileSize = arguments.value(1024u, "--shadow-tile-size");
+    auto numCascades = arguments.value(4u, "--shadow-cascades");
+
     bool add_amient = true;
     bool add_directional = true;
     bool add_point = true;
@@ -96,6 +111,31 @@ int main(int argc, char** argv)
         add_spotlight = false;
     }
 
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+    // the clustered ShaderSets need to be in place before the scene is created so its pipelines are built with them
+    vsg::ref_ptr<ClusteredLighting> clusteredLighting;
+    if (clustered)
+    {
+        clusteredLighting = ClusteredLighting::create();
+        if (!clusteredLighting->assignShaderSets(options))
+        {
+            std::cout << "Could not read shaders/standard_phong.frag and shaders/standard_pbr.frag, please set VSG_FILE_PATH to the vsgExamples/data directory." << std::endl;
+            return 1;
+        }
+    }
+
+    vsg::ref_ptr<ShadowAtlas> shadowAtlas;
+    if (shadows)
+    {
+        shadowAtlas = ShadowAtlas::create(atlasSize, shadowTileSize, numCascades);
+        if (!shadowAtlas->assignShaderSets(options))
+        {
+            std::cout << "Could not read shaders/standard_phong.frag and shaders/standard_pbr.frag, please set VSG_FILE_PATH to the vsgExamples/data directory." << std::endl;
+            return 1;
+        }
+    }
+
     vsg::ref_ptr<vsg::Node> scene;
     if (argc>1)
     {
@@ -117,7 +157,7 @@ int main(int argc, char** argv)
     // compute the bounds of the scene graph to help position camera
     auto bounds = vsg::visit<vsg::ComputeBounds>(scene).bounds;
 
-    if (add_amient || add_directional || add_point || add_spotlight || add_headlight)
+    if (add_amient || add_directional || add_point || add_spotlight || add_headlight || numLights > 0)
     {
         auto span = vsg::length(bounds.max - bounds.min);
         auto group = vsg::Group::create();
@@ -142,6 +182,8 @@ int main(int argc, char** argv)
             directionalLight->intensity = 0.15;
             directionalLight->direction.set(0.0, -1.0, -1.0);
             group->addChild(directionalLight);
+
+            if (shadowAtlas) shadowAtlas->setDirectionalLight(directionalLight);
         }
 
         // point light
@@ -175,6 +217,8 @@ int main(int argc, char** argv)
             spotLight->innerAngle = vsg::radians(8.0);
             spotLight->outerAngle = vsg::radians(9.0);
 
+            if (shadowAtlas) shadowAtlas->addSpotLight(spotLight);
+
             // enable culling of the spot light by decorating with a CullGroup
             auto cullGroup = vsg::CullGroup::create();
             cullGroup->bound.center = spotLight->position;
@@ -205,6 +249,44 @@ int main(int argc, char** argv)
             group->addChild(absoluteTransform);
         }
 
+        if (numLights > 0)
+        {
+            // scatter the lights just above the scene, with intensities that give each a radius of influence of a few percent of the scene
+            std::mt19937 generator;
+            std::uniform_real_distribution<double> unit(0.0, 1.0);
+            double lightRadius = span * 0.05;
+            float intensityCutoff = clusteredLighting ? clusteredLighting->intensityCutoff : 1.0f / 256.0f;
+
+            auto lightGroup = vsg::Group::create();
+            for (uint32_t i = 0; i < numLights; ++i)
+            {
+                vsg::dvec3 position(bounds.min.x + (bounds.max.x - bounds.min.x) * unit(generator),
+                                    bounds.min.y + (bounds.max.y - bounds.min.y) * unit(generator),
+                                    bounds.min.z + (bounds.max.z - bounds.min.z + span * 0.1) * unit(generator));
+                vsg::vec3 color(static_cast<float>(unit(generator)), static_cast<float>(unit(generator)), 1.0f);
+                float intensity = static_cast<float>(intensityCutoff * lightRadius * lightRadius);
+
+                if (clusteredLighting)
+                {
+                    clusteredLighting->add(position, color, intensity);
+                }
+                else
+                {
+                    // the standard shaders' LightData only has room for the first few dozen of these
+                    auto pointLight = vsg::PointLight::create();
+                    pointLight->color = color;
+                    pointLight->intensity = intensity;
+                    pointLight->position = position;
+                    lightGroup->addChild(pointLight);
+                }
+            }
+
+            if (lightGroup->children.empty())
+                std::cout << "Clustered point lights = " << clusteredLighting->numLights() << std::endl;
+            else
+                group->addChild(lightGroup);
+        }
+
         scene = group;
     }
 
@@ -251,7 +333,30 @@ int main(int argc, char** argv)
     viewer->addEventHandler(vsg::Trackball::create(camera));
 
     auto renderGraph = vsg::RenderGraph::create(window, view);
-    auto commandGraph = vsg::CommandGraph::create(window, renderGraph);
+    auto commandGraph = vsg::CommandGraph::create(window);
+
+    if (clusteredLighting)
+    {
+        // bin the lights for this frame's view ahead of rendering it
+        auto computeCommands = clusteredLighting->createComputeCommands(options);
+        if (!computeCommands)
+        {
+            std::cout << "Could not read the shaders/clustered_lights_*.comp shaders." << std::endl;
+            return 1;
+        }
+
+        clusteredLighting->assign(*scene);
+        commandGraph->addChild(computeCommands);
+    }
+    if (shadowAtlas)
+    {
+        // render the shadow tiles ahead of the main view, which then only records the main pipelines of the StateSwitches
+        auto context = vsg::Context::create(window->getOrCreateDevice());
+        commandGraph->addChild(shadowAtlas->createCommands(*context, scene));
+        shadowAtlas->assign(*scene);
+        view->mask = shadowAtlas->mainMask;
+    }
+    commandGraph->addChild(renderGraph);
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     viewer->compile();
@@ -264,6 +369,8 @@ int main(int argc, char** argv)
     {
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
+        if (clusteredLighting) clusteredLighting->update(*camera);
+        if (shadowAtlas) shadowAtlas->update(*camera);
         viewer->update();
         viewer->recordAndSubmit();
         viewer->present();
@@ -277,5 +384,7 @@ int main(int argc, char** argv)
         std::cout << "Average frame rate = " << (numFramesCompleted / duration) << std::endl;
     }
 
+    if (shadowAtlas) shadowAtlas->report(std::cout);
+
     return 0;
 }
@@ -0,0 +1,352 @@
+#include "LODBuilder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+
+LODBuilder::LODBuilder(vsg::ref_ptr<const vsg::Options> in_options) :
+    options(in_options),
+    simplifier(QuadricSimplifier::create())
+{
+}
+
+void LODBuilder::_parallelFor(size_t count, const std::function<void(size_t)>& function) const
+{
+    size_t threads = numThreads > 0 ? numThreads : std::max(std::thread::hardware_concurrency(), 1u);
+    threads = std::min(threads, count);
+
+    std::atomic_size_t next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) function(i);
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; ++i) workers.emplace_back(worker);
+    worker();
+    for (auto& thread : workers) thread.join();
+}
+
+void LODBuilder::_split()
+{
+    _cells.clear();
+
+    size_t numTriangles = mesh.numTriangles();
+    std::vector<vsg::dvec3> centroids(numTriangles);
+    for (size_t t = 0; t < numTriangles; ++t)
+    {
+        const uint32_t* tri = &mesh.indices[t * 3];
+        centroids[t] = (vsg::dvec3(mesh.positions[tri[0]]) + vsg::dvec3(mesh.positions[tri[1]]) + vsg::dvec3(mesh.positions[tri[2]])) / 3.0;
+    }
+
+    Cell root;
+    root.triangles.resize(numTriangles);
+    std::iota(root.triangles.begin(), root.triangles.end(), 0);
+    for (auto& position : mesh.positions) root.box.add(vsg::dvec3(position));
+    _cells.push_back(std::move(root));
+
+    // breadth first, so cells are ordered by depth and children always follow their parent
+    for (uint32_t i = 0; i < _cells.size(); ++i)
+    {
+        if (_cells[i].triangles.size() <= maxTrianglesPerCell || _cells[i].depth >= maxDepth)
+        {
+            auto& leaf = _cells[i];
+            leaf.indices.reserve(leaf.triangles.size() * 3);
+            for (auto t : leaf.triangles)
+            {
+                leaf.indices.insert(leaf.indices.end(), &mesh.indices[t * 3], &mesh.indices[t * 3] + 3);
+                for (int c = 0; c < 3; ++c) leaf.extents.add(vsg::dvec3(mesh.positions[mesh.indices[t * 3 + c]]));
+            }
+            leaf.triangles = {};
+            continue;
+        }
+
+        auto box = _cells[i].box;
+        auto depth = _cells[i].depth + 1;
+        auto center = (box.min + box.max) * 0.5;
+
+        std::vector<uint32_t> octants[8];
+        for (auto t : _cells[i].triangles)
+        {
+            auto& c = centroids[t];
+            octants[(c.x >= center.x ? 1 : 0) | (c.y >= center.y ? 2 : 0) | (c.z >= center.z ? 4 : 0)].push_back(t);
+        }
+        _cells[i].triangles = {};
+
+        for (uint32_t octant = 0; octant < 8; ++octant)
+        {
+            if (octants[octant].empty()) continue;
+
+            Cell child;
+            child.depth = depth;
+            child.box.min.set((octant & 1) ? center.x : box.min.x, (octant & 2) ? center.y : box.min.y, (octant & 4) ? center.z : box.min.z);
+            child.box.max.set((octant & 1) ? box.max.x : center.x, (octant & 2) ? box.max.y : center.y, (octant & 4) ? box.max.z : center.z);
+            child.triangles = std::move(octants[octant]);
+
+            _cells[i].children.push_back(static_cast<uint32_t>(_cells.size()));
+            _cells.push_back(std::move(child));
+        }
+    }
+
+    // children follow their parents, so a reverse pass gathers the extents of inner cells from their children
+    for (auto itr = _cells.rbegin(); itr != _cells.rend(); ++itr)
+    {
+        for (auto child : itr->children) itr->extents.add(_cells[child].extents);
+
+        auto& extents = itr->extents;
+        if (extents.valid()) itr->bound = vsg::dsphere((extents.min + extents.max) * 0.5, vsg::length(extents.max - extents.min) * 0.5);
+    }
+}
+
+void LODBuilder::_simplify(Cell& cell)
+{
+    std::vector<uint32_t> indices;
+    double childError = 0.0;
+    for (auto child : cell.children)
+    {
+        auto& childCell = _cells[child];
+        indices.insert(indices.end(), childCell.indices.begin(), childCell.indices.end());
+        childError = std::max(childError, childCell.error);
+    }
+
+    auto simplified = simplifier->simplify(mesh.positions, indices, maxTrianglesPerCell);
+    cell.indices = std::move(simplified.indices);
+    cell.error = simplified.error + childError;
+}
+
+void LODBuilder::build()
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    _split();
+
+    numCells = _cells.size();
+    numLeafCells = 0;
+    numLevels = _cells.empty() ? 0 : _cells.back().depth + 1;
+
+    // simplify a level at a time, deepest first, so the children of every cell in a level are complete
+    for (size_t level = numLevels; level-- > 0;)
+    {
+        std::vector<uint32_t> cells;
+        for (uint32_t i = 0; i < _cells.size(); ++i)
+        {
+            if (_cells[i].depth == level && !_cells[i].children.empty()) cells.push_back(i);
+        }
+
+        _parallelFor(cells.size(), [&](size_t i) { _simplify(_cells[cells[i]]); });
+    }
+
+    numOutputTriangles = 0;
+    for (auto& cell : _cells)
+    {
+        if (cell.children.empty()) ++numLeafCells;
+        numOutputTriangles += cell.indices.size() / 3;
+    }
+
+    buildTime = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+double LODBuilder::_screenHeightRatio(const Cell& cell) const
+{
+    if (pixelError <= 0.0) return lodTransitionScreenHeightRatio;
+
+    // the ratio of an LOD child is compared against roughly the bound's diameter over the height of the view at its
+    // distance, while an error e covers e * referenceScreenHeight / viewHeight pixels, so the error reaches pixelError
+    // pixels once the ratio reaches 2r * pixelError / (e * referenceScreenHeight)
+    if (cell.error <= 0.0) return maximumScreenHeightRatio;
+
+    double ratio = 2.0 * cell.bound.radius * pixelError / (cell.error * referenceScreenHeight);
+    return std::clamp(ratio, minimumScreenHeightRatio, maximumScreenHeightRatio);
+}
+
+vsg::Path LODBuilder::_cellFilename(uint32_t cellIndex, const vsg::Path& extension) const
+{
+    return vsg::Path(vsg::make_string("cell_", cellIndex, extension.string()));
+}
+
+vsg::ref_ptr<vsg::Node> LODBuilder::_createGeometry(const std::vector<uint32_t>& indices) const
+{
+    // give each cell its own compact vertex arrays, indexed from the source vertices used by its triangles
+    std::unordered_map<uint32_t, uint32_t> localIndices;
+    std::vector<uint32_t> globalIndices;
+    std::vector<uint32_t> triangles(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        auto [itr, inserted] = localIndices.emplace(indices[i], static_cast<uint32_t>(globalIndices.size()));
+        if (inserted) globalIndices.push_back(indices[i]);
+        triangles[i] = itr->second;
+    }
+
+    auto numVertices = static_cast<uint32_t>(globalIndices.size());
+    auto vertices = vsg::vec3Array::create(numVertices);
+    auto normals = vsg::vec3Array::create(numVertices, vsg::vec3(0.0f, 0.0f, 0.0f));
+    for (uint32_t v = 0; v < numVertices; ++v) vertices->set(v, mesh.positions[globalIndices[v]]);
+
+    // area weighted normals of the cell's triangles, as simplified meshes can't reuse the normals of the source geometry
+    for (size_t i = 0; i + 2 < triangles.size(); i += 3)
+    {
+        auto n = vsg::cross(vertices->at(triangles[i + 1]) - vertices->at(triangles[i]), vertices->at(triangles[i + 2]) - vertices->at(triangles[i]));
+        for (int c = 0; c < 3; ++c) normals->at(triangles[i + c]) += n;
+    }
+    for (auto& n : *normals)
+    {
+        float length = vsg::length(n);
+        n = (length > 0.0f) ? n / length : vsg::vec3(0.0f, 0.0f, 1.0f);
+    }
+
+    vsg::ref_ptr<vsg::Data> colors;
+    if (mesh.colors.empty())
+    {
+        colors = vsg::vec4Value::create(vsg::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+    }
+    else
+    {
+        auto colorArray = vsg::vec4Array::create(numVertices);
+        for (uint32_t v = 0; v < numVertices; ++v) colorArray->set(v, mesh.colors[globalIndices[v]]);
+        colors = colorArray;
+    }
+
+    vsg::ref_ptr<vsg::Data> indexArray;
+    if (numVertices <= 65536)
+    {
+        auto ushortIndices = vsg::ushortArray::create(static_cast<uint32_t>(triangles.size()));
+        for (size_t i = 0; i < triangles.size(); ++i) ushortIndices->set(i, static_cast<uint16_t>(triangles[i]));
+        indexArray = ushortIndices;
+    }
+    else
+    {
+        indexArray = vsg::uintArray::create(static_cast<uint32_t>(triangles.size()));
+        std::copy(triangles.begin(), triangles.end(), static_cast<uint32_t*>(indexArray->dataPointer()));
+    }
+
+    auto vid = vsg::VertexIndexDraw::create();
+    vid->firstBinding = _firstBinding;
+    vid->assignArrays(vsg::DataList{vertices, normals, colors});
+    vid->assignIndices(indexArray);
+    vid->indexCount = static_cast<uint32_t>(triangles.size());
+    vid->instanceCount = 1;
+
+    return vid;
+}
+
+vsg::ref_ptr<vsg::Node> LODBuilder::_createCell(uint32_t cellIndex, bool paged, const vsg::Path& extension) const
+{
+    auto& cell = _cells[cellIndex];
+
+    if (cell.children.empty())
+    {
+        auto cullGroup = vsg::CullGroup::create();
+        cullGroup->bound = cell.bound;
+        cullGroup->addChild(_createGeometry(cell.indices));
+        return cullGroup;
+    }
+
+    double ratio = _screenHeightRatio(cell);
+
+    if (paged)
+    {
+        auto plod = vsg::PagedLOD::create();
+        plod->bound = cell.bound;
+        plod->children[0] = vsg::PagedLOD::Child{ratio, {}};                        // external child visible when it's bound occupies more than ratio of the height of the window
+        plod->children[1] = vsg::PagedLOD::Child{0.0, _createGeometry(cell.indices)}; // visible always
+        plod->filename = _cellFilename(cellIndex, extension);
+        return plod;
+    }
+
+    auto lod = vsg::LOD::create();
+    lod->bound = cell.bound;
+    lod->addChild(vsg::LOD::Child{ratio, _createChildren(cellIndex, paged, extension)});
+    lod->addChild(vsg::LOD::Child{0.0, _createGeometry(cell.indices)});
+    return lod;
+}
+
+vsg::ref_ptr<vsg::Node> LODBuilder::_createChildren(uint32_t cellIndex, bool paged, const vsg::Path& extension) const
+{
+    auto group = vsg::Group::create();
+    for (auto child : _cells[cellIndex].children) group->addChild(_createCell(child, paged, extension));
+    return group;
+}
+
+vsg::ref_ptr<vsg::Node> LODBuilder::_createRoot(bool paged, const vsg::Path& extension)
+{
+    if (_cells.empty()) return {};
+
+    // a single pipeline for the whole hierarchy, inherited by the cells as they are paged in
+    auto shaderSet = vsg::createPhongShaderSet(options);
+    auto config = vsg::GraphicsPipelineConfigurator::create(shaderSet);
+
+    auto material = vsg::PhongMaterialValue::create();
+    config->assignUniform("material", material);
+
+    vsg::DataList vertexArrays;
+    config->assignArray(vertexArrays, "vsg_Vertex", VK_VERTEX_INPUT_RATE_VERTEX, vsg::vec3Array::create(1));
+    config->assignArray(vertexArrays, "vsg_Normal", VK_VERTEX_INPUT_RATE_VERTEX, vsg::vec3Array::create(1));
+    if (mesh.colors.empty())
+        config->assignArray(vertexArrays, "vsg_Color", VK_VERTEX_INPUT_RATE_INSTANCE, vsg::vec4Value::create(vsg::vec4(1.0f, 1.0f, 1.0f, 1.0f)));
+    else
+        config->assignArray(vertexArrays, "vsg_Color", VK_VERTEX_INPUT_RATE_VERTEX, vsg::vec4Array::create(1));
+
+    config->init();
+    _firstBinding = config->baseAttributeBinding;
+
+    auto stateGroup = vsg::StateGroup::create();
+    config->copyTo(stateGroup);
+    stateGroup->addChild(_createCell(0, paged, extension));
+
+    // the cell positions are relative to the mesh origin to keep float precision
+    auto transform = vsg::MatrixTransform::create(vsg::translate(mesh.origin));
+    transform->addChild(stateGroup);
+    return transform;
+}
+
+vsg::ref_ptr<vsg::Node> LODBuilder::createScene()
+{
+    return _createRoot(false, {});
+}
+
+bool LODBuilder::write(const vsg::Path& filename)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    auto extension = vsg::lowerCaseFileExtension(filename);
+    auto root = _createRoot(true, extension);
+    if (!root) return false;
+
+    auto directory = vsg::filePath(filename);
+    if (!directory.empty()) vsg::makeDirectory(directory);
+
+    if (!vsg::write(root, filename, options)) return false;
+    ++numFilesWritten;
+
+    std::vector<uint32_t> innerCells;
+    for (uint32_t i = 0; i < _cells.size(); ++i)
+    {
+        if (!_cells[i].children.empty()) innerCells.push_back(i);
+    }
+
+    std::atomic_size_t numFailed{0};
+    _parallelFor(innerCells.size(), [&](size_t i) {
+        auto cellFilename = _cellFilename(innerCells[i], extension);
+        if (vsg::write(_createChildren(innerCells[i], true, extension), directory.empty() ? cellFilename : directory / cellFilename, options))
+            ++numFilesWritten;
+        else
+            ++numFailed;
+    });
+
+    writeTime = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - startTime).count();
+
+    return numFailed == 0;
+}
+
+void LODBuilder::report(std::ostream& out) const
+{
+    out << "LODBuilder" << std::endl;
+    out << "    source triangles " << mesh.numTriangles() << ", vertices " << mesh.positions.size() << std::endl;
+    out << "    cells " << numCells << ", leaf cells " << numLeafCells << ", levels " << numLevels << std::endl;
+    out << "    output triangles " << numOutputTriangles << std::endl;
+    out << "    collapses " << simplifier->numCollapses << ", rejected " << simplifier->numRejectedCollapses << std::endl;
+    if (!_cells.empty()) out << "    root error " << _cells.front().error << ", screen height ratio " << _screenHeightRatio(_cells.front()) << std::endl;
+    out << "    build time " << buildTime << "ms" << std::endl;
+    if (numFilesWritten > 0) out << "    files written " << numFilesWritten << " in " << writeTime << "ms" << std::endl;
+}
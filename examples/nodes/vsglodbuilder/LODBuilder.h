@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+#include "MeshCollector.h"
+#include "QuadricSimplifier.h"
+
+// Builds a level of detail hierarchy from a Mesh. The triangles are split into an octree until each leaf cell holds at
+// most maxTrianglesPerCell, then each level of inner cells, deepest first, is simplified in parallel from the meshes of
+// its children down to maxTrianglesPerCell. A cell's error is its own simplification error plus the largest error of
+// its children, so it bounds the distance of the cell's mesh from the original surface.
+//
+// Written out, the root file holds the shared state and a PagedLOD for the root cell, and each inner cell has a file
+// holding its children: leaf cells at full resolution and inner cells as PagedLOD with their simplified mesh as the
+// low resolution child. Cells only hold geometry, so tiles are cheap to page in and compile.
+class LODBuilder : public vsg::Inherit<vsg::Object, LODBuilder>
+{
+public:
+    explicit LODBuilder(vsg::ref_ptr<const vsg::Options> in_options);
+
+    vsg::ref_ptr<const vsg::Options> options;
+    vsg::ref_ptr<QuadricSimplifier> simplifier;
+    Mesh mesh;
+
+    // settings
+    size_t maxTrianglesPerCell = 65536;
+    uint32_t maxDepth = 8;
+    uint32_t numThreads = 0; // 0 to use std::thread::hardware_concurrency()
+
+    // screen height ratio a cell's children are paged in at, the same default as vsgpagedlod's TileReader
+    double lodTransitionScreenHeightRatio = 0.25;
+
+    // when non zero, compute each cell's ratio from its error instead, so its children are paged in before the error
+    // covers more than pixelError pixels on a screen referenceScreenHeight pixels high, clamped to the given range
+    double pixelError = 0.0;
+    double referenceScreenHeight = 1080.0;
+    double minimumScreenHeightRatio = 0.05;
+    double maximumScreenHeightRatio = 8.0;
+
+    // split mesh into cells and simplify them
+    void build();
+
+    // write the hierarchy to filename and a file per inner cell beside it, with the same extension
+    bool write(const vsg::Path& filename);
+
+    // create the hierarchy in memory, with vsg::LOD in place of the PagedLOD
+    vsg::ref_ptr<vsg::Node> createScene();
+
+    // statistics
+    size_t numCells = 0;
+    size_t numLeafCells = 0;
+    size_t numLevels = 0;
+    size_t numOutputTriangles = 0;
+    std::atomic_size_t numFilesWritten{0};
+    double buildTime = 0.0; // milliseconds
+    double writeTime = 0.0; // milliseconds
+
+    void report(std::ostream& out) const;
+
+protected:
+    struct Cell
+    {
+        uint32_t depth = 0;
+        vsg::dbox box;     // octant the cell splits
+        vsg::dbox extents; // extents of the cell's triangles
+        vsg::dsphere bound;
+        std::vector<uint32_t> triangles; // source triangles, only held while splitting
+        std::vector<uint32_t> children;
+        std::vector<uint32_t> indices; // full resolution for leaf cells, simplified for inner cells
+        double error = 0.0;
+    };
+
+    void _split();
+    void _simplify(Cell& cell);
+    void _parallelFor(size_t count, const std::function<void(size_t)>& function) const;
+
+    double _screenHeightRatio(const Cell& cell) const;
+    vsg::Path _cellFilename(uint32_t cellIndex, const vsg::Path& extension) const;
+
+    vsg::ref_ptr<vsg::Node> _createRoot(bool paged, const vsg::Path& extension);
+    vsg::ref_ptr<vsg::Node> _createCell(uint32_t cellIndex, bool paged, const vsg::Path& extension) const;
+    vsg::ref_ptr<vsg::Node> _createChildren(uint32_t cellIndex, bool paged, const vsg::Path& extension) const;
+    vsg::ref_ptr<vsg::Node> _createGeometry(const std::vector<uint32_t>& indices) const;
+
+    std::vector<Cell> _cells;
+    uint32_t _firstBinding = 0;
+};
@@ -0,0 +1,196 @@
+#include "MeshCollector.h"
+
+#include <algorithm>
+#include <cstring>
+
+size_t MeshCollector::PositionHash::operator()(const vsg::vec3& v) const
+{
+    uint32_t bits[3];
+    std::memcpy(bits, v.data(), sizeof(bits));
+    size_t seed = bits[0];
+    seed ^= bits[1] + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= bits[2] + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+}
+
+MeshCollector::MeshCollector()
+{
+    _matrixStack.push_back(vsg::dmat4());
+    _topologyStack.push_back(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+}
+
+void MeshCollector::apply(const vsg::Node& node)
+{
+    node.traverse(*this);
+}
+
+void MeshCollector::apply(const vsg::Transform& transform)
+{
+    _matrixStack.push_back(transform.transform(_matrixStack.back()));
+    transform.traverse(*this);
+    _matrixStack.pop_back();
+}
+
+void MeshCollector::apply(const vsg::LOD& lod)
+{
+    // the children are ordered from highest to lowest resolution
+    if (!lod.children.empty() && lod.children.front().node) lod.children.front().node->accept(*this);
+}
+
+void MeshCollector::apply(const vsg::PagedLOD& plod)
+{
+    // use the high resolution child if it's already loaded, otherwise the low resolution one
+    if (plod.children[0].node) plod.children[0].node->accept(*this);
+    else if (plod.children[1].node) plod.children[1].node->accept(*this);
+}
+
+void MeshCollector::apply(const vsg::StateGroup& stateGroup)
+{
+    auto topology = _topologyStack.back();
+    for (auto& stateCommand : stateGroup.stateCommands)
+    {
+        auto bindGraphicsPipeline = stateCommand->cast<vsg::BindGraphicsPipeline>();
+        if (!bindGraphicsPipeline || !bindGraphicsPipeline->pipeline) continue;
+
+        for (auto& pipelineState : bindGraphicsPipeline->pipeline->pipelineStates)
+        {
+            if (auto inputAssemblyState = pipelineState->cast<vsg::InputAssemblyState>()) topology = inputAssemblyState->topology;
+        }
+    }
+
+    _topologyStack.push_back(topology);
+    stateGroup.traverse(*this);
+    _topologyStack.pop_back();
+}
+
+MeshCollector::Arrays MeshCollector::_arrays(const vsg::BufferInfoList& arrays, const vsg::BufferInfo* indices) const
+{
+    // the vertices are taken to be the first array, as with the vsg::Builder and vsgXchange loaders, and the colors the
+    // first vec4Array with an entry per vertex
+    Arrays result;
+    if (arrays.empty() || !arrays[0] || !arrays[0]->data) return result;
+
+    result.vertices = arrays[0]->data.cast<vsg::vec3Array>();
+    if (!result.vertices) return result;
+
+    for (size_t i = 1; i < arrays.size() && !result.colors; ++i)
+    {
+        auto colors = arrays[i] ? arrays[i]->data.cast<vsg::vec4Array>() : vsg::ref_ptr<vsg::vec4Array>();
+        if (colors && colors->size() == result.vertices->size()) result.colors = colors;
+    }
+
+    if (indices) result.indices = indices->data;
+    return result;
+}
+
+void MeshCollector::apply(const vsg::Geometry& geometry)
+{
+    auto arrays = _arrays(geometry.arrays, geometry.indices.get());
+
+    for (auto& command : geometry.commands)
+    {
+        if (auto drawIndexed = command->cast<vsg::DrawIndexed>())
+        {
+            if (arrays.indices) _addTriangles(arrays, drawIndexed->firstIndex, drawIndexed->indexCount, drawIndexed->vertexOffset);
+            else ++numSkippedDraws;
+        }
+        else if (auto draw = command->cast<vsg::Draw>())
+        {
+            auto nonIndexed = arrays;
+            nonIndexed.indices = {};
+            _addTriangles(nonIndexed, draw->firstVertex, draw->vertexCount, 0);
+        }
+    }
+}
+
+void MeshCollector::apply(const vsg::VertexIndexDraw& vid)
+{
+    auto arrays = _arrays(vid.arrays, vid.indices.get());
+    if (arrays.indices) _addTriangles(arrays, vid.firstIndex, vid.indexCount, vid.vertexOffset);
+    else ++numSkippedDraws;
+}
+
+void MeshCollector::apply(const vsg::VertexDraw& vd)
+{
+    auto arrays = _arrays(vd.arrays, nullptr);
+    _addTriangles(arrays, vd.firstVertex, vd.vertexCount, 0);
+}
+
+uint32_t MeshCollector::_weld(const vsg::vec3& position, const vsg::vec4* color)
+{
+    auto [itr, inserted] = _welded.emplace(position, static_cast<uint32_t>(mesh.positions.size()));
+    if (!inserted) return itr->second;
+
+    mesh.positions.push_back(position);
+
+    // colors are only stored once some geometry has provided them, with white for the vertices before that
+    if (color && mesh.colors.empty()) mesh.colors.resize(mesh.positions.size() - 1, vsg::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+    if (!mesh.colors.empty()) mesh.colors.push_back(color ? *color : vsg::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+
+    return itr->second;
+}
+
+void MeshCollector::_addTriangles(const Arrays& arrays, uint32_t first, uint32_t count, int32_t vertexOffset)
+{
+    if (!arrays.vertices || _topologyStack.back() != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+    {
+        ++numSkippedDraws;
+        return;
+    }
+
+    ++numDraws;
+
+    auto& vertices = *arrays.vertices;
+    const auto& matrix = _matrixStack.back();
+
+    auto ushortIndices = arrays.indices.cast<vsg::ushortArray>();
+    auto uintIndices = arrays.indices.cast<vsg::uintArray>();
+    auto ubyteIndices = arrays.indices.cast<vsg::ubyteArray>();
+    if (arrays.indices && !ushortIndices && !uintIndices && !ubyteIndices)
+    {
+        ++numSkippedDraws;
+        return;
+    }
+
+    auto vertexIndex = [&](uint32_t i) -> int64_t {
+        if (ushortIndices) return static_cast<int64_t>(ushortIndices->at(i)) + vertexOffset;
+        if (uintIndices) return static_cast<int64_t>(uintIndices->at(i)) + vertexOffset;
+        if (ubyteIndices) return static_cast<int64_t>(ubyteIndices->at(i)) + vertexOffset;
+        return static_cast<int64_t>(i);
+    };
+
+    size_t numIndices = arrays.indices ? arrays.indices->valueCount() : vertices.size();
+    uint32_t end = std::min(first + count - (count % 3), static_cast<uint32_t>(numIndices));
+
+    for (uint32_t i = first; i + 3 <= end; i += 3)
+    {
+        uint32_t triangle[3];
+        bool valid = true;
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            auto index = vertexIndex(i + c);
+            if (index < 0 || index >= static_cast<int64_t>(vertices.size()))
+            {
+                valid = false;
+                break;
+            }
+
+            auto world = matrix * vsg::dvec3(vertices.at(static_cast<size_t>(index)));
+            if (!_hasOrigin)
+            {
+                mesh.origin = world;
+                _hasOrigin = true;
+            }
+
+            const vsg::vec4* color = arrays.colors ? &arrays.colors->at(static_cast<size_t>(index)) : nullptr;
+            triangle[c] = _weld(vsg::vec3(world - mesh.origin), color);
+        }
+
+        ++numSourceTriangles;
+
+        // welding can make triangles degenerate
+        if (!valid || triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) continue;
+
+        mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <unordered_map>
+#include <vector>
+
+// Triangle soup gathered from a scene graph, with vertices welded by position so triangles on either side of normal or
+// texture coordinate seams share vertices. Positions are relative to origin, the position of the first vertex, so they
+// keep float precision for geocentric or other large coordinate models.
+struct Mesh
+{
+    vsg::dvec3 origin;
+    std::vector<vsg::vec3> positions;
+    std::vector<vsg::vec4> colors; // empty unless some of the source geometry had per vertex colors
+    std::vector<uint32_t> indices; // triangle list
+
+    size_t numTriangles() const { return indices.size() / 3; }
+};
+
+// Collect the triangle lists of a scene graph into a Mesh, in world coordinates. Only the highest resolution child of
+// LOD nodes is used, PagedLOD external children aren't loaded, and draws with topologies other than triangle lists are
+// counted as skipped. Textures and materials aren't carried over, scans are typically untextured or vertex colored.
+class MeshCollector : public vsg::Inherit<vsg::ConstVisitor, MeshCollector>
+{
+public:
+    MeshCollector();
+
+    Mesh mesh;
+
+    // statistics
+    size_t numDraws = 0;
+    size_t numSkippedDraws = 0;
+    size_t numSourceTriangles = 0;
+
+    using vsg::ConstVisitor::apply;
+
+    void apply(const vsg::Node& node) override;
+    void apply(const vsg::Transform& transform) override;
+    void apply(const vsg::LOD& lod) override;
+    void apply(const vsg::PagedLOD& plod) override;
+    void apply(const vsg::StateGroup& stateGroup) override;
+    void apply(const vsg::Geometry& geometry) override;
+    void apply(const vsg::VertexIndexDraw& vid) override;
+    void apply(const vsg::VertexDraw& vd) override;
+
+protected:
+    struct Arrays
+    {
+        vsg::ref_ptr<vsg::vec3Array> vertices;
+        vsg::ref_ptr<vsg::vec4Array> colors;
+        vsg::ref_ptr<vsg::Data> indices;
+    };
+
+    Arrays _arrays(const vsg::BufferInfoList& arrays, const vsg::BufferInfo* indices) const;
+    void _addTriangles(const Arrays& arrays, uint32_t firstIndex, uint32_t count, int32_t vertexOffset);
+    uint32_t _weld(const vsg::vec3& position, const vsg::vec4* color);
+
+    struct PositionHash
+    {
+        size_t operator()(const vsg::vec3& v) const;
+    };
+
+    std::vector<vsg::dmat4> _matrixStack;
+    std::vector<VkPrimitiveTopology> _topologyStack;
+    std::unordered_map<vsg::vec3, uint32_t, PositionHash> _welded;
+    bool _hasOrigin = false;
+};
@@ -0,0 +1,255 @@
+#include "QuadricSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <queue>
+#include <unordered_map>
+
+namespace
+{
+    // symmetric 4x4 matrix summing the squared distances to a set of planes, stored as its upper triangle
+    struct Quadric
+    {
+        double q[10] = {};
+
+        static Quadric plane(const vsg::dvec3& n, double d)
+        {
+            return Quadric{{n.x * n.x, n.x * n.y, n.x * n.z, n.x * d, n.y * n.y, n.y * n.z, n.y * d, n.z * n.z, n.z * d, d * d}};
+        }
+
+        Quadric& operator+=(const Quadric& rhs)
+        {
+            for (int i = 0; i < 10; ++i) q[i] += rhs.q[i];
+            return *this;
+        }
+
+        double evaluate(const vsg::dvec3& p) const
+        {
+            return q[0] * p.x * p.x + 2.0 * q[1] * p.x * p.y + 2.0 * q[2] * p.x * p.z + 2.0 * q[3] * p.x +
+                   q[4] * p.y * p.y + 2.0 * q[5] * p.y * p.z + 2.0 * q[6] * p.y +
+                   q[7] * p.z * p.z + 2.0 * q[8] * p.z + q[9];
+        }
+    };
+
+    // collapse of the from vertex onto the to vertex, valid while neither vertex has changed since it was queued
+    struct Candidate
+    {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+        uint32_t fromVersion;
+        uint32_t toVersion;
+
+        // std::priority_queue pops the largest element, so order by descending cost to pop the cheapest collapse
+        bool operator<(const Candidate& rhs) const { return cost > rhs.cost; }
+    };
+
+    uint64_t edgeKey(uint32_t a, uint32_t b)
+    {
+        if (a > b) std::swap(a, b);
+        return (static_cast<uint64_t>(a) << 32) | b;
+    }
+} // namespace
+
+SimplifiedMesh QuadricSimplifier::simplify(const std::vector<vsg::vec3>& positions, const std::vector<uint32_t>& indices, size_t targetTriangles) const
+{
+    SimplifiedMesh result;
+
+    size_t numTriangles = indices.size() / 3;
+    if (numTriangles <= targetTriangles)
+    {
+        result.indices = indices;
+        return result;
+    }
+
+    // map the source vertices used by the input to a compact local range
+    std::unordered_map<uint32_t, uint32_t> localIndices;
+    std::vector<uint32_t> globalIndices;
+    std::vector<uint32_t> triangles(numTriangles * 3);
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        auto [itr, inserted] = localIndices.emplace(indices[i], static_cast<uint32_t>(globalIndices.size()));
+        if (inserted) globalIndices.push_back(indices[i]);
+        triangles[i] = itr->second;
+    }
+
+    size_t numVertices = globalIndices.size();
+    std::vector<vsg::dvec3> vertices(numVertices);
+    for (size_t v = 0; v < numVertices; ++v) vertices[v] = vsg::dvec3(positions[globalIndices[v]]);
+
+    std::vector<Quadric> quadrics(numVertices);
+    std::vector<std::vector<uint32_t>> vertexTriangles(numVertices);
+    std::unordered_map<uint64_t, uint32_t> edgeCounts;
+    for (uint32_t t = 0; t < numTriangles; ++t)
+    {
+        const uint32_t* tri = &triangles[t * 3];
+        auto n = vsg::cross(vertices[tri[1]] - vertices[tri[0]], vertices[tri[2]] - vertices[tri[0]]);
+        double length = vsg::length(n);
+        if (length > 0.0)
+        {
+            n /= length;
+            auto plane = Quadric::plane(n, -vsg::dot(n, vertices[tri[0]]));
+            for (int c = 0; c < 3; ++c) quadrics[tri[c]] += plane;
+        }
+
+        for (int c = 0; c < 3; ++c)
+        {
+            vertexTriangles[tri[c]].push_back(t);
+            ++edgeCounts[edgeKey(tri[c], tri[(c + 1) % 3])];
+        }
+    }
+
+    // lock the vertices of edges that aren't shared by exactly two triangles, the border of the input and any non manifold edges
+    std::vector<bool> locked(numVertices, false);
+    for (auto& [key, count] : edgeCounts)
+    {
+        if (count == 2) continue;
+        locked[static_cast<uint32_t>(key >> 32)] = true;
+        locked[static_cast<uint32_t>(key & 0xffffffff)] = true;
+    }
+
+    std::vector<uint32_t> versions(numVertices, 0);
+    std::vector<bool> removedVertices(numVertices, false);
+    std::vector<bool> removedTriangles(numTriangles, false);
+
+    // queue the cheaper of the two directions an edge can collapse in that moves an unlocked vertex
+    std::priority_queue<Candidate> candidates;
+    auto addCandidate = [&](uint32_t a, uint32_t b) {
+        if (locked[a] && locked[b]) return;
+
+        Quadric q = quadrics[a];
+        q += quadrics[b];
+
+        double costAB = locked[a] ? std::numeric_limits<double>::max() : q.evaluate(vertices[b]);
+        double costBA = locked[b] ? std::numeric_limits<double>::max() : q.evaluate(vertices[a]);
+        if (costAB <= costBA)
+            candidates.push(Candidate{costAB, a, b, versions[a], versions[b]});
+        else
+            candidates.push(Candidate{costBA, b, a, versions[b], versions[a]});
+    };
+
+    for (auto& [key, count] : edgeCounts) addCandidate(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key & 0xffffffff));
+
+    auto containsVertex = [&](uint32_t t, uint32_t v) {
+        const uint32_t* tri = &triangles[t * 3];
+        return tri[0] == v || tri[1] == v || tri[2] == v;
+    };
+
+    auto collectNeighbours = [&](uint32_t v, std::vector<uint32_t>& neighbours) {
+        neighbours.clear();
+        for (auto t : vertexTriangles[v])
+        {
+            if (removedTriangles[t]) continue;
+            for (int c = 0; c < 3; ++c)
+            {
+                if (triangles[t * 3 + c] != v) neighbours.push_back(triangles[t * 3 + c]);
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    };
+
+    size_t numLiveTriangles = numTriangles;
+    double maxCost = 0.0;
+    uint64_t localCollapses = 0;
+    uint64_t localRejected = 0;
+    std::vector<uint32_t> fromNeighbours, toNeighbours, shared;
+
+    while (numLiveTriangles > targetTriangles && !candidates.empty())
+    {
+        auto candidate = candidates.top();
+        candidates.pop();
+
+        if (removedVertices[candidate.from] || removedVertices[candidate.to] ||
+            versions[candidate.from] != candidate.fromVersion || versions[candidate.to] != candidate.toVersion) continue;
+
+        if (std::sqrt(std::max(candidate.cost, 0.0)) > maxError) break;
+
+        // the link condition, the end points may only share the neighbours opposite the edge or the surface becomes non manifold
+        collectNeighbours(candidate.from, fromNeighbours);
+        collectNeighbours(candidate.to, toNeighbours);
+        shared.clear();
+        std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(), std::back_inserter(shared));
+
+        size_t numEdgeTriangles = 0;
+        for (auto t : vertexTriangles[candidate.from])
+        {
+            if (!removedTriangles[t] && containsVertex(t, candidate.to)) ++numEdgeTriangles;
+        }
+
+        bool valid = shared.size() == numEdgeTriangles;
+
+        // the triangles that move with the collapsed vertex mustn't fold over or become degenerate
+        for (auto t : vertexTriangles[candidate.from])
+        {
+            if (!valid) break;
+            if (removedTriangles[t] || containsVertex(t, candidate.to)) continue;
+
+            const uint32_t* tri = &triangles[t * 3];
+            vsg::dvec3 p[3];
+            for (int c = 0; c < 3; ++c) p[c] = vertices[tri[c] == candidate.from ? candidate.to : tri[c]];
+
+            auto before = vsg::cross(vertices[tri[1]] - vertices[tri[0]], vertices[tri[2]] - vertices[tri[0]]);
+            auto after = vsg::cross(p[1] - p[0], p[2] - p[0]);
+            double beforeLength = vsg::length(before);
+            double afterLength = vsg::length(after);
+            if (afterLength == 0.0 || (beforeLength > 0.0 && vsg::dot(before, after) < minimumNormalDot * beforeLength * afterLength)) valid = false;
+        }
+
+        if (!valid)
+        {
+            ++localRejected;
+            continue;
+        }
+
+        // collapse, removing the triangles on the edge and moving the rest over to the kept vertex
+        for (auto t : vertexTriangles[candidate.from])
+        {
+            if (removedTriangles[t]) continue;
+
+            if (containsVertex(t, candidate.to))
+            {
+                removedTriangles[t] = true;
+                --numLiveTriangles;
+            }
+            else
+            {
+                uint32_t* tri = &triangles[t * 3];
+                for (int c = 0; c < 3; ++c)
+                {
+                    if (tri[c] == candidate.from) tri[c] = candidate.to;
+                }
+                vertexTriangles[candidate.to].push_back(t);
+            }
+        }
+
+        vertexTriangles[candidate.from].clear();
+        removedVertices[candidate.from] = true;
+        quadrics[candidate.to] += quadrics[candidate.from];
+        ++versions[candidate.to];
+
+        maxCost = std::max(maxCost, candidate.cost);
+        ++localCollapses;
+
+        auto& adjacent = vertexTriangles[candidate.to];
+        adjacent.erase(std::remove_if(adjacent.begin(), adjacent.end(), [&](uint32_t t) { return removedTriangles[t]; }), adjacent.end());
+
+        // requeue the edges of the kept vertex with its new quadric
+        collectNeighbours(candidate.to, toNeighbours);
+        for (auto n : toNeighbours) addCandidate(candidate.to, n);
+    }
+
+    numCollapses += localCollapses;
+    numRejectedCollapses += localRejected;
+
+    result.indices.reserve(numLiveTriangles * 3);
+    for (uint32_t t = 0; t < numTriangles; ++t)
+    {
+        if (removedTriangles[t]) continue;
+        for (int c = 0; c < 3; ++c) result.indices.push_back(globalIndices[triangles[t * 3 + c]]);
+    }
+    result.error = std::sqrt(std::max(maxCost, 0.0));
+
+    return result;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <limits>
+#include <vector>
+
+// A triangle list that indexes the vertices of the source Mesh, with the error of the simplification that produced it.
+struct SimplifiedMesh
+{
+    std::vector<uint32_t> indices;
+    double error = 0.0; // approximate distance of the simplified surface from its input
+
+    size_t numTriangles() const { return indices.size() / 3; }
+};
+
+// Quadric error metric edge collapse decimation, after Garland and Heckbert. Edges are collapsed onto one of their end
+// points rather than an optimal position so the simplified mesh only references source vertices, allowing the meshes
+// of neighbouring cells and levels to share a vertex array. Vertices on the boundary of the input are locked, so cells
+// simplified independently still meet without cracks, and collapses that would fold a triangle over are rejected.
+// The simplifier holds no per mesh state, so one instance can be shared by threads simplifying different cells.
+class QuadricSimplifier : public vsg::Inherit<vsg::Object, QuadricSimplifier>
+{
+public:
+    // stop simplifying once the error of the next collapse exceeds maxError
+    double maxError = std::numeric_limits<double>::max();
+
+    // reject collapses that rotate a triangle's normal further than this, as the cosine of the angle
+    double minimumNormalDot = 0.2;
+
+    // simplify the indexed triangles to targetTriangles or fewer, where allowed by the locked boundary and maxError
+    SimplifiedMesh simplify(const std::vector<vsg::vec3>& positions, const std::vector<uint32_t>& indices, size_t targetTriangles) const;
+
+    // statistics
+    mutable std::atomic_uint64_t numCollapses{0};
+    mutable std::atomic_uint64_t numRejectedCollapses{0};
+};
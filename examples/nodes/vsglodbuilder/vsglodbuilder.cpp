@@ -0,0 +1,163 @@
+#include <vsg/all.h>
+
+#ifdef vsgXchange_FOUND
+#    include <vsgXchange/all.h>
+#endif
+
+#include "LODBuilder.h"
+#include "MeshCollector.h"
+
+#include <iostream>
+
+// Builds a level of detail hierarchy for a large mesh, such as a scan or a photogrammetry model, that is too heavy to
+// draw in full. The triangles of the model are split into an octree of cells and simplified level by level with a
+// quadric error metric, then either written out as a PagedLOD database:
+//
+//     vsglodbuilder model.ply -o lod/model.vsgb
+//     VSG_FILE_PATH=lod vsgviewer lod/model.vsgb
+//
+// or, without an output file, viewed directly as an in memory vsg::LOD hierarchy. Use --view to view a written
+// database as it will be paged in, with -t or --pixel-error to set where the levels switch.
+int main(int argc, char** argv)
+{
+    // set up defaults and read command line arguments to override them
+    vsg::CommandLine arguments(&argc, argv);
+
+    // set up vsg::Options to pass in filepaths and ReaderWriter's and other IO related options to use when reading and writing files.
+    auto options = vsg::Options::create();
+    options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
+    options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
+
+#ifdef vsgXchange_all
+    // add vsgXchange's support for reading and writing 3rd party file formats
+    options->add(vsgXchange::all::create());
+#endif
+
+    arguments.read(options);
+
+    auto windowTraits = vsg::WindowTraits::create();
+    windowTraits->windowTitle = "vsglodbuilder";
+    windowTraits->debugLayer = arguments.read({"--debug", "-d"});
+    windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
+    if (arguments.read({"--fullscreen", "--fs"})) windowTraits->fullscreen = true;
+    if (arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height)) { windowTraits->fullscreen = false; }
+    auto numFrames = arguments.value(-1, "-f");
+    auto outputFilename = arguments.value(vsg::Path(), "-o");
+    bool view = arguments.read("--view");
+
+    auto builder = LODBuilder::create(options);
+    arguments.read("--threads", builder->numThreads);
+    arguments.read("--cell-triangles", builder->maxTrianglesPerCell);
+    arguments.read("--max-depth", builder->maxDepth);
+    arguments.read("-t", builder->lodTransitionScreenHeightRatio);
+    arguments.read("--pixel-error", builder->pixelError);
+    arguments.read("--screen-height", builder->referenceScreenHeight);
+    arguments.read("--max-error", builder->simplifier->maxError);
+
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+    if (argc <= 1)
+    {
+        std::cout << "Please specify a model to build the level of detail hierarchy from." << std::endl;
+        return 1;
+    }
+
+    vsg::Path filename = arguments[1];
+    auto model = vsg::read_cast<vsg::Node>(filename, options);
+    if (!model)
+    {
+        std::cout << "Unable to load file " << filename << std::endl;
+        return 1;
+    }
+
+    auto collector = MeshCollector::create();
+    model->accept(*collector);
+    model = {};
+
+    std::cout << "Collected " << collector->numSourceTriangles << " triangles from " << collector->numDraws << " draws";
+    if (collector->numSkippedDraws > 0) std::cout << ", skipped " << collector->numSkippedDraws << " draws that weren't indexed triangle lists";
+    std::cout << std::endl;
+
+    if (collector->mesh.numTriangles() == 0)
+    {
+        std::cout << "No triangles to build from." << std::endl;
+        return 1;
+    }
+
+    builder->mesh = std::move(collector->mesh);
+    builder->build();
+
+    vsg::ref_ptr<vsg::Node> scene;
+    if (!outputFilename.empty())
+    {
+        if (!builder->write(outputFilename))
+        {
+            std::cout << "Unable to write " << outputFilename << std::endl;
+            builder->report(std::cout);
+            return 1;
+        }
+
+        builder->report(std::cout);
+        if (!view) return 0;
+
+        // the cells are referenced relative to the root file
+        options->paths.insert(options->paths.begin(), vsg::filePath(outputFilename));
+        scene = vsg::read_cast<vsg::Node>(outputFilename, options);
+        if (!scene)
+        {
+            std::cout << "Unable to read back " << outputFilename << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        scene = builder->createScene();
+        builder->report(std::cout);
+    }
+
+    // create the viewer and assign window(s) to it
+    auto viewer = vsg::Viewer::create();
+    auto window = vsg::Window::create(windowTraits);
+    if (!window)
+    {
+        std::cout << "Could not create windows." << std::endl;
+        return 1;
+    }
+
+    viewer->addWindow(window);
+
+    // compute the bounds of the scene graph to help position camera
+    auto bounds = vsg::visit<vsg::ComputeBounds>(scene).bounds;
+    vsg::dvec3 centre = (bounds.min + bounds.max) * 0.5;
+    double radius = vsg::length(bounds.max - bounds.min) * 0.6;
+    double nearFarRatio = 0.0005;
+
+    // set up the camera
+    auto lookAt = vsg::LookAt::create(centre + vsg::dvec3(0.0, -radius * 3.5, 0.0), centre, vsg::dvec3(0.0, 0.0, 1.0));
+    auto perspective = vsg::Perspective::create(30.0, static_cast<double>(window->extent2D().width) / static_cast<double>(window->extent2D().height), nearFarRatio * radius, radius * 4.5);
+    auto camera = vsg::Camera::create(perspective, lookAt, vsg::ViewportState::create(window->extent2D()));
+
+    // add close handler to respond the close window button and pressing escape
+    viewer->addEventHandler(vsg::CloseHandler::create(viewer));
+    viewer->addEventHandler(vsg::Trackball::create(camera));
+
+    auto commandGraph = vsg::createCommandGraphForView(window, camera, scene);
+    viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
+
+    viewer->compile();
+
+    // rendering main loop
+    while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
+    {
+        // pass any events into EventHandlers assigned to the Viewer
+        viewer->handleEvents();
+
+        viewer->update();
+
+        viewer->recordAndSubmit();
+
+        viewer->present();
+    }
+
+    return 0;
+}
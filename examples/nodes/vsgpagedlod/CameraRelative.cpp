@@ -0,0 +1,61 @@
+#include "CameraRelative.h"
+
+#include <cmath>
+
+CameraRelativeOrigin::CameraRelativeOrigin(double in_bucketSize) :
+    bucketSize(in_bucketSize)
+{
+}
+
+void CameraRelativeOrigin::update(const vsg::ViewMatrix& in_viewMatrix)
+{
+    viewMatrix = in_viewMatrix.transform();
+
+    vsg::dvec3 eye = in_viewMatrix.inverse() * vsg::dvec3(0.0, 0.0, 0.0);
+    vsg::dvec3 bucketOrigin((std::floor(eye.x / bucketSize) + 0.5) * bucketSize,
+                            (std::floor(eye.y / bucketSize) + 0.5) * bucketSize,
+                            (std::floor(eye.z / bucketSize) + 0.5) * bucketSize);
+
+    if (generation == 0 || bucketOrigin != origin)
+    {
+        origin = bucketOrigin;
+        ++generation;
+        ++numOriginChanges;
+    }
+
+    viewOrigin = vsg::mat4(viewMatrix * vsg::translate(origin));
+}
+
+void CameraRelativeOrigin::report(std::ostream& out) const
+{
+    out << "camera relative bucketSize = " << bucketSize << ", numOriginChanges = " << numOriginChanges << ", numRebuilt = " << numRebuilt
+        << ", numCached = " << numCached << ", numFallback = " << numFallback << std::endl;
+}
+
+CameraRelativeTransform::CameraRelativeTransform(vsg::ref_ptr<CameraRelativeOrigin> in_origin, const vsg::dmat4& in_matrix) :
+    origin(in_origin),
+    matrix(in_matrix)
+{
+}
+
+vsg::dmat4 CameraRelativeTransform::transform(const vsg::dmat4& mv) const
+{
+    if (origin->generation == 0 || mv != origin->viewMatrix)
+    {
+        ++origin->numFallback;
+        return mv * matrix;
+    }
+
+    if (_generation != origin->generation)
+    {
+        _relative = vsg::mat4(vsg::translate(-origin->origin) * matrix);
+        _generation = origin->generation;
+        ++origin->numRebuilt;
+    }
+    else
+    {
+        ++origin->numCached;
+    }
+
+    return vsg::dmat4(origin->viewOrigin * _relative);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <ostream>
+
+// Origin near the camera's eye point that tiles using a CameraRelativeTransform are positioned relative to.
+// The origin moves in steps of bucketSize as the eye moves, and each time it moves the tiles rebuild their relative
+// matrices. Between moves each tile's matrix is combined with the view in single precision, which is accurate for the
+// tiles near the camera where precision matters as both translations are then small.
+class CameraRelativeOrigin : public vsg::Inherit<vsg::Object, CameraRelativeOrigin>
+{
+public:
+    explicit CameraRelativeOrigin(double in_bucketSize = 1000.0);
+
+    const double bucketSize;
+
+    // call once per frame before recordAndSubmit() with the ViewMatrix the tiles will be recorded with
+    void update(const vsg::ViewMatrix& viewMatrix);
+
+    vsg::dmat4 viewMatrix; // as passed to update(), tiles recorded with any other modelview fall back to double precision
+    vsg::mat4 viewOrigin;  // viewMatrix * translate(origin)
+    vsg::dvec3 origin;
+    uint64_t generation = 0; // incremented each time origin moves, 0 until the first update()
+
+    // statistics
+    uint64_t numOriginChanges = 0;
+    mutable std::atomic_uint64_t numRebuilt{0};  // tile matrices rebuilt for a new origin or tile
+    mutable std::atomic_uint64_t numCached{0};   // tile matrices reused from a previous frame
+    mutable std::atomic_uint64_t numFallback{0}; // transforms computed in double precision
+
+    void report(std::ostream& out) const;
+};
+
+// Transform used in place of a vsg::MatrixTransform for a tile's local to world matrix. When recorded with the
+// CameraRelativeOrigin's view the tile's matrix relative to the origin, cached in single precision until the origin
+// moves, is combined with the view's origin relative matrix. Other traversals, such as intersections or views other
+// than the one the origin is updated from, get the full double precision transform.
+// The cache is written during record so a tile shouldn't be recorded by several threads at once.
+class CameraRelativeTransform : public vsg::Inherit<vsg::Transform, CameraRelativeTransform>
+{
+public:
+    CameraRelativeTransform(vsg::ref_ptr<CameraRelativeOrigin> in_origin, const vsg::dmat4& in_matrix);
+
+    vsg::ref_ptr<CameraRelativeOrigin> origin;
+    vsg::dmat4 matrix;
+
+    vsg::dmat4 transform(const vsg::dmat4& mv) const override;
+
+protected:
+    mutable uint64_t _generation = 0;
+    mutable vsg::mat4 _relative;
+};
@@ -0,0 +1,432 @@
+#include "TilePackCache.h"
+#include "AtomicSave.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// MappedFile
+//
+bool MappedFile::open(const vsg::Path& filename)
+{
+    close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(filename.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    _data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!_data)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    _fileHandle = file;
+    _mappingHandle = mapping;
+    _size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(filename.string().c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) return false;
+
+    _data = static_cast<const uint8_t*>(ptr);
+    _size = static_cast<std::size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (!_data) return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(_data);
+    CloseHandle(_mappingHandle);
+    CloseHandle(_fileHandle);
+    _mappingHandle = nullptr;
+    _fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+
+    _data = nullptr;
+    _size = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// BC1 compression
+//
+namespace
+{
+    struct RGB
+    {
+        int r, g, b;
+    };
+
+    uint16_t toRGB565(const RGB& c)
+    {
+        auto quantize = [](int v, int maxValue) { return (v * maxValue + 127) / 255; };
+        return static_cast<uint16_t>((quantize(c.r, 31) << 11) | (quantize(c.g, 63) << 5) | quantize(c.b, 31));
+    }
+
+    RGB fromRGB565(uint16_t v)
+    {
+        int r = (v >> 11) & 31;
+        int g = (v >> 5) & 63;
+        int b = v & 31;
+        return RGB{(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+    }
+
+    uint64_t compressBlock(const RGB texels[16])
+    {
+        // bounding box of the block's colours, inset slightly to reduce the error of the end points
+        RGB minColor{255, 255, 255}, maxColor{0, 0, 0};
+        for (int i = 0; i < 16; ++i)
+        {
+            minColor = RGB{std::min(minColor.r, texels[i].r), std::min(minColor.g, texels[i].g), std::min(minColor.b, texels[i].b)};
+            maxColor = RGB{std::max(maxColor.r, texels[i].r), std::max(maxColor.g, texels[i].g), std::max(maxColor.b, texels[i].b)};
+        }
+
+        RGB inset{(maxColor.r - minColor.r) / 16, (maxColor.g - minColor.g) / 16, (maxColor.b - minColor.b) / 16};
+        minColor = RGB{std::min(minColor.r + inset.r, 255), std::min(minColor.g + inset.g, 255), std::min(minColor.b + inset.b, 255)};
+        maxColor = RGB{std::max(maxColor.r - inset.r, 0), std::max(maxColor.g - inset.g, 0), std::max(maxColor.b - inset.b, 0)};
+
+        uint16_t color0 = toRGB565(maxColor);
+        uint16_t color1 = toRGB565(minColor);
+
+        // color0 > color1 selects the opaque four colour mode
+        if (color0 < color1) std::swap(color0, color1);
+        if (color0 == color1) return uint64_t(color0) | (uint64_t(color1) << 16);
+
+        RGB palette[4];
+        palette[0] = fromRGB565(color0);
+        palette[1] = fromRGB565(color1);
+        palette[2] = RGB{(2 * palette[0].r + palette[1].r) / 3, (2 * palette[0].g + palette[1].g) / 3, (2 * palette[0].b + palette[1].b) / 3};
+        palette[3] = RGB{(palette[0].r + 2 * palette[1].r) / 3, (palette[0].g + 2 * palette[1].g) / 3, (palette[0].b + 2 * palette[1].b) / 3};
+
+        uint32_t indices = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            int bestIndex = 0;
+            int bestDistance = std::numeric_limits<int>::max();
+            for (int p = 0; p < 4; ++p)
+            {
+                int dr = texels[i].r - palette[p].r;
+                int dg = texels[i].g - palette[p].g;
+                int db = texels[i].b - palette[p].b;
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestIndex = p;
+                }
+            }
+            indices |= uint32_t(bestIndex) << (2 * i);
+        }
+
+        return uint64_t(color0) | (uint64_t(color1) << 16) | (uint64_t(indices) << 32);
+    }
+
+    bool isSRGB(VkFormat format)
+    {
+        return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB;
+    }
+} // namespace
+
+vsg::ref_ptr<vsg::Data> TilePackCache::compressBC1(const vsg::Data& data)
+{
+    auto rgba = dynamic_cast<const vsg::ubvec4Array2D*>(&data);
+    auto rgb = dynamic_cast<const vsg::ubvec3Array2D*>(&data);
+    if (!rgba && !rgb) return {};
+
+    uint32_t width = data.width();
+    uint32_t height = data.height();
+    if (width == 0 || height == 0) return {};
+
+    auto texel = [&](uint32_t c, uint32_t r) -> RGB {
+        c = std::min(c, width - 1);
+        r = std::min(r, height - 1);
+        if (rgba)
+        {
+            auto& v = rgba->at(c, r);
+            return RGB{v.r, v.g, v.b};
+        }
+        auto& v = rgb->at(c, r);
+        return RGB{v.r, v.g, v.b};
+    };
+
+    uint32_t blocksWide = (width + 3) / 4;
+    uint32_t blocksHigh = (height + 3) / 4;
+
+    vsg::Data::Properties properties;
+    properties.format = isSRGB(data.properties.format) ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    properties.blockWidth = 4;
+    properties.blockHeight = 4;
+    properties.origin = data.properties.origin;
+
+    auto compressed = vsg::block64Array2D::create(blocksWide, blocksHigh, properties);
+
+    RGB texels[16];
+    for (uint32_t br = 0; br < blocksHigh; ++br)
+    {
+        for (uint32_t bc = 0; bc < blocksWide; ++bc)
+        {
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                texels[i] = texel(bc * 4 + (i % 4), br * 4 + (i / 4));
+            }
+
+            uint64_t block = compressBlock(texels);
+            std::memcpy(&(compressed->at(bc, br)), &block, sizeof(uint64_t));
+        }
+    }
+
+    return compressed;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// TilePackCache
+//
+TilePackCache::TilePackCache(const vsg::Path& in_directory, uint32_t in_levelsPerPack) :
+    directory(in_directory),
+    levelsPerPack(std::max(in_levelsPerPack, 1u))
+{
+}
+
+vsg::Path TilePackCache::packFilename(uint32_t packIndex) const
+{
+    uint32_t minLevel = packIndex * levelsPerPack;
+    uint32_t maxLevel = minLevel + levelsPerPack - 1;
+    return directory / vsg::make_string("tiles_", minLevel, "-", maxLevel, ".vsgtpak");
+}
+
+void TilePackCache::openPack(uint32_t packIndex, Pack& pack) const
+{
+    pack.index = nullptr;
+    pack.numEntries = 0;
+
+    if (!pack.file.open(packFilename(packIndex))) return;
+
+    // validate the header and index fit in the file before using them
+    Header header;
+    if (pack.file.size() < sizeof(Header)) return;
+    std::memcpy(&header, pack.file.data(), sizeof(Header));
+
+    Header expected;
+    if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version ||
+        header.indexOffset + uint64_t(header.numEntries) * sizeof(IndexEntry) > pack.file.size())
+    {
+        vsg::warn("TilePackCache: ignoring invalid pack ", packFilename(packIndex));
+        pack.file.close();
+        return;
+    }
+
+    pack.index = reinterpret_cast<const IndexEntry*>(pack.file.data() + header.indexOffset);
+    pack.numEntries = header.numEntries;
+}
+
+TilePackCache::Pack& TilePackCache::getPack(uint32_t level) const
+{
+    uint32_t packIndex = level / levelsPerPack;
+    auto& pack = _packs[packIndex];
+    if (!pack)
+    {
+        pack.reset(new Pack);
+        openPack(packIndex, *pack);
+    }
+    return *pack;
+}
+
+vsg::ref_ptr<vsg::Data> TilePackCache::createData(const IndexEntry& entry, const uint8_t* payload)
+{
+    uint32_t blocksWide = (entry.width + 3) / 4;
+    uint32_t blocksHigh = (entry.height + 3) / 4;
+    if (uint64_t(blocksWide) * blocksHigh * sizeof(vsg::block64) != entry.size) return {};
+
+    vsg::Data::Properties properties;
+    properties.format = static_cast<VkFormat>(entry.format);
+    properties.blockWidth = 4;
+    properties.blockHeight = 4;
+    properties.origin = vsg::TOP_LEFT;
+
+    auto data = vsg::block64Array2D::create(blocksWide, blocksHigh, properties);
+    std::memcpy(data->dataPointer(), payload, entry.size);
+    return data;
+}
+
+vsg::ref_ptr<vsg::Data> TilePackCache::read(uint32_t x, uint32_t y, uint32_t level) const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    auto& pack = getPack(level);
+
+    TileKey key(level, y, x);
+    if (auto itr = pack.pending.find(key); itr != pack.pending.end())
+    {
+        return createData(itr->second.entry, itr->second.payload.data());
+    }
+
+    if (!pack.index) return {};
+
+    auto end = pack.index + pack.numEntries;
+    auto itr = std::lower_bound(pack.index, end, key, [](const IndexEntry& entry, const TileKey& k) {
+        return TileKey(entry.level, entry.y, entry.x) < k;
+    });
+
+    if (itr == end || TileKey(itr->level, itr->y, itr->x) != key) return {};
+    if (itr->offset + itr->size > pack.file.size()) return {};
+
+    return createData(*itr, pack.file.data() + itr->offset);
+}
+
+bool TilePackCache::write(uint32_t x, uint32_t y, uint32_t level, const vsg::Data& data)
+{
+    auto compressed = compressBC1(data);
+    if (!compressed) return false;
+
+    // payloads are always stored with a top left origin so flip the rows of blocks if required.
+    uint32_t blocksWide = compressed->width();
+    uint32_t blocksHigh = compressed->height();
+    const uint8_t* blocks = static_cast<const uint8_t*>(compressed->dataPointer());
+
+    Pending pending;
+    pending.entry.level = level;
+    pending.entry.y = y;
+    pending.entry.x = x;
+    pending.entry.format = compressed->properties.format;
+    pending.entry.width = data.width();
+    pending.entry.height = data.height();
+    pending.entry.size = compressed->dataSize();
+    pending.payload.resize(compressed->dataSize());
+
+    std::size_t rowSize = blocksWide * sizeof(vsg::block64);
+    for (uint32_t br = 0; br < blocksHigh; ++br)
+    {
+        uint32_t sourceRow = (data.properties.origin == vsg::TOP_LEFT) ? br : (blocksHigh - 1 - br);
+        std::memcpy(pending.payload.data() + br * rowSize, blocks + sourceRow * rowSize, rowSize);
+    }
+
+    if (data.properties.origin != vsg::TOP_LEFT)
+    {
+        // flipping whole rows of blocks also requires reversing the rows of texels within each block
+        for (std::size_t i = 0; i < pending.payload.size(); i += sizeof(vsg::block64))
+        {
+            uint8_t* block = pending.payload.data() + i;
+            std::swap(block[4], block[7]);
+            std::swap(block[5], block[6]);
+        }
+    }
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    getPack(level).pending[TileKey(level, y, x)] = std::move(pending);
+
+    return true;
+}
+
+void TilePackCache::flush()
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    if (!_packs.empty()) vsg::makeDirectory(directory);
+
+    for (auto& [packIndex, pack] : _packs)
+    {
+        if (pack->pending.empty()) continue;
+
+        // merge the existing entries with the new ones, new ones take precedence
+        std::map<TileKey, std::pair<IndexEntry, const uint8_t*>> entries;
+        for (uint32_t i = 0; i < pack->numEntries; ++i)
+        {
+            auto& entry = pack->index[i];
+            entries[TileKey(entry.level, entry.y, entry.x)] = {entry, pack->file.data() + entry.offset};
+        }
+        for (auto& [key, pending] : pack->pending)
+        {
+            entries[key] = {pending.entry, pending.payload.data()};
+        }
+
+        auto filename = packFilename(packIndex);
+        auto tempFilename = experimental::temporaryFilename(filename);
+
+        {
+            std::ofstream fout(tempFilename.string(), std::ios::out | std::ios::binary);
+            if (!fout)
+            {
+                vsg::warn("TilePackCache: unable to write ", tempFilename);
+                continue;
+            }
+
+            Header header;
+            fout.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+            std::vector<IndexEntry> index;
+            index.reserve(entries.size());
+
+            uint64_t offset = sizeof(Header);
+            for (auto& [key, value] : entries)
+            {
+                IndexEntry entry = value.first;
+                entry.offset = offset;
+                fout.write(reinterpret_cast<const char*>(value.second), static_cast<std::streamsize>(entry.size));
+                offset += entry.size;
+                index.push_back(entry);
+            }
+
+            header.numEntries = static_cast<uint32_t>(index.size());
+            header.indexOffset = offset;
+            fout.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(IndexEntry)));
+
+            fout.seekp(0);
+            fout.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        }
+
+        // replace the old pack and map the new one, unmapping it first as a mapped file can't be replaced on Windows
+        pack->file.close();
+        experimental::replaceFile(tempFilename, filename);
+
+        pack->pending.clear();
+        openPack(packIndex, *pack);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// Read only memory mapping of a file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const vsg::Path& filename);
+    void close();
+
+    const uint8_t* data() const { return _data; }
+    std::size_t size() const { return _size; }
+
+protected:
+    const uint8_t* _data = nullptr;
+    std::size_t _size = 0;
+#if defined(_WIN32)
+    void* _fileHandle = nullptr;
+    void* _mappingHandle = nullptr;
+#endif
+};
+
+// Cache of GPU ready, block compressed tiles, stored as one pack file per range of levels.
+// Each pack holds a sorted (level, y, x) index that is memory mapped along with the payloads, so a cold start only needs to
+// map the packs and copy each tile's blocks rather than open, read and decode an image file per tile.
+// Tiles are compressed to BC1 when written, new tiles are held in memory until flush() merges them into the packs on disk.
+class TilePackCache : public vsg::Inherit<vsg::Object, TilePackCache>
+{
+public:
+    TilePackCache(const vsg::Path& in_directory, uint32_t in_levelsPerPack = 4);
+
+    const vsg::Path directory;
+    const uint32_t levelsPerPack;
+
+    // return the block compressed tile, or null if it isn't in the cache.
+    vsg::ref_ptr<vsg::Data> read(uint32_t x, uint32_t y, uint32_t level) const;
+
+    // compress and add a tile to the cache, returns false if the tile's format isn't supported.
+    bool write(uint32_t x, uint32_t y, uint32_t level, const vsg::Data& data);
+
+    // write packs with new tiles to disk, merging with their existing contents.
+    void flush();
+
+    // compress an 8 bit RGB or RGBA image to BC1, returns null if the format isn't supported.
+    static vsg::ref_ptr<vsg::Data> compressBC1(const vsg::Data& data);
+
+    struct Header
+    {
+        char magic[8] = {'v', 's', 'g', 't', 'p', 'a', 'k', '\0'};
+        uint32_t version = 1;
+        uint32_t numEntries = 0;
+        uint64_t indexOffset = 0;
+    };
+
+    struct IndexEntry
+    {
+        uint32_t level = 0;
+        uint32_t y = 0;
+        uint32_t x = 0;
+        uint32_t format = 0; // VkFormat of the payload
+        uint32_t width = 0;  // in texels
+        uint32_t height = 0; // in texels
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+protected:
+    using TileKey = std::tuple<uint32_t, uint32_t, uint32_t>; // level, y, x
+
+    struct Pending
+    {
+        IndexEntry entry;
+        std::vector<uint8_t> payload;
+    };
+
+    struct Pack
+    {
+        MappedFile file;
+        const IndexEntry* index = nullptr;
+        uint32_t numEntries = 0;
+        std::map<TileKey, Pending> pending;
+    };
+
+    Pack& getPack(uint32_t level) const;
+    vsg::Path packFilename(uint32_t packIndex) const;
+    void openPack(uint32_t packIndex, Pack& pack) const;
+    static vsg::ref_ptr<vsg::Data> createData(const IndexEntry& entry, const uint8_t* payload);
+
+    mutable std::mutex _mutex;
+    mutable std::map<uint32_t, std::unique_ptr<Pack>> _packs;
+};
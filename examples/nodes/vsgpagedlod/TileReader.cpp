@@ -1,5 +1,88 @@
 #include "TileReader.h"
 
+// vertex shader used by gpuTerrain, displaces the shared grid by the tile's height field and projects it onto the ellipsoid.
+// Positions are computed as offsets from the tile centre using small angle forms, so single precision is sufficient for deep tiles.
+static char terrain_vert[] = R"(
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+    mat4 modelview;
+} pc;
+
+layout(binding = 1) uniform sampler2D heightSampler;
+
+// [0-2] world to local rotation, [3] longitude and latitude offsets from the tile centre, [4] sin/cos of centre latitude and longitude,
+// [5] centre radii, equator radius and eccentricity squared, [6] spherical mercator, centre mercator latitude, centre height,
+// [7] texture and height field origins
+layout(binding = 2) uniform TileParameters {
+    vec4 p[8];
+} tile;
+
+layout(location = 0) in vec2 inGrid;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    float dLon = mix(tile.p[3].x, tile.p[3].y, inGrid.x);
+    float dLat = mix(tile.p[3].z, tile.p[3].w, inGrid.y);
+    if (tile.p[6].x > 0.5)
+    {
+        // difference of Gudermannian functions, atan(sinh(n)) - atan(sinh(nc))
+        float nc = tile.p[6].y;
+        dLat = atan(2.0 * cosh(nc + 0.5 * dLat) * sinh(0.5 * dLat), 1.0 + sinh(nc + dLat) * sinh(nc));
+    }
+
+    float sinLatC = tile.p[4].x;
+    float cosLatC = tile.p[4].y;
+    float sinLonC = tile.p[4].z;
+    float cosLonC = tile.p[4].w;
+
+    float versLat = 2.0 * sin(0.5 * dLat) * sin(0.5 * dLat);
+    float versLon = 2.0 * sin(0.5 * dLon) * sin(0.5 * dLon);
+    float dCosLat = -cosLatC * versLat - sinLatC * sin(dLat);
+    float dSinLat = -sinLatC * versLat + cosLatC * sin(dLat);
+    float dCosLon = -cosLonC * versLon - sinLonC * sin(dLon);
+    float dSinLon = -sinLonC * versLon + cosLonC * sin(dLon);
+    float cosLat = cosLatC + dCosLat;
+    float sinLat = sinLatC + dSinLat;
+    float cosLon = cosLonC + dCosLon;
+    float sinLon = sinLonC + dSinLon;
+
+    // change in the prime vertical radius of curvature, N = a / sqrt(1 - e2 * sinLat^2)
+    float a = tile.p[5].z;
+    float e2 = tile.p[5].w;
+    float fc = inversesqrt(1.0 - e2 * sinLatC * sinLatC);
+    float f = inversesqrt(1.0 - e2 * sinLat * sinLat);
+    float dN = a * (e2 * dSinLat * (2.0 * sinLatC + dSinLat) * f * f * fc * fc) / (f + fc);
+
+    vec2 heightSize = vec2(textureSize(heightSampler, 0));
+    vec2 heightCoord = vec2(inGrid.x, tile.p[7].y > 0.5 ? 1.0 - inGrid.y : inGrid.y);
+    float dh = texture(heightSampler, (heightCoord * (heightSize - 1.0) + 0.5) / heightSize).r - tile.p[6].z;
+
+    float dR = dN + dh;
+    float dRz = dN * (1.0 - e2) + dh;
+    float Rc = tile.p[5].x;
+    float RzC = tile.p[5].y;
+
+    vec3 offset = vec3(dR * cosLat * cosLon + Rc * (dCosLat * cosLonC + cosLatC * dCosLon + dCosLat * dCosLon),
+                       dR * cosLat * sinLon + Rc * (dCosLat * sinLonC + cosLatC * dSinLon + dCosLat * dSinLon),
+                       dRz * sinLat + RzC * dSinLat);
+
+    vec3 position = mat3(tile.p[0].xyz, tile.p[1].xyz, tile.p[2].xyz) * offset;
+
+    gl_Position = (pc.projection * pc.modelview) * vec4(position, 1.0);
+    fragColor = vec3(1.0, 1.0, 1.0);
+    fragTexCoord = vec2(inGrid.x, tile.p[7].x > 0.5 ? 1.0 - inGrid.y : inGrid.y);
+}
+)";
+
 vsg::dvec3 TileReader::computeLatitudeLongitudeAltitude(const vsg::dvec3& src) const
 {
     if (projection == "EPSG:3857" || projection == "spherical-mercator")
@@ -87,7 +170,13 @@ vsg::ref_ptr<vsg::Object> TileReader::read_root(vsg::ref_ptr<const vsg::Options>
             auto imagePath = getTilePath(imageLayer, x, y, lod);
             //auto terrainPath = getTilePath(terrainLayer, x, y, lod);
 
-            auto imageTile = vsg::read_cast<vsg::Data>(imagePath, options);
+            vsg::ref_ptr<vsg::Data> imageTile;
+            if (tilePack) imageTile = tilePack->read(x, y, lod);
+            if (!imageTile)
+            {
+                imageTile = vsg::read_cast<vsg::Data>(imagePath, options);
+                if (tilePack && imageTile) tilePack->write(x, y, lod, *imageTile);
+            }
             //auto terrainTile = vsg::read(terrainPath, options);
 
             if (imageTile)
@@ -96,19 +185,10 @@ vsg::ref_ptr<vsg::Object> TileReader::read_root(vsg::ref_ptr<const vsg::Options>
                 auto tile = createTile(tile_extents, imageTile);
                 if (tile)
                 {
-                    vsg::ComputeBounds computeBound;
-                    tile->accept(computeBound);
-                    auto& bb = computeBound.bounds;
-                    vsg::dsphere bound((bb.min.x + bb.max.x) * 0.5, (bb.min.y + bb.max.y) * 0.5, (bb.min.z + bb.max.z) * 0.5, vsg::length(bb.max - bb.min) * 0.5);
-
-                    auto plod = vsg::PagedLOD::create();
-                    plod->bound = bound;
-                    plod->children[0] = vsg::PagedLOD::Child{0.25, {}};  // external child visible when it's bound occupies more than 1/4 of the height of the window
-                    plod->children[1] = vsg::PagedLOD::Child{0.0, tile}; // visible always
-                    plod->filename = vsg::make_string(x, " ", y, " 0.tile");
-                    plod->options = vsg::Options::create_if(options, *options);
-
-                    group->addChild(plod);
+                    auto bound = computeBound(tile, tile_extents);
+
+                    // external child visible when it's bound occupies more than 1/4 of the height of the window
+                    group->addChild(createPagedLOD(bound, tile, 0.25, vsg::make_string(x, " ", y, " 0.tile"), options));
                 }
             }
         }
@@ -146,14 +226,17 @@ vsg::ref_ptr<vsg::Object> TileReader::read_subtile(uint32_t x, uint32_t y, uint3
 
     auto group = vsg::Group::create();
 
-    struct TileID
+    struct SubTile
     {
         uint32_t local_x;
         uint32_t local_y;
+        vsg::Path imagePath;
+        vsg::Path terrainPath;
+        vsg::ref_ptr<vsg::Data> imageTile;
+        vsg::ref_ptr<vsg::Data> terrainTile;
     };
 
-    vsg::Paths tiles;
-    std::map<vsg::Path, TileID> pathToTileID;
+    std::vector<SubTile> subtiles;
 
     uint32_t subtile_x = x * 2;
     uint32_t subtile_y = y * 2;
@@ -164,67 +247,166 @@ vsg::ref_ptr<vsg::Object> TileReader::read_subtile(uint32_t x, uint32_t y, uint3
         {
             uint32_t local_x = subtile_x + dx;
             uint32_t local_y = subtile_y + dy;
-            auto tilePath = getTilePath(imageLayer, local_x, local_y, local_lod);
-            tiles.push_back(tilePath);
-            pathToTileID[tilePath] = TileID{local_x, local_y};
+            vsg::Path terrainPath;
+            if (terrainLayer) terrainPath = getTilePath(terrainLayer, local_x, local_y, local_lod);
+            subtiles.push_back(SubTile{local_x, local_y, getTilePath(imageLayer, local_x, local_y, local_lod), terrainPath, {}, {}});
         }
     }
 
-    auto pathObjects = vsg::read(tiles, options);
+    // block compressed tiles from the tile pack don't need to be fetched or decoded
+    uint32_t numFromPack = 0;
+    if (tilePack)
+    {
+        for (auto& subtile : subtiles)
+        {
+            vsg::time_point start_pack_read = vsg::clock::now();
+            subtile.imageTile = tilePack->read(subtile.local_x, subtile.local_y, local_lod);
+            if (subtile.imageTile)
+            {
+                stats->record(TileStats::PACK_READ, std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start_pack_read).count());
+                subtile.imagePath = {};
+                ++numFromPack;
+            }
+        }
+    }
+
+    // the requesting PagedLOD is only observed while reading, so a tile whose PagedLOD is deleted while its layers are being
+    // fetched is skipped rather than kept alive by the read
+    vsg::observer_ptr<vsg::PagedLOD> plod;
+    bool tracked = (scheduler || residency) && requestingPagedLOD(vsg::make_string(x, " ", y, " ", lod, ".tile"), plod);
+    auto tileExpired = [&]() {
+        if (!tracked) return false;
+        vsg::ref_ptr<vsg::PagedLOD> ref_plod = plod;
+        return !ref_plod || (scheduler && scheduler->expired(*ref_plod));
+    };
 
-    if (pathObjects.size() == 4)
+    bool cancelled = false;
+    if (scheduler)
     {
-        for (auto& [tilePath, object] : pathObjects)
+        // fetch all the layers of all the subtiles concurrently, prioritized by the requesting PagedLOD's screen-space size
+        if (tileExpired())
         {
-            auto& tileID = pathToTileID[tilePath];
-            auto imageTile = object.cast<vsg::Data>();
-            if (imageTile)
+            cancelled = true;
+        }
+        else
+        {
+            std::vector<std::future<TileRequestScheduler::Result>> imageFutures, terrainFutures;
+            for (auto& subtile : subtiles)
             {
-                auto tile_extents = computeTileExtents(tileID.local_x, tileID.local_y, local_lod);
-                auto tile = createTile(tile_extents, imageTile);
-                if (tile)
+                if (subtile.imagePath) imageFutures.push_back(scheduler->fetch(subtile.imagePath, options, plod));
+                if (subtile.terrainPath) terrainFutures.push_back(scheduler->fetch(subtile.terrainPath, options, plod));
+            }
+
+            auto imageItr = imageFutures.begin();
+            auto terrainItr = terrainFutures.begin();
+            for (auto& subtile : subtiles)
+            {
+                if (subtile.imagePath)
+                {
+                    auto imageResult = (imageItr++)->get();
+                    cancelled = cancelled || imageResult.cancelled;
+                    subtile.imageTile = imageResult.object.cast<vsg::Data>();
+                }
+
+                if (subtile.terrainPath)
                 {
-                    vsg::ComputeBounds computeBound;
-                    tile->accept(computeBound);
-                    auto& bb = computeBound.bounds;
-                    vsg::dsphere bound((bb.min.x + bb.max.x) * 0.5, (bb.min.y + bb.max.y) * 0.5, (bb.min.z + bb.max.z) * 0.5, vsg::length(bb.max - bb.min) * 0.5);
-
-                    if (local_lod < maxLevel)
-                    {
-                        auto plod = vsg::PagedLOD::create();
-                        plod->bound = bound;
-                        plod->children[0] = vsg::PagedLOD::Child{lodTransitionScreenHeightRatio, {}}; // external child visible when it's bound occupies more than 1/4 of the height of the window
-                        plod->children[1] = vsg::PagedLOD::Child{0.0, tile};                          // visible always
-                        plod->filename = vsg::make_string(tileID.local_x, " ", tileID.local_y, " ", local_lod, ".tile");
-                        plod->options = vsg::Options::create_if(options, *options);
-
-                        //std::cout<<"plod->filename "<<plod->filename<<std::endl;
-
-                        group->addChild(plod);
-                    }
-                    else
-                    {
-                        auto cullGroup = vsg::CullGroup::create();
-                        cullGroup->bound = bound;
-                        cullGroup->addChild(tile);
-
-                        group->addChild(cullGroup);
-                    }
+                    auto terrainResult = (terrainItr++)->get();
+                    cancelled = cancelled || terrainResult.cancelled;
+                    subtile.terrainTile = terrainResult.object.cast<vsg::Data>();
                 }
             }
         }
     }
+    else
+    {
+        vsg::Paths tiles;
+        for (auto& subtile : subtiles)
+        {
+            if (subtile.imagePath) tiles.push_back(subtile.imagePath);
+            if (subtile.terrainPath) tiles.push_back(subtile.terrainPath);
+        }
 
-    vsg::time_point end_read = vsg::clock::now();
+        vsg::PathObjects pathObjects;
+        if (!tiles.empty())
+        {
+            // the layers are read concurrently so each is attributed the time for the whole batch
+            vsg::time_point start_fetch = vsg::clock::now();
+            pathObjects = vsg::read(tiles, options);
+            double time_to_fetch = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start_fetch).count();
+            for (size_t i = 0; i < tiles.size(); ++i) stats->record(TileStats::FETCH, time_to_fetch);
+        }
+
+        for (auto& subtile : subtiles)
+        {
+            if (auto itr = pathObjects.find(subtile.imagePath); subtile.imagePath && itr != pathObjects.end()) subtile.imageTile = itr->second.cast<vsg::Data>();
+            if (auto itr = pathObjects.find(subtile.terrainPath); subtile.terrainPath && itr != pathObjects.end()) subtile.terrainTile = itr->second.cast<vsg::Data>();
+        }
+    }
 
-    double time_to_read_tile = std::chrono::duration<float, std::chrono::milliseconds::period>(end_read - start_read).count();
+    if (cancelled || tileExpired())
+    {
+        ++numTilesCancelled;
+        return {};
+    }
 
+    for (auto& subtile : subtiles)
     {
-        std::scoped_lock<std::mutex> lock(statsMutex);
-        numTilesRead += 1;
-        totalTimeReadingTiles += time_to_read_tile;
+        if (subtile.imagePath && subtile.imageTile) stats->addBytes(subtile.imageTile->dataSize());
+        if (subtile.terrainTile) stats->addBytes(subtile.terrainTile->dataSize());
     }
 
+    if (tilePack)
+    {
+        // add the newly fetched tiles to the tile pack
+        for (auto& subtile : subtiles)
+        {
+            if (subtile.imagePath && subtile.imageTile) tilePack->write(subtile.local_x, subtile.local_y, local_lod, *subtile.imageTile);
+        }
+    }
+
+    vsg::time_point start_build = vsg::clock::now();
+
+    uint64_t numBytes = 0;
+    for (auto& subtile : subtiles)
+    {
+        if (subtile.imageTile)
+        {
+            numBytes += estimateDeviceMemory(subtile.imageTile, subtile.terrainTile);
+
+            auto tile_extents = computeTileExtents(subtile.local_x, subtile.local_y, local_lod);
+            auto tile = createTile(tile_extents, subtile.imageTile, subtile.terrainTile);
+            if (tile)
+            {
+                auto bound = computeBound(tile, tile_extents, subtile.terrainTile);
+
+                if (local_lod < maxLevel)
+                {
+                    // external child visible when it's bound occupies more than lodTransitionScreenHeightRatio of the height of the window
+                    group->addChild(createPagedLOD(bound, tile, lodTransitionScreenHeightRatio, vsg::make_string(subtile.local_x, " ", subtile.local_y, " ", local_lod, ".tile"), options));
+                }
+                else
+                {
+                    auto cullGroup = vsg::CullGroup::create();
+                    cullGroup->bound = bound;
+                    cullGroup->addChild(tile);
+
+                    group->addChild(cullGroup);
+                }
+            }
+        }
+    }
+
+    vsg::time_point end_read = vsg::clock::now();
+
+    double time_to_read_tile = std::chrono::duration<double, std::chrono::milliseconds::period>(end_read - start_read).count();
+
+    stats->record(TileStats::BUILD, std::chrono::duration<double, std::chrono::milliseconds::period>(end_read - start_build).count());
+    stats->record(TileStats::READ_TILE, time_to_read_tile);
+
+    ++numTilesRead;
+    numTilesFromPack += numFromPack;
+    numBytesRead += numBytes;
+
     if (group->children.size() != 4)
     {
         vsg::warn("Warning: could not load all 4 subtiles, loaded only ", group->children.size());
@@ -232,9 +414,111 @@ vsg::ref_ptr<vsg::Object> TileReader::read_subtile(uint32_t x, uint32_t y, uint3
         return {};
     }
 
+    if (residency) residency->loaded(vsg::ref_ptr<vsg::PagedLOD>(plod), group, numBytes);
+
     return group;
 }
 
+uint64_t TileReader::estimateDeviceMemory(vsg::ref_ptr<vsg::Data> textureData, vsg::ref_ptr<vsg::Data> terrainData) const
+{
+    // uncompressed textures get a full mipmap chain generated on the GPU, adding a third to their size
+    uint64_t numBytes = textureData->dataSize();
+    if (textureData->properties.blockWidth <= 1 && mipmapLevelsHint > 1) numBytes += numBytes / 3;
+
+    if (gpuTerrain)
+    {
+        // the grid is shared, leaving the height field and tile parameters
+        numBytes += terrainData ? terrainData->dataSize() : 0;
+        numBytes += 8 * sizeof(vsg::vec4);
+    }
+    else
+    {
+        // 32 x 32 grid of vertices, colours and tex coords along with its indices
+        numBytes += 32 * 32 * (sizeof(vsg::vec3) + sizeof(vsg::vec3) + sizeof(vsg::vec2));
+        numBytes += 31 * 31 * 6 * sizeof(uint16_t);
+    }
+    return numBytes;
+}
+
+vsg::dsphere TileReader::computeBound(vsg::ref_ptr<vsg::Node> tile, const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> terrainData) const
+{
+    if (gpuTerrain)
+    {
+        // the shared grid only holds grid coordinates so sample the tile's surface directly
+        double minHeight = 0.0;
+        double maxHeight = 0.0;
+        if (auto heights = terrainData.cast<vsg::floatArray2D>(); heights && heights->valueCount() > 0)
+        {
+            minHeight = maxHeight = heights->at(0);
+            for (auto height : *heights)
+            {
+                minHeight = std::min(minHeight, static_cast<double>(height));
+                maxHeight = std::max(maxHeight, static_cast<double>(height));
+            }
+        }
+
+        const uint32_t numSamples = 9;
+        vsg::dvec3 delta = (tile_extents.max - tile_extents.min) / double(numSamples - 1);
+        vsg::dbox dbb;
+        for (uint32_t r = 0; r < numSamples; ++r)
+        {
+            for (uint32_t c = 0; c < numSamples; ++c)
+            {
+                for (auto height : {minHeight, maxHeight})
+                {
+                    vsg::dvec3 location(tile_extents.min.x + double(c) * delta.x, tile_extents.min.y + double(r) * delta.y, height);
+                    dbb.add(ellipsoidModel->convertLatLongAltitudeToECEF(computeLatitudeLongitudeAltitude(location)));
+                }
+            }
+        }
+        return vsg::dsphere((dbb.min + dbb.max) * 0.5, vsg::length(dbb.max - dbb.min) * 0.5);
+    }
+
+    vsg::ComputeBounds computeBounds;
+    tile->accept(computeBounds);
+    auto& cbb = computeBounds.bounds;
+    return vsg::dsphere((cbb.min.x + cbb.max.x) * 0.5, (cbb.min.y + cbb.max.y) * 0.5, (cbb.min.z + cbb.max.z) * 0.5, vsg::length(cbb.max - cbb.min) * 0.5);
+}
+
+vsg::ref_ptr<vsg::PagedLOD> TileReader::createPagedLOD(const vsg::dsphere& bound, vsg::ref_ptr<vsg::Node> tile, double minimumScreenHeightRatio, const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options) const
+{
+    auto plod = vsg::PagedLOD::create();
+    plod->bound = bound;
+    plod->children[0] = vsg::PagedLOD::Child{minimumScreenHeightRatio, {}}; // external child visible when it's bound occupies more than minimumScreenHeightRatio of the height of the window
+    plod->children[1] = vsg::PagedLOD::Child{0.0, tile};                    // visible always
+    plod->filename = filename;
+    plod->options = vsg::Options::create_if(options, *options);
+
+    if (scheduler || residency)
+    {
+        std::scoped_lock<std::mutex> lock(pagedLODMutex);
+
+        // prune entries for PagedLOD that have been deleted
+        if (pagedLODs.size() >= 1024 && (pagedLODs.size() % 1024) == 0)
+        {
+            for (auto itr = pagedLODs.begin(); itr != pagedLODs.end();)
+            {
+                if (itr->second) ++itr;
+                else itr = pagedLODs.erase(itr);
+            }
+        }
+
+        pagedLODs[filename] = plod;
+    }
+
+    return plod;
+}
+
+bool TileReader::requestingPagedLOD(const vsg::Path& filename, vsg::observer_ptr<vsg::PagedLOD>& plod) const
+{
+    std::scoped_lock<std::mutex> lock(pagedLODMutex);
+    auto itr = pagedLODs.find(filename);
+    if (itr == pagedLODs.end()) return false;
+
+    plod = itr->second;
+    return true;
+}
+
 void TileReader::init()
 {
     // set up graphics pipeline
@@ -242,6 +526,12 @@ void TileReader::init()
         {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr} // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
     };
 
+    if (gpuTerrain)
+    {
+        descriptorBindings.push_back(VkDescriptorSetLayoutBinding{1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr}); // height field
+        descriptorBindings.push_back(VkDescriptorSetLayoutBinding{2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr});         // tile parameters
+    }
+
     descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
 
     vsg::PushConstantRanges pushConstantRanges{
@@ -257,6 +547,67 @@ void TileReader::init()
     sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     sampler->anisotropyEnable = VK_TRUE;
     sampler->maxAnisotropy = 16.0f;
+
+    // block compressed tiles are stored without mipmaps and can't have them generated on the GPU
+    compressedSampler = vsg::Sampler::create();
+    compressedSampler->maxLod = 0.0f;
+    compressedSampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    compressedSampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    compressedSampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    compressedSampler->anisotropyEnable = VK_TRUE;
+    compressedSampler->maxAnisotropy = 16.0f;
+
+    if (gpuTerrain)
+    {
+        // height fields are sampled with nearest neighbour, matching the CPU built tiles
+        heightSampler = vsg::Sampler::create();
+        heightSampler->minFilter = VK_FILTER_NEAREST;
+        heightSampler->magFilter = VK_FILTER_NEAREST;
+        heightSampler->mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        heightSampler->maxLod = 0.0f;
+        heightSampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        heightSampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        heightSampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+        // used by tiles without a terrain layer
+        flatHeights = vsg::floatArray2D::create(1, 1, vsg::Data::Properties{VK_FORMAT_R32_SFLOAT});
+        flatHeights->set(0, 0, 0.0f);
+
+        // grid coordinates and indices shared by all tiles
+        uint32_t numRows = 32;
+        uint32_t numCols = 32;
+        uint32_t numTriangles = (numRows - 1) * (numCols - 1) * 2;
+
+        auto grid = vsg::vec2Array::create(numRows * numCols);
+        for (uint32_t r = 0; r < numRows; ++r)
+        {
+            for (uint32_t c = 0; c < numCols; ++c)
+            {
+                grid->set(c + r * numCols, vsg::vec2(float(c) / float(numCols - 1), float(r) / float(numRows - 1)));
+            }
+        }
+
+        auto indices = vsg::ushortArray::create(numTriangles * 3);
+        auto itr = indices->begin();
+        for (uint32_t r = 0; r < numRows - 1; ++r)
+        {
+            for (uint32_t c = 0; c < numCols - 1; ++c)
+            {
+                uint32_t vi = c + r * numCols;
+                (*itr++) = vi;
+                (*itr++) = vi + 1;
+                (*itr++) = vi + numCols;
+                (*itr++) = vi + numCols;
+                (*itr++) = vi + 1;
+                (*itr++) = vi + numCols + 1;
+            }
+        }
+
+        gridCommands = vsg::Commands::create();
+        gridCommands->addChild(vsg::BindVertexBuffers::create(0, vsg::DataList{grid}));
+        gridCommands->addChild(vsg::BindIndexBuffer::create(indices));
+        gridCommands->addChild(vsg::DrawIndexed::create(indices->size(), 1, 0, 0, 0));
+    }
 }
 
 vsg::ref_ptr<vsg::StateGroup> TileReader::createRoot() const
@@ -265,7 +616,7 @@ vsg::ref_ptr<vsg::StateGroup> TileReader::createRoot() const
     vsg::Paths searchPaths = vsg::getEnvPaths("VSG_FILE_PATH");
 
     // load shaders
-    vsg::ref_ptr<vsg::ShaderStage> vertexShader = vsg::ShaderStage::read(VK_SHADER_STAGE_VERTEX_BIT, "main", vsg::findFile("shaders/vert_PushConstants.spv", searchPaths));
+    vsg::ref_ptr<vsg::ShaderStage> vertexShader = gpuTerrain ? vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", terrain_vert) : vsg::ShaderStage::read(VK_SHADER_STAGE_VERTEX_BIT, "main", vsg::findFile("shaders/vert_PushConstants.spv", searchPaths));
     vsg::ref_ptr<vsg::ShaderStage> fragmentShader = vsg::ShaderStage::read(VK_SHADER_STAGE_FRAGMENT_BIT, "main", vsg::findFile("shaders/frag_PushConstants.spv", searchPaths));
     if (!vertexShader || !fragmentShader)
     {
@@ -285,6 +636,12 @@ vsg::ref_ptr<vsg::StateGroup> TileReader::createRoot() const
         VkVertexInputAttributeDescription{2, 2, VK_FORMAT_R32G32_SFLOAT, 0},    // tex coord data
     };
 
+    if (gpuTerrain)
+    {
+        vertexBindingsDescriptions = {VkVertexInputBindingDescription{0, sizeof(vsg::vec2), VK_VERTEX_INPUT_RATE_VERTEX}}; // grid coord data
+        vertexAttributeDescriptions = {VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32_SFLOAT, 0}};         // grid coord data
+    }
+
     vsg::GraphicsPipelineStates pipelineStates{
         vsg::VertexInputState::create(vertexBindingsDescriptions, vertexAttributeDescriptions),
         vsg::InputAssemblyState::create(),
@@ -302,16 +659,23 @@ vsg::ref_ptr<vsg::StateGroup> TileReader::createRoot() const
     return root;
 }
 
-vsg::ref_ptr<vsg::Node> TileReader::createTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const
+vsg::ref_ptr<vsg::Transform> TileReader::createTileTransform(const vsg::dmat4& localToWorld) const
+{
+    if (cameraRelativeOrigin) return CameraRelativeTransform::create(cameraRelativeOrigin, localToWorld);
+    return vsg::MatrixTransform::create(localToWorld);
+}
+
+vsg::ref_ptr<vsg::Node> TileReader::createTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData, vsg::ref_ptr<vsg::Data> terrainData) const
 {
 #if 1
-    return createECEFTile(tile_extents, sourceData);
+    if (gpuTerrain) return createGPUTerrainTile(tile_extents, sourceData, terrainData);
+    return createECEFTile(tile_extents, sourceData, terrainData);
 #else
     return createTextureQuad(tile_extents, sourceData);
 #endif
 }
 
-vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> textureData) const
+vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> textureData, vsg::ref_ptr<vsg::Data> terrainData) const
 {
     vsg::dvec3 center = computeLatitudeLongitudeAltitude((tile_extents.min + tile_extents.max) * 0.5);
 
@@ -319,7 +683,8 @@ vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents
     auto worldToLocal = vsg::inverse(localToWorld);
 
     // create texture image and associated DescriptorSets and binding
-    auto texture = vsg::DescriptorImage::create(sampler, textureData, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    auto textureSampler = (textureData->properties.blockWidth > 1) ? compressedSampler : sampler;
+    auto texture = vsg::DescriptorImage::create(textureSampler, textureData, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 
     auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture});
     auto bindDescriptorSets = vsg::BindDescriptorSets::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, vsg::DescriptorSets{descriptorSet});
@@ -329,7 +694,7 @@ vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents
     scenegraph->add(bindDescriptorSets);
 
     // set up model transformation node
-    auto transform = vsg::MatrixTransform::create(localToWorld); // VK_SHADER_STAGE_VERTEX_BIT
+    auto transform = createTileTransform(localToWorld); // VK_SHADER_STAGE_VERTEX_BIT
 
     // add transform to root of the scene graph
     scenegraph->addChild(transform);
@@ -355,6 +720,16 @@ vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents
 
     vsg::vec3 color(1.0f, 1.0f, 1.0f);
 
+    // optional height field, sampled with nearest neighbour
+    auto heights = terrainData.cast<vsg::floatArray2D>();
+    auto heightAt = [&](uint32_t c, uint32_t r) -> double {
+        if (!heights || heights->width() < 2 || heights->height() < 2) return 0.0;
+        uint32_t hc = (c * (heights->width() - 1) + (numCols - 1) / 2) / (numCols - 1);
+        uint32_t hr = (r * (heights->height() - 1) + (numRows - 1) / 2) / (numRows - 1);
+        if (heights->properties.origin == vsg::TOP_LEFT) hr = heights->height() - 1 - hr;
+        return static_cast<double>(heights->at(hc, hr));
+    };
+
     // set up vertex coords
     auto vertices = vsg::vec3Array::create(numVertices);
     auto colors = vsg::vec3Array::create(numVertices);
@@ -363,7 +738,7 @@ vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents
     {
         for (uint32_t c = 0; c < numCols; ++c)
         {
-            vsg::dvec3 location(longitudeOrigin + double(c) * longitudeScale, latitudeOrigin + double(r) * latitudeScale, 0.0);
+            vsg::dvec3 location(longitudeOrigin + double(c) * longitudeScale, latitudeOrigin + double(r) * latitudeScale, heightAt(c, r));
             vsg::dvec3 latitudeLongitudeAltitude = computeLatitudeLongitudeAltitude(location);
 
             auto ecef = ellipsoidModel->convertLatLongAltitudeToECEF(latitudeLongitudeAltitude);
@@ -406,6 +781,72 @@ vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents
     return scenegraph;
 }
 
+vsg::ref_ptr<vsg::Node> TileReader::createGPUTerrainTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> textureData, vsg::ref_ptr<vsg::Data> terrainData) const
+{
+    vsg::dvec3 midPoint = (tile_extents.min + tile_extents.max) * 0.5;
+    vsg::dvec3 center = computeLatitudeLongitudeAltitude(midPoint);
+
+    auto localToWorld = ellipsoidModel->computeLocalToWorldTransform(center);
+    auto worldToLocal = vsg::inverse(localToWorld);
+
+    bool sphericalMercator = (projection == "EPSG:3857" || projection == "spherical-mercator");
+    double latitudeCenter = vsg::radians(center.x);
+    double longitudeCenter = vsg::radians(center.y);
+    double mercatorCenter = 2.0 * vsg::radians(midPoint.y);
+
+    double a = ellipsoidModel->radiusEquator();
+    double b = ellipsoidModel->radiusPolar();
+    double e2 = 1.0 - (b * b) / (a * a);
+    double N = a / sqrt(1.0 - e2 * sin(latitudeCenter) * sin(latitudeCenter));
+
+    // offsets are taken relative to the tile centre in double precision so the vertex shader only works with small values
+    auto parameters = vsg::vec4Array::create(8);
+    for (int i = 0; i < 3; ++i)
+    {
+        parameters->set(i, vsg::vec4(float(worldToLocal[i][0]), float(worldToLocal[i][1]), float(worldToLocal[i][2]), 0.0f));
+    }
+    if (sphericalMercator)
+    {
+        parameters->set(3, vsg::vec4(float(vsg::radians(tile_extents.min.x) - longitudeCenter), float(vsg::radians(tile_extents.max.x) - longitudeCenter),
+                                     float(2.0 * vsg::radians(tile_extents.min.y) - mercatorCenter), float(2.0 * vsg::radians(tile_extents.max.y) - mercatorCenter)));
+    }
+    else
+    {
+        parameters->set(3, vsg::vec4(float(vsg::radians(tile_extents.min.x) - longitudeCenter), float(vsg::radians(tile_extents.max.x) - longitudeCenter),
+                                     float(vsg::radians(tile_extents.min.y) - latitudeCenter), float(vsg::radians(tile_extents.max.y) - latitudeCenter)));
+    }
+    parameters->set(4, vsg::vec4(float(sin(latitudeCenter)), float(cos(latitudeCenter)), float(sin(longitudeCenter)), float(cos(longitudeCenter))));
+    parameters->set(5, vsg::vec4(float(N + center.z), float(N * (1.0 - e2) + center.z), float(a), float(e2)));
+    parameters->set(6, vsg::vec4(sphericalMercator ? 1.0f : 0.0f, float(mercatorCenter), float(center.z), 0.0f));
+
+    auto heights = terrainData.cast<vsg::floatArray2D>();
+    if (heights && heights->properties.format == VK_FORMAT_UNDEFINED) heights->properties.format = VK_FORMAT_R32_SFLOAT;
+    if (!heights) heights = flatHeights;
+
+    parameters->set(7, vsg::vec4((textureData->properties.origin == vsg::TOP_LEFT) ? 1.0f : 0.0f, (heights->properties.origin == vsg::TOP_LEFT) ? 1.0f : 0.0f, 0.0f, 0.0f));
+
+    // create texture, height field and tile parameter descriptors
+    auto textureSampler = (textureData->properties.blockWidth > 1) ? compressedSampler : sampler;
+    auto texture = vsg::DescriptorImage::create(textureSampler, textureData, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    auto heightField = vsg::DescriptorImage::create(heightSampler, heights, 1, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    auto tileParameters = vsg::DescriptorBuffer::create(parameters, 2, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+
+    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture, heightField, tileParameters});
+    auto bindDescriptorSets = vsg::BindDescriptorSets::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, vsg::DescriptorSets{descriptorSet});
+
+    // create StateGroup to bind any texture state
+    auto scenegraph = vsg::StateGroup::create();
+    scenegraph->add(bindDescriptorSets);
+
+    // set up model transformation node, the shared grid is drawn in the tile's local coordinate frame
+    auto transform = createTileTransform(localToWorld);
+    transform->addChild(gridCommands);
+
+    scenegraph->addChild(transform);
+
+    return scenegraph;
+}
+
 vsg::ref_ptr<vsg::Node> TileReader::createTextureQuad(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> textureData) const
 {
     if (!textureData) return {};
@@ -2,6 +2,12 @@
 
 #include <vsg/all.h>
 
+#include "CameraRelative.h"
+#include "TilePackCache.h"
+#include "TileRequestScheduler.h"
+#include "TileResidencyManager.h"
+#include "TileStats.h"
+
 class TileReader : public vsg::Inherit<vsg::ReaderWriter, TileReader>
 {
 public:
@@ -20,14 +26,33 @@ public:
     vsg::Path terrainLayer;
     uint32_t mipmapLevelsHint = 16;
 
+    // optional scheduler used to fetch the image and terrain layers of subtiles concurrently, prioritized and cancellable.
+    vsg::ref_ptr<TileRequestScheduler> scheduler;
+
+    // optional cache of block compressed tiles, read in place of the image layer and populated with newly fetched tiles.
+    vsg::ref_ptr<TilePackCache> tilePack;
+
+    // optional manager that bounds the device memory used by paged in tiles.
+    vsg::ref_ptr<TileResidencyManager> residency;
+
+    // when enabled tiles only upload their height field and extents, a grid shared by all tiles is displaced and projected in the vertex shader.
+    bool gpuTerrain = false;
+
+    // when set ECEF tiles are positioned with CameraRelativeTransforms relative to this origin rather than MatrixTransforms.
+    vsg::ref_ptr<CameraRelativeOrigin> cameraRelativeOrigin;
+
     void init();
 
     vsg::ref_ptr<vsg::Object> read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) const override;
 
-    // timing stats
-    mutable std::mutex statsMutex;
-    mutable uint64_t numTilesRead{0};
-    mutable double totalTimeReadingTiles{0.0};
+    // latency histograms and bytes read, shared with the scheduler when one is assigned
+    vsg::ref_ptr<TileStats> stats = TileStats::create();
+
+    // tile counts
+    mutable std::atomic_uint64_t numTilesRead{0};
+    mutable std::atomic_uint64_t numTilesCancelled{0};
+    mutable std::atomic_uint64_t numTilesFromPack{0};
+    mutable std::atomic_uint64_t numBytesRead{0};
 
 protected:
     vsg::dvec3 computeLatitudeLongitudeAltitude(const vsg::dvec3& src) const;
@@ -37,13 +62,32 @@ protected:
     vsg::ref_ptr<vsg::Object> read_root(vsg::ref_ptr<const vsg::Options> options = {}) const;
     vsg::ref_ptr<vsg::Object> read_subtile(uint32_t x, uint32_t y, uint32_t lod, vsg::ref_ptr<const vsg::Options> options = {}) const;
 
-    vsg::ref_ptr<vsg::Node> createTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const;
-    vsg::ref_ptr<vsg::Node> createECEFTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const;
+    vsg::ref_ptr<vsg::PagedLOD> createPagedLOD(const vsg::dsphere& bound, vsg::ref_ptr<vsg::Node> tile, double minimumScreenHeightRatio, const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options) const;
+    // look up the PagedLOD that requested filename, returns false if it wasn't created by this TileReader
+    bool requestingPagedLOD(const vsg::Path& filename, vsg::observer_ptr<vsg::PagedLOD>& plod) const;
+
+    vsg::ref_ptr<vsg::Node> createTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData, vsg::ref_ptr<vsg::Data> terrainData = {}) const;
+    vsg::ref_ptr<vsg::Node> createECEFTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData, vsg::ref_ptr<vsg::Data> terrainData = {}) const;
+    vsg::ref_ptr<vsg::Node> createGPUTerrainTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData, vsg::ref_ptr<vsg::Data> terrainData = {}) const;
     vsg::ref_ptr<vsg::Node> createTextureQuad(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const;
 
+    uint64_t estimateDeviceMemory(vsg::ref_ptr<vsg::Data> textureData, vsg::ref_ptr<vsg::Data> terrainData) const;
+    vsg::dsphere computeBound(vsg::ref_ptr<vsg::Node> tile, const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> terrainData = {}) const;
+
     vsg::ref_ptr<vsg::StateGroup> createRoot() const;
+    vsg::ref_ptr<vsg::Transform> createTileTransform(const vsg::dmat4& localToWorld) const;
 
     vsg::ref_ptr<vsg::DescriptorSetLayout> descriptorSetLayout;
     vsg::ref_ptr<vsg::PipelineLayout> pipelineLayout;
     vsg::ref_ptr<vsg::Sampler> sampler;
+    vsg::ref_ptr<vsg::Sampler> compressedSampler;
+
+    // state shared by all tiles when using gpuTerrain
+    vsg::ref_ptr<vsg::Sampler> heightSampler;
+    vsg::ref_ptr<vsg::floatArray2D> flatHeights;
+    vsg::ref_ptr<vsg::Commands> gridCommands;
+
+    // PagedLOD that have been created, used to associate subtile requests with the PagedLOD making them
+    mutable std::mutex pagedLODMutex;
+    mutable std::map<vsg::Path, vsg::observer_ptr<vsg::PagedLOD>> pagedLODs;
 };
@@ -0,0 +1,130 @@
+#include "TileRequestScheduler.h"
+
+TileRequestScheduler::TileRequestScheduler(uint32_t numThreads)
+{
+    for (uint32_t i = 0; i < std::max(numThreads, 1u); ++i)
+    {
+        _threads.emplace_back([this]() { run(); });
+    }
+}
+
+TileRequestScheduler::~TileRequestScheduler()
+{
+    stop();
+}
+
+void TileRequestScheduler::stop()
+{
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _active = false;
+    }
+    _cv.notify_all();
+
+    for (auto& thread : _threads)
+    {
+        if (thread.joinable()) thread.join();
+    }
+    _threads.clear();
+
+    // release any requests that were never serviced
+    for (auto& request : _requests) request.promise.set_value(Result{{}, true});
+    _requests.clear();
+}
+
+std::future<TileRequestScheduler::Result> TileRequestScheduler::fetch(const vsg::Path& path, vsg::ref_ptr<const vsg::Options> options, vsg::observer_ptr<vsg::PagedLOD> plod)
+{
+    Request request;
+    request.path = path;
+    request.options = options;
+    request.plod = plod;
+    if (vsg::ref_ptr<vsg::PagedLOD> ref_plod = plod) request.bound = ref_plod->bound;
+
+    auto future = request.promise.get_future();
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (!_active)
+        {
+            request.promise.set_value(Result{{}, true});
+            return future;
+        }
+        _requests.push_back(std::move(request));
+    }
+    _cv.notify_one();
+
+    return future;
+}
+
+void TileRequestScheduler::update(const vsg::dvec3& eye, double fieldOfViewY)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _eye = eye;
+    _tanHalfFieldOfViewY = std::tan(vsg::radians(fieldOfViewY) * 0.5);
+}
+
+double TileRequestScheduler::screenHeightRatio(const vsg::dsphere& bound) const
+{
+    if (_tanHalfFieldOfViewY <= 0.0) return std::numeric_limits<double>::max();
+
+    double distance = vsg::length(bound.center - _eye) - bound.radius;
+    if (distance <= bound.radius * 1e-6) return std::numeric_limits<double>::max();
+
+    return bound.radius / (distance * _tanHalfFieldOfViewY);
+}
+
+bool TileRequestScheduler::expired(const vsg::PagedLOD& plod) const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return screenHeightRatio(plod.bound) < minimumScreenHeightRatio * cancelRatio;
+}
+
+void TileRequestScheduler::run()
+{
+    while (true)
+    {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this]() { return !_active || !_requests.empty(); });
+            if (!_active) return;
+
+            // drop expired requests and pick the one with the largest screen height ratio
+            auto selected = _requests.end();
+            double selectedRatio = 0.0;
+            for (auto itr = _requests.begin(); itr != _requests.end();)
+            {
+                vsg::ref_ptr<vsg::PagedLOD> plod = itr->plod;
+                double ratio = screenHeightRatio(itr->bound);
+                if (!plod || ratio < minimumScreenHeightRatio * cancelRatio)
+                {
+                    ++numCancelled;
+                    itr->promise.set_value(Result{{}, true});
+                    itr = _requests.erase(itr);
+                    continue;
+                }
+
+                if (selected == _requests.end() || ratio > selectedRatio)
+                {
+                    selected = itr;
+                    selectedRatio = ratio;
+                }
+                ++itr;
+            }
+
+            if (selected == _requests.end()) continue;
+
+            request = std::move(*selected);
+            _requests.erase(selected);
+        }
+
+        // the read itself can't be interrupted, but cancelling requests before they start avoids spending bandwidth on them.
+        Result result;
+        vsg::time_point start_fetch = vsg::clock::now();
+        result.object = vsg::read(request.path, request.options);
+        if (stats) stats->record(TileStats::FETCH, std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start_fetch).count());
+        ++numFetched;
+
+        request.promise.set_value(result);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "TileStats.h"
+
+#include <condition_variable>
+#include <future>
+#include <list>
+#include <thread>
+
+// Prioritized, cancellable scheduler for fetching tile layers.
+// Requests are serviced by a pool of threads in order of the screen-space size of the requesting tile, a proxy for
+// its screen-space error, relative to the current camera. Requests are dropped without being fetched once the PagedLOD
+// that made them has been deleted or the camera has moved far enough away that the tile would no longer be paged in.
+class TileRequestScheduler : public vsg::Inherit<vsg::Object, TileRequestScheduler>
+{
+public:
+    explicit TileRequestScheduler(uint32_t numThreads = 4);
+
+    struct Result
+    {
+        vsg::ref_ptr<vsg::Object> object;
+        bool cancelled = false;
+    };
+
+    // the screen height ratio at which tiles are paged in, requests for tiles below minimumScreenHeightRatio * cancelRatio are cancelled.
+    double minimumScreenHeightRatio = 0.25;
+    double cancelRatio = 0.5;
+
+    // queue the reading of path on behalf of plod, the result is available via the returned future.
+    std::future<Result> fetch(const vsg::Path& path, vsg::ref_ptr<const vsg::Options> options, vsg::observer_ptr<vsg::PagedLOD> plod);
+
+    // update the camera position and vertical field of view used for prioritizing and cancelling requests, call once per frame.
+    void update(const vsg::dvec3& eye, double fieldOfViewY);
+
+    // returns true if the tile associated with plod is no longer required
+    bool expired(const vsg::PagedLOD& plod) const;
+
+    void stop();
+
+    // optional stats that each fetch's latency is recorded to
+    vsg::ref_ptr<TileStats> stats;
+
+    // stats
+    std::atomic_uint64_t numFetched{0};
+    std::atomic_uint64_t numCancelled{0};
+
+protected:
+    virtual ~TileRequestScheduler();
+
+    struct Request
+    {
+        vsg::Path path;
+        vsg::ref_ptr<const vsg::Options> options;
+        vsg::observer_ptr<vsg::PagedLOD> plod;
+        vsg::dsphere bound;
+        std::promise<Result> promise;
+    };
+
+    double screenHeightRatio(const vsg::dsphere& bound) const;
+    void run();
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::list<Request> _requests;
+    vsg::dvec3 _eye;
+    double _tanHalfFieldOfViewY = 0.0;
+    bool _active = true;
+
+    std::vector<std::thread> _threads;
+};
@@ -0,0 +1,117 @@
+#include "TileResidencyManager.h"
+
+TileResidencyManager::TileResidencyManager(uint64_t in_budget) :
+    budget(in_budget)
+{
+}
+
+void TileResidencyManager::loaded(vsg::ref_ptr<vsg::PagedLOD> plod, vsg::ref_ptr<vsg::Node> subgraph, uint64_t bytes)
+{
+    if (!plod || !subgraph) return;
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _pending.push_back(Tile{plod, subgraph, deferredRelease ? subgraph : vsg::ref_ptr<vsg::Node>(), bytes, 0.0});
+}
+
+void TileResidencyManager::update(vsg::DatabasePager& databasePager, const vsg::dvec3& eye, double fieldOfViewY)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    uint64_t frameCount = databasePager.frameCount;
+
+    // pending subgraphs become resident once the DatabasePager has merged them, or are dropped if they have been discarded,
+    // a retained subgraph that only this manager references has been discarded.
+    for (auto itr = _pending.begin(); itr != _pending.end();)
+    {
+        vsg::ref_ptr<vsg::PagedLOD> plod = itr->plod;
+        if (!plod || (itr->retained && itr->retained->referenceCount() == 1))
+        {
+            if (deferredRelease) deferredRelease->release(std::move(itr->retained));
+            itr = _pending.erase(itr);
+            continue;
+        }
+
+        vsg::ref_ptr<vsg::Node> subgraph = itr->subgraph;
+        if (!subgraph)
+        {
+            itr = _pending.erase(itr);
+        }
+        else if (plod->children[0].node == subgraph)
+        {
+            _stats.currentBytes += itr->bytes;
+            _resident.push_back(*itr);
+            itr = _pending.erase(itr);
+        }
+        else
+        {
+            ++itr;
+        }
+    }
+
+    _stats.peakBytes = std::max(_stats.peakBytes, _stats.currentBytes);
+
+    // account for tiles expired since the last frame and prioritize the remaining ones
+    double tanHalfFieldOfViewY = std::tan(vsg::radians(fieldOfViewY) * 0.5);
+    for (auto itr = _resident.begin(); itr != _resident.end();)
+    {
+        vsg::ref_ptr<vsg::PagedLOD> plod = itr->plod;
+        vsg::ref_ptr<vsg::Node> subgraph = itr->subgraph;
+        if (!plod || !subgraph || plod->children[0].node != subgraph)
+        {
+            _stats.currentBytes -= itr->bytes;
+            _stats.evictedBytes += itr->bytes;
+            ++_stats.numEvicted;
+            subgraph = {};
+            if (deferredRelease) deferredRelease->release(std::move(itr->retained));
+            itr = _resident.erase(itr);
+            continue;
+        }
+
+        double distance = vsg::length(plod->bound.center - eye);
+        double screenHeightRatio = (distance > plod->bound.radius) ? plod->bound.radius / (distance * tanHalfFieldOfViewY) : std::numeric_limits<double>::max();
+
+        uint64_t lastUsed = plod->frameHighResLastUsed.load();
+        double framesUnused = (frameCount > lastUsed) ? static_cast<double>(frameCount - lastUsed) : 0.0;
+
+        itr->priority = screenHeightRatio * std::pow(0.5, framesUnused / halfLifeFrames);
+        ++itr;
+    }
+
+    if (deferredRelease) deferredRelease->flush();
+
+    _stats.numResident = _resident.size();
+
+    // keep the highest priority tiles that fit within the budget
+    std::sort(_resident.begin(), _resident.end(), [](const Tile& lhs, const Tile& rhs) { return lhs.priority > rhs.priority; });
+
+    uint32_t numWithinBudget = 0;
+    uint64_t bytesWithinBudget = 0;
+    for (auto& tile : _resident)
+    {
+        if (bytesWithinBudget + tile.bytes > budget) break;
+        bytesWithinBudget += tile.bytes;
+        ++numWithinBudget;
+    }
+
+    if (_resident.empty())
+    {
+        // nothing to base a tile size estimate on yet so leave the DatabasePager's target as is
+    }
+    else if (_stats.currentBytes > budget)
+    {
+        databasePager.targetMaxNumPagedLODWithHighResSubgraphs = std::max(numWithinBudget, 1u);
+    }
+    else
+    {
+        // allow as many more tiles as the remaining budget can hold at the current average tile size
+        uint64_t averageBytes = std::max<uint64_t>(_stats.currentBytes / _resident.size(), 1);
+        uint64_t headroom = (budget - _stats.currentBytes) / averageBytes;
+        databasePager.targetMaxNumPagedLODWithHighResSubgraphs = static_cast<uint32_t>(std::min<uint64_t>(_resident.size() + headroom, std::numeric_limits<uint32_t>::max()));
+    }
+}
+
+TileResidencyManager::Stats TileResidencyManager::getStats() const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return _stats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "DeferredRelease.h"
+
+// Bounds the device memory used by paged in tiles to a byte budget.
+// Each high resolution subgraph loaded by a PagedLOD is registered along with an estimate of the device memory it uses,
+// and is tracked from the point it is merged into the scene graph until it's expired. Resident tiles are ranked by their
+// screen-space size relative to the current camera, weighted down by the number of frames since they were last used,
+// and the DatabasePager is limited to keeping the highest ranked tiles that fit within the budget resident, it then
+// expires the least recently used tiles in excess of that.
+class TileResidencyManager : public vsg::Inherit<vsg::Object, TileResidencyManager>
+{
+public:
+    explicit TileResidencyManager(uint64_t in_budget);
+
+    // device memory budget in bytes.
+    uint64_t budget;
+
+    // number of frames that a tile has to go unused for its priority to halve.
+    double halfLifeFrames = 60.0;
+
+    // when set the manager keeps a reference to each tile's subgraph, so that once the DatabasePager expires it the last
+    // reference is handed to deferredRelease and the subgraph is destroyed off the main thread.
+    vsg::ref_ptr<DeferredRelease> deferredRelease;
+
+    // register the high resolution subgraph loaded for plod, thread safe so can be called from loading threads.
+    void loaded(vsg::ref_ptr<vsg::PagedLOD> plod, vsg::ref_ptr<vsg::Node> subgraph, uint64_t bytes);
+
+    // update the residency state and paging target, call once per frame after Viewer::update().
+    void update(vsg::DatabasePager& databasePager, const vsg::dvec3& eye, double fieldOfViewY);
+
+    struct Stats
+    {
+        uint64_t currentBytes = 0;
+        uint64_t peakBytes = 0;
+        uint64_t evictedBytes = 0;
+        uint64_t numResident = 0;
+        uint64_t numEvicted = 0;
+    };
+
+    Stats getStats() const;
+
+protected:
+    struct Tile
+    {
+        vsg::observer_ptr<vsg::PagedLOD> plod;
+        vsg::observer_ptr<vsg::Node> subgraph;
+        vsg::ref_ptr<vsg::Node> retained;
+        uint64_t bytes = 0;
+        double priority = 0.0;
+    };
+
+    mutable std::mutex _mutex;
+    std::vector<Tile> _pending;
+    std::vector<Tile> _resident;
+    Stats _stats;
+};
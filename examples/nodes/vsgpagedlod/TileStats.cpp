@@ -0,0 +1,150 @@
+#include "TileStats.h"
+
+#include <cmath>
+#include <unordered_map>
+
+uint32_t LatencyHistogram::bucket(double milliseconds)
+{
+    double microseconds = milliseconds * 1000.0;
+    if (microseconds <= 1.0) return 0;
+
+    auto index = static_cast<uint32_t>(std::ceil(std::log2(microseconds) * 4.0));
+    return std::min(index, numBuckets - 1);
+}
+
+double LatencyHistogram::bucketUpperBound(uint32_t index)
+{
+    return std::exp2(static_cast<double>(index) * 0.25) * 0.001;
+}
+
+void LatencyHistogram::add(const LatencyHistogram& rhs)
+{
+    for (uint32_t i = 0; i < numBuckets; ++i) buckets[i] += rhs.buckets[i];
+    count += rhs.count;
+    total += rhs.total;
+    maximum = std::max(maximum, rhs.maximum);
+}
+
+double LatencyHistogram::percentile(double p) const
+{
+    if (count == 0) return 0.0;
+
+    auto target = static_cast<uint64_t>(std::ceil(p * 0.01 * static_cast<double>(count)));
+    uint64_t cumulative = 0;
+    for (uint32_t i = 0; i < numBuckets; ++i)
+    {
+        cumulative += buckets[i];
+        if (cumulative >= target) return std::min(bucketUpperBound(i), maximum);
+    }
+    return maximum;
+}
+
+static std::atomic_uint64_t s_nextTileStatsID{0};
+
+TileStats::TileStats() :
+    _id(s_nextTileStatsID++)
+{
+}
+
+const char* TileStats::stageName(Stage stage)
+{
+    switch (stage)
+    {
+    case FETCH: return "fetch";
+    case PACK_READ: return "pack_read";
+    case BUILD: return "build";
+    case READ_TILE: return "read_tile";
+    default: return "unknown";
+    }
+}
+
+TileStats::ThreadStats& TileStats::local()
+{
+    // keyed by id rather than address so a new TileStats allocated at the address of a deleted one gets fresh counters
+    thread_local std::unordered_map<uint64_t, ThreadStats*> s_threadStats;
+
+    auto& threadStats = s_threadStats[_id];
+    if (!threadStats)
+    {
+        std::scoped_lock<std::mutex> lock(_threadsMutex);
+        _threads.push_back(std::make_unique<ThreadStats>());
+        threadStats = _threads.back().get();
+    }
+    return *threadStats;
+}
+
+void TileStats::record(Stage stage, double milliseconds)
+{
+    auto& threadStats = local();
+
+    auto relaxedIncrement = [](std::atomic_uint64_t& value, uint64_t delta) {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    };
+
+    auto microseconds = static_cast<uint64_t>(milliseconds * 1000.0);
+    relaxedIncrement(threadStats.buckets[stage][LatencyHistogram::bucket(milliseconds)], 1);
+    relaxedIncrement(threadStats.totalMicroseconds[stage], microseconds);
+    if (microseconds > threadStats.maximumMicroseconds[stage].load(std::memory_order_relaxed)) threadStats.maximumMicroseconds[stage].store(microseconds, std::memory_order_relaxed);
+}
+
+void TileStats::addBytes(uint64_t bytes)
+{
+    auto& threadStats = local();
+    threadStats.bytesRead.store(threadStats.bytesRead.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+}
+
+TileStats::Summary TileStats::merge() const
+{
+    Summary summary;
+
+    std::scoped_lock<std::mutex> lock(_threadsMutex);
+    for (auto& threadStats : _threads)
+    {
+        for (uint32_t s = 0; s < NUM_STAGES; ++s)
+        {
+            LatencyHistogram histogram;
+            for (uint32_t i = 0; i < LatencyHistogram::numBuckets; ++i)
+            {
+                histogram.buckets[i] = threadStats->buckets[s][i].load(std::memory_order_relaxed);
+                histogram.count += histogram.buckets[i];
+            }
+            histogram.total = static_cast<double>(threadStats->totalMicroseconds[s].load(std::memory_order_relaxed)) * 0.001;
+            histogram.maximum = static_cast<double>(threadStats->maximumMicroseconds[s].load(std::memory_order_relaxed)) * 0.001;
+
+            summary.stages[s].add(histogram);
+        }
+        summary.bytesRead += threadStats->bytesRead.load(std::memory_order_relaxed);
+    }
+
+    return summary;
+}
+
+void TileStats::print(std::ostream& out) const
+{
+    auto summary = merge();
+    for (uint32_t s = 0; s < NUM_STAGES; ++s)
+    {
+        auto& histogram = summary.stages[s];
+        if (histogram.count == 0) continue;
+
+        out << stageName(static_cast<Stage>(s)) << " : count = " << histogram.count << ", mean = " << histogram.mean() << "ms"
+            << ", p50 = " << histogram.percentile(50.0) << "ms, p95 = " << histogram.percentile(95.0) << "ms, p99 = " << histogram.percentile(99.0) << "ms"
+            << ", max = " << histogram.maximum << "ms" << std::endl;
+    }
+    out << "bytesRead = " << summary.bytesRead << std::endl;
+}
+
+void TileStats::writeCSV(std::ostream& out) const
+{
+    auto summary = merge();
+    out << "stage,bucket_upper_bound_ms,count" << std::endl;
+    for (uint32_t s = 0; s < NUM_STAGES; ++s)
+    {
+        auto& histogram = summary.stages[s];
+        for (uint32_t i = 0; i < LatencyHistogram::numBuckets; ++i)
+        {
+            if (histogram.buckets[i] > 0) out << stageName(static_cast<Stage>(s)) << "," << LatencyHistogram::bucketUpperBound(i) << "," << histogram.buckets[i] << std::endl;
+        }
+    }
+    out << "bytes_read,," << summary.bytesRead << std::endl;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <array>
+#include <atomic>
+#include <ostream>
+
+// Histogram of latencies with logarithmically spaced buckets, four per doubling from 1 microsecond up to ~4 hours.
+struct LatencyHistogram
+{
+    static constexpr uint32_t numBuckets = 136;
+
+    std::array<uint64_t, numBuckets> buckets{};
+    uint64_t count = 0;
+    double total = 0.0;
+    double maximum = 0.0;
+
+    static uint32_t bucket(double milliseconds);
+    static double bucketUpperBound(uint32_t index);
+
+    void add(const LatencyHistogram& rhs);
+
+    double mean() const { return count > 0 ? total / static_cast<double>(count) : 0.0; }
+
+    // upper bound of the bucket containing the specified percentile, in milliseconds.
+    double percentile(double p) const;
+};
+
+// Lock-free collection of tile loading stats.
+// Each thread records into its own block of counters so recording never contends with other threads,
+// the blocks are merged on demand when the stats are reported.
+class TileStats : public vsg::Inherit<vsg::Object, TileStats>
+{
+public:
+    TileStats();
+
+    enum Stage : uint32_t
+    {
+        FETCH,     // fetching and decoding a single tile layer
+        PACK_READ, // reading a tile from the tile pack cache
+        BUILD,     // building the tile subgraphs
+        READ_TILE, // complete read of a subtile request
+        NUM_STAGES
+    };
+
+    static const char* stageName(Stage stage);
+
+    void record(Stage stage, double milliseconds);
+    void addBytes(uint64_t bytes);
+
+    struct Summary
+    {
+        std::array<LatencyHistogram, NUM_STAGES> stages;
+        uint64_t bytesRead = 0;
+    };
+
+    Summary merge() const;
+
+    // print count, mean, p50, p95, p99 and max for each stage.
+    void print(std::ostream& out) const;
+
+    // write the merged histograms as comma separated values, one row per stage and non empty bucket.
+    void writeCSV(std::ostream& out) const;
+
+protected:
+    struct ThreadStats
+    {
+        // only written by the owning thread, relaxed atomics let other threads merge them at any time
+        std::array<std::array<std::atomic_uint64_t, LatencyHistogram::numBuckets>, NUM_STAGES> buckets{};
+        std::array<std::atomic_uint64_t, NUM_STAGES> totalMicroseconds{};
+        std::array<std::atomic_uint64_t, NUM_STAGES> maximumMicroseconds{};
+        std::atomic_uint64_t bytesRead{0};
+    };
+
+    ThreadStats& local();
+
+    const uint64_t _id;
+    mutable std::mutex _threadsMutex;
+    std::vector<std::unique_ptr<ThreadStats>> _threads;
+};
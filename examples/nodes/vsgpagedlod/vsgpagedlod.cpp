@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <fstream>
 #include <iostream>
 #include <thread>
 
@@ -79,6 +80,43 @@ int main(int argc, char** argv)
 
         arguments.read("-t", tileReader->lodTransitionScreenHeightRatio);
         arguments.read("-m", tileReader->maxLevel);
+        if (arguments.read("--terrain")) tileReader->terrainLayer = "http://readymap.org/readymap/tiles/1.0.0/116/{z}/{x}/{y}.tif";
+        if (arguments.read("--gpu-terrain")) tileReader->gpuTerrain = true;
+
+        // optionally read and populate a cache of GPU ready, block compressed tiles
+        if (vsg::Path tilePackDirectory; arguments.read("--tile-pack", tilePackDirectory))
+        {
+            auto levelsPerPack = arguments.value<uint32_t>(4, "--tile-pack-levels");
+            tileReader->tilePack = TilePackCache::create(tilePackDirectory, levelsPerPack);
+        }
+
+        // optionally fetch tile layers through a prioritized, cancellable request scheduler
+        if (uint32_t numSchedulerThreads = 0; arguments.read("--scheduler", numSchedulerThreads))
+        {
+            tileReader->scheduler = TileRequestScheduler::create(numSchedulerThreads);
+            tileReader->scheduler->minimumScreenHeightRatio = tileReader->lodTransitionScreenHeightRatio;
+            tileReader->scheduler->stats = tileReader->stats;
+            arguments.read("--cancel-ratio", tileReader->scheduler->cancelRatio);
+        }
+
+        // optionally bound the device memory used by paged in tiles, budget specified in megabytes
+        if (double residencyBudget = 0.0; arguments.read("--budget", residencyBudget))
+        {
+            tileReader->residency = TileResidencyManager::create(static_cast<uint64_t>(residencyBudget * 1024.0 * 1024.0));
+
+            // destroy expired tiles on a background thread rather than the main thread
+            if (arguments.read("--deferred-release")) tileReader->residency->deferredRelease = DeferredRelease::create();
+        }
+
+        // position tiles relative to an origin that follows the camera in steps of the given size, in metres
+        if (double bucketSize = 0.0; arguments.read("--camera-relative", bucketSize) && bucketSize > 0.0)
+        {
+            tileReader->cameraRelativeOrigin = CameraRelativeOrigin::create(bucketSize);
+        }
+
+        // optionally write the tile loading histograms on exit
+        vsg::Path statsFilename;
+        arguments.read("--stats-csv", statsFilename);
 
         const double invalid_value = std::numeric_limits<double>::max();
         double poi_latitude = invalid_value;
@@ -118,6 +156,14 @@ int main(int argc, char** argv)
         vsg_scene->accept(computeBounds);
         vsg::dvec3 centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
         double radius = vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.6;
+        if (tileReader->gpuTerrain)
+        {
+            // tile geometry is generated in the vertex shader so use the extents of the ellipsoid instead
+            double radiusEquator = tileReader->ellipsoidModel->radiusEquator();
+            double radiusPolar = tileReader->ellipsoidModel->radiusPolar();
+            centre = vsg::dvec3(0.0, 0.0, 0.0);
+            radius = vsg::length(vsg::dvec3(radiusEquator, radiusEquator, radiusPolar) * 2.0) * 0.6;
+        }
         double nearFarRatio = 0.0005;
 
         // set up the camera
@@ -244,16 +290,67 @@ int main(int argc, char** argv)
 
             viewer->update();
 
+            if (tileReader->scheduler || tileReader->residency)
+            {
+                auto eye = camera->viewMatrix->inverse() * vsg::dvec3(0.0, 0.0, 0.0);
+                double fieldOfViewY = 30.0;
+                if (auto ellipsoidPerspective = perspective.cast<vsg::EllipsoidPerspective>()) fieldOfViewY = ellipsoidPerspective->fieldOfViewY;
+                else if (auto standardPerspective = perspective.cast<vsg::Perspective>()) fieldOfViewY = standardPerspective->fieldOfViewY;
+
+                // keep the scheduler's view of the camera up to date so it can prioritize and cancel tile requests
+                if (tileReader->scheduler) tileReader->scheduler->update(eye, fieldOfViewY);
+
+                // rebalance the paging target against the device memory budget
+                if (tileReader->residency)
+                {
+                    for (auto& task : viewer->recordAndSubmitTasks)
+                    {
+                        if (task->databasePager) tileReader->residency->update(*task->databasePager, eye, fieldOfViewY);
+                    }
+                }
+            }
+
+            if (tileReader->cameraRelativeOrigin) tileReader->cameraRelativeOrigin->update(*camera->viewMatrix);
+
             viewer->recordAndSubmit();
 
             viewer->present();
         }
 
         {
-            std::scoped_lock<std::mutex> lock(tileReader->statsMutex);
             std::cout << "numOperationThreads = " << numOperationThreads << std::endl;
             std::cout << "numTilesRead = " << tileReader->numTilesRead << std::endl;
-            std::cout << "average TimeReadingTiles = " << (tileReader->totalTimeReadingTiles / static_cast<double>(tileReader->numTilesRead)) << std::endl;
+            std::cout << "numTilesCancelled = " << tileReader->numTilesCancelled << std::endl;
+            std::cout << "numTilesFromPack = " << tileReader->numTilesFromPack << std::endl;
+            std::cout << "numBytesRead = " << tileReader->numBytesRead << std::endl;
+            tileReader->stats->print(std::cout);
+        }
+
+        if (!statsFilename.empty())
+        {
+            std::ofstream fout(statsFilename.string());
+            tileReader->stats->writeCSV(fout);
+        }
+
+        if (tileReader->residency)
+        {
+            auto stats = tileReader->residency->getStats();
+            std::cout << "residency budget = " << tileReader->residency->budget << ", current bytes = " << stats.currentBytes << ", peak bytes = " << stats.peakBytes << std::endl;
+            std::cout << "residency numResident = " << stats.numResident << ", numEvicted = " << stats.numEvicted << ", evicted bytes = " << stats.evictedBytes << std::endl;
+            if (auto& deferredRelease = tileReader->residency->deferredRelease)
+            {
+                std::cout << "deferred release numReleased = " << deferredRelease->numReleased << ", numBatches = " << deferredRelease->numBatches << ", release time = " << double(deferredRelease->releaseTime) * 1e-6 << "ms" << std::endl;
+            }
+        }
+
+        if (tileReader->cameraRelativeOrigin) tileReader->cameraRelativeOrigin->report(std::cout);
+
+        if (tileReader->tilePack) tileReader->tilePack->flush();
+
+        if (tileReader->scheduler)
+        {
+            std::cout << "scheduler numFetched = " << tileReader->scheduler->numFetched << ", numCancelled = " << tileReader->scheduler->numCancelled << std::endl;
+            tileReader->scheduler->stop();
         }
     }
     catch (const vsg::Exception& ve)
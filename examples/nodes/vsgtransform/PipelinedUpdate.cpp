@@ -0,0 +1,128 @@
+#include "PipelinedUpdate.h"
+
+#include <cstring>
+
+DataSnapshot::DataSnapshot(vsg::ref_ptr<vsg::Data> in_data) :
+    data(in_data)
+{
+    auto begin = static_cast<const uint8_t*>(data->dataPointer());
+    _values.assign(begin, begin + data->dataSize());
+}
+
+void DataSnapshot::publish()
+{
+    std::memcpy(data->dataPointer(), _values.data(), _values.size());
+    data->dirty();
+}
+
+vsg::ref_ptr<SnapshotTransform> FrameSnapshots::createTransform(const vsg::dmat4& matrix)
+{
+    auto transform = SnapshotTransform::create();
+    transform->matrix = transform->published = matrix;
+    _transforms.push_back(transform);
+    return transform;
+}
+
+vsg::ref_ptr<DataSnapshot> FrameSnapshots::createSnapshot(vsg::ref_ptr<vsg::Data> data)
+{
+    data->properties.dataVariance = vsg::DYNAMIC_DATA;
+
+    auto snapshot = DataSnapshot::create(data);
+    _snapshots.push_back(snapshot);
+    return snapshot;
+}
+
+void FrameSnapshots::publish()
+{
+    for (auto& transform : _transforms)
+    {
+        if (transform->published == transform->matrix) continue;
+
+        transform->published = transform->matrix;
+        if (boundsCache) boundsCache->invalidate(transform);
+    }
+    for (auto& snapshot : _snapshots) snapshot->publish();
+    if (boundsCache) boundsCache->update();
+    ++numPublished;
+}
+
+RecordThread::RecordThread(vsg::ref_ptr<vsg::Viewer> in_viewer) :
+    viewer(in_viewer)
+{
+    _thread = std::thread([this]() { _run(); });
+}
+
+RecordThread::~RecordThread()
+{
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _done = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+}
+
+void RecordThread::start()
+{
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _recordRequested = true;
+        _recordCompleted = false;
+    }
+    _cv.notify_all();
+}
+
+void RecordThread::wait()
+{
+    auto startTime = vsg::clock::now();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [&]() { return _recordCompleted; });
+
+    totalWaitTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+
+    if (_exception)
+    {
+        auto exception = _exception;
+        _exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+void RecordThread::_run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _cv.wait(lock, [&]() { return _recordRequested || _done; });
+        if (_done) return;
+
+        _recordRequested = false;
+        lock.unlock();
+
+        auto startTime = vsg::clock::now();
+        std::exception_ptr exception;
+        try
+        {
+            viewer->recordAndSubmit();
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+        double recordTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+
+        lock.lock();
+        totalRecordTime += recordTime;
+        ++numFrames;
+        _exception = exception;
+        _recordCompleted = true;
+        _cv.notify_all();
+    }
+}
+
+void RecordThread::report(std::ostream& out) const
+{
+    double frames = numFrames > 0 ? static_cast<double>(numFrames) : 1.0;
+    out << "RecordThread frames = " << numFrames << ", average record = " << (totalRecordTime / frames) << "ms, average main thread wait = " << (totalWaitTime / frames) << "ms" << std::endl;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "BoundsCache.h"
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+// Transform with a matrix written by the application's update and a published copy used by the RecordTraversal, so the
+// update for the next frame can run while the current frame is being recorded. FrameSnapshots::publish() copies the
+// matrix to its published copy between frames.
+class SnapshotTransform : public vsg::Inherit<vsg::Transform, SnapshotTransform>
+{
+public:
+    vsg::dmat4 matrix;    // written by update
+    vsg::dmat4 published; // read by record, only written by FrameSnapshots::publish()
+
+    vsg::dmat4 transform(const vsg::dmat4& mv) const override { return mv * published; }
+};
+
+// Copy of a DYNAMIC_DATA Data's values written by the application's update, copied into data and marked dirty by
+// FrameSnapshots::publish() so that the transfer of data to the GPU, made during recordAndSubmit(), never sees a
+// partially updated array.
+class DataSnapshot : public vsg::Inherit<vsg::Object, DataSnapshot>
+{
+public:
+    explicit DataSnapshot(vsg::ref_ptr<vsg::Data> in_data);
+
+    vsg::ref_ptr<vsg::Data> data;
+
+    template<typename T>
+    T* values() { return reinterpret_cast<T*>(_values.data()); }
+
+    void publish();
+
+protected:
+    std::vector<uint8_t> _values;
+};
+
+// The SnapshotTransforms and DataSnapshots written by the application's update.
+class FrameSnapshots : public vsg::Inherit<vsg::Object, FrameSnapshots>
+{
+public:
+    vsg::ref_ptr<SnapshotTransform> createTransform(const vsg::dmat4& matrix = {});
+    vsg::ref_ptr<DataSnapshot> createSnapshot(vsg::ref_ptr<vsg::Data> data);
+
+    // optional cache of the scene's bounds, invalidated for each transform whose matrix changes and then updated so
+    // the CullNodes above them are culled with their new positions
+    vsg::ref_ptr<BoundsCache> boundsCache;
+
+    // make the update's values visible to record, call when no record is in progress
+    void publish();
+
+    uint64_t numPublished = 0;
+
+protected:
+    std::vector<vsg::ref_ptr<SnapshotTransform>> _transforms;
+    std::vector<vsg::ref_ptr<DataSnapshot>> _snapshots;
+};
+
+// Runs Viewer::recordAndSubmit() on a dedicated thread so the main thread can update the next frame's FrameSnapshots
+// while the current frame is recorded. The Viewer's event handling, update() and present() stay on the main thread,
+// as do any changes to the scene graph, only the snapshots being updated while a record is in progress. Exceptions
+// thrown by the record are passed on from wait().
+class RecordThread : public vsg::Inherit<vsg::Object, RecordThread>
+{
+public:
+    explicit RecordThread(vsg::ref_ptr<vsg::Viewer> in_viewer);
+    RecordThread(const RecordThread&) = delete;
+    RecordThread& operator=(const RecordThread&) = delete;
+
+    vsg::ref_ptr<vsg::Viewer> viewer;
+
+    // start recording the current frame
+    void start();
+
+    // wait for the record started by start() to complete
+    void wait();
+
+    // statistics, milliseconds
+    double totalRecordTime = 0.0;
+    double totalWaitTime = 0.0; // main thread time blocked in wait()
+    uint64_t numFrames = 0;
+
+    void report(std::ostream& out) const;
+
+protected:
+    virtual ~RecordThread();
+
+    void _run();
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _recordRequested = false;
+    bool _recordCompleted = true;
+    bool _done = false;
+    std::exception_ptr _exception;
+};
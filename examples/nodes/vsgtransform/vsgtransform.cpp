@@ -4,8 +4,161 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "BoundsCache.h"
+#include "PipelinedUpdate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 
+// Vehicles following each other around a multi-lane ring road with the intelligent driver model, each drawn as the
+// loaded model under a SnapshotTransform with an instanced marker, coloured by its speed, above it.
+class VehicleSimulation : public vsg::Inherit<vsg::Object, VehicleSimulation>
+{
+public:
+    struct Vehicle
+    {
+        double position; // distance along the lane
+        double speed;
+        double desiredSpeed;
+        vsg::ref_ptr<SnapshotTransform> transform;
+    };
+
+    struct Lane
+    {
+        double radius;
+        double length;
+        bool moving = true; // vehicles in lanes that aren't moving stay parked
+        std::vector<Vehicle> vehicles; // in order of position, each following the next
+    };
+
+    std::vector<Lane> lanes;
+    vsg::dvec3 modelCentre;
+    double vehicleLength = 1.0;
+    uint32_t numSubsteps = 1;
+
+    vsg::ref_ptr<DataSnapshot> markerPositions;
+    vsg::ref_ptr<DataSnapshot> markerColors;
+
+    VehicleSimulation(vsg::ref_ptr<FrameSnapshots> snapshots, vsg::ref_ptr<vsg::Node> model, uint32_t numVehicles, uint32_t numLanes, bool cull, vsg::Group& scene)
+    {
+        auto bounds = vsg::visit<vsg::ComputeBounds>(model).bounds;
+        modelCentre = (bounds.min + bounds.max) * 0.5;
+        vehicleLength = std::max(vsg::length(bounds.max - bounds.min), 1e-3);
+
+        numLanes = std::max(1u, std::min(numLanes, numVehicles));
+        uint32_t vehiclesPerLane = (numVehicles + numLanes - 1) / numLanes;
+        double spacing = vehicleLength * 3.0;
+        double innerRadius = std::max(vehicleLength * 4.0, spacing * static_cast<double>(vehiclesPerLane) / (2.0 * vsg::PI));
+
+        uint32_t numAssigned = 0;
+        for (uint32_t l = 0; l < numLanes && numAssigned < numVehicles; ++l)
+        {
+            auto& lane = lanes.emplace_back();
+            lane.radius = innerRadius + static_cast<double>(l) * vehicleLength * 1.5;
+            lane.length = 2.0 * vsg::PI * lane.radius;
+
+            uint32_t count = std::min(vehiclesPerLane, numVehicles - numAssigned);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                double variation = static_cast<double>(std::rand()) / static_cast<double>(RAND_MAX);
+                auto transform = snapshots->createTransform();
+                transform->addChild(model);
+                if (cull) scene.addChild(vsg::CullNode::create(vsg::dsphere(), transform)); // bound assigned by the BoundsCache
+                else scene.addChild(transform);
+                lane.vehicles.push_back(Vehicle{lane.length * static_cast<double>(i) / static_cast<double>(count), 0.0, vehicleLength * (8.0 + 6.0 * variation), transform});
+            }
+            numAssigned += count;
+        }
+
+        auto positions = vsg::vec3Array::create(numVehicles);
+        auto colors = vsg::vec4Array::create(numVehicles);
+        markerPositions = snapshots->createSnapshot(positions);
+        markerColors = snapshots->createSnapshot(colors);
+
+        vsg::Builder builder;
+        vsg::GeometryInfo geomInfo;
+        vsg::StateInfo stateInfo;
+        geomInfo.dx.set(static_cast<float>(vehicleLength) * 0.2f, 0.0f, 0.0f);
+        geomInfo.dy.set(0.0f, static_cast<float>(vehicleLength) * 0.2f, 0.0f);
+        geomInfo.dz.set(0.0f, 0.0f, static_cast<float>(vehicleLength) * 0.2f);
+        geomInfo.positions = positions;
+        geomInfo.colors = colors;
+        stateInfo.instance_positions_vec3 = true;
+        scene.addChild(builder.createBox(geomInfo, stateInfo));
+
+        write();
+    }
+
+    // advance the simulation by dt seconds, writing the SnapshotTransforms' matrices and the markers' snapshots
+    void update(double dt)
+    {
+        const double maxAcceleration = vehicleLength * 2.0;
+        const double comfortableDeceleration = vehicleLength * 3.0;
+        const double minimumGap = vehicleLength * 0.5;
+        const double timeHeadway = 1.0;
+
+        double h = dt / static_cast<double>(numSubsteps);
+        for (uint32_t step = 0; step < numSubsteps; ++step)
+        {
+            for (auto& lane : lanes)
+            {
+                if (!lane.moving) continue;
+
+                auto& vehicles = lane.vehicles;
+                for (size_t i = 0; i < vehicles.size(); ++i)
+                {
+                    auto& vehicle = vehicles[i];
+                    auto& leader = vehicles[(i + 1) % vehicles.size()];
+
+                    double acceleration = maxAcceleration * (1.0 - std::pow(vehicle.speed / vehicle.desiredSpeed, 4.0));
+                    if (&leader != &vehicle)
+                    {
+                        double gap = std::fmod(leader.position - vehicle.position + lane.length, lane.length) - vehicleLength;
+                        double desiredGap = minimumGap + vehicle.speed * timeHeadway + vehicle.speed * (vehicle.speed - leader.speed) / (2.0 * std::sqrt(maxAcceleration * comfortableDeceleration));
+                        acceleration -= maxAcceleration * std::pow(std::max(desiredGap, 0.0) / std::max(gap, minimumGap * 0.1), 2.0);
+                    }
+                    vehicle.speed = std::max(0.0, vehicle.speed + acceleration * h);
+                }
+
+                // the lane is a loop so vehicles keep their order, the first one wrapping around to follow the last
+                for (auto& vehicle : vehicles) vehicle.position += vehicle.speed * h;
+                while (!vehicles.empty() && vehicles.back().position >= lane.length)
+                {
+                    vehicles.back().position -= lane.length;
+                    std::rotate(vehicles.begin(), vehicles.end() - 1, vehicles.end());
+                }
+            }
+        }
+
+        write();
+    }
+
+protected:
+    void write()
+    {
+        auto positions = markerPositions->values<vsg::vec3>();
+        auto colors = markerColors->values<vsg::vec4>();
+
+        size_t index = 0;
+        for (auto& lane : lanes)
+        {
+            for (auto& vehicle : lane.vehicles)
+            {
+                double angle = vehicle.position / lane.radius;
+                vsg::dvec3 position(lane.radius * std::cos(angle), lane.radius * std::sin(angle), 0.0);
+                vehicle.transform->matrix = vsg::translate(position) * vsg::rotate(angle + vsg::PI * 0.5, 0.0, 0.0, 1.0) * vsg::translate(-modelCentre);
+
+                float relativeSpeed = static_cast<float>(std::min(vehicle.speed / vehicle.desiredSpeed, 1.0));
+                positions[index] = vsg::vec3(position + vsg::dvec3(0.0, 0.0, vehicleLength));
+                colors[index] = vsg::vec4(1.0f - relativeSpeed, relativeSpeed, 0.2f, 1.0f);
+                ++index;
+            }
+        }
+    }
+};
+
 int main(int argc, char** argv)
 {
     // set up defaults and read command line arguments to override them
@@ -40,6 +193,18 @@ int main(int argc, char** argv)
 
     auto outputFilename = arguments.value<std::string>("", "-o");
 
+    // simulate vehicles each drawn with the model, optionally updating the next frame while the current one is recorded
+    auto numVehicles = arguments.value(0u, "--vehicles");
+    auto numLanes = arguments.value(4u, "--lanes");
+    auto numSubsteps = arguments.value(1u, "--substeps");
+    bool pipelined = arguments.read("--pipelined");
+
+    // cull each vehicle with bounds cached and recomputed only for the vehicles that move, in the lanes given
+    bool cachedBounds = arguments.read("--cached-bounds");
+    auto numMovingLanes = arguments.value(numLanes, "--moving-lanes");
+
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
     if (argc<=1)
     {
         std::cout<<"Please specify model to load on command line."<<std::endl;
@@ -61,7 +226,18 @@ int main(int argc, char** argv)
 
     auto scene = vsg::Group::create();
 
-    if (!just_scale)
+    auto snapshots = FrameSnapshots::create();
+    vsg::ref_ptr<VehicleSimulation> simulation;
+    if (numVehicles > 0)
+    {
+        simulation = VehicleSimulation::create(snapshots, model, numVehicles, numLanes, cachedBounds, *scene);
+        simulation->numSubsteps = std::max(numSubsteps, 1u);
+        for (size_t l = numMovingLanes; l < simulation->lanes.size(); ++l) simulation->lanes[l].moving = false;
+
+        if (cachedBounds) snapshots->boundsCache = BoundsCache::create(scene);
+        snapshots->publish();
+    }
+    else if (!just_scale)
     {
         auto tm_1 = vsg::MatrixTransform::create();
         tm_1->matrix = vsg::translate(-radius*(0.75+scale*0.5), 0.0, 0.0);
@@ -69,12 +245,15 @@ int main(int argc, char** argv)
         scene->addChild(tm_1);
     }
 
-    auto tm_2 = vsg::MatrixTransform::create();
-    tm_2->matrix = vsg::translate(centre) * vsg::scale(scale, scale, scale) * vsg::translate(-centre);
-    tm_2->addChild(model);
-    scene->addChild(tm_2);
+    if (!simulation)
+    {
+        auto tm_2 = vsg::MatrixTransform::create();
+        tm_2->matrix = vsg::translate(centre) * vsg::scale(scale, scale, scale) * vsg::translate(-centre);
+        tm_2->addChild(model);
+        scene->addChild(tm_2);
+    }
 
-    if (!just_scale)
+    if (!just_scale && !simulation)
     {
         auto tm_3 = vsg::MatrixTransform::create();
         tm_3->matrix = vsg::translate(centre + vsg::dvec3(radius*(0.75+scale*0.5), 0.0, 0.0)) * vsg::rotate(vsg::radians(90.0), 1.0, 0.0, 0.0) * vsg::translate(-centre);
@@ -131,8 +310,14 @@ int main(int argc, char** argv)
 
     viewer->compile();
 
+    vsg::ref_ptr<RecordThread> recordThread;
+    if (pipelined && simulation) recordThread = RecordThread::create(viewer);
+
     auto startTime = vsg::clock::now();
     double numFramesCompleted = 0.0;
+    double totalSimulationTime = 0.0;
+    double totalPublishTime = 0.0;
+    double previousTime = 0.0;
 
     // rendering main loop
     while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
@@ -140,12 +325,62 @@ int main(int argc, char** argv)
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
         viewer->update();
-        viewer->recordAndSubmit();
-        viewer->present();
+
+        double simulationTime = viewer->getFrameStamp()->simulationTime;
+        double dt = std::min(simulationTime - previousTime, 0.1);
+        previousTime = simulationTime;
+
+        if (recordThread)
+        {
+            // record this frame from the published snapshots while simulating the next, the display trailing the simulation by a frame
+            recordThread->start();
+
+            auto simulationStart = vsg::clock::now();
+            simulation->update(dt);
+            totalSimulationTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - simulationStart).count();
+
+            recordThread->wait();
+            viewer->present();
+
+            auto publishStart = vsg::clock::now();
+            snapshots->publish();
+            totalPublishTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - publishStart).count();
+        }
+        else
+        {
+            if (simulation)
+            {
+                auto simulationStart = vsg::clock::now();
+                simulation->update(dt);
+                totalSimulationTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - simulationStart).count();
+
+                auto publishStart = vsg::clock::now();
+                snapshots->publish();
+                totalPublishTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - publishStart).count();
+            }
+
+            viewer->recordAndSubmit();
+            viewer->present();
+        }
 
         numFramesCompleted += 1.0;
     }
 
+    if (simulation && numFramesCompleted > 0.0)
+    {
+        std::cout << "Average simulation time = " << (totalSimulationTime / numFramesCompleted) << "ms, publish time = " << (totalPublishTime / numFramesCompleted) << "ms" << std::endl;
+    }
+    if (auto& boundsCache = snapshots->boundsCache)
+    {
+        boundsCache->report(std::cout);
+
+        // compare with walking the whole scene
+        auto computeStart = vsg::clock::now();
+        vsg::visit<vsg::ComputeBounds>(scene);
+        std::cout << "Full ComputeBounds of scene = " << std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - computeStart).count() << "ms" << std::endl;
+    }
+    if (recordThread) recordThread->report(std::cout);
+
     auto duration = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startTime).count();
     if (numFramesCompleted > 0.0)
     {
@@ -0,0 +1,187 @@
+#include "FrameScheduler.h"
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <ostream>
+
+namespace
+{
+    // AThermalStatus values from android/thermal.h
+    constexpr int ATHERMAL_STATUS_NONE = 0;
+
+    struct AndroidFunctions
+    {
+        AThermalManager* (*AThermal_acquireManager)() = nullptr;
+        void (*AThermal_releaseManager)(AThermalManager*) = nullptr;
+        int (*AThermal_getCurrentThermalStatus)(AThermalManager*) = nullptr;
+        float (*AThermal_getThermalHeadroom)(AThermalManager*, int) = nullptr;
+
+        APerformanceHintManager* (*APerformanceHint_getManager)() = nullptr;
+        APerformanceHintSession* (*APerformanceHint_createSession)(APerformanceHintManager*, const int32_t*, size_t, int64_t) = nullptr;
+        int (*APerformanceHint_reportActualWorkDuration)(APerformanceHintSession*, int64_t) = nullptr;
+        void (*APerformanceHint_closeSession)(APerformanceHintSession*) = nullptr;
+
+        AndroidFunctions()
+        {
+            // functions not provided by the device's API level are left null
+            void* handle = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+            if (!handle) return;
+
+            load(handle, AThermal_acquireManager, "AThermal_acquireManager");
+            load(handle, AThermal_releaseManager, "AThermal_releaseManager");
+            load(handle, AThermal_getCurrentThermalStatus, "AThermal_getCurrentThermalStatus");
+            load(handle, AThermal_getThermalHeadroom, "AThermal_getThermalHeadroom");
+
+            load(handle, APerformanceHint_getManager, "APerformanceHint_getManager");
+            load(handle, APerformanceHint_createSession, "APerformanceHint_createSession");
+            load(handle, APerformanceHint_reportActualWorkDuration, "APerformanceHint_reportActualWorkDuration");
+            load(handle, APerformanceHint_closeSession, "APerformanceHint_closeSession");
+        }
+
+        template<typename F>
+        static void load(void* handle, F& function, const char* name)
+        {
+            function = reinterpret_cast<F>(dlsym(handle, name));
+        }
+    };
+
+    const AndroidFunctions& android()
+    {
+        static AndroidFunctions functions;
+        return functions;
+    }
+
+    double secondsSince(vsg::clock::time_point start, vsg::clock::time_point now)
+    {
+        return std::chrono::duration<double>(now - start).count();
+    }
+} // namespace
+
+FrameScheduler::FrameScheduler()
+{
+    auto now = vsg::clock::now();
+    _lastInput = now;
+    _lastThermalPoll = now;
+    _lastStep = now;
+    _frameStart = now;
+
+    auto& functions = android();
+    if (functions.AThermal_acquireManager) _thermalManager = functions.AThermal_acquireManager();
+    if (functions.APerformanceHint_getManager) _hintManager = functions.APerformanceHint_getManager();
+}
+
+FrameScheduler::~FrameScheduler()
+{
+    stopSession();
+
+    auto& functions = android();
+    if (_thermalManager && functions.AThermal_releaseManager) functions.AThermal_releaseManager(_thermalManager);
+}
+
+void FrameScheduler::startSession()
+{
+    auto& functions = android();
+    if (_hintSession || !_hintManager || !functions.APerformanceHint_createSession) return;
+
+    // the session covers the calling thread, the one recording and submitting frames
+    int32_t threadId = gettid();
+    _hintSession = functions.APerformanceHint_createSession(_hintManager, &threadId, 1, targetFrameNanoseconds);
+}
+
+void FrameScheduler::stopSession()
+{
+    auto& functions = android();
+    if (_hintSession && functions.APerformanceHint_closeSession) functions.APerformanceHint_closeSession(_hintSession);
+    _hintSession = nullptr;
+}
+
+void FrameScheduler::inputEvent()
+{
+    _lastInput = vsg::clock::now();
+    _frameRequested = true;
+}
+
+bool FrameScheduler::animating() const
+{
+    return secondsSince(_lastInput, vsg::clock::now()) < idleTimeout;
+}
+
+void FrameScheduler::beginFrame()
+{
+    _frameStart = vsg::clock::now();
+    _frameRequested = false;
+}
+
+void FrameScheduler::endFrame()
+{
+    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(vsg::clock::now() - _frameStart).count();
+
+    ++_numFrames;
+    if (duration > targetFrameNanoseconds) ++_numOverTarget;
+
+    auto& functions = android();
+    if (_hintSession && functions.APerformanceHint_reportActualWorkDuration) functions.APerformanceHint_reportActualWorkDuration(_hintSession, duration);
+}
+
+float FrameScheduler::_thermalHeadroom()
+{
+    auto& functions = android();
+    if (!_thermalManager) return 0.0f;
+
+    // forecast 10 seconds ahead so the step down happens before the device reaches throttling
+    if (functions.AThermal_getThermalHeadroom)
+    {
+        float headroom = functions.AThermal_getThermalHeadroom(_thermalManager, 10);
+        if (!std::isnan(headroom)) return headroom;
+    }
+
+    // without a forecast treat any throttling status as being at the step down threshold
+    if (functions.AThermal_getCurrentThermalStatus)
+    {
+        return functions.AThermal_getCurrentThermalStatus(_thermalManager) > ATHERMAL_STATUS_NONE ? stepDownHeadroom : 0.0f;
+    }
+
+    return 0.0f;
+}
+
+bool FrameScheduler::updateResolutionScale()
+{
+    // the headroom is only updated by the system about once a second, so don't poll it every frame
+    auto now = vsg::clock::now();
+    if (secondsSince(_lastThermalPoll, now) < 2.0) return false;
+    _lastThermalPoll = now;
+
+    _headroom = _thermalHeadroom();
+
+    if (secondsSince(_lastStep, now) < stepInterval) return false;
+
+    if (_headroom >= stepDownHeadroom && (_resolutionIndex + 1) < resolutionScales.size())
+    {
+        ++_resolutionIndex;
+        ++_numStepsDown;
+    }
+    else if (_headroom < stepUpHeadroom && _resolutionIndex > 0)
+    {
+        --_resolutionIndex;
+        ++_numStepsUp;
+    }
+    else
+    {
+        return false;
+    }
+
+    _lastStep = now;
+    _frameRequested = true;
+    return true;
+}
+
+void FrameScheduler::report(std::ostream& out) const
+{
+    out << "frames " << _numFrames << ", over target " << _numOverTarget;
+    out << ", thermal headroom " << _headroom << ", resolution scale " << resolutionScale();
+    out << ", steps down " << _numStepsDown << ", steps up " << _numStepsUp;
+    out << ", performance hint session " << (_hintSession ? "active" : "unavailable");
+}
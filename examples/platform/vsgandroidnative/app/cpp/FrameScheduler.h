@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <cstdint>
+#include <vector>
+
+struct AThermalManager;
+struct APerformanceHintManager;
+struct APerformanceHintSession;
+
+// Decides when to render and at what resolution, so long sessions stay ahead of thermal throttling rather than
+// having the device halve clocks after a few minutes of continuous rendering.
+//  * frames are only rendered on demand once the scene and input have been idle for idleTimeout
+//  * the CPU time of each frame is reported to an ADPF performance hint session along with the target frame period,
+//    so the system can clock the cores to just meet it rather than race to idle
+//  * the thermal headroom forecast is polled and the internal resolution stepped down before it reaches throttling
+//
+// The thermal (API 30/31) and performance hint (API 33) functions are looked up from libandroid.so at runtime so the
+// app still runs on the minSdkVersion, where the scheduler falls back to just on demand rendering.
+class FrameScheduler : public vsg::Inherit<vsg::Object, FrameScheduler>
+{
+public:
+    FrameScheduler();
+
+    // frame period reported as the ADPF target work duration
+    int64_t targetFrameNanoseconds = 16666667;
+
+    // seconds without input after which the scene stops animating
+    double idleTimeout = 10.0;
+
+    // thermal headroom forecast, 1.0 being where throttling starts, above which the resolution steps down and below
+    // which it steps back up. Steps are at least stepInterval seconds apart so a step can take effect before the next.
+    float stepDownHeadroom = 0.85f;
+    float stepUpHeadroom = 0.65f;
+    double stepInterval = 10.0;
+    std::vector<float> resolutionScales{1.0f, 0.85f, 0.7f, 0.5f};
+
+    // start and stop the performance hint session, startSession() must be called from the rendering thread
+    void startSession();
+    void stopSession();
+
+    // input resets the idle timer
+    void inputEvent();
+
+    // request a frame without resetting the idle timer, such as after the window is shown or resized
+    void requestFrame() { _frameRequested = true; }
+
+    // true while the scene is animating, false once idle
+    bool animating() const;
+
+    // true if a frame should be rendered now, when false the main loop can block waiting for events
+    bool frameRequired() const { return _frameRequested || animating(); }
+
+    // bracket the CPU work of a frame, endFrame() reports its duration to the performance hint session
+    void beginFrame();
+    void endFrame();
+
+    // poll the thermal state and return true if resolutionScale() changed
+    bool updateResolutionScale();
+
+    float resolutionScale() const { return resolutionScales[_resolutionIndex]; }
+
+    void report(std::ostream& out) const;
+
+protected:
+    virtual ~FrameScheduler();
+
+    float _thermalHeadroom();
+
+    vsg::clock::time_point _lastInput;
+    vsg::clock::time_point _lastThermalPoll;
+    vsg::clock::time_point _lastStep;
+    vsg::clock::time_point _frameStart;
+    bool _frameRequested = true;
+    size_t _resolutionIndex = 0;
+    float _headroom = 0.0f;
+
+    AThermalManager* _thermalManager = nullptr;
+    APerformanceHintManager* _hintManager = nullptr;
+    APerformanceHintSession* _hintSession = nullptr;
+
+    // stats
+    uint64_t _numFrames = 0;
+    uint64_t _numOverTarget = 0;
+    uint64_t _numStepsDown = 0;
+    uint64_t _numStepsUp = 0;
+};
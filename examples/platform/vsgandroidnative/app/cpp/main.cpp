@@ -11,7 +11,17 @@
 #include <vsg/all.h>
 #include <vsg/platform/android/Android_Window.h>
 
+#ifdef vsgembed_FOUND
+#include "teapot_vsgb.cpp"
+#else
 #include "model_teapot.cpp"
+#endif
+
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
 
 #define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, "vsgnative", __VA_ARGS__))
 #define LOGW(...) ((void)__android_log_print(ANDROID_LOG_WARN, "vsgnative", __VA_ARGS__))
@@ -28,6 +38,11 @@ struct AppData
     vsg::ref_ptr<vsgAndroid::Android_Window> window;
     vsg::ref_ptr<vsg::Camera> camera;
     vsg::ref_ptr<vsg::MatrixTransform> scene;
+    vsg::ref_ptr<FrameScheduler> scheduler;
+
+    // size of the ANativeWindow before any resolution scaling
+    int32_t nativeWidth = 0;
+    int32_t nativeHeight = 0;
 
     bool animate = false;
     float time = 0.0f;
@@ -47,6 +62,15 @@ static void calculateCameraParameters(vsg::ref_ptr<vsg::Node> scene, vsg::ref_pt
     projectionMatrix = vsg::Perspective::create(30.0, static_cast<double>(window->extent2D().width) / static_cast<double>(window->extent2D().height), nearFarRatio * radius, radius * 6);
 }
 
+// set the window's buffers to the scheduler's resolution scale, the compositor scales them up to the display
+static void setBuffersGeometry(struct AppData* appData)
+{
+    float scale = appData->scheduler->resolutionScale();
+    int32_t width = std::max(1, static_cast<int32_t>(static_cast<float>(appData->nativeWidth) * scale));
+    int32_t height = std::max(1, static_cast<int32_t>(static_cast<float>(appData->nativeHeight) * scale));
+    ANativeWindow_setBuffersGeometry(appData->app->window, width, height, 0);
+}
+
 //
 // Init the vsg viewer and load assets
 //
@@ -60,6 +84,11 @@ static int vsg_init(struct AppData* appData)
     // setup traits
     appData->traits = vsg::WindowTraits::create();
     appData->traits->setValue("nativeWindow", appData->app->window);
+    // reset any scaling from a previous window on the same surface before reading its native size
+    ANativeWindow_setBuffersGeometry(appData->app->window, 0, 0, 0);
+    appData->nativeWidth = ANativeWindow_getWidth(appData->app->window);
+    appData->nativeHeight = ANativeWindow_getHeight(appData->app->window);
+    setBuffersGeometry(appData);
     appData->traits->width = ANativeWindow_getWidth(appData->app->window);
     appData->traits->height = ANativeWindow_getHeight(appData->app->window);
 
@@ -80,7 +109,9 @@ static int vsg_init(struct AppData* appData)
     appData->scene = vsg::MatrixTransform::create();
     auto rot = vsg::MatrixTransform::create(vsg::rotate(vsg::radians(90.0), 1.0, 0.0, 0.0));
     appData->scene->addChild(rot);
+    auto loadStart = std::chrono::steady_clock::now();
     rot->addChild( teapot() );
+    LOGI("Scene parsed in %fms", std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - loadStart).count());
 
     // cast the window to an android window so we can pass it events
     appData->window = window.cast<vsgAndroid::Android_Window>();
@@ -98,11 +129,20 @@ static int vsg_init(struct AppData* appData)
 
     appData->viewer->compile();
 
+    // frames are recorded and submitted on this thread, so the performance hint session is created for it
+    appData->scheduler->startSession();
+    appData->scheduler->inputEvent();
+
     return 0;
 }
 
 static void vsg_term(struct AppData* appData)
 {
+    std::ostringstream report;
+    appData->scheduler->report(report);
+    LOGI("Frame scheduler : %s", report.str().c_str());
+    appData->scheduler->stopSession();
+
     appData->traits = nullptr;
     appData->viewer = nullptr;
     appData->window = nullptr;
@@ -121,12 +161,15 @@ static void vsg_frame(struct AppData* appData)
     }
 
     if(appData->viewer->advanceToNextFrame()) {
+        // time the CPU work of the frame, not the wait for the swapchain image
+        appData->scheduler->beginFrame();
+
         // poll events and advance frame counters
         // pass any events into EventHandlers assigned to the Viewer
         appData->viewer->handleEvents();
 
         appData->viewer->update();
-        appData->time = appData->time + 0.033f;
+        if (appData->scheduler->animating()) appData->time = appData->time + 0.033f;
 
         // update
         appData->scene->matrix = vsg::rotate(static_cast<double>(- appData->time), 0.0, 0.0, 1.0);
@@ -134,8 +177,17 @@ static void vsg_frame(struct AppData* appData)
         // render
         appData->viewer->recordAndSubmit();
         appData->viewer->present();
+
+        appData->scheduler->endFrame();
     }
 
+    // step the resolution down ahead of the device throttling, Window::resize() rebuilds the swapchain at the new size
+    if (appData->scheduler->updateResolutionScale())
+    {
+        setBuffersGeometry(appData);
+        appData->window->resize();
+        LOGI("Thermal headroom, resolution scale now %f", appData->scheduler->resolutionScale());
+    }
 }
 
 //
@@ -144,7 +196,11 @@ static void vsg_frame(struct AppData* appData)
 static int32_t android_handleinput(struct android_app* app, AInputEvent* event)
 {
     struct AppData* appData = (struct AppData*)app->userData;
-    if(appData->window.valid()) return 0;
+    if(!appData->window.valid()) return 0;
+
+    // any input wakes the scene from idle
+    appData->scheduler->inputEvent();
+
     // pass the event to the vsg android window
     return appData->window->handleAndroidInputEvent(event) ? 1 : 0;
 }
@@ -168,12 +224,18 @@ static void android_handlecmd(struct android_app* app, int32_t cmd)
                 vsg_init(appData);
             }
             break;
+        case APP_CMD_WINDOW_RESIZED:
+        case APP_CMD_WINDOW_REDRAW_NEEDED:
+        case APP_CMD_CONFIG_CHANGED:
+            appData->scheduler->requestFrame();
+            break;
         case APP_CMD_TERM_WINDOW:
             // The window is being hidden or closed, clean it up.
             vsg_term(appData);
             break;
         case APP_CMD_GAINED_FOCUS:
             appData->animate = true;
+            appData->scheduler->inputEvent();
             break;
         case APP_CMD_LOST_FOCUS:
             appData->animate = false;
@@ -192,6 +254,7 @@ void android_main(struct android_app* app)
     app->onAppCmd = android_handlecmd;
     app->onInputEvent = android_handleinput;
     appData.app = app;
+    appData.scheduler = FrameScheduler::create();
 
     // Used to poll the events in the main loop
     int events;
@@ -200,14 +263,16 @@ void android_main(struct android_app* app)
     // main loop
     do
     {
-        // poll events
-        if (ALooper_pollAll(0, nullptr, &events, (void**)&source) >= 0)
+        // render if vulkan is ready, we are animating and the scheduler wants a frame
+        bool renderFrame = appData.animate && appData.viewer.valid() && appData.scheduler->frameRequired();
+
+        // poll events, blocking until the next one when there is no frame to render
+        if (ALooper_pollAll(renderFrame ? 0 : -1, nullptr, &events, (void**)&source) >= 0)
         {
             if (source != nullptr) source->process(app, source);
         }
 
-        // render if vulkan is ready and we are animating
-        if (appData.animate && appData.viewer.valid()) {
+        if (renderFrame && appData.viewer.valid()) {
             vsg_frame(&appData);
         }
     } while (app->destroyRequested == 0);
@@ -7,7 +7,12 @@
 
 #include <vsg/all.h>
 
+#ifdef vsgembed_FOUND
+#include "lz_vsgb.cpp"
+#else
 #include "lz.cpp"
+#endif
+#include <chrono>
 using namespace vsg;
 
 //------------------------------------------------------------------------
@@ -47,7 +52,9 @@ using namespace vsg;
     auto horizonMountainHeight=0;
     std::string pathFilename = "";
     vsg::ref_ptr<vsg::Window> window = self.window.vsgWindow;
+    auto loadStart = std::chrono::steady_clock::now();
     vsg::ref_ptr<vsg::Node> vsg_scene = lz();
+    NSLog(@"vsgiosnative : scene parsed in %fms", std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - loadStart).count());
 
     // compute the bounds of the scene graph to help position camera
     vsg::ComputeBounds computeBounds;
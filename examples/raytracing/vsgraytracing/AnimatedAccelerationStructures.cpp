@@ -0,0 +1,626 @@
+#include "AnimatedAccelerationStructures.h"
+
+#include <cstring>
+#include <limits>
+
+vsg::ref_ptr<vsg::Device> createDeviceWithBuildQueue(vsg::Window* window)
+{
+    auto& windowTraits = window->traits();
+    auto instance = window->getOrCreateInstance();
+    auto surface = window->getOrCreateSurface();
+    auto physicalDevice = window->getOrCreatePhysicalDevice();
+
+    auto [queueFamily, presentFamily] = physicalDevice->getQueueFamily(windowTraits->queueFlags, surface);
+    if (queueFamily < 0 || presentFamily < 0) return {};
+    if (physicalDevice->getQueueFamilyProperties()[queueFamily].queueCount < 2) return {};
+
+    vsg::QueueSettings queueSettings{vsg::QueueSetting{queueFamily, {1.0, 1.0}}};
+    if (presentFamily != queueFamily) queueSettings.push_back(vsg::QueueSetting{presentFamily, {1.0}});
+
+    vsg::Names requestedLayers;
+    if (windowTraits->debugLayer)
+    {
+        requestedLayers.push_back("VK_LAYER_KHRONOS_validation");
+        if (windowTraits->apiDumpLayer) requestedLayers.push_back("VK_LAYER_LUNARG_api_dump");
+    }
+    vsg::Names validatedNames = vsg::validateInstancelayerNames(requestedLayers);
+
+    vsg::Names deviceExtensions;
+    deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    deviceExtensions.insert(deviceExtensions.end(), windowTraits->deviceExtensionNames.begin(), windowTraits->deviceExtensionNames.end());
+
+    auto device = vsg::Device::create(physicalDevice, queueSettings, validatedNames, deviceExtensions, windowTraits->deviceFeatures, instance->getAllocationCallbacks());
+    window->setDevice(device);
+    return device;
+}
+
+// VK_KHR_acceleration_structure and VK_KHR_buffer_device_address entry points
+struct AnimatedAccelerationStructures::Functions
+{
+    explicit Functions(VkDevice device)
+    {
+        load(device, vkGetBufferDeviceAddressKHR, "vkGetBufferDeviceAddressKHR");
+        load(device, vkCreateAccelerationStructureKHR, "vkCreateAccelerationStructureKHR");
+        load(device, vkDestroyAccelerationStructureKHR, "vkDestroyAccelerationStructureKHR");
+        load(device, vkGetAccelerationStructureBuildSizesKHR, "vkGetAccelerationStructureBuildSizesKHR");
+        load(device, vkGetAccelerationStructureDeviceAddressKHR, "vkGetAccelerationStructureDeviceAddressKHR");
+        load(device, vkCmdBuildAccelerationStructuresKHR, "vkCmdBuildAccelerationStructuresKHR");
+        load(device, vkCmdCopyAccelerationStructureKHR, "vkCmdCopyAccelerationStructureKHR");
+        load(device, vkCmdWriteAccelerationStructuresPropertiesKHR, "vkCmdWriteAccelerationStructuresPropertiesKHR");
+    }
+
+    template<typename T>
+    static void load(VkDevice device, T& function, const char* name)
+    {
+        function = reinterpret_cast<T>(vkGetDeviceProcAddr(device, name));
+        if (!function) throw vsg::Exception{std::string("Error: AnimatedAccelerationStructures unable to load ") + name, VK_ERROR_EXTENSION_NOT_PRESENT};
+    }
+
+    PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR = nullptr;
+    PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR = nullptr;
+    PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR = nullptr;
+    PFN_vkGetAccelerationStructureBuildSizesKHR vkGetAccelerationStructureBuildSizesKHR = nullptr;
+    PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR = nullptr;
+    PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR = nullptr;
+    PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR = nullptr;
+    PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR = nullptr;
+};
+
+// records the frame's refits and TLAS update
+class UpdateAccelerationStructures : public vsg::Inherit<vsg::Command, UpdateAccelerationStructures>
+{
+public:
+    explicit UpdateAccelerationStructures(vsg::ref_ptr<AnimatedAccelerationStructures> in_accelerationStructures) :
+        accelerationStructures(in_accelerationStructures) {}
+
+    vsg::ref_ptr<AnimatedAccelerationStructures> accelerationStructures;
+
+    void record(vsg::CommandBuffer& commandBuffer) const override
+    {
+        accelerationStructures->recordBuilds(commandBuffer);
+    }
+};
+
+// binds the TLAS, whose handle stays the same through updates and rebuilds
+class DescriptorAnimatedTLAS : public vsg::Inherit<vsg::Descriptor, DescriptorAnimatedTLAS>
+{
+public:
+    DescriptorAnimatedTLAS(vsg::ref_ptr<AnimatedAccelerationStructures> in_accelerationStructures, uint32_t in_dstBinding, uint32_t in_dstArrayElement) :
+        Inherit(in_dstBinding, in_dstArrayElement, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR),
+        accelerationStructures(in_accelerationStructures) {}
+
+    vsg::ref_ptr<AnimatedAccelerationStructures> accelerationStructures;
+
+    void assignTo(vsg::Context& context, VkWriteDescriptorSet& wds) const override
+    {
+        Descriptor::assignTo(context, wds);
+
+        auto info = context.scratchMemory->allocate<VkWriteDescriptorSetAccelerationStructureKHR>(1);
+        info->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+        info->pNext = nullptr;
+        info->accelerationStructureCount = 1;
+        info->pAccelerationStructures = &accelerationStructures->_tlas.handle;
+
+        wds.descriptorCount = 1;
+        wds.pNext = info;
+    }
+};
+
+// record commands with function and wait for them to complete
+template<typename F>
+static void submitAndWait(vsg::Device* device, vsg::Queue* queue, F function)
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queue->queueFamilyIndex();
+
+    VkCommandPool commandPool;
+    if (vkCreateCommandPool(*device, &poolInfo, device->getAllocationCallbacks(), &commandPool) != VK_SUCCESS)
+    {
+        throw vsg::Exception{"Error: AnimatedAccelerationStructures unable to create command pool."};
+    }
+
+    VkCommandBufferAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = commandPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(*device, &allocateInfo, &commandBuffer);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    function(commandBuffer);
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    auto fence = vsg::Fence::create(device);
+    queue->submit(submitInfo, fence);
+    fence->wait(std::numeric_limits<uint64_t>::max());
+
+    vkDestroyCommandPool(*device, commandPool, device->getAllocationCallbacks());
+}
+
+static void accelerationStructureBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    barrier.dstAccessMask = dstAccessMask;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+AnimatedAccelerationStructures::AnimatedAccelerationStructures(vsg::ref_ptr<vsg::Device> in_device, uint32_t in_numFrames) :
+    device(in_device),
+    numFrames(std::max(in_numFrames, 1u)),
+    _functions(new Functions(*in_device))
+{
+}
+
+AnimatedAccelerationStructures::~AnimatedAccelerationStructures()
+{
+    for (auto& mesh : _meshes) destroyAccelerationStructure(mesh.blas);
+    destroyAccelerationStructure(_tlas);
+}
+
+uint32_t AnimatedAccelerationStructures::addMesh(vsg::ref_ptr<vsg::vec3Array> vertices, vsg::ref_ptr<vsg::uintArray> indices, bool deformable)
+{
+    Mesh mesh;
+    mesh.vertices = vertices;
+    mesh.indices = indices;
+    mesh.deformable = deformable;
+    _meshes.push_back(mesh);
+    return static_cast<uint32_t>(_meshes.size() - 1);
+}
+
+uint32_t AnimatedAccelerationStructures::addInstance(uint32_t mesh, const vsg::mat4& transform)
+{
+    _instances.push_back(Instance{mesh, transform});
+    _instancesModified = true;
+    return static_cast<uint32_t>(_instances.size() - 1);
+}
+
+void AnimatedAccelerationStructures::setTransform(uint32_t instance, const vsg::mat4& transform)
+{
+    _instances[instance].transform = transform;
+    _instancesModified = true;
+}
+
+void AnimatedAccelerationStructures::dirtyMesh(uint32_t mesh)
+{
+    if (_meshes[mesh].deformable) _meshes[mesh].modified = true;
+}
+
+AnimatedAccelerationStructures::HostBuffer AnimatedAccelerationStructures::createHostBuffer(VkDeviceSize size, VkBufferUsageFlags usage)
+{
+    HostBuffer hostBuffer;
+
+    hostBuffer.buffer = vsg::Buffer::create(size, usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_SHARING_MODE_EXCLUSIVE);
+    hostBuffer.buffer->compile(device);
+
+    VkMemoryAllocateFlagsInfo flagsInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO, nullptr, VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT, 0};
+    auto memory = vsg::DeviceMemory::create(device, hostBuffer.buffer->getMemoryRequirements(device->deviceID), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &flagsInfo);
+    hostBuffer.buffer->bind(memory, 0);
+
+    // the memory stays mapped for the lifetime of the buffer
+    if (memory->map(0, size, 0, &hostBuffer.data) != VK_SUCCESS)
+    {
+        throw vsg::Exception{"Error: AnimatedAccelerationStructures unable to map buffer."};
+    }
+
+    hostBuffer.address = getBufferDeviceAddress(hostBuffer.buffer);
+    return hostBuffer;
+}
+
+vsg::ref_ptr<vsg::Buffer> AnimatedAccelerationStructures::createDeviceBuffer(VkDeviceSize size, VkBufferUsageFlags usage)
+{
+    auto buffer = vsg::Buffer::create(size, usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_SHARING_MODE_EXCLUSIVE);
+    buffer->compile(device);
+
+    VkMemoryAllocateFlagsInfo flagsInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO, nullptr, VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT, 0};
+    auto memory = vsg::DeviceMemory::create(device, buffer->getMemoryRequirements(device->deviceID), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &flagsInfo);
+    buffer->bind(memory, 0);
+
+    return buffer;
+}
+
+VkDeviceAddress AnimatedAccelerationStructures::getBufferDeviceAddress(vsg::Buffer* buffer) const
+{
+    VkBufferDeviceAddressInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    info.buffer = buffer->vk(device->deviceID);
+    return _functions->vkGetBufferDeviceAddressKHR(*device, &info);
+}
+
+void AnimatedAccelerationStructures::createAccelerationStructure(AccelerationStructure& as, VkAccelerationStructureTypeKHR type, VkDeviceSize size)
+{
+    as.buffer = createDeviceBuffer(size, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR);
+
+    VkAccelerationStructureCreateInfoKHR createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+    createInfo.buffer = as.buffer->vk(device->deviceID);
+    createInfo.size = size;
+    createInfo.type = type;
+
+    if (_functions->vkCreateAccelerationStructureKHR(*device, &createInfo, device->getAllocationCallbacks(), &as.handle) != VK_SUCCESS)
+    {
+        throw vsg::Exception{"Error: AnimatedAccelerationStructures unable to create acceleration structure."};
+    }
+
+    VkAccelerationStructureDeviceAddressInfoKHR addressInfo{};
+    addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+    addressInfo.accelerationStructure = as.handle;
+    as.address = _functions->vkGetAccelerationStructureDeviceAddressKHR(*device, &addressInfo);
+}
+
+void AnimatedAccelerationStructures::destroyAccelerationStructure(AccelerationStructure& as)
+{
+    if (as.handle) _functions->vkDestroyAccelerationStructureKHR(*device, as.handle, device->getAllocationCallbacks());
+    as.handle = VK_NULL_HANDLE;
+    as.address = 0;
+    as.buffer = {};
+}
+
+VkBuildAccelerationStructureFlagsKHR AnimatedAccelerationStructures::blasFlags(const Mesh& mesh) const
+{
+    // the flags of an update must match those of the original build
+    if (mesh.deformable) return VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR;
+    return VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+}
+
+VkBuildAccelerationStructureFlagsKHR AnimatedAccelerationStructures::tlasFlags() const
+{
+    if (rebuildTLAS) return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR;
+    return VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+}
+
+VkAccelerationStructureGeometryKHR AnimatedAccelerationStructures::triangleGeometry(const Mesh& mesh, uint32_t frameIndex) const
+{
+    VkAccelerationStructureGeometryKHR geometry{};
+    geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+    geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+    geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+
+    auto& triangles = geometry.geometry.triangles;
+    triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+    triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+    triangles.vertexData.deviceAddress = mesh.vertexBuffers[mesh.deformable ? frameIndex : 0].address;
+    triangles.vertexStride = sizeof(vsg::vec3);
+    triangles.maxVertex = static_cast<uint32_t>(mesh.vertices->size()) - 1;
+    triangles.indexType = VK_INDEX_TYPE_UINT32;
+    triangles.indexData.deviceAddress = mesh.indexBuffer.address;
+
+    return geometry;
+}
+
+VkAccelerationStructureGeometryKHR AnimatedAccelerationStructures::instanceGeometry(uint32_t frameIndex) const
+{
+    VkAccelerationStructureGeometryKHR geometry{};
+    geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+    geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+    geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+
+    auto& instances = geometry.geometry.instances;
+    instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+    instances.arrayOfPointers = VK_FALSE;
+    instances.data.deviceAddress = _instanceBuffers[frameIndex].address;
+
+    return geometry;
+}
+
+void AnimatedAccelerationStructures::writeInstances(uint32_t frameIndex)
+{
+    auto vkInstances = static_cast<VkAccelerationStructureInstanceKHR*>(_instanceBuffers[frameIndex].data);
+    for (size_t i = 0; i < _instances.size(); ++i)
+    {
+        auto& instance = _instances[i];
+        auto& vkInstance = vkInstances[i];
+
+        // VkTransformMatrixKHR is a row major 3x4 matrix, vsg::mat4 is column major
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int column = 0; column < 4; ++column) vkInstance.transform.matrix[row][column] = instance.transform[column][row];
+        }
+
+        vkInstance.instanceCustomIndex = static_cast<uint32_t>(i);
+        vkInstance.mask = 0xff;
+        vkInstance.instanceShaderBindingTableRecordOffset = 0;
+        vkInstance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+        vkInstance.accelerationStructureReference = _meshes[instance.mesh].blas.address;
+    }
+}
+
+void AnimatedAccelerationStructures::compile(vsg::ref_ptr<vsg::Queue> queue)
+{
+    if (_tlas.handle || _meshes.empty() || _instances.empty()) return;
+
+    auto properties = device->getPhysicalDevice()->getProperties<VkPhysicalDeviceAccelerationStructurePropertiesKHR, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR>();
+    VkDeviceSize scratchAlignment = std::max(properties.minAccelerationStructureScratchOffsetAlignment, 1u);
+
+    // input buffers
+    for (auto& mesh : _meshes)
+    {
+        auto numVertexBuffers = mesh.deformable ? numFrames : 1;
+        for (uint32_t i = 0; i < numVertexBuffers; ++i)
+        {
+            mesh.vertexBuffers.push_back(createHostBuffer(mesh.vertices->dataSize(), VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR));
+            std::memcpy(mesh.vertexBuffers.back().data, mesh.vertices->dataPointer(), mesh.vertices->dataSize());
+        }
+
+        mesh.indexBuffer = createHostBuffer(mesh.indices->dataSize(), VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+        std::memcpy(mesh.indexBuffer.data, mesh.indices->dataPointer(), mesh.indices->dataSize());
+        mesh.modified = false;
+    }
+
+    for (uint32_t i = 0; i < numFrames; ++i)
+    {
+        _instanceBuffers.push_back(createHostBuffer(sizeof(VkAccelerationStructureInstanceKHR) * _instances.size(), VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR));
+    }
+
+    // size and create the BLASes, each with its own region of the scratch buffer so they can be built with a single command
+    VkDeviceSize scratchSize = 0;
+    std::vector<VkAccelerationStructureGeometryKHR> geometries;
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos;
+    std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRanges;
+    geometries.reserve(_meshes.size());
+
+    for (auto& mesh : _meshes)
+    {
+        geometries.push_back(triangleGeometry(mesh, 0));
+
+        VkAccelerationStructureBuildGeometryInfoKHR buildInfo{};
+        buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+        buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        buildInfo.flags = blasFlags(mesh);
+        buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+        buildInfo.geometryCount = 1;
+        buildInfo.pGeometries = &geometries.back();
+
+        uint32_t primitiveCount = static_cast<uint32_t>(mesh.indices->size() / 3);
+
+        VkAccelerationStructureBuildSizesInfoKHR sizes{};
+        sizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+        _functions->vkGetAccelerationStructureBuildSizesKHR(*device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, &primitiveCount, &sizes);
+
+        createAccelerationStructure(mesh.blas, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizes.accelerationStructureSize);
+        if (!mesh.deformable) staticSize += sizes.accelerationStructureSize;
+
+        mesh.blas.scratchOffset = scratchSize;
+        scratchSize = alignUp(scratchSize + std::max(sizes.buildScratchSize, sizes.updateScratchSize), scratchAlignment);
+
+        buildInfo.dstAccelerationStructure = mesh.blas.handle;
+        buildInfos.push_back(buildInfo);
+        buildRanges.push_back(VkAccelerationStructureBuildRangeInfoKHR{primitiveCount, 0, 0, 0});
+    }
+
+    // size and create the TLAS
+    auto tlasGeometry = instanceGeometry(0);
+
+    VkAccelerationStructureBuildGeometryInfoKHR tlasBuildInfo{};
+    tlasBuildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+    tlasBuildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+    tlasBuildInfo.flags = tlasFlags();
+    tlasBuildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    tlasBuildInfo.geometryCount = 1;
+    tlasBuildInfo.pGeometries = &tlasGeometry;
+
+    uint32_t numInstances = static_cast<uint32_t>(_instances.size());
+
+    VkAccelerationStructureBuildSizesInfoKHR tlasSizes{};
+    tlasSizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+    _functions->vkGetAccelerationStructureBuildSizesKHR(*device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &tlasBuildInfo, &numInstances, &tlasSizes);
+
+    createAccelerationStructure(_tlas, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, tlasSizes.accelerationStructureSize);
+    _tlas.scratchOffset = scratchSize;
+    scratchSize += std::max(tlasSizes.buildScratchSize, tlasSizes.updateScratchSize);
+
+    _scratchBuffer = createDeviceBuffer(scratchSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    _scratchAddress = getBufferDeviceAddress(_scratchBuffer);
+
+    for (size_t i = 0; i < buildInfos.size(); ++i) buildInfos[i].scratchData.deviceAddress = _scratchAddress + _meshes[i].blas.scratchOffset;
+
+    // build the BLASes and query the compacted sizes of the static ones
+    std::vector<VkAccelerationStructureKHR> staticHandles;
+    for (auto& mesh : _meshes)
+    {
+        if (!mesh.deformable) staticHandles.push_back(mesh.blas.handle);
+    }
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (!staticHandles.empty())
+    {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+        queryPoolInfo.queryCount = static_cast<uint32_t>(staticHandles.size());
+        vkCreateQueryPool(*device, &queryPoolInfo, device->getAllocationCallbacks(), &queryPool);
+    }
+
+    submitAndWait(device, queue, [&](VkCommandBuffer commandBuffer) {
+        std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> rangePointers;
+        for (auto& range : buildRanges) rangePointers.push_back(&range);
+
+        _functions->vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(buildInfos.size()), buildInfos.data(), rangePointers.data());
+
+        if (queryPool)
+        {
+            accelerationStructureBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
+
+            vkCmdResetQueryPool(commandBuffer, queryPool, 0, static_cast<uint32_t>(staticHandles.size()));
+            _functions->vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, static_cast<uint32_t>(staticHandles.size()), staticHandles.data(), VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool, 0);
+        }
+    });
+
+    // copy the static BLASes into compacted ones, then build the TLAS referencing them
+    std::vector<AccelerationStructure> originals;
+    if (queryPool)
+    {
+        std::vector<VkDeviceSize> compactedSizes(staticHandles.size());
+        vkGetQueryPoolResults(*device, queryPool, 0, static_cast<uint32_t>(compactedSizes.size()), compactedSizes.size() * sizeof(VkDeviceSize), compactedSizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        vkDestroyQueryPool(*device, queryPool, device->getAllocationCallbacks());
+
+        size_t query = 0;
+        for (auto& mesh : _meshes)
+        {
+            if (mesh.deformable) continue;
+
+            originals.push_back(mesh.blas);
+            mesh.blas = AccelerationStructure{};
+            createAccelerationStructure(mesh.blas, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, compactedSizes[query]);
+            compactedStaticSize += compactedSizes[query++];
+        }
+    }
+
+    for (uint32_t i = 0; i < numFrames; ++i) writeInstances(i);
+    _instancesModified = false;
+
+    tlasBuildInfo.dstAccelerationStructure = _tlas.handle;
+    tlasBuildInfo.scratchData.deviceAddress = _scratchAddress + _tlas.scratchOffset;
+
+    submitAndWait(device, queue, [&](VkCommandBuffer commandBuffer) {
+        size_t original = 0;
+        for (auto& mesh : _meshes)
+        {
+            if (mesh.deformable) continue;
+
+            VkCopyAccelerationStructureInfoKHR copyInfo{};
+            copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+            copyInfo.src = originals[original++].handle;
+            copyInfo.dst = mesh.blas.handle;
+            copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+            _functions->vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+        }
+
+        if (!originals.empty()) accelerationStructureBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
+
+        VkAccelerationStructureBuildRangeInfoKHR tlasRange{numInstances, 0, 0, 0};
+        const VkAccelerationStructureBuildRangeInfoKHR* tlasRangePointer = &tlasRange;
+        _functions->vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &tlasBuildInfo, &tlasRangePointer);
+    });
+
+    for (auto& as : originals) destroyAccelerationStructure(as);
+}
+
+vsg::ref_ptr<vsg::Descriptor> AnimatedAccelerationStructures::createDescriptor(uint32_t dstBinding, uint32_t dstArrayElement)
+{
+    return DescriptorAnimatedTLAS::create(vsg::ref_ptr<AnimatedAccelerationStructures>(this), dstBinding, dstArrayElement);
+}
+
+vsg::ref_ptr<vsg::Command> AnimatedAccelerationStructures::createUpdateCommand()
+{
+    return UpdateAccelerationStructures::create(vsg::ref_ptr<AnimatedAccelerationStructures>(this));
+}
+
+void AnimatedAccelerationStructures::update(uint64_t frameCount, vsg::ref_ptr<vsg::Fence> fence)
+{
+    if (fence && fence->hasDependencies()) fence->wait(std::numeric_limits<uint64_t>::max());
+
+    _frameIndex = static_cast<uint32_t>(frameCount % numFrames);
+
+    _refitMeshes.clear();
+    for (size_t i = 0; i < _meshes.size(); ++i)
+    {
+        auto& mesh = _meshes[i];
+        if (!mesh.modified) continue;
+
+        std::memcpy(mesh.vertexBuffers[_frameIndex].data, mesh.vertices->dataPointer(), mesh.vertices->dataSize());
+        mesh.modified = false;
+        _refitMeshes.push_back(static_cast<uint32_t>(i));
+    }
+
+    // a refitted BLAS changes the bounds of the instances that reference it, so the TLAS needs updating too
+    _updateTLAS = _instancesModified || !_refitMeshes.empty();
+    if (_updateTLAS)
+    {
+        writeInstances(_frameIndex);
+        _instancesModified = false;
+        ++numTLASUpdates;
+    }
+
+    numRefits += _refitMeshes.size();
+}
+
+void AnimatedAccelerationStructures::recordBuilds(VkCommandBuffer commandBuffer) const
+{
+    if (!_tlas.handle || (_refitMeshes.empty() && !_updateTLAS)) return;
+
+    // the previous frame's ray tracing and builds must be complete before the acceleration structures and scratch buffer are rewritten
+    VkMemoryBarrier previousBarrier{};
+    previousBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    previousBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    previousBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &previousBarrier, 0, nullptr, 0, nullptr);
+
+    if (!_refitMeshes.empty())
+    {
+        std::vector<VkAccelerationStructureGeometryKHR> geometries;
+        std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos;
+        std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRanges;
+        geometries.reserve(_refitMeshes.size());
+        buildRanges.reserve(_refitMeshes.size());
+
+        for (auto i : _refitMeshes)
+        {
+            auto& mesh = _meshes[i];
+            geometries.push_back(triangleGeometry(mesh, _frameIndex));
+
+            VkAccelerationStructureBuildGeometryInfoKHR buildInfo{};
+            buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+            buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+            buildInfo.flags = blasFlags(mesh);
+            buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+            buildInfo.srcAccelerationStructure = mesh.blas.handle;
+            buildInfo.dstAccelerationStructure = mesh.blas.handle;
+            buildInfo.geometryCount = 1;
+            buildInfo.pGeometries = &geometries.back();
+            buildInfo.scratchData.deviceAddress = _scratchAddress + mesh.blas.scratchOffset;
+            buildInfos.push_back(buildInfo);
+
+            buildRanges.push_back(VkAccelerationStructureBuildRangeInfoKHR{static_cast<uint32_t>(mesh.indices->size() / 3), 0, 0, 0});
+        }
+
+        std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> rangePointers;
+        for (auto& range : buildRanges) rangePointers.push_back(&range);
+
+        _functions->vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(buildInfos.size()), buildInfos.data(), rangePointers.data());
+
+        accelerationStructureBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
+    }
+
+    if (_updateTLAS)
+    {
+        auto geometry = instanceGeometry(_frameIndex);
+
+        VkAccelerationStructureBuildGeometryInfoKHR buildInfo{};
+        buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+        buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+        buildInfo.flags = tlasFlags();
+        buildInfo.mode = rebuildTLAS ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+        buildInfo.srcAccelerationStructure = rebuildTLAS ? VK_NULL_HANDLE : _tlas.handle;
+        buildInfo.dstAccelerationStructure = _tlas.handle;
+        buildInfo.geometryCount = 1;
+        buildInfo.pGeometries = &geometry;
+        buildInfo.scratchData.deviceAddress = _scratchAddress + _tlas.scratchOffset;
+
+        VkAccelerationStructureBuildRangeInfoKHR range{static_cast<uint32_t>(_instances.size()), 0, 0, 0};
+        const VkAccelerationStructureBuildRangeInfoKHR* rangePointer = &range;
+        _functions->vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildInfo, &rangePointer);
+    }
+
+    accelerationStructureBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// assign the window a device with two queues in its graphics family, the second for building acceleration structures
+// alongside the ray tracing on the first. Returns null if the family only has one queue, call before the window's device is created.
+extern vsg::ref_ptr<vsg::Device> createDeviceWithBuildQueue(vsg::Window* window);
+
+// Acceleration structures for scenes whose instances move and whose meshes may deform, maintained with raw Vulkan calls
+// so they can be updated in place each frame rather than rebuilt from scratch as vsg::TopLevelAccelerationStructure is.
+// Static meshes get a BLAS built once for fast tracing and then compacted. Deformable meshes get a BLAS that allows
+// updates and is refitted, VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR, in the frames their vertices are modified.
+// Moving instances only rewrite the TLAS instance buffer, the TLAS is then updated in place or, with rebuildTLAS, rebuilt.
+// The vertex and instance buffers are host visible and duplicated for each frame in flight so the CPU can write the next
+// frame's data while the previous frame's builds are still executing.
+class AnimatedAccelerationStructures : public vsg::Inherit<vsg::Object, AnimatedAccelerationStructures>
+{
+public:
+    AnimatedAccelerationStructures(vsg::ref_ptr<vsg::Device> in_device, uint32_t in_numFrames);
+
+    const vsg::ref_ptr<vsg::Device> device;
+    const uint32_t numFrames;
+
+    // rebuild the TLAS each frame rather than updating it, keeps the trace quality when instances move a long way.
+    bool rebuildTLAS = false;
+
+    // returns the index of the mesh, vertices of deformable meshes may be modified after compile(), followed by a call to dirtyMesh().
+    uint32_t addMesh(vsg::ref_ptr<vsg::vec3Array> vertices, vsg::ref_ptr<vsg::uintArray> indices, bool deformable);
+
+    // returns the index of the instance
+    uint32_t addInstance(uint32_t mesh, const vsg::mat4& transform);
+
+    void setTransform(uint32_t instance, const vsg::mat4& transform);
+    void dirtyMesh(uint32_t mesh);
+
+    // create and build the acceleration structures, compacting the static BLASes, using one time submissions to queue.
+    void compile(vsg::ref_ptr<vsg::Queue> queue);
+
+    // descriptor of the TLAS for the ray tracing shaders
+    vsg::ref_ptr<vsg::Descriptor> createDescriptor(uint32_t dstBinding, uint32_t dstArrayElement = 0);
+
+    // command that records the refits and the TLAS update for the current frame, to be placed in a command graph ahead of the ray tracing.
+    vsg::ref_ptr<vsg::Command> createUpdateCommand();
+
+    // copy the current transforms and modified vertices into the buffers for the frame, first waiting on fence, signalled by the
+    // submission that last read those buffers. Call before Viewer::recordAndSubmit().
+    void update(uint64_t frameCount, vsg::ref_ptr<vsg::Fence> fence = {});
+
+    // statistics
+    VkDeviceSize staticSize = 0;          // BLAS size of the static meshes before compaction
+    VkDeviceSize compactedStaticSize = 0; // BLAS size of the static meshes after compaction
+    uint64_t numRefits = 0;
+    uint64_t numTLASUpdates = 0;
+
+    struct Functions;
+
+protected:
+    virtual ~AnimatedAccelerationStructures();
+
+    struct HostBuffer
+    {
+        vsg::ref_ptr<vsg::Buffer> buffer;
+        void* data = nullptr; // persistently mapped
+        VkDeviceAddress address = 0;
+    };
+
+    struct AccelerationStructure
+    {
+        vsg::ref_ptr<vsg::Buffer> buffer;
+        VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
+        VkDeviceAddress address = 0;
+        VkDeviceSize scratchOffset = 0;
+    };
+
+    struct Mesh
+    {
+        vsg::ref_ptr<vsg::vec3Array> vertices;
+        vsg::ref_ptr<vsg::uintArray> indices;
+        bool deformable = false;
+        bool modified = false;
+
+        std::vector<HostBuffer> vertexBuffers; // one per frame for deformable meshes
+        HostBuffer indexBuffer;
+        AccelerationStructure blas;
+    };
+
+    struct Instance
+    {
+        uint32_t mesh;
+        vsg::mat4 transform;
+    };
+
+    void recordBuilds(VkCommandBuffer commandBuffer) const;
+
+    HostBuffer createHostBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+    vsg::ref_ptr<vsg::Buffer> createDeviceBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+    VkDeviceAddress getBufferDeviceAddress(vsg::Buffer* buffer) const;
+
+    void createAccelerationStructure(AccelerationStructure& as, VkAccelerationStructureTypeKHR type, VkDeviceSize size);
+    void destroyAccelerationStructure(AccelerationStructure& as);
+
+    VkBuildAccelerationStructureFlagsKHR blasFlags(const Mesh& mesh) const;
+    VkBuildAccelerationStructureFlagsKHR tlasFlags() const;
+
+    VkAccelerationStructureGeometryKHR triangleGeometry(const Mesh& mesh, uint32_t frameIndex) const;
+    VkAccelerationStructureGeometryKHR instanceGeometry(uint32_t frameIndex) const;
+
+    void writeInstances(uint32_t frameIndex);
+
+    std::unique_ptr<Functions> _functions;
+    std::vector<Mesh> _meshes;
+    std::vector<Instance> _instances;
+    bool _instancesModified = true;
+
+    std::vector<HostBuffer> _instanceBuffers; // one per frame
+    vsg::ref_ptr<vsg::Buffer> _scratchBuffer;
+    VkDeviceAddress _scratchAddress = 0;
+    AccelerationStructure _tlas;
+
+    // which of the per frame buffers the current frame uses and the meshes it refits
+    uint32_t _frameIndex = 0;
+    std::vector<uint32_t> _refitMeshes;
+    bool _updateTLAS = false;
+
+    friend class UpdateAccelerationStructures;
+    friend class DescriptorAnimatedTLAS;
+};
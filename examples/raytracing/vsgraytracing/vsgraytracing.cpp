@@ -5,6 +5,8 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "AnimatedAccelerationStructures.h"
+
 struct RayTracingUniform
 {
     vsg::mat4 viewInverse;
@@ -17,6 +19,44 @@ public:
     RayTracingUniformValue() {}
 };
 
+// octahedron of unit radius for the static instances
+void createOctahedron(vsg::ref_ptr<vsg::vec3Array>& vertices, vsg::ref_ptr<vsg::uintArray>& indices)
+{
+    vertices = vsg::vec3Array::create({{1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}});
+    indices = vsg::uintArray::create({0, 2, 4, 2, 1, 4, 1, 3, 4, 3, 0, 4, 2, 0, 5, 1, 2, 5, 3, 1, 5, 0, 3, 5});
+}
+
+// grid of numColumns x numRows quads in the xy plane, rippled by animateGrid() for the deformable instances
+void createGrid(uint32_t numColumns, uint32_t numRows, vsg::ref_ptr<vsg::vec3Array>& vertices, vsg::ref_ptr<vsg::uintArray>& indices)
+{
+    vertices = vsg::vec3Array::create((numColumns + 1) * (numRows + 1));
+    indices = vsg::uintArray::create(numColumns * numRows * 6);
+
+    auto index = indices->begin();
+    for (uint32_t r = 0; r < numRows; ++r)
+    {
+        for (uint32_t c = 0; c < numColumns; ++c)
+        {
+            uint32_t i = r * (numColumns + 1) + c;
+            for (auto v : {i, i + 1, i + numColumns + 2, i, i + numColumns + 2, i + numColumns + 1}) *(index++) = v;
+        }
+    }
+}
+
+void animateGrid(uint32_t numColumns, uint32_t numRows, vsg::vec3Array& vertices, double time)
+{
+    for (uint32_t r = 0; r <= numRows; ++r)
+    {
+        for (uint32_t c = 0; c <= numColumns; ++c)
+        {
+            float x = 2.0f * float(c) / float(numColumns) - 1.0f;
+            float y = 2.0f * float(r) / float(numRows) - 1.0f;
+            float z = 0.2f * std::sin(4.0f * (x + y) + 3.0f * float(time));
+            vertices.set(r * (numColumns + 1) + c, vsg::vec3(x, y, z));
+        }
+    }
+}
+
 int main(int argc, char** argv)
 {
     try
@@ -43,6 +83,12 @@ int main(int argc, char** argv)
         arguments.read("--screen", windowTraits->screenNum);
         auto numFrames = arguments.value(-1, "-f");
 
+        // benchmark of animated instances, alternating between static octahedra and deforming grids sharing numDeformable BLASes
+        auto numAnimated = arguments.value<uint32_t>(0, "--animated");
+        auto numDeformable = arguments.value<uint32_t>(1, "--deformable");
+        bool rebuildTLAS = arguments.read("--rebuild-tlas");
+        bool sameQueue = arguments.read("--same-queue");
+
         vsg::Path filename;
         if (argc > 1) filename = arguments[1];
 
@@ -123,7 +169,17 @@ int main(int argc, char** argv)
         vsg::ref_ptr<vsg::Device> device;
         try
         {
-            device = window->getOrCreateDevice();
+            // build the animated acceleration structures on a second queue unless the graphics family only has one
+            if (numAnimated > 0 && !sameQueue)
+            {
+                device = createDeviceWithBuildQueue(window);
+                if (!device)
+                {
+                    std::cout << "Graphics queue family has a single queue, building acceleration structures on the rendering queue." << std::endl;
+                    sameQueue = true;
+                }
+            }
+            if (!device) device = window->getOrCreateDevice();
         }
         catch (const vsg::Exception& exception)
         {
@@ -132,7 +188,38 @@ int main(int argc, char** argv)
         }
 
         vsg::ref_ptr<vsg::TopLevelAccelerationStructure> tlas;
-        if (!filename)
+        vsg::ref_ptr<AnimatedAccelerationStructures> animated;
+        std::vector<vsg::ref_ptr<vsg::vec3Array>> gridVertices;
+        const uint32_t gridSize = 32;
+        uint32_t numInstanceColumns = 0;
+        if (numAnimated > 0)
+        {
+            animated = AnimatedAccelerationStructures::create(device, window->numFrames());
+            animated->rebuildTLAS = rebuildTLAS;
+
+            vsg::ref_ptr<vsg::vec3Array> vertices;
+            vsg::ref_ptr<vsg::uintArray> indices;
+            createOctahedron(vertices, indices);
+            animated->addMesh(vertices, indices, false);
+
+            for (uint32_t i = 0; i < numDeformable; ++i)
+            {
+                createGrid(gridSize, gridSize, vertices, indices);
+                animateGrid(gridSize, gridSize, *vertices, 0.0);
+                gridVertices.push_back(vertices);
+                animated->addMesh(vertices, indices, true);
+            }
+
+            numInstanceColumns = static_cast<uint32_t>(std::ceil(std::sqrt(double(numAnimated))));
+            for (uint32_t i = 0; i < numAnimated; ++i)
+            {
+                animated->addInstance(i % (numDeformable + 1), vsg::mat4());
+            }
+
+            double extent = 3.0 * numInstanceColumns;
+            lookAt = vsg::LookAt::create(vsg::dvec3(0.0, 0.0, -extent), vsg::dvec3(0.0, 0.0, 0.0), vsg::dvec3(0.0, 1.0, 0.0));
+        }
+        else if (!filename)
         {
             // acceleration structures
             // set up vertex and index arrays
@@ -217,7 +304,11 @@ int main(int argc, char** argv)
         auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
 
         // create DescriptorSets and binding to bind our TopLevelAcceleration structure, storage image and camera matrix uniforms
-        auto accelDescriptor = vsg::DescriptorAccelerationStructure::create(vsg::AccelerationStructures{tlas}, 0, 0);
+        vsg::ref_ptr<vsg::Descriptor> accelDescriptor;
+        if (animated)
+            accelDescriptor = animated->createDescriptor(0, 0);
+        else
+            accelDescriptor = vsg::DescriptorAccelerationStructure::create(vsg::AccelerationStructures{tlas}, 0, 0);
 
         auto storageImageDescriptor = vsg::DescriptorImage::create(storageImageInfo, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 
@@ -259,15 +350,53 @@ int main(int argc, char** argv)
 
         auto copyImageViewToWindow = vsg::CopyImageViewToWindow::create(storageImageInfo->imageView, window);
 
+        if (animated && sameQueue) commandGraph->addChild(animated->createUpdateCommand());
+
         commandGraph->addChild(scenegraph);
         commandGraph->addChild(copyImageViewToWindow);
 
         viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
+        vsg::ref_ptr<vsg::RecordAndSubmitTask> buildTask;
+        vsg::ref_ptr<vsg::Semaphore> traceComplete;
+        if (animated)
+        {
+            auto buildQueue = sameQueue ? device->getQueue(commandGraph->queueFamily) : device->getQueue(commandGraph->queueFamily, 1);
+            animated->compile(buildQueue);
+
+            std::cout << "Static BLAS size " << animated->staticSize << " bytes, compacted to " << animated->compactedStaticSize << " bytes" << std::endl;
+
+            if (!sameQueue)
+            {
+                // the builds for a frame are submitted to the second queue ahead of the frame's ray tracing, which waits
+                // for them, and from the second frame on the builds wait for the previous frame's ray tracing.
+                auto buildCommandGraph = vsg::CommandGraph::create(device, commandGraph->queueFamily);
+                buildCommandGraph->addChild(animated->createUpdateCommand());
+
+                buildTask = vsg::RecordAndSubmitTask::create(device, window->numFrames());
+                buildTask->commandGraphs.push_back(buildCommandGraph);
+                buildTask->queue = buildQueue;
+
+                auto buildComplete = vsg::Semaphore::create(device, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
+                traceComplete = vsg::Semaphore::create(device, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR);
+
+                auto& graphicsTask = viewer->recordAndSubmitTasks.front();
+                buildTask->signalSemaphores.push_back(buildComplete);
+                graphicsTask->waitSemaphores.push_back(buildComplete);
+                graphicsTask->signalSemaphores.push_back(traceComplete);
+
+                viewer->recordAndSubmitTasks.insert(viewer->recordAndSubmitTasks.begin(), buildTask);
+            }
+        }
+
         viewer->addEventHandler(vsg::Trackball::create(camera));
 
         viewer->compile();
 
+        auto startTime = vsg::clock::now();
+        double animationTime = 0.0;
+        uint64_t frameCount = 0;
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
@@ -280,9 +409,45 @@ int main(int argc, char** argv)
 
             viewer->update();
 
+            if (animated)
+            {
+                auto animationStart = vsg::clock::now();
+                double time = viewer->getFrameStamp()->simulationTime;
+
+                for (uint32_t i = 0; i < numAnimated; ++i)
+                {
+                    double x = 3.0 * (double(i % numInstanceColumns) - 0.5 * double(numInstanceColumns - 1));
+                    double y = 3.0 * (double(i / numInstanceColumns) - 0.5 * double(numInstanceColumns - 1));
+                    double z = std::sin(time + 0.1 * i);
+                    animated->setTransform(i, vsg::mat4(vsg::translate(x, y, z) * vsg::rotate(time + 0.1 * i, 0.0, 1.0, 0.0)));
+                }
+
+                for (uint32_t i = 0; i < numDeformable; ++i)
+                {
+                    animateGrid(gridSize, gridSize, *gridVertices[i], time + i);
+                    animated->dirtyMesh(i + 1);
+                }
+
+                auto& readingTask = buildTask ? buildTask : viewer->recordAndSubmitTasks.front();
+                animated->update(frameCount, readingTask->fence());
+                animationTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - animationStart).count();
+
+                if (buildTask && frameCount == 1) buildTask->waitSemaphores.push_back(traceComplete);
+            }
+
             viewer->recordAndSubmit();
 
             viewer->present();
+
+            ++frameCount;
+        }
+
+        if (animated && frameCount > 0)
+        {
+            auto duration = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+            std::cout << "Average frame time = " << duration / double(frameCount) << " ms" << std::endl;
+            std::cout << "Average animation update time = " << animationTime / double(frameCount) << " ms" << std::endl;
+            std::cout << "BLAS refits = " << animated->numRefits << ", TLAS " << (rebuildTLAS ? "rebuilds = " : "updates = ") << animated->numTLASUpdates << std::endl;
         }
 
         // clean up done automatically thanks to ref_ptr<>
@@ -1,6 +1,11 @@
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <map>
 #include <vsg/all.h>
 
+#include "BoundsCache.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -35,6 +40,101 @@ public:
     }
 };
 
+// CPU counterpart of the clip.vert gl_ClipDistance test, skips recording the subgraph when its bound lies entirely
+// within one of the eye coordinate clip spheres so none of its primitives would survive clipping on the GPU
+class ClipCullGroup : public vsg::Inherit<vsg::Group, ClipCullGroup>
+{
+public:
+    vsg::dsphere bound;
+    vsg::ref_ptr<vsg::vec4Array> eyeClipSettings;
+    mutable std::atomic_uint64_t numCulled{0}; // written during record, which may run on several threads
+
+    ClipCullGroup(const vsg::dsphere& in_bound, vsg::ref_ptr<vsg::vec4Array> in_eyeClipSettings) :
+        bound(in_bound),
+        eyeClipSettings(in_eyeClipSettings) {}
+
+    bool clipped(const vsg::dmat4& modelview) const
+    {
+        vsg::dvec3 eye_center = modelview * bound.center;
+
+        // allow for any scaling in the modelview matrix
+        double scale = std::max({vsg::length(vsg::dvec3(modelview[0][0], modelview[0][1], modelview[0][2])),
+                                 vsg::length(vsg::dvec3(modelview[1][0], modelview[1][1], modelview[1][2])),
+                                 vsg::length(vsg::dvec3(modelview[2][0], modelview[2][1], modelview[2][2]))});
+        double eye_radius = bound.radius * scale;
+
+        for (auto& sphere : *eyeClipSettings)
+        {
+            if (vsg::length(eye_center - vsg::dvec3(sphere.x, sphere.y, sphere.z)) + eye_radius <= sphere.w) return true;
+        }
+        return false;
+    }
+
+    void accept(vsg::RecordTraversal& visitor) const override
+    {
+        if (clipped(visitor.getState()->modelviewMatrixStack.top()))
+        {
+            ++numCulled;
+            return;
+        }
+
+        traverse(visitor);
+    }
+};
+
+// decorates the children of each Group with a ClipCullGroup so fully clipped subgraphs are culled hierarchically.
+// The bounds come from a BoundsCache of the subgraph, built before any ClipCullGroups are inserted, so each node's bounds
+// are computed once from its children's rather than rerunning ComputeBounds over the subgraph below every level.
+class InsertClipCullGroups : public vsg::Inherit<vsg::Visitor, InsertClipCullGroups>
+{
+public:
+    vsg::ref_ptr<vsg::vec4Array> eyeClipSettings;
+    vsg::ref_ptr<BoundsCache> boundsCache;
+    std::map<vsg::Node*, vsg::ref_ptr<ClipCullGroup>> clipCullGroups;
+
+    InsertClipCullGroups(vsg::ref_ptr<vsg::vec4Array> in_eyeClipSettings, vsg::ref_ptr<BoundsCache> in_boundsCache) :
+        eyeClipSettings(in_eyeClipSettings),
+        boundsCache(in_boundsCache) {}
+
+    void apply(vsg::Object& object) override
+    {
+        object.traverse(*this);
+    }
+
+    void apply(vsg::Group& group) override
+    {
+        for (auto& child : group.children)
+        {
+            if (child.cast<ClipCullGroup>()) continue;
+
+            auto& clipCullGroup = clipCullGroups[child.get()];
+            if (!clipCullGroup)
+            {
+                child->accept(*this);
+
+                // the bound is in the parent's coordinate frame, matching the modelview matrix the ClipCullGroup is recorded with
+                auto bounds = boundsCache->bounds(child);
+                if (!bounds.valid()) continue;
+
+                vsg::dsphere bound((bounds.min + bounds.max) * 0.5, vsg::length(bounds.max - bounds.min) * 0.5);
+                clipCullGroup = ClipCullGroup::create(bound, eyeClipSettings);
+                clipCullGroup->addChild(child);
+            }
+            child = clipCullGroup;
+        }
+    }
+
+    uint64_t numCulled() const
+    {
+        uint64_t count = 0;
+        for (auto& [node, clipCullGroup] : clipCullGroups)
+        {
+            if (clipCullGroup) count += clipCullGroup->numCulled;
+        }
+        return count;
+    }
+};
+
 class IntersectionHandler : public vsg::Inherit<vsg::Visitor, IntersectionHandler>
 {
 public:
@@ -134,6 +234,9 @@ int main(int argc, char** argv)
 
         auto numFrames = arguments.value(-1, "-f");
 
+        // disable the CPU culling of fully clipped subgraphs to compare against clipping them only on the GPU
+        bool clipCulling = !arguments.read("--no-clip-cull");
+
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
         if (argc <= 1)
@@ -250,6 +353,13 @@ int main(int argc, char** argv)
         eyeClipSettings->set(0, vsg::vec4(0.0, 0.0, 0.0, 0.0));
         eyeClipSettings->properties.dataVariance = vsg::DYNAMIC_DATA;
 
+        vsg::ref_ptr<InsertClipCullGroups> insertClipCullGroups;
+        if (clipCulling)
+        {
+            insertClipCullGroups = InsertClipCullGroups::create(eyeClipSettings, BoundsCache::create(model));
+            model->accept(*insertClipCullGroups);
+        }
+
         auto device = window->getOrCreateDevice();
 
 
@@ -345,6 +455,11 @@ int main(int argc, char** argv)
 
         auto fps = frameCount / (std::chrono::duration<double, std::chrono::seconds::period>(std::chrono::steady_clock::now() - startTime).count());
         std::cout << "Average fps = " << fps << std::endl;
+
+        if (insertClipCullGroups && frameCount > 0.0)
+        {
+            std::cout << "Average subgraphs clip culled per frame = " << (static_cast<double>(insertClipCullGroups->numCulled()) / frameCount) << std::endl;
+        }
     }
     catch (const vsg::Exception& exception)
     {
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "AsyncCompute.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -25,6 +27,7 @@ int main(int argc, char** argv)
     windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
     windowTraits->synchronizationLayer = arguments.read("--sync");
     arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height);
+    bool async = arguments.read("--async"); // run the compute on a dedicated compute queue, overlapping the rendering of the previous frame
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -46,15 +49,39 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    auto physicalDevice = window->getOrCreatePhysicalDevice();
+    auto computeQueueFamily = physicalDevice->getQueueFamily(VK_QUEUE_COMPUTE_BIT);
+    if (async)
+    {
+        int dedicatedQueueFamily = findDedicatedComputeQueueFamily(physicalDevice);
+        if (dedicatedQueueFamily >= 0 && createDeviceWithComputeQueue(window, dedicatedQueueFamily))
+        {
+            computeQueueFamily = dedicatedQueueFamily;
+        }
+        else
+        {
+            std::cout << "No dedicated compute queue family available, running compute on the graphics queue." << std::endl;
+            async = false;
+        }
+    }
+
     auto device = window->getOrCreateDevice();
 
+    // with async compute the vertices are written to a ring of buffers so compute can fill one while another is drawn
+    uint32_t numSlots = async ? 3 : 1;
+
     VkDeviceSize bufferSize = sizeof(vsg::vec4) * 256;
-    auto buffer = vsg::createBufferAndMemory(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    vsg::BufferInfoList bufferInfos;
+    for (uint32_t slot = 0; slot < numSlots; ++slot)
+    {
+        auto buffer = vsg::createBufferAndMemory(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    auto bufferInfo = vsg::BufferInfo::create();
-    bufferInfo->buffer = buffer;
-    bufferInfo->offset = 0;
-    bufferInfo->range = bufferSize;
+        auto bufferInfo = vsg::BufferInfo::create();
+        bufferInfo->buffer = buffer;
+        bufferInfo->offset = 0;
+        bufferInfo->range = bufferSize;
+        bufferInfos.push_back(bufferInfo);
+    }
 
     // camera related details
     auto viewport = vsg::ViewportState::create(0, 0, window->extent2D().width, window->extent2D().height);
@@ -69,10 +96,14 @@ int main(int argc, char** argv)
 
     auto computeScaleBuffer = vsg::DescriptorBuffer::create(computeScale, 1);
 
+    // the graphics command graph is created first as its queue family is required for the queue ownership transfers
+    auto graphicCommandGraph = vsg::CommandGraph::create(window);
+    uint32_t graphicsQueueFamily = static_cast<uint32_t>(graphicCommandGraph->queueFamily);
+    uint32_t computeFamily = static_cast<uint32_t>(computeQueueFamily);
+
     // create the compute graph to compute the positions of the vertices
-    auto physicalDevice = window->getOrCreatePhysicalDevice();
-    auto computeQueueFamily = physicalDevice->getQueueFamily(VK_QUEUE_COMPUTE_BIT);
     auto computeCommandGraph = vsg::CommandGraph::create(device, computeQueueFamily);
+    auto computeSlots = vsg::Switch::create();
     {
         vsg::DescriptorSetLayoutBindings descriptorBindings{
             {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
@@ -85,17 +116,39 @@ int main(int argc, char** argv)
         auto bindPipeline = vsg::BindComputePipeline::create(pipeline);
         computeCommandGraph->addChild(bindPipeline);
 
-        auto stroageBuffer = vsg::DescriptorBuffer::create(vsg::BufferInfoList{bufferInfo}, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-        auto descriptorSet = vsg::DescriptorSet::create( descriptorSetLayout, vsg::Descriptors{stroageBuffer, computeScaleBuffer});
-        auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, descriptorSet);
-
-        computeCommandGraph->addChild(bindDescriptorSet);
-
-        computeCommandGraph->addChild(vsg::Dispatch::create(1, 1, 1));
+        for (auto& bufferInfo : bufferInfos)
+        {
+            auto stroageBuffer = vsg::DescriptorBuffer::create(vsg::BufferInfoList{bufferInfo}, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            auto descriptorSet = vsg::DescriptorSet::create( descriptorSetLayout, vsg::Descriptors{stroageBuffer, computeScaleBuffer});
+            auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, descriptorSet);
+
+            auto commands = vsg::Commands::create();
+            commands->addChild(bindDescriptorSet);
+            commands->addChild(vsg::Dispatch::create(1, 1, 1));
+
+            if (async)
+            {
+                // release ownership of the buffer to the graphics queue family, the vertices are wholly rewritten each frame so there's no need to transfer it back.
+                auto releaseBarrier = vsg::BufferMemoryBarrier::create(
+                    VK_ACCESS_SHADER_WRITE_BIT, // srcAccessMask
+                    0,                          // dstAccessMask
+                    computeFamily,              // srcQueueFamilyIndex
+                    graphicsQueueFamily,        // dstQueueFamilyIndex
+                    bufferInfo->buffer,         // buffer
+                    0,                          // offset
+                    bufferSize                  // size
+                );
+                commands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, releaseBarrier));
+            }
+
+            computeSlots->addChild(true, commands);
+        }
+        computeCommandGraph->addChild(computeSlots);
     }
 
     // set up graphics subgraph to render the computed vertices
-    auto graphicCommandGraph = vsg::CommandGraph::create(window);
+    auto acquireSlots = vsg::Switch::create();
+    auto drawSlots = vsg::Switch::create();
     {
         // set up graphics pipeline
         vsg::PushConstantRanges pushConstantRanges{
@@ -127,17 +180,40 @@ int main(int argc, char** argv)
         auto scenegraph = vsg::StateGroup::create();
         scenegraph->add(bindGraphicsPipeline);
 
+        // the acquire barriers have to be recorded outside the render pass
+        if (async) graphicCommandGraph->addChild(acquireSlots);
+
         auto renderGraph = vsg::createRenderGraphForView(window, camera, scenegraph);
         graphicCommandGraph->addChild(renderGraph);
 
         // setup geometry
-        auto drawCommands = vsg::Commands::create();
-        auto bind_vertex_buffer = vsg::BindVertexBuffers::create();
-        bind_vertex_buffer->arrays.push_back(bufferInfo);
-        drawCommands->addChild(bind_vertex_buffer);
-        drawCommands->addChild(vsg::Draw::create(256, 1, 0, 0));
-
-        scenegraph->addChild(drawCommands);
+        for (auto& bufferInfo : bufferInfos)
+        {
+            auto drawCommands = vsg::Commands::create();
+            auto bind_vertex_buffer = vsg::BindVertexBuffers::create();
+            bind_vertex_buffer->arrays.push_back(bufferInfo);
+            drawCommands->addChild(bind_vertex_buffer);
+            drawCommands->addChild(vsg::Draw::create(256, 1, 0, 0));
+
+            drawSlots->addChild(true, drawCommands);
+
+            if (async)
+            {
+                // acquire ownership of the buffer released by the compute queue family
+                auto acquireBarrier = vsg::BufferMemoryBarrier::create(
+                    0,                                   // srcAccessMask
+                    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, // dstAccessMask
+                    computeFamily,                       // srcQueueFamilyIndex
+                    graphicsQueueFamily,                 // dstQueueFamilyIndex
+                    bufferInfo->buffer,                  // buffer
+                    0,                                   // offset
+                    bufferSize                           // size
+                );
+                acquireSlots->addChild(true, vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, acquireBarrier));
+            }
+        }
+
+        scenegraph->addChild(drawSlots);
     }
 
     // create the viewer and assign window(s) to it
@@ -146,6 +222,15 @@ int main(int argc, char** argv)
     // viewer->assignRecordAndSubmitTaskAndPresentation({graphicCommandGraph, computeCommandGraph});
     viewer->assignRecordAndSubmitTaskAndPresentation({computeCommandGraph, graphicCommandGraph});
 
+    // with a dedicated compute queue family the viewer assigns the compute command graph its own RecordAndSubmitTask
+    vsg::ref_ptr<AsyncCompute> asyncCompute;
+    if (async) asyncCompute = AsyncCompute::assign(*viewer, computeCommandGraph, graphicCommandGraph, numSlots);
+    if (async && !asyncCompute)
+    {
+        std::cout << "Unable to assign the compute and graphics command graphs to separate RecordAndSubmitTasks." << std::endl;
+        return 1;
+    }
+
     // compile the Vulkan objects
     viewer->compile();
 
@@ -166,6 +251,23 @@ int main(int argc, char** argv)
         computeScale->at(0).z = sin(frameTime);
         computeScale->dirty();
 
+        if (asyncCompute)
+        {
+            asyncCompute->advance(viewer->getFrameStamp()->frameCount);
+
+            computeSlots->setSingleChildOn(asyncCompute->computeSlot());
+            if (asyncCompute->graphicsReady())
+            {
+                acquireSlots->setSingleChildOn(asyncCompute->graphicsSlot());
+                drawSlots->setSingleChildOn(asyncCompute->graphicsSlot());
+            }
+            else
+            {
+                acquireSlots->setAllChildren(false);
+                drawSlots->setAllChildren(false);
+            }
+        }
+
         viewer->recordAndSubmit();
 
         viewer->present();
@@ -0,0 +1,361 @@
+#include "ExtendedDynamicState.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    bool containsExtension(const std::vector<VkExtensionProperties>& extensions, const char* name)
+    {
+        for (auto& extension : extensions)
+        {
+            if (std::strcmp(extension.extensionName, name) == 0) return true;
+        }
+        return false;
+    }
+
+    // extended dynamic state 1 only allows the topology to change within its class, so pipelines are shared per class
+    VkPrimitiveTopology topologyClass(VkPrimitiveTopology topology)
+    {
+        switch (topology)
+        {
+        case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+            return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+            return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+        case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+            return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+        default:
+            return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        }
+    }
+} // namespace
+
+std::vector<VkDynamicState> ExtendedDynamicStateSupport::dynamicStates() const
+{
+    std::vector<VkDynamicState> states;
+    if (extendedDynamicState)
+    {
+        states.insert(states.end(), {VK_DYNAMIC_STATE_CULL_MODE_EXT, VK_DYNAMIC_STATE_FRONT_FACE_EXT, VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT,
+                                     VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT, VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT});
+    }
+    if (extendedDynamicState2)
+    {
+        states.insert(states.end(), {VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT, VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT});
+    }
+    if (extendedDynamicState3PolygonMode)
+    {
+        states.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+    }
+    return states;
+}
+
+ExtendedDynamicStateSupport queryExtendedDynamicState(vsg::PhysicalDevice& physicalDevice)
+{
+    auto extensions = physicalDevice.enumerateDeviceExtensionProperties();
+
+    ExtendedDynamicStateSupport support;
+    if (containsExtension(extensions, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME))
+    {
+        auto features = physicalDevice.getFeatures<VkPhysicalDeviceExtendedDynamicStateFeaturesEXT, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT>();
+        support.extendedDynamicState = features.extendedDynamicState != VK_FALSE;
+    }
+
+    // the later extensions are only used on top of the first
+    if (support.extendedDynamicState && containsExtension(extensions, VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME))
+    {
+        auto features = physicalDevice.getFeatures<VkPhysicalDeviceExtendedDynamicState2FeaturesEXT, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT>();
+        support.extendedDynamicState2 = features.extendedDynamicState2 != VK_FALSE;
+    }
+
+    if (support.extendedDynamicState && containsExtension(extensions, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME))
+    {
+        auto features = physicalDevice.getFeatures<VkPhysicalDeviceExtendedDynamicState3FeaturesEXT, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT>();
+        support.extendedDynamicState3PolygonMode = features.extendedDynamicState3PolygonMode != VK_FALSE;
+    }
+
+    return support;
+}
+
+void requestExtendedDynamicState(vsg::WindowTraits& windowTraits, const ExtendedDynamicStateSupport& support)
+{
+    if (!support) return;
+
+    if (!windowTraits.deviceFeatures) windowTraits.deviceFeatures = vsg::DeviceFeatures::create();
+    auto& deviceFeatures = *windowTraits.deviceFeatures;
+
+    windowTraits.deviceExtensionNames.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    deviceFeatures.get<VkPhysicalDeviceExtendedDynamicStateFeaturesEXT, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT>().extendedDynamicState = VK_TRUE;
+
+    if (support.extendedDynamicState2)
+    {
+        windowTraits.deviceExtensionNames.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+        deviceFeatures.get<VkPhysicalDeviceExtendedDynamicState2FeaturesEXT, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT>().extendedDynamicState2 = VK_TRUE;
+    }
+
+    if (support.extendedDynamicState3PolygonMode)
+    {
+        windowTraits.deviceExtensionNames.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+        deviceFeatures.get<VkPhysicalDeviceExtendedDynamicState3FeaturesEXT, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT>().extendedDynamicState3PolygonMode = VK_TRUE;
+    }
+}
+
+SetExtendedDynamicState::SetExtendedDynamicState(const ExtendedDynamicStateSupport& in_support) :
+    Inherit(defaultSlot),
+    support(in_support)
+{
+}
+
+void SetExtendedDynamicState::set(const vsg::GraphicsPipelineStates& pipelineStates)
+{
+    for (auto& pipelineState : pipelineStates)
+    {
+        if (auto rasterizationState = pipelineState.cast<vsg::RasterizationState>())
+        {
+            cullMode = rasterizationState->cullMode;
+            frontFace = rasterizationState->frontFace;
+            depthBiasEnable = rasterizationState->depthBiasEnable;
+            polygonMode = rasterizationState->polygonMode;
+        }
+        else if (auto inputAssemblyState = pipelineState.cast<vsg::InputAssemblyState>())
+        {
+            primitiveTopology = inputAssemblyState->topology;
+            primitiveRestartEnable = inputAssemblyState->primitiveRestartEnable;
+        }
+        else if (auto depthStencilState = pipelineState.cast<vsg::DepthStencilState>())
+        {
+            depthTestEnable = depthStencilState->depthTestEnable;
+            depthWriteEnable = depthStencilState->depthWriteEnable;
+            depthCompareOp = depthStencilState->depthCompareOp;
+        }
+    }
+}
+
+int SetExtendedDynamicState::compare(const vsg::Object& rhs_object) const
+{
+    int result = vsg::StateCommand::compare(rhs_object);
+    if (result != 0) return result;
+
+    auto& rhs = static_cast<decltype(*this)>(rhs_object);
+    if ((result = vsg::compare_value(active, rhs.active))) return result;
+    if ((result = vsg::compare_value(cullMode, rhs.cullMode))) return result;
+    if ((result = vsg::compare_value(frontFace, rhs.frontFace))) return result;
+    if ((result = vsg::compare_value(primitiveTopology, rhs.primitiveTopology))) return result;
+    if ((result = vsg::compare_value(depthTestEnable, rhs.depthTestEnable))) return result;
+    if ((result = vsg::compare_value(depthWriteEnable, rhs.depthWriteEnable))) return result;
+    if ((result = vsg::compare_value(depthCompareOp, rhs.depthCompareOp))) return result;
+    if ((result = vsg::compare_value(depthBiasEnable, rhs.depthBiasEnable))) return result;
+    if ((result = vsg::compare_value(primitiveRestartEnable, rhs.primitiveRestartEnable))) return result;
+    if ((result = vsg::compare_value(polygonMode, rhs.polygonMode))) return result;
+    if ((result = vsg::compare_value(support.extendedDynamicState2, rhs.support.extendedDynamicState2))) return result;
+    return vsg::compare_value(support.extendedDynamicState3PolygonMode, rhs.support.extendedDynamicState3PolygonMode);
+}
+
+void SetExtendedDynamicState::compile(vsg::Context& context)
+{
+    if (context.deviceID >= _functions.size()) _functions.resize(context.deviceID + 1);
+
+    auto& functions = _functions[context.deviceID];
+    if (functions.vkCmdSetCullMode) return;
+
+    auto device = context.device;
+    device->getProcAddr(functions.vkCmdSetCullMode, "vkCmdSetCullModeEXT", "vkCmdSetCullMode");
+    device->getProcAddr(functions.vkCmdSetFrontFace, "vkCmdSetFrontFaceEXT", "vkCmdSetFrontFace");
+    device->getProcAddr(functions.vkCmdSetPrimitiveTopology, "vkCmdSetPrimitiveTopologyEXT", "vkCmdSetPrimitiveTopology");
+    device->getProcAddr(functions.vkCmdSetDepthTestEnable, "vkCmdSetDepthTestEnableEXT", "vkCmdSetDepthTestEnable");
+    device->getProcAddr(functions.vkCmdSetDepthWriteEnable, "vkCmdSetDepthWriteEnableEXT", "vkCmdSetDepthWriteEnable");
+    device->getProcAddr(functions.vkCmdSetDepthCompareOp, "vkCmdSetDepthCompareOpEXT", "vkCmdSetDepthCompareOp");
+    if (support.extendedDynamicState2)
+    {
+        device->getProcAddr(functions.vkCmdSetDepthBiasEnable, "vkCmdSetDepthBiasEnableEXT", "vkCmdSetDepthBiasEnable");
+        device->getProcAddr(functions.vkCmdSetPrimitiveRestartEnable, "vkCmdSetPrimitiveRestartEnableEXT", "vkCmdSetPrimitiveRestartEnable");
+    }
+    if (support.extendedDynamicState3PolygonMode)
+    {
+        device->getProcAddr(functions.vkCmdSetPolygonMode, "vkCmdSetPolygonModeEXT");
+    }
+}
+
+void SetExtendedDynamicState::record(vsg::CommandBuffer& commandBuffer) const
+{
+    if (!active) return;
+
+    auto& functions = _functions[commandBuffer.deviceID];
+    if (!functions.vkCmdSetCullMode) return;
+
+    functions.vkCmdSetCullMode(commandBuffer, cullMode);
+    functions.vkCmdSetFrontFace(commandBuffer, frontFace);
+    functions.vkCmdSetPrimitiveTopology(commandBuffer, primitiveTopology);
+    functions.vkCmdSetDepthTestEnable(commandBuffer, depthTestEnable);
+    functions.vkCmdSetDepthWriteEnable(commandBuffer, depthWriteEnable);
+    functions.vkCmdSetDepthCompareOp(commandBuffer, depthCompareOp);
+    if (functions.vkCmdSetDepthBiasEnable) functions.vkCmdSetDepthBiasEnable(commandBuffer, depthBiasEnable);
+    if (functions.vkCmdSetPrimitiveRestartEnable) functions.vkCmdSetPrimitiveRestartEnable(commandBuffer, primitiveRestartEnable);
+    if (functions.vkCmdSetPolygonMode) functions.vkCmdSetPolygonMode(commandBuffer, polygonMode);
+}
+
+CollapsePipelineVariants::CollapsePipelineVariants(const ExtendedDynamicStateSupport& in_support, vsg::ref_ptr<vsg::SharedObjects> in_sharedObjects) :
+    support(in_support),
+    sharedObjects(in_sharedObjects)
+{
+    if (!sharedObjects) sharedObjects = vsg::SharedObjects::create();
+
+    if (support)
+    {
+        _inactive = SetExtendedDynamicState::create(support);
+        _inactive->active = false;
+    }
+}
+
+void CollapsePipelineVariants::apply(vsg::Node& node)
+{
+    if (_visited.insert(&node).second) node.traverse(*this);
+}
+
+void CollapsePipelineVariants::apply(vsg::StateGroup& stateGroup)
+{
+    if (!_visited.insert(&stateGroup).second) return;
+
+    vsg::StateGroup::StateCommands dynamicStateCommands;
+    for (auto& stateCommand : stateGroup.stateCommands)
+    {
+        if (auto bindGraphicsPipeline = stateCommand.cast<vsg::BindGraphicsPipeline>())
+        {
+            auto& collapsed = collapse(*bindGraphicsPipeline);
+            stateCommand = collapsed.bindGraphicsPipeline;
+            if (collapsed.setExtendedDynamicState) dynamicStateCommands.push_back(collapsed.setExtendedDynamicState);
+        }
+        else if (auto stateSwitch = stateCommand.cast<vsg::StateSwitch>())
+        {
+            // each pipeline variant selected by the switch gets its dynamic state selected by the same mask
+            auto dynamicStateSwitch = vsg::StateSwitch::create();
+            dynamicStateSwitch->slot = SetExtendedDynamicState::defaultSlot;
+            for (auto& child : stateSwitch->children)
+            {
+                if (auto childBindGraphicsPipeline = child.stateCommand.cast<vsg::BindGraphicsPipeline>())
+                {
+                    auto& collapsed = collapse(*childBindGraphicsPipeline);
+                    child.stateCommand = collapsed.bindGraphicsPipeline;
+                    if (collapsed.setExtendedDynamicState) dynamicStateSwitch->add(child.mask, collapsed.setExtendedDynamicState);
+                }
+            }
+            if (!dynamicStateSwitch->children.empty()) dynamicStateCommands.push_back(dynamicStateSwitch);
+        }
+    }
+
+    stateGroup.stateCommands.insert(stateGroup.stateCommands.end(), dynamicStateCommands.begin(), dynamicStateCommands.end());
+
+    stateGroup.traverse(*this);
+}
+
+const CollapsePipelineVariants::Collapsed& CollapsePipelineVariants::collapse(vsg::BindGraphicsPipeline& bindGraphicsPipeline)
+{
+    if (auto itr = _collapsed.find(&bindGraphicsPipeline); itr != _collapsed.end()) return itr->second;
+
+    auto& collapsed = _collapsed[&bindGraphicsPipeline];
+    collapsed.bindGraphicsPipeline = vsg::ref_ptr<vsg::BindGraphicsPipeline>(&bindGraphicsPipeline);
+
+    auto pipeline = bindGraphicsPipeline.pipeline;
+    // pipelines that aren't collapsed are accompanied by the inactive SetExtendedDynamicState
+    collapsed.setExtendedDynamicState = _inactive;
+    if (!pipeline) return collapsed;
+
+    _pipelinesBefore.insert(pipeline.get());
+
+    // pipelines with states set dynamically by another means, or tessellated ones whose topology can't change, are left as they are
+    auto dynamicStates = support.dynamicStates();
+    bool collapsible = static_cast<bool>(support);
+    for (auto& pipelineState : pipeline->pipelineStates)
+    {
+        if (auto inputAssemblyState = pipelineState.cast<vsg::InputAssemblyState>())
+        {
+            if (topologyClass(inputAssemblyState->topology) == VK_PRIMITIVE_TOPOLOGY_PATCH_LIST) collapsible = false;
+        }
+        else if (auto dynamicState = pipelineState.cast<vsg::DynamicState>())
+        {
+            for (auto state : dynamicState->dynamicStates)
+            {
+                if (std::find(dynamicStates.begin(), dynamicStates.end(), state) != dynamicStates.end()) collapsible = false;
+            }
+        }
+    }
+
+    if (!collapsible)
+    {
+        _pipelinesAfter.insert(pipeline.get());
+        return collapsed;
+    }
+
+    auto setExtendedDynamicState = SetExtendedDynamicState::create(support);
+    setExtendedDynamicState->set(pipeline->pipelineStates);
+
+    // reset the states that are now dynamic to their defaults so that the variants compare equal
+    vsg::ref_ptr<vsg::DynamicState> dynamicState;
+    vsg::GraphicsPipelineStates pipelineStates;
+    for (auto& pipelineState : pipeline->pipelineStates)
+    {
+        if (auto rasterizationState = pipelineState.cast<vsg::RasterizationState>())
+        {
+            auto state = vsg::RasterizationState::create(*rasterizationState);
+            state->cullMode = VK_CULL_MODE_BACK_BIT;
+            state->frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+            if (support.extendedDynamicState2) state->depthBiasEnable = VK_FALSE;
+            if (support.extendedDynamicState3PolygonMode) state->polygonMode = VK_POLYGON_MODE_FILL;
+            pipelineStates.push_back(state);
+        }
+        else if (auto inputAssemblyState = pipelineState.cast<vsg::InputAssemblyState>())
+        {
+            auto state = vsg::InputAssemblyState::create(*inputAssemblyState);
+            state->topology = topologyClass(inputAssemblyState->topology);
+            if (support.extendedDynamicState2) state->primitiveRestartEnable = VK_FALSE;
+            pipelineStates.push_back(state);
+        }
+        else if (auto depthStencilState = pipelineState.cast<vsg::DepthStencilState>())
+        {
+            auto state = vsg::DepthStencilState::create(*depthStencilState);
+            state->depthTestEnable = VK_TRUE;
+            state->depthWriteEnable = VK_TRUE;
+            state->depthCompareOp = VK_COMPARE_OP_GREATER;
+            pipelineStates.push_back(state);
+        }
+        else if (auto originalDynamicState = pipelineState.cast<vsg::DynamicState>())
+        {
+            dynamicState = vsg::DynamicState::create();
+            dynamicState->dynamicStates = originalDynamicState->dynamicStates;
+            pipelineStates.push_back(dynamicState);
+        }
+        else
+        {
+            pipelineStates.push_back(pipelineState);
+        }
+    }
+
+    if (!dynamicState)
+    {
+        dynamicState = vsg::DynamicState::create();
+        pipelineStates.push_back(dynamicState);
+    }
+    dynamicState->dynamicStates.insert(dynamicState->dynamicStates.end(), dynamicStates.begin(), dynamicStates.end());
+
+    auto graphicsPipeline = vsg::GraphicsPipeline::create(pipeline->layout, pipeline->stages, pipelineStates, pipeline->subpass);
+    sharedObjects->share(graphicsPipeline);
+
+    auto newBindGraphicsPipeline = vsg::BindGraphicsPipeline::create(graphicsPipeline);
+    sharedObjects->share(newBindGraphicsPipeline);
+    sharedObjects->share(setExtendedDynamicState);
+
+    _pipelinesAfter.insert(graphicsPipeline.get());
+
+    collapsed.bindGraphicsPipeline = newBindGraphicsPipeline;
+    collapsed.setExtendedDynamicState = setExtendedDynamicState;
+    return collapsed;
+}
+
+void CollapsePipelineVariants::report(std::ostream& out) const
+{
+    out << "CollapsePipelineVariants graphics pipelines before = " << numPipelinesBefore() << ", after = " << numPipelinesAfter()
+        << ", extended dynamic state 2 = " << support.extendedDynamicState2 << ", extended dynamic state 3 polygon mode = " << support.extendedDynamicState3PolygonMode << std::endl;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <map>
+#include <set>
+
+// Which of the VK_EXT_extended_dynamic_state extensions a device supports, and so which states can be made dynamic:
+//   1 - cull mode, front face, primitive topology, depth test enable, depth write enable and depth compare op
+//   2 - depth bias enable and primitive restart enable
+//   3 - polygon mode
+struct ExtendedDynamicStateSupport
+{
+    bool extendedDynamicState = false;
+    bool extendedDynamicState2 = false;
+    bool extendedDynamicState3PolygonMode = false;
+
+    explicit operator bool() const { return extendedDynamicState; }
+
+    // the VkDynamicStates covered by the supported extensions
+    std::vector<VkDynamicState> dynamicStates() const;
+};
+
+// query the PhysicalDevice for the extensions and their features
+extern ExtendedDynamicStateSupport queryExtendedDynamicState(vsg::PhysicalDevice& physicalDevice);
+
+// add the supported extensions and features to the WindowTraits, call before the Window's Device is created
+extern void requestExtendedDynamicState(vsg::WindowTraits& windowTraits, const ExtendedDynamicStateSupport& support);
+
+// StateCommand that sets the extended dynamic states that a GraphicsPipeline's fixed function states would otherwise
+// specify. It has its own slot, which the RecordTraversal records after the pipeline's, so it can be placed in the same
+// StateGroup or StateSwitch arrangement as the BindGraphicsPipeline it accompanies. An inactive one records nothing, it is
+// placed with the pipelines that have the states static so that the slot changes along with every pipeline.
+class SetExtendedDynamicState : public vsg::Inherit<vsg::StateCommand, SetExtendedDynamicState>
+{
+public:
+    static constexpr uint32_t defaultSlot = 8;
+
+    explicit SetExtendedDynamicState(const ExtendedDynamicStateSupport& in_support = {});
+
+    ExtendedDynamicStateSupport support;
+
+    // false for the placeholder that accompanies pipelines without the extended dynamic states
+    bool active = true;
+
+    // extended dynamic state 1
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    VkPrimitiveTopology primitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkBool32 depthTestEnable = VK_TRUE;
+    VkBool32 depthWriteEnable = VK_TRUE;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_GREATER;
+
+    // extended dynamic state 2
+    VkBool32 depthBiasEnable = VK_FALSE;
+    VkBool32 primitiveRestartEnable = VK_FALSE;
+
+    // extended dynamic state 3
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+
+    // take the values from a pipeline's fixed function states
+    void set(const vsg::GraphicsPipelineStates& pipelineStates);
+
+    int compare(const vsg::Object& rhs_object) const override;
+
+    void compile(vsg::Context& context) override;
+    void record(vsg::CommandBuffer& commandBuffer) const override;
+
+protected:
+    struct Functions
+    {
+        PFN_vkCmdSetCullModeEXT vkCmdSetCullMode = nullptr;
+        PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFace = nullptr;
+        PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopology = nullptr;
+        PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnable = nullptr;
+        PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnable = nullptr;
+        PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOp = nullptr;
+        PFN_vkCmdSetDepthBiasEnableEXT vkCmdSetDepthBiasEnable = nullptr;
+        PFN_vkCmdSetPrimitiveRestartEnableEXT vkCmdSetPrimitiveRestartEnable = nullptr;
+        PFN_vkCmdSetPolygonModeEXT vkCmdSetPolygonMode = nullptr;
+    };
+
+    std::vector<Functions> _functions; // indexed by deviceID
+};
+
+// Visitor that collapses the variants of GraphicsPipelines that differ only in states covered by the supported extended
+// dynamic states. Each BindGraphicsPipeline is replaced by one for a pipeline with those states made dynamic and reset to
+// their defaults, shared through SharedObjects so that equal pipelines become one, and a SetExtendedDynamicState with the
+// original values is added next to it. BindGraphicsPipelines in StateSwitches get a matching StateSwitch of
+// SetExtendedDynamicState with the same masks. Binding a pipeline with the states static invalidates the dynamic values,
+// but the RecordTraversal only records a slot again when it changes, so pipelines that aren't collapsed get an inactive
+// SetExtendedDynamicState and the dynamic values are recorded again whenever a collapsed pipeline is bound after one.
+// Run before compiling.
+class CollapsePipelineVariants : public vsg::Inherit<vsg::Visitor, CollapsePipelineVariants>
+{
+public:
+    CollapsePipelineVariants(const ExtendedDynamicStateSupport& in_support, vsg::ref_ptr<vsg::SharedObjects> in_sharedObjects = {});
+
+    const ExtendedDynamicStateSupport support;
+    vsg::ref_ptr<vsg::SharedObjects> sharedObjects;
+
+    // statistics
+    size_t numPipelinesBefore() const { return _pipelinesBefore.size(); }
+    size_t numPipelinesAfter() const { return _pipelinesAfter.size(); }
+
+    void apply(vsg::Node& node) override;
+    void apply(vsg::StateGroup& stateGroup) override;
+
+    void report(std::ostream& out) const;
+
+protected:
+    struct Collapsed
+    {
+        vsg::ref_ptr<vsg::BindGraphicsPipeline> bindGraphicsPipeline;
+        vsg::ref_ptr<SetExtendedDynamicState> setExtendedDynamicState;
+    };
+
+    std::map<vsg::BindGraphicsPipeline*, Collapsed> _collapsed;
+    vsg::ref_ptr<SetExtendedDynamicState> _inactive;
+    std::set<vsg::Object*> _visited;
+    std::set<vsg::GraphicsPipeline*> _pipelinesBefore;
+    std::set<vsg::GraphicsPipeline*> _pipelinesAfter;
+
+    const Collapsed& collapse(vsg::BindGraphicsPipeline& bindGraphicsPipeline);
+};
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "ExtendedDynamicState.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -62,6 +64,7 @@ int main(int argc, char** argv)
     auto outputFile = arguments.value<vsg::Path>("", "-o");
     auto outputShaderSetFile = arguments.value<vsg::Path>("", "--os");
     auto share = arguments.read("--share");
+    auto extendedDynamicState = arguments.read("--eds");
 
     if (!shaderSet) shaderSet = vsg::createPhongShaderSet(options);
 
@@ -231,6 +234,16 @@ int main(int argc, char** argv)
     scenegraph->addChild(transform);
 #endif
 
+    // add any models on the command line, to measure the pipelines they create
+    for (int i = 1; i < argc; ++i)
+    {
+        vsg::Path filename = arguments[i];
+        if (auto model = vsg::read_cast<vsg::Node>(filename, options))
+            scenegraph->addChild(model);
+        else
+            std::cout << "Unable to load file " << filename << std::endl;
+    }
+
     if (sharedObjects) sharedObjects->report(std::cout);
 
     // create the viewer and assign window(s) to it
@@ -245,6 +258,22 @@ int main(int argc, char** argv)
 
     viewer->addWindow(window);
 
+    // with --eds the pipeline variants that differ in cull mode, depth and topology etc. are collapsed into one pipeline
+    // with those states set by SetExtendedDynamicState commands, without it the pipelines are only counted for comparison
+    ExtendedDynamicStateSupport support;
+    if (extendedDynamicState)
+    {
+        support = queryExtendedDynamicState(*window->getOrCreatePhysicalDevice());
+        if (support)
+            requestExtendedDynamicState(*windowTraits, support);
+        else
+            std::cout << "VK_EXT_extended_dynamic_state not supported." << std::endl;
+    }
+
+    auto collapsePipelineVariants = CollapsePipelineVariants::create(support, options->sharedObjects);
+    scenegraph->accept(*collapsePipelineVariants);
+    collapsePipelineVariants->report(std::cout);
+
     vsg::ComputeBounds computeBounds;
     scenegraph->accept(computeBounds);
     vsg::dvec3 centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
@@ -297,7 +326,9 @@ int main(int argc, char** argv)
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     // compile the Vulkan objects
+    auto startCompile = vsg::clock::now();
     viewer->compile();
+    std::cout << "Compile time " << std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startCompile).count() << "ms" << std::endl;
 
     // main frame loop
     while (viewer->advanceToNextFrame())
@@ -1,11 +1,20 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "StagingRing.h"
+
 class UpdateImage : public vsg::Visitor
 {
 public:
     double value = 0.0;
 
+    // when set the rows are written here, tightly packed, rather than to the image itself
+    void* destination = nullptr;
+
+    // the rows to update, numRows of 0 updating all the rows
+    size_t firstRow = 0;
+    size_t numRows = 0;
+
     template<class A>
     void update(A& image)
     {
@@ -16,10 +25,11 @@ public:
         float c_mult = 1.0f / static_cast<float>(image.width() - 1);
         float c_offset = 0.5f + cos(value) * 0.25f;
 
-        for (size_t r = 0; r < image.height(); ++r)
+        size_t endRow = numRows > 0 ? std::min(firstRow + numRows, static_cast<size_t>(image.height())) : image.height();
+        for (size_t r = firstRow; r < endRow; ++r)
         {
             float r_ratio = static_cast<float>(r) * r_mult;
-            value_type* ptr = &image.at(0, r);
+            value_type* ptr = destination ? (static_cast<value_type*>(destination) + (r - firstRow) * image.width()) : &image.at(0, r);
             for (size_t c = 0; c < image.width(); ++c)
             {
                 float c_ratio = static_cast<float>(c) * c_mult;
@@ -42,7 +52,7 @@ public:
                 ++ptr;
             }
         }
-        image.dirty();
+        if (!destination) image.dirty();
     }
 
     // use the vsg::Visitor to safely cast to types handled by the UpdateImage class
@@ -51,13 +61,40 @@ public:
     void apply(vsg::vec4Array2D& image) override { update(image); }
 
     // provide convenient way to invoke the UpdateImage as a functor
-    void operator()(vsg::Data* image, double v)
+    void operator()(vsg::Data* image, double v, void* dest = nullptr, size_t first = 0, size_t count = 0)
     {
         value = v;
+        destination = dest;
+        firstRow = first;
+        numRows = count;
         image->accept(*this);
     }
 };
 
+// find the ImageInfo that a vsg::Data is copied to
+class FindImageInfo : public vsg::Visitor
+{
+public:
+    explicit FindImageInfo(vsg::Data* in_data) :
+        data(in_data) {}
+
+    vsg::Data* data;
+    vsg::ref_ptr<vsg::ImageInfo> imageInfo;
+
+    void apply(vsg::Object& object) override
+    {
+        object.traverse(*this);
+    }
+
+    void apply(vsg::DescriptorImage& descriptorImage) override
+    {
+        for (auto& info : descriptorImage.imageInfoList)
+        {
+            if (info->imageView && info->imageView->image && info->imageView->image->data.get() == data) imageInfo = info;
+        }
+    }
+};
+
 int main(int argc, char** argv)
 {
     // set up defaults and read command line arguments to override them
@@ -97,6 +134,8 @@ int main(int argc, char** argv)
     auto image_size = arguments.value<uint32_t>(256, "-s");
     bool lateTransfer = arguments.read("--late");
     bool multiThreading = arguments.read("--mt");
+    bool useRing = arguments.read("--ring"); // upload through a persistently mapped StagingRing rather than the TransferTask
+    auto rowsPerFrame = arguments.value<uint32_t>(0, "--rows"); // only update a band of this many rows each frame, sweeping down the image
 
     vsg::GeometryInfo geomInfo;
     vsg::StateInfo stateInfo;
@@ -163,6 +202,13 @@ int main(int argc, char** argv)
         break;
     }
 
+    // RGB data is converted to RGBA on upload so can't be written straight into the staging memory
+    if (useRing && arrayType == USE_RGB)
+    {
+        std::cout << "--ring not supported with --rgb, using the TransferTask." << std::endl;
+        useRing = false;
+    }
+
     // set the dynmaic hint to tell the Viewer::compile() to assign this vsg::Data to a vsg::TransferTask
     textureData->properties.dataVariance = lateTransfer ? vsg::DYNAMIC_DATA_TRANSFER_AFTER_RECORD : vsg::DYNAMIC_DATA;
 
@@ -189,6 +235,15 @@ int main(int argc, char** argv)
     }
 
     auto commandGraph = vsg::createCommandGraphForView(window, camera, scenegraph);
+
+    // the StagingRing records its copy before the render pass, with a region for each frame in flight
+    vsg::ref_ptr<StagingRing> stagingRing;
+    if (useRing)
+    {
+        stagingRing = StagingRing::create(textureData->dataSize(), window->numFrames());
+        commandGraph->children.insert(commandGraph->children.begin(), stagingRing);
+    }
+
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     if (multiThreading) viewer->setupThreading();
@@ -196,8 +251,17 @@ int main(int argc, char** argv)
     // compile the Vulkan objects
     viewer->compile();
 
+    vsg::ref_ptr<vsg::ImageInfo> imageInfo;
+    if (stagingRing)
+    {
+        FindImageInfo findImageInfo(textureData);
+        scenegraph->accept(findImageInfo);
+        imageInfo = findImageInfo.imageInfo;
+    }
+
     auto startTime = vsg::clock::now();
     double numFramesCompleted = 0.0;
+    double recordAndSubmitTime = 0.0;
 
     // main frame loop
     while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
@@ -208,12 +272,64 @@ int main(int argc, char** argv)
         double time = std::chrono::duration<double, std::chrono::seconds::period>(viewer->getFrameStamp()->time - viewer->start_point()).count();
 
         // update texture data
-        updateImage(textureData, time);
+        if (rowsPerFrame > 0)
+        {
+            // mark each row as it's updated, the regions coalescing into the band, or two when it wraps around the image
+            DirtyRegions dirtyRegions;
+            uint32_t numRows = std::min(rowsPerFrame, image_size);
+            uint32_t firstRow = static_cast<uint32_t>((static_cast<uint64_t>(numFramesCompleted) * numRows) % image_size);
+            for (uint32_t i = 0; i < numRows; ++i)
+            {
+                dirtyRegions.add(VkOffset3D{0, static_cast<int32_t>((firstRow + i) % image_size), 0}, VkExtent3D{image_size, 1, 1});
+            }
+
+            bool uploaded = false;
+            if (stagingRing)
+            {
+                stagingRing->beginFrame(viewer->recordAndSubmitTasks[0]->fence());
+
+                uploaded = true;
+                for (auto& region : dirtyRegions.regions())
+                {
+                    auto allocation = stagingRing->allocate(textureData->valueSize() * region.extent.width * region.extent.height);
+                    updateImage(textureData, time, allocation.ptr, static_cast<size_t>(region.offset.y), region.extent.height);
+                    uploaded = uploaded && stagingRing->copy(allocation, imageInfo, region.offset, region.extent);
+                }
+            }
+
+            // the TransferTask copies the whole image whatever fraction of it changed
+            if (!uploaded)
+            {
+                for (auto& region : dirtyRegions.regions()) updateImage(textureData, time, nullptr, static_cast<size_t>(region.offset.y), region.extent.height);
+            }
+        }
+        else if (stagingRing)
+        {
+            stagingRing->beginFrame(viewer->recordAndSubmitTasks[0]->fence());
+
+            // write straight into the staging memory, falling back to the TransferTask if the image can't be copied to directly
+            auto allocation = stagingRing->allocate(textureData->dataSize());
+            updateImage(textureData, time, allocation.ptr);
+            if (allocation && !stagingRing->copy(allocation, imageInfo))
+            {
+                std::cout << "Unable to upload image through StagingRing, using the TransferTask." << std::endl;
+                stagingRing = {};
+                updateImage(textureData, time);
+            }
+        }
+        else
+        {
+            updateImage(textureData, time);
+        }
 
         viewer->update();
 
+        auto startOfRecordAndSubmit = vsg::clock::now();
+
         viewer->recordAndSubmit();
 
+        recordAndSubmitTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startOfRecordAndSubmit).count();
+
         viewer->present();
 
         numFramesCompleted += 1.0;
@@ -223,6 +339,12 @@ int main(int argc, char** argv)
     if (numFramesCompleted > 0.0)
     {
         std::cout << "Average frame rate = " << (numFramesCompleted / duration) << std::endl;
+
+        // with the TransferTask the copy into its staging buffer and any wait for the GPU happen within recordAndSubmit()
+        double bytesUploaded = stagingRing ? static_cast<double>(stagingRing->bytesUploaded) : static_cast<double>(textureData->dataSize()) * numFramesCompleted;
+        std::cout << "Average transfer speed " << (bytesUploaded / duration) / (1024.0 * 1024.0) << " Mb/sec" << std::endl;
+        std::cout << "Average recordAndSubmit time " << (recordAndSubmitTime / numFramesCompleted) << " ms" << std::endl;
+        if (stagingRing) std::cout << "Average staging ring stall time " << (stagingRing->stallTime / numFramesCompleted) << " ms" << std::endl;
     }
 
     // clean up done automatically thanks to ref_ptr<>
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "AsyncCompute.h"
+
 class UpdateImage : public vsg::Visitor
 {
 public:
@@ -74,6 +76,7 @@ int main(int argc, char** argv)
     }
     auto numFrames = arguments.value(-1, "-f");
     auto workgroupSize = arguments.value(32, "-w");
+    bool async = arguments.read("--async"); // run the compute on a dedicated compute queue, overlapping the rendering of the previous frame
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -100,6 +103,21 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    int computeQueueFamily = window->getOrCreatePhysicalDevice()->getQueueFamily(VK_QUEUE_COMPUTE_BIT);
+    if (async)
+    {
+        int dedicatedQueueFamily = findDedicatedComputeQueueFamily(window->getOrCreatePhysicalDevice());
+        if (dedicatedQueueFamily >= 0 && createDeviceWithComputeQueue(window, dedicatedQueueFamily))
+        {
+            computeQueueFamily = dedicatedQueueFamily;
+        }
+        else
+        {
+            std::cout << "No dedicated compute queue family available, running compute on the graphics queue." << std::endl;
+            async = false;
+        }
+    }
+
     // create the viewer and assign window(s) to it
     auto viewer = vsg::Viewer::create();
     viewer->addWindow(window);
@@ -123,23 +141,30 @@ int main(int argc, char** argv)
     UpdateImage updateImage;
     updateImage(textureData, 0.0);
 
-    vsg::ref_ptr<vsg::Image> image = vsg::Image::create();
-    image->usage |= (VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
-    image->format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    image->mipLevels = 1;
-    image->extent = VkExtent3D{textureData->width(), textureData->height(), 1};
-    image->imageType = VK_IMAGE_TYPE_2D;
-    image->arrayLayers = 1;
+    // with async compute the texture is written to a ring of images so compute can fill one while another is drawn
+    uint32_t numSlots = async ? 3 : 1;
 
-    auto imageView = vsg::ImageView::create(image, VK_IMAGE_ASPECT_COLOR_BIT);
     auto sampler = vsg::Sampler::create();
-    auto imageInfo = vsg::ImageInfo::create(sampler, imageView, VK_IMAGE_LAYOUT_GENERAL);
-
-    // create texture image and associated DescriptorSets and binding
-    auto texture = vsg::DescriptorImage::create(imageInfo, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    std::vector<vsg::ref_ptr<vsg::Image>> images;
+    std::vector<vsg::ref_ptr<vsg::ImageInfo>> imageInfos;
+    for (uint32_t slot = 0; slot < numSlots; ++slot)
+    {
+        vsg::ref_ptr<vsg::Image> image = vsg::Image::create();
+        image->usage |= (VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+        image->format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        image->mipLevels = 1;
+        image->extent = VkExtent3D{textureData->width(), textureData->height(), 1};
+        image->imageType = VK_IMAGE_TYPE_2D;
+        image->arrayLayers = 1;
+
+        auto imageView = vsg::ImageView::create(image, VK_IMAGE_ASPECT_COLOR_BIT);
+        images.push_back(image);
+        imageInfos.push_back(vsg::ImageInfo::create(sampler, imageView, VK_IMAGE_LAYOUT_GENERAL));
+    }
 
     // setup graphics rendering subgraph
     auto scenegraph = vsg::StateGroup::create();
+    auto drawSlots = vsg::Switch::create();
     {
         // set up graphics pipeline
         vsg::DescriptorSetLayoutBindings descriptorBindings{
@@ -176,18 +201,25 @@ int main(int argc, char** argv)
         auto graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
         auto bindGraphicsPipeline = vsg::BindGraphicsPipeline::create(graphicsPipeline);
 
-        auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture});
-        auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->layout, 0, descriptorSet);
-
-        // create StateGroup as the root of the scene/command graph to hold the GraphicsProgram, and binding of Descriptors to decorate the whole graph
+        // create StateGroup as the root of the scene/command graph to hold the GraphicsProgram
         scenegraph->add(bindGraphicsPipeline);
-        scenegraph->add(bindDescriptorSet);
+        scenegraph->addChild(drawSlots);
 
         // set up model transformation node
         auto transform = vsg::MatrixTransform::create(); // VK_SHADER_STAGE_VERTEX_BIT
 
-        // add transform to root of the scene graph
-        scenegraph->addChild(transform);
+        // create texture image and associated DescriptorSets and binding for each slot, each decorating the transform
+        for (auto& imageInfo : imageInfos)
+        {
+            auto texture = vsg::DescriptorImage::create(imageInfo, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+            auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture});
+            auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->layout, 0, descriptorSet);
+
+            auto slotStateGroup = vsg::StateGroup::create();
+            slotStateGroup->add(bindDescriptorSet);
+            slotStateGroup->addChild(transform);
+            drawSlots->addChild(true, slotStateGroup);
+        }
 
         // set up vertex and index arrays
         auto vertices = vsg::vec3Array::create(
@@ -229,8 +261,10 @@ int main(int argc, char** argv)
     }
 
     // set up compute shader subgraph
+    auto computeSlots = vsg::Switch::create();
+    auto acquireSlots = vsg::Switch::create();
+    vsg::ref_ptr<AsyncCompute> asyncCompute;
     {
-        auto physicalDevice = window->getOrCreatePhysicalDevice();
         auto device = window->getOrCreateDevice();
 
         auto width = textureData->width();
@@ -252,65 +286,106 @@ int main(int argc, char** argv)
         auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
 
         auto sourceBuffer = vsg::DescriptorBuffer::create(textureData, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-        auto writeTexture = vsg::DescriptorImage::create(imageInfo, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 
         auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, vsg::PushConstantRanges{});
 
-        vsg::Descriptors descriptors{
-            sourceBuffer,
-            writeTexture};
-        auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, descriptors);
-        auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, descriptorSet);
-
         // set up the compute pipeline
         auto pipeline = vsg::ComputePipeline::create(pipelineLayout, computeShader);
         auto bindPipeline = vsg::BindComputePipeline::create(pipeline);
 
-        auto preCopyBarrier = vsg::ImageMemoryBarrier::create();
-        preCopyBarrier->srcAccessMask = 0;
-        preCopyBarrier->dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-        preCopyBarrier->oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        preCopyBarrier->newLayout = VK_IMAGE_LAYOUT_GENERAL;
-        preCopyBarrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        preCopyBarrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        preCopyBarrier->image = image;
-        preCopyBarrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        preCopyBarrier->subresourceRange.baseArrayLayer = 0;
-        preCopyBarrier->subresourceRange.layerCount = 1;
-        preCopyBarrier->subresourceRange.levelCount = 1;
-        preCopyBarrier->subresourceRange.baseMipLevel = 0;
-
-        auto preCopyBarrierCmd = vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, preCopyBarrier);
-
-        auto postCopyBarrier = vsg::ImageMemoryBarrier::create();
-        postCopyBarrier->srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-        postCopyBarrier->dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        postCopyBarrier->oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-        postCopyBarrier->newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        postCopyBarrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        postCopyBarrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        postCopyBarrier->image = image;
-        postCopyBarrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        postCopyBarrier->subresourceRange.baseArrayLayer = 0;
-        postCopyBarrier->subresourceRange.layerCount = 1;
-        postCopyBarrier->subresourceRange.levelCount = 1;
-        postCopyBarrier->subresourceRange.baseMipLevel = 0;
-
-        auto postCopyBarrierCmd = vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, postCopyBarrier);
-
-        int computeQueueFamily = physicalDevice->getQueueFamily(VK_QUEUE_COMPUTE_BIT);
+        auto grahics_commandGraph = vsg::CommandGraph::create(window);
         auto compute_commandGraph = vsg::CommandGraph::create(device, computeQueueFamily);
 
-        compute_commandGraph->addChild(preCopyBarrierCmd);
+        // without async compute the queue families are the same and the barriers don't transfer ownership
+        uint32_t srcQueueFamily = async ? static_cast<uint32_t>(computeQueueFamily) : VK_QUEUE_FAMILY_IGNORED;
+        uint32_t dstQueueFamily = async ? static_cast<uint32_t>(grahics_commandGraph->queueFamily) : VK_QUEUE_FAMILY_IGNORED;
+
+        for (uint32_t slot = 0; slot < numSlots; ++slot)
+        {
+            auto& image = images[slot];
+
+            auto writeTexture = vsg::DescriptorImage::create(imageInfos[slot], 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+
+            vsg::Descriptors descriptors{
+                sourceBuffer,
+                writeTexture};
+            auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, descriptors);
+            auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, descriptorSet);
+
+            // the image is wholly rewritten each frame so its previous contents, and ownership, can be discarded
+            auto preCopyBarrier = vsg::ImageMemoryBarrier::create();
+            preCopyBarrier->srcAccessMask = 0;
+            preCopyBarrier->dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            preCopyBarrier->oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            preCopyBarrier->newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            preCopyBarrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            preCopyBarrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            preCopyBarrier->image = image;
+            preCopyBarrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            preCopyBarrier->subresourceRange.baseArrayLayer = 0;
+            preCopyBarrier->subresourceRange.layerCount = 1;
+            preCopyBarrier->subresourceRange.levelCount = 1;
+            preCopyBarrier->subresourceRange.baseMipLevel = 0;
+
+            auto preCopyBarrierCmd = vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, preCopyBarrier);
+
+            // with async compute this releases the image to the graphics queue family
+            auto postCopyBarrier = vsg::ImageMemoryBarrier::create();
+            postCopyBarrier->srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            postCopyBarrier->dstAccessMask = async ? 0 : VK_ACCESS_SHADER_READ_BIT;
+            postCopyBarrier->oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            postCopyBarrier->newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            postCopyBarrier->srcQueueFamilyIndex = srcQueueFamily;
+            postCopyBarrier->dstQueueFamilyIndex = dstQueueFamily;
+            postCopyBarrier->image = image;
+            postCopyBarrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            postCopyBarrier->subresourceRange.baseArrayLayer = 0;
+            postCopyBarrier->subresourceRange.layerCount = 1;
+            postCopyBarrier->subresourceRange.levelCount = 1;
+            postCopyBarrier->subresourceRange.baseMipLevel = 0;
+
+            auto postCopyBarrierCmd = vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, async ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, postCopyBarrier);
+
+            auto commands = vsg::Commands::create();
+            commands->addChild(preCopyBarrierCmd);
+            commands->addChild(bindDescriptorSet);
+            commands->addChild(vsg::Dispatch::create(uint32_t(ceil(float(width) / float(workgroupSize))), uint32_t(ceil(float(height) / float(workgroupSize))), 1));
+            commands->addChild(postCopyBarrierCmd);
+            computeSlots->addChild(true, commands);
+
+            if (async)
+            {
+                // acquire ownership of the image on the graphics queue family, matching the compute queue's release
+                auto acquireBarrier = vsg::ImageMemoryBarrier::create();
+                acquireBarrier->srcAccessMask = 0;
+                acquireBarrier->dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                acquireBarrier->oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+                acquireBarrier->newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                acquireBarrier->srcQueueFamilyIndex = srcQueueFamily;
+                acquireBarrier->dstQueueFamilyIndex = dstQueueFamily;
+                acquireBarrier->image = image;
+                acquireBarrier->subresourceRange = postCopyBarrier->subresourceRange;
+
+                acquireSlots->addChild(true, vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, acquireBarrier));
+            }
+        }
+
         compute_commandGraph->addChild(bindPipeline);
-        compute_commandGraph->addChild(bindDescriptorSet);
-        compute_commandGraph->addChild(vsg::Dispatch::create(uint32_t(ceil(float(width) / float(workgroupSize))), uint32_t(ceil(float(height) / float(workgroupSize))), 1));
-        compute_commandGraph->addChild(postCopyBarrierCmd);
+        compute_commandGraph->addChild(computeSlots);
 
-        auto grahics_commandGraph = vsg::CommandGraph::create(window);
+        // the acquire barriers have to be recorded outside the render pass
+        if (async) grahics_commandGraph->addChild(acquireSlots);
         grahics_commandGraph->addChild(vsg::createRenderGraphForView(window, camera, scenegraph));
 
         viewer->assignRecordAndSubmitTaskAndPresentation({compute_commandGraph, grahics_commandGraph});
+
+        // with a dedicated compute queue family the viewer assigns the compute command graph its own RecordAndSubmitTask
+        if (async) asyncCompute = AsyncCompute::assign(*viewer, compute_commandGraph, grahics_commandGraph, numSlots);
+        if (async && !asyncCompute)
+        {
+            std::cout << "Unable to assign the compute and graphics command graphs to separate RecordAndSubmitTasks." << std::endl;
+            return 1;
+        }
     }
 
     // compile the Vulkan objects
@@ -332,6 +407,23 @@ int main(int argc, char** argv)
 
         viewer->update();
 
+        if (asyncCompute)
+        {
+            asyncCompute->advance(viewer->getFrameStamp()->frameCount);
+
+            computeSlots->setSingleChildOn(asyncCompute->computeSlot());
+            if (asyncCompute->graphicsReady())
+            {
+                acquireSlots->setSingleChildOn(asyncCompute->graphicsSlot());
+                drawSlots->setSingleChildOn(asyncCompute->graphicsSlot());
+            }
+            else
+            {
+                acquireSlots->setAllChildren(false);
+                drawSlots->setAllChildren(false);
+            }
+        }
+
         viewer->recordAndSubmit();
 
         viewer->present();
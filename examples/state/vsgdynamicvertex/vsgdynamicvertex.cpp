@@ -1,6 +1,9 @@
+#include <cstring>
 #include <iostream>
 #include <vsg/all.h>
 
+#include "StagingRing.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -17,19 +20,26 @@ public:
     void apply(vsg::Geometry& geometry)
     {
         if (geometry.arrays.empty()) return;
-        geometry.arrays[0]->data->accept(*this);
+        collect(geometry.arrays[0]);
     }
 
     void apply(vsg::VertexIndexDraw& vid)
     {
         if (vid.arrays.empty()) return;
-        vid.arrays[0]->data->accept(*this);
+        collect(vid.arrays[0]);
     }
 
     void apply(vsg::BindVertexBuffers& bvd)
     {
         if (bvd.arrays.empty()) return;
-        bvd.arrays[0]->data->accept(*this);
+        collect(bvd.arrays[0]);
+    }
+
+    void collect(vsg::ref_ptr<vsg::BufferInfo> bufferInfo)
+    {
+        currentBufferInfo = bufferInfo;
+        bufferInfo->data->accept(*this);
+        currentBufferInfo = {};
     }
 
     void apply(vsg::vec3Array& vertices)
@@ -38,6 +48,11 @@ public:
         {
             verticesSet.insert(&vertices);
         }
+        if (currentBufferInfo)
+        {
+            bufferInfos[&vertices].insert(currentBufferInfo.get());
+            pendingRanges[&vertices];
+        }
     }
 
 
@@ -54,6 +69,123 @@ public:
     }
 
     std::set<vsg::vec3Array*> verticesSet;
+
+    // the BufferInfo that each vertex array is copied to, used to upload to the buffers directly with --ring
+    std::map<vsg::vec3Array*, std::set<vsg::BufferInfo*>> bufferInfos;
+
+    // modified ranges that the StagingRing didn't have room for, uploaded with the next frame's. Each array has its
+    // entry created here so that the UploadVertices threads only ever modify the entries of the arrays they update.
+    std::map<vsg::vec3Array*, DirtyRanges> pendingRanges;
+    vsg::ref_ptr<vsg::BufferInfo> currentBufferInfo;
+};
+
+// modify a window of the vertices that advances each frame, recording the byte ranges changed
+void modifyVertices(vsg::vec3Array& vertices, float dz, double fraction, uint64_t frameNumber, DirtyRanges& dirtyRanges)
+{
+    if (vertices.size() == 0) return;
+
+    size_t count = std::max(static_cast<size_t>(static_cast<double>(vertices.size()) * fraction), size_t(1));
+    size_t first = static_cast<size_t>((frameNumber * count) % vertices.size());
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t index = (first + i) % vertices.size();
+        vertices[index].z += dz;
+        dirtyRanges.add(index * sizeof(vsg::vec3), sizeof(vsg::vec3));
+    }
+}
+
+// update vertex arrays, writing the results directly into the StagingRing and queuing the copies to their buffers
+class UploadVertices : public vsg::Inherit<vsg::Operation, UploadVertices>
+{
+public:
+    UploadVertices(StagingRing& in_ring, FindVertexData& in_vertexData, vsg::ref_ptr<vsg::vec3Array>* in_begin, vsg::ref_ptr<vsg::vec3Array>* in_end, vsg::ref_ptr<vsg::Latch> in_latch) :
+        ring(in_ring),
+        vertexData(in_vertexData),
+        begin(in_begin),
+        end(in_end),
+        latch(in_latch) {}
+
+    StagingRing& ring;
+    FindVertexData& vertexData;
+    vsg::ref_ptr<vsg::vec3Array>* begin;
+    vsg::ref_ptr<vsg::vec3Array>* end;
+    vsg::ref_ptr<vsg::Latch> latch;
+    float dz = 0.0f;
+    double fraction = 1.0;
+    uint64_t frameNumber = 0;
+
+    // only copy the ranges of the vertices that have been modified
+    void uploadRanges(vsg::vec3Array& vertices)
+    {
+        auto itr = vertexData.bufferInfos.find(&vertices);
+        if (itr == vertexData.bufferInfos.end())
+        {
+            DirtyRanges dirtyRanges;
+            modifyVertices(vertices, dz, fraction, frameNumber, dirtyRanges);
+            vertices.dirty();
+            return;
+        }
+
+        auto& dirtyRanges = vertexData.pendingRanges.at(&vertices);
+        modifyVertices(vertices, dz, fraction, frameNumber, dirtyRanges);
+
+        // ranges that don't fit in the ring this frame are kept for the next rather than copying the whole array
+        DirtyRanges remainingRanges;
+        for (auto& range : dirtyRanges.ranges())
+        {
+            auto allocation = ring.allocate(range.size);
+            if (!allocation)
+            {
+                remainingRanges.add(range.offset, range.size);
+                continue;
+            }
+
+            std::memcpy(allocation.ptr, static_cast<const uint8_t*>(vertices.dataPointer()) + range.offset, range.size);
+            for (auto& bufferInfo : itr->second)
+            {
+                ring.copy(allocation, vsg::ref_ptr<vsg::BufferInfo>(bufferInfo), range.offset);
+            }
+        }
+        dirtyRanges = std::move(remainingRanges);
+    }
+
+    void run() override
+    {
+        for (auto vertices_itr = begin; vertices_itr != end; ++vertices_itr)
+        {
+            auto& vertices = *vertices_itr;
+
+            if (fraction < 1.0)
+            {
+                uploadRanges(*vertices);
+                continue;
+            }
+
+            // only take space in the ring for arrays that it can copy to
+            auto itr = vertexData.bufferInfos.find(vertices.get());
+            auto allocation = (itr != vertexData.bufferInfos.end()) ? ring.allocate(vertices->dataSize()) : StagingRing::Allocation{};
+            auto dst = static_cast<vsg::vec3*>(allocation.ptr);
+            for (auto& v : *vertices)
+            {
+                v.z += dz;
+                if (dst) *(dst++) = v;
+            }
+
+            if (allocation)
+            {
+                for (auto& bufferInfo : itr->second)
+                {
+                    ring.copy(allocation, vsg::ref_ptr<vsg::BufferInfo>(bufferInfo));
+                }
+            }
+            else
+            {
+                // fall back to the TransferTask when the ring is full or doesn't know the array's buffers
+                vertices->dirty();
+            }
+        }
+        if (latch) latch->count_down();
+    }
 };
 
 int main(int argc, char** argv)
@@ -99,10 +231,13 @@ int main(int argc, char** argv)
         auto numFrames = arguments.value(-1, "-f");
 
         bool multiThreading = arguments.read("--mt");
-        auto modify = arguments.read("--modify");
+        auto partial = arguments.value(1.0, "--partial"); // modify this fraction of each vertex array per frame
+        auto modify = arguments.read("--modify") || partial < 1.0;
         auto dirty = arguments.read("--dirty");
         auto dynamic = arguments.read("--dynamic") || dirty || modify;
         bool lateTransfer = arguments.read("--late");
+        bool useRing = arguments.read("--ring"); // upload through a persistently mapped StagingRing rather than the TransferTask
+        auto ringThreads = arguments.value<uint32_t>(0, "--ring-threads");
 
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -122,7 +257,8 @@ int main(int argc, char** argv)
 
         // visit the scene graph to collect all the vertex arrays;
         size_t numVertices = 0;
-        auto verticesList = vsg::visit<FindVertexData>(vsg_scene).getVerticesList();
+        auto vertexData = vsg::visit<FindVertexData>(vsg_scene);
+        auto verticesList = vertexData.getVerticesList();
         if (dynamic)
         {
             for(auto& vertices : verticesList)
@@ -180,6 +316,17 @@ int main(int argc, char** argv)
         // set up commandGraph for rendering
         auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
 
+        // the StagingRing records its copies before the render pass, with a region for each frame in flight
+        vsg::ref_ptr<StagingRing> stagingRing;
+        if (useRing && dynamic)
+        {
+            VkDeviceSize regionSize = 0;
+            for (auto& vertices : verticesList) regionSize += ((vertices->dataSize() + 15) / 16) * 16;
+
+            stagingRing = StagingRing::create(regionSize, window->numFrames());
+            commandGraph->children.insert(commandGraph->children.begin(), stagingRing);
+        }
+
         viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
 
@@ -188,8 +335,13 @@ int main(int argc, char** argv)
 
         viewer->compile();
 
+        // split the vertex arrays between worker threads that write directly to the StagingRing
+        vsg::ref_ptr<vsg::OperationThreads> uploadThreads;
+        if (stagingRing && ringThreads > 1) uploadThreads = vsg::OperationThreads::create(ringThreads);
+
         auto startTime = std::chrono::steady_clock::now();
         double frameCount = 0.0;
+        double recordAndSubmitTime = 0.0;
 
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
@@ -201,10 +353,49 @@ int main(int argc, char** argv)
 
             viewer->update();
 
-            if (modify)
+            if (stagingRing)
+            {
+                stagingRing->beginFrame(viewer->recordAndSubmitTasks[0]->fence());
+
+                float dz = modify ? static_cast<float>(sin(vsg::PI * frameCount / 180.0) * radius * 0.001) : 0.0f;
+                auto begin = verticesList.data();
+                auto end = verticesList.data() + verticesList.size();
+                if (uploadThreads)
+                {
+                    size_t numThreads = std::min(uploadThreads->threads.size(), verticesList.size());
+                    auto latch = vsg::Latch::create(static_cast<int>(numThreads));
+                    for (size_t i = 0; i < numThreads; ++i)
+                    {
+                        auto upload = UploadVertices::create(*stagingRing, vertexData, begin + (verticesList.size() * i) / numThreads, begin + (verticesList.size() * (i + 1)) / numThreads, latch);
+                        upload->dz = dz;
+                        upload->fraction = partial;
+                        upload->frameNumber = static_cast<uint64_t>(frameCount);
+                        uploadThreads->add(upload);
+                    }
+                    latch->wait();
+                }
+                else
+                {
+                    auto upload = UploadVertices::create(*stagingRing, vertexData, begin, end, vsg::ref_ptr<vsg::Latch>());
+                    upload->dz = dz;
+                    upload->fraction = partial;
+                    upload->frameNumber = static_cast<uint64_t>(frameCount);
+                    upload->run();
+                }
+            }
+            else if (modify)
             {
                 for(auto& vertices : verticesList)
                 {
+                    // the TransferTask copies the whole array whatever fraction of it changed
+                    if (partial < 1.0)
+                    {
+                        DirtyRanges dirtyRanges;
+                        modifyVertices(*vertices, static_cast<float>(sin(vsg::PI * frameCount / 180.0) * radius * 0.001), partial, static_cast<uint64_t>(frameCount), dirtyRanges);
+                        vertices->dirty();
+                        continue;
+                    }
+
                     for(auto& v : *vertices)
                     {
                         v.z += (sin(vsg::PI * frameCount / 180.0) * radius * 0.001);
@@ -220,14 +411,30 @@ int main(int argc, char** argv)
                 }
             }
 
+            auto startOfRecordAndSubmit = std::chrono::steady_clock::now();
+
             viewer->recordAndSubmit();
+
+            recordAndSubmitTime += std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - startOfRecordAndSubmit).count();
+
             viewer->present();
         }
 
-        auto fps = frameCount / (std::chrono::duration<double, std::chrono::seconds::period>(std::chrono::steady_clock::now() - startTime).count());
-        double transferSpeed = (double)(numVertices * sizeof(vsg::vec3) * fps);
+        auto duration = std::chrono::duration<double, std::chrono::seconds::period>(std::chrono::steady_clock::now() - startTime).count();
+        auto fps = frameCount / duration;
+        double transferSpeed = stagingRing ? (static_cast<double>(stagingRing->bytesUploaded) / duration) : (double)(numVertices * sizeof(vsg::vec3) * fps);
         std::cout << "Average fps = " << fps << std::endl;
         std::cout << "Average transfer speed " <<(transferSpeed) / (1024.0 * 1024.0) << " Mb/sec"<<std::endl;
+        if (frameCount > 0.0)
+        {
+            // with the TransferTask the copy into its staging buffer and any wait for the GPU happen within recordAndSubmit()
+            std::cout << "Average recordAndSubmit time " << (recordAndSubmitTime / frameCount) << " ms" << std::endl;
+            if (stagingRing)
+            {
+                std::cout << "Average staging ring stall time " << (stagingRing->stallTime / frameCount) << " ms" << std::endl;
+                if (stagingRing->numOverflows > 0) std::cout << "Staging ring overflows " << stagingRing->numOverflows << std::endl;
+            }
+        }
     }
     catch (const vsg::Exception& exception)
     {
@@ -0,0 +1,420 @@
+#include "OptimizeStateGroups.h"
+
+#include <algorithm>
+
+namespace
+{
+    class CountParents : public vsg::Inherit<vsg::Visitor, CountParents>
+    {
+    public:
+        explicit CountParents(std::map<vsg::Node*, uint32_t>& in_numParents) :
+            numParents(in_numParents) {}
+
+        std::map<vsg::Node*, uint32_t>& numParents;
+
+        void apply(vsg::Node& node) override
+        {
+            // each accept() is from a different parent, only the first traverses
+            if (++numParents[&node] == 1) node.traverse(*this);
+        }
+    };
+
+    template<class T>
+    bool isExactly(const vsg::Object* object)
+    {
+        return object && typeid(*object) == typeid(T);
+    }
+
+    template<class A>
+    vsg::ref_ptr<vsg::Data> concatenate(const std::vector<const vsg::Data*>& arrays)
+    {
+        size_t size = 0;
+        for (auto data : arrays) size += static_cast<const A*>(data)->size();
+
+        auto result = A::create(static_cast<uint32_t>(size));
+        result->properties.format = arrays.front()->properties.format;
+
+        size_t pos = 0;
+        for (auto data : arrays)
+        {
+            auto array = static_cast<const A*>(data);
+            for (size_t i = 0; i < array->size(); ++i) result->at(pos++) = array->at(i);
+        }
+        return result;
+    }
+
+    vsg::ref_ptr<vsg::Data> concatenate(const std::vector<const vsg::Data*>& arrays)
+    {
+        auto front = arrays.front();
+        if (isExactly<vsg::vec2Array>(front)) return concatenate<vsg::vec2Array>(arrays);
+        if (isExactly<vsg::vec3Array>(front)) return concatenate<vsg::vec3Array>(arrays);
+        if (isExactly<vsg::vec4Array>(front)) return concatenate<vsg::vec4Array>(arrays);
+        if (isExactly<vsg::ubvec4Array>(front)) return concatenate<vsg::ubvec4Array>(arrays);
+        if (isExactly<vsg::floatArray>(front)) return concatenate<vsg::floatArray>(arrays);
+        return {};
+    }
+
+    bool concatenatable(const vsg::Data* data)
+    {
+        bool supportedType = isExactly<vsg::vec2Array>(data) || isExactly<vsg::vec3Array>(data) || isExactly<vsg::vec4Array>(data) ||
+                             isExactly<vsg::ubvec4Array>(data) || isExactly<vsg::floatArray>(data);
+        return supportedType && data->stride() == data->valueSize();
+    }
+
+    uint32_t indexAt(const vsg::Data* indices, size_t i)
+    {
+        if (auto ushortIndices = indices->cast<vsg::ushortArray>()) return ushortIndices->at(i);
+        return indices->cast<vsg::uintArray>()->at(i);
+    }
+} // namespace
+
+void OptimizeStateGroups::optimize(vsg::Node& node)
+{
+    _numParents.clear();
+    _visited.clear();
+    _stateStacks.clear();
+    _sharedDepth = 0;
+
+    auto countParents = CountParents::create(_numParents);
+    node.accept(*countParents);
+
+    node.accept(*this);
+}
+
+bool OptimizeStateGroups::modifiable(vsg::Node* node) const
+{
+    auto itr = _numParents.find(node);
+    return itr == _numParents.end() || itr->second <= 1;
+}
+
+void OptimizeStateGroups::apply(vsg::Node& node)
+{
+    if (!_visited.insert(&node).second) return;
+
+    bool shared = !modifiable(&node);
+    if (shared) ++_sharedDepth;
+    node.traverse(*this);
+    if (shared) --_sharedDepth;
+}
+
+void OptimizeStateGroups::apply(vsg::Group& group)
+{
+    if (!_visited.insert(&group).second) return;
+
+    bool shared = !modifiable(&group);
+    if (shared) ++_sharedDepth;
+
+    optimizeChildren(group.children);
+    traverseChildren(group);
+
+    if (shared) --_sharedDepth;
+}
+
+void OptimizeStateGroups::apply(vsg::StateGroup& stateGroup)
+{
+    if (!_visited.insert(&stateGroup).second) return;
+
+    bool shared = !modifiable(&stateGroup);
+    if (shared) ++_sharedDepth;
+
+    for (auto& stateCommand : stateGroup.stateCommands) _stateStacks[stateCommand->slot].push_back(stateCommand.get());
+
+    optimizeChildren(stateGroup.children);
+    traverseChildren(stateGroup);
+
+    for (auto& stateCommand : stateGroup.stateCommands) _stateStacks[stateCommand->slot].pop_back();
+
+    if (shared) --_sharedDepth;
+}
+
+void OptimizeStateGroups::traverseChildren(vsg::Group& group)
+{
+    for (auto& child : group.children) child->accept(*this);
+}
+
+void OptimizeStateGroups::optimizeChildren(vsg::Group::Children& children)
+{
+    // what is bound above is only known for nodes reached by a single path
+    if (_sharedDepth == 0) collapse(children);
+
+    sortAndMerge(children);
+    mergeDraws(children);
+}
+
+void OptimizeStateGroups::collapse(vsg::Group::Children& children)
+{
+    for (size_t i = 0; i < children.size();)
+    {
+        auto stateGroup = children[i].cast<vsg::StateGroup>();
+        if (!isExactly<vsg::StateGroup>(stateGroup) || !modifiable(stateGroup))
+        {
+            ++i;
+            continue;
+        }
+
+        auto& stateCommands = stateGroup->stateCommands;
+        auto redundant = [&](const vsg::ref_ptr<vsg::StateCommand>& stateCommand) {
+            auto itr = _stateStacks.find(stateCommand->slot);
+            return itr != _stateStacks.end() && !itr->second.empty() && itr->second.back() == stateCommand.get();
+        };
+
+        size_t numStateCommands = stateCommands.size();
+        stateCommands.erase(std::remove_if(stateCommands.begin(), stateCommands.end(), redundant), stateCommands.end());
+        numStateCommandsRemoved += numStateCommands - stateCommands.size();
+
+        if (!stateCommands.empty() || stateGroup->prototypeArrayState)
+        {
+            ++i;
+            continue;
+        }
+
+        // splice the children into the parent in place of the now empty StateGroup, then check them in turn
+        auto grandChildren = stateGroup->children;
+        children.erase(children.begin() + static_cast<std::ptrdiff_t>(i));
+        children.insert(children.begin() + static_cast<std::ptrdiff_t>(i), grandChildren.begin(), grandChildren.end());
+        ++numStateGroupsCollapsed;
+    }
+}
+
+void OptimizeStateGroups::sortAndMerge(vsg::Group::Children& children)
+{
+    auto sortable = [&](const vsg::ref_ptr<vsg::Node>& child) {
+        return isExactly<vsg::StateGroup>(child.get()) && modifiable(child.get());
+    };
+
+    // pipelines are in slot 0 and descriptor sets in the slots after, so ordering by slot sorts by pipeline then descriptor sets
+    auto key = [](const vsg::StateGroup& stateGroup) {
+        std::vector<std::pair<uint32_t, const vsg::StateCommand*>> k;
+        for (auto& stateCommand : stateGroup.stateCommands) k.emplace_back(stateCommand->slot, stateCommand.get());
+        std::stable_sort(k.begin(), k.end(), [](auto& lhs, auto& rhs) { return lhs.first < rhs.first; });
+        return k;
+    };
+
+    vsg::Group::Children result;
+    result.reserve(children.size());
+
+    for (size_t i = 0; i < children.size();)
+    {
+        if (!sortable(children[i]))
+        {
+            result.push_back(children[i++]);
+            continue;
+        }
+
+        // only reorder runs of StateGroups so their order relative to other siblings is kept
+        size_t end = i;
+        while (end < children.size() && sortable(children[end])) ++end;
+
+        std::vector<vsg::ref_ptr<vsg::StateGroup>> run;
+        for (size_t j = i; j < end; ++j) run.push_back(children[j].cast<vsg::StateGroup>());
+        std::stable_sort(run.begin(), run.end(), [&](auto& lhs, auto& rhs) { return key(*lhs) < key(*rhs); });
+
+        vsg::ref_ptr<vsg::StateGroup> previous;
+        for (auto& stateGroup : run)
+        {
+            if (previous && previous->stateCommands == stateGroup->stateCommands && previous->prototypeArrayState == stateGroup->prototypeArrayState)
+            {
+                previous->children.insert(previous->children.end(), stateGroup->children.begin(), stateGroup->children.end());
+                ++numStateGroupsMerged;
+                continue;
+            }
+
+            result.push_back(stateGroup);
+            previous = stateGroup;
+        }
+
+        i = end;
+    }
+
+    children.swap(result);
+}
+
+void OptimizeStateGroups::mergeDraws(vsg::Group::Children& children)
+{
+    // arrays with as many values as the draw has vertices are concatenated, the others are per instance and must be shared
+    using Signature = std::pair<uint32_t, std::vector<std::pair<const std::type_info*, const vsg::Data*>>>;
+
+    std::map<Signature, std::vector<size_t>> buckets;
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        auto vid = children[i].cast<vsg::VertexIndexDraw>();
+        if (!isExactly<vsg::VertexIndexDraw>(vid) || !modifiable(vid) || vid->instanceCount != 1 || vid->firstInstance != 0) continue;
+        if (!vid->indices || !vid->indices->data || vid->arrays.empty() || !vid->arrays[0] || !vid->arrays[0]->data) continue;
+
+        auto indices = vid->indices->data.get();
+        if (!(isExactly<vsg::ushortArray>(indices) || isExactly<vsg::uintArray>(indices)) || vid->firstIndex + vid->indexCount > indices->valueCount()) continue;
+
+        size_t numVertices = vid->arrays[0]->data->valueCount();
+        Signature signature{vid->firstBinding, {}};
+        bool compatible = true;
+        for (auto& bufferInfo : vid->arrays)
+        {
+            auto data = (bufferInfo && bufferInfo->data) ? bufferInfo->data.get() : nullptr;
+            if (!data) compatible = false;
+            else if (data->valueCount() != numVertices) signature.second.emplace_back(&typeid(*data), data);
+            else if (concatenatable(data)) signature.second.emplace_back(&typeid(*data), nullptr);
+            else compatible = false;
+        }
+
+        if (compatible) buckets[signature].push_back(i);
+    }
+
+    std::set<size_t> removed;
+    for (auto& [signature, drawIndices] : buckets)
+    {
+        if (drawIndices.size() < 2) continue;
+
+        std::vector<vsg::VertexIndexDraw*> draws;
+        for (auto i : drawIndices) draws.push_back(children[i].cast<vsg::VertexIndexDraw>());
+
+        vsg::DataList arrays;
+        for (size_t a = 0; a < signature.second.size(); ++a)
+        {
+            if (auto shared = signature.second[a].second)
+            {
+                arrays.push_back(vsg::ref_ptr<vsg::Data>(const_cast<vsg::Data*>(shared)));
+                continue;
+            }
+
+            std::vector<const vsg::Data*> toConcatenate;
+            for (auto vid : draws) toConcatenate.push_back(vid->arrays[a]->data.get());
+            arrays.push_back(concatenate(toConcatenate));
+        }
+
+        size_t numVertices = 0, numIndices = 0;
+        for (auto vid : draws)
+        {
+            numVertices += vid->arrays[0]->data->valueCount();
+            numIndices += vid->indexCount;
+        }
+
+        auto writeIndices = [&](auto mergedIndices) {
+            size_t pos = 0;
+            uint32_t base = 0;
+            for (auto vid : draws)
+            {
+                auto indices = vid->indices->data.get();
+                for (uint32_t k = vid->firstIndex; k < vid->firstIndex + vid->indexCount; ++k)
+                {
+                    mergedIndices->at(pos++) = static_cast<typename std::decay_t<decltype(*mergedIndices)>::value_type>(indexAt(indices, k) + static_cast<uint32_t>(vid->vertexOffset) + base);
+                }
+                base += static_cast<uint32_t>(vid->arrays[0]->data->valueCount());
+            }
+            return mergedIndices;
+        };
+
+        auto merged = vsg::VertexIndexDraw::create();
+        merged->firstBinding = signature.first;
+        merged->assignArrays(arrays);
+        if (numVertices > 65535)
+            merged->assignIndices(writeIndices(vsg::uintArray::create(static_cast<uint32_t>(numIndices))));
+        else
+            merged->assignIndices(writeIndices(vsg::ushortArray::create(static_cast<uint32_t>(numIndices))));
+        merged->indexCount = static_cast<uint32_t>(numIndices);
+        merged->instanceCount = 1;
+
+        children[drawIndices.front()] = merged;
+        removed.insert(drawIndices.begin() + 1, drawIndices.end());
+        numDrawsMerged += drawIndices.size() - 1;
+    }
+
+    if (removed.empty()) return;
+
+    vsg::Group::Children result;
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        if (removed.count(i) == 0) result.push_back(children[i]);
+    }
+    children.swap(result);
+}
+
+void CountStateBinds::apply(const vsg::Node& node)
+{
+    node.traverse(*this);
+}
+
+void CountStateBinds::apply(const vsg::StateGroup& stateGroup)
+{
+    for (auto& stateCommand : stateGroup.stateCommands)
+    {
+        auto& stateStack = _stateStacks[stateCommand->slot];
+        stateStack.stack.push_back(stateCommand.get());
+        stateStack.dirty = true;
+    }
+
+    stateGroup.traverse(*this);
+
+    for (auto& stateCommand : stateGroup.stateCommands)
+    {
+        auto& stateStack = _stateStacks[stateCommand->slot];
+        stateStack.stack.pop_back();
+        stateStack.dirty = !stateStack.stack.empty();
+    }
+}
+
+void CountStateBinds::apply(const vsg::LOD& lod)
+{
+    // the highest resolution child
+    if (!lod.children.empty() && lod.children.front().node) lod.children.front().node->accept(*this);
+}
+
+void CountStateBinds::apply(const vsg::PagedLOD& plod)
+{
+    for (auto& child : plod.children)
+    {
+        if (child.node)
+        {
+            child.node->accept(*this);
+            return;
+        }
+    }
+}
+
+void CountStateBinds::apply(const vsg::VertexDraw&)
+{
+    draw();
+}
+
+void CountStateBinds::apply(const vsg::VertexIndexDraw&)
+{
+    draw();
+}
+
+void CountStateBinds::apply(const vsg::Geometry&)
+{
+    draw();
+}
+
+void CountStateBinds::apply(const vsg::Draw&)
+{
+    draw();
+}
+
+void CountStateBinds::apply(const vsg::DrawIndexed&)
+{
+    draw();
+}
+
+void CountStateBinds::draw()
+{
+    ++numDraws;
+    for (auto& [slot, stateStack] : _stateStacks)
+    {
+        if (!stateStack.dirty || stateStack.stack.empty()) continue;
+
+        auto stateCommand = stateStack.stack.back();
+        if (stateCommand->is_compatible(typeid(vsg::BindDescriptorSet)) || stateCommand->is_compatible(typeid(vsg::BindDescriptorSets)))
+            ++numDescriptorBinds;
+        else if (slot == 0)
+            ++numPipelineBinds;
+        else
+            ++numOtherBinds;
+
+        stateStack.dirty = false;
+    }
+}
+
+void CountStateBinds::print(std::ostream& out) const
+{
+    out << "pipeline binds = " << numPipelineBinds << ", descriptor binds = " << numDescriptorBinds << ", other state binds = " << numOtherBinds << ", draws = " << numDraws;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <map>
+#include <set>
+
+// Optimizer pass that reduces the state changes the RecordTraversal makes. Within each group's children it:
+//   - collapses StateGroups whose state commands are all already bound by an ancestor, splicing their children into the group,
+//   - sorts runs of sibling StateGroups by pipeline and then by descriptor sets so equal state is bound consecutively,
+//   - merges sibling StateGroups with the same state commands into one,
+//   - merges sibling VertexIndexDraws with compatible arrays into one, with concatenated vertex and index arrays.
+// Nodes with more than one parent are never modified, as what their ancestors bind differs between their parents,
+// and neither is anything below them collapsed. Run before compiling.
+class OptimizeStateGroups : public vsg::Inherit<vsg::Visitor, OptimizeStateGroups>
+{
+public:
+    void optimize(vsg::Node& node);
+
+    // statistics
+    size_t numStateCommandsRemoved = 0;
+    size_t numStateGroupsCollapsed = 0;
+    size_t numStateGroupsMerged = 0;
+    size_t numDrawsMerged = 0;
+
+    void apply(vsg::Node& node) override;
+    void apply(vsg::Group& group) override;
+    void apply(vsg::StateGroup& stateGroup) override;
+
+protected:
+    std::map<vsg::Node*, uint32_t> _numParents;
+    std::set<vsg::Node*> _visited;
+    std::map<uint32_t, std::vector<vsg::StateCommand*>> _stateStacks; // by slot
+    uint32_t _sharedDepth = 0;
+
+    bool modifiable(vsg::Node* node) const;
+    void optimizeChildren(vsg::Group::Children& children);
+    void collapse(vsg::Group::Children& children);
+    void sortAndMerge(vsg::Group::Children& children);
+    void mergeDraws(vsg::Group::Children& children);
+    void traverseChildren(vsg::Group& group);
+};
+
+// Counts the binds a RecordTraversal would record for a frame with everything in view. This mirrors the VSG's
+// StateStack which marks a slot dirty on every push and pop and records its top state command at the next draw.
+class CountStateBinds : public vsg::Inherit<vsg::ConstVisitor, CountStateBinds>
+{
+public:
+    size_t numPipelineBinds = 0;
+    size_t numDescriptorBinds = 0;
+    size_t numOtherBinds = 0;
+    size_t numDraws = 0;
+
+    void apply(const vsg::Node& node) override;
+    void apply(const vsg::StateGroup& stateGroup) override;
+    void apply(const vsg::LOD& lod) override;
+    void apply(const vsg::PagedLOD& plod) override;
+    void apply(const vsg::VertexDraw& vd) override;
+    void apply(const vsg::VertexIndexDraw& vid) override;
+    void apply(const vsg::Geometry& geometry) override;
+    void apply(const vsg::Draw& draw) override;
+    void apply(const vsg::DrawIndexed& drawIndexed) override;
+
+    void print(std::ostream& out) const;
+
+protected:
+    struct StateStack
+    {
+        std::vector<const vsg::StateCommand*> stack;
+        bool dirty = false;
+    };
+
+    std::map<uint32_t, StateStack> _stateStacks; // by slot
+
+    void draw();
+};
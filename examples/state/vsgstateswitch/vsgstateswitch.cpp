@@ -3,6 +3,8 @@
 #include <chrono>
 #include <iostream>
 
+#include "OptimizeStateGroups.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -112,6 +114,7 @@ int main(int argc, char** argv)
 
     bool insertStateSwitch = !arguments.read("-n"); // no replacement of GraphicsPipeline, so assume loaded scene graph has required vsg::StateSwitch
     bool separateRenderGraph = arguments.read("-s");
+    bool optimize = arguments.read("--optimize");
     auto outputFilename = arguments.value<std::string>("", "-o");
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
@@ -133,6 +136,30 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    if (optimize)
+    {
+        // regroup the state before the StateSwitch are inserted so there are fewer of them to switch
+        auto before = CountStateBinds::create();
+        scenegraph->accept(*before);
+
+        auto startTime = vsg::clock::now();
+        auto optimizeStateGroups = OptimizeStateGroups::create();
+        optimizeStateGroups->optimize(*scenegraph);
+        auto time = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+
+        auto after = CountStateBinds::create();
+        scenegraph->accept(*after);
+
+        std::cout << "Optimized state in " << time << "ms, removed " << optimizeStateGroups->numStateCommandsRemoved << " redundant state commands, collapsed "
+                  << optimizeStateGroups->numStateGroupsCollapsed << " and merged " << optimizeStateGroups->numStateGroupsMerged << " StateGroups, merged "
+                  << optimizeStateGroups->numDrawsMerged << " draws" << std::endl;
+        std::cout << "  per frame before : ";
+        before->print(std::cout);
+        std::cout << "\n  per frame after  : ";
+        after->print(std::cout);
+        std::cout << std::endl;
+    }
+
     vsg::Mask mask_1 = 0x1;
     vsg::Mask mask_2 = 0x2;
 
@@ -0,0 +1,258 @@
+#include "BindlessTextureTable.h"
+
+// DescriptorSetLayout created with the descriptor indexing binding flags, which vsg::DescriptorSetLayout doesn't provide
+class BindlessDescriptorSetLayout : public vsg::Inherit<vsg::DescriptorSetLayout, BindlessDescriptorSetLayout>
+{
+public:
+    explicit BindlessDescriptorSetLayout(const vsg::DescriptorSetLayoutBindings& in_bindings)
+    {
+        bindings = in_bindings;
+    }
+
+    VkDescriptorSetLayout vk(uint32_t deviceID) const override { return _layouts[deviceID].layout; }
+
+    void compile(vsg::Context& context) override
+    {
+        if (context.deviceID >= _layouts.size()) _layouts.resize(context.deviceID + 1);
+
+        auto& entry = _layouts[context.deviceID];
+        if (entry.layout) return;
+
+        std::vector<VkDescriptorBindingFlags> bindingFlags(bindings.size(), VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT);
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+        bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (VkResult result = vkCreateDescriptorSetLayout(*context.device, &layoutInfo, context.device->getAllocationCallbacks(), &entry.layout); result != VK_SUCCESS)
+        {
+            throw vsg::Exception{"Error: BindlessDescriptorSetLayout failed to create VkDescriptorSetLayout.", result};
+        }
+        entry.device = context.device;
+    }
+
+protected:
+    virtual ~BindlessDescriptorSetLayout()
+    {
+        for (auto& entry : _layouts)
+        {
+            if (entry.layout) vkDestroyDescriptorSetLayout(*entry.device, entry.layout, entry.device->getAllocationCallbacks());
+        }
+    }
+
+    struct Entry
+    {
+        vsg::ref_ptr<vsg::Device> device;
+        VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    };
+    std::vector<Entry> _layouts; // indexed by deviceID
+};
+
+// binds the table's descriptor set, slot numbering follows vsg::BindDescriptorSet
+class BindBindlessTextureTable : public vsg::Inherit<vsg::StateCommand, BindBindlessTextureTable>
+{
+public:
+    BindBindlessTextureTable(vsg::ref_ptr<BindlessTextureTable> in_table, vsg::ref_ptr<vsg::PipelineLayout> in_layout, uint32_t in_firstSet) :
+        Inherit(1 + in_firstSet),
+        table(in_table),
+        layout(in_layout),
+        firstSet(in_firstSet)
+    {
+    }
+
+    vsg::ref_ptr<BindlessTextureTable> table;
+    vsg::ref_ptr<vsg::PipelineLayout> layout;
+    uint32_t firstSet;
+
+    void traverse(vsg::Visitor& visitor) override { table->accept(visitor); }
+    void traverse(vsg::ConstVisitor& visitor) const override { table->accept(visitor); }
+
+    void compile(vsg::Context& context) override
+    {
+        layout->compile(context);
+        table->compile(context);
+    }
+
+    void record(vsg::CommandBuffer& commandBuffer) const override
+    {
+        VkDescriptorSet descriptorSet = table->vk(commandBuffer.deviceID);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout->vk(commandBuffer.deviceID), firstSet, 1, &descriptorSet, 0, nullptr);
+    }
+};
+
+BindlessTextureTable::BindlessTextureTable(uint32_t in_capacity, const std::vector<VkShaderStageFlags>& in_bindingStages) :
+    capacity(in_capacity),
+    bindingStages(in_bindingStages),
+    _slots(in_capacity)
+{
+    vsg::DescriptorSetLayoutBindings bindings;
+    for (size_t i = 0; i < bindingStages.size(); ++i)
+    {
+        bindings.push_back(VkDescriptorSetLayoutBinding{static_cast<uint32_t>(i), VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity, bindingStages[i], nullptr});
+    }
+    descriptorSetLayout = BindlessDescriptorSetLayout::create(bindings);
+
+    // hand out the lowest slots first
+    for (uint32_t slot = capacity; slot > 0; --slot) _freeList.push_back(slot - 1);
+}
+
+BindlessTextureTable::~BindlessTextureTable()
+{
+    for (auto& implementation : _implementations)
+    {
+        // the descriptor set is freed with its pool
+        if (implementation.descriptorPool) vkDestroyDescriptorPool(*implementation.device, implementation.descriptorPool, implementation.device->getAllocationCallbacks());
+    }
+}
+
+uint32_t BindlessTextureTable::allocate(const vsg::ImageInfoList& images)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    if (_freeList.empty() || images.size() != bindingStages.size()) return ~0u;
+
+    uint32_t slot = _freeList.back();
+    _freeList.pop_back();
+
+    auto& s = _slots[slot];
+    s.images = images;
+    s.upload = vsg::DescriptorImage::create(images, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    s.allocated = true;
+
+    // each device's descriptor set is written at its own compile, devices not yet compiled pick the slot up when they are
+    for (auto& implementation : _implementations)
+    {
+        if (implementation.descriptorSet) implementation.pending.push_back(slot);
+    }
+    return slot;
+}
+
+void BindlessTextureTable::release(uint32_t slot)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    if (slot >= capacity || !_slots[slot].allocated) return;
+
+    // the descriptors are left as they are, partially bound means they needn't be valid once unused
+    _slots[slot] = Slot{};
+    _freeList.push_back(slot);
+}
+
+uint32_t BindlessTextureTable::numAllocated() const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return capacity - static_cast<uint32_t>(_freeList.size());
+}
+
+vsg::ref_ptr<vsg::StateCommand> BindlessTextureTable::createBindCommand(vsg::ref_ptr<vsg::PipelineLayout> layout, uint32_t firstSet)
+{
+    return BindBindlessTextureTable::create(vsg::ref_ptr<BindlessTextureTable>(this), layout, firstSet);
+}
+
+void BindlessTextureTable::compile(vsg::Context& context)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    auto deviceID = context.deviceID;
+    if (deviceID >= _implementations.size()) _implementations.resize(deviceID + 1);
+
+    auto& implementation = _implementations[deviceID];
+    if (!implementation.descriptorSet)
+    {
+        descriptorSetLayout->compile(context);
+
+        auto device = context.device;
+        VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity * static_cast<uint32_t>(bindingStages.size())};
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+
+        if (VkResult result = vkCreateDescriptorPool(*device, &poolInfo, device->getAllocationCallbacks(), &implementation.descriptorPool); result != VK_SUCCESS)
+        {
+            throw vsg::Exception{"Error: BindlessTextureTable failed to create VkDescriptorPool.", result};
+        }
+        implementation.device = device;
+
+        VkDescriptorSetLayout layout = descriptorSetLayout->vk(deviceID);
+        VkDescriptorSetAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocateInfo.descriptorPool = implementation.descriptorPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &layout;
+
+        if (VkResult result = vkAllocateDescriptorSets(*device, &allocateInfo, &implementation.descriptorSet); result != VK_SUCCESS)
+        {
+            throw vsg::Exception{"Error: BindlessTextureTable failed to allocate VkDescriptorSet.", result};
+        }
+
+        // the new set needs every slot allocated so far
+        for (uint32_t slot = 0; slot < capacity; ++slot)
+        {
+            if (_slots[slot].allocated) implementation.pending.push_back(slot);
+        }
+    }
+
+    auto& pending = implementation.pending;
+    if (pending.empty()) return;
+
+    // compiling the DescriptorImages creates the samplers and image views and schedules the texture uploads
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    imageInfos.reserve(pending.size() * bindingStages.size());
+    std::vector<VkWriteDescriptorSet> writes;
+    writes.reserve(pending.size() * bindingStages.size());
+
+    for (auto slot : pending)
+    {
+        auto& s = _slots[slot];
+        if (!s.allocated) continue;
+
+        s.upload->compile(context);
+        for (uint32_t binding = 0; binding < s.images.size(); ++binding)
+        {
+            auto& imageInfo = s.images[binding];
+            imageInfos.push_back(VkDescriptorImageInfo{imageInfo->sampler ? imageInfo->sampler->vk(deviceID) : VK_NULL_HANDLE, imageInfo->imageView->vk(deviceID), imageInfo->imageLayout});
+
+            VkWriteDescriptorSet write = {};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = implementation.descriptorSet;
+            write.dstBinding = binding;
+            write.dstArrayElement = slot;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write.pImageInfo = &imageInfos.back();
+            writes.push_back(write);
+        }
+    }
+
+    // update after bind, so the set may already be bound in command buffers that are in flight
+    vkUpdateDescriptorSets(*context.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    pending.clear();
+}
+
+void BindlessTextureTable::traverse(vsg::Visitor& visitor)
+{
+    for (auto& slot : _slots)
+    {
+        if (slot.upload) slot.upload->accept(visitor);
+    }
+}
+
+void BindlessTextureTable::traverse(vsg::ConstVisitor& visitor) const
+{
+    for (auto& slot : _slots)
+    {
+        if (slot.upload) slot.upload->accept(visitor);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <mutex>
+
+// Global table of textures for bindless rendering with VK_EXT_descriptor_indexing. Each binding of the table's
+// descriptor set is an array of capacity combined image samplers and a slot indexes the same element of every binding,
+// so a material's textures are all found from one index passed to the shaders as instance data or a push constant.
+// The set is created with update after bind and partially bound flags, so slots can be written and reused while
+// command buffers using other slots are in flight, and unallocated slots need no valid descriptor.
+class BindlessTextureTable : public vsg::Inherit<vsg::Object, BindlessTextureTable>
+{
+public:
+    BindlessTextureTable(uint32_t in_capacity, const std::vector<VkShaderStageFlags>& in_bindingStages);
+
+    const uint32_t capacity;
+    const std::vector<VkShaderStageFlags> bindingStages; // one entry per binding
+
+    // layout to use for the table's set in PipelineLayouts
+    vsg::ref_ptr<vsg::DescriptorSetLayout> descriptorSetLayout;
+
+    // allocate a slot for one ImageInfo per binding, returns ~0u when the table is full. The slot's descriptors are
+    // written at the table's next compile, for slots allocated after Viewer::compile() use CompileManager::compile() on
+    // the bind command.
+    uint32_t allocate(const vsg::ImageInfoList& images);
+
+    // return the slot to the free list, only release slots that no command buffer still in flight draws with
+    void release(uint32_t slot);
+
+    uint32_t numAllocated() const;
+
+    // state command binding the table's descriptor set, compiling it compiles the table
+    vsg::ref_ptr<vsg::StateCommand> createBindCommand(vsg::ref_ptr<vsg::PipelineLayout> layout, uint32_t firstSet = 0);
+
+    void compile(vsg::Context& context);
+    VkDescriptorSet vk(uint32_t deviceID) const { return _implementations[deviceID].descriptorSet; }
+
+    // visits the DescriptorImages that upload the textures so dynamic data is collected by the Viewer
+    void traverse(vsg::Visitor& visitor) override;
+    void traverse(vsg::ConstVisitor& visitor) const override;
+
+protected:
+    virtual ~BindlessTextureTable();
+
+    struct Slot
+    {
+        vsg::ImageInfoList images;
+        vsg::ref_ptr<vsg::DescriptorImage> upload;
+        bool allocated = false;
+    };
+
+    struct Implementation
+    {
+        vsg::ref_ptr<vsg::Device> device;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        std::vector<uint32_t> pending; // slots to write at the device's next compile
+    };
+
+    mutable std::mutex _mutex;
+    std::vector<Slot> _slots;
+    std::vector<uint32_t> _freeList;
+    std::vector<Implementation> _implementations; // indexed by deviceID
+};
@@ -4,6 +4,9 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "BindlessTextureTable.h"
+
+#include <algorithm>
 #include <iostream>
 
 void updateBaseTexture(vsg::ubvec4Array2D& image, float value)
@@ -141,87 +144,12 @@ vsg::ref_ptr<vsg::Node> createGeometry(uint32_t numColumns, uint32_t numRows)
     return vid;
 }
 
-int main(int argc, char** argv)
+// Descriptor set version of the scene graph, all tiles' textures in one pair of descriptor arrays and each tile binding
+// its index as a uniform.
+vsg::ref_ptr<vsg::Node> createScenegraph(const std::vector<vsg::ref_ptr<vsg::ubvec4Array2D>>& textureDataList, const std::vector<vsg::ref_ptr<vsg::floatArray2D>>& heightFieldDataList,
+                                         int numColumns, int numRows, vsg::ref_ptr<vsg::ShaderStage> vertexShader, vsg::ref_ptr<vsg::ShaderStage> fragmentShader)
 {
-    // set up defaults and read command line arguments to override them
-    vsg::CommandLine arguments(&argc, argv);
-
-    auto windowTraits = vsg::WindowTraits::create();
-    windowTraits->debugLayer = arguments.read({"--debug", "-d"});
-    windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
-    arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height);
-
-    bool update = arguments.read("--update");
-    int numRows = arguments.value(4, "--rows");
-    int numColumns = arguments.value(4, "--cols");
-    ;
-
-    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
-
-    // set up search paths to SPIRV shaders and textures
-    vsg::Paths searchPaths = vsg::getEnvPaths("VSG_FILE_PATH");
-
-    auto options = vsg::Options::create();
-    options->paths = searchPaths;
-#ifdef vsgXchange_all
-    // add vsgXchange's support for reading and writing 3rd party file formats
-    options->add(vsgXchange::all::create());
-#endif
-
-    // load shaders
-
-    auto vertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/texturearray.vert", options);
-    auto fragmentShader = vsg::read_cast<vsg::ShaderStage>("shaders/texturearray.frag", options);
-
-    if (!vertexShader || !fragmentShader)
-    {
-        vertexShader = vsg::ShaderStage::read(VK_SHADER_STAGE_VERTEX_BIT, "main", vsg::findFile("shaders/texturearray_vert.spv", searchPaths));
-        fragmentShader = vsg::ShaderStage::read(VK_SHADER_STAGE_FRAGMENT_BIT, "main", vsg::findFile("shaders/texturearray_frag.spv", searchPaths));
-    }
-
-    if (!vertexShader || !fragmentShader)
-    {
-        std::cout << "Could not create shaders." << std::endl;
-        return 1;
-    }
-
-    uint32_t numTiles = numRows * numColumns;
-
-    vsg::ShaderStage::SpecializationConstants specializationContexts{
-        {0, vsg::uintValue::create(numTiles)}, // numTiles
-    };
-
-    vertexShader->specializationConstants = specializationContexts;
-    fragmentShader->specializationConstants = specializationContexts;
-
-    // compile section
-    vsg::ShaderStages stagesToCompile;
-    if (vertexShader && vertexShader->module && vertexShader->module->code.empty()) stagesToCompile.emplace_back(vertexShader);
-    if (fragmentShader && fragmentShader->module && fragmentShader->module->code.empty()) stagesToCompile.emplace_back(fragmentShader);
-
-    // set up texture image
-    std::vector<vsg::ref_ptr<vsg::ubvec4Array2D>> textureDataList;
-    for (uint32_t i = 0; i < numTiles; ++i)
-    {
-        auto textureData = vsg::ubvec4Array2D::create(256, 256);
-        textureData->properties.format = VK_FORMAT_R8G8B8A8_UNORM;
-        if (update) textureData->properties.dataVariance = vsg::DYNAMIC_DATA;
-
-        updateBaseTexture(*textureData, 1.0f);
-
-        textureDataList.push_back(textureData);
-    }
-
-    // set up height fields
-    std::vector<vsg::ref_ptr<vsg::floatArray2D>> heightFieldDataList;
-    for (uint32_t i = 0; i < numTiles; ++i)
-    {
-        auto heightField = vsg::floatArray2D::create(64, 64);
-        heightField->properties.format = VK_FORMAT_R32_SFLOAT;
-
-        updateElevation(*heightField, 1.0f);
-        heightFieldDataList.push_back(heightField);
-    }
+    uint32_t numTiles = static_cast<uint32_t>(textureDataList.size());
 
     // set up graphics pipeline
     vsg::DescriptorSetLayoutBindings descriptorBindings{
@@ -345,11 +273,222 @@ int main(int argc, char** argv)
         }
     }
 
+    return scenegraph;
+}
+
+// Bindless version of the scene graph, the textures of all tiles are in one BindlessTextureTable bound once at the root,
+// and each tile's geometry carries its slot in the table as per instance vertex data, so no per tile descriptor sets are bound.
+vsg::ref_ptr<vsg::Node> createBindlessScenegraph(const std::vector<vsg::ref_ptr<vsg::ubvec4Array2D>>& textureDataList, const std::vector<vsg::ref_ptr<vsg::floatArray2D>>& heightFieldDataList,
+                                                 int numColumns, int numRows, uint32_t capacity, vsg::ref_ptr<vsg::Options> options)
+{
+    auto vertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/texturearray_bindless.vert", options);
+    auto fragmentShader = vsg::read_cast<vsg::ShaderStage>("shaders/texturearray_bindless.frag", options);
+    if (!vertexShader || !fragmentShader)
+    {
+        std::cout << "Could not create bindless shaders, shaders/texturearray_bindless.vert and .frag require vsgXchange to compile." << std::endl;
+        return {};
+    }
+
+    if (capacity < textureDataList.size())
+    {
+        std::cout << "Bindless texture table capacity of " << capacity << " is too small for " << textureDataList.size() << " tiles." << std::endl;
+        return {};
+    }
+
+    auto table = BindlessTextureTable::create(capacity, std::vector<VkShaderStageFlags>{VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT});
+
+    vsg::PushConstantRanges pushConstantRanges{
+        {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection view, and model matrices, actual push constant calls automatically provided by the VSG's DispatchTraversal
+    };
+
+    vsg::VertexInputState::Bindings vertexBindingsDescriptions{
+        VkVertexInputBindingDescription{0, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX}, // vertex data
+        VkVertexInputBindingDescription{1, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX}, // colour data
+        VkVertexInputBindingDescription{2, sizeof(vsg::vec2), VK_VERTEX_INPUT_RATE_VERTEX}, // tex coord data
+        VkVertexInputBindingDescription{3, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_INSTANCE} // material index
+    };
+
+    vsg::VertexInputState::Attributes vertexAttributeDescriptions{
+        VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0}, // vertex data
+        VkVertexInputAttributeDescription{1, 1, VK_FORMAT_R32G32B32_SFLOAT, 0}, // colour data
+        VkVertexInputAttributeDescription{2, 2, VK_FORMAT_R32G32_SFLOAT, 0},    // tex coord data
+        VkVertexInputAttributeDescription{3, 3, VK_FORMAT_R32_UINT, 0},         // material index
+    };
+
+    vsg::GraphicsPipelineStates pipelineStates{
+        vsg::VertexInputState::create(vertexBindingsDescriptions, vertexAttributeDescriptions),
+        vsg::InputAssemblyState::create(),
+        vsg::RasterizationState::create(),
+        vsg::MultisampleState::create(),
+        vsg::ColorBlendState::create(),
+        vsg::DepthStencilState::create()};
+
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{table->descriptorSetLayout}, pushConstantRanges);
+    auto graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
+    auto bindGraphicsPipeline = vsg::BindGraphicsPipeline::create(graphicsPipeline);
+
+    auto clampToEdge_sampler = vsg::Sampler::create();
+    clampToEdge_sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    clampToEdge_sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    auto hf_sampler = vsg::Sampler::create();
+    hf_sampler->minFilter = VK_FILTER_NEAREST;
+    hf_sampler->magFilter = VK_FILTER_NEAREST;
+    hf_sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    hf_sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    hf_sampler->anisotropyEnable = VK_FALSE;
+    hf_sampler->maxAnisotropy = 1;
+    hf_sampler->mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    // the table's set is bound once for the whole graph
+    auto scenegraph = vsg::StateGroup::create();
+    scenegraph->add(bindGraphicsPipeline);
+    scenegraph->add(table->createBindCommand(pipelineLayout));
+
+    auto geometry = createGeometry(64, 64).cast<vsg::VertexIndexDraw>();
+
+    for (int r = 0; r < numRows; ++r)
+    {
+        for (int c = 0; c < numColumns; ++c)
+        {
+            uint32_t tileIndex = r * numColumns + c;
+            uint32_t slot = table->allocate(vsg::ImageInfoList{vsg::ImageInfo::create(hf_sampler, heightFieldDataList[tileIndex]), vsg::ImageInfo::create(clampToEdge_sampler, textureDataList[tileIndex])});
+
+            // share the tile geometry's vertex and index buffers, only the material index array differs between tiles
+            auto vid = vsg::VertexIndexDraw::create();
+            vid->arrays = geometry->arrays;
+            vid->arrays.push_back(vsg::BufferInfo::create(vsg::uintArray::create({slot})));
+            vid->indices = geometry->indices;
+            vid->indexType = geometry->indexType;
+            vid->indexCount = geometry->indexCount;
+            vid->instanceCount = 1;
+
+            vsg::dvec3 position(static_cast<float>(c), static_cast<float>(r), 0.0f);
+            auto transform = vsg::MatrixTransform::create(vsg::translate(position));
+            transform->addChild(vid);
+
+            scenegraph->addChild(transform);
+        }
+    }
+
+    std::cout << "Bindless texture table slots allocated " << table->numAllocated() << " of " << table->capacity << std::endl;
+
+    return scenegraph;
+}
+
+int main(int argc, char** argv)
+{
+    // set up defaults and read command line arguments to override them
+    vsg::CommandLine arguments(&argc, argv);
+
+    auto windowTraits = vsg::WindowTraits::create();
+    windowTraits->debugLayer = arguments.read({"--debug", "-d"});
+    windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
+    arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height);
+
+    bool update = arguments.read("--update");
+    int numRows = arguments.value(4, "--rows");
+    int numColumns = arguments.value(4, "--cols");
+    bool bindless = arguments.read("--bindless");
+    uint32_t capacity = arguments.value(std::max(4096u, static_cast<uint32_t>(numRows * numColumns)), "--capacity");
+
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+    // set up search paths to SPIRV shaders and textures
+    vsg::Paths searchPaths = vsg::getEnvPaths("VSG_FILE_PATH");
+
+    auto options = vsg::Options::create();
+    options->paths = searchPaths;
+#ifdef vsgXchange_all
+    // add vsgXchange's support for reading and writing 3rd party file formats
+    options->add(vsgXchange::all::create());
+#endif
+
+    // load shaders
+
+    auto vertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/texturearray.vert", options);
+    auto fragmentShader = vsg::read_cast<vsg::ShaderStage>("shaders/texturearray.frag", options);
+
+    if (!vertexShader || !fragmentShader)
+    {
+        vertexShader = vsg::ShaderStage::read(VK_SHADER_STAGE_VERTEX_BIT, "main", vsg::findFile("shaders/texturearray_vert.spv", searchPaths));
+        fragmentShader = vsg::ShaderStage::read(VK_SHADER_STAGE_FRAGMENT_BIT, "main", vsg::findFile("shaders/texturearray_frag.spv", searchPaths));
+    }
+
+    if (!vertexShader || !fragmentShader)
+    {
+        std::cout << "Could not create shaders." << std::endl;
+        return 1;
+    }
+
+    uint32_t numTiles = numRows * numColumns;
+
+    vsg::ShaderStage::SpecializationConstants specializationContexts{
+        {0, vsg::uintValue::create(numTiles)}, // numTiles
+    };
+
+    vertexShader->specializationConstants = specializationContexts;
+    fragmentShader->specializationConstants = specializationContexts;
+
+    // compile section
+    vsg::ShaderStages stagesToCompile;
+    if (vertexShader && vertexShader->module && vertexShader->module->code.empty()) stagesToCompile.emplace_back(vertexShader);
+    if (fragmentShader && fragmentShader->module && fragmentShader->module->code.empty()) stagesToCompile.emplace_back(fragmentShader);
+
+    // set up texture image
+    std::vector<vsg::ref_ptr<vsg::ubvec4Array2D>> textureDataList;
+    for (uint32_t i = 0; i < numTiles; ++i)
+    {
+        auto textureData = vsg::ubvec4Array2D::create(256, 256);
+        textureData->properties.format = VK_FORMAT_R8G8B8A8_UNORM;
+        if (update) textureData->properties.dataVariance = vsg::DYNAMIC_DATA;
+
+        updateBaseTexture(*textureData, 1.0f);
+
+        textureDataList.push_back(textureData);
+    }
+
+    // set up height fields
+    std::vector<vsg::ref_ptr<vsg::floatArray2D>> heightFieldDataList;
+    for (uint32_t i = 0; i < numTiles; ++i)
+    {
+        auto heightField = vsg::floatArray2D::create(64, 64);
+        heightField->properties.format = VK_FORMAT_R32_SFLOAT;
+
+        updateElevation(*heightField, 1.0f);
+        heightFieldDataList.push_back(heightField);
+    }
+
+    vsg::ref_ptr<vsg::Node> scenegraph;
+    if (bindless)
+    {
+        scenegraph = createBindlessScenegraph(textureDataList, heightFieldDataList, numColumns, numRows, capacity, options);
+        if (!scenegraph) return 1;
+    }
+    else
+    {
+        scenegraph = createScenegraph(textureDataList, heightFieldDataList, numColumns, numRows, vertexShader, fragmentShader);
+    }
+
     // vsg::write(scenegraph, "test.vsgt");
 
     // create the viewer and assign window(s) to it
     auto viewer = vsg::Viewer::create();
 
+    if (bindless)
+    {
+        // the global texture table needs runtime sized, non uniformly indexed arrays with update after bind
+        windowTraits->deviceExtensionNames.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+        auto requestFeatures = windowTraits->deviceFeatures = vsg::DeviceFeatures::create();
+        auto& descriptorIndexingFeatures = requestFeatures->get<VkPhysicalDeviceDescriptorIndexingFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES>();
+        descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    }
+
     auto window = vsg::Window::create(windowTraits);
     if (!window)
     {
@@ -0,0 +1,151 @@
+#include "FontCache.h"
+#include "AtomicSave.h"
+#include "Hash.h"
+#include "ParallelTraversal.h"
+
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+FontCache::FontCache(const vsg::Path& in_cacheDirectory, vsg::ref_ptr<vsg::OperationThreads> in_operationThreads) :
+    cacheDirectory(in_cacheDirectory),
+    operationThreads(in_operationThreads)
+{
+}
+
+uint64_t FontCache::hashFile(const vsg::Path& filename)
+{
+    std::ifstream fin(filename.string(), std::ios::in | std::ios::binary);
+    if (!fin) return 0;
+
+    uint64_t hash = experimental::hashSeed;
+    char buffer[65536];
+    while (fin.read(buffer, sizeof(buffer)) || fin.gcount() > 0)
+    {
+        hash = experimental::hashBytes(buffer, static_cast<size_t>(fin.gcount()), hash);
+    }
+    return hash;
+}
+
+uint64_t FontCache::hashOptions(uint64_t hash, const vsg::Options* options) const
+{
+    if (hash == 0 || !options) return hash;
+
+    auto hashValue = [&](const std::string& name) {
+        hash = experimental::hashBytes(name.data(), name.size(), hash);
+
+        std::string str;
+        double d;
+        float f;
+        int32_t i;
+        uint32_t u;
+        bool b;
+        if (options->getValue(name, str)) hash = experimental::hashBytes(str.data(), str.size(), hash);
+        else if (options->getValue(name, d)) hash = experimental::hashBytes(&d, sizeof(d), hash);
+        else if (options->getValue(name, f)) hash = experimental::hashBytes(&f, sizeof(f), hash);
+        else if (options->getValue(name, i)) hash = experimental::hashBytes(&i, sizeof(i), hash);
+        else if (options->getValue(name, u)) hash = experimental::hashBytes(&u, sizeof(u), hash);
+        else if (options->getValue(name, b)) hash = experimental::hashBytes(&b, sizeof(b), hash);
+        else if (auto data = options->getObject<vsg::Data>(name)) hash = experimental::hashBytes(data->dataPointer(), data->dataSize(), hash);
+    };
+
+    // only the values that are set contribute, so fonts generated with the reader's defaults keep their cache entries
+    for (auto& name : generationOptions)
+    {
+        if (options->getObject(name)) hashValue(name);
+    }
+    return hash;
+}
+
+vsg::Path FontCache::cacheFilename(uint64_t hash) const
+{
+    std::ostringstream str;
+    str << std::hex << std::setw(16) << std::setfill('0') << hash << ".vsgb";
+    return cacheDirectory / str.str();
+}
+
+vsg::ref_ptr<vsg::Font> FontCache::generate(const vsg::Path& filename, uint64_t hash, vsg::ref_ptr<const vsg::Options> options)
+{
+    auto readOptions = options;
+    if (createReaderWriter)
+    {
+        auto taskOptions = vsg::Options::create(*options);
+        taskOptions->readerWriters.insert(taskOptions->readerWriters.begin(), createReaderWriter());
+        readOptions = taskOptions;
+    }
+
+    auto startTime = vsg::clock::now();
+    auto font = vsg::read_cast<vsg::Font>(filename, readOptions);
+    auto duration = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startTime).count();
+    if (!font) return {};
+
+    // write through a temporary file so a concurrent or interrupted run never sees a partial cache entry
+    if (hash != 0 && !cacheDirectory.empty())
+    {
+        experimental::atomicSave(cacheFilename(hash), [&](const vsg::Path& temporaryFilename) { return vsg::write(font, temporaryFilename, options); });
+    }
+
+    std::scoped_lock<std::mutex> lock(_statsMutex);
+    ++_stats.numGenerated;
+    _stats.generateTime += duration;
+    return font;
+}
+
+std::vector<vsg::ref_ptr<vsg::Font>> FontCache::load(const std::vector<vsg::Path>& filenames, vsg::ref_ptr<const vsg::Options> options)
+{
+    if (!cacheDirectory.empty()) vsg::makeDirectory(cacheDirectory);
+
+    std::vector<vsg::ref_ptr<vsg::Font>> fonts(filenames.size());
+    std::vector<std::function<void()>> tasks;
+
+    // fonts listed more than once, or found through different paths, share the first one's entry rather than having
+    // several tasks generate the same font and write the same cache file
+    std::map<uint64_t, size_t> firstIndices;
+    std::vector<std::pair<size_t, size_t>> duplicates;
+    for (size_t i = 0; i < filenames.size(); ++i)
+    {
+        // VSG native files are already pre-baked so only fonts that need generating are cached
+        auto& filename = filenames[i];
+        auto ext = vsg::lowerCaseFileExtension(filename);
+        if (ext == ".vsgb" || ext == ".vsgt")
+        {
+            fonts[i] = vsg::read_cast<vsg::Font>(filename, options);
+            continue;
+        }
+
+        auto foundFilename = vsg::findFile(filename, options);
+        uint64_t hash = foundFilename ? hashOptions(hashFile(foundFilename), options.get()) : 0;
+        if (hash != 0)
+        {
+            if (auto itr = firstIndices.find(hash); itr != firstIndices.end())
+            {
+                duplicates.emplace_back(i, itr->second);
+                continue;
+            }
+            firstIndices[hash] = i;
+        }
+
+        if (hash != 0 && !cacheDirectory.empty())
+        {
+            auto cachedFilename = cacheFilename(hash);
+            if (vsg::fileExists(cachedFilename))
+            {
+                fonts[i] = vsg::read_cast<vsg::Font>(cachedFilename, options);
+                if (fonts[i])
+                {
+                    ++_stats.numCacheHits;
+                    continue;
+                }
+            }
+        }
+
+        tasks.push_back([this, &fonts, i, filename, hash, options]() { fonts[i] = generate(filename, hash, options); });
+    }
+
+    experimental::runTasks(operationThreads.get(), tasks);
+
+    for (auto& [index, firstIndex] : duplicates) fonts[index] = fonts[firstIndex];
+
+    return fonts;
+}
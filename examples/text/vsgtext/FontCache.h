@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <functional>
+#include <mutex>
+
+// Loads fonts through the Options' ReaderWriters, caching the signed distance field fonts generated from .ttf/.otf etc.
+// files on disk as .vsgb files named after a hash of the source file's contents and the generation options, so only the first load of a font pays
+// for generating its glyph atlas. Fonts that aren't cached are generated in parallel across operationThreads.
+class FontCache : public vsg::Inherit<vsg::Object, FontCache>
+{
+public:
+    explicit FontCache(const vsg::Path& in_cacheDirectory, vsg::ref_ptr<vsg::OperationThreads> in_operationThreads = {});
+
+    vsg::Path cacheDirectory;
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+
+    // when assigned each generating task reads its font with its own ReaderWriter, for font readers that serialize access to shared state
+    std::function<vsg::ref_ptr<vsg::ReaderWriter>()> createReaderWriter;
+
+    // load the fonts, the returned fonts are in the same order as filenames with null entries for fonts that couldn't be read
+    std::vector<vsg::ref_ptr<vsg::Font>> load(const std::vector<vsg::Path>& filenames, vsg::ref_ptr<const vsg::Options> options);
+    vsg::ref_ptr<vsg::Font> load(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options) { return load(std::vector<vsg::Path>{filename}, options).front(); }
+
+    // names of the Options values that change the generated font, the values set are part of the cache key
+    std::vector<std::string> generationOptions{"quality", "charset", "texel_margin_ratio", "quad_margin_ratio"};
+
+    // 64 bit FNV-1a hash of the file's contents, 0 if it can't be read
+    static uint64_t hashFile(const vsg::Path& filename);
+
+    // continue hash with the generationOptions values set in options
+    uint64_t hashOptions(uint64_t hash, const vsg::Options* options) const;
+
+    struct Stats
+    {
+        size_t numCacheHits = 0;
+        size_t numGenerated = 0;
+        double generateTime = 0.0; // seconds spent loading, summed over all the fonts generated
+    };
+
+    const Stats& stats() const { return _stats; }
+
+protected:
+    vsg::Path cacheFilename(uint64_t hash) const;
+    vsg::ref_ptr<vsg::Font> generate(const vsg::Path& filename, uint64_t hash, vsg::ref_ptr<const vsg::Options> options);
+
+    std::mutex _statsMutex;
+    Stats _stats;
+};
@@ -5,6 +5,8 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "FontCache.h"
+
 vsg::ref_ptr<vsg::Node> createQuad(const vsg::vec3& origin, const vsg::vec3& horizontal, const vsg::vec3& vertical, vsg::ref_ptr<vsg::Data> sourceData = {})
 {
     struct ConvertToRGBA : public vsg::Visitor
@@ -181,11 +183,20 @@ int main(int argc, char** argv)
     auto numFrames = arguments.value(-1, "--nf");
     auto clearColor = arguments.value(vsg::vec4(0.2f, 0.2f, 0.4f, 1.0f), "--clear");
     bool disableDepthTest = arguments.read({"--ddt", "--disable-depth-test"});
+
+    // cache the distance field fonts generated from .ttf etc. files, generating any additional fonts in parallel
+    auto fontCacheDirectory = arguments.value<vsg::Path>("", "--font-cache");
+    auto numFontThreads = arguments.value(0u, "--font-threads");
+    std::vector<vsg::Path> extraFontFilenames;
+    vsg::Path extraFontFilename;
+    while (arguments.read("--extra-font", extraFontFilename)) extraFontFilenames.push_back(extraFontFilename);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     // set up search paths to SPIRV shaders and textures
     auto options = vsg::Options::create();
     options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
+    options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
 #ifdef vsgXchange_all
     // add vsgXchange's support for reading and writing 3rd party file formats
     options->add(vsgXchange::all::create());
@@ -193,14 +204,36 @@ int main(int argc, char** argv)
 
     arguments.read(options);
 
-    auto font = vsg::read_cast<vsg::Font>(font_filename, options);
+    if (!fontCacheDirectory && options->fileCache) fontCacheDirectory = options->fileCache / "fonts";
+
+    auto fontCache = FontCache::create(fontCacheDirectory, numFontThreads > 0 ? vsg::OperationThreads::create(numFontThreads) : vsg::ref_ptr<vsg::OperationThreads>());
+#ifdef vsgXchange_FOUND
+    // give each font generating thread its own freetype reader rather than them all queuing on the one in options
+    if (numFontThreads > 0) fontCache->createReaderWriter = []() -> vsg::ref_ptr<vsg::ReaderWriter> { return vsgXchange::freetype::create(); };
+#endif
+
+    std::vector<vsg::Path> fontFilenames{font_filename};
+    fontFilenames.insert(fontFilenames.end(), extraFontFilenames.begin(), extraFontFilenames.end());
 
-    if (!font)
+    auto fontLoadStartTime = vsg::clock::now();
+    auto fonts = fontCache->load(fontFilenames, options);
+    auto fontLoadDuration = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - fontLoadStartTime).count();
+
+    auto& fontCacheStats = fontCache->stats();
+    std::cout << "Loaded " << fonts.size() << " fonts in " << fontLoadDuration << "ms, " << fontCacheStats.numCacheHits << " from the font cache, "
+              << fontCacheStats.numGenerated << " generated" << std::endl;
+
+    for (size_t i = 0; i < fonts.size(); ++i)
     {
-        std::cout << "Failing to read font : " << font_filename << std::endl;
-        return 1;
+        if (!fonts[i])
+        {
+            std::cout << "Failing to read font : " << fontFilenames[i] << std::endl;
+            return 1;
+        }
     }
 
+    auto font = fonts.front();
+
     if (disableDepthTest)
     {
         // assign a custom StateSet to options->shaderSets so that subsequent TextGroup::setup(0, options) call will pass in our custom ShaderSet.
@@ -215,6 +248,23 @@ int main(int argc, char** argv)
     // set up model transformation node
     auto scenegraph = vsg::Group::create();
 
+    // label each of the extra fonts in its own typeface
+    for (size_t i = 1; i < fonts.size(); ++i)
+    {
+        auto layout = vsg::StandardLayout::create();
+        layout->position = vsg::vec3(0.0, 0.0, 4.0f + 1.5f * static_cast<float>(i));
+        layout->horizontal = vsg::vec3(1.0, 0.0, 0.0);
+        layout->vertical = vsg::vec3(0.0, 0.0, 1.0);
+        layout->color = vsg::vec4(1.0, 1.0, 1.0, 1.0);
+
+        auto text = vsg::Text::create();
+        text->text = vsg::stringValue::create(fontFilenames[i].string());
+        text->font = fonts[i];
+        text->layout = layout;
+        text->setup(0, options);
+        scenegraph->addChild(text);
+    }
+
     if (render_all_glyphs)
     {
         auto layout = vsg::StandardLayout::create();
@@ -0,0 +1,302 @@
+#include "DynamicTextPool.h"
+#include "ParallelTraversal.h"
+
+#include <algorithm>
+#include <atomic>
+
+DynamicTextPool::DynamicTextPool(vsg::ref_ptr<vsg::Font> in_font, uint32_t in_capacity, uint32_t in_maxGlyphsPerLabel, uint32_t in_labelsPerPage) :
+    font(in_font),
+    capacity(in_capacity),
+    maxGlyphsPerLabel(in_maxGlyphsPerLabel),
+    labelsPerPage(std::max(1u, std::min(in_labelsPerPage, in_capacity)))
+{
+    _labels.reserve(capacity);
+
+    // the pages are allocated up front so their arrays stay the same size and only need updating, never recompiling
+    uint32_t numPages = (capacity + labelsPerPage - 1) / labelsPerPage;
+    uint32_t numVertices = labelsPerPage * maxGlyphsPerLabel * 4;
+    _pages.resize(numPages);
+    for (auto& page : _pages)
+    {
+        page.vertices = vsg::vec3Array::create(numVertices, vsg::vec3(0.0f, 0.0f, 0.0f));
+        page.colors = vsg::vec4Array::create(numVertices, vsg::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+        page.outlineColors = vsg::vec4Array::create(numVertices, vsg::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        page.outlineWidths = vsg::floatArray::create(numVertices, 0.0f);
+        page.texcoords = vsg::vec3Array::create(numVertices, vsg::vec3(0.0f, 0.0f, 0.0f));
+        page.centerAndAutoScaleDistances = vsg::vec4Array::create(numVertices, vsg::vec4(0.0f, 0.0f, 0.0f, 0.0f));
+
+        for (vsg::Data* data : std::initializer_list<vsg::Data*>{page.vertices, page.colors, page.outlineColors, page.outlineWidths, page.texcoords, page.centerAndAutoScaleDistances})
+        {
+            data->properties.dataVariance = vsg::DYNAMIC_DATA;
+        }
+    }
+}
+
+DynamicTextPool::LabelID DynamicTextPool::allocate(vsg::ref_ptr<vsg::TextLayout> layout, const std::string& text)
+{
+    LabelID id = invalidLabel;
+    if (!_freeList.empty())
+    {
+        id = _freeList.back();
+        _freeList.pop_back();
+    }
+    else if (_labels.size() < capacity)
+    {
+        id = static_cast<LabelID>(_labels.size());
+        _labels.emplace_back();
+    }
+    else
+    {
+        return invalidLabel;
+    }
+
+    auto& label = _labels[id];
+    label.layout = layout;
+    label.text = vsg::stringValue::create(text);
+    label.active = true;
+    _changed.insert(id);
+    return id;
+}
+
+void DynamicTextPool::release(LabelID id)
+{
+    if (id >= _labels.size() || !_labels[id].active) return;
+
+    auto& label = _labels[id];
+    label.active = false;
+    label.layout = {};
+    label.text = {};
+    _freeList.push_back(id);
+
+    // cleared on the next update()
+    _changed.insert(id);
+}
+
+void DynamicTextPool::setText(LabelID id, const std::string& text)
+{
+    if (id >= _labels.size() || !_labels[id].active) return;
+
+    auto& label = _labels[id];
+    if (label.text->value() == text) return;
+
+    label.text->value() = text;
+    _changed.insert(id);
+}
+
+void DynamicTextPool::changed(LabelID id)
+{
+    if (id < _labels.size() && _labels[id].active) _changed.insert(id);
+}
+
+void DynamicTextPool::setup(vsg::ref_ptr<const vsg::Options> options)
+{
+    children.clear();
+
+    vsg::ref_ptr<vsg::ShaderSet> shaderSet;
+    if (options)
+    {
+        auto itr = options->shaderSets.find("text");
+        if (itr != options->shaderSets.end()) shaderSet = itr->second;
+    }
+    if (!shaderSet) shaderSet = vsg::createTextShaderSet(options);
+
+    auto config = vsg::GraphicsPipelineConfigurator::create(shaderSet);
+
+    // glyphs are blended over the scene and visible from both sides
+    struct SetPipelineStates : public vsg::Visitor
+    {
+        void apply(vsg::Object& object) override { object.traverse(*this); }
+        void apply(vsg::RasterizationState& rs) override { rs.cullMode = VK_CULL_MODE_NONE; }
+        void apply(vsg::ColorBlendState& cbs) override { cbs.configureAttachments(true); }
+    } setPipelineStates;
+    config->accept(setPipelineStates);
+
+    if (billboard)
+    {
+        if (!config->shaderHints) config->shaderHints = vsg::ShaderCompileSettings::create();
+        config->shaderHints->defines.insert("BILLBOARD");
+    }
+
+    auto sampler = vsg::Sampler::create();
+    sampler->magFilter = VK_FILTER_LINEAR;
+    sampler->minFilter = VK_FILTER_LINEAR;
+    sampler->mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler->borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    sampler->anisotropyEnable = VK_TRUE;
+    sampler->maxAnisotropy = 16.0f;
+    sampler->maxLod = 12.0f;
+
+    config->assignTexture("textureAtlas", font->atlas, sampler);
+
+    // two triangles per glyph quad, shared by all the pages
+    uint32_t numQuads = labelsPerPage * maxGlyphsPerLabel;
+    auto indices = vsg::uintArray::create(numQuads * 6);
+    auto itr = indices->begin();
+    for (uint32_t q = 0; q < numQuads; ++q)
+    {
+        uint32_t i = q * 4;
+        *(itr++) = i;
+        *(itr++) = i + 1;
+        *(itr++) = i + 2;
+        *(itr++) = i + 2;
+        *(itr++) = i + 3;
+        *(itr++) = i;
+    }
+
+    for (size_t p = 0; p < _pages.size(); ++p)
+    {
+        auto& page = _pages[p];
+
+        // the configurator only needs the first page's arrays to set up the vertex input, the others are bound in the same order
+        vsg::DataList arrays;
+        if (p == 0)
+        {
+            config->assignArray(arrays, "inPosition", VK_VERTEX_INPUT_RATE_VERTEX, page.vertices);
+            config->assignArray(arrays, "inColor", VK_VERTEX_INPUT_RATE_VERTEX, page.colors);
+            config->assignArray(arrays, "inOutlineColor", VK_VERTEX_INPUT_RATE_VERTEX, page.outlineColors);
+            config->assignArray(arrays, "inOutlineWidth", VK_VERTEX_INPUT_RATE_VERTEX, page.outlineWidths);
+            config->assignArray(arrays, "inTexCoord", VK_VERTEX_INPUT_RATE_VERTEX, page.texcoords);
+            if (billboard) config->assignArray(arrays, "inCenterAndAutoScaleDistance", VK_VERTEX_INPUT_RATE_VERTEX, page.centerAndAutoScaleDistances);
+        }
+        else
+        {
+            arrays = vsg::DataList{page.vertices, page.colors, page.outlineColors, page.outlineWidths, page.texcoords};
+            if (billboard) arrays.push_back(page.centerAndAutoScaleDistances);
+        }
+
+        page.draw = vsg::VertexIndexDraw::create();
+        page.draw->assignArrays(arrays);
+        page.draw->assignIndices(indices);
+        page.draw->indexCount = page.numSlotsUsed * maxGlyphsPerLabel * 6;
+        page.draw->instanceCount = 1;
+    }
+
+    config->init();
+
+    auto stateGroup = vsg::StateGroup::create();
+    config->copyTo(stateGroup);
+
+    for (auto& page : _pages)
+    {
+        page.draw->firstBinding = config->baseAttributeBinding;
+        stateGroup->addChild(page.draw);
+    }
+
+    addChild(stateGroup);
+}
+
+void DynamicTextPool::writeSlot(LabelID id, const vsg::TextQuads& quads)
+{
+    auto& page = _pages[id / labelsPerPage];
+    size_t base = static_cast<size_t>(id % labelsPerPage) * maxGlyphsPerLabel * 4;
+
+    size_t numQuads = std::min(quads.size(), static_cast<size_t>(maxGlyphsPerLabel));
+    for (size_t q = 0; q < numQuads; ++q)
+    {
+        auto& quad = quads[q];
+        for (size_t i = 0; i < 4; ++i)
+        {
+            size_t v = base + q * 4 + i;
+            page.vertices->at(v) = quad.vertices[i];
+            page.colors->at(v) = quad.colors[i];
+            page.outlineColors->at(v) = quad.outlineColors[i];
+            page.outlineWidths->at(v) = quad.outlineWidths[i];
+            page.texcoords->at(v) = quad.texcoords[i];
+            page.centerAndAutoScaleDistances->at(v) = quad.centerAndAutoScaleDistance;
+        }
+    }
+
+    // collapse the rest of the slot to degenerate quads so they don't rasterize
+    for (size_t v = base + numQuads * 4; v < base + static_cast<size_t>(maxGlyphsPerLabel) * 4; ++v)
+    {
+        page.vertices->at(v).set(0.0f, 0.0f, 0.0f);
+    }
+}
+
+bool DynamicTextPool::layoutLabel(LabelID id)
+{
+    auto& label = _labels[id];
+
+    vsg::TextQuads quads;
+    if (label.active && label.layout) label.layout->layout(label.text.get(), *font, quads);
+
+    writeSlot(id, quads);
+    return quads.size() <= maxGlyphsPerLabel;
+}
+
+void DynamicTextPool::update()
+{
+    if (_changed.empty()) return;
+
+    std::vector<LabelID> changedLabels(_changed.begin(), _changed.end());
+    _changed.clear();
+
+    // labels only write to their own slot so can be laid out concurrently
+    std::atomic<uint64_t> labelsTruncated(0);
+    size_t numThreads = operationThreads ? operationThreads->threads.size() : 0;
+    if (numThreads > 0 && changedLabels.size() >= minParallelLabels)
+    {
+        size_t numTasks = std::min(changedLabels.size(), (numThreads + 1) * 4);
+        std::vector<std::function<void()>> tasks(numTasks);
+        for (size_t t = 0; t < numTasks; ++t)
+        {
+            size_t begin = (changedLabels.size() * t) / numTasks;
+            size_t end = (changedLabels.size() * (t + 1)) / numTasks;
+            tasks[t] = [this, &changedLabels, &labelsTruncated, begin, end]() {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    if (!layoutLabel(changedLabels[i])) ++labelsTruncated;
+                }
+            };
+        }
+
+        experimental::runTasks(operationThreads.get(), tasks);
+    }
+    else
+    {
+        for (auto id : changedLabels)
+        {
+            if (!layoutLabel(id)) ++labelsTruncated;
+        }
+    }
+
+    // changedLabels is sorted so each page's labels are adjacent
+    uint32_t previousPage = ~0u;
+    for (auto id : changedLabels)
+    {
+        uint32_t p = id / labelsPerPage;
+        if (p == previousPage) continue;
+        previousPage = p;
+
+        auto& page = _pages[p];
+        page.vertices->dirty();
+        page.colors->dirty();
+        page.outlineColors->dirty();
+        page.outlineWidths->dirty();
+        page.texcoords->dirty();
+        if (billboard) page.centerAndAutoScaleDistances->dirty();
+
+        // only draw up to highest active slot
+        uint32_t firstSlot = p * labelsPerPage;
+        uint32_t lastSlot = std::min(firstSlot + labelsPerPage, static_cast<uint32_t>(_labels.size()));
+        page.numSlotsUsed = 0;
+        for (uint32_t s = lastSlot; s > firstSlot; --s)
+        {
+            if (_labels[s - 1].active)
+            {
+                page.numSlotsUsed = s - firstSlot;
+                break;
+            }
+        }
+        if (page.draw) page.draw->indexCount = page.numSlotsUsed * maxGlyphsPerLabel * 6;
+
+        ++_stats.pagesDirtied;
+    }
+
+    ++_stats.numUpdates;
+    _stats.labelsLaidOut += changedLabels.size();
+    _stats.labelsTruncated += labelsTruncated;
+}
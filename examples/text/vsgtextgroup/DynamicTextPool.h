@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <set>
+
+// Pool of frequently changing labels drawn together with the standard text ShaderSet. Each label is assigned a slot of
+// maxGlyphsPerLabel glyph quads in one of the pool's pages, a page being a VertexIndexDraw over dynamic vertex arrays
+// shared by labelsPerPage labels. Changing a label only lays out that label again, writing its quads into its slot and
+// dirtying its page, so each frame only the pages with changed labels are transferred to the GPU. Released slots are
+// cleared to degenerate quads and reused by the next allocate(), and the labels changed in a frame are laid out in
+// parallel across operationThreads when assigned.
+//
+// Usage:
+//   1. allocate() the labels, up to capacity,
+//   2. setup() once before Viewer::compile() to create the pipeline and pages,
+//   3. setText(), changed(), release() and allocate() as the labels change, then update() each frame before Viewer::update().
+class DynamicTextPool : public vsg::Inherit<vsg::Group, DynamicTextPool>
+{
+public:
+    using LabelID = uint32_t;
+    static constexpr LabelID invalidLabel = ~0u;
+
+    DynamicTextPool(vsg::ref_ptr<vsg::Font> in_font, uint32_t in_capacity, uint32_t in_maxGlyphsPerLabel = 32, uint32_t in_labelsPerPage = 1024);
+
+    const vsg::ref_ptr<vsg::Font> font;
+    const uint32_t capacity;
+    const uint32_t maxGlyphsPerLabel;
+    const uint32_t labelsPerPage;
+
+    // billboard the labels, the layouts' billboard setting must match
+    bool billboard = false;
+
+    // lay out the changed labels on these threads when there are more than minParallelLabels of them
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+    size_t minParallelLabels = 256;
+
+    // returns invalidLabel when the pool is full
+    LabelID allocate(vsg::ref_ptr<vsg::TextLayout> layout, const std::string& text);
+    void release(LabelID id);
+
+    void setText(LabelID id, const std::string& text);
+
+    // call after modifying a label's TextLayout so it's laid out again on the next update()
+    void changed(LabelID id);
+
+    void setup(vsg::ref_ptr<const vsg::Options> options = {});
+
+    // lay out the labels changed since the last update() and dirty their pages
+    void update();
+
+    size_t numLabels() const { return _labels.size() - _freeList.size(); }
+
+    struct Stats
+    {
+        uint64_t numUpdates = 0;
+        uint64_t labelsLaidOut = 0;
+        uint64_t pagesDirtied = 0;
+        uint64_t labelsTruncated = 0;
+    };
+
+    const Stats& stats() const { return _stats; }
+
+protected:
+    struct Label
+    {
+        vsg::ref_ptr<vsg::TextLayout> layout;
+        vsg::ref_ptr<vsg::stringValue> text;
+        bool active = false;
+    };
+
+    struct Page
+    {
+        vsg::ref_ptr<vsg::vec3Array> vertices;
+        vsg::ref_ptr<vsg::vec4Array> colors;
+        vsg::ref_ptr<vsg::vec4Array> outlineColors;
+        vsg::ref_ptr<vsg::floatArray> outlineWidths;
+        vsg::ref_ptr<vsg::vec3Array> texcoords;
+        vsg::ref_ptr<vsg::vec4Array> centerAndAutoScaleDistances;
+        vsg::ref_ptr<vsg::VertexIndexDraw> draw;
+        uint32_t numSlotsUsed = 0; // one past the highest active slot, limits the indices drawn
+    };
+
+    // lay out the label into its slot, returns false if the text was truncated to fit
+    bool layoutLabel(LabelID id);
+    void writeSlot(LabelID id, const vsg::TextQuads& quads);
+
+    std::vector<Label> _labels;
+    std::vector<LabelID> _freeList;
+    std::set<LabelID> _changed;
+    std::vector<Page> _pages;
+    Stats _stats;
+};
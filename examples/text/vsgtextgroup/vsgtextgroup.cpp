@@ -5,6 +5,33 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "DynamicTextPool.h"
+
+// create a DynamicTextPool holding numLabels track labels laid out in a grid from origin
+vsg::ref_ptr<DynamicTextPool> createDynamicTextPool(vsg::ref_ptr<vsg::Font> font, uint32_t numLabels, uint32_t maxGlyphsPerLabel, const vsg::vec3& origin, const vsg::vec3& dx,
+                                                    const vsg::vec3& horizontal, const vsg::vec3& vertical, bool billboard, float billboardAutoScaleDistance)
+{
+    auto dynamicTextPool = DynamicTextPool::create(font, numLabels, maxGlyphsPerLabel);
+    dynamicTextPool->billboard = billboard;
+
+    uint32_t labelsPerRow = static_cast<uint32_t>(ceil(sqrt(static_cast<double>(numLabels))));
+    for (uint32_t i = 0; i < numLabels; ++i)
+    {
+        auto layout = vsg::StandardLayout::create();
+        layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
+        layout->position = origin + dx * (0.5f * static_cast<float>(i % labelsPerRow)) + vertical * (2.0f * static_cast<float>(i / labelsPerRow));
+        layout->horizontal = horizontal;
+        layout->vertical = vertical;
+        layout->color = vsg::vec4(1.0, 1.0, 1.0, 1.0);
+        layout->outlineWidth = 0.1;
+        layout->billboard = billboard;
+        layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+        dynamicTextPool->allocate(layout, vsg::make_string("Track ", i));
+    }
+
+    return dynamicTextPool;
+}
 
 int main(int argc, char** argv)
 {
@@ -30,6 +57,12 @@ int main(int argc, char** argv)
     bool disableDepthTest = arguments.read({"--ddt", "--disable-depth-test"});
     float billboardAutoScaleDistance = arguments.value(100.0f, "--distance");
 
+    // pool the labels into shared dynamic vertex arrays and change all their strings updateRate times a second
+    bool dynamicText = arguments.read("--dynamic");
+    auto updateRate = arguments.value(10.0, "--update-rate");
+    auto maxGlyphsPerLabel = arguments.value(32u, "--max-glyphs");
+    auto numLayoutThreads = arguments.value(0u, "--layout-threads");
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     // set up search paths to SPIRV shaders and textures
@@ -73,7 +106,19 @@ int main(int argc, char** argv)
     vsg::vec3 horizontal = vsg::vec3(size, 0.0, 0.0);
     vsg::vec3 vertical = billboard ? vsg::vec3(0.0, size, 0.0) : vsg::vec3(0.0, 0.0, size);
 
-    for(uint32_t r = 0; r < numRows; ++r)
+    vsg::ref_ptr<vsg::Node> scene = textgroup;
+    vsg::ref_ptr<DynamicTextPool> dynamicTextPool;
+    if (dynamicText)
+    {
+        dynamicTextPool = createDynamicTextPool(font, numLabels, maxGlyphsPerLabel, row_origin, dx, horizontal, vertical, billboard, billboardAutoScaleDistance);
+        if (numLayoutThreads > 0) dynamicTextPool->operationThreads = vsg::OperationThreads::create(numLayoutThreads);
+        dynamicTextPool->setup(options);
+        dynamicTextPool->update();
+        scene = dynamicTextPool;
+    }
+
+    // the TextGroup's labels, skipped when the DynamicTextPool is used
+    for(uint32_t r = 0; r < numRows && !dynamicTextPool; ++r)
     {
         vsg::vec3 local_origin = row_origin;
         for(uint32_t c = 0; c < numColumns; ++c)
@@ -310,11 +355,11 @@ int main(int argc, char** argv)
         row_origin += dy;
     }
 
-    textgroup->setup(0, options);
+    if (!dynamicTextPool) textgroup->setup(0, options);
 
     if (!output_filename.empty())
     {
-        vsg::write(textgroup, output_filename);
+        vsg::write(scene, output_filename);
         return 1;
     }
 
@@ -336,7 +381,7 @@ int main(int argc, char** argv)
     // camera related details
     // compute the bounds of the scene graph to help position camera
     vsg::ComputeBounds computeBounds;
-    textgroup->accept(computeBounds);
+    scene->accept(computeBounds);
     vsg::dvec3 centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
     double radius = vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.6;
     double nearFarRatio = 0.001;
@@ -347,7 +392,7 @@ int main(int argc, char** argv)
     auto lookAt = vsg::LookAt::create(centre + vsg::dvec3(0.0, -radius * 3.5, 0.0), centre, vsg::dvec3(0.0, 0.0, 1.0));
     auto camera = vsg::Camera::create(perspective, lookAt, viewport);
 
-    auto commandGraph = vsg::createCommandGraphForView(window, camera, textgroup);
+    auto commandGraph = vsg::createCommandGraphForView(window, camera, scene);
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     // compile the Vulkan objects
@@ -361,6 +406,8 @@ int main(int argc, char** argv)
 
     auto startTime = vsg::clock::now();
     double numFramesCompleted = 0.0;
+    auto lastTextUpdate = startTime;
+    uint32_t textUpdateCount = 0;
 
     // main frame loop
     while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
@@ -368,6 +415,14 @@ int main(int argc, char** argv)
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        if (dynamicTextPool && std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - lastTextUpdate).count() * updateRate >= 1.0)
+        {
+            lastTextUpdate = vsg::clock::now();
+            ++textUpdateCount;
+            for (uint32_t i = 0; i < numLabels; ++i) dynamicTextPool->setText(i, vsg::make_string("Track ", i, " : ", textUpdateCount));
+        }
+        if (dynamicTextPool) dynamicTextPool->update();
+
         viewer->update();
 
         viewer->recordAndSubmit();
@@ -384,6 +439,12 @@ int main(int argc, char** argv)
         std::cout << "Average frame rate = " << (numFramesCompleted / duration) << std::endl;
     }
 
+    if (dynamicTextPool)
+    {
+        auto& stats = dynamicTextPool->stats();
+        std::cout << "Dynamic text updates = " << stats.numUpdates << ", labels laid out = " << stats.labelsLaidOut << ", pages dirtied = " << stats.pagesDirtied << ", labels truncated = " << stats.labelsTruncated << std::endl;
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
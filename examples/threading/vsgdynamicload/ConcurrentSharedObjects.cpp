@@ -0,0 +1,232 @@
+#include "ConcurrentSharedObjects.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <streambuf>
+#include <typeinfo>
+
+namespace
+{
+    // std::streambuf that FNV-1a hashes everything written to it rather than storing it
+    class HashStreamBuf : public std::streambuf
+    {
+    public:
+        uint64_t hash = experimental::hashSeed;
+
+    protected:
+        int_type overflow(int_type c) override
+        {
+            if (!traits_type::eq_int_type(c, traits_type::eof()))
+            {
+                char ch = traits_type::to_char_type(c);
+                hash = experimental::hashBytes(&ch, 1, hash);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(const char* s, std::streamsize count) override
+        {
+            hash = experimental::hashBytes(s, static_cast<size_t>(count), hash);
+            return count;
+        }
+    };
+} // namespace
+
+ConcurrentSharedObjects::ConcurrentSharedObjects(size_t in_numShards) :
+    numShards(std::max(in_numShards, size_t(1))),
+    _shards(numShards)
+{
+}
+
+uint64_t ConcurrentSharedObjects::_hash(const vsg::Object& object) const
+{
+    // hash the object as it would be written to .vsgb, which covers the same members as its compare() for the types shared
+    HashStreamBuf streamBuf;
+    std::ostream stream(&streamBuf);
+    vsg::BinaryOutput output(stream);
+    output.writeObject("object", &object);
+
+    return streamBuf.hash ^ static_cast<uint64_t>(typeid(object).hash_code());
+}
+
+uint64_t ConcurrentSharedObjects::_hash(const vsg::Path& filename) const
+{
+    HashStreamBuf streamBuf;
+    std::ostream stream(&streamBuf);
+    stream << filename.string();
+    return streamBuf.hash;
+}
+
+std::unique_lock<std::mutex> ConcurrentSharedObjects::_lock(const Shard& shard) const
+{
+    std::unique_lock<std::mutex> lock(shard.mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        ++numContended;
+        lock.lock();
+    }
+    return lock;
+}
+
+vsg::Object* ConcurrentSharedObjects::_find(const Shard& shard, uint64_t hash, const vsg::Object& object) const
+{
+    auto [begin, end] = shard.objects.equal_range(hash);
+    for (auto itr = begin; itr != end; ++itr)
+    {
+        auto& candidate = itr->second;
+        if (candidate.get() == &object || candidate->compare(object) == 0) return candidate.get();
+        ++numCollisions;
+    }
+    return nullptr;
+}
+
+bool ConcurrentSharedObjects::contains(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options) const
+{
+    auto hash = _hash(filename);
+    auto& shard = _shard(hash);
+    {
+        auto lock = _lock(shard);
+        auto [begin, end] = shard.files.equal_range(hash);
+        for (auto itr = begin; itr != end; ++itr)
+        {
+            auto& file = itr->second;
+            if (file.filename == filename && vsg::compare_pointer(file.options, options) == 0) return true;
+        }
+    }
+
+    // vsg::read() caches files through the base class' share()
+    return vsg::SharedObjects::contains(filename, options);
+}
+
+void ConcurrentSharedObjects::add(vsg::ref_ptr<vsg::Object> object, const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options)
+{
+    auto hash = _hash(filename);
+    auto& shard = _shard(hash);
+    auto lock = _lock(shard);
+
+    auto [begin, end] = shard.files.equal_range(hash);
+    for (auto itr = begin; itr != end; ++itr)
+    {
+        auto& file = itr->second;
+        if (file.filename == filename && vsg::compare_pointer(file.options, options) == 0)
+        {
+            file.object = object;
+            return;
+        }
+    }
+
+    shard.files.emplace(hash, Shard::File{filename, options, object});
+}
+
+bool ConcurrentSharedObjects::remove(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options)
+{
+    bool removed = false;
+
+    auto hash = _hash(filename);
+    auto& shard = _shard(hash);
+    {
+        auto lock = _lock(shard);
+        auto [begin, end] = shard.files.equal_range(hash);
+        for (auto itr = begin; itr != end;)
+        {
+            auto& file = itr->second;
+            if (file.filename == filename && vsg::compare_pointer(file.options, options) == 0)
+            {
+                itr = shard.files.erase(itr);
+                removed = true;
+            }
+            else
+            {
+                ++itr;
+            }
+        }
+    }
+
+    return vsg::SharedObjects::remove(filename, options) || removed;
+}
+
+void ConcurrentSharedObjects::clear()
+{
+    for (auto& shard : _shards)
+    {
+        auto lock = _lock(shard);
+        shard.objects.clear();
+        shard.files.clear();
+    }
+
+    vsg::SharedObjects::clear();
+}
+
+void ConcurrentSharedObjects::prune()
+{
+    for (auto& shard : _shards)
+    {
+        auto lock = _lock(shard);
+        for (auto itr = shard.objects.begin(); itr != shard.objects.end();)
+        {
+            if (itr->second->referenceCount() == 1)
+                itr = shard.objects.erase(itr);
+            else
+                ++itr;
+        }
+        for (auto itr = shard.files.begin(); itr != shard.files.end();)
+        {
+            if (!itr->second.object || itr->second.object->referenceCount() == 1)
+                itr = shard.files.erase(itr);
+            else
+                ++itr;
+        }
+    }
+
+    vsg::SharedObjects::prune();
+}
+
+void ConcurrentSharedObjects::report(std::ostream& out) const
+{
+    size_t numObjects = 0, numFiles = 0, maxShardObjects = 0;
+    for (auto& shard : _shards)
+    {
+        auto lock = _lock(shard);
+        numObjects += shard.objects.size();
+        numFiles += shard.files.size();
+        maxShardObjects = std::max(maxShardObjects, shard.objects.size());
+    }
+
+    out << "ConcurrentSharedObjects shards = " << numShards << ", objects = " << numObjects << " (largest shard " << maxShardObjects << "), files = " << numFiles << std::endl;
+    out << "    hits = " << numHits << ", misses = " << numMisses << ", collisions = " << numCollisions << ", contended = " << numContended << std::endl;
+}
+
+ShareSubgraph::ShareSubgraph(vsg::ref_ptr<ConcurrentSharedObjects> in_sharedObjects) :
+    sharedObjects(in_sharedObjects)
+{
+}
+
+void ShareSubgraph::apply(vsg::Node& node)
+{
+    node.traverse(*this);
+}
+
+void ShareSubgraph::apply(vsg::StateGroup& stateGroup)
+{
+    sharedObjects->share(stateGroup.stateCommands);
+    stateGroup.traverse(*this);
+}
+
+void ShareSubgraph::apply(vsg::VertexIndexDraw& vid)
+{
+    for (auto& bufferInfo : vid.arrays)
+    {
+        if (bufferInfo) sharedObjects->share(bufferInfo->data);
+    }
+    if (vid.indices) sharedObjects->share(vid.indices->data);
+}
+
+void ShareSubgraph::apply(vsg::Geometry& geometry)
+{
+    for (auto& bufferInfo : geometry.arrays)
+    {
+        if (bufferInfo) sharedObjects->share(bufferInfo->data);
+    }
+    if (geometry.indices) sharedObjects->share(geometry.indices->data);
+    geometry.traverse(*this);
+}
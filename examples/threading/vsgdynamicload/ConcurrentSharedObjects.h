@@ -0,0 +1,136 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+// SharedObjects for many loader threads deduplicating at once. vsg::SharedObjects keeps every type in one ordered set
+// behind one mutex, so each share() takes the lock and makes O(log n) deep comparisons against its neighbours in the
+// set. Here objects are keyed by a 64 bit hash of their type and serialized contents, spread over numShards shards each
+// with its own mutex, and a deep compare is only made against objects whose hash matches, normally just the one equal
+// object. Objects that compare equal but serialize differently are not merged, which only costs some sharing.
+// It can be assigned to vsg::Options::sharedObjects in place of a vsg::SharedObjects: the virtual file cache methods,
+// contains(), add() and remove(), use the shards, while share() calls made through a vsg::SharedObjects pointer, such as
+// those inside vsg::read() and the vsgXchange loaders, go to the base class implementation as share() is a non-virtual
+// template. Code holding a ConcurrentSharedObjects gets the sharded share(), which ShareSubgraph uses to share the
+// state and arrays of loaded subgraphs.
+class ConcurrentSharedObjects : public vsg::Inherit<vsg::SharedObjects, ConcurrentSharedObjects>
+{
+public:
+    explicit ConcurrentSharedObjects(size_t in_numShards = 64);
+
+    const size_t numShards;
+
+    template<class T>
+    void share(vsg::ref_ptr<T>& object)
+    {
+        share(object, [](vsg::ref_ptr<T>&) {});
+    }
+
+    // share object, calling init on it if it is the first of its kind, as vsg::SharedObjects::share()
+    template<class T, typename Func>
+    void share(vsg::ref_ptr<T>& object, Func init);
+
+    template<class C>
+    void share(C& container)
+    {
+        for (auto& object : container) share(object);
+    }
+
+    bool contains(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) const override;
+    void add(vsg::ref_ptr<vsg::Object> object, const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) override;
+    bool remove(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) override;
+
+    // remove all the objects held, along with those in the base class
+    void clear();
+
+    // remove the objects only referenced by this, along with those in the base class
+    void prune();
+
+    // statistics
+    mutable std::atomic_uint64_t numHits{0};
+    mutable std::atomic_uint64_t numMisses{0};
+    mutable std::atomic_uint64_t numCollisions{0}; // hashes matched but the objects compared different
+    mutable std::atomic_uint64_t numContended{0};  // shard locks that were already held by another thread
+
+    void report(std::ostream& out) const;
+
+protected:
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_multimap<uint64_t, vsg::ref_ptr<vsg::Object>> objects;
+
+        struct File
+        {
+            vsg::Path filename;
+            vsg::ref_ptr<const vsg::Options> options;
+            vsg::ref_ptr<vsg::Object> object;
+        };
+        std::unordered_multimap<uint64_t, File> files;
+    };
+
+    uint64_t _hash(const vsg::Object& object) const;
+    uint64_t _hash(const vsg::Path& filename) const;
+    Shard& _shard(uint64_t hash) const { return _shards[hash % numShards]; }
+    std::unique_lock<std::mutex> _lock(const Shard& shard) const;
+
+    // returns the object already held that equals object, or nullptr
+    vsg::Object* _find(const Shard& shard, uint64_t hash, const vsg::Object& object) const;
+
+    mutable std::vector<Shard> _shards;
+};
+
+template<class T, typename Func>
+void ConcurrentSharedObjects::share(vsg::ref_ptr<T>& object, Func init)
+{
+    if (!object) return;
+
+    // hash before init() so a later object equal to this one before its init() matches it, as with vsg::SharedObjects
+    auto hash = _hash(*object);
+    auto& shard = _shard(hash);
+    {
+        auto lock = _lock(shard);
+        if (auto found = _find(shard, hash, *object))
+        {
+            object = vsg::ref_ptr<T>(static_cast<T*>(found));
+            ++numHits;
+            return;
+        }
+    }
+
+    init(object);
+
+    auto lock = _lock(shard);
+
+    // another thread may have shared an equal object while init() ran
+    if (auto found = _find(shard, hash, *object))
+    {
+        object = vsg::ref_ptr<T>(static_cast<T*>(found));
+        ++numHits;
+        return;
+    }
+
+    shard.objects.emplace(hash, object);
+    ++numMisses;
+}
+
+// Visitor that shares the state commands of StateGroups and the arrays of geometry through a ConcurrentSharedObjects,
+// so loaded models with equal textures, descriptor sets and pipelines reuse the first copy, and its compiled Vulkan objects.
+class ShareSubgraph : public vsg::Inherit<vsg::Visitor, ShareSubgraph>
+{
+public:
+    explicit ShareSubgraph(vsg::ref_ptr<ConcurrentSharedObjects> in_sharedObjects);
+
+    vsg::ref_ptr<ConcurrentSharedObjects> sharedObjects;
+
+    using vsg::Visitor::apply;
+
+    void apply(vsg::Node& node) override;
+    void apply(vsg::StateGroup& stateGroup) override;
+    void apply(vsg::VertexIndexDraw& vid) override;
+    void apply(vsg::Geometry& geometry) override;
+};
@@ -0,0 +1,120 @@
+#include "MergeQueue.h"
+
+#include <set>
+
+void MergeQueue::add(vsg::ref_ptr<Merge> merge, uint64_t bytes, const vsg::dsphere& bound)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _pending.push_back(Pending{merge, bytes, bound});
+    _pendingBytes += bytes;
+    maxBacklog = std::max(maxBacklog, _pending.size());
+}
+
+size_t MergeQueue::backlog() const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return _pending.size();
+}
+
+uint64_t MergeQueue::backlogBytes() const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return _pendingBytes;
+}
+
+bool MergeQueue::visible(const vsg::dsphere& bound, const vsg::dmat4& projectionView) const
+{
+    // subgraphs without a bound are treated as visible
+    if (bound.radius <= 0.0) return true;
+
+    // test against the left, right, bottom and top planes of the view frustum
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        for (double side : {1.0, -1.0})
+        {
+            vsg::dvec4 plane(projectionView[0][3] + side * projectionView[0][axis],
+                             projectionView[1][3] + side * projectionView[1][axis],
+                             projectionView[2][3] + side * projectionView[2][axis],
+                             projectionView[3][3] + side * projectionView[3][axis]);
+            double length = vsg::length(vsg::dvec3(plane.x, plane.y, plane.z));
+            double distance = (plane.x * bound.center.x + plane.y * bound.center.y + plane.z * bound.center.z + plane.w) / length;
+            if (distance < -bound.radius) return false;
+        }
+    }
+    return true;
+}
+
+void MergeQueue::update()
+{
+    std::vector<Pending> pending;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        pending.swap(_pending);
+    }
+
+    if (pending.empty()) return;
+
+    ++numFramesWithBacklog;
+
+    if (camera)
+    {
+        // stable partition so merges are otherwise run in the order they were added
+        auto projectionView = camera->projectionMatrix->transform() * camera->viewMatrix->transform();
+        std::stable_partition(pending.begin(), pending.end(), [&](const Pending& p) { return visible(p.bound, projectionView); });
+    }
+
+    auto start = vsg::clock::now();
+    uint64_t bytesMerged = 0;
+    auto itr = pending.begin();
+    for (; itr != pending.end(); ++itr)
+    {
+        if (itr != pending.begin())
+        {
+            double elapsed = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+            if (timeBudget > 0.0 && elapsed >= timeBudget) break;
+            if (byteBudget > 0 && bytesMerged + itr->bytes > byteBudget) break;
+        }
+
+        itr->merge->run();
+        bytesMerged += itr->bytes;
+        ++numMerged;
+    }
+
+    // return the merges that didn't fit within the budget to the front of the queue
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _pendingBytes -= bytesMerged;
+    _pending.insert(_pending.begin(), std::make_move_iterator(itr), std::make_move_iterator(pending.end()));
+}
+
+uint64_t computeDataSize(const vsg::Node& node)
+{
+    struct DataSize : public vsg::ConstVisitor
+    {
+        std::set<const vsg::Data*> visited;
+        uint64_t size = 0;
+
+        void apply(const vsg::Object& object) override
+        {
+            object.traverse(*this);
+        }
+
+        void apply(const vsg::Data& data) override
+        {
+            if (visited.insert(&data).second) size += data.dataSize();
+        }
+    } dataSize;
+
+    node.accept(dataSize);
+    return dataSize.size;
+}
+
+vsg::dsphere computeWorldBound(const vsg::Node& node, const vsg::Group& attachmentPoint)
+{
+    vsg::ComputeBounds computeBounds;
+    if (auto transform = attachmentPoint.cast<vsg::MatrixTransform>()) computeBounds.matrixStack.push_back(transform->matrix);
+    node.accept(computeBounds);
+
+    auto& bb = computeBounds.bounds;
+    if (!bb.valid()) return {};
+    return vsg::dsphere((bb.min + bb.max) * 0.5, vsg::length(bb.max - bb.min) * 0.5);
+}
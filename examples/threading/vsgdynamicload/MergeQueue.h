@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vsg/all.h>
+
+struct Merge : public vsg::Inherit<vsg::Operation, Merge>
+{
+    Merge(const vsg::Path& in_path, vsg::observer_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Group> in_attachmentPoint, vsg::ref_ptr<vsg::Node> in_node, const vsg::CompileResult& in_compileResult):
+        path(in_path),
+        viewer(in_viewer),
+        attachmentPoint(in_attachmentPoint),
+        node(in_node),
+        compileResult(in_compileResult) {}
+
+    vsg::Path path;
+    vsg::observer_ptr<vsg::Viewer> viewer;
+    vsg::ref_ptr<vsg::Group> attachmentPoint;
+    vsg::ref_ptr<vsg::Node> node;
+    vsg::CompileResult compileResult;
+
+    void run() override
+    {
+        vsg::debug("Merge::run() path = ", path, ", ", attachmentPoint, ", ", node);
+
+        vsg::ref_ptr<vsg::Viewer> ref_viewer = viewer;
+        if (ref_viewer)
+        {
+            updateViewer(*ref_viewer, compileResult);
+        }
+
+        attachmentPoint->addChild(node);
+    }
+};
+
+// Spreads the merging of background loaded subgraphs over several frames.
+// Loading threads add compiled subgraphs along with an estimate of their size and optional world space bound,
+// then each frame update() runs pending Merge operations until the time or byte budget for the frame is spent.
+// When a camera is assigned, merges for subgraphs that are within the camera's view frustum are run first.
+class MergeQueue : public vsg::Inherit<vsg::Object, MergeQueue>
+{
+public:
+    // per frame budgets, a value of 0 disables the associated budget. At least one merge is run every frame.
+    double timeBudget = 2.0; // milliseconds
+    uint64_t byteBudget = 0;
+
+    // optional camera used to merge visible subgraphs first
+    vsg::ref_ptr<vsg::Camera> camera;
+
+    // add merge to the queue, thread safe so can be called from loading threads.
+    void add(vsg::ref_ptr<Merge> merge, uint64_t bytes = 0, const vsg::dsphere& bound = {});
+
+    // run pending merges within the frame budgets, call once per frame after Viewer::update().
+    void update();
+
+    // number of merges and bytes waiting to be merged
+    size_t backlog() const;
+    uint64_t backlogBytes() const;
+
+    // stats
+    uint64_t numMerged = 0;
+    size_t maxBacklog = 0;
+    uint64_t numFramesWithBacklog = 0;
+
+protected:
+    struct Pending
+    {
+        vsg::ref_ptr<Merge> merge;
+        uint64_t bytes = 0;
+        vsg::dsphere bound;
+    };
+
+    bool visible(const vsg::dsphere& bound, const vsg::dmat4& projectionView) const;
+
+    mutable std::mutex _mutex;
+    std::vector<Pending> _pending;
+    uint64_t _pendingBytes = 0;
+};
+
+// estimate the memory used by the data in a subgraph
+uint64_t computeDataSize(const vsg::Node& node);
+
+// compute the world space bound of a subgraph that will be attached to attachmentPoint
+vsg::dsphere computeWorldBound(const vsg::Node& node, const vsg::Group& attachmentPoint);
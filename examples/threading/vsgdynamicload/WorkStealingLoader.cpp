@@ -0,0 +1,164 @@
+#include "WorkStealingLoader.h"
+#include "ConcurrentSharedObjects.h"
+
+WorkStealingLoader::WorkStealingLoader(vsg::ref_ptr<vsg::Viewer> in_viewer, uint32_t numThreads, vsg::ref_ptr<vsg::ResourceHints> resourceHints) :
+    _viewer(in_viewer)
+{
+    numThreads = std::max(numThreads, 1u);
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        auto worker = std::make_unique<Worker>();
+        worker->compileManager = vsg::CompileManager::create(*in_viewer, resourceHints);
+        _workers.push_back(std::move(worker));
+    }
+
+    // start the threads once all the workers exist as any of them may steal from the others
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        _workers[i]->thread = std::thread([this, i]() { run(i); });
+    }
+}
+
+WorkStealingLoader::~WorkStealingLoader()
+{
+    stop();
+}
+
+void WorkStealingLoader::stop()
+{
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _active = false;
+    }
+    _cv.notify_all();
+
+    for (auto& worker : _workers)
+    {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+}
+
+void WorkStealingLoader::load(vsg::ref_ptr<vsg::Group> attachmentPoint, const vsg::Path& filename, vsg::ref_ptr<vsg::Options> options)
+{
+    // distribute new loads round robin, stealing takes care of any imbalance
+    auto& worker = *_workers[_nextWorker++ % _workers.size()];
+    {
+        std::scoped_lock<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(Task{READ, attachmentPoint, filename, options, {}});
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        ++_numQueued;
+    }
+    _cv.notify_one();
+}
+
+bool WorkStealingLoader::take(uint32_t index, Task& task)
+{
+    // newest task from our own deque first
+    {
+        auto& worker = *_workers[index];
+        std::scoped_lock<std::mutex> lock(worker.mutex);
+        if (!worker.tasks.empty())
+        {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // otherwise steal the oldest task from another thread
+    for (size_t i = 1; i < _workers.size(); ++i)
+    {
+        auto& victim = *_workers[(index + i) % _workers.size()];
+        std::scoped_lock<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            ++numStolen;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingLoader::process(uint32_t index, Task& task)
+{
+    auto& worker = *_workers[index];
+
+    switch (task.stage)
+    {
+    case READ:
+        task.node = vsg::read_cast<vsg::Node>(task.filename, task.options);
+        if (!task.node) return;
+        task.stage = OPTIMIZE;
+        break;
+    case OPTIMIZE: {
+        if (auto concurrentSharedObjects = task.options ? task.options->sharedObjects.cast<ConcurrentSharedObjects>() : vsg::ref_ptr<ConcurrentSharedObjects>{})
+        {
+            ShareSubgraph shareSubgraph(concurrentSharedObjects);
+            task.node->accept(shareSubgraph);
+        }
+
+        vsg::ComputeBounds computeBounds;
+        task.node->accept(computeBounds);
+
+        vsg::dvec3 centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
+        double radius = vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.5;
+        auto scale = vsg::MatrixTransform::create(vsg::scale(1.0 / radius, 1.0 / radius, 1.0 / radius) * vsg::translate(-centre));
+
+        scale->addChild(task.node);
+        task.node = scale;
+        task.stage = COMPILE;
+        break;
+    }
+    case COMPILE: {
+        vsg::ref_ptr<vsg::Viewer> ref_viewer = _viewer;
+        if (!ref_viewer) return;
+
+        auto result = worker.compileManager->compile(task.node);
+        if (result)
+        {
+            auto merge = Merge::create(task.filename, _viewer, task.attachmentPoint, task.node, result);
+            if (mergeQueue) mergeQueue->add(merge, computeDataSize(*task.node), computeWorldBound(*task.node, *task.attachmentPoint));
+            else ref_viewer->addUpdateOperation(merge);
+        }
+        ++numLoaded;
+        return;
+    }
+    }
+
+    // queue the next stage on our own deque where it'll be picked up next unless an idle thread steals it first
+    {
+        std::scoped_lock<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        ++_numQueued;
+    }
+    _cv.notify_one();
+}
+
+void WorkStealingLoader::run(uint32_t index)
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this]() { return !_active || _numQueued > 0; });
+            if (!_active) return;
+            --_numQueued;
+        }
+
+        // a queued task is guaranteed to be in one of the deques, though another thread may briefly hold its lock
+        Task task;
+        while (!take(index, task)) std::this_thread::yield();
+
+        process(index, task);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "MergeQueue.h"
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+// Work-stealing loader that runs the read, optimize and compile of each model as separate tasks.
+// Every thread owns a deque of tasks and a CompileManager, so compiles on different threads use their own
+// transfer and compile contexts rather than contending for the viewer's. Threads push the next stage of a load
+// on to the back of their own deque and take work from the back, so a model usually goes from read to compile
+// on one thread, idle threads steal the oldest tasks from the front of other threads' deques. Compiled models are
+// passed to the viewer's update operations, or the mergeQueue when assigned, for merging via Merge.
+class WorkStealingLoader : public vsg::Inherit<vsg::Object, WorkStealingLoader>
+{
+public:
+    WorkStealingLoader(vsg::ref_ptr<vsg::Viewer> in_viewer, uint32_t numThreads, vsg::ref_ptr<vsg::ResourceHints> resourceHints = {});
+
+    void load(vsg::ref_ptr<vsg::Group> attachmentPoint, const vsg::Path& filename, vsg::ref_ptr<vsg::Options> options);
+
+    void stop();
+
+    // optional queue that compiled models are passed to instead of the viewer's update operations
+    vsg::ref_ptr<MergeQueue> mergeQueue;
+
+    // stats
+    std::atomic_uint64_t numLoaded{0};
+    std::atomic_uint64_t numStolen{0};
+
+protected:
+    virtual ~WorkStealingLoader();
+
+    enum Stage
+    {
+        READ,
+        OPTIMIZE,
+        COMPILE
+    };
+
+    struct Task
+    {
+        Stage stage = READ;
+        vsg::ref_ptr<vsg::Group> attachmentPoint;
+        vsg::Path filename;
+        vsg::ref_ptr<vsg::Options> options;
+        vsg::ref_ptr<vsg::Node> node;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        vsg::ref_ptr<vsg::CompileManager> compileManager;
+        std::thread thread;
+    };
+
+    bool take(uint32_t index, Task& task);
+    void process(uint32_t index, Task& task);
+    void run(uint32_t index);
+
+    vsg::observer_ptr<vsg::Viewer> _viewer;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic_uint32_t _nextWorker{0};
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    uint64_t _numQueued = 0;
+    bool _active = true;
+};
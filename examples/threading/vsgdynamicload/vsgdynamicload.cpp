@@ -9,47 +9,23 @@
 #include <iostream>
 #include <thread>
 
-struct Merge : public vsg::Inherit<vsg::Operation, Merge>
-{
-    Merge(const vsg::Path& in_path, vsg::observer_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Group> in_attachmentPoint, vsg::ref_ptr<vsg::Node> in_node, const vsg::CompileResult& in_compileResult):
-        path(in_path),
-        viewer(in_viewer),
-        attachmentPoint(in_attachmentPoint),
-        node(in_node),
-        compileResult(in_compileResult) {}
-
-    vsg::Path path;
-    vsg::observer_ptr<vsg::Viewer> viewer;
-    vsg::ref_ptr<vsg::Group> attachmentPoint;
-    vsg::ref_ptr<vsg::Node> node;
-    vsg::CompileResult compileResult;
-
-    void run() override
-    {
-        std::cout<<"Merge::run() path = "<<path<<", "<<attachmentPoint<<", "<<node<<std::endl;
-
-        vsg::ref_ptr<vsg::Viewer> ref_viewer = viewer;
-        if (ref_viewer)
-        {
-            updateViewer(*ref_viewer, compileResult);
-        }
-
-        attachmentPoint->addChild(node);
-    }
-};
+#include "ConcurrentSharedObjects.h"
+#include "WorkStealingLoader.h"
 
 struct LoadOperation : public vsg::Inherit<vsg::Operation, LoadOperation>
 {
-    LoadOperation(vsg::ref_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Group> in_attachmentPoint, const vsg::Path& in_filename, vsg::ref_ptr<vsg::Options> in_options) :
+    LoadOperation(vsg::ref_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Group> in_attachmentPoint, const vsg::Path& in_filename, vsg::ref_ptr<vsg::Options> in_options, vsg::ref_ptr<MergeQueue> in_mergeQueue = {}) :
         viewer(in_viewer),
         attachmentPoint(in_attachmentPoint),
         filename(in_filename),
-        options(in_options) {}
+        options(in_options),
+        mergeQueue(in_mergeQueue) {}
 
     vsg::observer_ptr<vsg::Viewer> viewer;
     vsg::ref_ptr<vsg::Group> attachmentPoint;
     vsg::Path filename;
     vsg::ref_ptr<vsg::Options> options;
+    vsg::ref_ptr<MergeQueue> mergeQueue;
 
     void run() override
     {
@@ -60,6 +36,12 @@ struct LoadOperation : public vsg::Inherit<vsg::Operation, LoadOperation>
         {
             // std::cout << "Loaded " << filename << std::endl;
 
+            if (auto concurrentSharedObjects = options->sharedObjects.cast<ConcurrentSharedObjects>())
+            {
+                ShareSubgraph shareSubgraph(concurrentSharedObjects);
+                node->accept(shareSubgraph);
+            }
+
             vsg::ComputeBounds computeBounds;
             node->accept(computeBounds);
 
@@ -70,7 +52,12 @@ struct LoadOperation : public vsg::Inherit<vsg::Operation, LoadOperation>
             scale->addChild(node);
 
             auto result = ref_viewer->compileManager->compile(node);
-            if (result) ref_viewer->addUpdateOperation(Merge::create(filename, viewer, attachmentPoint, scale, result));
+            if (result)
+            {
+                auto merge = Merge::create(filename, viewer, attachmentPoint, scale, result);
+                if (mergeQueue) mergeQueue->add(merge, computeDataSize(*scale), computeWorldBound(*scale, *attachmentPoint));
+                else ref_viewer->addUpdateOperation(merge);
+            }
         }
     }
 };
@@ -95,6 +82,14 @@ int main(int argc, char** argv)
 
         arguments.read(options);
 
+        // optionally replace the SharedObjects with one that shards its locks, so the loader threads contend less
+        vsg::ref_ptr<ConcurrentSharedObjects> concurrentSharedObjects;
+        if (arguments.read({"--concurrent-shared-objects", "--cso"}))
+        {
+            concurrentSharedObjects = ConcurrentSharedObjects::create(arguments.value<size_t>(64, "--shards"));
+            options->sharedObjects = concurrentSharedObjects;
+        }
+
         auto windowTraits = vsg::WindowTraits::create();
         windowTraits->windowTitle = "vsgdynamicload";
         windowTraits->debugLayer = arguments.read({"--debug", "-d"});
@@ -105,6 +100,20 @@ int main(int argc, char** argv)
         arguments.read("--display", windowTraits->display);
         auto numFrames = arguments.value(-1, "-f");
         auto numThreads = arguments.value(16, "-n");
+        auto workStealing = arguments.read({"--work-stealing", "--ws"});
+
+        // optionally spread merging of loaded models over several frames, with per frame time budget in milliseconds and byte budget in megabytes
+        auto mergeTimeBudget = arguments.value(0.0, "--merge-budget");
+        auto mergeByteBudget = arguments.value(0.0, "--merge-bytes");
+        vsg::ref_ptr<MergeQueue> mergeQueue;
+        if (mergeTimeBudget > 0.0 || mergeByteBudget > 0.0)
+        {
+            mergeQueue = MergeQueue::create();
+            mergeQueue->timeBudget = mergeTimeBudget;
+            mergeQueue->byteBudget = static_cast<uint64_t>(mergeByteBudget * 1024.0 * 1024.0);
+        }
+        auto mergeVisibleFirst = arguments.read("--merge-visible-first");
+        auto reportBacklog = arguments.read("--report-backlog");
 
         // provide setting of the resource hints on the command line
         vsg::ref_ptr<vsg::ResourceHints> resourceHints;
@@ -153,6 +162,7 @@ int main(int argc, char** argv)
         auto perspective = vsg::Perspective::create(30.0, static_cast<double>(window->extent2D().width) / static_cast<double>(window->extent2D().height), nearFarRatio * viewingDistance, viewingDistance * 2.0);
         auto viewportState = vsg::ViewportState::create(window->extent2D());
         auto camera = vsg::Camera::create(perspective, lookAt, viewportState);
+        if (mergeQueue && mergeVisibleFirst) mergeQueue->camera = camera;
 
         // add close handler to respond the close window button and pressing escape
         viewer->addEventHandler(vsg::CloseHandler::create(viewer));
@@ -173,7 +183,15 @@ int main(int argc, char** argv)
         // configure the viewers rendering backend, initialize and compile Vulkan objects, passing in ResourceHints to guide the resources allocated.
         viewer->compile(resourceHints);
 
-        auto loadThreads = vsg::OperationThreads::create(numThreads, viewer->status);
+        // either load through a single shared queue and the viewer's CompileManager, or through a work-stealing loader with per thread compile contexts
+        vsg::ref_ptr<vsg::OperationThreads> loadThreads;
+        vsg::ref_ptr<WorkStealingLoader> workStealingLoader;
+        if (workStealing)
+        {
+            workStealingLoader = WorkStealingLoader::create(viewer, numThreads, resourceHints);
+            workStealingLoader->mergeQueue = mergeQueue;
+        }
+        else loadThreads = vsg::OperationThreads::create(numThreads, viewer->status);
 
         // assign the LoadOperation that will do the load in the background and once loaded and compiled merged then via Merge operation that is assigned to updateOperations and called from viewer.update()
         vsg::observer_ptr<vsg::Viewer> observer_viewer(viewer);
@@ -185,7 +203,8 @@ int main(int argc, char** argv)
 
             vsg_scene->addChild(transform);
 
-            loadThreads->add(LoadOperation::create(observer_viewer, transform, argv[i], options));
+            if (workStealingLoader) workStealingLoader->load(transform, argv[i], options);
+            else loadThreads->add(LoadOperation::create(observer_viewer, transform, argv[i], options, mergeQueue));
         }
 
         // rendering main loop
@@ -197,12 +216,31 @@ int main(int argc, char** argv)
 
             viewer->update();
 
+            if (mergeQueue)
+            {
+                mergeQueue->update();
+                if (reportBacklog && mergeQueue->backlog() > 0) std::cout << "merge backlog = " << mergeQueue->backlog() << ", " << mergeQueue->backlogBytes() << " bytes" << std::endl;
+            }
+
             viewer->recordAndSubmit();
 
             viewer->present();
 
             // if (loadThreads->queue->empty()) break;
         }
+
+        if (mergeQueue)
+        {
+            std::cout << "numMerged = " << mergeQueue->numMerged << ", maxBacklog = " << mergeQueue->maxBacklog << ", numFramesWithBacklog = " << mergeQueue->numFramesWithBacklog << std::endl;
+        }
+
+        if (workStealingLoader)
+        {
+            std::cout << "numLoaded = " << workStealingLoader->numLoaded << ", numStolen = " << workStealingLoader->numStolen << std::endl;
+            workStealingLoader->stop();
+        }
+
+        if (concurrentSharedObjects) concurrentSharedObjects->report(std::cout);
     }
     catch (const vsg::Exception& ve)
     {
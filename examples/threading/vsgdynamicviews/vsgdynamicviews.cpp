@@ -5,28 +5,51 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <iostream>
+#include <list>
+#include <map>
 #include <thread>
 
+// State of a dynamically loaded view, shared by its LoadViewOperation and Merge so that toggles are ignored while the view
+// is being loaded or merged, and a merge only attaches the view if it's still wanted.
+struct ViewState : public vsg::Inherit<vsg::Object, ViewState>
+{
+    enum State
+    {
+        CLOSED,
+        LOADING,
+        OPEN
+    };
+
+    std::atomic<State> state{CLOSED};
+    vsg::ref_ptr<vsg::Node> node; // attached RenderGraph while OPEN, only accessed from the main thread
+};
+
 struct Merge : public vsg::Inherit<vsg::Operation, Merge>
 {
-    Merge(const vsg::Path& in_path, vsg::observer_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Group> in_attachmentPoint, vsg::ref_ptr<vsg::Node> in_node, const vsg::CompileResult& in_compileResult):
+    Merge(const vsg::Path& in_path, vsg::observer_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Group> in_attachmentPoint, vsg::ref_ptr<vsg::Node> in_node, const vsg::CompileResult& in_compileResult, vsg::ref_ptr<ViewState> in_viewState = {}):
         path(in_path),
         viewer(in_viewer),
         attachmentPoint(in_attachmentPoint),
         node(in_node),
-        compileResult(in_compileResult) {}
+        compileResult(in_compileResult),
+        viewState(in_viewState) {}
 
     vsg::Path path;
     vsg::observer_ptr<vsg::Viewer> viewer;
     vsg::ref_ptr<vsg::Group> attachmentPoint;
     vsg::ref_ptr<vsg::Node> node;
     vsg::CompileResult compileResult;
+    vsg::ref_ptr<ViewState> viewState;
 
     void run() override
     {
-        std::cout<<"Merge::run() path = "<<path<<", "<<attachmentPoint<<", "<<node<<std::endl;
+        vsg::debug("Merge::run() path = ", path, ", ", attachmentPoint, ", ", node);
+
+        // the view has been closed since it was queued for loading
+        if (viewState && viewState->state != ViewState::LOADING) return;
 
         vsg::ref_ptr<vsg::Viewer> ref_viewer = viewer;
         if (ref_viewer)
@@ -35,12 +58,96 @@ struct Merge : public vsg::Inherit<vsg::Operation, Merge>
         }
 
         attachmentPoint->addChild(node);
+
+        if (viewState)
+        {
+            viewState->node = node;
+            viewState->state = ViewState::OPEN;
+        }
+    }
+};
+
+// Spreads Merge operations over several frames, running pending merges each frame until the time budget is spent.
+struct MergeQueue : public vsg::Inherit<vsg::Object, MergeQueue>
+{
+    double timeBudget = 2.0; // milliseconds, at least one merge is run every frame
+
+    void add(vsg::ref_ptr<Merge> merge)
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+        pending.push_back(merge);
+        maxBacklog = std::max(maxBacklog, pending.size());
+    }
+
+    size_t backlog() const
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+        return pending.size();
+    }
+
+    void update()
+    {
+        auto start = vsg::clock::now();
+        for (bool first = true;; first = false)
+        {
+            vsg::ref_ptr<Merge> merge;
+            {
+                std::scoped_lock<std::mutex> lock(mutex);
+                if (pending.empty()) return;
+                if (!first && std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count() >= timeBudget) return;
+
+                merge = pending.front();
+                pending.pop_front();
+            }
+
+            merge->run();
+            ++numMerged;
+        }
     }
+
+    mutable std::mutex mutex;
+    std::list<vsg::ref_ptr<Merge>> pending;
+    uint64_t numMerged = 0;
+    size_t maxBacklog = 0;
+};
+
+// RenderGraph compiled by LoadViewOperation, kept so that reopening a view splices in the already compiled RenderGraph
+// rather than reloading and recompiling its pipelines and descriptors.
+struct ViewCache : public vsg::Inherit<vsg::Object, ViewCache>
+{
+    struct Entry
+    {
+        vsg::ref_ptr<vsg::RenderGraph> renderGraph;
+        vsg::CompileResult compileResult;
+    };
+
+    static std::string key(const vsg::Path& filename, int32_t x, int32_t y, uint32_t width, uint32_t height)
+    {
+        return vsg::make_string(filename, " ", x, " ", y, " ", width, " ", height);
+    }
+
+    bool find(const std::string& viewKey, Entry& entry) const
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+        auto itr = entries.find(viewKey);
+        if (itr == entries.end()) return false;
+        entry = itr->second;
+        return true;
+    }
+
+    void add(const std::string& viewKey, const Entry& entry)
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+        entries[viewKey] = entry;
+    }
+
+    mutable std::mutex mutex;
+    std::map<std::string, Entry> entries;
 };
 
 struct LoadViewOperation : public vsg::Inherit<vsg::Operation, LoadViewOperation>
 {
-    LoadViewOperation(vsg::ref_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Window> in_window, int32_t in_x, int32_t in_y, uint32_t in_width, uint32_t in_height, vsg::ref_ptr<vsg::Group> in_attachmentPoint, const vsg::Path& in_filename, vsg::ref_ptr<vsg::Options> in_options) :
+    LoadViewOperation(vsg::ref_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Window> in_window, int32_t in_x, int32_t in_y, uint32_t in_width, uint32_t in_height, vsg::ref_ptr<vsg::Group> in_attachmentPoint, const vsg::Path& in_filename, vsg::ref_ptr<vsg::Options> in_options, vsg::ref_ptr<MergeQueue> in_mergeQueue = {}, vsg::ref_ptr<ViewCache> in_viewCache = {}) :
         viewer(in_viewer),
         window(in_window),
         x(in_x),
@@ -49,7 +156,9 @@ struct LoadViewOperation : public vsg::Inherit<vsg::Operation, LoadViewOperation
         height(in_height),
         attachmentPoint(in_attachmentPoint),
         filename(in_filename),
-        options(in_options)
+        options(in_options),
+        mergeQueue(in_mergeQueue),
+        viewCache(in_viewCache)
     {
     }
 
@@ -60,11 +169,36 @@ struct LoadViewOperation : public vsg::Inherit<vsg::Operation, LoadViewOperation
     vsg::ref_ptr<vsg::Group> attachmentPoint;
     vsg::Path filename;
     vsg::ref_ptr<vsg::Options> options;
+    vsg::ref_ptr<MergeQueue> mergeQueue;
+    vsg::ref_ptr<ViewCache> viewCache;
+    vsg::ref_ptr<ViewState> viewState = ViewState::create();
+
+    void merge(vsg::Viewer& ref_viewer, vsg::ref_ptr<vsg::RenderGraph> renderGraph, const vsg::CompileResult& result)
+    {
+        auto merge = Merge::create(filename, viewer, attachmentPoint, renderGraph, result, viewState);
+        if (mergeQueue) mergeQueue->add(merge);
+        else ref_viewer.addUpdateOperation(merge);
+    }
 
     void run() override
+    {
+        if (!load()) viewState->state = ViewState::CLOSED;
+    }
+
+    // load, compile and queue the merge of the view, returns false if there is nothing to merge
+    bool load()
     {
         vsg::ref_ptr<vsg::Viewer> ref_viewer = viewer;
         vsg::ref_ptr<vsg::Window> ref_window = window;
+        if (!ref_viewer || !ref_window) return false;
+
+        // reuse a previously compiled view, its pipelines and descriptors are already compiled so merging only attaches it
+        auto viewKey = ViewCache::key(filename, x, y, width, height);
+        if (ViewCache::Entry entry; viewCache && viewCache->find(viewKey, entry))
+        {
+            merge(*ref_viewer, entry.renderGraph, entry.compileResult);
+            return true;
+        }
 
         // std::cout << "Loading " << filename << std::endl;
         if (auto node = vsg::read_cast<vsg::Node>(filename, options))
@@ -111,12 +245,80 @@ struct LoadViewOperation : public vsg::Inherit<vsg::Operation, LoadViewOperation
                 }
             });
 
-            if (result) ref_viewer->addUpdateOperation(Merge::create(filename, viewer, attachmentPoint, renderGraph, result));
+            if (result)
+            {
+                if (viewCache) viewCache->add(viewKey, ViewCache::Entry{renderGraph, result});
+                merge(*ref_viewer, renderGraph, result);
+                return true;
+            }
         }
+        return false;
     }
 };
 
 
+// toggle the dynamically loaded views on and off when pressing 'v', reopened views are merged from the ViewCache.
+// Toggles are ignored while any of the views is still being loaded or merged.
+class ToggleViews : public vsg::Inherit<vsg::Visitor, ToggleViews>
+{
+public:
+    ToggleViews(vsg::ref_ptr<vsg::CommandGraph> in_commandGraph, vsg::ref_ptr<vsg::Window> in_window, vsg::ref_ptr<vsg::OperationThreads> in_loadThreads) :
+        commandGraph(in_commandGraph),
+        window(in_window),
+        loadThreads(in_loadThreads) {}
+
+    vsg::ref_ptr<vsg::CommandGraph> commandGraph;
+    vsg::ref_ptr<vsg::Window> window;
+    vsg::ref_ptr<vsg::OperationThreads> loadThreads;
+    std::vector<vsg::ref_ptr<LoadViewOperation>> loadViewOperations;
+
+    void openViews()
+    {
+        for (auto& task : loadViewOperations)
+        {
+            if (task->viewState->state != ViewState::CLOSED) continue;
+
+            task->viewState->state = ViewState::LOADING;
+            loadThreads->add(task);
+        }
+    }
+
+    void closeViews()
+    {
+        // wait until the device is idle as the previous frame may still be using the views.
+        vkDeviceWaitIdle(*(window->getDevice()));
+
+        auto& children = commandGraph->children;
+        for (auto& task : loadViewOperations)
+        {
+            auto& viewState = *task->viewState;
+            if (viewState.state != ViewState::OPEN) continue;
+
+            children.erase(std::remove(children.begin(), children.end(), viewState.node), children.end());
+            viewState.node = {};
+            viewState.state = ViewState::CLOSED;
+        }
+    }
+
+    void apply(vsg::KeyPressEvent& keyPress) override
+    {
+        if (keyPress.keyBase != 'v') return;
+
+        bool anyOpen = false;
+        for (auto& task : loadViewOperations)
+        {
+            auto state = task->viewState->state.load();
+            if (state == ViewState::LOADING) return;
+            if (state == ViewState::OPEN) anyOpen = true;
+        }
+
+        if (anyOpen)
+            closeViews();
+        else
+            openViews();
+    }
+};
+
 int main(int argc, char** argv)
 {
     try
@@ -148,6 +350,15 @@ int main(int argc, char** argv)
         auto numFrames = arguments.value(-1, "-f");
         auto numThreads = arguments.value(16, "-n");
 
+        // optionally spread merging of loaded views over several frames, with per frame time budget in milliseconds
+        vsg::ref_ptr<MergeQueue> mergeQueue;
+        if (double mergeTimeBudget = 0.0; arguments.read("--merge-budget", mergeTimeBudget))
+        {
+            mergeQueue = MergeQueue::create();
+            mergeQueue->timeBudget = mergeTimeBudget;
+        }
+        auto reportBacklog = arguments.read("--report-backlog");
+
         // provide setting of the resource hints on the command line
         vsg::ref_ptr<vsg::ResourceHints> resourceHints;
         if (vsg::Path resourceFile; arguments.read("--resource", resourceFile)) resourceHints = vsg::read_cast<vsg::ResourceHints>(resourceFile);
@@ -226,8 +437,13 @@ int main(int argc, char** argv)
 
         // assign the LoadViewOperation that will do the load in the background and once loaded and compiled merged then via Merge operation that is assigned to updateOperations and called from viewer.update()
         vsg::observer_ptr<vsg::Viewer> observer_viewer(viewer);
-        loadThreads->add(LoadViewOperation::create(observer_viewer, window, 50, 50, 512, 480, commandGraph, "models/openstreetmap.vsgt", options));
-        loadThreads->add(LoadViewOperation::create(observer_viewer, window, 600, 50, 512, 480, commandGraph, "models/lz.vsgt", options));
+        auto viewCache = ViewCache::create();
+        auto toggleViews = ToggleViews::create(commandGraph, window, loadThreads);
+        toggleViews->loadViewOperations.push_back(LoadViewOperation::create(observer_viewer, window, 50, 50, 512, 480, commandGraph, "models/openstreetmap.vsgt", options, mergeQueue, viewCache));
+        toggleViews->loadViewOperations.push_back(LoadViewOperation::create(observer_viewer, window, 600, 50, 512, 480, commandGraph, "models/lz.vsgt", options, mergeQueue, viewCache));
+        toggleViews->openViews();
+
+        viewer->addEventHandler(toggleViews);
 
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
@@ -238,12 +454,20 @@ int main(int argc, char** argv)
 
             viewer->update();
 
+            if (mergeQueue)
+            {
+                mergeQueue->update();
+                if (reportBacklog && mergeQueue->backlog() > 0) std::cout << "merge backlog = " << mergeQueue->backlog() << std::endl;
+            }
+
             viewer->recordAndSubmit();
 
             viewer->present();
 
             // if (loadThreads->queue->empty()) break;
         }
+
+        if (mergeQueue) std::cout << "numMerged = " << mergeQueue->numMerged << ", maxBacklog = " << mergeQueue->maxBacklog << std::endl;
     }
     catch (const vsg::Exception& ve)
     {
@@ -0,0 +1,287 @@
+#include "ImGuiCache.h"
+#include "Hash.h"
+
+#include <vsgImGui/RenderImGui.h>
+#include <vsgImGui/imgui.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    const char* composite_vert = R"(
+#version 450
+out gl_PerVertex { vec4 gl_Position; };
+void main()
+{
+    // full screen triangle
+    vec2 texCoord = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(texCoord * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+    const char* composite_frag = R"(
+#version 450
+layout(set = 0, binding = 0) uniform sampler2D ui;
+layout(location = 0) out vec4 outColor;
+void main()
+{
+    // the cached UI is rendered at the window's resolution from the top left corner of the image
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    if (any(greaterThanEqual(coord, textureSize(ui, 0)))) discard;
+    outColor = texelFetch(ui, coord, 0);
+}
+)";
+
+} // namespace
+
+ImGuiCache::ImGuiCache(vsg::ref_ptr<vsg::Window> in_window, const VkExtent2D& in_maxExtent) :
+    window(in_window),
+    maxExtent{std::max(in_maxExtent.width, 1u), std::max(in_maxExtent.height, 1u)}
+{
+}
+
+vsg::ref_ptr<vsg::Node> ImGuiCache::createRenderGraph(vsg::ref_ptr<vsg::Command> components)
+{
+    auto device = window->getOrCreateDevice();
+    auto context = vsg::Context::create(device);
+
+    VkFormat colorFormat = window->surfaceFormat().format;
+
+    auto image = vsg::Image::create();
+    image->imageType = VK_IMAGE_TYPE_2D;
+    image->format = colorFormat;
+    image->extent = VkExtent3D{maxExtent.width, maxExtent.height, 1};
+    image->mipLevels = 1;
+    image->arrayLayers = 1;
+    image->samples = VK_SAMPLE_COUNT_1_BIT;
+    image->tiling = VK_IMAGE_TILING_OPTIMAL;
+    image->usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    auto colorImageView = vsg::createImageView(*context, image, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    // every redraw replaces the whole UI so the previous contents are never needed
+    vsg::RenderPass::Attachments attachments(1);
+    attachments[0].format = colorFormat;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vsg::RenderPass::Subpasses subpasses(1);
+    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[0].colorAttachments.emplace_back(vsg::AttachmentReference{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+
+    // wait for the previous frame's composite to finish reading the image, and make this frame's UI visible to the composite
+    vsg::RenderPass::Dependencies dependencies(2);
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    auto renderPass = vsg::RenderPass::create(device, attachments, subpasses, dependencies);
+    auto framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{colorImageView}, maxExtent.width, maxExtent.height, 1);
+
+    // clear to transparent, ImGui's blending then leaves premultiplied colors in the image
+    _renderGraph = vsg::RenderGraph::create();
+    _renderGraph->framebuffer = framebuffer;
+    _renderGraph->clearValues.resize(1);
+    _renderGraph->clearValues[0].color = VkClearColorValue{{0.0f, 0.0f, 0.0f, 0.0f}};
+    _resize(window->extent2D());
+
+    auto queueFamily = device->getPhysicalDevice()->getQueueFamily(VK_QUEUE_GRAPHICS_BIT);
+    uint32_t imageCount = std::max(2u, static_cast<uint32_t>(window->numFrames()));
+    auto renderImGui = vsgImGui::RenderImGui::create(device, queueFamily, renderPass, 2u, imageCount, _renderGraph->renderArea.extent);
+    renderImGui->addChild(components);
+    _renderGraph->addChild(renderImGui);
+
+    auto sampler = vsg::Sampler::create();
+    sampler->magFilter = VK_FILTER_NEAREST;
+    sampler->minFilter = VK_FILTER_NEAREST;
+    _colorImage = vsg::ImageInfo::create(sampler, colorImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    _switch = vsg::Switch::create();
+    _switch->addChild(true, _renderGraph);
+    return _switch;
+}
+
+vsg::ref_ptr<vsg::Node> ImGuiCache::createComposite()
+{
+    auto vertexShader = vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", composite_vert);
+    auto fragmentShader = vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", composite_frag);
+
+    vsg::DescriptorSetLayoutBindings descriptorBindings{
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}};
+    auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+
+    vsg::PushConstantRanges pushConstantRanges{
+        {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // not used by the shaders, but the View always pushes the projection and modelview matrices
+    };
+
+    auto rasterizationState = vsg::RasterizationState::create();
+    rasterizationState->cullMode = VK_CULL_MODE_NONE;
+
+    auto depthStencilState = vsg::DepthStencilState::create();
+    depthStencilState->depthTestEnable = VK_FALSE;
+    depthStencilState->depthWriteEnable = VK_FALSE;
+
+    // the cached colors are premultiplied by alpha
+    VkPipelineColorBlendAttachmentState blend = {};
+    blend.blendEnable = VK_TRUE;
+    blend.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend.colorBlendOp = VK_BLEND_OP_ADD;
+    blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    vsg::GraphicsPipelineStates pipelineStates{
+        vsg::VertexInputState::create(),
+        vsg::InputAssemblyState::create(),
+        rasterizationState,
+        vsg::MultisampleState::create(),
+        vsg::ColorBlendState::create(vsg::ColorBlendState::ColorBlendAttachments{blend}),
+        depthStencilState};
+
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, pushConstantRanges);
+    auto graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
+
+    auto texture = vsg::DescriptorImage::create(_colorImage, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture});
+
+    auto composite = vsg::StateGroup::create();
+    composite->add(vsg::BindGraphicsPipeline::create(graphicsPipeline));
+    composite->add(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, descriptorSet));
+    composite->addChild(vsg::Draw::create(3, 1, 0, 0));
+
+    auto camera = vsg::Camera::create(vsg::Orthographic::create(), vsg::LookAt::create(), vsg::ViewportState::create(window->extent2D()));
+    return vsg::View::create(camera, composite);
+}
+
+void ImGuiCache::_resize(const VkExtent2D& extent)
+{
+    if ((extent.width > maxExtent.width || extent.height > maxExtent.height) && !_clipWarned)
+    {
+        vsg::warn("ImGuiCache window extent ", extent.width, "x", extent.height, " is larger than the cache's ", maxExtent.width, "x", maxExtent.height, ", the UI will be clipped.");
+        _clipWarned = true;
+    }
+
+    _renderGraph->renderArea.offset = VkOffset2D{0, 0};
+    _renderGraph->renderArea.extent = VkExtent2D{std::min(extent.width, maxExtent.width), std::min(extent.height, maxExtent.height)};
+}
+
+uint64_t ImGuiCache::_hashDrawData() const
+{
+    auto drawData = ImGui::GetDrawData();
+    if (!drawData || !drawData->Valid) return 0;
+
+    uint64_t hash = experimental::hashSeed;
+    hash = experimental::hashBytes(&drawData->DisplaySize, sizeof(drawData->DisplaySize), hash);
+    for (int n = 0; n < drawData->CmdListsCount; ++n)
+    {
+        const ImDrawList* cmdList = drawData->CmdLists[n];
+        hash = experimental::hashBytes(cmdList->VtxBuffer.Data, cmdList->VtxBuffer.Size * sizeof(ImDrawVert), hash);
+        hash = experimental::hashBytes(cmdList->IdxBuffer.Data, cmdList->IdxBuffer.Size * sizeof(ImDrawIdx), hash);
+        for (auto& cmd : cmdList->CmdBuffer)
+        {
+            hash = experimental::hashBytes(&cmd.ClipRect, sizeof(cmd.ClipRect), hash);
+            hash = experimental::hashBytes(&cmd.TextureId, sizeof(cmd.TextureId), hash);
+            hash = experimental::hashBytes(&cmd.VtxOffset, sizeof(cmd.VtxOffset), hash);
+            hash = experimental::hashBytes(&cmd.IdxOffset, sizeof(cmd.IdxOffset), hash);
+            hash = experimental::hashBytes(&cmd.ElemCount, sizeof(cmd.ElemCount), hash);
+        }
+    }
+    return hash;
+}
+
+void ImGuiCache::update()
+{
+    if (!_switch) return;
+
+    ++numFrames;
+    auto now = vsg::clock::now();
+
+    // the draw lists of the last ImGui frame stay available until the next ImGui::NewFrame()
+    bool settling = false;
+    if (_redraw)
+    {
+        auto hash = _hashDrawData();
+        settling = (hash != _drawDataHash);
+        _drawDataHash = hash;
+        totalHashTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - now).count();
+    }
+
+    bool dataChanged = false;
+    if (dataHash)
+    {
+        auto hash = dataHash();
+        dataChanged = (hash != _dataHash);
+        _dataHash = hash;
+    }
+
+    bool intervalPassed = maxInterval > 0.0 && std::chrono::duration<double>(now - _lastRedraw).count() >= maxInterval;
+
+    _redraw = _input || dataChanged || settling || intervalPassed;
+    if (_input) ++numInputRedraws;
+    else if (dataChanged) ++numDataRedraws;
+    else if (settling) ++numSettleRedraws;
+    else if (intervalPassed) ++numIntervalRedraws;
+
+    if (_redraw)
+    {
+        ++numRedrawn;
+        _lastRedraw = now;
+    }
+
+    _input = false;
+    _switch->setAllChildren(_redraw);
+}
+
+void ImGuiCache::apply(vsg::KeyEvent&)
+{
+    _input = true;
+}
+
+void ImGuiCache::apply(vsg::PointerEvent&)
+{
+    _input = true;
+}
+
+void ImGuiCache::apply(vsg::ScrollWheelEvent&)
+{
+    _input = true;
+}
+
+void ImGuiCache::apply(vsg::TouchEvent&)
+{
+    _input = true;
+}
+
+void ImGuiCache::apply(vsg::ConfigureWindowEvent& configureWindow)
+{
+    _input = true;
+    if (_renderGraph) _resize(VkExtent2D{configureWindow.width, configureWindow.height});
+}
+
+void ImGuiCache::report(std::ostream& out) const
+{
+    double frames = numFrames > 0 ? static_cast<double>(numFrames) : 1.0;
+    out << "ImGuiCache frames = " << numFrames << ", redrawn = " << numRedrawn << " (" << (100.0 * static_cast<double>(numRedrawn) / frames) << "%), input = " << numInputRedraws
+        << ", data = " << numDataRedraws << ", settling = " << numSettleRedraws << ", interval = " << numIntervalRedraws
+        << ", average draw data hash = " << (numRedrawn > 0 ? totalHashTime / static_cast<double>(numRedrawn) : 0.0) << "ms" << std::endl;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <functional>
+#include <ostream>
+
+// Retained rendering of an ImGui overlay. The UI is rendered by vsgImGui::RenderImGui into an offscreen image that is
+// composited over the window every frame, and the ImGui frame, with its rebuild and upload of the vertex and index
+// buffers, is only run when something may have changed it:
+//   - an input event has been handled, or the window resized,
+//   - dataHash, a hash of the application data the UI displays, has changed,
+//   - the previous UI frame produced draw lists with a different hash to the one before it, so the UI is still
+//     animating or settling after an input, e.g. hover highlights or windows being resized,
+//   - maxInterval has passed since the last UI frame, for widgets driven by time rather than input.
+// Add it as an event handler ahead of vsgImGui::SendEventsToImGui so it sees the events ImGui consumes, and call
+// update() once per frame before recordAndSubmit().
+// The image is allocated at maxExtent, windows larger than it have the UI clipped to it.
+class ImGuiCache : public vsg::Inherit<vsg::Visitor, ImGuiCache>
+{
+public:
+    ImGuiCache(vsg::ref_ptr<vsg::Window> in_window, const VkExtent2D& in_maxExtent);
+
+    vsg::ref_ptr<vsg::Window> window;
+    const VkExtent2D maxExtent;
+
+    std::function<uint64_t()> dataHash;
+    double maxInterval = 0.0; // seconds, 0 for no time driven redraws
+
+    // offscreen RenderGraph that renders components with a vsgImGui::RenderImGui, add to the CommandGraph before the window's RenderGraph
+    vsg::ref_ptr<vsg::Node> createRenderGraph(vsg::ref_ptr<vsg::Command> components);
+
+    // draws the cached UI over the window, add to the window's RenderGraph after the scene's View
+    vsg::ref_ptr<vsg::Node> createComposite();
+
+    // decide whether this frame runs the ImGui frame
+    void update();
+
+    bool redrawing() const { return _redraw; }
+
+    // input events that may change the UI
+    void apply(vsg::KeyEvent& keyEvent) override;
+    void apply(vsg::PointerEvent& pointerEvent) override;
+    void apply(vsg::ScrollWheelEvent& scrollWheel) override;
+    void apply(vsg::TouchEvent& touchEvent) override;
+    void apply(vsg::ConfigureWindowEvent& configureWindow) override;
+
+    // statistics
+    uint64_t numFrames = 0;
+    uint64_t numRedrawn = 0;
+    uint64_t numInputRedraws = 0;
+    uint64_t numDataRedraws = 0;
+    uint64_t numSettleRedraws = 0;
+    uint64_t numIntervalRedraws = 0;
+    double totalHashTime = 0.0; // milliseconds
+
+    void report(std::ostream& out) const;
+
+protected:
+    uint64_t _hashDrawData() const;
+    void _resize(const VkExtent2D& extent);
+
+    vsg::ref_ptr<vsg::Switch> _switch;
+    vsg::ref_ptr<vsg::RenderGraph> _renderGraph;
+    vsg::ref_ptr<vsg::ImageInfo> _colorImage;
+
+    bool _input = true;
+    bool _redraw = false;
+    uint64_t _dataHash = 0;
+    uint64_t _drawDataHash = 0;
+    vsg::clock::time_point _lastRedraw;
+    bool _clipWarned = false;
+};
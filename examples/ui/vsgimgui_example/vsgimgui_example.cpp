@@ -10,8 +10,12 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include <chrono>
 #include <iostream>
 
+#include "Hash.h"
+#include "ImGuiCache.h"
+
 struct Params : public vsg::Inherit<vsg::Object, Params>
 {
     bool showGui = true; // you can toggle this with your own EventHandler and key
@@ -23,6 +27,18 @@ struct Params : public vsg::Inherit<vsg::Object, Params>
     float clearColor[3]{0.2f, 0.2f, 0.4f}; // Unfortunately, this doesn't change dynamically in vsg
     uint32_t counter = 0;
     float dist = 0.f;
+    float frameRate = 0.0f; // updated once a second by the main loop
+
+    // hash of the values shown by the UI so an ImGuiCache redraws when the application changes them
+    uint64_t hash() const
+    {
+        bool flags[] = {showGui, showDemoWindow, showSecondWindow, showImPlotDemoWindow, showLogoWindow, showImagesWindow};
+        uint64_t h = experimental::hashBytes(flags, sizeof(flags));
+        h = experimental::hashBytes(clearColor, sizeof(clearColor), h);
+        h = experimental::hashBytes(&counter, sizeof(counter), h);
+        h = experimental::hashBytes(&dist, sizeof(dist), h);
+        return experimental::hashBytes(&frameRate, sizeof(frameRate), h);
+    }
 };
 
 class MyGui : public vsg::Inherit<vsg::Command, MyGui>
@@ -70,7 +86,8 @@ public:
             ImGui::SameLine();
             ImGui::Text("counter = %d", params->counter);
 
-            ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+            // ImGui's own frame rate only counts the frames it's drawn in, so use the one measured by the main loop
+            ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", params->frameRate > 0.0f ? 1000.0f / params->frameRate : 0.0f, params->frameRate);
             ImGui::End();
         }
 
@@ -182,6 +199,10 @@ int main(int argc, char** argv)
     auto numFrames = arguments.value(-1, "-f");
     auto fontFile = arguments.value<vsg::Path>({}, "--font");
     auto fontSize = arguments.value<float>(30.0f, "--font-size");
+    bool uiCache = arguments.read("--ui-cache");
+    VkExtent2D uiCacheExtent{3840, 2160};
+    arguments.read("--ui-cache-extent", uiCacheExtent.width, uiCacheExtent.height);
+    auto uiMaxInterval = arguments.value(0.0, "--ui-max-interval");
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -273,8 +294,27 @@ int main(int argc, char** argv)
 
         // Create the ImGui node and add it to the renderGraph
         auto params = Params::create();
-        auto renderImGui = vsgImGui::RenderImGui::create(window, MyGui::create(params, options));
-        renderGraph->addChild(renderImGui);
+        auto gui = MyGui::create(params, options);
+
+        vsg::ref_ptr<ImGuiCache> imguiCache;
+        if (uiCache)
+        {
+            // render the UI into a cached image, only rerunning ImGui when an input or the params may have changed it
+            imguiCache = ImGuiCache::create(window, uiCacheExtent);
+            imguiCache->dataHash = [params]() { return params->hash(); };
+            imguiCache->maxInterval = uiMaxInterval;
+
+            commandGraph->children.insert(commandGraph->children.begin(), imguiCache->createRenderGraph(gui));
+            renderGraph->addChild(imguiCache->createComposite());
+
+            // ahead of SendEventsToImGui so the events ImGui handles are still seen
+            viewer->addEventHandler(imguiCache);
+        }
+        else
+        {
+            auto renderImGui = vsgImGui::RenderImGui::create(window, gui);
+            renderGraph->addChild(renderImGui);
+        }
 
         // Add the ImGui event handler first to handle events early
         viewer->addEventHandler(vsgImGui::SendEventsToImGui::create());
@@ -305,6 +345,9 @@ int main(int argc, char** argv)
             }
         }
 
+        auto frameRateStart = vsg::clock::now();
+        uint32_t frameRateCount = 0;
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
@@ -315,6 +358,17 @@ int main(int argc, char** argv)
 
             viewer->handleEvents();
 
+            ++frameRateCount;
+            double elapsed = std::chrono::duration<double>(vsg::clock::now() - frameRateStart).count();
+            if (elapsed >= 1.0)
+            {
+                params->frameRate = static_cast<float>(static_cast<double>(frameRateCount) / elapsed);
+                frameRateStart = vsg::clock::now();
+                frameRateCount = 0;
+            }
+
+            if (imguiCache) imguiCache->update();
+
             viewer->update();
 
             viewer->recordAndSubmit();
@@ -330,6 +384,8 @@ int main(int argc, char** argv)
 
             vsg::write(recordEvents->events, event_output_filename);
         }
+
+        if (imguiCache) imguiCache->report(std::cout);
     }
     catch (const vsg::Exception& ve)
     {
@@ -0,0 +1,253 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    double milliseconds(vsg::clock::duration duration)
+    {
+        return std::chrono::duration<double, std::chrono::milliseconds::period>(duration).count();
+    }
+
+    vsg::clock::duration duration(double milliseconds)
+    {
+        return std::chrono::duration_cast<vsg::clock::duration>(std::chrono::duration<double, std::chrono::milliseconds::period>(milliseconds));
+    }
+
+    bool supportsDeviceExtension(VkPhysicalDevice physicalDevice, const char* name)
+    {
+        uint32_t count = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+        std::vector<VkExtensionProperties> extensions(count);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+        return std::any_of(extensions.begin(), extensions.end(), [&](const VkExtensionProperties& extension) { return std::strcmp(extension.extensionName, name) == 0; });
+    }
+} // namespace
+
+void FramePacer::Latency::add(double value)
+{
+    if (count == 0 || value < min) min = value;
+    if (count == 0 || value > max) max = value;
+    total += value;
+    ++count;
+}
+
+FramePacer::FramePacer(vsg::ref_ptr<vsg::Window> in_window) :
+    window(in_window),
+    _sampleTime(vsg::clock::now()),
+    _targetTime(_sampleTime)
+{
+}
+
+void FramePacer::configure(vsg::WindowTraits& windowTraits)
+{
+    windowTraits.vulkanVersion = std::max(windowTraits.vulkanVersion, static_cast<uint32_t>(VK_API_VERSION_1_1));
+}
+
+bool FramePacer::setup()
+{
+    _refreshPeriod = 1000.0 / refreshRate;
+
+    auto physicalDevice = window->getOrCreatePhysicalDevice();
+    if (!supportsDeviceExtension(*physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) || !supportsDeviceExtension(*physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) return false;
+
+    auto presentIdFeatures = physicalDevice->getFeatures<VkPhysicalDevicePresentIdFeaturesKHR, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR>();
+    auto presentWaitFeatures = physicalDevice->getFeatures<VkPhysicalDevicePresentWaitFeaturesKHR, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR>();
+    if (!presentIdFeatures.presentId || !presentWaitFeatures.presentWait) return false;
+
+    auto& windowTraits = window->traits();
+    windowTraits->deviceExtensionNames.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    windowTraits->deviceExtensionNames.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+    if (!windowTraits->deviceFeatures) windowTraits->deviceFeatures = vsg::DeviceFeatures::create();
+    windowTraits->deviceFeatures->get<VkPhysicalDevicePresentIdFeaturesKHR, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR>().presentId = VK_TRUE;
+    windowTraits->deviceFeatures->get<VkPhysicalDevicePresentWaitFeaturesKHR, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR>().presentWait = VK_TRUE;
+
+    _presentWait = true;
+    return true;
+}
+
+void FramePacer::present(vsg::Viewer& viewer)
+{
+    if (_presentWait)
+    {
+        // follows vsg::Presentation::present(), adding the VkPresentIdKHR that vkWaitForPresentKHR() waits on
+        for (auto& presentation : viewer.presentations)
+        {
+            std::vector<VkSemaphore> vk_semaphores;
+            std::vector<VkSwapchainKHR> vk_swapchains;
+            std::vector<uint32_t> indices;
+            std::vector<uint64_t> presentIds;
+
+            for (auto& presentationWindow : presentation->windows)
+            {
+                auto imageIndex = presentationWindow->imageIndex();
+                if (imageIndex >= presentationWindow->numFrames()) continue;
+
+                auto swapchain = presentationWindow->getSwapchain()->vk();
+                if (presentationWindow == window)
+                {
+                    // present ids are per swapchain, so the pending frames of a swapchain that's been recreated will never complete
+                    if (swapchain != _swapchain)
+                    {
+                        _swapchain = swapchain;
+                        _pending.clear();
+                        _lastPresentedId = 0;
+                    }
+                    presentIds.push_back(++_presentId);
+                    _pending.push_back(PendingFrame{_presentId, _sampleTime, _targetTime, _inputTime, _hasInput});
+                }
+                else
+                {
+                    presentIds.push_back(0); // 0 leaves the present without an id
+                }
+
+                vk_semaphores.push_back(presentationWindow->frame(imageIndex).renderFinished->vk());
+                vk_swapchains.push_back(swapchain);
+                indices.push_back(static_cast<uint32_t>(imageIndex));
+            }
+
+            if (vk_swapchains.empty()) continue;
+
+            VkPresentIdKHR presentIdInfo = {};
+            presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+            presentIdInfo.swapchainCount = static_cast<uint32_t>(presentIds.size());
+            presentIdInfo.pPresentIds = presentIds.data();
+
+            VkPresentInfoKHR presentInfo = {};
+            presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+            presentInfo.pNext = &presentIdInfo;
+            presentInfo.waitSemaphoreCount = static_cast<uint32_t>(vk_semaphores.size());
+            presentInfo.pWaitSemaphores = vk_semaphores.data();
+            presentInfo.swapchainCount = static_cast<uint32_t>(vk_swapchains.size());
+            presentInfo.pSwapchains = vk_swapchains.data();
+            presentInfo.pImageIndices = indices.data();
+
+            presentation->queue->present(presentInfo);
+        }
+    }
+    else
+    {
+        viewer.present();
+        if (_hasInput) inputLatency.add(milliseconds(vsg::clock::now() - _inputTime));
+    }
+
+    // CPU time from sampling events to presenting, the GPU's share is left to the margin
+    double workTime = milliseconds(vsg::clock::now() - _sampleTime);
+    _workTime = (numFrames == 0) ? workTime : std::max(workTime, _workTime * 0.9 + workTime * 0.1);
+
+    _hasInput = false;
+    ++numFrames;
+}
+
+void FramePacer::wait()
+{
+    auto now = vsg::clock::now();
+    vsg::clock::time_point nextDisplay;
+
+    if (_presentWait && _swapchain && _presentId > maxQueuedFrames)
+    {
+        if (!_vkWaitForPresentKHR)
+        {
+            _vkWaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(*(window->getDevice()), "vkWaitForPresentKHR"));
+            if (!_vkWaitForPresentKHR) _presentWait = false;
+        }
+
+        uint64_t waitId = _presentId - maxQueuedFrames;
+        if (_vkWaitForPresentKHR && _vkWaitForPresentKHR(*(window->getDevice()), _swapchain, waitId, 100'000'000) == VK_SUCCESS)
+        {
+            now = vsg::clock::now();
+            _presented(waitId, now);
+
+            // the frame started next can be displayed once those queued before it have been
+            nextDisplay = now + duration(_refreshPeriod * static_cast<double>(maxQueuedFrames + 1));
+        }
+        else
+        {
+            // timed out or the swapchain is out of date, don't add a sleep to a frame that's already late
+            _sampleTime = _targetTime = now;
+            return;
+        }
+    }
+    else
+    {
+        nextDisplay = _sampleTime + duration(_refreshPeriod);
+    }
+
+    auto sampleTime = nextDisplay - duration(_workTime + _margin);
+    if (sampleTime > now)
+    {
+        std::this_thread::sleep_until(sampleTime);
+        totalSleep += milliseconds(sampleTime - now);
+    }
+
+    _targetTime = nextDisplay;
+    _sampleTime = vsg::clock::now();
+}
+
+void FramePacer::_presented(uint64_t presentId, vsg::clock::time_point time)
+{
+    // refine the refresh period from consecutive presents, ignoring those where a vertical blank was missed
+    if (_lastPresentedId != 0 && presentId == _lastPresentedId + 1)
+    {
+        double interval = milliseconds(time - _lastPresented);
+        if (interval > _refreshPeriod * 0.5 && interval < _refreshPeriod * 1.5) _refreshPeriod = _refreshPeriod * 0.95 + interval * 0.05;
+    }
+    _lastPresented = time;
+    _lastPresentedId = presentId;
+
+    while (!_pending.empty() && _pending.front().presentId <= presentId)
+    {
+        auto& frame = _pending.front();
+
+        if (frame.hasInput) inputLatency.add(milliseconds(time - frame.inputTime));
+        sampleLatency.add(milliseconds(time - frame.sampleTime));
+
+        if (time > frame.targetTime + duration(_refreshPeriod * 0.5))
+        {
+            ++numMissed;
+            _margin = std::min(maxMargin, _margin + 0.5);
+            _framesMade = 0;
+        }
+        else if (++_framesMade >= 120)
+        {
+            _margin = std::max(minMargin, _margin - 0.1);
+            _framesMade = 0;
+        }
+
+        _pending.pop_front();
+    }
+}
+
+void FramePacer::apply(vsg::KeyEvent& keyEvent)
+{
+    if (!_hasInput || keyEvent.time < _inputTime) _inputTime = keyEvent.time;
+    _hasInput = true;
+}
+
+void FramePacer::apply(vsg::PointerEvent& pointerEvent)
+{
+    if (!_hasInput || pointerEvent.time < _inputTime) _inputTime = pointerEvent.time;
+    _hasInput = true;
+}
+
+void FramePacer::apply(vsg::ScrollWheelEvent& scrollWheel)
+{
+    if (!_hasInput || scrollWheel.time < _inputTime) _inputTime = scrollWheel.time;
+    _hasInput = true;
+}
+
+void FramePacer::report(std::ostream& out) const
+{
+    out << "FramePacer " << (_presentWait ? "present wait" : "refresh rate") << " pacing, frames = " << numFrames << ", missed = " << numMissed
+        << ", refresh period = " << _refreshPeriod << "ms, margin = " << _margin << "ms, average sleep = " << (numFrames > 0 ? totalSleep / static_cast<double>(numFrames) : 0.0) << "ms" << std::endl;
+
+    const char* inputEnd = _presentWait ? "displayed" : "queued";
+    out << "    input to " << inputEnd << " latency, frames = " << inputLatency.count << ", min = " << inputLatency.min << "ms, average = " << inputLatency.average() << "ms, max = " << inputLatency.max << "ms" << std::endl;
+    if (_presentWait)
+    {
+        out << "    sample to displayed latency, frames = " << sampleLatency.count << ", min = " << sampleLatency.min << "ms, average = " << sampleLatency.average() << "ms, max = " << sampleLatency.max << "ms" << std::endl;
+    }
+}
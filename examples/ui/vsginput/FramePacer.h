@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <deque>
+#include <ostream>
+
+// Paces the main loop to minimize the time between sampling input and the frame reaching the display. Each frame is
+// presented with a VK_KHR_present_id, then wait() blocks in vkWaitForPresentKHR until the frame maxQueuedFrames before
+// it has been displayed, which gives the phase of the vertical blank, and sleeps until just long enough before the next
+// vertical blank the new frame can make for the sampling, update, record and GPU work to complete. The time taken is
+// tracked from the CPU work and an adaptive margin that grows when a frame misses its vertical blank and shrinks
+// slowly while they're being made. Frames are timed from the earliest input event handled in them to their present
+// completing, as an approximation of input-to-photon latency.
+// Without VK_KHR_present_wait the loop is paced to the refreshRate from the end of advanceToNextFrame(), and latency
+// can only be measured to the frame being queued for presentation.
+class FramePacer : public vsg::Inherit<vsg::Visitor, FramePacer>
+{
+public:
+    explicit FramePacer(vsg::ref_ptr<vsg::Window> in_window);
+
+    // request the Vulkan 1.1 instance needed to query the present wait features, call before the Window is created
+    static void configure(vsg::WindowTraits& windowTraits);
+
+    // enable VK_KHR_present_id and VK_KHR_present_wait when supported, call before the Window's Device is created.
+    bool setup();
+
+    vsg::ref_ptr<vsg::Window> window;
+
+    uint32_t maxQueuedFrames = 0; // frames that can be waiting for display when the next is started
+    double refreshRate = 60.0;   // Hz, refined from the present timings when present wait is available
+    double minMargin = 0.5;      // milliseconds
+    double maxMargin = 8.0;      // milliseconds
+
+    bool presentWaitEnabled() const { return _presentWait; }
+    double refreshPeriod() const { return _refreshPeriod; } // milliseconds
+    double margin() const { return _margin; }               // milliseconds
+
+    // call in place of viewer.present()
+    void present(vsg::Viewer& viewer);
+
+    // call after present(), before advanceToNextFrame() samples the next frame's events
+    void wait();
+
+    // record the time of the input events handled each frame
+    void apply(vsg::KeyEvent& keyEvent) override;
+    void apply(vsg::PointerEvent& pointerEvent) override;
+    void apply(vsg::ScrollWheelEvent& scrollWheel) override;
+
+    // statistics, milliseconds
+    struct Latency
+    {
+        uint64_t count = 0;
+        double min = 0.0;
+        double max = 0.0;
+        double total = 0.0;
+
+        void add(double value);
+        double average() const { return count > 0 ? total / static_cast<double>(count) : 0.0; }
+    };
+
+    Latency inputLatency;  // earliest input event in a frame to its present completing, or being queued
+    Latency sampleLatency; // start of advanceToNextFrame() to the frame's present completing
+    uint64_t numFrames = 0;
+    uint64_t numMissed = 0; // frames displayed after the vertical blank they were paced for
+    double totalSleep = 0.0;
+
+    void report(std::ostream& out) const;
+
+protected:
+    void _presented(uint64_t presentId, vsg::clock::time_point time);
+
+    struct PendingFrame
+    {
+        uint64_t presentId;
+        vsg::clock::time_point sampleTime;
+        vsg::clock::time_point targetTime;
+        vsg::clock::time_point inputTime;
+        bool hasInput;
+    };
+
+    bool _presentWait = false;
+    PFN_vkWaitForPresentKHR _vkWaitForPresentKHR = nullptr;
+    VkSwapchainKHR _swapchain = VK_NULL_HANDLE;
+
+    uint64_t _presentId = 0;
+    std::deque<PendingFrame> _pending;
+
+    vsg::clock::time_point _sampleTime;
+    vsg::clock::time_point _targetTime;
+    vsg::clock::time_point _inputTime;
+    bool _hasInput = false;
+
+    vsg::clock::time_point _lastPresented;
+    uint64_t _lastPresentedId = 0;
+    double _refreshPeriod = 1000.0 / 60.0;
+    double _workTime = 0.0;
+    double _margin = 2.0;
+    uint32_t _framesMade = 0;
+};
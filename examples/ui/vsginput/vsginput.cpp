@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "FramePacer.h"
+
 class InputHandler : public vsg::Inherit<vsg::Visitor, InputHandler>
 {
 public:
@@ -145,6 +147,12 @@ int main(int argc, char** argv)
     auto event_output_filename = arguments.value(std::string(""), "-o");
     auto font_filename = arguments.value(std::string("fonts/times.vsgb"), "--font");
 
+    // pace frames to sample input as late as possible before the vertical blank, reporting the input latency on exit
+    bool lowLatency = arguments.read("--low-latency");
+    auto maxQueuedFrames = arguments.value(0u, "--max-queued-frames");
+    auto refreshRate = arguments.value(60.0, "--refresh-rate");
+    if (lowLatency) FramePacer::configure(*windowTraits);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     // set up search paths to SPIRV shaders and textures
@@ -306,6 +314,18 @@ int main(int argc, char** argv)
 
     viewer->addWindow(window);
 
+    vsg::ref_ptr<FramePacer> framePacer;
+    if (lowLatency)
+    {
+        framePacer = FramePacer::create(window);
+        framePacer->maxQueuedFrames = maxQueuedFrames;
+        framePacer->refreshRate = refreshRate;
+        if (!framePacer->setup())
+        {
+            std::cout << "VK_KHR_present_wait not supported, pacing to " << refreshRate << "Hz and measuring latency to queuing the present." << std::endl;
+        }
+    }
+
     // set up the camera
     auto viewport = vsg::ViewportState::create(window->extent2D());
     auto projection = vsg::Orthographic::create(0.0, projectionHeight * aspectRatio, 0.0, projectionHeight, 100.0, 0.0);
@@ -341,6 +361,8 @@ int main(int argc, char** argv)
     // assign Input handler
     viewer->addEventHandler(InputHandler::create(keyboard_text, pointer_text, scroll_text, window_text, frame_text));
 
+    if (framePacer) viewer->addEventHandler(framePacer);
+
     // main frame loop
     while (viewer->advanceToNextFrame())
     {
@@ -356,9 +378,19 @@ int main(int argc, char** argv)
 
         viewer->recordAndSubmit();
 
-        viewer->present();
+        if (framePacer)
+        {
+            framePacer->present(*viewer);
+            framePacer->wait();
+        }
+        else
+        {
+            viewer->present();
+        }
     }
 
+    if (framePacer) framePacer->report(std::cout);
+
     if (recordEvents)
     {
         if (!event_output_filename.empty())
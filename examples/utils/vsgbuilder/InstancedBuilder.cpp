@@ -0,0 +1,363 @@
+#include "InstancedBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+InstancedBuilder::InstancedBuilder(vsg::ref_ptr<vsg::Builder> in_builder, bool in_quantize) :
+    builder(in_builder),
+    quantize(in_quantize)
+{
+}
+
+vsg::ref_ptr<vsg::Node> InstancedBuilder::createBox(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances)
+{
+    return create(BOX, info, stateInfo, instances);
+}
+
+vsg::ref_ptr<vsg::Node> InstancedBuilder::createCapsule(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances)
+{
+    return create(CAPSULE, info, stateInfo, instances);
+}
+
+vsg::ref_ptr<vsg::Node> InstancedBuilder::createCone(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances)
+{
+    return create(CONE, info, stateInfo, instances);
+}
+
+vsg::ref_ptr<vsg::Node> InstancedBuilder::createCylinder(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances)
+{
+    return create(CYLINDER, info, stateInfo, instances);
+}
+
+vsg::ref_ptr<vsg::Node> InstancedBuilder::createSphere(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances)
+{
+    return create(SPHERE, info, stateInfo, instances);
+}
+
+const InstancedBuilder::Geometry& InstancedBuilder::getOrCreateGeometry(Shape shape, const vsg::GeometryInfo& info)
+{
+    // the instances provide the position and colour so only the shape parameters distinguish one geometry from another
+    vsg::GeometryInfo shapeInfo = info;
+    shapeInfo.position.set(0.0f, 0.0f, 0.0f);
+    shapeInfo.color.set(1.0f, 1.0f, 1.0f, 1.0f);
+    shapeInfo.positions = {};
+    shapeInfo.colors = {};
+    shapeInfo.cullNode = false;
+
+    auto key = std::make_pair(shape, shapeInfo);
+    if (auto itr = _geometries.find(key); itr != _geometries.end()) return itr->second;
+
+    vsg::ref_ptr<vsg::Node> node;
+    vsg::StateInfo plainState;
+    switch (shape)
+    {
+    case (BOX): node = builder->createBox(shapeInfo, plainState); break;
+    case (CAPSULE): node = builder->createCapsule(shapeInfo, plainState); break;
+    case (CONE): node = builder->createCone(shapeInfo, plainState); break;
+    case (CYLINDER): node = builder->createCylinder(shapeInfo, plainState); break;
+    case (SPHERE): node = builder->createSphere(shapeInfo, plainState); break;
+    }
+
+    // take the vertex arrays from the Builder's subgraph, without instancing they are bound as vertices, normals, texcoords then colors
+    struct FindVertexIndexDraw : public vsg::Visitor
+    {
+        vsg::ref_ptr<vsg::VertexIndexDraw> vid;
+        void apply(vsg::Node& node) override { node.traverse(*this); }
+        void apply(vsg::VertexIndexDraw& in_vid) override { vid = &in_vid; }
+    } findVertexIndexDraw;
+
+    auto& geometry = _geometries[key];
+    if (node) node->accept(findVertexIndexDraw);
+
+    auto& vid = findVertexIndexDraw.vid;
+    if (!vid || vid->arrays.size() < 3 || !vid->indices)
+    {
+        vsg::warn("InstancedBuilder could not find the vertex arrays of the Builder's shape.");
+        return geometry;
+    }
+
+    geometry.vertices = vid->arrays[0]->data;
+    geometry.normals = vid->arrays[1]->data;
+    geometry.texcoords = vid->arrays[2]->data;
+    geometry.indices = vid->indices->data;
+    geometry.indexCount = vid->indexCount;
+
+    if (auto vertices = geometry.vertices.cast<vsg::vec3Array>())
+    {
+        for (auto& v : *vertices) geometry.radius = std::max(geometry.radius, static_cast<double>(vsg::length(v)));
+    }
+
+    ++_stats.numGeometries;
+    return geometry;
+}
+
+vsg::ref_ptr<vsg::ShaderSet> InstancedBuilder::createShaderSet(bool lighting)
+{
+    auto options = builder->options;
+    auto vertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/instanced_soa.vert", options);
+    auto fragmentShader = vsg::read_cast<vsg::ShaderStage>(lighting ? "shaders/standard_phong.frag" : "shaders/standard_flat_shaded.frag", options);
+    if (!vertexShader || !fragmentShader)
+    {
+        vsg::error("InstancedBuilder could not find shaders.");
+        return {};
+    }
+
+    auto shaderSet = vsg::ShaderSet::create(vsg::ShaderStages{vertexShader, fragmentShader});
+
+    shaderSet->addAttributeBinding("vsg_Vertex", "", 0, VK_FORMAT_R32G32B32_SFLOAT, vsg::vec3Array::create(1));
+    shaderSet->addAttributeBinding("vsg_Normal", "", 1, VK_FORMAT_R32G32B32_SFLOAT, vsg::vec3Array::create(1));
+    shaderSet->addAttributeBinding("vsg_TexCoord0", "", 2, VK_FORMAT_R32G32_SFLOAT, vsg::vec2Array::create(1));
+
+    if (quantize)
+    {
+        shaderSet->addAttributeBinding("vsg_InstancePositionScale", "VSG_QUANTIZED_INSTANCES", 4, VK_FORMAT_R16G16B16A16_UNORM, vsg::usvec4Array::create(1));
+        shaderSet->addAttributeBinding("vsg_InstanceRotation", "", 5, VK_FORMAT_R8G8B8A8_SNORM, vsg::bvec4Array::create(1));
+    }
+    else
+    {
+        shaderSet->addAttributeBinding("vsg_InstancePositionScale", "", 4, VK_FORMAT_R32G32B32A32_SFLOAT, vsg::vec4Array::create(1));
+        shaderSet->addAttributeBinding("vsg_InstanceRotation", "", 5, VK_FORMAT_R32G32B32A32_SFLOAT, vsg::quatArray::create(1));
+    }
+    shaderSet->addAttributeBinding("vsg_InstanceColorIndex", "", 6, VK_FORMAT_R8_UINT, vsg::ubyteArray::create(1));
+
+    shaderSet->addUniformBinding("diffuseMap", "VSG_DIFFUSE_MAP", 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, vsg::ubvec4Array2D::create(1, 1, vsg::Data::Properties{VK_FORMAT_R8G8B8A8_UNORM}));
+    shaderSet->addUniformBinding("material", "", 0, 10, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, vsg::PhongMaterialValue::create());
+    shaderSet->addUniformBinding("instanceSettings", "", 0, 11, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, vsg::vec4Array::create(257));
+    if (lighting) shaderSet->addUniformBinding("lightData", "", 1, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, vsg::vec4Array::create(64));
+
+    shaderSet->addPushConstantRange("pc", "", VK_SHADER_STAGE_VERTEX_BIT, 0, 128);
+
+    shaderSet->optionalDefines = {"VSG_GREYSACLE_DIFFUSE_MAP", "VSG_TWO_SIDED_LIGHTING"};
+
+    if (lighting) shaderSet->customDescriptorSetBindings.push_back(vsg::ViewDependentStateBinding::create(1));
+
+    return shaderSet;
+}
+
+const vsg::StateGroup::StateCommands& InstancedBuilder::getOrCreateState(const vsg::StateInfo& stateInfo)
+{
+    if (auto itr = _states.find(stateInfo); itr != _states.end()) return itr->second;
+
+    auto& stateCommands = _states[stateInfo];
+
+    auto shaderSet = createShaderSet(stateInfo.lighting);
+    if (!shaderSet) return stateCommands;
+
+    if (!_settings)
+    {
+        // settings[0] dequantizes the instance positions and scales, the palette follows
+        _settings = vsg::vec4Array::create(257);
+        _settings->at(0).set(static_cast<float>(chunkSize), static_cast<float>(chunkSize), static_cast<float>(chunkSize), maxScale);
+
+        size_t numColors = palette ? std::min(palette->size(), size_t(256)) : 0;
+        if (palette && palette->size() > 256) vsg::warn("InstancedBuilder palette truncated to 256 colours.");
+        for (size_t i = 0; i < 256; ++i)
+        {
+            _settings->at(i + 1) = (i < numColors) ? palette->at(i) : vsg::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+        }
+    }
+
+    auto config = vsg::GraphicsPipelineConfigurator::create(shaderSet);
+
+    struct SetPipelineStates : public vsg::Visitor
+    {
+        const vsg::StateInfo& si;
+        explicit SetPipelineStates(const vsg::StateInfo& in_si) :
+            si(in_si) {}
+
+        void apply(vsg::Object& object) override { object.traverse(*this); }
+        void apply(vsg::RasterizationState& rs) override
+        {
+            if (si.two_sided) rs.cullMode = VK_CULL_MODE_NONE;
+            if (si.wireframe) rs.polygonMode = VK_POLYGON_MODE_LINE;
+        }
+    } setPipelineStates(stateInfo);
+    config->accept(setPipelineStates);
+
+    if (stateInfo.two_sided && stateInfo.lighting)
+    {
+        if (!config->shaderHints) config->shaderHints = vsg::ShaderCompileSettings::create();
+        config->shaderHints->defines.insert("VSG_TWO_SIDED_LIGHTING");
+    }
+
+    // the vertex input only depends on the formats so placeholder arrays set it up for all the chunks, which bind their arrays in the same order
+    vsg::DataList arrays;
+    config->assignArray(arrays, "vsg_Vertex", VK_VERTEX_INPUT_RATE_VERTEX, vsg::vec3Array::create(1));
+    config->assignArray(arrays, "vsg_Normal", VK_VERTEX_INPUT_RATE_VERTEX, vsg::vec3Array::create(1));
+    config->assignArray(arrays, "vsg_TexCoord0", VK_VERTEX_INPUT_RATE_VERTEX, vsg::vec2Array::create(1));
+    if (quantize)
+    {
+        config->assignArray(arrays, "vsg_InstancePositionScale", VK_VERTEX_INPUT_RATE_INSTANCE, vsg::usvec4Array::create(1));
+        config->assignArray(arrays, "vsg_InstanceRotation", VK_VERTEX_INPUT_RATE_INSTANCE, vsg::bvec4Array::create(1));
+    }
+    else
+    {
+        config->assignArray(arrays, "vsg_InstancePositionScale", VK_VERTEX_INPUT_RATE_INSTANCE, vsg::vec4Array::create(1));
+        config->assignArray(arrays, "vsg_InstanceRotation", VK_VERTEX_INPUT_RATE_INSTANCE, vsg::quatArray::create(1));
+    }
+    config->assignArray(arrays, "vsg_InstanceColorIndex", VK_VERTEX_INPUT_RATE_INSTANCE, vsg::ubyteArray::create(1));
+
+    if (stateInfo.image) config->assignTexture("diffuseMap", stateInfo.image);
+
+    // use the same material as the Builder when it's been given a custom one
+    vsg::ref_ptr<vsg::Data> material;
+    if (builder->shaderSet)
+    {
+        if (auto& materialBinding = builder->shaderSet->getUniformBinding("material")) material = materialBinding.data;
+    }
+    config->assignUniform("material", material ? material : vsg::PhongMaterialValue::create());
+    config->assignUniform("instanceSettings", _settings);
+
+    auto sharedObjects = builder->options ? builder->options->sharedObjects : vsg::ref_ptr<vsg::SharedObjects>();
+    if (sharedObjects)
+        sharedObjects->share(config, [](auto gpc) { gpc->init(); });
+    else
+        config->init();
+
+    auto stateGroup = vsg::StateGroup::create();
+    config->copyTo(stateGroup, sharedObjects);
+    stateCommands = stateGroup->stateCommands;
+
+    return stateCommands;
+}
+
+vsg::ref_ptr<vsg::Node> InstancedBuilder::create(Shape shape, const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances)
+{
+    auto& positions = instances.positions;
+    if (!positions || positions->size() == 0) return {};
+
+    uint32_t numInstances = static_cast<uint32_t>(positions->size());
+    auto& rotations = instances.rotations;
+    auto& scales = instances.scales;
+    auto& colorIndices = instances.colorIndices;
+    if ((rotations && rotations->size() < numInstances) || (scales && scales->size() < numInstances) || (colorIndices && colorIndices->size() < numInstances))
+    {
+        vsg::warn("InstancedBuilder instance arrays must all be at least as long as the positions array.");
+        return {};
+    }
+
+    auto& geometry = getOrCreateGeometry(shape, info);
+    if (!geometry.vertices) return {};
+
+    vsg::dvec3 offset(info.position);
+    vsg::dbox bounds;
+    for (auto& p : *positions) bounds.add(offset + vsg::dvec3(p));
+
+    // the chunk size is fixed by the first call as the quantized positions are decoded with it
+    if (chunkSize <= 0.0)
+    {
+        vsg::dvec3 extents = bounds.max - bounds.min;
+        double measure = 1.0;
+        int numDimensions = 0;
+        for (int d = 0; d < 3; ++d)
+        {
+            if (extents[d] > 0.0)
+            {
+                measure *= extents[d];
+                ++numDimensions;
+            }
+        }
+
+        double numChunks = std::max(1.0, double(numInstances) / double(std::max(targetInstancesPerChunk, 1u)));
+        chunkSize = (numDimensions > 0) ? std::pow(measure / numChunks, 1.0 / double(numDimensions)) : 1.0;
+        if (chunkSize <= 0.0) chunkSize = 1.0;
+    }
+
+    auto& stateCommands = getOrCreateState(stateInfo);
+    if (stateCommands.empty()) return {};
+
+    // bucket the instances by the grid cell they fall in
+    using Cell = std::tuple<int64_t, int64_t, int64_t>;
+    std::map<Cell, std::vector<uint32_t>> cells;
+    for (uint32_t i = 0; i < numInstances; ++i)
+    {
+        vsg::dvec3 p = offset + vsg::dvec3(positions->at(i));
+        cells[Cell{static_cast<int64_t>(std::floor(p.x / chunkSize)), static_cast<int64_t>(std::floor(p.y / chunkSize)), static_cast<int64_t>(std::floor(p.z / chunkSize))}].push_back(i);
+    }
+
+    auto stateGroup = vsg::StateGroup::create();
+    stateGroup->stateCommands = stateCommands;
+
+    auto quantizeUnorm = [](double v) { return static_cast<uint16_t>(std::lround(std::clamp(v, 0.0, 1.0) * 65535.0)); };
+    auto quantizeSnorm = [](double v) { return static_cast<int8_t>(std::lround(std::clamp(v, -1.0, 1.0) * 127.0)); };
+
+    for (auto& [cell, indices] : cells)
+    {
+        vsg::dvec3 origin(double(std::get<0>(cell)) * chunkSize, double(std::get<1>(cell)) * chunkSize, double(std::get<2>(cell)) * chunkSize);
+        uint32_t count = static_cast<uint32_t>(indices.size());
+
+        vsg::ref_ptr<vsg::Data> positionScales;
+        vsg::ref_ptr<vsg::Data> chunkRotations;
+        auto chunkColorIndices = vsg::ubyteArray::create(count);
+
+        vsg::dbox chunkBounds;
+        double chunkMaxScale = 0.0;
+        if (quantize)
+        {
+            auto quantizedPositions = vsg::usvec4Array::create(count);
+            auto quantizedRotations = vsg::bvec4Array::create(count);
+            for (uint32_t c = 0; c < count; ++c)
+            {
+                uint32_t i = indices[c];
+                vsg::dvec3 local = (offset + vsg::dvec3(positions->at(i)) - origin) / chunkSize;
+                double s = std::min(scales ? static_cast<double>(scales->at(i)) : 1.0, static_cast<double>(maxScale));
+                quantizedPositions->at(c).set(quantizeUnorm(local.x), quantizeUnorm(local.y), quantizeUnorm(local.z), quantizeUnorm(s / maxScale));
+
+                vsg::quat q = rotations ? vsg::normalize(rotations->at(i)) : vsg::quat(0.0f, 0.0f, 0.0f, 1.0f);
+                quantizedRotations->at(c).set(quantizeSnorm(q.x), quantizeSnorm(q.y), quantizeSnorm(q.z), quantizeSnorm(q.w));
+
+                chunkBounds.add(origin + local * chunkSize);
+                chunkMaxScale = std::max(chunkMaxScale, s);
+            }
+            positionScales = quantizedPositions;
+            chunkRotations = quantizedRotations;
+        }
+        else
+        {
+            auto floatPositions = vsg::vec4Array::create(count);
+            auto floatRotations = vsg::quatArray::create(count);
+            for (uint32_t c = 0; c < count; ++c)
+            {
+                uint32_t i = indices[c];
+                vsg::dvec3 local = offset + vsg::dvec3(positions->at(i)) - origin;
+                double s = scales ? static_cast<double>(scales->at(i)) : 1.0;
+                floatPositions->at(c) = vsg::vec4(vsg::vec3(local), static_cast<float>(s));
+                floatRotations->at(c) = rotations ? rotations->at(i) : vsg::quat(0.0f, 0.0f, 0.0f, 1.0f);
+
+                chunkBounds.add(origin + local);
+                chunkMaxScale = std::max(chunkMaxScale, s);
+            }
+            positionScales = floatPositions;
+            chunkRotations = floatRotations;
+        }
+
+        for (uint32_t c = 0; c < count; ++c)
+        {
+            chunkColorIndices->at(c) = colorIndices ? colorIndices->at(indices[c]) : 0;
+        }
+
+        auto vid = vsg::VertexIndexDraw::create();
+        vid->assignArrays(vsg::DataList{geometry.vertices, geometry.normals, geometry.texcoords, positionScales, chunkRotations, chunkColorIndices});
+        vid->assignIndices(geometry.indices);
+        vid->indexCount = geometry.indexCount;
+        vid->instanceCount = count;
+
+        // the instance positions are relative to the chunk origin to keep them small
+        auto transform = vsg::MatrixTransform::create(vsg::translate(origin));
+        transform->subgraphRequiresLocalFrustum = false;
+        transform->addChild(vid);
+
+        vsg::dsphere bound((chunkBounds.min + chunkBounds.max) * 0.5, vsg::length(chunkBounds.max - chunkBounds.min) * 0.5 + geometry.radius * chunkMaxScale);
+        auto cullGroup = vsg::CullGroup::create(bound);
+        cullGroup->addChild(transform);
+        stateGroup->addChild(cullGroup);
+
+        ++_stats.numChunks;
+    }
+
+    _stats.numInstances += numInstances;
+    _stats.instanceBytes += numInstances * bytesPerInstance();
+
+    return stateGroup;
+}
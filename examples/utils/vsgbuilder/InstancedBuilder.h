@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <map>
+
+// Structure-of-arrays per instance data, only positions is required, the other arrays default to an identity rotation,
+// a scale of 1 and colour index 0 when not assigned.
+struct InstanceArrays
+{
+    vsg::ref_ptr<vsg::vec3Array> positions;
+    vsg::ref_ptr<vsg::quatArray> rotations;
+    vsg::ref_ptr<vsg::floatArray> scales;
+    vsg::ref_ptr<vsg::ubyteArray> colorIndices; // index into InstancedBuilder::palette
+};
+
+// Companion to vsg::Builder for drawing large numbers of instances of the same shape. The shape's vertex arrays are
+// created once by the Builder for each distinct shape and GeometryInfo and shared by every subgraph created for it,
+// and the instances are bucketed into a grid of chunkSize cubes, each chunk a CullGroup with its own compact instance
+// arrays so chunks outside the view frustum aren't drawn. With quantize the instance positions are stored as 16 bit
+// offsets from the chunk origin with the scale in the 4th component, and the rotations as 8 bit normalized quaternions.
+class InstancedBuilder : public vsg::Inherit<vsg::Object, InstancedBuilder>
+{
+public:
+    explicit InstancedBuilder(vsg::ref_ptr<vsg::Builder> in_builder, bool in_quantize = false);
+
+    vsg::ref_ptr<vsg::Builder> builder;
+    const bool quantize;
+
+    // edge length of the chunks, 0.0 to choose one from the bounds of the instances so each chunk holds around targetInstancesPerChunk
+    double chunkSize = 0.0;
+    uint32_t targetInstancesPerChunk = 4096;
+
+    // the largest scale that can be represented when quantizing, larger scales are clamped
+    float maxScale = 1.0f;
+
+    // up to 256 colours indexed by InstanceArrays::colorIndices, must be assigned before the first create call
+    vsg::ref_ptr<vsg::vec4Array> palette;
+
+    vsg::ref_ptr<vsg::Node> createBox(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances);
+    vsg::ref_ptr<vsg::Node> createCapsule(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances);
+    vsg::ref_ptr<vsg::Node> createCone(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances);
+    vsg::ref_ptr<vsg::Node> createCylinder(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances);
+    vsg::ref_ptr<vsg::Node> createSphere(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances);
+
+    struct Stats
+    {
+        size_t numGeometries = 0;
+        size_t numChunks = 0;
+        size_t numInstances = 0;
+        size_t instanceBytes = 0;
+    };
+
+    const Stats& stats() const { return _stats; }
+
+    // bytes of instance data per instance, the vertex arrays of the shared geometries aren't included
+    size_t bytesPerInstance() const { return quantize ? (8 + 4 + 1) : (16 + 16 + 1); }
+
+protected:
+    enum Shape
+    {
+        BOX,
+        CAPSULE,
+        CONE,
+        CYLINDER,
+        SPHERE
+    };
+
+    struct Geometry
+    {
+        vsg::ref_ptr<vsg::Data> vertices;
+        vsg::ref_ptr<vsg::Data> normals;
+        vsg::ref_ptr<vsg::Data> texcoords;
+        vsg::ref_ptr<vsg::Data> indices;
+        uint32_t indexCount = 0;
+        double radius = 0.0;
+    };
+
+    vsg::ref_ptr<vsg::Node> create(Shape shape, const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo, const InstanceArrays& instances);
+
+    const Geometry& getOrCreateGeometry(Shape shape, const vsg::GeometryInfo& info);
+    const vsg::StateGroup::StateCommands& getOrCreateState(const vsg::StateInfo& stateInfo);
+    vsg::ref_ptr<vsg::ShaderSet> createShaderSet(bool lighting);
+
+    std::map<std::pair<Shape, vsg::GeometryInfo>, Geometry> _geometries;
+    std::map<vsg::StateInfo, vsg::StateGroup::StateCommands> _states;
+    vsg::ref_ptr<vsg::vec4Array> _settings;
+    Stats _stats;
+};
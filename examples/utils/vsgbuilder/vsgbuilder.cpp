@@ -4,6 +4,9 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "InstancedBuilder.h"
+
+#include <algorithm>
 #include <iostream>
 
 int main(int argc, char** argv)
@@ -94,6 +97,8 @@ int main(int argc, char** argv)
     bool heightfield = arguments.read("--hf");
     bool billboard = arguments.read("--billboard");
 
+    bool openShapes = quad || disk || heightfield || billboard;
+
     if (!(box || sphere || cone || capsule || quad || cylinder || disk || heightfield))
     {
         box = true;
@@ -108,11 +113,19 @@ int main(int argc, char** argv)
 
     auto numVertices = arguments.value<uint32_t>(0, "-n");
 
+    // draw the -n instances from structure-of-arrays data with InstancedBuilder rather than through GeometryInfo::positions
+    bool soa = arguments.read("--soa");
+    bool quantize = arguments.read("--quantize");
+    auto chunkSize = arguments.value<double>(0.0, "--chunk-size");
+    auto paletteSize = arguments.value<uint32_t>(16, "--palette-size");
+
     vsg::Path textureFile = arguments.value(vsg::Path{}, {"-i", "--image"});
     vsg::Path displacementFile = arguments.value(vsg::Path{}, "--dm");
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
+    if (soa && openShapes) vsg::warn("vsgbuilder --soa only supports the closed shapes, ignoring --quad, --disk, --hf and --billboard.");
+
 #ifdef vsgXchange_all
     // add vsgXchange's support for reading and writing 3rd party file formats
     options->add(vsgXchange::all::create());
@@ -123,7 +136,8 @@ int main(int argc, char** argv)
     vsg::dvec3 centre = {0.0, 0.0, 0.0};
     double radius = 1.0;
 
-    {
+    // the --soa path creates only the closed shapes with InstancedBuilder and returns early
+    auto createShapes = [&]() {
         radius = vsg::length(geomInfo.dx + geomInfo.dy + geomInfo.dz);
 
         //geomInfo.transform = vsg::perspective(vsg::radians(60.0f), 2.0f, 1.0f, 10.0f);
@@ -135,6 +149,66 @@ int main(int argc, char** argv)
 
         vsg::dbox bound;
 
+        if (soa)
+        {
+            if (numVertices == 0) numVertices = 1;
+            paletteSize = std::clamp(paletteSize, 1u, 256u);
+
+            auto instancedBuilder = InstancedBuilder::create(builder, quantize);
+            instancedBuilder->chunkSize = chunkSize;
+            instancedBuilder->maxScale = 1.5f;
+            instancedBuilder->palette = vsg::vec4Array::create(paletteSize);
+            for (auto& c : *(instancedBuilder->palette))
+            {
+                c.set(float(std::rand()) / float(RAND_MAX), float(std::rand()) / float(RAND_MAX), float(std::rand()) / float(RAND_MAX), 1.0f);
+            }
+
+            float w = std::pow(float(numVertices), 0.33f) * 2.0f * vsg::length(geomInfo.dx);
+
+            InstanceArrays instances;
+            instances.positions = vsg::vec3Array::create(numVertices);
+            instances.rotations = vsg::quatArray::create(numVertices);
+            instances.scales = vsg::floatArray::create(numVertices);
+            instances.colorIndices = vsg::ubyteArray::create(numVertices);
+            for (uint32_t i = 0; i < numVertices; ++i)
+            {
+                instances.positions->at(i).set(w * (float(std::rand()) / float(RAND_MAX) - 0.5f),
+                                               w * (float(std::rand()) / float(RAND_MAX) - 0.5f),
+                                               w * (float(std::rand()) / float(RAND_MAX) - 0.5f));
+
+                vsg::vec3 axis(float(std::rand()) / float(RAND_MAX) - 0.5f, float(std::rand()) / float(RAND_MAX) - 0.5f, float(std::rand()) / float(RAND_MAX) - 0.5f);
+                if (vsg::length(axis) < 1e-3f) axis.set(0.0f, 0.0f, 1.0f);
+                instances.rotations->at(i) = vsg::quat(vsg::radians(360.0f) * float(std::rand()) / float(RAND_MAX), vsg::normalize(axis));
+
+                instances.scales->at(i) = 0.5f + float(std::rand()) / float(RAND_MAX);
+                instances.colorIndices->at(i) = static_cast<uint8_t>(std::rand() % paletteSize);
+            }
+
+            radius += (0.5 * sqrt(3.0) * w);
+
+            // only the closed shapes are supported, each shape's vertex arrays are shared by all its chunks
+            auto add = [&](vsg::ref_ptr<vsg::Node> node) {
+                if (node) scene->addChild(node);
+                bound.add(geomInfo.position);
+                geomInfo.position += geomInfo.dx * 1.5f;
+            };
+
+            if (box) add(instancedBuilder->createBox(geomInfo, stateInfo, instances));
+            if (sphere) add(instancedBuilder->createSphere(geomInfo, stateInfo, instances));
+            if (cylinder) add(instancedBuilder->createCylinder(geomInfo, stateInfo, instances));
+            if (cone) add(instancedBuilder->createCone(geomInfo, stateInfo, instances));
+            if (capsule) add(instancedBuilder->createCapsule(geomInfo, stateInfo, instances));
+
+            auto& stats = instancedBuilder->stats();
+            std::cout << "InstancedBuilder : " << stats.numInstances << " instances in " << stats.numChunks << " chunks of size " << instancedBuilder->chunkSize
+                      << ", " << stats.numGeometries << " shared geometries, " << instancedBuilder->bytesPerInstance() << " bytes per instance, "
+                      << stats.instanceBytes << " bytes of instance data" << std::endl;
+
+            centre = (bound.min + bound.max) * 0.5;
+            radius += vsg::length(bound.max - bound.min) * 0.5;
+            return;
+        }
+
         if (numVertices > 0 || billboard)
         {
             if (numVertices == 0) numVertices = 1;
@@ -254,7 +328,8 @@ int main(int argc, char** argv)
         // update the centre and radius to account for all the shapes added so we can position the camera to see them all.
         centre = (bound.min + bound.max) * 0.5;
         radius += vsg::length(bound.max - bound.min) * 0.5;
-    }
+    };
+    createShapes();
 
     // write out scene if required
     if (!outputFilename.empty())
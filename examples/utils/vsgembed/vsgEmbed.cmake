@@ -0,0 +1,41 @@
+# vsg_embed_model(<target> <model> NAME <name> [TYPE <vsg::Type>])
+#
+# Converts model to the native binary format at build time with vsgembed, generating ${NAME}_vsgb.cpp in the current
+# binary directory. The generated source defines a ${NAME}() function returning the parsed model, it's intended to be
+# #included by one of target's sources as the ascii literals were, so the binary directory is added to target's include
+# path and vsgembed_FOUND is defined. When cross compiling set VSGEMBED_EXECUTABLE to a vsgembed built for the host.
+function(vsg_embed_model TARGET MODEL)
+    cmake_parse_arguments(EMBED "" "NAME;TYPE" "" ${ARGN})
+
+    if (NOT EMBED_NAME)
+        get_filename_component(EMBED_NAME ${MODEL} NAME_WE)
+    endif()
+
+    if (NOT EMBED_TYPE)
+        set(EMBED_TYPE "vsg::Node")
+    endif()
+
+    if (VSGEMBED_EXECUTABLE)
+        set(EMBED_TOOL ${VSGEMBED_EXECUTABLE})
+    elseif (TARGET vsgembed)
+        set(EMBED_TOOL vsgembed)
+    else()
+        message(FATAL_ERROR "vsg_embed_model() requires VSGEMBED_EXECUTABLE to be set to a host build of vsgembed.")
+    endif()
+
+    set(EMBED_OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/${EMBED_NAME}_vsgb.cpp)
+
+    add_custom_command(
+        OUTPUT ${EMBED_OUTPUT}
+        COMMAND ${EMBED_TOOL} ${MODEL} -o ${EMBED_OUTPUT} --name ${EMBED_NAME} --type ${EMBED_TYPE}
+        DEPENDS ${MODEL} ${EMBED_TOOL}
+        COMMENT "Embedding ${MODEL} as ${EMBED_NAME}_vsgb.cpp"
+        VERBATIM
+    )
+
+    # compiled by being #included, so only listed to make target depend on its generation
+    set_source_files_properties(${EMBED_OUTPUT} PROPERTIES HEADER_FILE_ONLY ON GENERATED ON)
+    target_sources(${TARGET} PRIVATE ${EMBED_OUTPUT})
+    target_include_directories(${TARGET} PRIVATE ${CMAKE_CURRENT_BINARY_DIR})
+    target_compile_definitions(${TARGET} PRIVATE vsgembed_FOUND)
+endfunction()
@@ -0,0 +1,117 @@
+#include <vsg/all.h>
+
+#ifdef vsgXchange_FOUND
+#    include <vsgXchange/all.h>
+#endif
+
+#include "AtomicSave.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// serialize object to memory in the native ascii or binary format, extension selects which
+std::string serialize(const vsg::Object* object, const vsg::Path& extension)
+{
+    auto options = vsg::Options::create();
+    options->extensionHint = extension;
+
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    vsg::VSG io;
+    io.write(object, out, options);
+    return out.str();
+}
+
+// average time in milliseconds to parse data in memory, as the embedded blob is parsed at startup
+double timeParse(const std::string& data, unsigned int numRuns)
+{
+    vsg::VSG io;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < numRuns; ++i)
+    {
+        auto object = io.read(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+        if (!object) return -1.0;
+    }
+    return std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - start).count() / static_cast<double>(numRuns);
+}
+
+int main(int argc, char** argv)
+{
+    vsg::CommandLine arguments(&argc, argv);
+
+    auto options = vsg::Options::create();
+    options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
+#ifdef vsgXchange_FOUND
+    options->add(vsgXchange::all::create());
+#endif
+
+    auto outputFilename = arguments.value<std::string>("", "-o");
+    auto name = arguments.value<std::string>("model", "--name");
+    auto type = arguments.value<std::string>("vsg::Node", "--type");
+    auto numRuns = arguments.value(0u, "--benchmark");
+    auto bytesPerLine = arguments.value(32u, "--bytes-per-line");
+
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+    if (argc < 2 || (outputFilename.empty() && numRuns == 0))
+    {
+        std::cout << "Usage: vsgembed model -o output.cpp [--name name] [--type vsg::Type] [--benchmark numRuns]" << std::endl;
+        return 1;
+    }
+
+    vsg::Path inputFilename = argv[1];
+    auto object = vsg::read(inputFilename, options);
+    if (!object)
+    {
+        std::cout << "Unable to load " << inputFilename << std::endl;
+        return 1;
+    }
+
+    auto binary = serialize(object, ".vsgb");
+
+    if (numRuns > 0)
+    {
+        auto ascii = serialize(object, ".vsgt");
+        std::cout << "ascii  : " << ascii.size() << " bytes, parsed in " << timeParse(ascii, numRuns) << "ms" << std::endl;
+        std::cout << "binary : " << binary.size() << " bytes, parsed in " << timeParse(binary, numRuns) << "ms" << std::endl;
+    }
+
+    if (outputFilename.empty()) return 0;
+
+    // write to a string first so a failed or interrupted run doesn't leave a partial source file to be compiled
+    std::ostringstream source;
+    source << "// generated by vsgembed from " << inputFilename.filename().string() << ", do not edit" << std::endl;
+    source << "#include <vsg/io/VSG.h>" << std::endl;
+    source << std::endl;
+    source << "alignas(16) static constexpr uint8_t " << name << "_vsgb[" << binary.size() << "] = {";
+    source << std::hex << std::setfill('0');
+    for (size_t i = 0; i < binary.size(); ++i)
+    {
+        if (i % std::max(bytesPerLine, 1u) == 0) source << std::endl;
+        source << "0x" << std::setw(2) << static_cast<unsigned int>(static_cast<uint8_t>(binary[i])) << ",";
+    }
+    source << std::dec << std::endl
+           << "};" << std::endl;
+    source << std::endl;
+    source << "// parsed in place from the constant data, without copying it into a stream" << std::endl;
+    source << "static auto " << name << " = []() {" << std::endl;
+    source << "    vsg::VSG io;" << std::endl;
+    source << "    return io.read_cast<" << type << ">(" << name << "_vsgb, sizeof(" << name << "_vsgb));" << std::endl;
+    source << "};" << std::endl;
+
+    bool written = experimental::atomicSave(outputFilename, [&](const vsg::Path& temporaryFilename) {
+        std::ofstream fout(temporaryFilename.string(), std::ios::out | std::ios::binary);
+        fout << source.str();
+        fout.close();
+        return !fout.fail();
+    });
+    if (!written)
+    {
+        std::cout << "Unable to write " << outputFilename << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
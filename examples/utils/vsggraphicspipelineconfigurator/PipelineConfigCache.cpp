@@ -0,0 +1,142 @@
+#include "PipelineConfigCache.h"
+#include "Hash.h"
+
+#include <sstream>
+
+namespace
+{
+    // appends the settings to a byte string, strings and sets prefixed with their size so the result is unambiguous
+    struct KeyWriter
+    {
+        std::string bytes;
+
+        void add(const void* data, size_t size)
+        {
+            bytes.append(static_cast<const char*>(data), size);
+        }
+
+        template<typename T>
+        void add(const T& v)
+        {
+            add(&v, sizeof(T));
+        }
+
+        void add(const std::string& str)
+        {
+            add(static_cast<uint64_t>(str.size()));
+            add(str.data(), str.size());
+        }
+
+        void add(const std::set<std::string>& strings)
+        {
+            add(static_cast<uint64_t>(strings.size()));
+            for (auto& str : strings) add(str);
+        }
+    };
+} // namespace
+
+PipelineConfigCache::PipelineConfigCache() :
+    options(vsg::Options::create())
+{
+    options->extensionHint = ".vsgb";
+}
+
+std::string PipelineConfigCache::key(const vsg::GraphicsPipelineConfigurator& gpc, const vsg::Options* options)
+{
+    KeyWriter writer;
+
+    // ShaderSets are shared through vsg::Options so their identity stands in for their contents
+    writer.add(reinterpret_cast<uintptr_t>(gpc.shaderSet.get()));
+    writer.add(gpc.subpass);
+    writer.add(gpc.baseAttributeBinding);
+
+    writer.add(static_cast<uint8_t>(gpc.shaderHints ? 1 : 0));
+    if (gpc.shaderHints) writer.add(gpc.shaderHints->defines);
+
+    writer.add(static_cast<uint8_t>(gpc.descriptorConfigurator ? 1 : 0));
+    if (auto& dc = gpc.descriptorConfigurator)
+    {
+        writer.add(dc->defines);
+        writer.add(static_cast<uint8_t>(dc->blending));
+        writer.add(static_cast<uint8_t>(dc->two_sided));
+        writer.add(static_cast<uint64_t>(dc->descriptorBindings.size()));
+        for (auto& binding : dc->descriptorBindings)
+        {
+            writer.add(binding.binding);
+            writer.add(binding.descriptorType);
+            writer.add(binding.descriptorCount);
+            writer.add(binding.stageFlags);
+        }
+    }
+
+    // the binary serialization covers every pipeline state's members, including the VertexInputState filled in by assignArray()
+    vsg::VSG vsgWriter;
+    vsg::ref_ptr<const vsg::Options> writeOptions(options);
+    writer.add(static_cast<uint64_t>(gpc.pipelineStates.size()));
+    for (auto& pipelineState : gpc.pipelineStates)
+    {
+        std::ostringstream sstr(std::ios::out | std::ios::binary);
+        vsgWriter.write(pipelineState, sstr, writeOptions);
+
+        auto str = sstr.str();
+        writer.add(str);
+    }
+
+    return std::move(writer.bytes);
+}
+
+uint64_t PipelineConfigCache::hash(const std::string& key)
+{
+    // FNV-1a, so equal settings give equal hashes regardless of platform or run
+    return experimental::hashBytes(key.data(), key.size());
+}
+
+void PipelineConfigCache::init(vsg::GraphicsPipelineConfigurator& gpc)
+{
+    ++numLookups;
+
+    auto settings = key(gpc, options);
+    auto value = hash(settings);
+    auto& shard = _shards[value % numShards];
+
+    std::shared_ptr<Entry> entry;
+    {
+        std::scoped_lock<std::mutex> lock(shard.mutex);
+        auto& candidates = shard.entries[value];
+        for (auto& candidate : candidates)
+        {
+            if (candidate->key == settings)
+            {
+                entry = candidate;
+                break;
+            }
+        }
+
+        if (!entry)
+        {
+            // a hash shared with different settings can't be given the same pipeline
+            if (!candidates.empty()) ++numCollisions;
+
+            entry = std::make_shared<Entry>();
+            entry->key = std::move(settings);
+            candidates.push_back(entry);
+        }
+    }
+
+    // the first configurator with the hash initializes outside the shard lock, concurrent ones with the same hash wait on it
+    std::call_once(entry->initialized, [&]() {
+        gpc.init();
+        entry->graphicsPipeline = gpc.graphicsPipeline;
+        entry->bindGraphicsPipeline = gpc.bindGraphicsPipeline;
+        ++numPipelines;
+    });
+
+    gpc.graphicsPipeline = entry->graphicsPipeline;
+    gpc.bindGraphicsPipeline = entry->bindGraphicsPipeline;
+}
+
+void PipelineConfigCache::report(std::ostream& out) const
+{
+    out << "PipelineConfigCache lookups = " << numLookups << ", pipelines created = " << numPipelines << ", hit rate = "
+        << (numLookups > 0 ? 100.0 * (numLookups - numPipelines) / numLookups : 0.0) << "%, hash collisions = " << numCollisions << std::endl;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Deduplicates GraphicsPipelineConfigurator::init() by a 64 bit hash of the settings that determine its pipeline: the
+// ShaderSet, shader defines, descriptor bindings, vertex inputs and pipeline states. The first configurator with a
+// given hash is initialized, later ones are assigned its GraphicsPipeline and BindGraphicsPipeline, and so the same
+// DescriptorSetLayouts, without building or deep comparing candidate pipelines as SharedObjects::share() does. Each
+// entry keeps the settings it was hashed from, so configurators whose hashes collide are compared and kept apart.
+// The hash map is split into shards each with their own mutex so loader threads can look up concurrently.
+class PipelineConfigCache : public vsg::Inherit<vsg::Object, PipelineConfigCache>
+{
+public:
+    PipelineConfigCache();
+
+    // options to use when serializing pipeline states for hashing
+    vsg::ref_ptr<vsg::Options> options;
+
+    // the settings that determine gpc's pipeline, written to a byte string that is equal for equal settings
+    static std::string key(const vsg::GraphicsPipelineConfigurator& gpc, const vsg::Options* options);
+
+    static uint64_t hash(const std::string& key);
+
+    // use in place of gpc.init()
+    void init(vsg::GraphicsPipelineConfigurator& gpc);
+
+    // statistics
+    std::atomic_uint numLookups{0};
+    std::atomic_uint numPipelines{0};
+    std::atomic_uint numCollisions{0};
+
+    void report(std::ostream& out) const;
+
+protected:
+    struct Entry
+    {
+        std::string key;
+        std::once_flag initialized;
+        vsg::ref_ptr<vsg::GraphicsPipeline> graphicsPipeline;
+        vsg::ref_ptr<vsg::BindGraphicsPipeline> bindGraphicsPipeline;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, std::vector<std::shared_ptr<Entry>>> entries;
+    };
+
+    static constexpr size_t numShards = 16;
+    Shard _shards[numShards];
+};
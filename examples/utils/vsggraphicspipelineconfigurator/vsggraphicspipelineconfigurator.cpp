@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "PipelineConfigCache.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -40,6 +42,7 @@ int main(int argc, char** argv)
     auto outputFile = arguments.value<vsg::Path>("", "-o");
     auto outputShaderSetFile = arguments.value<vsg::Path>("", "--os");
     auto share = arguments.read("--share");
+    auto hashCache = arguments.read("--hash-cache");
     auto numInstances = arguments.value<size_t>(1, "-n");
 
     if (!shaderSet) shaderSet = vsg::createPhongShaderSet(options);
@@ -65,6 +68,8 @@ int main(int argc, char** argv)
     }
 
     auto sharedObjects = vsg::SharedObjects::create_if(share);
+    vsg::ref_ptr<PipelineConfigCache> pipelineConfigCache;
+    if (hashCache) pipelineConfigCache = PipelineConfigCache::create();
 
     vsg::dvec3 position{0.0, 0.0, 0.0};
     vsg::dvec3 delta_column{2.0, 0.0, 0.0};
@@ -75,6 +80,7 @@ int main(int argc, char** argv)
     size_t numColumns = std::max(size_t(1), static_cast<size_t>(sqrt(static_cast<double>(numInstances))));
     size_t numRows = std::max(size_t(1), numInstances / numColumns);
 
+    auto startTime = vsg::clock::now();
 
     for(size_t r=0; (r < numRows) && (scenegraph->children.size() < numInstances); ++r)
     {
@@ -165,7 +171,8 @@ int main(int argc, char** argv)
             }
 
             // share the pipeline config and initilaize if it's unique
-            if (sharedObjects) sharedObjects->share(graphicsPipelineConfig, [](auto gpc) { gpc->init(); });
+            if (pipelineConfigCache) pipelineConfigCache->init(*graphicsPipelineConfig);
+            else if (sharedObjects) sharedObjects->share(graphicsPipelineConfig, [](auto gpc) { gpc->init(); });
             else graphicsPipelineConfig->init();
 
             // create StateGroup as the root of the scene/command graph to hold the GraphicsProgram, and binding of Descriptors to decorate the whole graph
@@ -215,7 +222,11 @@ int main(int argc, char** argv)
         }
     }
 
+    auto setupTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+    std::cout << "Scene graph of " << scenegraph->children.size() << " instances set up in " << setupTime << "ms" << std::endl;
+
     if (sharedObjects) sharedObjects->report(std::cout);
+    if (pipelineConfigCache) pipelineConfigCache->report(std::cout);
 
     // create the viewer and assign window(s) to it
     auto viewer = vsg::Viewer::create();
@@ -0,0 +1,384 @@
+#include "BatchIntersector.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+    const uint32_t s_maxLeafSize = 4;
+
+    struct Item
+    {
+        vsg::dbox box;
+        vsg::dvec3 centre;
+    };
+
+    uint32_t buildNode(const std::vector<Item>& items, std::vector<uint32_t>& order, std::vector<BatchIntersector::BVHNode>& nodes, uint32_t begin, uint32_t end)
+    {
+        vsg::dbox box, centres;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            auto& item = items[order[i]];
+            box.add(item.box);
+            centres.add(item.centre);
+        }
+
+        auto index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(BatchIntersector::BVHNode{box.min, box.max, begin, end - begin});
+
+        // split at the median of the longest axis of the centres
+        auto extents = centres.max - centres.min;
+        int axis = (extents.x >= extents.y && extents.x >= extents.z) ? 0 : ((extents.y >= extents.z) ? 1 : 2);
+        if ((end - begin) <= s_maxLeafSize || extents[axis] <= 0.0) return index;
+
+        uint32_t mid = (begin + end) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](uint32_t lhs, uint32_t rhs) { return items[lhs].centre[axis] < items[rhs].centre[axis]; });
+
+        buildNode(items, order, nodes, begin, mid);
+        auto second = buildNode(items, order, nodes, mid, end);
+
+        nodes[index].first = second;
+        nodes[index].count = 0;
+        return index;
+    }
+
+    void buildBVH(const std::vector<Item>& items, std::vector<uint32_t>& order, std::vector<BatchIntersector::BVHNode>& nodes)
+    {
+        order.resize(items.size());
+        std::iota(order.begin(), order.end(), 0);
+        nodes.clear();
+        if (!items.empty()) buildNode(items, order, nodes, 0, static_cast<uint32_t>(items.size()));
+    }
+
+    struct Ray
+    {
+        Ray(const vsg::dvec3& in_start, const vsg::dvec3& in_end) :
+            start(in_start),
+            direction(in_end - in_start)
+        {
+            for (int i = 0; i < 3; ++i) inverseDirection[i] = direction[i] != 0.0 ? 1.0 / direction[i] : std::numeric_limits<double>::max();
+        }
+
+        vsg::dvec3 start;
+        vsg::dvec3 direction;
+        vsg::dvec3 inverseDirection;
+
+        bool intersects(const BatchIntersector::BVHNode& node, double maxRatio) const
+        {
+            double tmin = 0.0;
+            double tmax = maxRatio;
+            for (int i = 0; i < 3; ++i)
+            {
+                double t1 = (node.min[i] - start[i]) * inverseDirection[i];
+                double t2 = (node.max[i] - start[i]) * inverseDirection[i];
+                tmin = std::max(tmin, std::min(t1, t2));
+                tmax = std::min(tmax, std::max(t1, t2));
+            }
+            return tmin <= tmax;
+        }
+
+        // Möller–Trumbore, returns the ratio along the ray or a negative value if there is no intersection
+        double intersects(const vsg::vec3& v0, const vsg::vec3& v1, const vsg::vec3& v2) const
+        {
+            vsg::dvec3 p0(v0), e1 = vsg::dvec3(v1) - p0, e2 = vsg::dvec3(v2) - p0;
+            auto p = vsg::cross(direction, e2);
+            double det = vsg::dot(e1, p);
+            if (std::abs(det) < 1e-20) return -1.0;
+
+            double inv_det = 1.0 / det;
+            auto s = start - p0;
+            double u = vsg::dot(s, p) * inv_det;
+            if (u < 0.0 || u > 1.0) return -1.0;
+
+            auto q = vsg::cross(s, e1);
+            double v = vsg::dot(direction, q) * inv_det;
+            if (v < 0.0 || (u + v) > 1.0) return -1.0;
+
+            return vsg::dot(e2, q) * inv_det;
+        }
+    };
+
+    // visit the leaf items whose bounds the ray passes through within maxRatio, testItem may reduce maxRatio.
+    // Subtrees that don't fit on the stack, which the median split build shouldn't produce, are traversed recursively.
+    template<typename F>
+    void traverseBVH(const std::vector<BatchIntersector::BVHNode>& nodes, const Ray& ray, double& maxRatio, F&& testItem, uint32_t root = 0)
+    {
+        if (nodes.empty()) return;
+
+        const uint32_t maxStackSize = 64;
+        uint32_t stack[maxStackSize];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = root;
+        while (stackSize > 0)
+        {
+            auto& node = nodes[stack[--stackSize]];
+            if (!ray.intersects(node, maxRatio)) continue;
+
+            uint32_t firstChild = static_cast<uint32_t>(&node - nodes.data()) + 1;
+            if (node.count > 0)
+            {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i) testItem(i, maxRatio);
+            }
+            else if (stackSize + 2 <= maxStackSize)
+            {
+                stack[stackSize++] = node.first;
+                stack[stackSize++] = firstChild;
+            }
+            else
+            {
+                traverseBVH(nodes, ray, maxRatio, testItem, firstChild);
+                traverseBVH(nodes, ray, maxRatio, testItem, node.first);
+            }
+        }
+    }
+
+    class TaskOperation : public vsg::Inherit<vsg::Operation, TaskOperation>
+    {
+    public:
+        TaskOperation(std::function<void()> in_task, vsg::ref_ptr<vsg::Latch> in_latch) :
+            task(std::move(in_task)),
+            latch(in_latch) {}
+
+        std::function<void()> task;
+        vsg::ref_ptr<vsg::Latch> latch;
+
+        void run() override
+        {
+            task();
+            latch->count_down();
+        }
+    };
+} // namespace
+
+class BatchIntersector::Collector : public vsg::ConstVisitor
+{
+public:
+    explicit Collector(BatchIntersector& in_intersector) :
+        intersector(in_intersector) {}
+
+    BatchIntersector& intersector;
+    std::vector<vsg::dmat4> matrixStack{vsg::dmat4()};
+
+    using ConstVisitor::apply;
+
+    void apply(const vsg::Node& node) override
+    {
+        node.traverse(*this);
+    }
+
+    void apply(const vsg::Transform& transform) override
+    {
+        matrixStack.push_back(transform.transform(matrixStack.back()));
+        transform.traverse(*this);
+        matrixStack.pop_back();
+    }
+
+    void apply(const vsg::LOD& lod) override
+    {
+        if (!lod.children.empty() && lod.children.front().node) lod.children.front().node->accept(*this);
+    }
+
+    void apply(const vsg::PagedLOD& plod) override
+    {
+        for (auto& child : plod.children)
+        {
+            if (child.node)
+            {
+                child.node->accept(*this);
+                return;
+            }
+        }
+    }
+
+    void apply(const vsg::VertexIndexDraw& vid) override
+    {
+        if (!vid.arrays.empty() && vid.indices) add(vid, vid.arrays[0]->data, vid.indices->data, vid.firstIndex, vid.indexCount);
+    }
+
+    void apply(const vsg::VertexDraw& vd) override
+    {
+        if (!vd.arrays.empty()) add(vd, vd.arrays[0]->data, {}, vd.firstVertex, vd.vertexCount);
+    }
+
+    void apply(const vsg::Geometry& geometry) override
+    {
+        if (geometry.arrays.empty()) return;
+
+        auto vertices = geometry.arrays[0]->data;
+        for (auto& command : geometry.commands)
+        {
+            if (auto drawIndexed = command->cast<vsg::DrawIndexed>(); drawIndexed && geometry.indices)
+                add(geometry, vertices, geometry.indices->data, drawIndexed->firstIndex, drawIndexed->indexCount);
+            else if (auto draw = command->cast<vsg::Draw>())
+                add(geometry, vertices, {}, draw->firstVertex, draw->vertexCount);
+        }
+    }
+
+    void add(const vsg::Node& node, vsg::ref_ptr<const vsg::Data> vertices, vsg::ref_ptr<const vsg::Data> indices, uint32_t first, uint32_t count)
+    {
+        auto bvh = intersector.triangleBVH(vertices, indices, first, count);
+        if (!bvh || bvh->nodes.empty()) return;
+
+        auto& localToWorld = matrixStack.back();
+        intersector.instances.push_back(Instance{vsg::inverse(localToWorld), localToWorld, bvh, &node});
+    }
+};
+
+BatchIntersector::BatchIntersector(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads) :
+    operationThreads(in_operationThreads)
+{
+}
+
+const BatchIntersector::TriangleBVH* BatchIntersector::triangleBVH(vsg::ref_ptr<const vsg::Data> vertexData, vsg::ref_ptr<const vsg::Data> indexData, uint32_t first, uint32_t count)
+{
+    GeometryKey key(vertexData, indexData, first, count);
+    if (auto itr = geometryCache.find(key); itr != geometryCache.end()) return itr->second.get();
+
+    auto& bvh = geometryCache[key];
+    bvh = std::make_unique<TriangleBVH>();
+
+    auto vertices = vertexData ? vertexData->cast<vsg::vec3Array>() : nullptr;
+    if (!vertices) return bvh.get();
+
+    // triangle lists only, other topologies would need the pipeline's input assembly state
+    std::vector<uint32_t> vertexIndices;
+    if (!indexData)
+    {
+        for (uint32_t i = first; i < first + count && i < vertices->size(); ++i) vertexIndices.push_back(i);
+    }
+    else if (auto us = indexData->cast<vsg::ushortArray>())
+    {
+        for (uint32_t i = first; i < first + count && i < us->size(); ++i) vertexIndices.push_back(us->at(i));
+    }
+    else if (auto ui = indexData->cast<vsg::uintArray>())
+    {
+        for (uint32_t i = first; i < first + count && i < ui->size(); ++i) vertexIndices.push_back(ui->at(i));
+    }
+    else if (auto ub = indexData->cast<vsg::ubyteArray>())
+    {
+        for (uint32_t i = first; i < first + count && i < ub->size(); ++i) vertexIndices.push_back(ub->at(i));
+    }
+
+    std::vector<Item> items;
+    size_t numTriangles = vertexIndices.size() / 3;
+    items.reserve(numTriangles);
+    for (size_t t = 0; t < numTriangles; ++t)
+    {
+        Item item;
+        for (size_t c = 0; c < 3; ++c)
+        {
+            auto index = vertexIndices[t * 3 + c];
+            if (index >= vertices->size()) index = 0;
+            item.box.add(vsg::dvec3(vertices->at(index)));
+        }
+        item.centre = (item.box.min + item.box.max) * 0.5;
+        items.push_back(item);
+    }
+
+    std::vector<uint32_t> order;
+    buildBVH(items, order, bvh->nodes);
+
+    // store the triangles in leaf order so each leaf's vertices are contiguous
+    bvh->vertices.reserve(order.size() * 3);
+    bvh->triangleIndices = order;
+    for (auto t : order)
+    {
+        for (size_t c = 0; c < 3; ++c)
+        {
+            auto index = vertexIndices[t * 3 + c];
+            bvh->vertices.push_back(vertices->at(index < vertices->size() ? index : 0));
+        }
+    }
+
+    return bvh.get();
+}
+
+void BatchIntersector::build(const vsg::Node& scene)
+{
+    instances.clear();
+
+    Collector collector(*this);
+    scene.accept(collector);
+
+    std::vector<Item> items;
+    items.reserve(instances.size());
+    for (auto& instance : instances)
+    {
+        // transform the corners of the local bounds into world coordinates
+        auto& root = instance.bvh->nodes.front();
+        Item item;
+        for (int c = 0; c < 8; ++c)
+        {
+            vsg::dvec3 corner((c & 1) ? root.max.x : root.min.x, (c & 2) ? root.max.y : root.min.y, (c & 4) ? root.max.z : root.min.z);
+            item.box.add(instance.localToWorld * corner);
+        }
+        item.centre = (item.box.min + item.box.max) * 0.5;
+        items.push_back(item);
+    }
+
+    buildBVH(items, instanceOrder, instanceNodes);
+}
+
+size_t BatchIntersector::numTriangles() const
+{
+    size_t count = 0;
+    for (auto& [key, bvh] : geometryCache) count += bvh->triangleIndices.size();
+    return count;
+}
+
+void BatchIntersector::intersect(const Segment& segment, Hit& hit) const
+{
+    hit = Hit{};
+
+    Ray worldRay(segment.start, segment.end);
+    double nearest = 1.0;
+    traverseBVH(instanceNodes, worldRay, nearest, [&](uint32_t i, double& maxRatio) {
+        uint32_t instanceIndex = instanceOrder[i];
+        auto& instance = instances[instanceIndex];
+
+        // ratios along the segment are preserved by the affine world to local transform
+        Ray localRay(instance.worldToLocal * segment.start, instance.worldToLocal * segment.end);
+        auto& bvh = *instance.bvh;
+        traverseBVH(bvh.nodes, localRay, maxRatio, [&](uint32_t t, double& localMaxRatio) {
+            double ratio = localRay.intersects(bvh.vertices[t * 3], bvh.vertices[t * 3 + 1], bvh.vertices[t * 3 + 2]);
+            if (ratio >= 0.0 && ratio <= localMaxRatio)
+            {
+                localMaxRatio = ratio;
+                hit.ratio = ratio;
+                hit.instanceIndex = instanceIndex;
+                hit.triangleIndex = bvh.triangleIndices[t];
+            }
+        });
+    });
+
+    if (hit.valid()) hit.worldIntersection = segment.start + (segment.end - segment.start) * hit.ratio;
+}
+
+void BatchIntersector::intersect(const std::vector<Segment>& segments, std::vector<Hit>& hits) const
+{
+    hits.resize(segments.size());
+
+    size_t numThreads = operationThreads ? operationThreads->threads.size() + 1 : 1;
+    size_t numTasks = std::max(size_t(1), std::min(numThreads, segments.size() / std::max(minSegmentsPerTask, size_t(1))));
+
+    auto intersectRange = [this, &segments, &hits](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) intersect(segments[i], hits[i]);
+    };
+
+    if (numTasks == 1)
+    {
+        intersectRange(0, segments.size());
+        return;
+    }
+
+    auto latch = vsg::Latch::create(static_cast<int>(numTasks - 1));
+    for (size_t t = 1; t < numTasks; ++t)
+    {
+        size_t begin = (segments.size() * t) / numTasks;
+        size_t end = (segments.size() * (t + 1)) / numTasks;
+        operationThreads->add(TaskOperation::create([intersectRange, begin, end]() { intersectRange(begin, end); }, latch));
+    }
+
+    intersectRange(0, segments.size() / numTasks);
+    latch->wait();
+}
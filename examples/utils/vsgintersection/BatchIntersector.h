@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <map>
+
+// Batched line segment intersection against a scene graph's triangle geometry.
+// build() collects the VertexIndexDraw, VertexDraw and Geometry triangle lists in the scene along with their world
+// transforms, building a bounding volume hierarchy for each unique vertex/index array pair which is cached and reused by
+// subsequent builds and by every instance of the geometry. intersect() tests an array of segments against the instances,
+// splitting the batch across the optional operation threads, and returns the nearest hit of each segment.
+// Only the highest resolution loaded child of LOD and PagedLOD is used, instanced vertex attributes are ignored.
+class BatchIntersector : public vsg::Inherit<vsg::Object, BatchIntersector>
+{
+public:
+    explicit BatchIntersector(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads = {});
+
+    struct Segment
+    {
+        vsg::dvec3 start;
+        vsg::dvec3 end;
+    };
+
+    struct Hit
+    {
+        double ratio = -1.0; // position of the hit along the segment, negative if there was no hit
+        vsg::dvec3 worldIntersection;
+        uint32_t instanceIndex = 0;
+        uint32_t triangleIndex = 0;
+
+        bool valid() const { return ratio >= 0.0; }
+    };
+
+    // optional threads that batches are split across, the calling thread always runs a share of the segments
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+
+    // minimum number of segments per task
+    size_t minSegmentsPerTask = 64;
+
+    // collect the geometry of the scene, call again after the scene graph has changed.
+    void build(const vsg::Node& scene);
+
+    // hits[i] is the nearest intersection of segments[i].
+    void intersect(const std::vector<Segment>& segments, std::vector<Hit>& hits) const;
+
+    // the drawable node associated with a Hit::instanceIndex
+    const vsg::Node* instanceNode(uint32_t instanceIndex) const { return instanceIndex < instances.size() ? instances[instanceIndex].node : nullptr; }
+
+    size_t numInstances() const { return instances.size(); }
+    size_t numCachedGeometries() const { return geometryCache.size(); }
+    size_t numTriangles() const;
+
+    struct BVHNode
+    {
+        vsg::dvec3 min;
+        vsg::dvec3 max;
+        uint32_t first = 0; // first item of a leaf, index of the second child of an interior node
+        uint32_t count = 0; // number of items in a leaf, 0 for interior nodes whose first child follows them
+    };
+
+    struct TriangleBVH
+    {
+        std::vector<vsg::vec3> vertices; // three per triangle, in BVH leaf order
+        std::vector<uint32_t> triangleIndices; // the source triangle of each triangle in BVH order
+        std::vector<BVHNode> nodes;
+    };
+
+protected:
+    struct Instance
+    {
+        vsg::dmat4 worldToLocal;
+        vsg::dmat4 localToWorld;
+        const TriangleBVH* bvh = nullptr;
+        const vsg::Node* node = nullptr;
+    };
+
+    class Collector;
+    friend class Collector;
+
+    const TriangleBVH* triangleBVH(vsg::ref_ptr<const vsg::Data> vertices, vsg::ref_ptr<const vsg::Data> indices, uint32_t first, uint32_t count);
+    void intersect(const Segment& segment, Hit& hit) const;
+
+    using GeometryKey = std::tuple<vsg::ref_ptr<const vsg::Data>, vsg::ref_ptr<const vsg::Data>, uint32_t, uint32_t>;
+    std::map<GeometryKey, std::unique_ptr<TriangleBVH>> geometryCache;
+
+    std::vector<Instance> instances;
+    std::vector<BVHNode> instanceNodes; // BVH over the world bounds of the instances
+    std::vector<uint32_t> instanceOrder;
+};
@@ -0,0 +1,125 @@
+#include "FrameArenaAllocator.h"
+
+static constexpr size_t s_arenaAlignment = 16;
+
+// arena that allocations on the current thread are directed to, set by FrameArenaAllocator::Scope
+static thread_local FrameArenaAllocator* s_scopedArena = nullptr;
+
+FrameArenaAllocator::Scope::Scope(FrameArenaAllocator& allocator) :
+    _previous(s_scopedArena)
+{
+    s_scopedArena = &allocator;
+}
+
+FrameArenaAllocator::Scope::~Scope()
+{
+    s_scopedArena = _previous;
+}
+
+FrameArenaAllocator::FrameArenaAllocator(std::unique_ptr<Allocator> in_nestedAllocator, size_t in_chunkSize) :
+    vsg::Allocator(std::move(in_nestedAllocator)),
+    chunkSize(std::max(in_chunkSize, size_t(4096)))
+{
+}
+
+FrameArenaAllocator::~FrameArenaAllocator()
+{
+    for (auto& chunk : _chunks) operator delete(chunk.memory, std::align_val_t{s_arenaAlignment});
+}
+
+void* FrameArenaAllocator::allocate(std::size_t size, vsg::AllocatorAffinity allocatorAffinity)
+{
+    bool useArena = (allocatorAffinity == ALLOCATOR_AFFINITY_FRAME || s_scopedArena == this) && size <= chunkSize / 4;
+    if (!useArena)
+    {
+        if (allocatorAffinity == ALLOCATOR_AFFINITY_FRAME) allocatorAffinity = vsg::ALLOCATOR_AFFINITY_OBJECTS;
+        return Allocator::allocate(size, allocatorAffinity);
+    }
+
+    size_t alignedSize = (std::max(size, size_t(1)) + s_arenaAlignment - 1) & ~(s_arenaAlignment - 1);
+
+    std::scoped_lock<std::mutex> lock(_arenaMutex);
+
+    while (_currentChunk < _chunks.size() && _chunks[_currentChunk].used + alignedSize > chunkSize) ++_currentChunk;
+    if (_currentChunk == _chunks.size())
+    {
+        if (_chunks.size() == maxChunks)
+        {
+            if (allocatorAffinity == ALLOCATOR_AFFINITY_FRAME) allocatorAffinity = vsg::ALLOCATOR_AFFINITY_OBJECTS;
+            return Allocator::allocate(size, allocatorAffinity);
+        }
+
+        auto memory = static_cast<uint8_t*>(operator new(chunkSize, std::align_val_t{s_arenaAlignment}));
+        _chunks.push_back(Chunk{memory, 0});
+
+        // publish the chunk's range for deallocate()
+        if (!_arenaBegin || memory < _arenaBegin) _arenaBegin = memory;
+        if (memory + chunkSize > _arenaEnd) _arenaEnd = memory + chunkSize;
+        _chunkMemory[_chunks.size() - 1].store(memory, std::memory_order_relaxed);
+        _numChunks.store(_chunks.size(), std::memory_order_release);
+    }
+
+    auto& chunk = _chunks[_currentChunk];
+    void* ptr = chunk.memory + chunk.used;
+    chunk.used += alignedSize;
+
+    _frameBytes += alignedSize;
+    ++_numLive;
+    ++numArenaAllocations;
+    return ptr;
+}
+
+bool FrameArenaAllocator::inArena(const void* ptr) const
+{
+    // read the count first so every chunk it covers has been published, most frees are rejected by the overall range
+    size_t numChunks = _numChunks.load(std::memory_order_acquire);
+    auto memory = static_cast<const uint8_t*>(ptr);
+    if (numChunks == 0 || memory < _arenaBegin.load(std::memory_order_relaxed) || memory >= _arenaEnd.load(std::memory_order_relaxed)) return false;
+
+    for (size_t i = 0; i < numChunks; ++i)
+    {
+        auto chunkMemory = _chunkMemory[i].load(std::memory_order_relaxed);
+        if (memory >= chunkMemory && memory < chunkMemory + chunkSize) return true;
+    }
+    return false;
+}
+
+bool FrameArenaAllocator::deallocate(void* ptr, std::size_t size)
+{
+    if (ptr && size <= chunkSize / 4 && inArena(ptr))
+    {
+        _numLive.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return Allocator::deallocate(ptr, size);
+}
+
+void FrameArenaAllocator::reset()
+{
+    std::scoped_lock<std::mutex> lock(_arenaMutex);
+
+    ++numFrames;
+    if (_frameBytes > peakFrameBytes) peakFrameBytes = _frameBytes;
+
+    if (_numLive > 0)
+    {
+        vsg::warn("FrameArenaAllocator::reset() ", _numLive.load(), " arena allocations still in use, not resetting arena.");
+        ++numSkippedResets;
+        return;
+    }
+
+    // keep the chunks so that subsequent frames reuse them
+    for (auto& chunk : _chunks) chunk.used = 0;
+    _currentChunk = 0;
+    _frameBytes = 0;
+}
+
+void FrameArenaAllocator::report(std::ostream& out) const
+{
+    {
+        std::scoped_lock<std::mutex> lock(_arenaMutex);
+        out << "FrameArenaAllocator::report() chunkSize = " << chunkSize << ", numChunks = " << _chunks.size() << ", numFrames = " << numFrames
+            << ", numArenaAllocations = " << numArenaAllocations << ", peakFrameBytes = " << peakFrameBytes << ", numSkippedResets = " << numSkippedResets << std::endl;
+    }
+    vsg::Allocator::report(out);
+}
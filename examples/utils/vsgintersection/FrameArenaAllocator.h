@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <array>
+#include <atomic>
+
+// vsg::Allocator that serves transient allocations from a bump allocated arena which is reset in bulk each frame.
+// Allocations made with ALLOCATOR_AFFINITY_FRAME, or made on a thread while a FrameArenaAllocator::Scope is active, come from
+// the arena, deallocating them only decrements a count of live allocations. All other allocations go to vsg::Allocator.
+// Anything allocated in the arena must be released before the next reset(), if allocations are still live reset() warns
+// and leaves the arena to grow rather than reuse memory that is still in use.
+class FrameArenaAllocator : public vsg::Allocator
+{
+public:
+    static constexpr vsg::AllocatorAffinity ALLOCATOR_AFFINITY_FRAME = vsg::AllocatorAffinity(vsg::ALLOCATOR_AFFINITY_LAST);
+
+    explicit FrameArenaAllocator(std::unique_ptr<Allocator> in_nestedAllocator = {}, size_t in_chunkSize = 1024 * 1024);
+    ~FrameArenaAllocator();
+
+    // size of each contiguous chunk of the arena, allocations larger than a quarter of this bypass the arena
+    const size_t chunkSize;
+
+    // the arena stops growing at maxChunks, further frame allocations that don't fit go to vsg::Allocator
+    static constexpr size_t maxChunks = 256;
+
+    // while in scope, allocations made by the constructing thread through the allocator are served from the arena
+    class Scope
+    {
+    public:
+        explicit Scope(FrameArenaAllocator& allocator);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    protected:
+        FrameArenaAllocator* _previous;
+    };
+
+    void* allocate(std::size_t size, vsg::AllocatorAffinity allocatorAffinity = vsg::ALLOCATOR_AFFINITY_OBJECTS) override;
+    bool deallocate(void* ptr, std::size_t size) override;
+
+    // release everything allocated in the arena since the last reset, call once per frame after advanceToNextFrame().
+    void reset();
+
+    void report(std::ostream& out) const override;
+
+    // stats
+    std::atomic_uint64_t numFrames{0};
+    std::atomic_uint64_t numArenaAllocations{0};
+    std::atomic_uint64_t numSkippedResets{0};
+    std::atomic_size_t peakFrameBytes{0};
+
+protected:
+    struct Chunk
+    {
+        uint8_t* memory = nullptr;
+        size_t used = 0;
+    };
+
+    bool inArena(const void* ptr) const;
+
+    // guards allocation from, and reset of, the chunks
+    mutable std::mutex _arenaMutex;
+    std::vector<Chunk> _chunks;
+    size_t _currentChunk = 0;
+    size_t _frameBytes = 0;
+    std::atomic_uint64_t _numLive{0};
+
+    // chunks are only ever appended until the allocator is destroyed, so deallocate() can check whether a pointer is in
+    // the arena from these without taking the mutex. _chunkMemory entries are written before _numChunks is incremented.
+    std::array<std::atomic<const uint8_t*>, maxChunks> _chunkMemory{};
+    std::atomic_size_t _numChunks{0};
+    std::atomic<const uint8_t*> _arenaBegin{nullptr};
+    std::atomic<const uint8_t*> _arenaEnd{nullptr};
+};
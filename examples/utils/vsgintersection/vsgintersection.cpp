@@ -4,7 +4,12 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "BatchIntersector.h"
+#include "FrameArenaAllocator.h"
+
 #include <iostream>
+#include <optional>
+#include <random>
 
 class IntersectionHandler : public vsg::Inherit<vsg::Visitor, IntersectionHandler>
 {
@@ -20,6 +25,9 @@ public:
     double scale = 1.0;
     bool verbose = true;
 
+    // optional arena that the transient intersector and its intersections are allocated from
+    FrameArenaAllocator* frameArena = nullptr;
+
     IntersectionHandler(vsg::ref_ptr<vsg::Builder> in_builder, vsg::ref_ptr<vsg::Camera> in_camera, vsg::ref_ptr<vsg::Group> in_scenegraph, vsg::ref_ptr<vsg::EllipsoidModel> in_ellipsoidModel, double in_scale, vsg::ref_ptr<vsg::Options> in_options) :
         builder(in_builder),
         options(in_options),
@@ -37,7 +45,7 @@ public:
         if (lastPointerEvent)
         {
             intersection(*lastPointerEvent);
-            if (!lastIntersection) return;
+            if (!lastWorldIntersection) return;
 
             vsg::info("keyPress.keyModifier = ", keyPress.keyModifier, " keyPress.keyBase = ", keyPress.keyBase);
 
@@ -54,12 +62,12 @@ public:
                 geom.position.set(0.0f, 0.0f, 0.0f);
 
                 // the position is set by positions data, in this case just one poistion so use a vec4Value, but we can if need use a array of positions
-                auto pos = vsg::vec3(lastIntersection->worldIntersection);
+                auto pos = vsg::vec3(*lastWorldIntersection);
                 geom.positions = vsg::vec4Value::create(vsg::vec4(pos.x, pos.y, pos.z, scale*5.0)); // x,y,z and scaleDistance
             }
             else
             {
-                geom.position = vsg::vec3(lastIntersection->worldIntersection);
+                geom.position = vsg::vec3(*lastWorldIntersection);
             }
 
             if (keyPress.keyBase == 'b')
@@ -117,6 +125,10 @@ public:
 
     void intersection(vsg::PointerEvent& pointerEvent)
     {
+        // the intersector and intersections are discarded before returning so can come from the frame arena
+        std::optional<FrameArenaAllocator::Scope> arenaScope;
+        if (frameArena) arenaScope.emplace(*frameArena);
+
         auto intersector = vsg::LineSegmentIntersector::create(*camera, pointerEvent.x, pointerEvent.y);
         scenegraph->accept(*intersector);
 
@@ -138,9 +150,9 @@ public:
                 if (verbose) std::cout << " lat = " << location[0] << ", long = " << location[1] << ", height = " << location[2];
             }
 
-            if (lastIntersection)
+            if (lastWorldIntersection)
             {
-                if (verbose) std::cout << ", distance from previous intersection = " << vsg::length(intersection->worldIntersection - lastIntersection->worldIntersection);
+                if (verbose) std::cout << ", distance from previous intersection = " << vsg::length(intersection->worldIntersection - *lastWorldIntersection);
             }
 
             if (verbose)
@@ -168,12 +180,12 @@ public:
             }
         }
 
-        lastIntersection = intersector->intersections.front();
+        lastWorldIntersection = intersector->intersections.front()->worldIntersection;
     }
 
 protected:
     vsg::ref_ptr<vsg::PointerEvent> lastPointerEvent;
-    vsg::ref_ptr<vsg::LineSegmentIntersector::Intersection> lastIntersection;
+    std::optional<vsg::dvec3> lastWorldIntersection;
 };
 
 int main(int argc, char** argv)
@@ -199,6 +211,16 @@ int main(int argc, char** argv)
     auto horizonMountainHeight = arguments.value(0.0, "--hmh");
     vsg::Path textureFile = arguments.value<std::string>("", "-t");
 
+    auto numBatchSegments = arguments.value<size_t>(0, "--batch");
+    auto numBatchThreads = arguments.value<uint32_t>(0, "--batch-threads");
+
+    FrameArenaAllocator* frameArena = nullptr;
+    if (arguments.read("--frame-arena"))
+    {
+        frameArena = new FrameArenaAllocator(std::move(vsg::Allocator::instance()), arguments.value<size_t>(1024 * 1024, "--arena-chunk"));
+        vsg::Allocator::instance().reset(frameArena);
+    }
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
 #ifdef vsgXchange_all
@@ -308,6 +330,7 @@ int main(int argc, char** argv)
 
     auto intersectionHandler = IntersectionHandler::create(builder, camera, scene, ellipsoidModel, radius * 0.1, options);
     intersectionHandler->state = stateInfo;
+    intersectionHandler->frameArena = frameArena;
     viewer->addEventHandler(intersectionHandler);
 
     // assign a CompileTraversal to the Builder that will compile for all the views assigned to the viewer,
@@ -316,9 +339,61 @@ int main(int argc, char** argv)
 
     viewer->compile();
 
+    // optionally fire a batch of height above terrain segments through the scene each frame
+    vsg::ref_ptr<BatchIntersector> batchIntersector;
+    if (numBatchSegments > 0)
+    {
+        batchIntersector = BatchIntersector::create(numBatchThreads > 0 ? vsg::OperationThreads::create(numBatchThreads) : vsg::ref_ptr<vsg::OperationThreads>());
+    }
+    size_t numBuiltChildren = 0;
+    std::vector<BatchIntersector::Segment> segments(numBatchSegments);
+    std::vector<BatchIntersector::Hit> hits;
+    std::mt19937 randomEngine;
+    std::uniform_real_distribution<double> unitDistribution(0.0, 1.0);
+    double batchTime = 0.0;
+    double buildTime = 0.0;
+    size_t numBatches = 0;
+    size_t numHits = 0;
+
     // rendering main loop
     while (viewer->advanceToNextFrame())
     {
+        // release the previous frame's transient allocations
+        if (frameArena) frameArena->reset();
+
+        if (batchIntersector)
+        {
+            // the handler adds shapes to the scene so rebuild the instances when it changes, geometry BVHs are cached
+            if (scene->children.size() != numBuiltChildren)
+            {
+                auto startOfBuild = vsg::clock::now();
+                batchIntersector->build(*scene);
+                buildTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startOfBuild).count();
+                numBuiltChildren = scene->children.size();
+            }
+
+            auto& bounds = computeBounds.bounds;
+            for (auto& segment : segments)
+            {
+                vsg::dvec3 position(bounds.min.x + (bounds.max.x - bounds.min.x) * unitDistribution(randomEngine),
+                                    bounds.min.y + (bounds.max.y - bounds.min.y) * unitDistribution(randomEngine),
+                                    bounds.min.z + (bounds.max.z - bounds.min.z) * unitDistribution(randomEngine));
+                vsg::dvec3 up = ellipsoidModel ? vsg::normalize(position) : vsg::dvec3(0.0, 0.0, 1.0);
+                segment.start = position + up * radius;
+                segment.end = position - up * radius;
+            }
+
+            auto startOfBatch = vsg::clock::now();
+            batchIntersector->intersect(segments, hits);
+            batchTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startOfBatch).count();
+
+            ++numBatches;
+            for (auto& hit : hits)
+            {
+                if (hit.valid()) ++numHits;
+            }
+        }
+
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
@@ -329,6 +404,16 @@ int main(int argc, char** argv)
         viewer->present();
     }
 
+    if (frameArena) frameArena->report(std::cout);
+
+    if (batchIntersector && numBatches > 0)
+    {
+        std::cout << "BatchIntersector: " << batchIntersector->numInstances() << " instances, " << batchIntersector->numCachedGeometries() << " cached geometries, "
+                  << batchIntersector->numTriangles() << " triangles, total build time " << buildTime << "ms" << std::endl;
+        std::cout << "    " << numBatches << " batches of " << numBatchSegments << " segments, average " << (batchTime / double(numBatches)) << "ms per batch, "
+                  << (double(numBatches * numBatchSegments) / (batchTime * 0.001)) << " segments per second, " << numHits << " hits" << std::endl;
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -0,0 +1,276 @@
+#include "SpirvArchive.h"
+#include "AtomicSave.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <thread>
+
+namespace
+{
+    // accumulates the shared FNV-1a hash of a stage's settings
+    struct Hash
+    {
+        uint64_t value = experimental::hashSeed;
+
+        void add(const void* data, size_t size) { value = experimental::hashBytes(data, size, value); }
+
+        template<typename T>
+        void add(const T& v)
+        {
+            add(&v, sizeof(T));
+        }
+
+        void add(const std::string& str)
+        {
+            uint64_t size = str.size();
+            add(size);
+            add(str.data(), str.size());
+        }
+    };
+
+    class CollectShaderStages : public vsg::Inherit<vsg::Visitor, CollectShaderStages>
+    {
+    public:
+        explicit CollectShaderStages(vsg::ShaderStages& in_stages) :
+            stages(in_stages) {}
+
+        vsg::ShaderStages& stages;
+        std::set<vsg::Object*> visited;
+
+        void add(vsg::BindGraphicsPipeline& bindGraphicsPipeline)
+        {
+            if (!bindGraphicsPipeline.pipeline) return;
+            for (auto& stage : bindGraphicsPipeline.pipeline->stages) stages.push_back(stage);
+        }
+
+        void apply(vsg::Node& node) override
+        {
+            if (visited.insert(&node).second) node.traverse(*this);
+        }
+
+        void apply(vsg::StateGroup& stateGroup) override
+        {
+            if (!visited.insert(&stateGroup).second) return;
+
+            for (auto& stateCommand : stateGroup.stateCommands)
+            {
+                if (auto bindGraphicsPipeline = stateCommand->cast<vsg::BindGraphicsPipeline>()) add(*bindGraphicsPipeline);
+            }
+            stateGroup.traverse(*this);
+        }
+
+        void apply(vsg::Commands& commands) override
+        {
+            if (!visited.insert(&commands).second) return;
+
+            for (auto& command : commands.children)
+            {
+                if (auto bindGraphicsPipeline = command->cast<vsg::BindGraphicsPipeline>()) add(*bindGraphicsPipeline);
+            }
+        }
+    };
+} // namespace
+
+uint64_t SpirvArchive::key(const vsg::ShaderStage& stage)
+{
+    Hash hash;
+    hash.add(static_cast<uint32_t>(stage.stage));
+    hash.add(stage.entryPointName);
+
+    if (stage.module)
+    {
+        hash.add(stage.module->source);
+        if (auto& hints = stage.module->hints)
+        {
+            hash.add(hints->vulkanVersion);
+            hash.add(hints->clientInputVersion);
+            hash.add(static_cast<uint32_t>(hints->language));
+            hash.add(hints->defaultVersion);
+            hash.add(static_cast<uint32_t>(hints->target));
+            hash.add(static_cast<uint8_t>(hints->forwardCompatible));
+            hash.add(static_cast<uint8_t>(hints->generateDebugInfo));
+
+            // std::set so the defines are already in a stable order
+            hash.add(static_cast<uint64_t>(hints->defines.size()));
+            for (auto& define : hints->defines) hash.add(define);
+        }
+    }
+    return hash.value;
+}
+
+void SpirvArchive::collect(const vsg::ShaderSet& shaderSet, vsg::ShaderStages& stages)
+{
+    for (auto& [shaderCompileSettings, variantStages] : shaderSet.variants)
+    {
+        stages.insert(stages.end(), variantStages.begin(), variantStages.end());
+    }
+}
+
+void SpirvArchive::collect(vsg::Node& node, vsg::ShaderStages& stages)
+{
+    auto collectShaderStages = CollectShaderStages::create(stages);
+    node.accept(*collectShaderStages);
+}
+
+const SpirvArchive::IndexEntry* SpirvArchive::find(uint64_t key) const
+{
+    auto itr = std::lower_bound(_entries.begin(), _entries.end(), key, [](const IndexEntry& entry, uint64_t k) { return entry.key < k; });
+    return (itr != _entries.end() && itr->key == key) ? &(*itr) : nullptr;
+}
+
+size_t SpirvArchive::precompile(const vsg::ShaderStages& stages, vsg::ref_ptr<const vsg::Options> options, uint32_t numThreads)
+{
+    // one job per permutation not already archived, its code is then shared with the other stages of the same key.
+    // Jobs hold distinct ShaderModules so no two threads compile into the same one.
+    std::map<uint64_t, std::vector<vsg::ref_ptr<vsg::ShaderStage>>> permutations;
+    for (auto& stage : stages)
+    {
+        if (!stage || !stage->module || stage->module->source.empty()) continue;
+
+        auto k = key(*stage);
+        if (find(k)) continue;
+
+        auto& permutation = permutations[k];
+        if (std::none_of(permutation.begin(), permutation.end(), [&](auto& s) { return s->module == stage->module; })) permutation.push_back(stage);
+    }
+
+    std::vector<std::pair<uint64_t, std::vector<vsg::ref_ptr<vsg::ShaderStage>>*>> jobs;
+    for (auto& [k, permutation] : permutations) jobs.emplace_back(k, &permutation);
+
+    std::atomic_size_t nextJob{0};
+    std::atomic_size_t numCompiled{0};
+
+    auto run = [&]() {
+        // glslang state isn't shared between threads, so each has its own compiler
+        auto shaderCompiler = vsg::ShaderCompiler::create();
+        if (!shaderCompiler->supported()) return;
+
+        for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+        {
+            auto& permutation = *jobs[i].second;
+            auto& stage = permutation.front();
+            if (stage->module->code.empty() && !shaderCompiler->compile(stage, {}, options))
+            {
+                vsg::warn("SpirvArchive: failed to compile ", stage->module->source.size(), " byte ", stage->entryPointName, " shader, stage = ", stage->stage);
+                continue;
+            }
+
+            for (auto& other : permutation) other->module->code = stage->module->code;
+            ++numCompiled;
+        }
+    };
+
+    numThreads = std::max(1u, std::min(numThreads, static_cast<uint32_t>(jobs.size())));
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t < numThreads; ++t) threads.emplace_back(run);
+    run();
+    for (auto& thread : threads) thread.join();
+
+    // merge the new code into the archive, keeping the index sorted
+    for (auto& [k, permutation] : jobs)
+    {
+        auto& code = permutation->front()->module->code;
+        if (code.empty()) continue;
+
+        _entries.push_back(IndexEntry{k, _code.size(), code.size()});
+        _code.insert(_code.end(), code.begin(), code.end());
+    }
+    std::sort(_entries.begin(), _entries.end(), [](const IndexEntry& lhs, const IndexEntry& rhs) { return lhs.key < rhs.key; });
+
+    return numCompiled;
+}
+
+size_t SpirvArchive::assign(const vsg::ShaderStages& stages)
+{
+    size_t numAssigned = 0;
+    for (auto& stage : stages)
+    {
+        if (!stage || !stage->module || !stage->module->code.empty() || stage->module->source.empty()) continue;
+
+        if (auto entry = find(key(*stage)))
+        {
+            auto begin = _code.begin() + static_cast<std::ptrdiff_t>(entry->offset);
+            stage->module->code.assign(begin, begin + static_cast<std::ptrdiff_t>(entry->numWords));
+            ++numHits;
+            ++numAssigned;
+        }
+        else
+        {
+            ++numMisses;
+        }
+    }
+    return numAssigned;
+}
+
+bool SpirvArchive::read(const vsg::Path& filename)
+{
+    std::ifstream fin(filename.string(), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!fin) return false;
+
+    uint64_t fileSize = static_cast<uint64_t>(fin.tellg());
+    fin.seekg(0);
+
+    Header header, expected;
+    if (!fin.read(reinterpret_cast<char*>(&header), sizeof(Header)) || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version)
+    {
+        vsg::warn("SpirvArchive: ", filename, " is not a SPIR-V archive");
+        return false;
+    }
+
+    // check the index and the code it refers to fit in the file before allocating them, so a corrupt archive can't request huge allocations
+    uint64_t indexSize = static_cast<uint64_t>(header.numEntries) * sizeof(IndexEntry);
+    if (indexSize > fileSize - sizeof(Header))
+    {
+        vsg::warn("SpirvArchive: ", filename, " is truncated");
+        return false;
+    }
+
+    std::vector<IndexEntry> entries(header.numEntries);
+    if (!fin.read(reinterpret_cast<char*>(entries.data()), static_cast<std::streamsize>(indexSize))) return false;
+
+    uint64_t availableWords = (fileSize - sizeof(Header) - indexSize) / sizeof(uint32_t);
+    uint64_t numWords = 0;
+    for (auto& entry : entries)
+    {
+        if (entry.offset > availableWords || entry.numWords > availableWords - entry.offset)
+        {
+            vsg::warn("SpirvArchive: ", filename, " has an entry outside of its code");
+            return false;
+        }
+        numWords = std::max(numWords, entry.offset + entry.numWords);
+    }
+
+    // find() is a binary search so the entries must be sorted by key
+    if (!std::is_sorted(entries.begin(), entries.end(), [](const IndexEntry& lhs, const IndexEntry& rhs) { return lhs.key < rhs.key; }))
+    {
+        vsg::warn("SpirvArchive: ", filename, " has an unsorted index");
+        return false;
+    }
+
+    std::vector<uint32_t> code(numWords);
+    if (!fin.read(reinterpret_cast<char*>(code.data()), static_cast<std::streamsize>(code.size() * sizeof(uint32_t)))) return false;
+
+    _entries.swap(entries);
+    _code.swap(code);
+    return true;
+}
+
+bool SpirvArchive::write(const vsg::Path& filename) const
+{
+    Header header;
+    header.numEntries = static_cast<uint32_t>(_entries.size());
+
+    // write through a temporary file so an interrupted write can't leave a truncated archive behind
+    return experimental::atomicSave(filename, [&](const vsg::Path& temporaryFilename) {
+        std::ofstream fout(temporaryFilename.string(), std::ios::out | std::ios::binary);
+        fout.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        fout.write(reinterpret_cast<const char*>(_entries.data()), static_cast<std::streamsize>(_entries.size() * sizeof(IndexEntry)));
+        fout.write(reinterpret_cast<const char*>(_code.data()), static_cast<std::streamsize>(_code.size() * sizeof(uint32_t)));
+        fout.close();
+        return !fout.fail();
+    });
+}
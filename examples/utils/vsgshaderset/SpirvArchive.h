@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+
+// Single file archive of precompiled SPIR-V, indexed by a 64 bit hash of everything that determines a ShaderModule's
+// compiled code: the stage, entry point, GLSL source and the ShaderCompileSettings defines and targets. The archive
+// is written by precompile() and consulted by assign() ahead of the ShaderCompiler, so shader permutations that were
+// precompiled don't need glslang at runtime.
+//
+// File layout, little endian:
+//   Header
+//   IndexEntry[numEntries], sorted by key so lookups are a binary search
+//   SPIR-V code of all the entries, IndexEntry::offset counts words from the start of the code
+class SpirvArchive : public vsg::Inherit<vsg::Object, SpirvArchive>
+{
+public:
+    struct Header
+    {
+        char magic[8] = {'V', 'S', 'G', 'S', 'P', 'V', 'A', '1'};
+        uint32_t version = 1;
+        uint32_t numEntries = 0;
+    };
+
+    struct IndexEntry
+    {
+        uint64_t key = 0;
+        uint64_t offset = 0;
+        uint64_t numWords = 0;
+    };
+
+    static uint64_t key(const vsg::ShaderStage& stage);
+
+    // collect the ShaderStages of the ShaderSet's variants
+    static void collect(const vsg::ShaderSet& shaderSet, vsg::ShaderStages& stages);
+
+    // collect the ShaderStages of the pipelines in a subgraph, such as a loaded model
+    static void collect(vsg::Node& node, vsg::ShaderStages& stages);
+
+    // compile the stages whose keys aren't in the archive yet on numThreads threads and add their code, returns the number of stages compiled.
+    size_t precompile(const vsg::ShaderStages& stages, vsg::ref_ptr<const vsg::Options> options, uint32_t numThreads);
+
+    // assign the archived code to stages that have none, returns the number of stages assigned.
+    size_t assign(const vsg::ShaderStages& stages);
+
+    bool read(const vsg::Path& filename);
+    bool write(const vsg::Path& filename) const;
+
+    size_t size() const { return _entries.size(); }
+
+    // statistics of assign()
+    std::atomic_uint numHits{0};
+    std::atomic_uint numMisses{0};
+
+protected:
+    std::vector<IndexEntry> _entries;
+    std::vector<uint32_t> _code;
+
+    const IndexEntry* find(uint64_t key) const;
+};
@@ -1,6 +1,9 @@
 #include <iostream>
+#include <thread>
 #include <vsg/all.h>
 
+#include "SpirvArchive.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -149,6 +152,9 @@ int main(int argc, char** argv)
     bool binary = arguments.read("--binary");
     bool vsgShaderSet = arguments.read("--vsg");
     bool stripShaderSetBeforeWrite = arguments.read({"-s", "--strip"});
+    auto archiveFilename = arguments.value<vsg::Path>("", "--archive");
+    auto precompileFilename = arguments.value<vsg::Path>("", "--precompile");
+    auto numThreads = arguments.value<uint32_t>(std::max(1u, std::thread::hardware_concurrency()), "--threads");
 
     vsg::ref_ptr<vsg::ShaderSet> shaderSet;
     if (inputFilename)
@@ -221,12 +227,50 @@ int main(int argc, char** argv)
     }
 
     // load remain command line parameters as models to help fill out the required ShaderSet variants
+    std::vector<vsg::ref_ptr<vsg::Node>> models;
     for(int i = 1; i<argc; ++i)
     {
         vsg::Path filename(argv[i]);
         if (auto model = vsg::read(filename, options))
         {
             std::cout<<"Loaded filename = "<<filename<<", model = "<<model<<std::endl;
+            if (auto node = model.cast<vsg::Node>()) models.push_back(node);
+        }
+    }
+
+    if (archiveFilename || precompileFilename)
+    {
+        // the permutations used by the ShaderSets' variants and the loaded models
+        vsg::ShaderStages stages;
+        for(auto& [name, ss] : options->shaderSets) SpirvArchive::collect(*ss, stages);
+        for(auto& model : models) SpirvArchive::collect(*model, stages);
+
+        auto archive = SpirvArchive::create();
+        if (archiveFilename)
+        {
+            // assign the archived code the way a loader would ahead of compiling with glslang
+            if (!archive->read(archiveFilename))
+            {
+                std::cout<<"Unable to read SPIR-V archive "<<archiveFilename<<std::endl;
+                return 1;
+            }
+
+            archive->assign(stages);
+            std::cout<<"\nSPIR-V archive "<<archiveFilename<<" entries = "<<archive->size()<<", hits = "<<archive->numHits<<", misses = "<<archive->numMisses<<std::endl;
+        }
+
+        if (precompileFilename)
+        {
+            auto startTime = vsg::clock::now();
+            auto numCompiled = archive->precompile(stages, options, numThreads);
+            auto time = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+
+            if (!archive->write(precompileFilename))
+            {
+                std::cout<<"Unable to write SPIR-V archive "<<precompileFilename<<std::endl;
+                return 1;
+            }
+            std::cout<<"\nPrecompiled "<<numCompiled<<" shader permutations on "<<numThreads<<" threads in "<<time<<"ms, written "<<archive->size()<<" entries to "<<precompileFilename<<std::endl;
         }
     }
 
@@ -0,0 +1,172 @@
+#include "WorkgroupTuner.h"
+#include "AtomicSave.h"
+#include "DeviceKey.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+WorkgroupTuner::WorkgroupTuner(vsg::ref_ptr<vsg::Device> in_device, vsg::ref_ptr<vsg::Queue> in_queue, const vsg::Path& in_cacheFilename) :
+    device(in_device),
+    queue(in_queue),
+    cacheFilename(in_cacheFilename)
+{
+    auto physicalDevice = device->getPhysicalDevice();
+    const auto& properties = physicalDevice->getProperties();
+
+    _deviceKey = experimental::deviceKey(*device->getInstance(), *physicalDevice);
+
+    auto& queueFamilyProperties = physicalDevice->getQueueFamilyProperties();
+    auto queueFamilyIndex = queue->queueFamilyIndex();
+    if (queueFamilyIndex < queueFamilyProperties.size() && queueFamilyProperties[queueFamilyIndex].timestampValidBits > 0)
+    {
+        _timestampPeriod = static_cast<double>(properties.limits.timestampPeriod);
+    }
+    else
+    {
+        vsg::warn("WorkgroupTuner timestamps not supported by the queue, timing submissions on the CPU.");
+    }
+
+    _compileTraversal = vsg::CompileTraversal::create();
+    _compileTraversal->queueFlags = VK_QUEUE_COMPUTE_BIT;
+    _compileTraversal->add(device);
+
+    if (cacheFilename) _readCache();
+}
+
+std::vector<uint32_t> WorkgroupTuner::squareCandidates(const std::vector<uint32_t>& sizes) const
+{
+    const auto& limits = device->getPhysicalDevice()->getProperties().limits;
+
+    std::vector<uint32_t> candidates;
+    for (auto size : sizes)
+    {
+        if (size == 0 || size > limits.maxComputeWorkGroupSize[0] || size > limits.maxComputeWorkGroupSize[1] || size * size > limits.maxComputeWorkGroupInvocations) continue;
+        candidates.push_back(size);
+    }
+    return candidates;
+}
+
+double WorkgroupTuner::_time(vsg::ref_ptr<vsg::Node> dispatch)
+{
+    auto queryPool = vsg::QueryPool::create();
+    queryPool->queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPool->queryCount = 2;
+
+    auto commands = vsg::Commands::create();
+    commands->addChild(vsg::ResetQueryPool::create(queryPool));
+    commands->addChild(vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0));
+    commands->addChild(dispatch);
+    commands->addChild(vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1));
+
+    auto context = _compileTraversal->contexts.front();
+    commands->accept(*_compileTraversal);
+    context->record();
+    context->waitForCompletion();
+
+    std::vector<double> times;
+    for (uint32_t i = 0; i < warmupIterations + numIterations; ++i)
+    {
+        auto fence = vsg::Fence::create(device);
+        auto startTime = vsg::clock::now();
+
+        vsg::submitCommandsToQueue(context->commandPool, fence, 100000000000, queue, [&](vsg::CommandBuffer& commandBuffer) {
+            commands->record(commandBuffer);
+        });
+
+        double cpuTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+        if (i < warmupIterations) continue;
+
+        std::vector<uint64_t> timestamps(2);
+        if (_timestampPeriod > 0.0 && queryPool->getResults(timestamps) == VK_SUCCESS)
+        {
+            times.push_back(_timestampPeriod * 1e-6 * static_cast<double>(timestamps[1] - timestamps[0]));
+        }
+        else
+        {
+            times.push_back(cpuTime);
+        }
+    }
+
+    if (times.empty()) return 0.0;
+
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+uint32_t WorkgroupTuner::select(const std::string& kernel, const std::vector<uint32_t>& candidates, const CreateDispatch& createDispatch)
+{
+    auto key = _deviceKey + " " + kernel;
+
+    if (auto itr = _cache.find(key); itr != _cache.end() && !retune)
+    {
+        auto& result = results[kernel];
+        result.workgroupSize = itr->second.first;
+        result.time = itr->second.second;
+        result.cached = true;
+        return result.workgroupSize;
+    }
+
+    Result result;
+    for (auto candidate : candidates)
+    {
+        auto dispatch = createDispatch(candidate);
+        if (!dispatch) continue;
+
+        double time = _time(dispatch);
+        result.candidateTimes[candidate] = time;
+        if (result.workgroupSize == 0 || time < result.time)
+        {
+            result.workgroupSize = candidate;
+            result.time = time;
+        }
+    }
+
+    results[kernel] = result;
+    if (result.workgroupSize == 0) return 0;
+
+    _cache[key] = {result.workgroupSize, result.time};
+    if (cacheFilename) _writeCache();
+
+    return result.workgroupSize;
+}
+
+void WorkgroupTuner::_readCache()
+{
+    std::ifstream fin(cacheFilename.string());
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        // deviceKey kernel workgroupSize time
+        std::istringstream str(line);
+        std::string deviceKey, kernel;
+        uint32_t workgroupSize = 0;
+        double time = 0.0;
+        if (str >> deviceKey >> kernel >> workgroupSize >> time) _cache[deviceKey + " " + kernel] = {workgroupSize, time};
+    }
+}
+
+void WorkgroupTuner::_writeCache() const
+{
+    // write through a temporary file so a concurrent or interrupted run never sees a partial cache
+    experimental::atomicSave(cacheFilename, [&](const vsg::Path& temporaryFilename) {
+        std::ofstream fout(temporaryFilename.string());
+        for (auto& [key, value] : _cache) fout << key << " " << value.first << " " << value.second << std::endl;
+        fout.close();
+        return !fout.fail();
+    });
+}
+
+void WorkgroupTuner::report(std::ostream& out) const
+{
+    out << "WorkgroupTuner device = " << _deviceKey << ", timing = " << (_timestampPeriod > 0.0 ? "timestamps" : "cpu") << std::endl;
+    for (auto& [kernel, result] : results)
+    {
+        out << "    " << kernel << " workgroup size = " << result.workgroupSize << ", " << result.time << "ms" << (result.cached ? " (cached)" : "") << std::endl;
+        for (auto& [candidate, time] : result.candidateTimes)
+        {
+            out << "        " << candidate << " : " << time << "ms" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <functional>
+#include <map>
+#include <ostream>
+
+// Chooses the workgroup size specialization constant of compute kernels by timing each candidate size on the device.
+// Each candidate's dispatch is run warmupIterations times then timed over numIterations with timestamp queries, the
+// candidate with the lowest median time winning. Winners are kept in cacheFilename keyed by the device's UUID and
+// driver version, so each kernel is only benchmarked on the first run on a device and retuned after a driver update.
+// The kernel name passed to select(), which mustn't contain whitespace, should include anything else that changes the
+// best size, such as the problem size.
+class WorkgroupTuner : public vsg::Inherit<vsg::Object, WorkgroupTuner>
+{
+public:
+    WorkgroupTuner(vsg::ref_ptr<vsg::Device> in_device, vsg::ref_ptr<vsg::Queue> in_queue, const vsg::Path& in_cacheFilename = {});
+
+    vsg::ref_ptr<vsg::Device> device;
+    vsg::ref_ptr<vsg::Queue> queue;
+    vsg::Path cacheFilename;
+
+    uint32_t warmupIterations = 2;
+    uint32_t numIterations = 5;
+    bool retune = false; // ignore results already in the cache
+
+    // identifies the device and driver in the cache
+    std::string deviceKey() const { return _deviceKey; }
+
+    // the square 2D workgroup sizes of sizes that are within the device's workgroup limits
+    std::vector<uint32_t> squareCandidates(const std::vector<uint32_t>& sizes = {4, 8, 16, 32}) const;
+
+    // returns the commands that bind and dispatch the kernel compiled with the given workgroup size
+    using CreateDispatch = std::function<vsg::ref_ptr<vsg::Node>(uint32_t workgroupSize)>;
+
+    // return the cached workgroup size for kernel, or benchmark candidates and cache the fastest, returns 0 if none could be timed
+    uint32_t select(const std::string& kernel, const std::vector<uint32_t>& candidates, const CreateDispatch& createDispatch);
+
+    struct Result
+    {
+        uint32_t workgroupSize = 0;
+        double time = 0.0;                          // milliseconds, median of the timed iterations
+        std::map<uint32_t, double> candidateTimes;  // only filled in when benchmarked by this run
+        bool cached = false;
+    };
+
+    std::map<std::string, Result> results;
+
+    void report(std::ostream& out) const;
+
+protected:
+    double _time(vsg::ref_ptr<vsg::Node> dispatch);
+    void _readCache();
+    void _writeCache() const;
+
+    std::string _deviceKey;
+    double _timestampPeriod = 0.0; // nanoseconds, 0 when timestamps aren't supported and CPU timing is used
+    vsg::ref_ptr<vsg::CompileTraversal> _compileTraversal;
+
+    // cached entries for all devices, so writing the cache keeps those from other devices
+    std::map<std::string, std::pair<uint32_t, double>> _cache;
+};
@@ -2,6 +2,9 @@
 
 #include <chrono>
 #include <iostream>
+#include <sstream>
+
+#include "WorkgroupTuner.h"
 
 int main(int argc, char** argv)
 {
@@ -10,7 +13,11 @@ int main(int argc, char** argv)
     auto height = arguments.value(1024, "--height");
     auto debugLayer = arguments.read({"--debug", "-d"});
     auto apiDumpLayer = arguments.read({"--api", "-a"});
-    auto workgroupSize = arguments.value(32, "-w");
+    int workgroupSize = 0;
+    bool fixedWorkgroupSize = arguments.read("-w", workgroupSize);
+    auto tuningCache = arguments.value<vsg::Path>("vsgcompute_workgroups.txt", "--tuning-cache");
+    auto retune = arguments.read("--retune");
+    auto tuningReport = arguments.read("--tuning-report");
     auto outputFilename = arguments.value<std::string>("", "-o");
     auto outputAsFloat = arguments.read("-f");
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
@@ -33,15 +40,11 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    computeStage->specializationConstants = vsg::ShaderStage::SpecializationConstants{
-        {0, vsg::intValue::create(width)},
-        {1, vsg::intValue::create(height)},
-        {2, vsg::intValue::create(workgroupSize)}};
-
     vsg::Names validatedNames = vsg::validateInstancelayerNames(requestedLayers);
 
     // get the physical device that supports the required compute queue
-    auto instance = vsg::Instance::create(instanceExtensions, validatedNames);
+    // Vulkan 1.1 so the WorkgroupTuner can identify the device by its UUID
+    auto instance = vsg::Instance::create(instanceExtensions, validatedNames, VK_API_VERSION_1_1);
     auto [physicalDevice, computeQueueFamily] = instance->getPhysicalDeviceAndQueueFamily(VK_QUEUE_COMPUTE_BIT);
     if (!physicalDevice || computeQueueFamily < 0)
     {
@@ -72,15 +75,47 @@ int main(int argc, char** argv)
     auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, vsg::PushConstantRanges{});
     auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, descriptorSet);
 
-    // set up the compute pipeline
-    auto pipeline = vsg::ComputePipeline::create(pipelineLayout, computeStage);
-    auto bindPipeline = vsg::BindComputePipeline::create(pipeline);
+    // create the commands that bind the Pipeline, with the workgroup size passed as a specialization constant, and DescritorSets and calls Dispatch
+    auto createDispatch = [&](uint32_t size) -> vsg::ref_ptr<vsg::Node> {
+        // each workgroup size needs its own ShaderStage for its specialization constants, sharing the ShaderModule
+        auto stage = vsg::ShaderStage::create(VK_SHADER_STAGE_COMPUTE_BIT, "main", computeStage->module);
+        stage->specializationConstants = vsg::ShaderStage::SpecializationConstants{
+            {0, vsg::intValue::create(width)},
+            {1, vsg::intValue::create(height)},
+            {2, vsg::intValue::create(static_cast<int>(size))}};
+
+        // set up the compute pipeline
+        auto pipeline = vsg::ComputePipeline::create(pipelineLayout, stage);
+        auto bindPipeline = vsg::BindComputePipeline::create(pipeline);
+
+        auto commands = vsg::Commands::create();
+        commands->addChild(bindPipeline);
+        commands->addChild(bindDescriptorSet);
+        commands->addChild(vsg::Dispatch::create(uint32_t(ceil(float(width) / float(size))), uint32_t(ceil(float(height) / float(size))), 1));
+        return commands;
+    };
+
+    // without -w benchmark the workgroup sizes the device supports on the first run, reusing the fastest on later runs
+    vsg::ref_ptr<WorkgroupTuner> tuner;
+    if (!fixedWorkgroupSize)
+    {
+        tuner = WorkgroupTuner::create(device, computeQueue, tuningCache);
+        tuner->retune = retune;
+
+        std::ostringstream kernel;
+        kernel << "shaders/comp.spv:" << width << "x" << height;
+        workgroupSize = static_cast<int>(tuner->select(kernel.str(), tuner->squareCandidates(), createDispatch));
+        if (workgroupSize == 0)
+        {
+            std::cout << "Unable to time workgroup sizes, using 32." << std::endl;
+            workgroupSize = 32;
+        }
+
+        if (tuningReport) tuner->report(std::cout);
+    }
 
     // assign to a CommandGraph that binds the Pipeline and DescritorSets and calls Dispatch
-    auto commandGraph = vsg::Commands::create();
-    commandGraph->addChild(bindPipeline);
-    commandGraph->addChild(bindDescriptorSet);
-    commandGraph->addChild(vsg::Dispatch::create(uint32_t(ceil(float(width) / float(workgroupSize))), uint32_t(ceil(float(height) / float(workgroupSize))), 1));
+    auto commandGraph = createDispatch(static_cast<uint32_t>(workgroupSize));
 
     // compile the Vulkan objects
     auto compileTraversal = vsg::CompileTraversal::create();
@@ -101,7 +136,7 @@ int main(int argc, char** argv)
     });
 
     auto time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - startTime).count();
-    std::cout << "Time to run commands " << time << "ms" << std::endl;
+    std::cout << "Time to run commands " << time << "ms, workgroup size " << workgroupSize << std::endl;
 
     if (!outputFilename.empty())
     {
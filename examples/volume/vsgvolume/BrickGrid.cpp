@@ -0,0 +1,145 @@
+#include "BrickGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+BrickGrid::BrickGrid(uint32_t in_brickSize, bool in_sparse) :
+    brickSize(std::max(in_brickSize, 2u)),
+    sparse(in_sparse)
+{
+    settings = vsg::vec4Array::create(4);
+}
+
+bool BrickGrid::build(vsg::ref_ptr<vsg::Data> volume)
+{
+    if (auto floatVolume = volume.cast<vsg::floatArray3D>()) return buildFrom(*floatVolume);
+    if (auto ubyteVolume = volume.cast<vsg::ubyteArray3D>()) return buildFrom(*ubyteVolume);
+    if (auto ushortVolume = volume.cast<vsg::ushortArray3D>()) return buildFrom(*ushortVolume);
+
+    vsg::warn("BrickGrid::build(", volume, ") unsupported volume data type.");
+    return false;
+}
+
+template<class A>
+bool BrickGrid::buildFrom(const A& volume)
+{
+    using value_type = typename A::value_type;
+
+    // integer volumes are sampled as normalized values so compare against the normalized value too
+    const float scale = std::numeric_limits<value_type>::is_integer ? 1.0f / static_cast<float>(std::numeric_limits<value_type>::max()) : 1.0f;
+
+    volumeSize.set(volume.width(), volume.height(), volume.depth());
+    if (volumeSize.x == 0 || volumeSize.y == 0 || volumeSize.z == 0) return false;
+
+    numBricks.set((volumeSize.x + brickSize - 1) / brickSize, (volumeSize.y + brickSize - 1) / brickSize, (volumeSize.z + brickSize - 1) / brickSize);
+
+    minMax = vsg::vec2Array3D::create(numBricks.x, numBricks.y, numBricks.z);
+    minMax->properties.format = VK_FORMAT_R32G32_SFLOAT;
+
+    auto clampedValue = [&](int64_t c, int64_t r, int64_t d) {
+        c = std::clamp<int64_t>(c, 0, volumeSize.x - 1);
+        r = std::clamp<int64_t>(r, 0, volumeSize.y - 1);
+        d = std::clamp<int64_t>(d, 0, volumeSize.z - 1);
+        return volume.at(static_cast<size_t>(c), static_cast<size_t>(r), static_cast<size_t>(d));
+    };
+
+    numOccupied = 0;
+    for (uint32_t bz = 0; bz < numBricks.z; ++bz)
+    {
+        for (uint32_t by = 0; by < numBricks.y; ++by)
+        {
+            for (uint32_t bx = 0; bx < numBricks.x; ++bx)
+            {
+                // include the one voxel border that filtering at the brick's faces reads
+                float minValue = std::numeric_limits<float>::max();
+                float maxValue = std::numeric_limits<float>::lowest();
+                for (int64_t d = int64_t(bz * brickSize) - 1; d <= int64_t((bz + 1) * brickSize); ++d)
+                {
+                    for (int64_t r = int64_t(by * brickSize) - 1; r <= int64_t((by + 1) * brickSize); ++r)
+                    {
+                        for (int64_t c = int64_t(bx * brickSize) - 1; c <= int64_t((bx + 1) * brickSize); ++c)
+                        {
+                            float v = static_cast<float>(clampedValue(c, r, d)) * scale;
+                            minValue = std::min(minValue, v);
+                            maxValue = std::max(maxValue, v);
+                        }
+                    }
+                }
+
+                minMax->set(bx, by, bz, vsg::vec2(minValue, maxValue));
+                if (maxValue > emptyThreshold) ++numOccupied;
+            }
+        }
+    }
+
+    if (sparse)
+    {
+        // pack the occupied bricks into a roughly cubic atlas, at least one brick so the atlas is never empty
+        uint32_t perAxis = std::max(1u, static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(std::max<size_t>(numOccupied, 1))))));
+        atlasBricks.set(perAxis, perAxis, (static_cast<uint32_t>(std::max<size_t>(numOccupied, 1)) + perAxis * perAxis - 1) / (perAxis * perAxis));
+
+        if (std::max({atlasBricks.x, atlasBricks.y, atlasBricks.z}) > 256)
+        {
+            vsg::warn("BrickGrid::build() too many occupied bricks for the 8 bit indirection grid, increase the brick size.");
+            return false;
+        }
+
+        const uint32_t stride = brickSize + 2;
+        auto packed = A::create(atlasBricks.x * stride, atlasBricks.y * stride, atlasBricks.z * stride);
+        packed->properties.format = volume.properties.format;
+
+        indirection = vsg::ubvec4Array3D::create(numBricks.x, numBricks.y, numBricks.z);
+        indirection->properties.format = VK_FORMAT_R8G8B8A8_UINT;
+
+        uint32_t slot = 0;
+        for (uint32_t bz = 0; bz < numBricks.z; ++bz)
+        {
+            for (uint32_t by = 0; by < numBricks.y; ++by)
+            {
+                for (uint32_t bx = 0; bx < numBricks.x; ++bx)
+                {
+                    if (minMax->at(bx, by, bz).y <= emptyThreshold)
+                    {
+                        indirection->set(bx, by, bz, vsg::ubvec4(0, 0, 0, 0));
+                        continue;
+                    }
+
+                    uint32_t ax = slot % atlasBricks.x;
+                    uint32_t ay = (slot / atlasBricks.x) % atlasBricks.y;
+                    uint32_t az = slot / (atlasBricks.x * atlasBricks.y);
+                    ++slot;
+
+                    indirection->set(bx, by, bz, vsg::ubvec4(static_cast<uint8_t>(ax), static_cast<uint8_t>(ay), static_cast<uint8_t>(az), 1));
+
+                    for (uint32_t d = 0; d < stride; ++d)
+                    {
+                        for (uint32_t r = 0; r < stride; ++r)
+                        {
+                            for (uint32_t c = 0; c < stride; ++c)
+                            {
+                                auto v = clampedValue(int64_t(bx * brickSize + c) - 1, int64_t(by * brickSize + r) - 1, int64_t(bz * brickSize + d) - 1);
+                                packed->set(ax * stride + c, ay * stride + r, az * stride + d, v);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        atlas = packed;
+    }
+
+    updateSettings();
+    return true;
+}
+
+void BrickGrid::updateSettings()
+{
+    auto& s = *settings;
+    s[0].set(static_cast<float>(volumeSize.x), static_cast<float>(volumeSize.y), static_cast<float>(volumeSize.z), 0.0f);
+    s[1].set(static_cast<float>(numBricks.x), static_cast<float>(numBricks.y), static_cast<float>(numBricks.z), static_cast<float>(brickSize));
+    s[2].set(static_cast<float>(atlasBricks.x * (brickSize + 2)), static_cast<float>(atlasBricks.y * (brickSize + 2)), static_cast<float>(atlasBricks.z * (brickSize + 2)), 0.0f);
+    s[3].set(emptyThreshold, maxStepScale, homogeneousRange, opacityThreshold);
+    settings->dirty();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// Low resolution acceleration structure for ray marching a single channel volume, built once when the volume is loaded.
+// The volume is divided into bricks of brickSize voxels along each edge and the minimum and maximum value of each brick,
+// including the neighbouring voxels that trilinear filtering reads, is stored in the minMax grid. The ray march skips
+// whole bricks whose maximum is at or below emptyThreshold and takes longer steps through bricks with little variation.
+//
+// With sparse the occupied bricks are also copied, with a one voxel border, into a packed atlas and the indirection grid
+// gives each brick's position in the atlas, w being 0 for empty bricks that aren't stored, so only the occupied part
+// of the volume has to fit in GPU memory.
+class BrickGrid : public vsg::Inherit<vsg::Object, BrickGrid>
+{
+public:
+    explicit BrickGrid(uint32_t in_brickSize = 16, bool in_sparse = false);
+
+    const uint32_t brickSize;
+    const bool sparse;
+
+    // normalized value at or below which voxels are transparent, matches AlphaFuncValue / TransparencyValue in volume.frag
+    float emptyThreshold = 0.5f;
+
+    // build the grids from a floatArray3D, ubyteArray3D or ushortArray3D, returns false for other types of data
+    bool build(vsg::ref_ptr<vsg::Data> volume);
+
+    vsg::uivec3 volumeSize;
+    vsg::uivec3 numBricks;
+    size_t numOccupied = 0;
+
+    vsg::ref_ptr<vsg::vec2Array3D> minMax;
+
+    // only set when sparse
+    vsg::ref_ptr<vsg::Data> atlas;
+    vsg::ref_ptr<vsg::ubvec4Array3D> indirection;
+    vsg::uivec3 atlasBricks;
+
+    // uniform block read by volume.frag, brick parameters then ray march settings
+    vsg::ref_ptr<vsg::vec4Array> settings;
+
+    float maxStepScale = 4.0f;      // longest step through homogeneous bricks, in multiples of the base step
+    float homogeneousRange = 0.05f; // bricks with max - min below this are homogeneous
+    float opacityThreshold = 0.95f; // rays stop once their opacity reaches this
+
+    void updateSettings();
+
+protected:
+    template<class A>
+    bool buildFrom(const A& volume);
+};
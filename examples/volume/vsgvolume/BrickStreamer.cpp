@@ -0,0 +1,394 @@
+#include "BrickStreamer.h"
+#include "ParallelTraversal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+
+BrickStreamer::BrickStreamer(vsg::ref_ptr<BrickedVolume> in_volume, VkDeviceSize in_cacheSize, vsg::ref_ptr<vsg::OperationThreads> in_operationThreads) :
+    volume(in_volume),
+    operationThreads(in_operationThreads),
+    _cacheSize(in_cacheSize)
+{
+}
+
+void BrickStreamer::splitKey(uint64_t key, uint32_t& level, uint32_t& x, uint32_t& y, uint32_t& z)
+{
+    level = static_cast<uint32_t>(key >> 60);
+    z = static_cast<uint32_t>((key >> 40) & 0xfffff);
+    y = static_cast<uint32_t>((key >> 20) & 0xfffff);
+    x = static_cast<uint32_t>(key & 0xfffff);
+}
+
+const BrickedVolume::IndexEntry& BrickStreamer::entry(uint64_t key) const
+{
+    uint32_t level, x, y, z;
+    splitKey(key, level, x, y, z);
+    return volume->entry(level, x, y, z);
+}
+
+void BrickStreamer::setup()
+{
+    const uint32_t stride = volume->brickSize() + 2;
+    const uint32_t coarsest = volume->numLevels() - 1;
+
+    // the coarsest level is always resident so the cache must at least hold it
+    std::vector<uint64_t> pinned;
+    auto coarsestBricks = volume->levelBricks(coarsest);
+    for (uint32_t z = 0; z < coarsestBricks.z; ++z)
+        for (uint32_t y = 0; y < coarsestBricks.y; ++y)
+            for (uint32_t x = 0; x < coarsestBricks.x; ++x)
+                if (volume->entry(coarsest, x, y, z).offset != 0) pinned.push_back(makeKey(coarsest, x, y, z));
+
+    // keep the atlas within the 2048 texel 3D image dimensions all devices support
+    uint32_t maxSlotsPerAxis = std::min(2048u / stride, 255u);
+    uint64_t maxSlots = uint64_t(maxSlotsPerAxis) * maxSlotsPerAxis * maxSlotsPerAxis;
+    uint64_t requestedSlots = std::max<uint64_t>(_cacheSize / volume->brickBytes(), pinned.size() + 8);
+    if (requestedSlots > maxSlots)
+    {
+        vsg::warn("BrickStreamer cache limited to ", maxSlots, " bricks by the maximum atlas size.");
+        requestedSlots = maxSlots;
+    }
+
+    uint32_t perAxis = std::min(maxSlotsPerAxis, static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(requestedSlots)))));
+    _atlasSlots.set(perAxis, perAxis, static_cast<uint32_t>((requestedSlots + uint64_t(perAxis) * perAxis - 1) / (uint64_t(perAxis) * perAxis)));
+
+    _slots.assign(size_t(_atlasSlots.x) * _atlasSlots.y * _atlasSlots.z, Slot{});
+    _freeSlots.clear();
+    for (uint32_t s = static_cast<uint32_t>(_slots.size()); s > 0; --s) _freeSlots.push_back(s - 1);
+
+    auto image = vsg::Image::create();
+    image->imageType = VK_IMAGE_TYPE_3D;
+    image->extent = VkExtent3D{_atlasSlots.x * stride, _atlasSlots.y * stride, _atlasSlots.z * stride};
+    image->mipLevels = 1;
+    image->arrayLayers = 1;
+    image->samples = VK_SAMPLE_COUNT_1_BIT;
+    image->format = volume->format();
+    image->tiling = VK_IMAGE_TILING_OPTIMAL;
+    image->usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image->flags = 0;
+    image->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    auto imageView = vsg::ImageView::create(image, VK_IMAGE_ASPECT_COLOR_BIT);
+    imageView->viewType = VK_IMAGE_VIEW_TYPE_3D;
+
+    auto sampler = vsg::Sampler::create();
+    sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    _atlas = vsg::ImageInfo::create(sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // the atlas is only partially written each frame, so transition it out of the undefined layout before the first copies
+    _layoutSwitch = vsg::Switch::create();
+    _layoutSwitch->addChild(true, vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                                                              vsg::ImageMemoryBarrier::create(0, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                                                              VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1})));
+
+    auto bricks = volume->levelBricks(0);
+    _pageTable = vsg::ubvec4Array3D::create(bricks.x, bricks.y, bricks.z, vsg::ubvec4(0, 0, 0, 0));
+    _pageTable->properties.format = VK_FORMAT_R8G8B8A8_UINT;
+    _pageTable->properties.dataVariance = vsg::DYNAMIC_DATA;
+
+    _minMax = vsg::vec2Array3D::create(bricks.x, bricks.y, bricks.z);
+    _minMax->properties.format = VK_FORMAT_R32G32_SFLOAT;
+    for (uint32_t z = 0; z < bricks.z; ++z)
+        for (uint32_t y = 0; y < bricks.y; ++y)
+            for (uint32_t x = 0; x < bricks.x; ++x)
+            {
+                auto& e = volume->entry(0, x, y, z);
+                _minMax->set(x, y, z, vsg::vec2(e.minValue, e.maxValue));
+            }
+
+    auto size = volume->levelSize(0);
+    _settings = vsg::vec4Array::create(4);
+    _settings->at(0).set(static_cast<float>(size.x), static_cast<float>(size.y), static_cast<float>(size.z), 0.0f);
+    _settings->at(1).set(static_cast<float>(bricks.x), static_cast<float>(bricks.y), static_cast<float>(bricks.z), static_cast<float>(volume->brickSize()));
+    _settings->at(2).set(static_cast<float>(image->extent.width), static_cast<float>(image->extent.height), static_cast<float>(image->extent.depth), 0.0f);
+    _settings->at(3).set(volume->header().emptyThreshold, maxStepScale, homogeneousRange, opacityThreshold);
+
+    // read the pinned bricks now, they're all uploaded by the first update()
+    for (auto key : pinned)
+    {
+        auto data = volume->brickData(entry(key));
+        _loaded.push_back(Loaded{key, std::vector<uint8_t>(data, data + volume->brickBytes())});
+        _pending.insert(key);
+    }
+    _numPinned = pinned.size();
+}
+
+vsg::ref_ptr<vsg::Node> BrickStreamer::createCommands(uint32_t numFrames)
+{
+    _stagingRing = StagingRing::create(std::max<VkDeviceSize>(maxUploadsPerFrame, _numPinned) * volume->brickBytes(), numFrames);
+
+    auto commands = vsg::Group::create();
+    commands->addChild(_layoutSwitch);
+    commands->addChild(_stagingRing);
+    return commands;
+}
+
+vsg::Descriptors BrickStreamer::descriptors() const
+{
+    // the page table and min/max grid are read per brick so must not be filtered
+    auto nearest_sampler = vsg::Sampler::create();
+    nearest_sampler->magFilter = VK_FILTER_NEAREST;
+    nearest_sampler->minFilter = VK_FILTER_NEAREST;
+    nearest_sampler->mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    nearest_sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    nearest_sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    nearest_sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    return vsg::Descriptors{
+        vsg::DescriptorImage::create(_atlas, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+        vsg::DescriptorBuffer::create(_settings, 1, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER),
+        vsg::DescriptorImage::create(nearest_sampler, _minMax, 2, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+        vsg::DescriptorImage::create(nearest_sampler, _pageTable, 3, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)};
+}
+
+bool BrickStreamer::assignSlot(uint64_t key, uint32_t& slot)
+{
+    if (!_freeSlots.empty())
+    {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+    }
+    else
+    {
+        // evict the least recently used brick that isn't pinned or selected this frame
+        uint32_t victim = 0;
+        uint64_t oldest = _frameCount;
+        for (uint32_t s = 0; s < _slots.size(); ++s)
+        {
+            auto& candidate = _slots[s];
+            if (!candidate.pinned && candidate.lastUsed < oldest)
+            {
+                victim = s;
+                oldest = candidate.lastUsed;
+            }
+        }
+        if (oldest == _frameCount) return false;
+
+        _resident.erase(_slots[victim].key);
+        _changed.push_back(_slots[victim].key);
+        ++_stats.bricksEvicted;
+        slot = victim;
+    }
+
+    uint32_t level, x, y, z;
+    splitKey(key, level, x, y, z);
+
+    auto& s = _slots[slot];
+    s.key = key;
+    s.lastUsed = _frameCount;
+    s.pinned = (level == volume->numLevels() - 1);
+    return true;
+}
+
+bool BrickStreamer::upload(uint64_t key, const uint8_t* data)
+{
+    auto brickBytes = volume->brickBytes();
+    auto allocation = _stagingRing->allocate(brickBytes);
+    if (!allocation) return false;
+
+    uint32_t slot = 0;
+    if (!assignSlot(key, slot))
+    {
+        ++_stats.bricksDropped;
+        return true;
+    }
+
+    std::memcpy(allocation.ptr, data, brickBytes);
+
+    const uint32_t stride = volume->brickSize() + 2;
+    uint32_t sx = slot % _atlasSlots.x;
+    uint32_t sy = (slot / _atlasSlots.x) % _atlasSlots.y;
+    uint32_t sz = slot / (_atlasSlots.x * _atlasSlots.y);
+    _stagingRing->copy(allocation, _atlas, VkOffset3D{int32_t(sx * stride), int32_t(sy * stride), int32_t(sz * stride)}, VkExtent3D{stride, stride, stride});
+
+    _resident[key] = slot;
+    _changed.push_back(key);
+    ++_stats.bricksUploaded;
+    return true;
+}
+
+void BrickStreamer::updatePageTable(uint64_t key)
+{
+    uint32_t level, x, y, z;
+    splitKey(key, level, x, y, z);
+
+    // the level 0 bricks covered by the changed brick
+    auto bricks = volume->levelBricks(0);
+    uint32_t begin[3] = {x << level, y << level, z << level};
+    uint32_t end[3] = {std::min((x + 1) << level, bricks.x), std::min((y + 1) << level, bricks.y), std::min((z + 1) << level, bricks.z)};
+
+    for (uint32_t bz = begin[2]; bz < end[2]; ++bz)
+    {
+        for (uint32_t by = begin[1]; by < end[1]; ++by)
+        {
+            for (uint32_t bx = begin[0]; bx < end[0]; ++bx)
+            {
+                vsg::ubvec4 value(0, 0, 0, 0);
+                if (volume->entry(0, bx, by, bz).offset != 0)
+                {
+                    // the finest resident brick covering this one
+                    for (uint32_t l = 0; l < volume->numLevels(); ++l)
+                    {
+                        auto itr = _resident.find(makeKey(l, bx >> l, by >> l, bz >> l));
+                        if (itr == _resident.end()) continue;
+
+                        uint32_t slot = itr->second;
+                        value.set(static_cast<uint8_t>(slot % _atlasSlots.x), static_cast<uint8_t>((slot / _atlasSlots.x) % _atlasSlots.y), static_cast<uint8_t>(slot / (_atlasSlots.x * _atlasSlots.y)), static_cast<uint8_t>(l + 1));
+                        break;
+                    }
+                }
+                _pageTable->set(bx, by, bz, value);
+            }
+        }
+    }
+}
+
+void BrickStreamer::update(vsg::ref_ptr<vsg::Fence> fence, const vsg::dvec3& eye, double pixelScale)
+{
+    ++_frameCount;
+    _stagingRing->beginFrame(fence);
+
+    // the layout transition has been recorded by the first frame
+    if (_frameCount == 2) _layoutSwitch->setAllChildren(false);
+
+    auto size0 = volume->levelSize(0);
+    const double brickSize = volume->brickSize();
+    const uint32_t coarsest = volume->numLevels() - 1;
+
+    // screen space size of the brick's voxels, from the nearest point of the brick
+    auto projectedError = [&](uint32_t level, uint32_t x, uint32_t y, uint32_t z) {
+        double levelScale = double(1u << level);
+        vsg::dvec3 voxel(levelScale / size0.x, levelScale / size0.y, levelScale / size0.z);
+        vsg::dvec3 brickMin(x * brickSize * voxel.x, y * brickSize * voxel.y, z * brickSize * voxel.z);
+        vsg::dvec3 brickMax(std::min(brickMin.x + brickSize * voxel.x, 1.0), std::min(brickMin.y + brickSize * voxel.y, 1.0), std::min(brickMin.z + brickSize * voxel.z, 1.0));
+        vsg::dvec3 nearest(std::clamp(eye.x, brickMin.x, brickMax.x), std::clamp(eye.y, brickMin.y, brickMax.y), std::clamp(eye.z, brickMin.z, brickMax.z));
+        double distance = std::max(vsg::length(eye - nearest), 1e-6);
+        return std::max({voxel.x, voxel.y, voxel.z}) * pixelScale / distance;
+    };
+
+    // select the bricks to draw, refining the bricks with the largest error first while the selection fits in the cache
+    struct Candidate
+    {
+        double error;
+        uint64_t key;
+        bool operator<(const Candidate& rhs) const { return error < rhs.error; }
+    };
+
+    std::priority_queue<Candidate> candidates;
+    auto coarsestBricks = volume->levelBricks(coarsest);
+    for (uint32_t z = 0; z < coarsestBricks.z; ++z)
+        for (uint32_t y = 0; y < coarsestBricks.y; ++y)
+            for (uint32_t x = 0; x < coarsestBricks.x; ++x)
+                if (volume->entry(coarsest, x, y, z).offset != 0) candidates.push(Candidate{projectedError(coarsest, x, y, z), makeKey(coarsest, x, y, z)});
+
+    _wanted.clear();
+    std::vector<Candidate> requests;
+    size_t budget = _slots.size();
+    while (!candidates.empty())
+    {
+        auto candidate = candidates.top();
+        candidates.pop();
+
+        _wanted.insert(candidate.key);
+        if (auto itr = _resident.find(candidate.key); itr != _resident.end())
+            _slots[itr->second].lastUsed = _frameCount;
+        else if (_pending.count(candidate.key) == 0)
+            requests.push_back(candidate);
+
+        uint32_t level, x, y, z;
+        splitKey(candidate.key, level, x, y, z);
+        if (level == 0 || candidate.error <= lodScale) continue;
+
+        auto childBricks = volume->levelBricks(level - 1);
+        std::vector<Candidate> children;
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            uint32_t cx = x * 2 + (i & 1), cy = y * 2 + ((i >> 1) & 1), cz = z * 2 + ((i >> 2) & 1);
+            if (cx >= childBricks.x || cy >= childBricks.y || cz >= childBricks.z) continue;
+            if (volume->entry(level - 1, cx, cy, cz).offset == 0) continue;
+            children.push_back(Candidate{projectedError(level - 1, cx, cy, cz), makeKey(level - 1, cx, cy, cz)});
+        }
+
+        if (_wanted.size() + candidates.size() + children.size() > budget) continue;
+        for (auto& child : children) candidates.push(child);
+    }
+    _stats.bricksSelected = _wanted.size();
+
+    // upload the bricks loaded since the last frame, keeping those that don't fit this frame for the next
+    std::vector<Loaded> loaded;
+    {
+        std::scoped_lock<std::mutex> lock(_loadedMutex);
+        loaded.swap(_loaded);
+    }
+
+    std::vector<Loaded> deferred;
+    uint32_t numUploads = 0;
+    for (auto& brick : loaded)
+    {
+        uint32_t level, x, y, z;
+        splitKey(brick.key, level, x, y, z);
+        bool pinned = (level == coarsest);
+
+        if (!pinned && (_wanted.count(brick.key) == 0 || _resident.count(brick.key) != 0))
+        {
+            _pending.erase(brick.key);
+            ++_stats.bricksDropped;
+            continue;
+        }
+
+        if ((!pinned && numUploads >= maxUploadsPerFrame) || !upload(brick.key, brick.data.data()))
+        {
+            deferred.push_back(std::move(brick));
+            continue;
+        }
+
+        _pending.erase(brick.key);
+        ++numUploads;
+    }
+
+    if (!deferred.empty())
+    {
+        std::scoped_lock<std::mutex> lock(_loadedMutex);
+        for (auto& brick : deferred) _loaded.push_back(std::move(brick));
+    }
+
+    // read the most needed missing bricks from the mapped file, paging them in on the loader threads
+    std::sort(requests.begin(), requests.end(), [](const Candidate& lhs, const Candidate& rhs) { return rhs < lhs; });
+    size_t maxRequests = operationThreads ? maxRequestsInFlight : maxUploadsPerFrame;
+    vsg::ref_ptr<BrickStreamer> self(this);
+    for (auto& request : requests)
+    {
+        if (_pending.size() >= maxRequests) break;
+
+        _pending.insert(request.key);
+        ++_stats.bricksRequested;
+
+        auto load = [self, key = request.key]() {
+            auto data = self->volume->brickData(self->entry(key));
+            Loaded brick{key, std::vector<uint8_t>(data, data + self->volume->brickBytes())};
+
+            std::scoped_lock<std::mutex> lock(self->_loadedMutex);
+            self->_loaded.push_back(std::move(brick));
+        };
+
+        if (operationThreads)
+            operationThreads->add(experimental::FunctionOperation::create(load));
+        else
+            load();
+    }
+
+    if (!_changed.empty())
+    {
+        for (auto key : _changed) updatePageTable(key);
+        _changed.clear();
+        _pageTable->dirty();
+    }
+
+    _stats.bricksResident = _resident.size();
+}
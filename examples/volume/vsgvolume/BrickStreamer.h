@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "BrickedVolume.h"
+#include "StagingRing.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+// Pages the bricks of a BrickedVolume through a fixed size GPU brick cache as the view changes. Each frame update()
+// selects the bricks to draw by refining from the coarsest level while a brick's voxels project larger than lodScale
+// pixels and the selection fits in the cache, then queues the missing bricks to be read from the mapped file on
+// operationThreads. Loaded bricks are copied into free or least recently used slots of the cache atlas through a
+// StagingRing, and the page table, one entry per level 0 brick, gives the atlas slot and level of the finest resident
+// brick covering it so volume.frag can sample through it. The coarsest level is loaded up front and never evicted so
+// there's always a brick to fall back to, and memory use is bounded by cacheSize on the GPU and by maxRequestsInFlight
+// bricks on the CPU.
+class BrickStreamer : public vsg::Inherit<vsg::Object, BrickStreamer>
+{
+public:
+    BrickStreamer(vsg::ref_ptr<BrickedVolume> in_volume, VkDeviceSize in_cacheSize, vsg::ref_ptr<vsg::OperationThreads> in_operationThreads = {});
+
+    const vsg::ref_ptr<BrickedVolume> volume;
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+
+    double lodScale = 1.0;
+    uint32_t maxUploadsPerFrame = 64;
+    uint32_t maxRequestsInFlight = 256;
+
+    // ray march settings written to settings[3], see BrickGrid
+    float maxStepScale = 4.0f;
+    float homogeneousRange = 0.05f;
+    float opacityThreshold = 0.95f;
+
+    // create the atlas and page table, and read the coarsest level
+    void setup();
+
+    // descriptors for volume.frag's bindings 0 to 3 when VSG_BRICK_GRID and VSG_SPARSE_BRICKS are defined, call after setup()
+    vsg::Descriptors descriptors() const;
+
+    // create the commands to place at the start of the command graph, before the render pass, with a staging region per frame in flight
+    vsg::ref_ptr<vsg::Node> createCommands(uint32_t numFrames);
+
+    // call each frame after advanceToNextFrame(), eye is in the volume's unit cube coordinates and pixelScale is the viewport
+    // height in pixels divided by 2 * tan(fovy / 2)
+    void update(vsg::ref_ptr<vsg::Fence> fence, const vsg::dvec3& eye, double pixelScale);
+
+    uint32_t numSlots() const { return static_cast<uint32_t>(_slots.size()); }
+
+    struct Stats
+    {
+        uint64_t bricksRequested = 0;
+        uint64_t bricksUploaded = 0;
+        uint64_t bricksEvicted = 0;
+        uint64_t bricksDropped = 0; // loaded but no longer wanted, or no slot could be freed
+        size_t bricksSelected = 0;  // in the last update()
+        size_t bricksResident = 0;
+    };
+
+    const Stats& stats() const { return _stats; }
+
+protected:
+    struct Slot
+    {
+        uint64_t key = ~0ull;
+        uint64_t lastUsed = 0;
+        bool pinned = false;
+    };
+
+    struct Loaded
+    {
+        uint64_t key;
+        std::vector<uint8_t> data;
+    };
+
+    static uint64_t makeKey(uint32_t level, uint32_t x, uint32_t y, uint32_t z) { return (uint64_t(level) << 60) | (uint64_t(z) << 40) | (uint64_t(y) << 20) | uint64_t(x); }
+    static void splitKey(uint64_t key, uint32_t& level, uint32_t& x, uint32_t& y, uint32_t& z);
+
+    const BrickedVolume::IndexEntry& entry(uint64_t key) const;
+
+    // returns false if the staging ring is full this frame
+    bool upload(uint64_t key, const uint8_t* data);
+    bool assignSlot(uint64_t key, uint32_t& slot);
+    void updatePageTable(uint64_t key);
+
+    VkDeviceSize _cacheSize;
+    size_t _numPinned = 0;
+    vsg::uivec3 _atlasSlots;
+    uint64_t _frameCount = 0;
+
+    std::vector<Slot> _slots;
+    std::vector<uint32_t> _freeSlots;
+    std::unordered_map<uint64_t, uint32_t> _resident;
+    std::unordered_set<uint64_t> _wanted;
+    std::unordered_set<uint64_t> _pending;
+
+    std::mutex _loadedMutex;
+    std::vector<Loaded> _loaded;
+
+    vsg::ref_ptr<StagingRing> _stagingRing;
+    vsg::ref_ptr<vsg::ImageInfo> _atlas;
+    vsg::ref_ptr<vsg::ubvec4Array3D> _pageTable;
+    vsg::ref_ptr<vsg::vec2Array3D> _minMax;
+    vsg::ref_ptr<vsg::vec4Array> _settings;
+    vsg::ref_ptr<vsg::Switch> _layoutSwitch;
+    std::vector<uint64_t> _changed;
+
+    Stats _stats;
+};
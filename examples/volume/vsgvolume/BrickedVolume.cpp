@@ -0,0 +1,337 @@
+#include "BrickedVolume.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#if defined(_WIN32)
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// MappedFile
+//
+bool MappedFile::open(const vsg::Path& filename)
+{
+    close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(filename.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    _data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!_data)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    _fileHandle = file;
+    _mappingHandle = mapping;
+    _size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(filename.string().c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) return false;
+
+    _data = static_cast<const uint8_t*>(ptr);
+    _size = static_cast<std::size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (!_data) return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(_data);
+    CloseHandle(_mappingHandle);
+    CloseHandle(_fileHandle);
+    _mappingHandle = nullptr;
+    _fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+
+    _data = nullptr;
+    _size = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// BrickedVolume
+//
+static const char brickedVolumeMagic[8] = {'v', 's', 'g', 'b', 'r', 'i', 'c', 'k'};
+
+bool BrickedVolume::write(vsg::ref_ptr<vsg::Data> volume, const vsg::Path& filename, uint32_t brickSize, float emptyThreshold)
+{
+    brickSize = std::max(brickSize, 2u);
+    if (auto floatVolume = volume.cast<vsg::floatArray3D>()) return writeLevels(*floatVolume, filename, brickSize, emptyThreshold, VK_FORMAT_R32_SFLOAT);
+    if (auto ubyteVolume = volume.cast<vsg::ubyteArray3D>()) return writeLevels(*ubyteVolume, filename, brickSize, emptyThreshold, VK_FORMAT_R8_UNORM);
+    if (auto ushortVolume = volume.cast<vsg::ushortArray3D>()) return writeLevels(*ushortVolume, filename, brickSize, emptyThreshold, VK_FORMAT_R16_UNORM);
+
+    vsg::warn("BrickedVolume::write(", volume, ") unsupported volume data type.");
+    return false;
+}
+
+template<class A>
+bool BrickedVolume::writeLevels(const A& volume, const vsg::Path& filename, uint32_t brickSize, float emptyThreshold, VkFormat format)
+{
+    using value_type = typename A::value_type;
+    const float scale = std::numeric_limits<value_type>::is_integer ? 1.0f / static_cast<float>(std::numeric_limits<value_type>::max()) : 1.0f;
+    const double rounding = std::numeric_limits<value_type>::is_integer ? 0.5 : 0.0;
+
+    if (volume.width() == 0 || volume.height() == 0 || volume.depth() == 0) return false;
+
+    // each level averages 2x2x2 voxels of the one before, so level L voxel i covers level 0 voxels [i * 2^L, (i + 1) * 2^L)
+    std::vector<vsg::ref_ptr<const A>> levels;
+    levels.emplace_back(&volume);
+    while (levels.size() < maxLevels)
+    {
+        auto& previous = *levels.back();
+        if (previous.width() <= brickSize && previous.height() <= brickSize && previous.depth() <= brickSize) break;
+
+        auto next = A::create((previous.width() + 1) / 2, (previous.height() + 1) / 2, (previous.depth() + 1) / 2);
+        next->properties.format = format;
+        for (size_t d = 0; d < next->depth(); ++d)
+        {
+            for (size_t r = 0; r < next->height(); ++r)
+            {
+                for (size_t c = 0; c < next->width(); ++c)
+                {
+                    double sum = 0.0;
+                    for (size_t i = 0; i < 8; ++i)
+                    {
+                        size_t pc = std::min(c * 2 + (i & 1), previous.width() - 1);
+                        size_t pr = std::min(r * 2 + ((i >> 1) & 1), previous.height() - 1);
+                        size_t pd = std::min(d * 2 + ((i >> 2) & 1), previous.depth() - 1);
+                        sum += static_cast<double>(previous.at(pc, pr, pd));
+                    }
+                    next->set(c, r, d, static_cast<value_type>(sum / 8.0 + rounding));
+                }
+            }
+        }
+        levels.emplace_back(next);
+    }
+
+    Header header{};
+    std::memcpy(header.magic, brickedVolumeMagic, sizeof(header.magic));
+    header.version = 1;
+    header.format = static_cast<uint32_t>(format);
+    header.valueSize = sizeof(value_type);
+    header.brickSize = brickSize;
+    header.numLevels = static_cast<uint32_t>(levels.size());
+    header.emptyThreshold = emptyThreshold;
+
+    uint64_t numEntries = 0;
+    for (uint32_t l = 0; l < header.numLevels; ++l)
+    {
+        auto& level = *levels[l];
+        uint32_t size[3] = {static_cast<uint32_t>(level.width()), static_cast<uint32_t>(level.height()), static_cast<uint32_t>(level.depth())};
+        for (int i = 0; i < 3; ++i)
+        {
+            header.levelSize[l][i] = size[i];
+            header.levelBricks[l][i] = (size[i] + brickSize - 1) / brickSize;
+        }
+        header.levelFirstEntry[l] = numEntries;
+        numEntries += uint64_t(header.levelBricks[l][0]) * header.levelBricks[l][1] * header.levelBricks[l][2];
+    }
+
+    std::ofstream fout(filename.string(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!fout) return false;
+
+    // the index is written after the payloads once the offsets are known
+    std::vector<IndexEntry> entries(numEntries, IndexEntry{0, 0.0f, 0.0f});
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    fout.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(IndexEntry));
+
+    uint64_t offset = sizeof(Header) + entries.size() * sizeof(IndexEntry);
+    const uint32_t stride = brickSize + 2;
+    std::vector<value_type> brick(size_t(stride) * stride * stride);
+
+    for (uint32_t l = 0; l < header.numLevels; ++l)
+    {
+        auto& level = *levels[l];
+        auto& bricks = header.levelBricks[l];
+        for (uint32_t bz = 0; bz < bricks[2]; ++bz)
+        {
+            for (uint32_t by = 0; by < bricks[1]; ++by)
+            {
+                for (uint32_t bx = 0; bx < bricks[0]; ++bx)
+                {
+                    float minValue = std::numeric_limits<float>::max();
+                    float maxValue = std::numeric_limits<float>::lowest();
+
+                    auto itr = brick.begin();
+                    for (uint32_t d = 0; d < stride; ++d)
+                    {
+                        size_t vd = static_cast<size_t>(std::clamp<int64_t>(int64_t(bz * brickSize + d) - 1, 0, int64_t(level.depth()) - 1));
+                        for (uint32_t r = 0; r < stride; ++r)
+                        {
+                            size_t vr = static_cast<size_t>(std::clamp<int64_t>(int64_t(by * brickSize + r) - 1, 0, int64_t(level.height()) - 1));
+                            for (uint32_t c = 0; c < stride; ++c)
+                            {
+                                size_t vc = static_cast<size_t>(std::clamp<int64_t>(int64_t(bx * brickSize + c) - 1, 0, int64_t(level.width()) - 1));
+                                auto v = level.at(vc, vr, vd);
+                                *(itr++) = v;
+                                minValue = std::min(minValue, static_cast<float>(v) * scale);
+                                maxValue = std::max(maxValue, static_cast<float>(v) * scale);
+                            }
+                        }
+                    }
+
+                    // averaging can hide small features, so a coarse brick's range also covers its children's, an empty brick then only has empty children
+                    if (l > 0)
+                    {
+                        auto& childBricks = header.levelBricks[l - 1];
+                        for (uint32_t i = 0; i < 8; ++i)
+                        {
+                            uint32_t cx = bx * 2 + (i & 1), cy = by * 2 + ((i >> 1) & 1), cz = bz * 2 + ((i >> 2) & 1);
+                            if (cx >= childBricks[0] || cy >= childBricks[1] || cz >= childBricks[2]) continue;
+
+                            auto& child = entries[header.levelFirstEntry[l - 1] + cx + uint64_t(childBricks[0]) * (cy + uint64_t(childBricks[1]) * cz)];
+                            minValue = std::min(minValue, child.minValue);
+                            maxValue = std::max(maxValue, child.maxValue);
+                        }
+                    }
+
+                    auto& entry = entries[header.levelFirstEntry[l] + bx + uint64_t(bricks[0]) * (by + uint64_t(bricks[1]) * bz)];
+                    entry.minValue = minValue;
+                    entry.maxValue = maxValue;
+
+                    if (maxValue > emptyThreshold)
+                    {
+                        entry.offset = offset;
+                        fout.write(reinterpret_cast<const char*>(brick.data()), brick.size() * sizeof(value_type));
+                        offset += brick.size() * sizeof(value_type);
+                    }
+                }
+            }
+        }
+    }
+
+    fout.seekp(sizeof(Header));
+    fout.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(IndexEntry));
+    return fout.good();
+}
+
+vsg::ref_ptr<BrickedVolume> BrickedVolume::open(const vsg::Path& filename)
+{
+    auto bricked = BrickedVolume::create();
+    if (!bricked->_file.open(filename)) return {};
+
+    auto& file = bricked->_file;
+    if (file.size() < sizeof(Header)) return {};
+
+    auto& header = bricked->header();
+    if (std::memcmp(header.magic, brickedVolumeMagic, sizeof(header.magic)) != 0 || header.version != 1 ||
+        header.numLevels == 0 || header.numLevels > maxLevels || header.brickSize < 2 || header.brickSize > 1024 ||
+        (header.valueSize != 1 && header.valueSize != 2 && header.valueSize != 4))
+    {
+        vsg::warn("BrickedVolume::open(", filename, ") not a bricked volume.");
+        return {};
+    }
+
+    // the brick counts and index layout follow from the level sizes, so check they agree before using any of them
+    uint64_t numEntries = 0;
+    for (uint32_t l = 0; l < header.numLevels; ++l)
+    {
+        bool consistent = header.levelFirstEntry[l] == numEntries;
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t size = header.levelSize[l][i];
+            uint32_t expectedSize = (l == 0) ? size : (header.levelSize[l - 1][i] + 1) / 2;
+            consistent = consistent && size > 0 && size == expectedSize && header.levelBricks[l][i] == (uint64_t(size) + header.brickSize - 1) / header.brickSize;
+        }
+        if (!consistent)
+        {
+            vsg::warn("BrickedVolume::open(", filename, ") inconsistent level ", l, ".");
+            return {};
+        }
+        numEntries += uint64_t(header.levelBricks[l][0]) * header.levelBricks[l][1] * header.levelBricks[l][2];
+    }
+
+    // check the whole index is mapped before it's used
+    uint64_t indexEnd = sizeof(Header) + numEntries * sizeof(IndexEntry);
+    if (numEntries > (file.size() - sizeof(Header)) / sizeof(IndexEntry))
+    {
+        vsg::warn("BrickedVolume::open(", filename, ") truncated index.");
+        return {};
+    }
+
+    // and every stored brick lies within the mapping, after the index, so brickData() never points past the end
+    uint64_t bytes = bricked->brickBytes();
+    auto entries = reinterpret_cast<const IndexEntry*>(file.data() + sizeof(Header));
+    for (uint64_t i = 0; i < numEntries; ++i)
+    {
+        uint64_t offset = entries[i].offset;
+        if (offset != 0 && (offset < indexEnd || bytes > file.size() || offset > file.size() - bytes))
+        {
+            vsg::warn("BrickedVolume::open(", filename, ") brick ", i, " outside of the file.");
+            return {};
+        }
+    }
+
+    return bricked;
+}
+
+vsg::uivec3 BrickedVolume::levelSize(uint32_t level) const
+{
+    auto& size = header().levelSize[level];
+    return vsg::uivec3(size[0], size[1], size[2]);
+}
+
+vsg::uivec3 BrickedVolume::levelBricks(uint32_t level) const
+{
+    auto& bricks = header().levelBricks[level];
+    return vsg::uivec3(bricks[0], bricks[1], bricks[2]);
+}
+
+size_t BrickedVolume::brickBytes() const
+{
+    size_t stride = brickSize() + 2;
+    return stride * stride * stride * header().valueSize;
+}
+
+const BrickedVolume::IndexEntry& BrickedVolume::entry(uint32_t level, uint32_t x, uint32_t y, uint32_t z) const
+{
+    auto& h = header();
+    auto index = h.levelFirstEntry[level] + x + uint64_t(h.levelBricks[level][0]) * (y + uint64_t(h.levelBricks[level][1]) * z);
+    return reinterpret_cast<const IndexEntry*>(_file.data() + sizeof(Header))[index];
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// Read only memory mapping of a file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const vsg::Path& filename);
+    void close();
+
+    const uint8_t* data() const { return _data; }
+    std::size_t size() const { return _size; }
+
+protected:
+    const uint8_t* _data = nullptr;
+    std::size_t _size = 0;
+#if defined(_WIN32)
+    void* _fileHandle = nullptr;
+    void* _mappingHandle = nullptr;
+#endif
+};
+
+// Multi-resolution bricked volume file, memory mapped so the index and the bricks are paged in by the OS on demand
+// rather than read up front. Level 0 is the full resolution volume and each following level halves the resolution in
+// each axis, down to a level that fits in a single brick. Every brick is stored with a one voxel border, so bricks can
+// be filtered without their neighbours, and bricks whose maximum is at or below the empty threshold aren't stored.
+//
+// Layout: Header, then for each level the IndexEntry of every brick in x, y then z order, then the brick payloads
+// each being (brickSize + 2)^3 voxels in x, y then z order.
+class BrickedVolume : public vsg::Inherit<vsg::Object, BrickedVolume>
+{
+public:
+    static constexpr uint32_t maxLevels = 16;
+
+    struct Header
+    {
+        char magic[8]; // "vsgbrick"
+        uint32_t version;
+        uint32_t format; // VkFormat of the voxels, VK_FORMAT_R8_UNORM, VK_FORMAT_R16_UNORM or VK_FORMAT_R32_SFLOAT
+        uint32_t valueSize;
+        uint32_t brickSize;
+        uint32_t numLevels;
+        float emptyThreshold;
+        uint32_t levelSize[maxLevels][3];
+        uint32_t levelBricks[maxLevels][3];
+        uint64_t levelFirstEntry[maxLevels];
+    };
+
+    struct IndexEntry
+    {
+        uint64_t offset; // 0 for empty bricks
+        float minValue;  // normalized value range of the brick including its border, the range of a coarser brick contains its children's
+        float maxValue;
+    };
+
+    // bricks a floatArray3D, ubyteArray3D or ushortArray3D held in memory into a new file
+    static bool write(vsg::ref_ptr<vsg::Data> volume, const vsg::Path& filename, uint32_t brickSize = 32, float emptyThreshold = 0.5f);
+
+    static vsg::ref_ptr<BrickedVolume> open(const vsg::Path& filename);
+
+    const Header& header() const { return *reinterpret_cast<const Header*>(_file.data()); }
+
+    uint32_t numLevels() const { return header().numLevels; }
+    uint32_t brickSize() const { return header().brickSize; }
+    VkFormat format() const { return static_cast<VkFormat>(header().format); }
+    vsg::uivec3 levelSize(uint32_t level) const;
+    vsg::uivec3 levelBricks(uint32_t level) const;
+
+    // bytes of a stored brick including its border
+    size_t brickBytes() const;
+
+    const IndexEntry& entry(uint32_t level, uint32_t x, uint32_t y, uint32_t z) const;
+
+    // the brick's voxels within the mapping, nullptr for empty bricks
+    const uint8_t* brickData(const IndexEntry& entry) const { return entry.offset != 0 ? _file.data() + entry.offset : nullptr; }
+
+protected:
+    template<class A>
+    static bool writeLevels(const A& volume, const vsg::Path& filename, uint32_t brickSize, float emptyThreshold, VkFormat format);
+
+    MappedFile _file;
+};
@@ -2,6 +2,10 @@
 #include <vsg/all.h>
 #include <vsgXchange/all.h>
 
+#include "BrickGrid.h"
+#include "BrickStreamer.h"
+#include "BrickedVolume.h"
+
 char volume_vert[] = R"(
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
@@ -202,12 +206,38 @@ int main(int argc, char** argv)
     windowTraits->width = 1000;
     windowTraits->height = 1000;
 
+    // skip empty bricks, step adaptively and stop rays once opaque, --sparse also only uploads the occupied bricks
+    bool sparse = arguments.read("--sparse");
+    bool useBricks = arguments.read("--bricks") || sparse;
+    auto brickSize = arguments.value<uint32_t>(16, "--brick-size");
+    auto maxStepScale = arguments.value<float>(4.0f, "--max-step-scale");
+    auto opacityThreshold = arguments.value<float>(0.95f, "--opacity-threshold");
+
+    // convert the volume to a bricked multi-resolution file, or stream one through a GPU brick cache of --brick-cache MB
+    auto writeBrickedFilename = arguments.value<vsg::Path>("", "--write-bricked");
+    auto brickedFilename = arguments.value<vsg::Path>("", "--bricked");
+    auto brickCacheSize = arguments.value<double>(512.0, "--brick-cache");
+    auto numLoaderThreads = arguments.value<uint32_t>(4, "--loader-threads");
+    auto lodScale = arguments.value<double>(1.0, "--lod-scale");
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     // load shaders
     auto vertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/volume.vert", options);
     auto fragmentShader = vsg::read_cast<vsg::ShaderStage>("shaders/volume.frag", options);
 
+    if (brickedFilename && !fragmentShader)
+    {
+        std::cout << "Streaming a bricked volume requires shaders/volume.frag." << std::endl;
+        return 1;
+    }
+
+    if (useBricks && !fragmentShader)
+    {
+        std::cout << "Brick grid requires shaders/volume.frag, falling back to marching the whole volume." << std::endl;
+        useBricks = false;
+    }
+
     if (!vertexShader) vertexShader = vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", volume_vert);
     if (!fragmentShader) fragmentShader = vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", volume_frag);
 
@@ -218,6 +248,32 @@ int main(int argc, char** argv)
     }
 
 
+    vsg::ref_ptr<BrickStreamer> brickStreamer;
+    if (brickedFilename)
+    {
+        auto brickedVolume = BrickedVolume::open(brickedFilename);
+        if (!brickedVolume)
+        {
+            std::cout << "Could not open bricked volume " << brickedFilename << std::endl;
+            return 1;
+        }
+
+        auto loaderThreads = numLoaderThreads > 0 ? vsg::OperationThreads::create(numLoaderThreads) : vsg::ref_ptr<vsg::OperationThreads>();
+        brickStreamer = BrickStreamer::create(brickedVolume, static_cast<VkDeviceSize>(brickCacheSize * 1024.0 * 1024.0), loaderThreads);
+        brickStreamer->lodScale = lodScale;
+        brickStreamer->maxStepScale = maxStepScale;
+        brickStreamer->opacityThreshold = opacityThreshold;
+        brickStreamer->setup();
+
+        std::cout << "BrickStreamer : " << brickedVolume->levelSize(0) << " voxels in " << brickedVolume->numLevels() << " levels of " << brickedVolume->brickSize()
+                  << " voxel bricks, cache of " << brickStreamer->numSlots() << " bricks" << std::endl;
+
+        fragmentShader->module->hints = vsg::ShaderCompileSettings::create();
+        fragmentShader->module->hints->defines.insert("VSG_BRICK_GRID");
+        fragmentShader->module->hints->defines.insert("VSG_SPARSE_BRICKS");
+        useBricks = false;
+    }
+
     vsg::ref_ptr<vsg::Data> textureData;
     if (auto texturePath = arguments.value<vsg::Path>("", "-i"))
     {
@@ -225,7 +281,7 @@ int main(int argc, char** argv)
         std::cout<<"Reading "<<textureData<<" from "<<texturePath<<std::endl;
     }
 
-    if (!textureData)
+    if (!textureData && !brickStreamer)
     {
         // read texture image
         auto data = vsg::floatArray3D::create(100, 100, 100);
@@ -242,11 +298,54 @@ int main(int argc, char** argv)
         textureData = data;
     }
 
+    if (writeBrickedFilename)
+    {
+        if (!textureData || !BrickedVolume::write(textureData, writeBrickedFilename, brickSize))
+        {
+            std::cout << "Could not write bricked volume " << writeBrickedFilename << std::endl;
+            return 1;
+        }
+        std::cout << "Written bricked volume " << writeBrickedFilename << std::endl;
+        return 0;
+    }
+
+    vsg::ref_ptr<BrickGrid> brickGrid;
+    if (useBricks)
+    {
+        brickGrid = BrickGrid::create(brickSize, sparse);
+        brickGrid->maxStepScale = maxStepScale;
+        brickGrid->opacityThreshold = opacityThreshold;
+        if (brickGrid->build(textureData))
+        {
+            std::cout << "BrickGrid : " << brickGrid->numBricks << " bricks of " << brickSize << " voxels, " << brickGrid->numOccupied << " occupied" << std::endl;
+            if (sparse)
+            {
+                std::cout << "    sparse atlas of " << brickGrid->atlas->dataSize() << " bytes replaces the " << textureData->dataSize() << " byte volume" << std::endl;
+                textureData = brickGrid->atlas;
+            }
+
+            fragmentShader->module->hints = vsg::ShaderCompileSettings::create();
+            fragmentShader->module->hints->defines.insert("VSG_BRICK_GRID");
+            if (sparse) fragmentShader->module->hints->defines.insert("VSG_SPARSE_BRICKS");
+        }
+        else
+        {
+            brickGrid = {};
+        }
+    }
+
     // set up graphics pipeline
     vsg::DescriptorSetLayoutBindings descriptorBindings{
         {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr} // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
     };
 
+    if (brickGrid || brickStreamer)
+    {
+        descriptorBindings.push_back({1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr});         // BrickSettings
+        descriptorBindings.push_back({2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}); // brickMinMax
+        if (brickStreamer || brickGrid->indirection) descriptorBindings.push_back({3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}); // brickIndirection
+    }
+
     auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
 
     vsg::PushConstantRanges pushConstantRanges{
@@ -282,9 +381,34 @@ int main(int argc, char** argv)
     clampToEdge_sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     clampToEdge_sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
 
-    auto texture = vsg::DescriptorImage::create(clampToEdge_sampler, textureData, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    vsg::Descriptors descriptors;
+    if (brickStreamer)
+    {
+        // the brick cache atlas, page table and brick ranges are all owned by the streamer
+        descriptors = brickStreamer->descriptors();
+    }
+    else
+    {
+        descriptors.push_back(vsg::DescriptorImage::create(clampToEdge_sampler, textureData, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER));
+    }
+
+    if (brickGrid)
+    {
+        // the brick grids are read per brick so must not be filtered
+        auto nearest_sampler = vsg::Sampler::create();
+        nearest_sampler->magFilter = VK_FILTER_NEAREST;
+        nearest_sampler->minFilter = VK_FILTER_NEAREST;
+        nearest_sampler->mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        nearest_sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        nearest_sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        nearest_sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+        descriptors.push_back(vsg::DescriptorBuffer::create(brickGrid->settings, 1, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER));
+        descriptors.push_back(vsg::DescriptorImage::create(nearest_sampler, brickGrid->minMax, 2, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER));
+        if (brickGrid->indirection) descriptors.push_back(vsg::DescriptorImage::create(nearest_sampler, brickGrid->indirection, 3, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER));
+    }
 
-    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture});
+    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, descriptors);
     auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->layout, 0, descriptorSet);
 
     // create StateGroup as the root of the scene/command graph to hold the GraphicsProgram, and binding of Descriptors to decorate the whole graph
@@ -320,6 +444,11 @@ int main(int argc, char** argv)
     auto camera = vsg::Camera::create(perspective, lookAt, viewport);
 
     auto commandGraph = vsg::createCommandGraphForView(window, camera, scenegraph);
+    if (brickStreamer)
+    {
+        // brick uploads have to be recorded before the render pass that samples the atlas
+        commandGraph->children.insert(commandGraph->children.begin(), brickStreamer->createCommands(window->numFrames()));
+    }
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     // compile the Vulkan objects
@@ -335,6 +464,13 @@ int main(int argc, char** argv)
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
+        if (brickStreamer)
+        {
+            // the volume geometry spans the unit cube at the origin so the eye is already in the volume's coordinates
+            double pixelScale = static_cast<double>(window->extent2D().height) / (2.0 * std::tan(vsg::radians(perspective->fieldOfViewY) * 0.5));
+            brickStreamer->update(viewer->recordAndSubmitTasks[0]->fence(), lookAt->eye, pixelScale);
+        }
+
         viewer->update();
 
         viewer->recordAndSubmit();
@@ -342,6 +478,13 @@ int main(int argc, char** argv)
         viewer->present();
     }
 
+    if (brickStreamer)
+    {
+        auto& stats = brickStreamer->stats();
+        std::cout << "BrickStreamer : requested " << stats.bricksRequested << ", uploaded " << stats.bricksUploaded << ", evicted " << stats.bricksEvicted
+                  << ", dropped " << stats.bricksDropped << ", " << stats.bricksResident << " resident" << std::endl;
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }